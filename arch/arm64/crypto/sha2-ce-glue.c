@@ -28,6 +28,8 @@ struct sha256_ce_state {
 
 asmlinkage void sha2_ce_transform(struct sha256_ce_state *sst, u8 const *src,
 				  int blocks);
+asmlinkage void sha2_ce_transform2x(u32 *state1, u32 *state2, u8 const *src1,
+				    u8 const *src2, int blocks);
 
 const u32 sha256_ce_offsetof_count = offsetof(struct sha256_ce_state,
 					      sst.count);
@@ -81,6 +83,84 @@ static int sha256_ce_final(struct shash_desc *desc, u8 *out)
 	return sha256_base_finish(desc, out);
 }
 
+/*
+ * Finish two messages that share the state in @desc and have the same length,
+ * running both through the interleaved transform.  The last (padded) blocks
+ * are assembled here so the asm code only ever sees whole blocks.
+ */
+static void sha256_ce_finup2x(struct shash_desc *desc, const u8 *data1,
+			      const u8 *data2, unsigned int len, u8 *out1,
+			      u8 *out2)
+{
+	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->sst.count % SHA256_BLOCK_SIZE;
+	u64 bits = (sctx->sst.count + len) << 3;
+	u8 buf1[2 * SHA256_BLOCK_SIZE], buf2[2 * SHA256_BLOCK_SIZE];
+	u32 st1[SHA256_DIGEST_SIZE / 4], st2[SHA256_DIGEST_SIZE / 4];
+	unsigned int blocks, i;
+
+	memcpy(st1, sctx->sst.state, sizeof(st1));
+	memcpy(st2, sctx->sst.state, sizeof(st2));
+	memcpy(buf1, sctx->sst.buf, partial);
+	memcpy(buf2, sctx->sst.buf, partial);
+
+	kernel_neon_begin_partial(22);
+
+	if (partial) {
+		unsigned int n = min(len, SHA256_BLOCK_SIZE - partial);
+
+		memcpy(buf1 + partial, data1, n);
+		memcpy(buf2 + partial, data2, n);
+		partial += n;
+		data1 += n;
+		data2 += n;
+		len -= n;
+		if (partial == SHA256_BLOCK_SIZE) {
+			sha2_ce_transform2x(st1, st2, buf1, buf2, 1);
+			partial = 0;
+		}
+	}
+
+	blocks = len / SHA256_BLOCK_SIZE;
+	if (blocks) {
+		sha2_ce_transform2x(st1, st2, data1, data2, blocks);
+		data1 += blocks * SHA256_BLOCK_SIZE;
+		data2 += blocks * SHA256_BLOCK_SIZE;
+		len -= blocks * SHA256_BLOCK_SIZE;
+	}
+
+	/* what is left fits in the buffer, followed by the padding */
+	memcpy(buf1 + partial, data1, len);
+	memcpy(buf2 + partial, data2, len);
+	partial += len;
+	blocks = partial + 9 > SHA256_BLOCK_SIZE ? 2 : 1;
+	buf1[partial] = 0x80;
+	memset(buf1 + partial + 1, 0,
+	       blocks * SHA256_BLOCK_SIZE - partial - 1 - sizeof(bits));
+	put_unaligned_be64(bits, buf1 + blocks * SHA256_BLOCK_SIZE - 8);
+	memcpy(buf2 + partial, buf1 + partial,
+	       blocks * SHA256_BLOCK_SIZE - partial);
+	sha2_ce_transform2x(st1, st2, buf1, buf2, blocks);
+
+	kernel_neon_end();
+
+	for (i = 0; i < SHA256_DIGEST_SIZE / 4; i++) {
+		put_unaligned_be32(st1[i], out1 + i * 4);
+		put_unaligned_be32(st2[i], out2 + i * 4);
+	}
+}
+
+static int sha256_ce_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			      unsigned int len, u8 * const outs[],
+			      unsigned int num_msgs)
+{
+	if (WARN_ON_ONCE(num_msgs != 2))
+		return -EOPNOTSUPP;
+
+	sha256_ce_finup2x(desc, data[0], data[1], len, outs[0], outs[1]);
+	return 0;
+}
+
 static struct shash_alg algs[] = { {
 	.init			= sha224_base_init,
 	.update			= sha256_ce_update,
@@ -101,7 +181,9 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
 	.descsize		= sizeof(struct sha256_ce_state),
+	.mb_max_msgs		= 2,
 	.digestsize		= SHA256_DIGEST_SIZE,
 	.base			= {
 		.cra_name		= "sha256",
@@ -658,6 +658,17 @@ static bool has_no_hw_prefetch(const struct arm64_cpu_capabilities *entry)
 	return MIDR_IS_CPU_MODEL_RANGE(midr, MIDR_THUNDERX, rv_min, rv_max);
 }
 
+/*
+ * Cores on which large memcpy()s run faster with non-temporal stores: the
+ * destination of a multi-page copy would only evict useful lines.
+ */
+static bool has_nt_large_copy(const struct arm64_cpu_capabilities *entry)
+{
+	u32 model = read_cpuid_id() & MIDR_CPU_MODEL_MASK;
+
+	return model == MIDR_KRYO2XX_GOLD || model == MIDR_KRYO2XX_SILVER;
+}
+
 static bool runs_at_el2(const struct arm64_cpu_capabilities *entry)
 {
 	return is_kernel_in_hyp_mode();
@@ -734,6 +745,11 @@ static const struct arm64_cpu_capabilities arm64_features[] = {
 		.capability = ARM64_HAS_NO_HW_PREFETCH,
 		.matches = has_no_hw_prefetch,
 	},
+	{
+		.desc = "Non-temporal stores for large copies",
+		.capability = ARM64_HAS_NT_LARGE_COPY,
+		.matches = has_nt_large_copy,
+	},
 #ifdef CONFIG_ARM64_UAO
 	{
 		.desc = "User Access Override",
@@ -915,11 +915,30 @@ struct cftype blkcg_files[] = {
 	{ }	/* terminate */
 };
 
+static u64 blkcg_background_read(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return css_to_blkcg(css)->background;
+}
+
+static int blkcg_background_write(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	ACCESS_ONCE(css_to_blkcg(css)->background) = !!val;
+	return 0;
+}
+
 struct cftype blkcg_legacy_files[] = {
 	{
 		.name = "reset_stats",
 		.write_u64 = blkcg_reset_stats,
 	},
+	{
+		.name = "background",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = blkcg_background_read,
+		.write_u64 = blkcg_background_write,
+	},
 	{ }	/* terminate */
 };
 
@@ -39,6 +39,7 @@
 #include <linux/ratelimit.h>
 #include <linux/pm_runtime.h>
 #include <linux/blk-cgroup.h>
+#include <soc/qcom/boot_stats.h>
 
 #ifdef CONFIG_BLOCK_PERF_FRAMEWORK
 #include <linux/ktime.h>
@@ -1708,6 +1709,7 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 	req->errors = 0;
 	req->__sector = bio->bi_iter.bi_sector;
 	req->ioprio = bio_prio(bio);
+	req->write_hint = bio->bi_write_hint;
 	blk_rq_bio_prep(req->q, req, bio);
 }
 EXPORT_SYMBOL(init_request_from_bio);
@@ -2053,6 +2055,8 @@ blk_qc_t generic_make_request(struct bio *bio)
 	if (!generic_make_request_checks(bio))
 		goto out;
 
+	boot_event_bio(bio);
+
 	/*
 	 * We only want one ->make_request_fn to be active at a time, else
 	 * stack usage with stacked devices could be a problem.  So use
@@ -2788,6 +2792,7 @@ void blk_account_io_completion(struct request *req, unsigned int bytes)
 		cpu = part_stat_lock();
 		part = req->part;
 		part_stat_add(cpu, part, sectors[rw], bytes >> 9);
+		blk_latency_io_bytes(req, bytes);
 		part_stat_unlock();
 	}
 }
@@ -2812,6 +2817,7 @@ void blk_account_io_done(struct request *req)
 		part_stat_add(cpu, part, ticks[rw], duration);
 		part_round_stats(cpu, part);
 		part_dec_in_flight(part, rw);
+		blk_latency_io_done(cpu, req);
 
 		hd_struct_put(part);
 		part_stat_unlock();
@@ -2871,6 +2877,7 @@ void blk_account_io_start(struct request *rq, bool new_io)
 		part_round_stats(cpu, part);
 		part_inc_in_flight(part, rw);
 		rq->part = part;
+		blk_latency_io_start(cpu, rq);
 	}
 
 	part_stat_unlock();
@@ -3584,6 +3591,7 @@ static void __blk_rq_prep_clone(struct request *dst, struct request *src)
 	dst->__data_len = blk_rq_bytes(src);
 	dst->nr_phys_segments = src->nr_phys_segments;
 	dst->ioprio = src->ioprio;
+	dst->write_hint = src->write_hint;
 	dst->extra_len = src->extra_len;
 }
 
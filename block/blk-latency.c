@@ -0,0 +1,374 @@
+/*
+ * Lightweight per-queue request latency and queue depth statistics
+ *
+ * Requests accounted by blk_account_io_start()/blk_account_io_done() are
+ * binned by operation and size into per-cpu log2 latency histograms, and
+ * the in-flight depth seen by each new request is recorded both as a
+ * histogram and as a coarse time series.  Everything is exported through
+ * the queue's sysfs directory, so that storage latency can be correlated
+ * with userspace stalls without running blktrace.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/genhd.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+
+#include "blk.h"
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,
+	BLK_LAT_FLUSH,
+	BLK_LAT_DISCARD,
+	BLK_LAT_NR_OPS,
+};
+
+/* upper bounds of the size classes, the last class is open ended */
+static const unsigned int blk_lat_size_kb[] = { 4, 16, 64, 256 };
+#define BLK_LAT_NR_SIZES	(ARRAY_SIZE(blk_lat_size_kb) + 1)
+
+/* bucket i holds latencies below (64us << i), the last one the rest */
+#define BLK_LAT_MIN_SHIFT	6
+#define BLK_LAT_NR_BUCKETS	14
+
+/* bucket i holds depths in [2^(i-1), 2^i), the last one the rest */
+#define BLK_LAT_NR_DEPTHS	9
+
+/* depth time series: one sample every BLK_LAT_SAMPLE_MS at most */
+#define BLK_LAT_NR_SAMPLES	64
+#define BLK_LAT_SAMPLE_MS	10
+
+static const char * const blk_lat_op_name[BLK_LAT_NR_OPS] = {
+	[BLK_LAT_READ]		= "read",
+	[BLK_LAT_WRITE]		= "write",
+	[BLK_LAT_FLUSH]		= "flush",
+	[BLK_LAT_DISCARD]	= "discard",
+};
+
+struct blk_latency_cpu {
+	u32 lat[BLK_LAT_NR_OPS][BLK_LAT_NR_SIZES][BLK_LAT_NR_BUCKETS];
+	u64 lat_sum_us[BLK_LAT_NR_OPS];
+	u32 depth[BLK_LAT_NR_DEPTHS];
+};
+
+struct blk_latency_sample {
+	unsigned long time;
+	unsigned int depth;
+};
+
+struct blk_latency {
+	struct blk_latency_cpu __percpu *cpu;
+	unsigned long next_sample;
+	unsigned int sample_head;
+	struct blk_latency_sample samples[BLK_LAT_NR_SAMPLES];
+};
+
+static int blk_lat_op(struct request *rq)
+{
+	if (rq->cmd_flags & REQ_DISCARD)
+		return BLK_LAT_DISCARD;
+	if ((rq->cmd_flags & REQ_FLUSH) && !rq->lat_bytes)
+		return BLK_LAT_FLUSH;
+	return rq_data_dir(rq) == WRITE ? BLK_LAT_WRITE : BLK_LAT_READ;
+}
+
+static int blk_lat_size(unsigned int bytes)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blk_lat_size_kb); i++)
+		if (bytes <= blk_lat_size_kb[i] << 10)
+			break;
+	return i;
+}
+
+static void blk_latency_sample_depth(struct blk_latency *lat,
+				     unsigned int depth)
+{
+	unsigned long now = jiffies;
+	unsigned long next = READ_ONCE(lat->next_sample);
+	unsigned int head;
+
+	if (time_before(now, next))
+		return;
+
+	/* a single submitter wins the slot, the others just move on */
+	if (cmpxchg(&lat->next_sample, next,
+		    now + msecs_to_jiffies(BLK_LAT_SAMPLE_MS)) != next)
+		return;
+
+	head = lat->sample_head;
+	lat->samples[head].time = now;
+	lat->samples[head].depth = depth;
+	lat->sample_head = (head + 1) % BLK_LAT_NR_SAMPLES;
+}
+
+/*
+ * Called from blk_account_io_start() for a new request, after it has been
+ * counted in flight.  The caller holds part_stat_lock().
+ */
+void blk_latency_io_start(int cpu, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	struct blk_latency *lat = lockless_dereference(q->latency);
+	struct blk_latency_cpu *stats;
+	unsigned int depth;
+
+	rq->lat_start_ns = 0;
+	rq->lat_bytes = 0;
+	if (!lat || !q->lat_hist_enabled)
+		return;
+
+	rq->lat_start_ns = ktime_get_ns();
+
+	depth = part_in_flight(&rq->rq_disk->part0);
+	stats = per_cpu_ptr(lat->cpu, cpu);
+	stats->depth[min(fls(depth), BLK_LAT_NR_DEPTHS - 1)]++;
+	blk_latency_sample_depth(lat, depth);
+}
+
+/*
+ * Called from blk_account_io_done() with part_stat_lock() held.  The
+ * request size has been accumulated by blk_account_io_completion(), as
+ * nothing is left in the request by the time it is done.
+ */
+void blk_latency_io_done(int cpu, struct request *rq)
+{
+	struct blk_latency *lat = lockless_dereference(rq->q->latency);
+	struct blk_latency_cpu *stats;
+	u64 now = ktime_get_ns();
+	u64 us;
+	int op;
+
+	if (!lat || !rq->lat_start_ns || now < rq->lat_start_ns)
+		return;
+
+	us = div_u64(now - rq->lat_start_ns, NSEC_PER_USEC);
+	op = blk_lat_op(rq);
+
+	stats = per_cpu_ptr(lat->cpu, cpu);
+	stats->lat[op][blk_lat_size(rq->lat_bytes)]
+		  [min(fls64(us >> BLK_LAT_MIN_SHIFT), BLK_LAT_NR_BUCKETS - 1)]++;
+	stats->lat_sum_us[op] += us;
+	rq->lat_start_ns = 0;
+}
+
+/*
+ * Statistics are set up and switched on when the queue is registered, so
+ * the many queues probed and torn down without a disk never pay for them.
+ */
+int blk_latency_init(struct request_queue *q)
+{
+	struct blk_latency *lat;
+
+	if (q->latency)
+		return 0;
+
+	lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+
+	lat->cpu = alloc_percpu(struct blk_latency_cpu);
+	if (!lat->cpu) {
+		kfree(lat);
+		return -ENOMEM;
+	}
+	lat->next_sample = jiffies;
+
+	smp_store_release(&q->latency, lat);
+	q->lat_hist_enabled = 1;
+	return 0;
+}
+
+void blk_latency_exit(struct request_queue *q)
+{
+	struct blk_latency *lat = q->latency;
+
+	if (!lat)
+		return;
+
+	free_percpu(lat->cpu);
+	kfree(lat);
+	q->latency = NULL;
+}
+
+static void blk_latency_reset(struct blk_latency *lat)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(lat->cpu, cpu), 0,
+		       sizeof(struct blk_latency_cpu));
+	memset(lat->samples, 0, sizeof(lat->samples));
+}
+
+ssize_t blk_latency_enable_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u\n", q->lat_hist_enabled);
+}
+
+/*
+ * Same protocol as the driver level latency_hist files: writing
+ * BLK_IO_LAT_HIST_ENABLE or BLK_IO_LAT_HIST_DISABLE toggles collection,
+ * BLK_IO_LAT_HIST_ZERO clears everything collected so far.
+ */
+ssize_t blk_latency_enable_store(struct request_queue *q, const char *page,
+				 size_t count)
+{
+	long value;
+	int err;
+
+	if (kstrtol(page, 0, &value))
+		return -EINVAL;
+
+	switch (value) {
+	case BLK_IO_LAT_HIST_ENABLE:
+		err = blk_latency_init(q);
+		if (err)
+			return err;
+		/* fall through */
+	case BLK_IO_LAT_HIST_DISABLE:
+		q->lat_hist_enabled = value;
+		break;
+	case BLK_IO_LAT_HIST_ZERO:
+		if (q->latency)
+			blk_latency_reset(q->latency);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return count;
+}
+
+/* Show the histograms of one operation, one column per size class. */
+static ssize_t blk_latency_op_show(struct request_queue *q, char *page,
+				   int op)
+{
+	struct blk_latency *lat = q->latency;
+	u64 hist[BLK_LAT_NR_SIZES][BLK_LAT_NR_BUCKETS] = { { 0 } };
+	u64 total = 0, sum = 0;
+	ssize_t len = 0;
+	int cpu, s, b;
+
+	if (!lat)
+		return sprintf(page, "disabled\n");
+
+	for_each_possible_cpu(cpu) {
+		struct blk_latency_cpu *stats = per_cpu_ptr(lat->cpu, cpu);
+
+		for (s = 0; s < BLK_LAT_NR_SIZES; s++)
+			for (b = 0; b < BLK_LAT_NR_BUCKETS; b++)
+				hist[s][b] += stats->lat[op][s][b];
+		sum += stats->lat_sum_us[op];
+	}
+	for (s = 0; s < BLK_LAT_NR_SIZES; s++)
+		for (b = 0; b < BLK_LAT_NR_BUCKETS; b++)
+			total += hist[s][b];
+
+	len += scnprintf(page + len, PAGE_SIZE - len,
+			 "%s latency (n = %llu, average = %lluus)\n",
+			 blk_lat_op_name[op], total,
+			 total ? div64_u64(sum, total) : 0);
+
+	len += scnprintf(page + len, PAGE_SIZE - len, "%12s", "");
+	for (s = 0; s < ARRAY_SIZE(blk_lat_size_kb); s++)
+		len += scnprintf(page + len, PAGE_SIZE - len, "%9s%4uK", "<=",
+				 blk_lat_size_kb[s]);
+	len += scnprintf(page + len, PAGE_SIZE - len, "%9s%4uK\n", ">",
+			 blk_lat_size_kb[s - 1]);
+
+	for (b = 0; b < BLK_LAT_NR_BUCKETS; b++) {
+		if (b < BLK_LAT_NR_BUCKETS - 1)
+			len += scnprintf(page + len, PAGE_SIZE - len,
+					 "< %8uus", 1U << (BLK_LAT_MIN_SHIFT + b));
+		else
+			len += scnprintf(page + len, PAGE_SIZE - len,
+					 ">=%8uus",
+					 1U << (BLK_LAT_MIN_SHIFT + b - 1));
+		for (s = 0; s < BLK_LAT_NR_SIZES; s++)
+			len += scnprintf(page + len, PAGE_SIZE - len, "%14llu",
+					 hist[s][b]);
+		len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	}
+	return len;
+}
+
+ssize_t blk_latency_read_show(struct request_queue *q, char *page)
+{
+	return blk_latency_op_show(q, page, BLK_LAT_READ);
+}
+
+ssize_t blk_latency_write_show(struct request_queue *q, char *page)
+{
+	return blk_latency_op_show(q, page, BLK_LAT_WRITE);
+}
+
+ssize_t blk_latency_flush_show(struct request_queue *q, char *page)
+{
+	return blk_latency_op_show(q, page, BLK_LAT_FLUSH);
+}
+
+ssize_t blk_latency_discard_show(struct request_queue *q, char *page)
+{
+	return blk_latency_op_show(q, page, BLK_LAT_DISCARD);
+}
+
+ssize_t blk_latency_depth_show(struct request_queue *q, char *page)
+{
+	struct blk_latency *lat = q->latency;
+	u64 hist[BLK_LAT_NR_DEPTHS] = { 0 };
+	ssize_t len = 0;
+	int cpu, b;
+
+	if (!lat)
+		return sprintf(page, "disabled\n");
+
+	for_each_possible_cpu(cpu) {
+		struct blk_latency_cpu *stats = per_cpu_ptr(lat->cpu, cpu);
+
+		for (b = 0; b < BLK_LAT_NR_DEPTHS; b++)
+			hist[b] += stats->depth[b];
+	}
+
+	for (b = 1; b < BLK_LAT_NR_DEPTHS; b++) {
+		if (b < BLK_LAT_NR_DEPTHS - 1)
+			len += scnprintf(page + len, PAGE_SIZE - len,
+					 "%4u-%-4u %llu\n", 1U << (b - 1),
+					 (1U << b) - 1, hist[b]);
+		else
+			len += scnprintf(page + len, PAGE_SIZE - len,
+					 ">=%-7u %llu\n", 1U << (b - 1),
+					 hist[b]);
+	}
+	return len;
+}
+
+/* Newest sample first, as "<age in ms> <depth>". */
+ssize_t blk_latency_depth_samples_show(struct request_queue *q, char *page)
+{
+	struct blk_latency *lat = q->latency;
+	unsigned long now = jiffies;
+	ssize_t len = 0;
+	unsigned int head, i;
+
+	if (!lat)
+		return sprintf(page, "disabled\n");
+
+	head = READ_ONCE(lat->sample_head);
+	for (i = 1; i <= BLK_LAT_NR_SAMPLES; i++) {
+		struct blk_latency_sample *sample;
+
+		sample = &lat->samples[(head + BLK_LAT_NR_SAMPLES - i) %
+				       BLK_LAT_NR_SAMPLES];
+		if (!sample->time)
+			break;
+		len += scnprintf(page + len, PAGE_SIZE - len, "%u %u\n",
+				 jiffies_to_msecs(now - sample->time),
+				 sample->depth);
+	}
+	return len;
+}
@@ -782,6 +782,10 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 	if (crypto_not_mergeable(req->bio, next->bio))
 		return 0;
 
+	/* don't mix data of different lifetimes on the device */
+	if (req->write_hint != next->write_hint)
+		return 0;
+
 	/*
 	 * If we are allowed to merge, then append bio list
 	 * from next to rq and release next. merge_requests_fn
@@ -895,6 +899,9 @@ bool blk_rq_merge_ok(struct request *rq, struct bio *bio)
 	if (crypto_not_mergeable(rq->bio, bio))
 		return false;
 
+	if (rq->write_hint != bio->bi_write_hint)
+		return false;
+
 	return true;
 }
 
@@ -8,6 +8,10 @@
  * Uses active queue tracking to support fairer distribution of tags
  * between multiple submitters when a shared tag map is used.
  *
+ * Large enough FIFO maps also keep a small per-cpu cache of free tags,
+ * refilled and drained a batch at a time, so that most allocations and
+ * frees never touch the shared bitmap.
+ *
  * Copyright (C) 2013-2014 Jens Axboe
  */
 #include <linux/kernel.h>
@@ -19,6 +23,20 @@
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
 
+static unsigned int bt_cached_tags(struct blk_mq_bitmap_tags *bt)
+{
+	unsigned int nr = 0;
+	int cpu;
+
+	if (!bt->cache)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		nr += READ_ONCE(per_cpu_ptr(bt->cache, cpu)->nr);
+
+	return nr;
+}
+
 static bool bt_has_free_tags(struct blk_mq_bitmap_tags *bt)
 {
 	int i;
@@ -32,7 +50,7 @@ static bool bt_has_free_tags(struct blk_mq_bitmap_tags *bt)
 			return true;
 	}
 
-	return false;
+	return bt_cached_tags(bt) != 0;
 }
 
 bool blk_mq_has_free_tags(struct blk_mq_tags *tags)
@@ -177,6 +195,110 @@ static int __bt_get_word(struct blk_align_bitmap *bm, unsigned int last_tag,
 
 #define BT_ALLOC_RR(tags) (tags->alloc_policy == BLK_TAG_ALLOC_RR)
 
+static inline unsigned long bt_word_mask(struct blk_align_bitmap *bm)
+{
+	if (bm->depth >= BITS_PER_LONG)
+		return ~0UL;
+	return (1UL << bm->depth) - 1;
+}
+
+/*
+ * Claim up to @nr free tags with a single cmpxchg on the first word,
+ * starting at *tag_cache, that has any free. Staying within one word
+ * keeps a cpu's cached tags on the cacheline it already owns.
+ */
+static unsigned int bt_claim_tags(struct blk_mq_bitmap_tags *bt,
+				  unsigned int *tag_cache,
+				  unsigned int *tags, unsigned int nr)
+{
+	unsigned int index = TAG_TO_INDEX(bt, *tag_cache);
+	unsigned int got = 0;
+	int i;
+
+	if (index >= bt->map_nr)
+		index = 0;
+
+	for (i = 0; i < bt->map_nr && !got; i++) {
+		struct blk_align_bitmap *bm = &bt->map[index];
+		unsigned long old, free, claim;
+		int bit;
+
+		do {
+			old = READ_ONCE(bm->word);
+			free = ~old & bt_word_mask(bm);
+			claim = 0;
+			got = 0;
+			for_each_set_bit(bit, &free, BITS_PER_LONG) {
+				claim |= 1UL << bit;
+				tags[got++] = (index << bt->bits_per_word) + bit;
+				if (got == nr)
+					break;
+			}
+		} while (claim && cmpxchg(&bm->word, old, old | claim) != old);
+
+		if (++index >= bt->map_nr)
+			index = 0;
+	}
+
+	if (got) {
+		*tag_cache = tags[got - 1] + 1;
+		if (*tag_cache >= bt->depth - 1)
+			*tag_cache = 0;
+	}
+
+	return got;
+}
+
+/*
+ * Hand out the most recently freed tag of this cpu, its request is the
+ * most likely to still be cache hot. Refill in a batch if empty.
+ */
+static int bt_cache_get(struct blk_mq_bitmap_tags *bt,
+			unsigned int *tag_cache)
+{
+	struct bt_tag_cache *cache;
+	unsigned long flags;
+	int tag = -1;
+
+	cache = get_cpu_ptr(bt->cache);
+	spin_lock_irqsave(&cache->lock, flags);
+	if (!cache->nr)
+		cache->nr = bt_claim_tags(bt, tag_cache, cache->tags,
+					  bt->cache_batch);
+	if (cache->nr)
+		tag = cache->tags[--cache->nr];
+	spin_unlock_irqrestore(&cache->lock, flags);
+	put_cpu_ptr(bt->cache);
+
+	return tag;
+}
+
+/*
+ * The bitmap is exhausted, take a tag back from whichever cpu still
+ * has one cached. This also covers caches of cpus that went offline.
+ */
+static int bt_cache_steal(struct blk_mq_bitmap_tags *bt)
+{
+	unsigned long flags;
+	int cpu, tag = -1;
+
+	for_each_possible_cpu(cpu) {
+		struct bt_tag_cache *cache = per_cpu_ptr(bt->cache, cpu);
+
+		if (!READ_ONCE(cache->nr))
+			continue;
+
+		spin_lock_irqsave(&cache->lock, flags);
+		if (cache->nr)
+			tag = cache->tags[--cache->nr];
+		spin_unlock_irqrestore(&cache->lock, flags);
+		if (tag != -1)
+			break;
+	}
+
+	return tag;
+}
+
 /*
  * Straight forward bitmap tag implementation, where each bit is a tag
  * (cleared == free, and set == busy). The small twist is using per-cpu
@@ -197,6 +319,12 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 	if (!hctx_may_queue(hctx, bt))
 		return -1;
 
+	if (bt->cache_size) {
+		tag = bt_cache_get(bt, tag_cache);
+		if (tag != -1)
+			return tag;
+	}
+
 	last_tag = org_last_tag = *tag_cache;
 	index = TAG_TO_INDEX(bt, last_tag);
 
@@ -222,6 +350,14 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 	}
 
 	*tag_cache = 0;
+
+	/*
+	 * Tags cached on other cpus are free as well. Waiters get here
+	 * after queueing themselves, which pairs with the waiter check in
+	 * bt_cache_put().
+	 */
+	if (bt->cache)
+		return bt_cache_steal(bt);
 	return -1;
 
 	/*
@@ -377,20 +513,18 @@ static struct bt_wait_state *bt_wake_ptr(struct blk_mq_bitmap_tags *bt)
 	return NULL;
 }
 
-static void bt_clear_tag(struct blk_mq_bitmap_tags *bt, unsigned int tag)
+/*
+ * Account one freed tag against the current wait queue, return false if
+ * nobody is waiting.
+ */
+static bool bt_wake_one(struct blk_mq_bitmap_tags *bt)
 {
-	const int index = TAG_TO_INDEX(bt, tag);
 	struct bt_wait_state *bs;
 	int wait_cnt;
 
-	clear_bit(TAG_TO_BIT(bt, tag), &bt->map[index].word);
-
-	/* Ensure that the wait list checks occur after clear_bit(). */
-	smp_mb();
-
 	bs = bt_wake_ptr(bt);
 	if (!bs)
-		return;
+		return false;
 
 	wait_cnt = atomic_dec_return(&bs->wait_cnt);
 	if (unlikely(wait_cnt < 0))
@@ -400,6 +534,117 @@ static void bt_clear_tag(struct blk_mq_bitmap_tags *bt, unsigned int tag)
 		bt_index_atomic_inc(&bt->wake_index);
 		wake_up(&bs->wait);
 	}
+
+	return true;
+}
+
+static void bt_clear_tag(struct blk_mq_bitmap_tags *bt, unsigned int tag)
+{
+	const int index = TAG_TO_INDEX(bt, tag);
+
+	clear_bit(TAG_TO_BIT(bt, tag), &bt->map[index].word);
+
+	/* Ensure that the wait list checks occur after clear_bit(). */
+	smp_mb();
+
+	bt_wake_one(bt);
+}
+
+/*
+ * Batched bt_clear_tag(): one atomic per bitmap word for each run of
+ * tags sharing that word, then the usual wakeup accounting per tag.
+ */
+static void bt_clear_tags(struct blk_mq_bitmap_tags *bt, unsigned int *tags,
+			  unsigned int nr)
+{
+	unsigned int i = 0;
+
+	while (i < nr) {
+		const int index = TAG_TO_INDEX(bt, tags[i]);
+		struct blk_align_bitmap *bm = &bt->map[index];
+		unsigned long mask = 0, old;
+
+		for (; i < nr && TAG_TO_INDEX(bt, tags[i]) == index; i++)
+			mask |= 1UL << TAG_TO_BIT(bt, tags[i]);
+
+		do {
+			old = READ_ONCE(bm->word);
+		} while (cmpxchg(&bm->word, old, old & ~mask) != old);
+	}
+
+	/* Ensure that the wait list checks occur after the clears. */
+	smp_mb();
+
+	for (i = 0; i < nr; i++)
+		if (!bt_wake_one(bt))
+			break;
+}
+
+static void bt_cache_drain(struct blk_mq_bitmap_tags *bt,
+			   struct bt_tag_cache *cache)
+{
+	unsigned int tags[BT_CACHE_MAX];
+	unsigned long flags;
+	unsigned int nr;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	nr = cache->nr;
+	memcpy(tags, cache->tags, nr * sizeof(tags[0]));
+	cache->nr = 0;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	if (nr)
+		bt_clear_tags(bt, tags, nr);
+}
+
+static void bt_cache_drain_all(struct blk_mq_bitmap_tags *bt)
+{
+	int cpu;
+
+	if (!bt->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		bt_cache_drain(bt, per_cpu_ptr(bt->cache, cpu));
+}
+
+/*
+ * Stash a freed tag on this cpu. A full cache gives its oldest batch
+ * back to the bitmap. Cached tags don't count towards waking waiters,
+ * so once somebody is waiting the whole cache is drained instead.
+ */
+static bool bt_cache_put(struct blk_mq_bitmap_tags *bt, unsigned int tag)
+{
+	unsigned int flush[BT_CACHE_MAX];
+	struct bt_tag_cache *cache;
+	unsigned long flags;
+	unsigned int nr = 0;
+
+	if (!bt->cache_size || tag >= bt->depth)
+		return false;
+
+	cache = get_cpu_ptr(bt->cache);
+	spin_lock_irqsave(&cache->lock, flags);
+	if (cache->nr >= bt->cache_size) {
+		nr = cache->nr - bt->cache_size + bt->cache_batch;
+		memcpy(flush, cache->tags, nr * sizeof(flush[0]));
+		cache->nr -= nr;
+		memmove(cache->tags, cache->tags + nr,
+			cache->nr * sizeof(cache->tags[0]));
+	}
+	cache->tags[cache->nr++] = tag;
+	spin_unlock_irqrestore(&cache->lock, flags);
+	put_cpu_ptr(bt->cache);
+
+	if (nr)
+		bt_clear_tags(bt, flush, nr);
+
+	/* Pairs with bt_cache_steal() running after prepare_to_wait(). */
+	smp_mb();
+	if (bt_wake_ptr(bt))
+		bt_cache_drain(bt, cache);
+
+	return true;
 }
 
 void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag,
@@ -411,6 +656,8 @@ void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag,
 		const int real_tag = tag - tags->nr_reserved_tags;
 
 		BUG_ON(real_tag >= tags->nr_tags);
+		if (bt_cache_put(&tags->bitmap_tags, real_tag))
+			return;
 		bt_clear_tag(&tags->bitmap_tags, real_tag);
 		if (likely(tags->alloc_policy == BLK_TAG_ALLOC_FIFO))
 			*last_tag = real_tag;
@@ -515,7 +762,26 @@ static unsigned int bt_unused_tags(struct blk_mq_bitmap_tags *bt)
 		used += bitmap_weight(&bm->word, bm->depth);
 	}
 
-	return bt->depth - used;
+	return bt->depth - used + bt_cached_tags(bt);
+}
+
+/*
+ * Cache at most a quarter of the map per cpu, so that in the common case
+ * there is plenty left in the bitmap for everybody else.
+ */
+static void bt_update_cache(struct blk_mq_bitmap_tags *bt)
+{
+	unsigned int size;
+
+	if (!bt->cache)
+		return;
+
+	size = min_t(unsigned int, BT_CACHE_MAX, bt->depth / (4 * nr_cpu_ids));
+	if (size < 2)
+		size = 0;
+
+	bt->cache_batch = size / 2;
+	bt->cache_size = size;
 }
 
 static void bt_update_count(struct blk_mq_bitmap_tags *bt,
@@ -538,6 +804,7 @@ static void bt_update_count(struct blk_mq_bitmap_tags *bt,
 		bt->wake_cnt = max(1U, depth / BT_WAIT_QUEUES);
 
 	bt->depth = depth;
+	bt_update_cache(bt);
 }
 
 static int bt_alloc(struct blk_mq_bitmap_tags *bt, unsigned int depth,
@@ -595,8 +862,23 @@ static int bt_alloc(struct blk_mq_bitmap_tags *bt, unsigned int depth,
 	return 0;
 }
 
+static void bt_alloc_cache(struct blk_mq_bitmap_tags *bt)
+{
+	int cpu;
+
+	bt->cache = alloc_percpu(struct bt_tag_cache);
+	if (!bt->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(bt->cache, cpu)->lock);
+
+	bt_update_cache(bt);
+}
+
 static void bt_free(struct blk_mq_bitmap_tags *bt)
 {
+	free_percpu(bt->cache);
 	kfree(bt->map);
 	kfree(bt->bs);
 }
@@ -613,6 +895,13 @@ static struct blk_mq_tags *blk_mq_init_bitmap_tags(struct blk_mq_tags *tags,
 	if (bt_alloc(&tags->breserved_tags, tags->nr_reserved_tags, node, true))
 		goto enomem;
 
+	/*
+	 * Round robin allocation relies on walking the bitmap in order, a
+	 * cache failing to allocate just means going without one.
+	 */
+	if (alloc_policy == BLK_TAG_ALLOC_FIFO)
+		bt_alloc_cache(&tags->bitmap_tags);
+
 	return tags;
 enomem:
 	bt_free(&tags->bitmap_tags);
@@ -672,6 +961,7 @@ int blk_mq_tag_update_depth(struct blk_mq_tags *tags, unsigned int tdepth)
 	 * static and should never need resizing.
 	 */
 	bt_update_count(&tags->bitmap_tags, tdepth);
+	bt_cache_drain_all(&tags->bitmap_tags);
 	blk_mq_tag_wakeup_all(tags, false);
 	return 0;
 }
@@ -721,6 +1011,9 @@ ssize_t blk_mq_tag_sysfs_show(struct blk_mq_tags *tags, char *page)
 	res = bt_unused_tags(&tags->breserved_tags);
 
 	page += sprintf(page, "nr_free=%u, nr_reserved=%u\n", free, res);
+	page += sprintf(page, "cache_size=%u, nr_cached=%u\n",
+			tags->bitmap_tags.cache_size,
+			bt_cached_tags(&tags->bitmap_tags));
 	page += sprintf(page, "active_queues=%u\n", atomic_read(&tags->active_queues));
 
 	return page - orig_page;
@@ -6,6 +6,7 @@
 enum {
 	BT_WAIT_QUEUES	= 8,
 	BT_WAIT_BATCH	= 8,
+	BT_CACHE_MAX	= 16,
 };
 
 struct bt_wait_state {
@@ -13,6 +14,17 @@ struct bt_wait_state {
 	wait_queue_head_t wait;
 } ____cacheline_aligned_in_smp;
 
+/*
+ * Per-cpu stash of free tags.  Their bits stay set in the shared bitmap,
+ * so only the owning cpu hands them out, except when the bitmap runs dry
+ * and they are stolen back.
+ */
+struct bt_tag_cache {
+	spinlock_t lock;
+	unsigned int nr;
+	unsigned int tags[BT_CACHE_MAX];
+} ____cacheline_aligned_in_smp;
+
 #define TAG_TO_INDEX(bt, tag)	((tag) >> (bt)->bits_per_word)
 #define TAG_TO_BIT(bt, tag)	((tag) & ((1 << (bt)->bits_per_word) - 1))
 
@@ -26,6 +38,10 @@ struct blk_mq_bitmap_tags {
 
 	atomic_t wake_index;
 	struct bt_wait_state *bs;
+
+	unsigned int cache_size;	/* 0 if caching is off */
+	unsigned int cache_batch;
+	struct bt_tag_cache __percpu *cache;
 };
 
 /*
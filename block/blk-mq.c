@@ -395,6 +395,16 @@ int blk_mq_request_started(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(blk_mq_request_started);
 
+/*
+ * blk-mq leaves rq->cpu at -1; the submitting CPU lives in the software
+ * queue the request was allocated from.
+ */
+int blk_mq_rq_cpu(struct request *rq)
+{
+	return rq->mq_ctx->cpu;
+}
+EXPORT_SYMBOL_GPL(blk_mq_rq_cpu);
+
 void blk_mq_start_request(struct request *rq)
 {
 	struct request_queue *q = rq->q;
@@ -747,7 +757,7 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	LIST_HEAD(rq_list);
 	LIST_HEAD(driver_list);
 	struct list_head *dptr;
-	int queued;
+	int queued, ret = BLK_MQ_RQ_QUEUE_OK;
 
 	WARN_ON(!cpumask_test_cpu(raw_smp_processor_id(), hctx->cpumask));
 
@@ -784,7 +794,6 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	queued = 0;
 	while (!list_empty(&rq_list)) {
 		struct blk_mq_queue_data bd;
-		int ret;
 
 		rq = list_first_entry(&rq_list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
@@ -821,6 +830,14 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 			dptr = &driver_list;
 	}
 
+	/*
+	 * If we stopped early, the last request handed to the driver was
+	 * not flagged as the last one. Let the driver kick off whatever it
+	 * has batched up so far.
+	 */
+	if (queued && ret != BLK_MQ_RQ_QUEUE_OK && q->mq_ops->commit_rqs)
+		q->mq_ops->commit_rqs(hctx);
+
 	if (!queued)
 		hctx->dispatched[0]++;
 	else if (queued < (1 << (BLK_MQ_MAX_DISPATCH_ORDER - 1)))
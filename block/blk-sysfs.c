@@ -480,6 +480,44 @@ static struct queue_sysfs_entry queue_poll_entry = {
 	.store = queue_poll_store,
 };
 
+#ifdef CONFIG_BLK_DEV_LATENCY_STATS
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_latency_enable_show,
+	.store = blk_latency_enable_store,
+};
+
+static struct queue_sysfs_entry queue_latency_read_entry = {
+	.attr = {.name = "latency_hist_read", .mode = S_IRUGO },
+	.show = blk_latency_read_show,
+};
+
+static struct queue_sysfs_entry queue_latency_write_entry = {
+	.attr = {.name = "latency_hist_write", .mode = S_IRUGO },
+	.show = blk_latency_write_show,
+};
+
+static struct queue_sysfs_entry queue_latency_flush_entry = {
+	.attr = {.name = "latency_hist_flush", .mode = S_IRUGO },
+	.show = blk_latency_flush_show,
+};
+
+static struct queue_sysfs_entry queue_latency_discard_entry = {
+	.attr = {.name = "latency_hist_discard", .mode = S_IRUGO },
+	.show = blk_latency_discard_show,
+};
+
+static struct queue_sysfs_entry queue_depth_hist_entry = {
+	.attr = {.name = "depth_hist", .mode = S_IRUGO },
+	.show = blk_latency_depth_show,
+};
+
+static struct queue_sysfs_entry queue_depth_samples_entry = {
+	.attr = {.name = "depth_samples", .mode = S_IRUGO },
+	.show = blk_latency_depth_samples_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -505,6 +543,15 @@ static struct attribute *default_attrs[] = {
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
 	&queue_poll_entry.attr,
+#ifdef CONFIG_BLK_DEV_LATENCY_STATS
+	&queue_latency_hist_entry.attr,
+	&queue_latency_read_entry.attr,
+	&queue_latency_write_entry.attr,
+	&queue_latency_flush_entry.attr,
+	&queue_latency_discard_entry.attr,
+	&queue_depth_hist_entry.attr,
+	&queue_depth_samples_entry.attr,
+#endif
 	NULL,
 };
 
@@ -600,6 +647,7 @@ static void blk_release_queue(struct kobject *kobj)
 		blk_mq_release(q);
 
 	blk_trace_shutdown(q);
+	blk_latency_exit(q);
 
 	if (q->bio_split)
 		bioset_free(q->bio_split);
@@ -643,6 +691,9 @@ int blk_register_queue(struct gendisk *disk)
 		blk_queue_bypass_end(q);
 	}
 
+	/* latency statistics are best effort, carry on without them */
+	blk_latency_init(q);
+
 	ret = blk_trace_init_sysfs(dev);
 	if (ret)
 		return ret;
@@ -310,4 +310,36 @@ static inline int blk_throtl_init(struct request_queue *q) { return 0; }
 static inline void blk_throtl_exit(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Internal latency statistics interface
+ */
+#ifdef CONFIG_BLK_DEV_LATENCY_STATS
+extern void blk_latency_io_start(int cpu, struct request *rq);
+extern void blk_latency_io_done(int cpu, struct request *rq);
+extern int blk_latency_init(struct request_queue *q);
+extern void blk_latency_exit(struct request_queue *q);
+extern ssize_t blk_latency_enable_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_enable_store(struct request_queue *q,
+					const char *page, size_t count);
+extern ssize_t blk_latency_read_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_write_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_flush_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_discard_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_depth_show(struct request_queue *q, char *page);
+extern ssize_t blk_latency_depth_samples_show(struct request_queue *q,
+					      char *page);
+
+static inline void blk_latency_io_bytes(struct request *rq, unsigned int bytes)
+{
+	rq->lat_bytes += bytes;
+}
+#else /* CONFIG_BLK_DEV_LATENCY_STATS */
+static inline void blk_latency_io_start(int cpu, struct request *rq) { }
+static inline void blk_latency_io_done(int cpu, struct request *rq) { }
+static inline int blk_latency_init(struct request_queue *q) { return 0; }
+static inline void blk_latency_exit(struct request_queue *q) { }
+static inline void blk_latency_io_bytes(struct request *rq,
+					unsigned int bytes) { }
+#endif /* CONFIG_BLK_DEV_LATENCY_STATS */
+
 #endif /* BLK_INTERNAL_H */
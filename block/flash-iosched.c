@@ -0,0 +1,635 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  A scheduler for flash storage with deep command queues.  Requests are
+ *  split in three classes, foreground sync, background sync and async:
+ *
+ *  - classes are served in bounded batches, foreground sync first, without
+ *    sorting and without ever idling the queue;
+ *  - every class has a FIFO expiry, expired requests are dispatched first;
+ *  - foreground reads have a latency target, taken from the blkio cgroup
+ *    of the submitter (blkio.flash.read_target_us) or the read_target_us
+ *    tunable.  When a read completes later than its target, the number of
+ *    async requests allowed in the device is cut to async_throttled_depth
+ *    for throttle_window milliseconds;
+ *  - requests of cgroups with blkio.background (or its alias
+ *    blkio.flash.background) set, and of tasks in the idle I/O priority
+ *    class, are background.
+ *
+ *  Completion latency histograms of each class are in the fg_sync_lat,
+ *  bg_sync_lat and async_lat attributes.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/blk-cgroup.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/ioprio.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+
+enum {
+	FLASH_SYNC_FG,
+	FLASH_SYNC_BG,
+	FLASH_ASYNC,
+	FLASH_NR_CLASSES
+};
+
+static const int fg_expire = HZ / 10;	/* max time before a foreground sync
+					   request is submitted */
+static const int bg_expire = HZ / 2;	/* ditto for background sync */
+static const int async_expire = 5 * HZ;	/* and for async, these limits are SOFT! */
+static const int fg_batch = 16;		/* # of requests dispatched in a row */
+static const int bg_batch = 4;
+static const int async_batch = 4;
+static const int read_target_us = 2000;	/* foreground read latency target */
+static const int throttle_window = HZ / 10; /* async throttling after a miss */
+static const int async_depth;		/* async requests in the device, 0 = any */
+static const int async_throttled_depth = 2; /* ditto while throttled */
+
+/*
+ * Upper bounds of the latency histogram buckets, the last bucket counts
+ * everything above.
+ */
+static const unsigned int flash_lat_bounds_us[] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000
+};
+#define FLASH_LAT_BUCKETS	(ARRAY_SIZE(flash_lat_bounds_us) + 1)
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+	struct list_head fifo_list[FLASH_NR_CLASSES];
+
+	unsigned int cur_class;		/* class of the current batch */
+	unsigned int batching;		/* requests dispatched in the batch */
+	unsigned int async_inflight;	/* async requests in the device */
+	unsigned long throttle_until;	/* jiffies, async throttled until then */
+
+	unsigned long lat_hist[FLASH_NR_CLASSES][FLASH_LAT_BUCKETS];
+	unsigned long target_misses;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_NR_CLASSES];
+	int fifo_batch[FLASH_NR_CLASSES];
+	int read_target_us;
+	int throttle_window;
+	int async_depth;
+	int async_throttled_depth;
+};
+
+/*
+ * rq->elv.priv[0] holds the class and the read latency target of the
+ * request, rq->elv.priv[1] the time it was queued in ns.
+ */
+#define FLASH_CLASS_BITS	2
+#define FLASH_CLASS_MASK	((1UL << FLASH_CLASS_BITS) - 1)
+
+static inline unsigned int flash_rq_class(struct request *rq)
+{
+	return (unsigned long)rq->elv.priv[0] & FLASH_CLASS_MASK;
+}
+
+static inline unsigned int flash_rq_target_us(struct request *rq)
+{
+	return (unsigned long)rq->elv.priv[0] >> FLASH_CLASS_BITS;
+}
+
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Per blkio cgroup settings.
+ */
+struct flash_cgroup_data {
+	struct blkcg_policy_data cpd;
+	unsigned int read_target_us;	/* 0: use the elevator's */
+};
+
+enum {
+	FLASH_CFT_READ_TARGET,
+	FLASH_CFT_BACKGROUND,
+};
+
+static struct blkcg_policy blkcg_policy_flash;
+
+static inline struct flash_cgroup_data *
+cpd_to_flashcd(struct blkcg_policy_data *cpd)
+{
+	return cpd ? container_of(cpd, struct flash_cgroup_data, cpd) : NULL;
+}
+
+static inline struct flash_cgroup_data *blkcg_to_flashcd(struct blkcg *blkcg)
+{
+	return cpd_to_flashcd(blkcg_to_cpd(blkcg, &blkcg_policy_flash));
+}
+
+static struct blkcg_policy_data *flash_cpd_alloc(gfp_t gfp)
+{
+	struct flash_cgroup_data *fcd;
+
+	fcd = kzalloc(sizeof(*fcd), gfp);
+	if (!fcd)
+		return NULL;
+	return &fcd->cpd;
+}
+
+static void flash_cpd_init(struct blkcg_policy_data *cpd)
+{
+}
+
+static void flash_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(cpd_to_flashcd(cpd));
+}
+
+static u64 flash_cgroup_read(struct cgroup_subsys_state *css,
+			     struct cftype *cft)
+{
+	struct blkcg *blkcg = css_to_blkcg(css);
+	struct flash_cgroup_data *fcd = blkcg_to_flashcd(blkcg);
+
+	/* flash.background is an alias of blkio.background */
+	if (cft->private == FLASH_CFT_BACKGROUND)
+		return blkcg->background;
+	return fcd ? fcd->read_target_us : 0;
+}
+
+static int flash_cgroup_write(struct cgroup_subsys_state *css,
+			      struct cftype *cft, u64 val)
+{
+	struct blkcg *blkcg = css_to_blkcg(css);
+	struct flash_cgroup_data *fcd = blkcg_to_flashcd(blkcg);
+
+	if (cft->private == FLASH_CFT_BACKGROUND) {
+		ACCESS_ONCE(blkcg->background) = !!val;
+		return 0;
+	}
+
+	if (!fcd)
+		return -EINVAL;
+	if (val > (UINT_MAX >> FLASH_CLASS_BITS))
+		return -ERANGE;
+	ACCESS_ONCE(fcd->read_target_us) = val;
+	return 0;
+}
+
+static struct cftype flash_blkcg_legacy_files[] = {
+	{
+		.name = "flash.read_target_us",
+		.private = FLASH_CFT_READ_TARGET,
+		.read_u64 = flash_cgroup_read,
+		.write_u64 = flash_cgroup_write,
+	},
+	{
+		.name = "flash.background",
+		.private = FLASH_CFT_BACKGROUND,
+		.read_u64 = flash_cgroup_read,
+		.write_u64 = flash_cgroup_write,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_flash = {
+	.legacy_cftypes		= flash_blkcg_legacy_files,
+
+	.cpd_alloc_fn		= flash_cpd_alloc,
+	.cpd_init_fn		= flash_cpd_init,
+	.cpd_free_fn		= flash_cpd_free,
+};
+
+static struct blkcg *flash_rq_blkcg(struct request *rq)
+{
+	struct request_list *rl = blk_rq_rl(rq);
+
+	if (!rl || !rl->blkg)
+		return NULL;
+	return rl->blkg->blkcg;
+}
+#endif	/* CONFIG_BLK_CGROUP */
+
+/*
+ * Pick the class and the read latency target of a new request.
+ */
+static void flash_classify_request(struct request *rq)
+{
+	unsigned int class = FLASH_SYNC_FG, target_us = 0;
+#ifdef CONFIG_BLK_CGROUP
+	struct blkcg *blkcg = flash_rq_blkcg(rq);
+	struct flash_cgroup_data *fcd = blkcg_to_flashcd(blkcg);
+
+	if (fcd)
+		target_us = ACCESS_ONCE(fcd->read_target_us);
+	if (blkcg && ACCESS_ONCE(blkcg->background))
+		class = FLASH_SYNC_BG;
+#endif
+
+	if (!rq_is_sync(rq))
+		class = FLASH_ASYNC;
+	else if (IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) == IOPRIO_CLASS_IDLE)
+		class = FLASH_SYNC_BG;
+
+	rq->elv.priv[0] = (void *)((unsigned long)target_us << FLASH_CLASS_BITS |
+				   class);
+	rq->elv.priv[1] = (void *)(unsigned long)ktime_get_ns();
+}
+
+/*
+ * add rq to the fifo of its class
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned int class;
+
+	flash_classify_request(rq);
+	class = flash_rq_class(rq);
+
+	rq->fifo_time = jiffies + fd->fifo_expire[class];
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class]);
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    flash_rq_class(req) == flash_rq_class(next)) {
+		if (time_before(next->fifo_time, req->fifo_time)) {
+			list_move(&req->queuelist, &next->queuelist);
+			req->fifo_time = next->fifo_time;
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	rq_fifo_clear(next);
+}
+
+/*
+ * flash_check_fifo returns 1 if the oldest request of the class has
+ * expired.  Requires !list_empty(&fd->fifo_list[class])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, unsigned int class)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[class].next);
+
+	return time_after_eq(jiffies, rq->fifo_time);
+}
+
+/*
+ * Async requests are limited in number while the device is in flight,
+ * more so when a foreground read has recently missed its target.
+ */
+static bool flash_may_dispatch(struct flash_data *fd, unsigned int class,
+			       int force)
+{
+	int depth;
+
+	if (list_empty(&fd->fifo_list[class]))
+		return false;
+
+	if (class != FLASH_ASYNC || force)
+		return true;
+
+	depth = fd->async_depth;
+	if (time_before(jiffies, fd->throttle_until) &&
+	    !flash_check_fifo(fd, class) &&
+	    (!depth || fd->async_throttled_depth < depth))
+		depth = fd->async_throttled_depth;
+
+	return !depth || fd->async_inflight < depth;
+}
+
+/*
+ * flash_dispatch_requests selects the next request: expired requests first,
+ * then the current batch, then a new batch.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+	unsigned int class, i;
+
+	for (class = 0; class < FLASH_NR_CLASSES; class++)
+		if (!list_empty(&fd->fifo_list[class]) &&
+		    flash_check_fifo(fd, class) &&
+		    flash_may_dispatch(fd, class, force))
+			goto new_batch;
+
+	class = fd->cur_class;
+	if (fd->batching < fd->fifo_batch[class] &&
+	    flash_may_dispatch(fd, class, force))
+		goto dispatch_request;
+
+	/*
+	 * The current class used up its batch: hand the next batch to the
+	 * classes after it in turn.  If it simply ran out of requests, start
+	 * over from the most important class.
+	 */
+	for (i = 0; i < FLASH_NR_CLASSES; i++) {
+		if (fd->batching >= fd->fifo_batch[fd->cur_class])
+			class = (fd->cur_class + 1 + i) % FLASH_NR_CLASSES;
+		else
+			class = i;
+
+		if (flash_may_dispatch(fd, class, force))
+			goto new_batch;
+	}
+
+	return 0;
+
+new_batch:
+	fd->cur_class = class;
+	fd->batching = 0;
+
+dispatch_request:
+	rq = rq_entry_fifo(fd->fifo_list[class].next);
+
+	fd->batching++;
+	if (class == FLASH_ASYNC)
+		fd->async_inflight++;
+
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(q, rq);
+
+	return 1;
+}
+
+static unsigned int flash_lat_bucket(u64 lat_us)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(flash_lat_bounds_us); i++)
+		if (lat_us <= flash_lat_bounds_us[i])
+			break;
+	return i;
+}
+
+static void flash_completed_request(struct request_queue *q,
+				    struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned int class = flash_rq_class(rq);
+	unsigned int target_us;
+	unsigned long lat_ns;
+	u64 lat_us;
+
+	/* queued in ns, wraps are harmless for anything short of seconds */
+	lat_ns = (unsigned long)ktime_get_ns() -
+		 (unsigned long)rq->elv.priv[1];
+	lat_us = lat_ns / NSEC_PER_USEC;
+
+	fd->lat_hist[class][flash_lat_bucket(lat_us)]++;
+
+	if (class == FLASH_ASYNC) {
+		if (fd->async_inflight)
+			fd->async_inflight--;
+		return;
+	}
+
+	if (class != FLASH_SYNC_FG || rq_data_dir(rq) != READ)
+		return;
+
+	target_us = flash_rq_target_us(rq);
+	if (!target_us)
+		target_us = fd->read_target_us;
+	if (target_us && lat_us > target_us) {
+		fd->target_misses++;
+		fd->throttle_until = jiffies + fd->throttle_window;
+	}
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	unsigned int class;
+
+	for (class = 0; class < FLASH_NR_CLASSES; class++)
+		BUG_ON(!list_empty(&fd->fifo_list[class]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static int flash_init_queue(struct request_queue *q, struct elevator_type *e)
+{
+	struct flash_data *fd;
+	struct elevator_queue *eq;
+	unsigned int class;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	fd = kzalloc_node(sizeof(*fd), GFP_KERNEL, q->node);
+	if (!fd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+	eq->elevator_data = fd;
+
+	for (class = 0; class < FLASH_NR_CLASSES; class++)
+		INIT_LIST_HEAD(&fd->fifo_list[class]);
+	fd->fifo_expire[FLASH_SYNC_FG] = fg_expire;
+	fd->fifo_expire[FLASH_SYNC_BG] = bg_expire;
+	fd->fifo_expire[FLASH_ASYNC] = async_expire;
+	fd->fifo_batch[FLASH_SYNC_FG] = fg_batch;
+	fd->fifo_batch[FLASH_SYNC_BG] = bg_batch;
+	fd->fifo_batch[FLASH_ASYNC] = async_batch;
+	fd->read_target_us = read_target_us;
+	fd->throttle_window = throttle_window;
+	fd->async_depth = async_depth;
+	fd->async_throttled_depth = async_throttled_depth;
+	fd->throttle_until = jiffies;
+
+	spin_lock_irq(q->queue_lock);
+	q->elevator = eq;
+	spin_unlock_irq(q->queue_lock);
+	return 0;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static void
+flash_var_store(int *var, const char *page)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_fg_expire_show, fd->fifo_expire[FLASH_SYNC_FG], 1);
+SHOW_FUNCTION(flash_bg_expire_show, fd->fifo_expire[FLASH_SYNC_BG], 1);
+SHOW_FUNCTION(flash_async_expire_show, fd->fifo_expire[FLASH_ASYNC], 1);
+SHOW_FUNCTION(flash_fg_batch_show, fd->fifo_batch[FLASH_SYNC_FG], 0);
+SHOW_FUNCTION(flash_bg_batch_show, fd->fifo_batch[FLASH_SYNC_BG], 0);
+SHOW_FUNCTION(flash_async_batch_show, fd->fifo_batch[FLASH_ASYNC], 0);
+SHOW_FUNCTION(flash_read_target_us_show, fd->read_target_us, 0);
+SHOW_FUNCTION(flash_throttle_window_show, fd->throttle_window, 1);
+SHOW_FUNCTION(flash_async_depth_show, fd->async_depth, 0);
+SHOW_FUNCTION(flash_async_throttled_depth_show, fd->async_throttled_depth, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	flash_var_store(&__data, (page));				\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return count;							\
+}
+STORE_FUNCTION(flash_fg_expire_store, &fd->fifo_expire[FLASH_SYNC_FG], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_bg_expire_store, &fd->fifo_expire[FLASH_SYNC_BG], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_expire_store, &fd->fifo_expire[FLASH_ASYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_fg_batch_store, &fd->fifo_batch[FLASH_SYNC_FG], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_bg_batch_store, &fd->fifo_batch[FLASH_SYNC_BG], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_async_batch_store, &fd->fifo_batch[FLASH_ASYNC], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_read_target_us_store, &fd->read_target_us, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_throttle_window_store, &fd->throttle_window, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_depth_store, &fd->async_depth, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_async_throttled_depth_store, &fd->async_throttled_depth, 1, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_lat_show(struct flash_data *fd, unsigned int class,
+			      char *page)
+{
+	ssize_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(flash_lat_bounds_us); i++)
+		len += sprintf(page + len, "<=%uus %lu\n", flash_lat_bounds_us[i],
+			       fd->lat_hist[class][i]);
+	len += sprintf(page + len, ">%uus %lu\n", flash_lat_bounds_us[i - 1],
+		       fd->lat_hist[class][i]);
+	return len;
+}
+
+#define LAT_SHOW_FUNCTION(__FUNC, __CLASS)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	return flash_lat_show(e->elevator_data, __CLASS, page);		\
+}
+LAT_SHOW_FUNCTION(flash_fg_sync_lat_show, FLASH_SYNC_FG);
+LAT_SHOW_FUNCTION(flash_bg_sync_lat_show, FLASH_SYNC_BG);
+LAT_SHOW_FUNCTION(flash_async_lat_show, FLASH_ASYNC);
+#undef LAT_SHOW_FUNCTION
+
+static ssize_t flash_target_misses_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	return sprintf(page, "%lu\n", fd->target_misses);
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+#define FD_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, flash_##name##_show, NULL)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(fg_expire),
+	FD_ATTR(bg_expire),
+	FD_ATTR(async_expire),
+	FD_ATTR(fg_batch),
+	FD_ATTR(bg_batch),
+	FD_ATTR(async_batch),
+	FD_ATTR(read_target_us),
+	FD_ATTR(throttle_window),
+	FD_ATTR(async_depth),
+	FD_ATTR(async_throttled_depth),
+	FD_ATTR_RO(fg_sync_lat),
+	FD_ATTR_RO(bg_sync_lat),
+	FD_ATTR_RO(async_lat),
+	FD_ATTR_RO(target_misses),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	int ret;
+
+#ifdef CONFIG_BLK_CGROUP
+	ret = blkcg_policy_register(&blkcg_policy_flash);
+	if (ret)
+		return ret;
+#endif
+
+	ret = elv_register(&iosched_flash);
+	if (ret) {
+#ifdef CONFIG_BLK_CGROUP
+		blkcg_policy_unregister(&blkcg_policy_flash);
+#endif
+		return ret;
+	}
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+#ifdef CONFIG_BLK_CGROUP
+	blkcg_policy_unregister(&blkcg_policy_flash);
+#endif
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -15,6 +15,10 @@
  * Each test is exposed via debugfs and can be triggered by writing to
  * the debugfs file.
  *
+ * A device independent benchmark mode runs built-in workloads and reports
+ * per request class latency percentiles and IOPS under the bench/
+ * debugfs directory.
+ *
  */
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt"\n"
 
@@ -28,6 +32,13 @@
 #include <linux/debugfs.h>
 #include <linux/test-iosched.h>
 #include <linux/delay.h>
+#include <linux/genhd.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include "blk.h"
 
 #define MODULE_NAME "test-iosched"
@@ -140,6 +151,7 @@ static void end_test_req(struct request *rq, int err)
 	pr_debug("%s: request %d completed, err=%d",
 	       __func__, test_rq->req_id, err);
 
+	test_rq->complete_time = ktime_get();
 	test_rq->req_completed = true;
 	test_rq->req_result = err;
 
@@ -872,6 +884,519 @@ void test_iosched_set_ignore_round(struct test_iosched *tios,
 }
 EXPORT_SYMBOL(test_iosched_set_ignore_round);
 
+/*
+ * Benchmark mode
+ *
+ * Writing a workload name to bench/run queues bench/nr_requests requests
+ * of that workload (capped to the queue's nr_requests, as all of them are
+ * allocated up front), lets the device drain them and repeats this for
+ * bench/rounds rounds. The latency of every request, from dispatch to
+ * completion, is then reported per class in bench/results together with
+ * the achieved IOPS and throughput.
+ *
+ * The benchmark writes to the area selected by utils/start_sector and
+ * utils/sector_range, which must not hold any data of value.
+ */
+#define BENCH_DEFAULT_REQS		256
+#define BENCH_DEFAULT_ROUNDS		8
+#define BENCH_MAX_ROUNDS		64
+#define BENCH_DEFAULT_RANGE		(1024 * 1024 * 2)	/* 1GB */
+#define BENCH_MAX_PAGES			(SZ_512K / PAGE_SIZE)
+
+enum bench_class {
+	BENCH_READ,
+	BENCH_WRITE,
+	BENCH_SYNC_WRITE,
+	BENCH_FLUSH,
+	BENCH_NR_CLASSES,
+};
+
+static const char * const bench_class_str[BENCH_NR_CLASSES] = {
+	[BENCH_READ]		= "read",
+	[BENCH_WRITE]		= "write",
+	[BENCH_SYNC_WRITE]	= "sync-write",
+	[BENCH_FLUSH]		= "flush",
+};
+
+enum bench_workload {
+	BENCH_MIXED,
+	BENCH_RANDOM_4K,
+	BENCH_SEQ_512K,
+	BENCH_FSYNC_STORM,
+	BENCH_NR_WORKLOADS,
+};
+
+static const char * const bench_workload_str[BENCH_NR_WORKLOADS] = {
+	[BENCH_MIXED]		= "mixed",
+	[BENCH_RANDOM_4K]	= "random-4k",
+	[BENCH_SEQ_512K]	= "seq-512k",
+	[BENCH_FSYNC_STORM]	= "fsync-storm",
+};
+
+struct test_bench {
+	struct mutex lock;		/* one benchmark at a time */
+	u32 nr_requests;
+	u32 rounds;
+	void *pages[BENCH_MAX_PAGES];	/* shared by all requests */
+	sector_t next_seq;
+
+	/* accumulated over the rounds of the current run */
+	u32 *lat_us[BENCH_NR_CLASSES];
+	unsigned int lat_nr[BENCH_NR_CLASSES];
+	unsigned int lat_max;
+	u64 duration_us;
+	u64 bytes;
+	int errors;
+
+	char *results;
+	size_t results_len;
+};
+
+static char *bench_get_test_case_str(int testcase)
+{
+	if (testcase < 0 || testcase >= BENCH_NR_WORKLOADS)
+		return "Unknown benchmark";
+	return (char *)bench_workload_str[testcase];
+}
+
+static u32 bench_range(struct test_iosched *tios)
+{
+	return tios->sector_range ? tios->sector_range : BENCH_DEFAULT_RANGE;
+}
+
+static sector_t bench_random_sector(struct test_iosched *tios,
+				    unsigned int bytes)
+{
+	u32 slots = max_t(u32, bench_range(tios) / (bytes >> 9), 1);
+
+	return tios->start_sector + (sector_t)prandom_u32_max(slots) *
+		(bytes >> 9);
+}
+
+static sector_t bench_seq_sector(struct test_iosched *tios,
+				 struct test_bench *b, unsigned int bytes)
+{
+	sector_t sector;
+
+	if (b->next_seq + (bytes >> 9) > bench_range(tios))
+		b->next_seq = 0;
+	sector = tios->start_sector + b->next_seq;
+	b->next_seq += bytes >> 9;
+	return sector;
+}
+
+/*
+ * Like test_iosched_create_test_req(), but mapping the benchmark's shared
+ * pages instead of allocating data buffers for every request.
+ */
+static int bench_add_req(struct test_iosched *tios, struct test_bench *b,
+			 int rw_flags, sector_t sector, unsigned int bytes)
+{
+	struct request_queue *q = tios->req_q;
+	struct test_request *test_rq;
+	struct request *rq;
+	struct bio *bio;
+	unsigned long flags;
+	int i, ret;
+
+	rq = blk_get_request(q, rw_flags, GFP_KERNEL);
+	if (IS_ERR_OR_NULL(rq)) {
+		pr_err("%s: Failed to allocate a request", __func__);
+		return -ENOMEM;
+	}
+
+	test_rq = kzalloc(sizeof(*test_rq), GFP_KERNEL);
+	if (!test_rq) {
+		blk_put_request(rq);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < bytes / PAGE_SIZE; i++) {
+		ret = blk_rq_map_kern(q, rq, b->pages[i], PAGE_SIZE,
+				      GFP_KERNEL);
+		if (ret) {
+			pr_err("%s: blk_rq_map_kern returned error %d",
+			       __func__, ret);
+			kfree(test_rq);
+			blk_put_request(rq);
+			return ret;
+		}
+	}
+
+	rq->end_io = end_test_req;
+	rq->__sector = sector;
+	rq->cmd_type |= REQ_TYPE_FS;
+	rq->cmd_flags |= REQ_SORTED;
+	rq->cmd_flags &= ~REQ_IO_STAT;
+	rq->rq_disk = dev_to_disk(kobj_to_dev(q->kobj.parent));
+
+	for (bio = rq->bio; bio; bio = bio->bi_next) {
+		bio->bi_end_io = end_test_bio;
+		if (bio == rq->bio)
+			bio->bi_iter.bi_sector = sector;
+	}
+
+	test_rq->buf_size = bytes;
+	test_rq->wr_rd_data_pattern = TEST_NO_PATTERN;
+	test_rq->req_id = tios->wr_rd_next_req_id++;
+	test_rq->req_result = -EINVAL;
+	test_rq->rq = rq;
+	rq->elv.priv[0] = test_rq;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	list_add_tail(&test_rq->queuelist, &tios->test_queue);
+	tios->test_count++;
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return 0;
+}
+
+static int bench_prepare_test(struct test_iosched *tios)
+{
+	struct test_bench *b = tios->bench;
+	unsigned int max_bytes, seq_bytes, nr;
+	int i, ret = 0;
+
+	nr = b->nr_requests;
+	max_bytes = min_t(unsigned int, SZ_512K,
+			  queue_max_sectors(tios->req_q) << 9);
+	max_bytes = max_t(unsigned int, round_down(max_bytes, PAGE_SIZE),
+			  PAGE_SIZE);
+
+	for (i = 0; i < nr && !ret; i++) {
+		switch (tios->test_info.testcase) {
+		case BENCH_MIXED:
+			/* a sync 4K reader competing with a buffered flood */
+			seq_bytes = min_t(unsigned int, SZ_128K, max_bytes);
+			if (i % 8 == 0)
+				ret = bench_add_req(tios, b, READ,
+					bench_random_sector(tios, SZ_4K),
+					SZ_4K);
+			else
+				ret = bench_add_req(tios, b, WRITE,
+					bench_seq_sector(tios, b, seq_bytes),
+					seq_bytes);
+			break;
+		case BENCH_RANDOM_4K:
+			ret = bench_add_req(tios, b,
+				i % 3 == 2 ? WRITE_SYNC : READ,
+				bench_random_sector(tios, SZ_4K), SZ_4K);
+			break;
+		case BENCH_SEQ_512K:
+			ret = bench_add_req(tios, b, i < nr / 2 ? READ : WRITE,
+				bench_seq_sector(tios, b, max_bytes),
+				max_bytes);
+			break;
+		case BENCH_FSYNC_STORM:
+			/* small sync appends, each followed by a cache flush */
+			if (i % 2 == 0)
+				ret = bench_add_req(tios, b, WRITE_SYNC,
+					bench_seq_sector(tios, b, SZ_4K),
+					SZ_4K);
+			else
+				ret = test_iosched_add_unique_test_req(tios, 0,
+					REQ_UNIQUE_FLUSH, 0, 0, NULL);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+static enum bench_class bench_req_class(struct request *rq)
+{
+	if (rq->cmd_flags & REQ_FLUSH)
+		return BENCH_FLUSH;
+	if (rq_data_dir(rq) == READ)
+		return BENCH_READ;
+	return rq_is_sync(rq) ? BENCH_SYNC_WRITE : BENCH_WRITE;
+}
+
+/* Collect the latencies of this round, every one counts as a pass. */
+static int bench_check_test_result(struct test_iosched *tios)
+{
+	struct test_bench *b = tios->bench;
+	struct test_request *trq;
+
+	list_for_each_entry(trq, &tios->dispatched_queue, queuelist) {
+		enum bench_class class;
+
+		if (!trq->rq || !trq->req_completed)
+			continue;
+		if (trq->req_result < 0) {
+			b->errors++;
+			continue;
+		}
+
+		class = bench_req_class(trq->rq);
+		if (b->lat_nr[class] < b->lat_max)
+			b->lat_us[class][b->lat_nr[class]++] =
+				ktime_us_delta(trq->complete_time,
+					       trq->issue_time);
+		b->bytes += trq->buf_size;
+	}
+	b->duration_us += ktime_to_us(tios->test_info.test_duration);
+
+	return 0;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 bench_percentile(u32 *lat, unsigned int nr, unsigned int permille)
+{
+	return lat[div_u64((u64)(nr - 1) * permille, 1000)];
+}
+
+static void bench_report(struct test_iosched *tios, int workload)
+{
+	struct test_bench *b = tios->bench;
+	unsigned int total = 0;
+	size_t len = 0;
+	int c;
+
+	for (c = 0; c < BENCH_NR_CLASSES; c++)
+		total += b->lat_nr[c];
+
+	len += scnprintf(b->results + len, PAGE_SIZE - len,
+			 "workload %s: %u requests in %llu us, errors %d\n",
+			 bench_workload_str[workload], total, b->duration_us,
+			 b->errors);
+	if (b->duration_us)
+		len += scnprintf(b->results + len, PAGE_SIZE - len,
+				 "iops %llu, throughput %llu KB/s\n",
+				 div64_u64((u64)total * USEC_PER_SEC,
+					   b->duration_us),
+				 div64_u64(b->bytes * USEC_PER_SEC,
+					   b->duration_us * 1024));
+
+	len += scnprintf(b->results + len, PAGE_SIZE - len,
+			 "%-12s %8s %10s %10s %10s %10s\n", "class", "count",
+			 "p50_us", "p99_us", "p999_us", "max_us");
+	for (c = 0; c < BENCH_NR_CLASSES; c++) {
+		u32 *lat = b->lat_us[c];
+		unsigned int nr = b->lat_nr[c];
+
+		if (!nr)
+			continue;
+
+		sort(lat, nr, sizeof(*lat), bench_cmp_u32, NULL);
+		len += scnprintf(b->results + len, PAGE_SIZE - len,
+				 "%-12s %8u %10u %10u %10u %10u\n",
+				 bench_class_str[c], nr,
+				 bench_percentile(lat, nr, 500),
+				 bench_percentile(lat, nr, 990),
+				 bench_percentile(lat, nr, 999), lat[nr - 1]);
+	}
+
+	b->results_len = len;
+	pr_info("%s: %s: %u requests, %llu us", __func__,
+		bench_workload_str[workload], total, b->duration_us);
+}
+
+static void bench_free_buffers(struct test_bench *b)
+{
+	int i;
+
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		vfree(b->lat_us[i]);
+		b->lat_us[i] = NULL;
+	}
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		if (b->pages[i])
+			free_page((unsigned long)b->pages[i]);
+		b->pages[i] = NULL;
+	}
+}
+
+static int bench_alloc_buffers(struct test_bench *b)
+{
+	int i;
+
+	b->lat_max = b->nr_requests * b->rounds;
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		b->lat_us[i] = vmalloc(b->lat_max * sizeof(u32));
+		if (!b->lat_us[i])
+			goto err;
+		b->lat_nr[i] = 0;
+	}
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		b->pages[i] = (void *)get_zeroed_page(GFP_KERNEL);
+		if (!b->pages[i])
+			goto err;
+	}
+	return 0;
+
+err:
+	bench_free_buffers(b);
+	return -ENOMEM;
+}
+
+static int bench_run(struct test_iosched *tios, int workload)
+{
+	struct test_bench *b = tios->bench;
+	struct test_info t_info;
+	int round, ret;
+
+	b->nr_requests = clamp_t(u32, b->nr_requests, 1,
+				 tios->req_q->nr_requests);
+	b->rounds = clamp_t(u32, b->rounds, 1, BENCH_MAX_ROUNDS);
+
+	ret = bench_alloc_buffers(b);
+	if (ret)
+		return ret;
+
+	b->next_seq = 0;
+	b->duration_us = 0;
+	b->bytes = 0;
+	b->errors = 0;
+
+	for (round = 0; round < b->rounds; round++) {
+		memset(&t_info, 0, sizeof(t_info));
+		t_info.testcase = workload;
+		t_info.data = b;
+		t_info.prepare_test_fn = bench_prepare_test;
+		t_info.check_test_result_fn = bench_check_test_result;
+		t_info.get_test_case_str_fn = bench_get_test_case_str;
+
+		ret = test_iosched_start_test(tios, &t_info);
+		if (ret) {
+			pr_err("%s: round %d failed, ret=%d", __func__,
+			       round, ret);
+			break;
+		}
+	}
+
+	if (!ret)
+		bench_report(tios, workload);
+	bench_free_buffers(b);
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct test_iosched *tios = file->private_data;
+	char name[16];
+	int workload, ret;
+
+	if (count >= sizeof(name))
+		return -EINVAL;
+	if (copy_from_user(name, buf, count))
+		return -EFAULT;
+	name[count] = '\0';
+
+	for (workload = 0; workload < BENCH_NR_WORKLOADS; workload++)
+		if (sysfs_streq(name, bench_workload_str[workload]))
+			break;
+	if (workload == BENCH_NR_WORKLOADS)
+		return -EINVAL;
+
+	mutex_lock(&tios->bench->lock);
+	ret = bench_run(tios, workload);
+	mutex_unlock(&tios->bench->lock);
+
+	return ret ? ret : count;
+}
+
+static ssize_t bench_run_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	char list[BENCH_NR_WORKLOADS * 16];
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < BENCH_NR_WORKLOADS; i++)
+		len += scnprintf(list + len, sizeof(list) - len, "%s ",
+				 bench_workload_str[i]);
+	list[len - 1] = '\n';
+
+	return simple_read_from_buffer(buf, count, ppos, list, len);
+}
+
+static const struct file_operations bench_run_fops = {
+	.open = simple_open,
+	.read = bench_run_read,
+	.write = bench_run_write,
+	.llseek = default_llseek,
+};
+
+static int bench_results_show(struct seq_file *s, void *data)
+{
+	struct test_iosched *tios = s->private;
+	struct test_bench *b = tios->bench;
+
+	mutex_lock(&b->lock);
+	if (b->results_len)
+		seq_write(s, b->results, b->results_len);
+	mutex_unlock(&b->lock);
+	return 0;
+}
+
+static int bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_results_show, inode->i_private);
+}
+
+static const struct file_operations bench_results_fops = {
+	.open = bench_results_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int test_bench_init(struct test_iosched *tios)
+{
+	struct test_bench *b;
+	struct dentry *root;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (!b)
+		return -ENOMEM;
+
+	b->results = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!b->results) {
+		kfree(b);
+		return -ENOMEM;
+	}
+	mutex_init(&b->lock);
+	b->nr_requests = BENCH_DEFAULT_REQS;
+	b->rounds = BENCH_DEFAULT_ROUNDS;
+	tios->bench = b;
+
+	root = debugfs_create_dir("bench", tios->debug.debug_root);
+	tios->debug.debug_bench_root = root;
+	if (!root ||
+	    !debugfs_create_file("run", S_IRUGO | S_IWUSR, root, tios,
+				 &bench_run_fops) ||
+	    !debugfs_create_file("results", S_IRUGO, root, tios,
+				 &bench_results_fops) ||
+	    !debugfs_create_u32("nr_requests", S_IRUGO | S_IWUSR, root,
+				&b->nr_requests) ||
+	    !debugfs_create_u32("rounds", S_IRUGO | S_IWUSR, root,
+				&b->rounds))
+		return -ENOENT;
+
+	return 0;
+}
+
+static void test_bench_exit(struct test_iosched *tios)
+{
+	if (!tios->bench)
+		return;
+
+	kfree(tios->bench->results);
+	kfree(tios->bench);
+	tios->bench = NULL;
+}
+
 static int test_debugfs_init(struct test_iosched *tios)
 {
 	char name[2*BDEVNAME_SIZE];
@@ -919,16 +1444,21 @@ static int test_debugfs_init(struct test_iosched *tios)
 	if (!tios->debug.sector_range)
 		goto err;
 
+	if (test_bench_init(tios))
+		goto err;
+
 	return 0;
 
 err:
 	debugfs_remove_recursive(tios->debug.debug_root);
+	test_bench_exit(tios);
 	return -ENOENT;
 }
 
 static void test_debugfs_cleanup(struct test_iosched *tios)
 {
 	debugfs_remove_recursive(tios->debug.debug_root);
+	test_bench_exit(tios);
 }
 
 static void print_req(struct request *req)
@@ -996,6 +1526,7 @@ static int test_dispatch_from(struct request_queue *q,
 		spin_unlock_irqrestore(&tios->lock, flags);
 
 		print_req(rq);
+		test_rq->issue_time = ktime_get();
 		elv_dispatch_sort(q, rq);
 		tios->test_info.test_byte_count += test_rq->buf_size;
 		ret = 1;
@@ -186,11 +186,27 @@ enum binder_stat_types {
 	BINDER_STAT_COUNT
 };
 
+enum binder_lock_types {
+	BINDER_LOCK_OUTER,
+	BINDER_LOCK_INNER,
+	BINDER_LOCK_NODE,
+	BINDER_LOCK_COUNT
+};
+
+enum binder_handoff_types {
+	BINDER_HANDOFF_THREAD,		/* queued to a waiting thread */
+	BINDER_HANDOFF_PROC,		/* queued to proc->todo */
+	BINDER_HANDOFF_COALESCED,	/* ditto, wakeup already pending */
+	BINDER_HANDOFF_COUNT
+};
+
 struct binder_stats {
 	atomic_t br[_IOC_NR(BR_ONEWAY_SPAM_SUSPECT) + 1];
 	atomic_t bc[_IOC_NR(BC_REPLY_SG) + 1];
 	atomic_t obj_created[BINDER_STAT_COUNT];
 	atomic_t obj_deleted[BINDER_STAT_COUNT];
+	atomic_t lock_contended[BINDER_LOCK_COUNT];
+	atomic_t handoff[BINDER_HANDOFF_COUNT];
 };
 
 static struct binder_stats binder_stats;
@@ -205,6 +221,11 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	atomic_inc(&binder_stats.obj_created[type]);
 }
 
+static inline void binder_stats_handoff(enum binder_handoff_types type)
+{
+	atomic_inc(&binder_stats.handoff[type]);
+}
+
 struct binder_transaction_log binder_transaction_log;
 struct binder_transaction_log binder_transaction_log_failed;
 
@@ -690,6 +711,27 @@ struct binder_object {
 	};
 };
 
+/*
+ * Contention is counted globally and, for the proc locks, for the proc.
+ * Only contended acquisitions touch the counters.
+ */
+static void binder_lock_contended(struct binder_proc *proc,
+				  enum binder_lock_types type)
+{
+	atomic_inc(&binder_stats.lock_contended[type]);
+	if (proc)
+		atomic_inc(&proc->stats.lock_contended[type]);
+}
+
+static void binder_node_spin_lock(struct binder_node *node)
+{
+	if (!spin_trylock(&node->lock)) {
+		/* node->proc can't be trusted without the lock */
+		binder_lock_contended(NULL, BINDER_LOCK_NODE);
+		spin_lock(&node->lock);
+	}
+}
+
 /**
  * binder_proc_lock() - Acquire outer lock for given binder_proc
  * @proc:         struct binder_proc to acquire
@@ -704,7 +746,10 @@ _binder_proc_lock(struct binder_proc *proc, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&proc->outer_lock);
+	if (!spin_trylock(&proc->outer_lock)) {
+		binder_lock_contended(proc, BINDER_LOCK_OUTER);
+		spin_lock(&proc->outer_lock);
+	}
 }
 
 /**
@@ -736,7 +781,10 @@ _binder_inner_proc_lock(struct binder_proc *proc, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&proc->inner_lock);
+	if (!spin_trylock(&proc->inner_lock)) {
+		binder_lock_contended(proc, BINDER_LOCK_INNER);
+		spin_lock(&proc->inner_lock);
+	}
 }
 
 /**
@@ -768,7 +816,7 @@ _binder_node_lock(struct binder_node *node, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&node->lock);
+	binder_node_spin_lock(node);
 }
 
 /**
@@ -801,7 +849,7 @@ _binder_node_inner_lock(struct binder_node *node, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&node->lock);
+	binder_node_spin_lock(node);
 	if (node->proc)
 		binder_inner_proc_lock(node->proc);
 	else
@@ -2949,6 +2997,9 @@ static int binder_fixup_parent(struct binder_transaction *t,
  * If the @thread parameter is not NULL, the transaction is always queued
  * to the waitlist of that specific thread.
  *
+ * Synchronous transactions don't take the node lock: it only orders the
+ * async queue of the node, and the node priority is fixed at creation.
+ *
  * Return:	0 if the transaction was successfully queued
  *		BR_DEAD_REPLY if the target process or thread is dead
  *		BR_FROZEN_REPLY if the target process or thread is frozen
@@ -2961,14 +3012,15 @@ static int binder_proc_transaction(struct binder_transaction *t,
 	struct binder_priority node_prio;
 	bool oneway = !!(t->flags & TF_ONE_WAY);
 	bool pending_async = false;
+	bool wakeup_pending = false;
 
 	BUG_ON(!node);
-	binder_node_lock(node);
 	node_prio.prio = node->min_priority;
 	node_prio.sched_policy = node->sched_policy;
 
 	if (oneway) {
 		BUG_ON(thread);
+		binder_node_lock(node);
 		if (node->has_async_transaction) {
 			pending_async = true;
 		} else {
@@ -2985,7 +3037,8 @@ static int binder_proc_transaction(struct binder_transaction *t,
 	if ((proc->is_frozen && !oneway) || proc->is_dead ||
 			(thread && thread->is_dead)) {
 		binder_inner_proc_unlock(proc);
-		binder_node_unlock(node);
+		if (oneway)
+			binder_node_unlock(node);
 		return proc->is_frozen ? BR_FROZEN_REPLY : BR_DEAD_REPLY;
 	}
 
@@ -2996,18 +3049,30 @@ static int binder_proc_transaction(struct binder_transaction *t,
 		binder_transaction_priority(thread->task, t, node_prio,
 					    node->inherit_rt);
 		binder_enqueue_thread_work_ilocked(thread, &t->work);
+		binder_stats_handoff(BINDER_HANDOFF_THREAD);
 	} else if (!pending_async) {
+		/*
+		 * No thread is waiting, so every poll thread was woken when
+		 * proc->todo became non-empty, and those that went back to
+		 * poll since saw the work.  Waking them again for each
+		 * transaction of a burst is just an rb-tree walk.
+		 */
+		wakeup_pending = !binder_worklist_empty_ilocked(&proc->todo);
 		binder_enqueue_work_ilocked(&t->work, &proc->todo);
+		binder_stats_handoff(wakeup_pending ?
+				     BINDER_HANDOFF_COALESCED :
+				     BINDER_HANDOFF_PROC);
 	} else {
 		binder_enqueue_work_ilocked(&t->work, &node->async_todo);
 	}
 
-	if (!pending_async)
+	if (!pending_async && !wakeup_pending)
 		binder_wakeup_thread_ilocked(proc, thread, !oneway /* sync */);
 
 	proc->outstanding_txns++;
 	binder_inner_proc_unlock(proc);
-	binder_node_unlock(node);
+	if (oneway)
+		binder_node_unlock(node);
 
 	return 0;
 }
@@ -3407,6 +3472,8 @@ static void binder_transaction(struct binder_proc *proc,
 				tr->data_size)) {
 		binder_user_error("%d:%d got transaction with invalid data ptr\n",
 				proc->pid, thread->pid);
+		/* pages under the data may not be zeroed, see nozero_min_size */
+		t->buffer->clear_on_free = true;
 		return_error = BR_FAILED_REPLY;
 		return_error_param = -EFAULT;
 		return_error_line = __LINE__;
@@ -6298,6 +6365,18 @@ static const char * const binder_objstat_strings[] = {
 	"transaction_complete"
 };
 
+static const char * const binder_lock_strings[] = {
+	"outer_lock",
+	"inner_lock",
+	"node_lock"
+};
+
+static const char * const binder_handoff_strings[] = {
+	"thread",
+	"proc",
+	"proc_coalesced"
+};
+
 static void print_binder_stats(struct seq_file *m, const char *prefix,
 			       struct binder_stats *stats)
 {
@@ -6338,6 +6417,26 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 				created - deleted,
 				created);
 	}
+
+	BUILD_BUG_ON(ARRAY_SIZE(stats->lock_contended) !=
+		     ARRAY_SIZE(binder_lock_strings));
+	for (i = 0; i < ARRAY_SIZE(stats->lock_contended); i++) {
+		int temp = atomic_read(&stats->lock_contended[i]);
+
+		if (temp)
+			seq_printf(m, "%s%s contended: %d\n", prefix,
+				   binder_lock_strings[i], temp);
+	}
+
+	BUILD_BUG_ON(ARRAY_SIZE(stats->handoff) !=
+		     ARRAY_SIZE(binder_handoff_strings));
+	for (i = 0; i < ARRAY_SIZE(stats->handoff); i++) {
+		int temp = atomic_read(&stats->handoff[i]);
+
+		if (temp)
+			seq_printf(m, "%shandoff %s: %d\n", prefix,
+				   binder_handoff_strings[i], temp);
+	}
 }
 
 static void print_binder_proc_stats(struct seq_file *m,
@@ -6391,6 +6490,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  buffers: %d\n", count);
 
 	binder_alloc_print_pages(m, &proc->alloc);
+	binder_alloc_print_stats(m, &proc->alloc);
 
 	count = 0;
 	binder_inner_proc_lock(proc);
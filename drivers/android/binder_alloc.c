@@ -23,6 +23,7 @@
 #include <linux/uaccess.h>
 #include <linux/highmem.h>
 #include <linux/sizes.h>
+#include <linux/ktime.h>
 #include "binder_alloc.h"
 #include "binder_trace.h"
 
@@ -41,6 +42,16 @@ static uint32_t binder_alloc_debug_mask = 0;
 module_param_named(debug_mask, binder_alloc_debug_mask,
 		   uint, 0644);
 
+/*
+ * Buffers with at least this much transaction data get the pages that
+ * the data fully covers unzeroed, as the sender's data is copied over
+ * them first thing.  0 zeroes all pages.
+ */
+static uint32_t binder_alloc_nozero_min = 0;
+
+module_param_named(nozero_min_size, binder_alloc_nozero_min,
+		   uint, 0644);
+
 #ifdef DEBUG
 #define binder_alloc_debug(mask, x...) \
 	do { \
@@ -87,14 +98,16 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return binder_buffer_next(buffer)->user_data - buffer->user_data;
 }
 
+static int binder_free_class(size_t size)
+{
+	return min_t(int, ilog2(size), BINDER_ALLOC_FREE_CLASSES - 1);
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
-	struct rb_node **p = &alloc->free_buffers.rb_node;
-	struct rb_node *parent = NULL;
-	struct binder_buffer *buffer;
-	size_t buffer_size;
 	size_t new_buffer_size;
+	int class;
 
 	BUG_ON(!new_buffer->free);
 
@@ -104,20 +117,67 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 		     "%d: add free buffer, size %zd, at %pK\n",
 		      alloc->pid, new_buffer_size, new_buffer);
 
-	while (*p) {
-		parent = *p;
-		buffer = rb_entry(parent, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
+	/*
+	 * Most recently freed first: its pages are the most likely to still
+	 * be populated and off the shrinker's reach.
+	 */
+	class = binder_free_class(new_buffer_size);
+	list_add(&new_buffer->free_entry, &alloc->free_buffers[class]);
+	__set_bit(class, &alloc->free_classes);
+}
 
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
+/*
+ * Must be called before the size of @buffer changes, that is before it
+ * is split or merged with its neighbours.
+ */
+static void binder_erase_free_buffer(struct binder_alloc *alloc,
+				     struct binder_buffer *buffer)
+{
+	int class = binder_free_class(binder_alloc_buffer_size(alloc, buffer));
 
-		if (new_buffer_size < buffer_size)
-			p = &parent->rb_left;
-		else
-			p = &parent->rb_right;
+	BUG_ON(!buffer->free);
+
+	list_del(&buffer->free_entry);
+	if (list_empty(&alloc->free_buffers[class]))
+		__clear_bit(class, &alloc->free_classes);
+}
+
+/*
+ * Find a free buffer of at least @size bytes.  Any buffer of a larger
+ * class fits, so only the class of @size itself ever needs a search, and
+ * only once no larger class is left.
+ */
+static struct binder_buffer *binder_find_free_buffer(struct binder_alloc *alloc,
+						     size_t size,
+						     size_t *buffer_size)
+{
+	int class = binder_free_class(size);
+	struct binder_buffer *buffer;
+	unsigned long larger;
+
+	if (test_bit(class, &alloc->free_classes)) {
+		buffer = list_first_entry(&alloc->free_buffers[class],
+					  struct binder_buffer, free_entry);
+		*buffer_size = binder_alloc_buffer_size(alloc, buffer);
+		if (*buffer_size >= size)
+			return buffer;
 	}
-	rb_link_node(&new_buffer->rb_node, parent, p);
-	rb_insert_color(&new_buffer->rb_node, &alloc->free_buffers);
+
+	larger = find_next_bit(&alloc->free_classes,
+			       BINDER_ALLOC_FREE_CLASSES, class + 1);
+	if (larger < BINDER_ALLOC_FREE_CLASSES) {
+		buffer = list_first_entry(&alloc->free_buffers[larger],
+					  struct binder_buffer, free_entry);
+		*buffer_size = binder_alloc_buffer_size(alloc, buffer);
+		return buffer;
+	}
+
+	list_for_each_entry(buffer, &alloc->free_buffers[class], free_entry) {
+		*buffer_size = binder_alloc_buffer_size(alloc, buffer);
+		if (*buffer_size >= size)
+			return buffer;
+	}
+	return NULL;
 }
 
 static void binder_insert_allocated_buffer_locked(
@@ -201,7 +261,8 @@ struct binder_buffer *binder_alloc_prepare_to_free(struct binder_alloc *alloc,
 }
 
 static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
-				    void __user *start, void __user *end)
+				    void __user *start, void __user *end,
+				    void __user *nozero_end)
 {
 	void __user *page_addr;
 	unsigned long user_page_addr;
@@ -209,6 +270,7 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 	struct vm_area_struct *vma = NULL;
 	struct mm_struct *mm = NULL;
 	bool need_mm = false;
+	int err = -ENOMEM;
 
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: %s pages %pK-%pK\n", alloc->pid,
@@ -267,12 +329,24 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 			goto err_page_ptr_cleared;
 
 		trace_binder_alloc_page_start(alloc, index);
-		page->page_ptr = alloc_page(GFP_KERNEL |
+		/*
+		 * Don't enter reclaim with alloc->mutex held, every
+		 * transaction to this proc would wait on it.  Fall back to
+		 * the stash, or let the caller refill the stash with the
+		 * mutex dropped.
+		 */
+		page->page_ptr = alloc_page(GFP_NOWAIT | __GFP_NOWARN |
 					    __GFP_HIGHMEM |
-					    __GFP_ZERO);
+					    (page_addr + PAGE_SIZE > nozero_end ?
+					     __GFP_ZERO : 0));
+		if (!page->page_ptr && alloc->nr_page_stash) {
+			page->page_ptr = list_first_entry(&alloc->page_stash,
+							  struct page, lru);
+			list_del(&page->page_ptr->lru);
+			alloc->nr_page_stash--;
+		}
 		if (!page->page_ptr) {
-			pr_err("%d: binder_alloc_buf failed for page at %pK\n",
-				alloc->pid, page_addr);
+			err = -EAGAIN;
 			goto err_alloc_page_failed;
 		}
 		page->alloc = alloc;
@@ -329,7 +403,7 @@ err_no_vma:
 		up_read(&mm->mmap_sem);
 		mmput(mm);
 	}
-	return vma ? -ENOMEM : -ESRCH;
+	return vma ? err : -ESRCH;
 }
 
 
@@ -370,7 +444,7 @@ static bool debug_low_async_space_locked(struct binder_alloc *alloc, int pid)
 	 * and at some point we'll catch them in the act. This is more efficient
 	 * than keeping a map per pid.
 	 */
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t total_alloc_size = 0;
 	size_t num_buffers = 0;
@@ -412,12 +486,12 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				int is_async,
 				int pid)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
 	void __user *has_page_addr;
 	void __user *end_page_addr;
+	void __user *nozero_end;
 	size_t size, data_offsets_size;
 	int ret;
 
@@ -455,23 +529,10 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	/* Pad 0-size buffers so they get assigned unique addresses */
 	size = max(size, sizeof(void *));
 
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-
-		if (size < buffer_size) {
-			best_fit = n;
-			n = n->rb_left;
-		} else if (size > buffer_size)
-			n = n->rb_right;
-		else {
-			best_fit = n;
-			break;
-		}
-	}
-	if (best_fit == NULL) {
+	buffer = binder_find_free_buffer(alloc, size, &buffer_size);
+	if (buffer == NULL) {
 		size_t allocated_buffers = 0;
+		int class;
 		size_t largest_alloc_size = 0;
 		size_t total_alloc_size = 0;
 		size_t free_buffers = 0;
@@ -487,14 +548,16 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			if (buffer_size > largest_alloc_size)
 				largest_alloc_size = buffer_size;
 		}
-		for (n = rb_first(&alloc->free_buffers); n != NULL;
-		     n = rb_next(n)) {
-			buffer = rb_entry(n, struct binder_buffer, rb_node);
-			buffer_size = binder_alloc_buffer_size(alloc, buffer);
-			free_buffers++;
-			total_free_size += buffer_size;
-			if (buffer_size > largest_free_size)
-				largest_free_size = buffer_size;
+		for (class = 0; class < BINDER_ALLOC_FREE_CLASSES; class++) {
+			list_for_each_entry(buffer, &alloc->free_buffers[class],
+					    free_entry) {
+				buffer_size = binder_alloc_buffer_size(alloc,
+								       buffer);
+				free_buffers++;
+				total_free_size += buffer_size;
+				if (buffer_size > largest_free_size)
+					largest_free_size = buffer_size;
+			}
 		}
 		binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
 				   "%d: binder_alloc_buf size %zd failed, no address space\n",
@@ -506,10 +569,6 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				   free_buffers, largest_free_size);
 		return ERR_PTR(-ENOSPC);
 	}
-	if (n == NULL) {
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-	}
 
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_alloc_buf size %zd got buffer %pK size %zd\n",
@@ -517,13 +576,18 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 
 	has_page_addr = (void __user *)
 		(((uintptr_t)buffer->user_data + buffer_size) & PAGE_MASK);
-	WARN_ON(n && buffer_size != size);
 	end_page_addr =
 		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data + size);
 	if (end_page_addr > has_page_addr)
 		end_page_addr = has_page_addr;
+	nozero_end = buffer->user_data;
+	if (binder_alloc_nozero_min && data_size >= binder_alloc_nozero_min)
+		nozero_end = (void __user *)
+			(((uintptr_t)buffer->user_data + data_size) &
+			 PAGE_MASK);
 	ret = binder_update_page_range(alloc, 1, (void __user *)
-		PAGE_ALIGN((uintptr_t)buffer->user_data), end_page_addr);
+		PAGE_ALIGN((uintptr_t)buffer->user_data), end_page_addr,
+		nozero_end);
 	if (ret)
 		return ERR_PTR(ret);
 
@@ -536,13 +600,15 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			       __func__, alloc->pid);
 			goto err_alloc_buf_struct_failed;
 		}
+		binder_erase_free_buffer(alloc, buffer);
 		new_buffer->user_data = (u8 __user *)buffer->user_data + size;
 		list_add(&new_buffer->entry, &buffer->entry);
 		new_buffer->free = 1;
 		binder_insert_free_buffer(alloc, new_buffer);
+	} else {
+		binder_erase_free_buffer(alloc, buffer);
 	}
 
-	rb_erase(best_fit, &alloc->free_buffers);
 	buffer->free = 0;
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -576,10 +642,48 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 err_alloc_buf_struct_failed:
 	binder_update_page_range(alloc, 0, (void __user *)
 				 PAGE_ALIGN((uintptr_t)buffer->user_data),
-				 end_page_addr);
+				 end_page_addr, NULL);
 	return ERR_PTR(-ENOMEM);
 }
 
+/*
+ * Allocate zeroed pages for a buffer of @size bytes without holding the
+ * mutex and add them to the stash, up to BINDER_ALLOC_PAGE_STASH pages.
+ */
+static int binder_alloc_refill_stash(struct binder_alloc *alloc, size_t size)
+{
+	int nr = min_t(size_t, DIV_ROUND_UP(size, PAGE_SIZE) + 1,
+		       BINDER_ALLOC_PAGE_STASH);
+	struct page *page, *tmp;
+	LIST_HEAD(pages);
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO);
+		if (!page)
+			break;
+		list_add(&page->lru, &pages);
+	}
+	if (!i) {
+		pr_err("%d: binder_alloc_buf failed to allocate pages\n",
+		       alloc->pid);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&alloc->mutex);
+	list_for_each_entry_safe(page, tmp, &pages, lru) {
+		if (alloc->nr_page_stash >= BINDER_ALLOC_PAGE_STASH)
+			break;
+		list_move(&page->lru, &alloc->page_stash);
+		alloc->nr_page_stash++;
+	}
+	mutex_unlock(&alloc->mutex);
+
+	list_for_each_entry_safe(page, tmp, &pages, lru)
+		__free_page(page);
+	return 0;
+}
+
 /**
  * binder_alloc_new_buf() - Allocate a new binder buffer
  * @alloc:              binder_alloc for this proc
@@ -604,10 +708,37 @@ struct binder_buffer *binder_alloc_new_buf(struct binder_alloc *alloc,
 					   int pid)
 {
 	struct binder_buffer *buffer;
+	u64 start = ktime_get_ns();
+	u64 ns;
 
 	mutex_lock(&alloc->mutex);
-	buffer = binder_alloc_new_buf_locked(alloc, data_size, offsets_size,
-					     extra_buffers_size, is_async, pid);
+	for (;;) {
+		buffer = binder_alloc_new_buf_locked(alloc, data_size,
+						     offsets_size,
+						     extra_buffers_size,
+						     is_async, pid);
+		if (buffer != ERR_PTR(-EAGAIN))
+			break;
+
+		/*
+		 * Pages of the buffer have to be allocated: do it, and
+		 * zero them, with the mutex dropped.  The buffer is looked
+		 * up again since the address space may have changed.
+		 */
+		alloc->stats.page_refills++;
+		mutex_unlock(&alloc->mutex);
+		if (binder_alloc_refill_stash(alloc, data_size + offsets_size +
+					      extra_buffers_size))
+			return ERR_PTR(-ENOMEM);
+		mutex_lock(&alloc->mutex);
+	}
+	if (!IS_ERR(buffer)) {
+		ns = ktime_get_ns() - start;
+		alloc->stats.allocs++;
+		alloc->stats.alloc_ns += ns;
+		if (ns > alloc->stats.alloc_ns_max)
+			alloc->stats.alloc_ns_max = ns;
+	}
 	mutex_unlock(&alloc->mutex);
 	return buffer;
 }
@@ -665,7 +796,8 @@ static void binder_delete_free_buffer(struct binder_alloc *alloc,
 				   prev->user_data,
 				   next ? next->user_data : NULL);
 		binder_update_page_range(alloc, 0, buffer_start_page(buffer),
-					 buffer_start_page(buffer) + PAGE_SIZE);
+					 buffer_start_page(buffer) + PAGE_SIZE,
+					 NULL);
 	}
 	list_del(&buffer->entry);
 	kmem_cache_free(binder_buffer_pool, buffer);
@@ -703,7 +835,8 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 	binder_update_page_range(alloc, 0,
 		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data),
 		(void __user *)(((uintptr_t)
-			  buffer->user_data + buffer_size) & PAGE_MASK));
+			  buffer->user_data + buffer_size) & PAGE_MASK),
+		NULL);
 
 	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
 	buffer->free = 1;
@@ -711,7 +844,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		struct binder_buffer *next = binder_buffer_next(buffer);
 
 		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_erase_free_buffer(alloc, next);
 			binder_delete_free_buffer(alloc, next);
 		}
 	}
@@ -719,8 +852,8 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		struct binder_buffer *prev = binder_buffer_prev(buffer);
 
 		if (prev->free) {
+			binder_erase_free_buffer(alloc, prev);
 			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
 			buffer = prev;
 		}
 	}
@@ -837,11 +970,17 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 	struct rb_node *n;
 	int buffers, page_count;
 	struct binder_buffer *buffer;
+	struct page *page, *tmp;
 
 	buffers = 0;
 	mutex_lock(&alloc->mutex);
 	BUG_ON(alloc->vma);
 
+	list_for_each_entry_safe(page, tmp, &alloc->page_stash, lru)
+		__free_page(page);
+	INIT_LIST_HEAD(&alloc->page_stash);
+	alloc->nr_page_stash = 0;
+
 	while ((n = rb_first(&alloc->allocated_buffers))) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 
@@ -963,6 +1102,52 @@ void binder_alloc_print_pages(struct seq_file *m,
 	seq_printf(m, "  pages high watermark: %zu\n", alloc->pages_high);
 }
 
+/**
+ * binder_alloc_print_stats() - print free space fragmentation and latency
+ * @m:     seq_file for output via seq_printf()
+ * @alloc: binder_alloc for this proc
+ *
+ * Fragmentation is the share of the free space outside the largest free
+ * buffer, in percent.
+ */
+void binder_alloc_print_stats(struct seq_file *m,
+			      struct binder_alloc *alloc)
+{
+	struct binder_alloc_stats stats;
+	struct binder_buffer *buffer;
+	int nr[BINDER_ALLOC_FREE_CLASSES];
+	size_t total = 0, largest = 0, size;
+	int class, count = 0;
+
+	mutex_lock(&alloc->mutex);
+	for (class = 0; class < BINDER_ALLOC_FREE_CLASSES; class++) {
+		nr[class] = 0;
+		list_for_each_entry(buffer, &alloc->free_buffers[class],
+				    free_entry) {
+			size = binder_alloc_buffer_size(alloc, buffer);
+			total += size;
+			largest = max(largest, size);
+			nr[class]++;
+		}
+		count += nr[class];
+	}
+	stats = alloc->stats;
+	mutex_unlock(&alloc->mutex);
+
+	seq_printf(m, "  free buffers: %d size %zu largest %zu frag %zu%%\n",
+		   count, total, largest,
+		   total ? (total - largest) * 100 / total : 0);
+	seq_puts(m, "  free classes:");
+	for (class = 0; class < BINDER_ALLOC_FREE_CLASSES; class++)
+		if (nr[class])
+			seq_printf(m, " %lu:%d", 1UL << class, nr[class]);
+	seq_puts(m, "\n");
+	seq_printf(m, "  allocs: %llu page refills %llu avg %llu ns max %llu ns\n",
+		   stats.allocs, stats.page_refills,
+		   stats.allocs ? div64_u64(stats.alloc_ns, stats.allocs) : 0,
+		   stats.alloc_ns_max);
+}
+
 /**
  * binder_alloc_get_allocated_count() - return count of buffers
  * @alloc: binder_alloc for this proc
@@ -1101,9 +1286,16 @@ static struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
+	BUILD_BUG_ON(ilog2(SZ_4M) >= BINDER_ALLOC_FREE_CLASSES);
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_ALLOC_FREE_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->free_buffers[i]);
+	INIT_LIST_HEAD(&alloc->page_stash);
 }
 
 int binder_alloc_shrinker_init(void)
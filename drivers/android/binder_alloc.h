@@ -21,7 +21,8 @@ struct binder_transaction;
 /**
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
- * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @rb_node:            node for allocated_buffers rb tree
+ * @free_entry:         entry in one of the alloc->free_buffers lists
  * @free:               %true if buffer is free
  * @clear_on_free:      %true if buffer must be zeroed after use
  * @allow_user_free:    %true if user is allowed to free buffer
@@ -41,8 +42,10 @@ struct binder_transaction;
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node;		/* allocated entry by address */
+		struct list_head free_entry;	/* free entry by size class */
+	};
 	unsigned free:1;
 	unsigned clear_on_free:1;
 	unsigned allow_user_free:1;
@@ -72,6 +75,29 @@ struct binder_lru_page {
 	struct binder_alloc *alloc;
 };
 
+/*
+ * Free buffers are kept in lists of log2 size classes, the largest class
+ * holding the whole SZ_4M address space.
+ */
+#define BINDER_ALLOC_FREE_CLASSES	23
+
+/* zeroed pages kept aside for buffers whose pages are not populated */
+#define BINDER_ALLOC_PAGE_STASH		16
+
+/**
+ * struct binder_alloc_stats - allocator statistics of a proc
+ * @allocs:             buffers allocated
+ * @page_refills:       times the mutex was dropped to allocate pages
+ * @alloc_ns:           total time spent allocating buffers
+ * @alloc_ns_max:       longest buffer allocation
+ */
+struct binder_alloc_stats {
+	u64 allocs;
+	u64 page_refills;
+	u64 alloc_ns;
+	u64 alloc_ns_max;
+};
+
 /**
  * struct binder_alloc - per-binder proc state for binder allocator
  * @vma:                vm_area_struct passed to mmap_handler
@@ -81,8 +107,9 @@ struct binder_lru_page {
  * @vma_vm_mm:          copy of vma->vm_mm (invarient after mmap)
  * @buffer:             base of per-proc address space mapped via mmap
  * @buffers:            list of all buffers for this proc
- * @free_buffers:       rb tree of buffers available for allocation
- *                      sorted by size
+ * @free_buffers:       lists of buffers available for allocation by
+ *                      log2 size class, most recently freed first
+ * @free_classes:       bitmap of the non-empty @free_buffers lists
  * @allocated_buffers:  rb tree of allocated buffers sorted by address
  * @free_async_space:   VA space available for async buffers. This is
  *                      initialized at mmap time to 1/2 the full VA space
@@ -92,6 +119,10 @@ struct binder_lru_page {
  * @pages_high:         high watermark of offset in @pages
  * @oneway_spam_detected: %true if oneway spam detection fired, clear that
  * flag once the async buffer has returned to a healthy state
+ * @page_stash:         zeroed pages allocated with the mutex dropped,
+ *                      consumed when buffer pages are populated
+ * @nr_page_stash:      number of pages on @page_stash
+ * @stats:              allocator statistics
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -104,7 +135,8 @@ struct binder_alloc {
 	struct mm_struct *vma_vm_mm;
 	void __user *buffer;
 	struct list_head buffers;
-	struct rb_root free_buffers;
+	struct list_head free_buffers[BINDER_ALLOC_FREE_CLASSES];
+	unsigned long free_classes;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 	struct binder_lru_page *pages;
@@ -113,6 +145,9 @@ struct binder_alloc {
 	int pid;
 	size_t pages_high;
 	bool oneway_spam_detected;
+	struct list_head page_stash;
+	int nr_page_stash;
+	struct binder_alloc_stats stats;
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -145,6 +180,8 @@ extern void binder_alloc_print_allocated(struct seq_file *m,
 					 struct binder_alloc *alloc);
 void binder_alloc_print_pages(struct seq_file *m,
 			      struct binder_alloc *alloc);
+void binder_alloc_print_stats(struct seq_file *m,
+			      struct binder_alloc *alloc);
 extern int binder_buffer_pool_create(void);
 extern void binder_buffer_pool_destroy(void);
 
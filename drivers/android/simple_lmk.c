@@ -5,13 +5,16 @@
 
 #define pr_fmt(fmt) "simple_lmk: " fmt
 
+#include <linux/debugfs.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/mm.h>
 #include <linux/moduleparam.h>
 #include <linux/oom.h>
 #include <linux/ratelimit.h>
+#include <linux/seq_file.h>
 #include <linux/sort.h>
+#include <linux/swap.h>
 #include <linux/vmpressure.h>
 
 /* The minimum number of pages to free per reclaim */
@@ -23,6 +26,30 @@
 /* Timeout in jiffies for each reclaim */
 #define RECLAIM_EXPIRES msecs_to_jiffies(CONFIG_ANDROID_SIMPLE_LMK_TIMEOUT_MSEC)
 
+/* One bucket per adj that a task can be killed at */
+#define NR_ADJ_BUCKETS (OOM_SCORE_ADJ_MAX + 1)
+
+/*
+ * The share of the victims' estimated size that a reclaim really frees,
+ * in 1/1024ths, as a running average. Shared and page cache pages make
+ * it vary a lot between workloads, so the number of pages to find is
+ * MIN_FREE_PAGES scaled by it, within these bounds.
+ */
+#define YIELD_SHIFT 10
+#define MIN_TARGET_PAGES (MIN_FREE_PAGES / 2)
+#define MAX_TARGET_PAGES (MIN_FREE_PAGES * 2)
+
+struct simple_lmk_stats {
+	unsigned long reclaims;
+	unsigned long kills;
+	unsigned long timeouts;
+	unsigned long pages_estimated;
+	unsigned long pages_freed;
+	unsigned int last_ms;
+	unsigned int max_ms;
+	u64 total_ms;
+};
+
 struct victim_info {
 	struct task_struct *tsk;
 	struct mm_struct *mm;
@@ -30,13 +57,25 @@ struct victim_info {
 };
 
 static struct victim_info victims[MAX_VICTIMS] __cacheline_aligned_in_smp;
-static struct task_struct *task_bucket[SHRT_MAX + 1] __cacheline_aligned;
+static struct task_struct *task_bucket[NR_ADJ_BUCKETS] __cacheline_aligned;
+static DECLARE_BITMAP(bucket_map, NR_ADJ_BUCKETS);
 static DECLARE_WAIT_QUEUE_HEAD(oom_waitq);
 static DECLARE_COMPLETION(reclaim_done);
 static __cacheline_aligned_in_smp DEFINE_RWLOCK(mm_free_lock);
 static int nr_victims;
 static atomic_t needs_reclaim = ATOMIC_INIT(0);
 static atomic_t nr_killed = ATOMIC_INIT(0);
+static unsigned int kill_yield = 1 << YIELD_SHIFT;
+static struct simple_lmk_stats lmk_stats;
+static DEFINE_SPINLOCK(lmk_stats_lock);
+
+/* The number of pages worth of victims to find for this reclaim */
+static unsigned long get_target_pages(void)
+{
+	return clamp_t(unsigned long,
+		       (MIN_FREE_PAGES << YIELD_SHIFT) / kill_yield,
+		       MIN_TARGET_PAGES, MAX_TARGET_PAGES);
+}
 
 static int victim_cmp(const void *lhs_ptr, const void *rhs_ptr)
 {
@@ -65,11 +104,11 @@ static unsigned long get_total_mm_pages(struct mm_struct *mm)
 	return pages;
 }
 
-static unsigned long find_victims(int *vindex)
+static unsigned long find_victims(int *vindex, unsigned long target)
 {
-	short i, min_adj = SHRT_MAX, max_adj = 0;
 	unsigned long pages_found = 0;
 	struct task_struct *tsk;
+	unsigned int i;
 
 	rcu_read_lock();
 	for_each_process(tsk) {
@@ -92,26 +131,24 @@ static unsigned long find_victims(int *vindex)
 			continue;
 
 		/* Store the task in a linked-list bucket based on its adj */
+		adj = min_t(short, adj, OOM_SCORE_ADJ_MAX);
 		tsk->simple_lmk_next = task_bucket[adj];
 		task_bucket[adj] = tsk;
-
-		/* Track the min and max adjs to speed up the loop below */
-		if (adj > max_adj)
-			max_adj = adj;
-		if (adj < min_adj)
-			min_adj = adj;
+		__set_bit(adj, bucket_map);
 	}
 
-	/* Start searching for victims from the highest adj (least important) */
-	for (i = max_adj; i >= min_adj; i--) {
+	/*
+	 * Start searching for victims from the highest adj (least important),
+	 * visiting only the buckets that have tasks.
+	 */
+	for (i = find_last_bit(bucket_map, NR_ADJ_BUCKETS); i < NR_ADJ_BUCKETS;
+	     i = i ? find_last_bit(bucket_map, i) : NR_ADJ_BUCKETS) {
 		int old_vindex;
 
-		tsk = task_bucket[i];
-		if (!tsk)
-			continue;
-
 		/* Clear out this bucket for the next time reclaim is done */
+		tsk = task_bucket[i];
 		task_bucket[i] = NULL;
+		__clear_bit(i, bucket_map);
 
 		/* Iterate through every task with this adj */
 		old_vindex = *vindex;
@@ -147,11 +184,11 @@ static unsigned long find_victims(int *vindex)
 		     sizeof(*victims), victim_cmp, victim_swap);
 
 		/* Stop when we are out of space or have enough pages found */
-		if (*vindex == MAX_VICTIMS || pages_found >= MIN_FREE_PAGES) {
+		if (*vindex == MAX_VICTIMS || pages_found >= target) {
 			/* Zero out any remaining buckets we didn't touch */
-			if (i > min_adj)
-				memset(&task_bucket[min_adj], 0,
-				       (i - min_adj) * sizeof(*task_bucket));
+			for_each_set_bit(i, bucket_map, NR_ADJ_BUCKETS)
+				task_bucket[i] = NULL;
+			bitmap_zero(bucket_map, NR_ADJ_BUCKETS);
 			break;
 		}
 	}
@@ -160,7 +197,41 @@ static unsigned long find_victims(int *vindex)
 	return pages_found;
 }
 
-static int process_victims(int vlen)
+/*
+ * Account a finished reclaim and, when all of its victims died in time,
+ * fold the share of their estimated size that showed up as free pages
+ * into kill_yield. Other allocations keep running meanwhile, so a single
+ * sample is noisy and is only given a quarter of the weight.
+ */
+static void update_stats(int nr_killed_now, unsigned long pages_killed,
+			 unsigned long free_before, ktime_t start,
+			 bool timed_out)
+{
+	unsigned long free_after = nr_free_pages();
+	unsigned long freed = free_after > free_before ?
+			      free_after - free_before : 0;
+	unsigned int ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+	unsigned long yield;
+
+	if (!timed_out && pages_killed) {
+		yield = min((freed << YIELD_SHIFT) / pages_killed,
+			    2UL << YIELD_SHIFT);
+		kill_yield = max(1UL, (3 * kill_yield + yield) / 4);
+	}
+
+	spin_lock(&lmk_stats_lock);
+	lmk_stats.reclaims++;
+	lmk_stats.kills += nr_killed_now;
+	lmk_stats.timeouts += timed_out;
+	lmk_stats.pages_estimated += pages_killed;
+	lmk_stats.pages_freed += freed;
+	lmk_stats.last_ms = ms;
+	lmk_stats.max_ms = max(lmk_stats.max_ms, ms);
+	lmk_stats.total_ms += ms;
+	spin_unlock(&lmk_stats_lock);
+}
+
+static int process_victims(int vlen, unsigned long target)
 {
 	unsigned long pages_found = 0;
 	int i, nr_to_kill = 0;
@@ -174,7 +245,7 @@ static int process_victims(int vlen)
 		struct task_struct *vtsk = victim->tsk;
 
 		/* The victim's mm lock is taken in find_victims; release it */
-		if (pages_found >= MIN_FREE_PAGES) {
+		if (pages_found >= target) {
 			task_unlock(vtsk);
 		} else {
 			pages_found += victim->size;
@@ -187,20 +258,23 @@ static int process_victims(int vlen)
 
 static void scan_and_kill(void)
 {
+	unsigned long target = get_target_pages();
+	unsigned long pages_found, pages_killed = 0, free_before;
 	int i, nr_to_kill, nr_found = 0;
-	unsigned long pages_found;
+	bool timed_out;
+	ktime_t start;
 
 	/* Populate the victims array with tasks sorted by adj and then size */
-	pages_found = find_victims(&nr_found);
+	pages_found = find_victims(&nr_found, target);
 	if (unlikely(!nr_found)) {
 		pr_err_ratelimited("No processes available to kill!\n");
 		return;
 	}
 
 	/* Minimize the number of victims if we found more pages than needed */
-	if (pages_found > MIN_FREE_PAGES) {
+	if (pages_found > target) {
 		/* First round of processing to weed out unneeded victims */
-		nr_to_kill = process_victims(nr_found);
+		nr_to_kill = process_victims(nr_found, target);
 
 		/*
 		 * Try to kill as few of the chosen victims as possible by
@@ -212,7 +286,7 @@ static void scan_and_kill(void)
 		     victim_swap);
 
 		/* Second round of processing to finally select the victims */
-		nr_to_kill = process_victims(nr_to_kill);
+		nr_to_kill = process_victims(nr_to_kill, target);
 	} else {
 		/* Too few pages found, so all the victims need to be killed */
 		nr_to_kill = nr_found;
@@ -224,6 +298,8 @@ static void scan_and_kill(void)
 	write_unlock(&mm_free_lock);
 
 	/* Kill the victims */
+	start = ktime_get();
+	free_before = nr_free_pages();
 	for (i = 0; i < nr_to_kill; i++) {
 		static const struct sched_param min_rt_prio = {
 			.sched_priority = 1
@@ -234,6 +310,7 @@ static void scan_and_kill(void)
 		pr_info("Killing %s with adj %d to free %lu KiB\n", vtsk->comm,
 			vtsk->signal->oom_score_adj,
 			victim->size << (PAGE_SHIFT - 10));
+		pages_killed += victim->size;
 
 		/* Accelerate the victim's death by forcing the kill signal */
 		do_send_sig_info(SIGKILL, SEND_SIG_FORCED, vtsk, true);
@@ -266,8 +343,11 @@ static void scan_and_kill(void)
 	}
 
 	/* Wait until all the victims die or until the timeout is reached */
-	if (!wait_for_completion_timeout(&reclaim_done, RECLAIM_EXPIRES))
+	timed_out = !wait_for_completion_timeout(&reclaim_done,
+						 RECLAIM_EXPIRES);
+	if (timed_out)
 		pr_info("Timeout hit waiting for victims to die, proceeding\n");
+	update_stats(nr_to_kill, pages_killed, free_before, start, timed_out);
 
 	/* Clean up for future reclaim invocations */
 	write_lock(&mm_free_lock);
@@ -332,6 +412,65 @@ static struct notifier_block vmpressure_notif = {
 	.priority = INT_MAX
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int simple_lmk_stats_show(struct seq_file *m, void *v)
+{
+	struct simple_lmk_stats st;
+
+	spin_lock(&lmk_stats_lock);
+	st = lmk_stats;
+	spin_unlock(&lmk_stats_lock);
+
+	seq_printf(m, "reclaims: %lu\n", st.reclaims);
+	seq_printf(m, "kills: %lu\n", st.kills);
+	seq_printf(m, "timeouts: %lu\n", st.timeouts);
+	seq_printf(m, "estimated KiB: %lu\n",
+		   st.pages_estimated << (PAGE_SHIFT - 10));
+	seq_printf(m, "freed KiB: %lu\n", st.pages_freed << (PAGE_SHIFT - 10));
+	seq_printf(m, "yield: %u/%u\n", READ_ONCE(kill_yield),
+		   1U << YIELD_SHIFT);
+	seq_printf(m, "target KiB: %lu\n",
+		   get_target_pages() << (PAGE_SHIFT - 10));
+	seq_printf(m, "latency ms: last %u avg %llu max %u\n", st.last_ms,
+		   st.reclaims ? div64_u64(st.total_ms, st.reclaims) : 0,
+		   st.max_ms);
+	return 0;
+}
+
+static int simple_lmk_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, simple_lmk_stats_show, NULL);
+}
+
+static ssize_t simple_lmk_stats_write(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	spin_lock(&lmk_stats_lock);
+	memset(&lmk_stats, 0, sizeof(lmk_stats));
+	spin_unlock(&lmk_stats_lock);
+	return count;
+}
+
+static const struct file_operations simple_lmk_stats_fops = {
+	.open		= simple_lmk_stats_open,
+	.read		= seq_read,
+	.write		= simple_lmk_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void simple_lmk_debugfs_init(void)
+{
+	debugfs_create_file("simple_lmk", 0644, NULL, NULL,
+			    &simple_lmk_stats_fops);
+}
+#else
+static inline void simple_lmk_debugfs_init(void)
+{
+}
+#endif
+
 /* Initialize Simple LMK when lmkd in Android writes to the minfree parameter */
 static int simple_lmk_init_set(const char *val, const struct kernel_param *kp)
 {
@@ -343,6 +482,7 @@ static int simple_lmk_init_set(const char *val, const struct kernel_param *kp)
 				     "simple_lmkd");
 		BUG_ON(IS_ERR(thread));
 		BUG_ON(vmpressure_notifier_register(&vmpressure_notif));
+		simple_lmk_debugfs_init();
 	}
 
 	return 0;
@@ -26,6 +26,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
 #include <linux/platform_device.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -305,6 +306,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	ktime_t start = boot_event_start();
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -350,6 +352,8 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		dev->pm_domain->sync(dev);
 
 	driver_bound(dev);
+	boot_event_record(BOOT_EV_PROBE, start, 0, "%s %s", drv->name,
+			  dev_name(dev));
 	ret = 1;
 	pr_debug("bus: '%s': %s: bound device %s to driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
@@ -363,6 +367,9 @@ probe_failed:
 	if (dev->pm_domain && dev->pm_domain->dismiss)
 		dev->pm_domain->dismiss(dev);
 
+	boot_event_record(ret == -EPROBE_DEFER ? BOOT_EV_DEFER : BOOT_EV_PROBE,
+			  start, ret, "%s %s", drv->name, dev_name(dev));
+
 	switch (ret) {
 	case -EPROBE_DEFER:
 		/* Driver requested deferred probing */
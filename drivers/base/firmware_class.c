@@ -32,6 +32,7 @@
 #include <linux/io.h>
 
 #include <generated/utsrelease.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 
@@ -1304,6 +1305,7 @@ static int assign_firmware_buf(struct firmware *fw, struct device *device,
 static int _request_firmware(struct fw_desc *desc)
 {
 	struct firmware *fw = NULL;
+	ktime_t start = boot_event_start();
 	long timeout;
 	int ret;
 
@@ -1363,6 +1365,8 @@ static int _request_firmware(struct fw_desc *desc)
 	}
 
 	*desc->firmware_p = fw;
+	boot_event_record(BOOT_EV_FIRMWARE, start, ret, "%s",
+			  desc->name ? desc->name : "");
 	return ret;
 }
 
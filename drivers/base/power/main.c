@@ -29,6 +29,8 @@
 #include <linux/sched.h>
 #include <linux/async.h>
 #include <linux/suspend.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <trace/events/power.h>
 #include <linux/cpufreq.h>
 #include <linux/cpuidle.h>
@@ -62,6 +64,38 @@ static pm_message_t pm_transition;
 
 static int async_error;
 
+/*
+ * Booting with pm_async_all marks every device added to dpm_list for
+ * asynchronous suspend and resume. Ordering against the parent is still
+ * enforced by dpm_wait(), so this is only safe on platforms without
+ * dependencies that bypass the device hierarchy.
+ */
+static bool pm_async_all;
+
+static int __init pm_async_all_setup(char *str)
+{
+	pm_async_all = true;
+	return 1;
+}
+__setup("pm_async_all", pm_async_all_setup);
+
+/* Ring of the most recent per-device PM callback durations. */
+#define DPM_TIMES_NR		256
+#define DPM_TIMES_NAME_LEN	32
+
+struct dpm_time_record {
+	char name[DPM_TIMES_NAME_LEN];
+	const char *info;
+	int event;
+	int error;
+	bool async;
+	u32 usecs;
+};
+
+static struct dpm_time_record dpm_times[DPM_TIMES_NR];
+static unsigned int dpm_times_idx;
+static DEFINE_SPINLOCK(dpm_times_lock);
+
 static char *pm_verb(int event)
 {
 	switch (event) {
@@ -127,6 +161,8 @@ void device_pm_add(struct device *dev)
 	pr_debug("PM: Adding info for %s:%s\n",
 		 dev->bus ? dev->bus->name : "No Bus", dev_name(dev));
 	device_pm_check_callbacks(dev);
+	if (pm_async_all)
+		device_enable_async_suspend(dev);
 	mutex_lock(&dpm_list_mtx);
 	if (dev->parent && dev->parent->power.is_prepared)
 		dev_warn(dev, "parent %s should not be sleeping\n",
@@ -191,32 +227,43 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
-static ktime_t initcall_debug_start(struct device *dev)
+static void dpm_record_time(struct device *dev, pm_message_t state,
+			    char *info, int error, s64 usecs)
 {
-	ktime_t calltime = ktime_set(0, 0);
+	struct dpm_time_record *rec;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_times_lock, flags);
+	rec = &dpm_times[dpm_times_idx++ % DPM_TIMES_NR];
+	strlcpy(rec->name, dev_name(dev), sizeof(rec->name));
+	rec->info = info;
+	rec->event = state.event;
+	rec->error = error;
+	rec->async = dev->power.async_suspend && pm_async_enabled;
+	rec->usecs = clamp_t(s64, usecs, 0, U32_MAX);
+	spin_unlock_irqrestore(&dpm_times_lock, flags);
+}
 
-	if (pm_print_times_enabled) {
+static ktime_t initcall_debug_start(struct device *dev)
+{
+	if (pm_print_times_enabled)
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 			dev_name(dev), task_pid_nr(current),
 			dev->parent ? dev_name(dev->parent) : "none");
-		calltime = ktime_get();
-	}
 
-	return calltime;
+	return ktime_get();
 }
 
 static void initcall_debug_report(struct device *dev, ktime_t calltime,
 				  int error, pm_message_t state, char *info)
 {
-	ktime_t rettime;
-	s64 nsecs;
+	s64 usecs = ktime_us_delta(ktime_get(), calltime);
 
-	rettime = ktime_get();
-	nsecs = (s64) ktime_to_ns(ktime_sub(rettime, calltime));
+	dpm_record_time(dev, state, info, error, usecs);
 
 	if (pm_print_times_enabled) {
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
-			error, (unsigned long long)nsecs >> 10);
+			error, (long long)usecs);
 	}
 }
 
@@ -1778,3 +1825,56 @@ void device_pm_check_callbacks(struct device *dev)
 		(!dev->driver || pm_ops_is_empty(dev->driver->pm));
 	spin_unlock_irq(&dev->power.lock);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int dpm_times_show(struct seq_file *s, void *unused)
+{
+	struct dpm_time_record *rec;
+	unsigned int i, n, first;
+
+	seq_puts(s, "# usecs    async error phase device\n");
+	spin_lock_irq(&dpm_times_lock);
+	n = min_t(unsigned int, dpm_times_idx, DPM_TIMES_NR);
+	first = dpm_times_idx - n;
+	for (i = 0; i < n; i++) {
+		rec = &dpm_times[(first + i) % DPM_TIMES_NR];
+		seq_printf(s, "%-10u %5d %5d %s%s %s\n", rec->usecs,
+			   rec->async, rec->error, rec->info,
+			   pm_verb(rec->event), rec->name);
+	}
+	spin_unlock_irq(&dpm_times_lock);
+
+	return 0;
+}
+
+static int dpm_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_times_show, NULL);
+}
+
+static ssize_t dpm_times_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	spin_lock_irq(&dpm_times_lock);
+	dpm_times_idx = 0;
+	spin_unlock_irq(&dpm_times_lock);
+
+	return count;
+}
+
+static const struct file_operations dpm_times_fops = {
+	.open		= dpm_times_open,
+	.read		= seq_read,
+	.write		= dpm_times_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_times_debugfs_init(void)
+{
+	debugfs_create_file("suspend_dev_times", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &dpm_times_fops);
+	return 0;
+}
+late_initcall(dpm_times_debugfs_init);
+#endif
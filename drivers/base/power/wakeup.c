@@ -847,6 +847,30 @@ void pm_get_active_wakeup_sources(char *pending_wakeup_source, size_t max)
 }
 EXPORT_SYMBOL_GPL(pm_get_active_wakeup_sources);
 
+/**
+ * pm_get_last_relaxed_wakeup_source - Name the source that held us up last.
+ * @name: Buffer to copy the name into.
+ * @max: Size of @name.
+ *
+ * Copy the name of the inactive wakeup source with the most recent
+ * activity, i.e. the one whose release allowed the system to suspend.
+ */
+void pm_get_last_relaxed_wakeup_source(char *name, size_t max)
+{
+	struct wakeup_source *ws, *last_ws = NULL;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		if (ws->active)
+			continue;
+		if (!last_ws || ktime_to_ns(ws->last_time) >
+				ktime_to_ns(last_ws->last_time))
+			last_ws = ws;
+	}
+	strlcpy(name, last_ws ? last_ws->name : "none", max);
+	rcu_read_unlock();
+}
+
 void pm_print_active_wakeup_sources(void)
 {
 	struct wakeup_source *ws;
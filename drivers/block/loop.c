@@ -86,6 +86,18 @@ static DEFINE_MUTEX(loop_index_mutex);
 static int max_part;
 static int part_shift;
 
+static bool direct_io;
+module_param(direct_io, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(direct_io, "Use direct I/O and AIO on the backing file by default when it allows it");
+
+static int max_workers = 4;
+module_param(max_workers, int, S_IRUGO);
+MODULE_PARM_DESC(max_workers, "Maximum number of worker threads per loop device");
+
+static int deep_queue = 4;
+module_param(deep_queue, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(deep_queue, "Pending requests above which are spread over all workers");
+
 static int transfer_xor(struct loop_device *lo, int cmd,
 			struct page *raw_page, unsigned raw_off,
 			struct page *loop_page, unsigned loop_off,
@@ -879,19 +891,42 @@ static void loop_config_discard(struct loop_device *lo)
 
 static void loop_unprepare_queue(struct loop_device *lo)
 {
-	flush_kthread_worker(&lo->worker);
-	kthread_stop(lo->worker_task);
+	int i;
+
+	for (i = 0; i < lo->nr_workers; i++) {
+		flush_kthread_worker(&lo->worker[i]);
+		kthread_stop(lo->worker_task[i]);
+	}
+	lo->nr_workers = 0;
 }
 
+/*
+ * The first worker serves everything while the queue is shallow, which
+ * keeps requests in submission order. The others only get work once more
+ * than deep_queue requests are pending, so that buffered reads of a hot
+ * image stop waiting on each other.
+ */
 static int loop_prepare_queue(struct loop_device *lo)
 {
-	init_kthread_worker(&lo->worker);
-	lo->worker_task = kthread_run(kthread_worker_fn,
-			&lo->worker, "loop%d", lo->lo_number);
-	if (IS_ERR(lo->worker_task))
-		return -ENOMEM;
-	set_user_nice(lo->worker_task, MIN_NICE);
+	int i, nr = clamp(max_workers, 1, LOOP_MAX_WORKERS);
+
+	for (i = 0; i < nr; i++) {
+		init_kthread_worker(&lo->worker[i]);
+		lo->worker_task[i] = kthread_run(kthread_worker_fn,
+				&lo->worker[i], i ? "loop%d-%d" : "loop%d",
+				lo->lo_number, i);
+		if (IS_ERR(lo->worker_task[i]))
+			goto err;
+		set_user_nice(lo->worker_task[i], MIN_NICE);
+		lo->nr_workers++;
+	}
+	atomic_set(&lo->nr_pending, 0);
+	lo->next_worker = 0;
 	return 0;
+
+err:
+	loop_unprepare_queue(lo);
+	return -ENOMEM;
 }
 
 static int loop_set_fd(struct loop_device *lo, fmode_t mode,
@@ -957,7 +992,7 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	if (!(lo_flags & LO_FLAGS_READ_ONLY) && file->f_op->fsync)
 		blk_queue_flush(lo->lo_queue, REQ_FLUSH);
 
-	loop_update_dio(lo);
+	__loop_update_dio(lo, io_is_direct(file) || direct_io);
 	set_capacity(lo->lo_disk, size);
 	bd_set_size(bdev, size << 9);
 	loop_sysfs_init(lo);
@@ -1736,6 +1771,18 @@ int loop_unregister_transfer(int number)
 EXPORT_SYMBOL(loop_register_transfer);
 EXPORT_SYMBOL(loop_unregister_transfer);
 
+static struct kthread_worker *loop_pick_worker(struct loop_device *lo,
+					       struct loop_cmd *cmd)
+{
+	int pending = atomic_inc_return(&lo->nr_pending);
+
+	if (lo->nr_workers == 1 || pending <= deep_queue ||
+	    (cmd->rq->cmd_flags & REQ_FLUSH))
+		return &lo->worker[0];
+
+	return &lo->worker[lo->next_worker++ % lo->nr_workers];
+}
+
 static int loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
@@ -1753,7 +1800,7 @@ static int loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 	else
 		cmd->use_aio = false;
 
-	queue_kthread_work(&lo->worker, &cmd->work);
+	queue_kthread_work(loop_pick_worker(lo, cmd), &cmd->work);
 
 	return BLK_MQ_RQ_QUEUE_OK;
 }
@@ -1780,8 +1827,10 @@ static void loop_queue_work(struct kthread_work *work)
 {
 	struct loop_cmd *cmd =
 		container_of(work, struct loop_cmd, work);
+	struct loop_device *lo = cmd->rq->q->queuedata;
 
 	loop_handle_cmd(cmd);
+	atomic_dec(&lo->nr_pending);
 }
 
 static int loop_init_request(void *data, struct request *rq,
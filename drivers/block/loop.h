@@ -26,6 +26,9 @@ enum {
 
 struct loop_func_table;
 
+/* kthread workers a loop device may spread a deep queue over */
+#define LOOP_MAX_WORKERS	8
+
 struct loop_device {
 	int		lo_number;
 	atomic_t	lo_refcnt;
@@ -56,8 +59,11 @@ struct loop_device {
 	spinlock_t		lo_lock;
 	int			lo_state;
 	struct mutex		lo_ctl_mutex;
-	struct kthread_worker	worker;
-	struct task_struct	*worker_task;
+	struct kthread_worker	worker[LOOP_MAX_WORKERS];
+	struct task_struct	*worker_task[LOOP_MAX_WORKERS];
+	int			nr_workers;
+	unsigned int		next_worker;
+	atomic_t		nr_pending;
 	bool			use_dio;
 	bool			sysfs_inited;
 
@@ -27,6 +27,21 @@ struct nullb_queue {
 	unsigned int queue_depth;
 
 	struct nullb_cmd *cmds;
+	struct nullb *nullb;
+};
+
+/*
+ * State of the device model (irqmode=3). Each channel serves one command
+ * at a time and remembers when it becomes idle; the write cache is a dirty
+ * byte count draining at a fixed rate.
+ */
+struct nullb_model {
+	spinlock_t lock;
+	ktime_t *chan_idle;
+	u32 rnd;
+	u64 dirty;
+	ktime_t dirty_stamp;
+	u64 gc_bytes;
 };
 
 struct nullb {
@@ -42,6 +57,8 @@ struct nullb {
 	struct nullb_queue *queues;
 	unsigned int nr_queues;
 	char disk_name[DISK_NAME_LEN];
+
+	struct nullb_model model;
 };
 
 static LIST_HEAD(nullb_list);
@@ -54,6 +71,7 @@ enum {
 	NULL_IRQ_NONE		= 0,
 	NULL_IRQ_SOFTIRQ	= 1,
 	NULL_IRQ_TIMER		= 2,
+	NULL_IRQ_MODEL		= 3,
 };
 
 enum {
@@ -121,7 +139,7 @@ static int irqmode = NULL_IRQ_SOFTIRQ;
 static int null_set_irqmode(const char *str, const struct kernel_param *kp)
 {
 	return null_param_store_val(str, &irqmode, NULL_IRQ_NONE,
-					NULL_IRQ_TIMER);
+					NULL_IRQ_MODEL);
 }
 
 static const struct kernel_param_ops null_irqmode_param_ops = {
@@ -130,12 +148,64 @@ static const struct kernel_param_ops null_irqmode_param_ops = {
 };
 
 device_param_cb(irqmode, &null_irqmode_param_ops, &irqmode, S_IRUGO);
-MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer, 3-device model");
 
 static unsigned long completion_nsec = 10000;
 module_param(completion_nsec, ulong, S_IRUGO);
 MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
 
+static unsigned long model_read_nsec = 100000;
+module_param(model_read_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_read_nsec, "Device model: base read service time in ns. Default: 100,000ns");
+
+static unsigned long model_write_nsec = 200000;
+module_param(model_write_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_write_nsec, "Device model: base write service time in ns. Default: 200,000ns");
+
+static unsigned long model_xfer_nsec = 2000;
+module_param(model_xfer_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_xfer_nsec, "Device model: transfer time in ns per KB. Default: 2,000ns");
+
+static unsigned int model_jitter_pct = 10;
+module_param(model_jitter_pct, uint, S_IRUGO);
+MODULE_PARM_DESC(model_jitter_pct, "Device model: uniform +/- jitter on the service time in percent. Default: 10");
+
+static unsigned int model_tail_ppm;
+module_param(model_tail_ppm, uint, S_IRUGO);
+MODULE_PARM_DESC(model_tail_ppm, "Device model: commands per million that take model_tail_nsec longer. Default: 0");
+
+static unsigned long model_tail_nsec = 10000000;
+module_param(model_tail_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_tail_nsec, "Device model: extra service time of a tail command in ns. Default: 10,000,000ns");
+
+static unsigned int model_channels = 4;
+module_param(model_channels, uint, S_IRUGO);
+MODULE_PARM_DESC(model_channels, "Device model: commands the device serves in parallel. Default: 4");
+
+static unsigned int model_wcache_kb;
+module_param(model_wcache_kb, uint, S_IRUGO);
+MODULE_PARM_DESC(model_wcache_kb, "Device model: volatile write cache size in KB, 0 disables it. Default: 0");
+
+static unsigned long model_wcache_nsec = 20000;
+module_param(model_wcache_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_wcache_nsec, "Device model: service time of a write absorbed by the cache in ns. Default: 20,000ns");
+
+static unsigned int model_wcache_drain_mbps = 100;
+module_param(model_wcache_drain_mbps, uint, S_IRUGO);
+MODULE_PARM_DESC(model_wcache_drain_mbps, "Device model: write cache destage rate in MB/s. Default: 100");
+
+static unsigned int model_gc_interval_kb;
+module_param(model_gc_interval_kb, uint, S_IRUGO);
+MODULE_PARM_DESC(model_gc_interval_kb, "Device model: stall all channels every this many KB written, 0 disables GC. Default: 0");
+
+static unsigned long model_gc_nsec = 5000000;
+module_param(model_gc_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(model_gc_nsec, "Device model: length of a garbage collection stall in ns. Default: 5,000,000ns");
+
+static unsigned int model_seed = 1;
+module_param(model_seed, uint, S_IRUGO);
+MODULE_PARM_DESC(model_seed, "Device model: seed of the jitter and tail generator. Default: 1");
+
 static int hw_queue_depth = 64;
 module_param(hw_queue_depth, int, S_IRUGO);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
@@ -172,6 +242,11 @@ static void free_cmd(struct nullb_cmd *cmd)
 
 static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer);
 
+static inline bool null_irq_uses_timer(void)
+{
+	return irqmode == NULL_IRQ_TIMER || irqmode == NULL_IRQ_MODEL;
+}
+
 static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
 {
 	struct nullb_cmd *cmd;
@@ -182,7 +257,7 @@ static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
 		cmd = &nq->cmds[tag];
 		cmd->tag = tag;
 		cmd->nq = nq;
-		if (irqmode == NULL_IRQ_TIMER) {
+		if (null_irq_uses_timer()) {
 			hrtimer_init(&cmd->timer, CLOCK_MONOTONIC,
 				     HRTIMER_MODE_REL);
 			cmd->timer.function = null_cmd_timer_expired;
@@ -261,6 +336,152 @@ static void null_cmd_end_timer(struct nullb_cmd *cmd)
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
 
+/* xorshift32, so that a given seed and workload replay the same latencies */
+static u32 null_model_rand(struct nullb_model *m)
+{
+	u32 x = m->rnd;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m->rnd = x;
+	return x;
+}
+
+static u64 null_model_service(struct nullb_model *m, int rw,
+			      unsigned int bytes)
+{
+	u64 t = rw == WRITE ? model_write_nsec : model_read_nsec;
+	u64 delta;
+
+	t += (u64)(bytes >> 10) * model_xfer_nsec;
+	if (model_jitter_pct) {
+		delta = div_u64(t * min(model_jitter_pct, 100U), 100);
+		t = t - delta + (null_model_rand(m) % (2 * delta + 1));
+	}
+	if (model_tail_ppm && null_model_rand(m) % 1000000 < model_tail_ppm)
+		t += model_tail_nsec;
+	return t;
+}
+
+/* Destage the write cache at model_wcache_drain_mbps since the last call */
+static void null_model_drain(struct nullb_model *m, ktime_t now)
+{
+	u64 drained;
+
+	drained = ktime_us_delta(now, m->dirty_stamp) *
+		  (u64)model_wcache_drain_mbps;
+	m->dirty = drained >= m->dirty ? 0 : m->dirty - drained;
+	m->dirty_stamp = now;
+}
+
+/* Every model_gc_interval_kb written, the whole device stalls */
+static void null_model_gc(struct nullb_model *m, ktime_t now,
+			  unsigned int bytes)
+{
+	ktime_t idle = now;
+	int i;
+
+	if (!model_gc_interval_kb)
+		return;
+
+	m->gc_bytes += bytes;
+	if (m->gc_bytes < (u64)model_gc_interval_kb << 10)
+		return;
+	m->gc_bytes -= (u64)model_gc_interval_kb << 10;
+
+	for (i = 0; i < model_channels; i++)
+		idle = ktime_compare(m->chan_idle[i], idle) > 0 ?
+			m->chan_idle[i] : idle;
+	idle = ktime_add_ns(idle, model_gc_nsec);
+	for (i = 0; i < model_channels; i++)
+		m->chan_idle[i] = idle;
+}
+
+/*
+ * Work out when the device would complete the command: flushes wait for
+ * the write cache to drain, writes that fit in the cache are acked right
+ * away and everything else queues on the first channel to go idle.
+ */
+static ktime_t null_model_expiry(struct nullb *nullb, int rw,
+				 unsigned int bytes, u64 flags)
+{
+	struct nullb_model *m = &nullb->model;
+	ktime_t now = ktime_get();
+	ktime_t done, start;
+	unsigned long irqflags;
+	int i, chan = 0;
+
+	spin_lock_irqsave(&m->lock, irqflags);
+	if (model_wcache_kb)
+		null_model_drain(m, now);
+
+	if (!bytes) {
+		done = now;
+		if (flags & REQ_FLUSH) {
+			done = ktime_add_us(now, div_u64(m->dirty,
+					    max(model_wcache_drain_mbps, 1U)));
+			m->dirty = 0;
+		}
+		goto out;
+	}
+
+	if (rw == WRITE) {
+		null_model_gc(m, now, bytes);
+		if (model_wcache_kb && !(flags & REQ_FUA) &&
+		    m->dirty + bytes <= (u64)model_wcache_kb << 10) {
+			m->dirty += bytes;
+			done = ktime_add_ns(now, model_wcache_nsec);
+			goto out;
+		}
+	}
+
+	for (i = 1; i < model_channels; i++)
+		if (ktime_compare(m->chan_idle[i], m->chan_idle[chan]) < 0)
+			chan = i;
+	start = ktime_compare(m->chan_idle[chan], now) > 0 ?
+		m->chan_idle[chan] : now;
+	done = ktime_add_ns(start, null_model_service(m, rw, bytes));
+	m->chan_idle[chan] = done;
+out:
+	spin_unlock_irqrestore(&m->lock, irqflags);
+	return done;
+}
+
+static void null_cmd_end_model(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd->nq->nullb;
+	ktime_t kt;
+
+	if (cmd->rq)
+		kt = null_model_expiry(nullb, rq_data_dir(cmd->rq),
+				       blk_rq_bytes(cmd->rq),
+				       cmd->rq->cmd_flags);
+	else
+		kt = null_model_expiry(nullb, bio_data_dir(cmd->bio),
+				       cmd->bio->bi_iter.bi_size,
+				       cmd->bio->bi_rw);
+
+	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_ABS);
+}
+
+static int null_model_init(struct nullb *nullb)
+{
+	struct nullb_model *m = &nullb->model;
+
+	spin_lock_init(&m->lock);
+	m->chan_idle = kcalloc(model_channels, sizeof(*m->chan_idle),
+			       GFP_KERNEL);
+	if (!m->chan_idle)
+		return -ENOMEM;
+	m->rnd = model_seed ?: 1;
+	m->dirty_stamp = ktime_get();
+
+	if (model_wcache_kb)
+		blk_queue_flush(nullb->q, REQ_FLUSH | REQ_FUA);
+	return 0;
+}
+
 static void null_softirq_done_fn(struct request *rq)
 {
 	if (queue_mode == NULL_Q_MQ)
@@ -295,6 +516,9 @@ static inline void null_handle_cmd(struct nullb_cmd *cmd)
 	case NULL_IRQ_TIMER:
 		null_cmd_end_timer(cmd);
 		break;
+	case NULL_IRQ_MODEL:
+		null_cmd_end_model(cmd);
+		break;
 	}
 }
 
@@ -356,7 +580,7 @@ static int null_queue_rq(struct blk_mq_hw_ctx *hctx,
 {
 	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(bd->rq);
 
-	if (irqmode == NULL_IRQ_TIMER) {
+	if (null_irq_uses_timer()) {
 		hrtimer_init(&cmd->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 		cmd->timer.function = null_cmd_timer_expired;
 	}
@@ -376,6 +600,7 @@ static void null_init_queue(struct nullb *nullb, struct nullb_queue *nq)
 
 	init_waitqueue_head(&nq->wait);
 	nq->queue_depth = nullb->queue_depth;
+	nq->nullb = nullb;
 }
 
 static int null_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
@@ -428,6 +653,7 @@ static void null_del_dev(struct nullb *nullb)
 	if (!use_lightnvm)
 		put_disk(nullb->disk);
 	cleanup_queues(nullb);
+	kfree(nullb->model.chan_idle);
 	kfree(nullb);
 }
 
@@ -708,6 +934,11 @@ static int null_add_dev(void)
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, nullb->q);
 
+	if (irqmode == NULL_IRQ_MODEL) {
+		rv = null_model_init(nullb);
+		if (rv)
+			goto out_cleanup_blk_queue;
+	}
 
 	mutex_lock(&lock);
 	list_add_tail(&nullb->list, &nullb_list);
@@ -758,6 +989,7 @@ out_cleanup_tags:
 out_cleanup_queues:
 	cleanup_queues(nullb);
 out_free_nullb:
+	kfree(nullb->model.chan_idle);
 	kfree(nullb);
 out:
 	return rv;
@@ -798,6 +1030,11 @@ static int __init null_init(void)
 	else if (!submit_queues)
 		submit_queues = 1;
 
+	if (irqmode == NULL_IRQ_MODEL && !model_channels) {
+		pr_warn("null_blk: model_channels must be at least 1\n");
+		model_channels = 1;
+	}
+
 	mutex_init(&lock);
 
 	null_major = register_blkdev(0, "nullb");
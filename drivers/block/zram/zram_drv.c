@@ -32,6 +32,12 @@
 #include <linux/idr.h>
 #include <linux/sysfs.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpumask.h>
+#include <linux/workqueue.h>
+#include <linux/semaphore.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 
 #include "zram_drv.h"
 
@@ -132,6 +138,30 @@ static void zram_set_obj_size(struct zram *zram,
 	zram->table[index].flags = (flags << ZRAM_FLAG_SHIFT) | size;
 }
 
+/* zsmalloc handle of the slot's object, resolving shared dedup entries */
+static unsigned long zram_get_zs_handle(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		struct zram_dedup_entry *entry;
+
+		entry = (struct zram_dedup_entry *)zram_get_handle(zram, index);
+		return entry->handle;
+	}
+#endif
+	return zram_get_handle(zram, index);
+}
+
+/* zcomp backend the slot's object was compressed with */
+static inline struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		return zram->recomp;
+#endif
+	return zram->comp;
+}
+
 static inline bool zram_allocated(struct zram *zram, u32 index)
 {
 	return zram_get_obj_size(zram, index) ||
@@ -395,6 +425,8 @@ static ssize_t writeback_limit_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static void zram_bd_cache_drop(struct zram *zram);
+
 static void reset_bdev(struct zram *zram)
 {
 	struct block_device *bdev;
@@ -402,6 +434,8 @@ static void reset_bdev(struct zram *zram)
 	if (!zram->backing_dev)
 		return;
 
+	zram_bd_cache_drop(zram);
+
 	bdev = zram->bdev;
 	if (zram->old_block_size)
 		set_blocksize(bdev, zram->old_block_size);
@@ -550,6 +584,261 @@ out:
 	return err;
 }
 
+/* Max number of blocks read around a backing device read */
+#define ZRAM_BD_RA_MAX_PAGES	32
+/* Max number of blocks kept in the read-around cache */
+#define ZRAM_BD_CACHE_PAGES	128
+
+struct zram_bd_cache_entry {
+	struct list_head lru;
+	unsigned long blk_idx;
+	struct page *page;
+	bool pending;	/* read-ahead bio not completed yet */
+	bool stale;	/* removed while pending, freed on completion */
+};
+
+static void zram_bd_cache_free(struct zram_bd_cache_entry *entry)
+{
+	__free_page(entry->page);
+	kfree(entry);
+}
+
+/* Unlink an entry; entries still under read are freed on completion */
+static void zram_bd_cache_remove(struct zram *zram,
+				struct zram_bd_cache_entry *entry)
+{
+	radix_tree_delete(&zram->bd_cache_tree, entry->blk_idx);
+	list_del(&entry->lru);
+	zram->bd_cache_nr--;
+
+	if (entry->pending)
+		entry->stale = true;
+	else
+		zram_bd_cache_free(entry);
+}
+
+static void zram_bd_cache_invalidate(struct zram *zram, unsigned long blk_idx)
+{
+	struct zram_bd_cache_entry *entry;
+	unsigned long flags;
+
+	if (!READ_ONCE(zram->bd_cache_nr))
+		return;
+
+	spin_lock_irqsave(&zram->bd_cache_lock, flags);
+	entry = radix_tree_lookup(&zram->bd_cache_tree, blk_idx);
+	if (entry)
+		zram_bd_cache_remove(zram, entry);
+	spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+}
+
+static void zram_bd_cache_drop(struct zram *zram)
+{
+	struct zram_bd_cache_entry *entry, *tmp;
+	unsigned long flags;
+
+	wait_event(zram->bd_ra_wait, !atomic_read(&zram->bd_ra_inflight));
+
+	spin_lock_irqsave(&zram->bd_cache_lock, flags);
+	list_for_each_entry_safe(entry, tmp, &zram->bd_cache_lru, lru)
+		zram_bd_cache_remove(zram, entry);
+	spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+}
+
+/*
+ * Copy a cached block into @bvec and drop it from the cache: the caller
+ * now holds the data, so a second read of the slot is unlikely.
+ * Returns true on hit.
+ */
+static bool zram_bd_cache_read(struct zram *zram, struct bio_vec *bvec,
+				unsigned long blk_idx)
+{
+	struct zram_bd_cache_entry *entry;
+	unsigned long flags;
+	bool hit = false;
+
+	if (!READ_ONCE(zram->bd_ra_pages) && !READ_ONCE(zram->bd_cache_nr))
+		return false;
+
+	spin_lock_irqsave(&zram->bd_cache_lock, flags);
+	entry = radix_tree_lookup(&zram->bd_cache_tree, blk_idx);
+	if (entry && !entry->pending) {
+		void *src, *dst;
+
+		dst = kmap_atomic(bvec->bv_page);
+		src = kmap_atomic(entry->page);
+		memcpy(dst + bvec->bv_offset, src, bvec->bv_len);
+		kunmap_atomic(src);
+		kunmap_atomic(dst);
+		zram_bd_cache_remove(zram, entry);
+		hit = true;
+	}
+	spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+
+	if (hit)
+		atomic64_inc(&zram->stats.bd_cache_hits);
+	else
+		atomic64_inc(&zram->stats.bd_cache_misses);
+
+	return hit;
+}
+
+/* Insert a pending entry for @blk_idx, evicting the oldest ones if full */
+static struct zram_bd_cache_entry *zram_bd_cache_add(struct zram *zram,
+						unsigned long blk_idx)
+{
+	struct zram_bd_cache_entry *entry, *tmp, *next;
+	unsigned long flags;
+	int err;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOWAIT | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->page = alloc_page(GFP_NOWAIT | __GFP_NOWARN);
+	if (!entry->page) {
+		kfree(entry);
+		return NULL;
+	}
+
+	entry->blk_idx = blk_idx;
+	entry->pending = true;
+	entry->stale = false;
+	set_page_private(entry->page, (unsigned long)entry);
+
+	spin_lock_irqsave(&zram->bd_cache_lock, flags);
+	err = radix_tree_insert(&zram->bd_cache_tree, blk_idx, entry);
+	if (err) {
+		spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+		zram_bd_cache_free(entry);
+		return NULL;
+	}
+
+	list_add(&entry->lru, &zram->bd_cache_lru);
+	zram->bd_cache_nr++;
+
+	/* the new entry is pending so it can't be evicted here */
+	list_for_each_entry_safe_reverse(tmp, next, &zram->bd_cache_lru, lru) {
+		if (zram->bd_cache_nr <= ZRAM_BD_CACHE_PAGES)
+			break;
+		if (!tmp->pending)
+			zram_bd_cache_remove(zram, tmp);
+	}
+	spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+
+	return entry;
+}
+
+static void zram_bd_ra_end_io(struct bio *bio)
+{
+	struct zram *zram = bio->bi_private;
+	struct bio_vec *bvec;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&zram->bd_cache_lock, flags);
+	bio_for_each_segment_all(bvec, bio, i) {
+		struct zram_bd_cache_entry *entry;
+
+		entry = (struct zram_bd_cache_entry *)page_private(bvec->bv_page);
+		entry->pending = false;
+		if (entry->stale)
+			zram_bd_cache_free(entry);
+		else if (bio->bi_error)
+			zram_bd_cache_remove(zram, entry);
+	}
+	spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&zram->bd_ra_inflight))
+		wake_up(&zram->bd_ra_wait);
+}
+
+/*
+ * Read the run of written-back blocks following @blk_idx into the
+ * read-around cache with a single low priority bio. Neighbouring slots
+ * are likely to be faulted in soon and writeback lays them out
+ * contiguously.
+ */
+static void zram_bd_readahead(struct zram *zram, unsigned long blk_idx)
+{
+	unsigned int ra_pages = READ_ONCE(zram->bd_ra_pages);
+	struct zram_bd_cache_entry *entries[ZRAM_BD_RA_MAX_PAGES];
+	unsigned int i, nr = 0;
+	unsigned long blk;
+	struct bio *bio;
+
+	for (blk = blk_idx + 1; nr < ra_pages && blk < zram->nr_pages; blk++) {
+		if (!test_bit(blk, zram->bitmap))
+			break;
+
+		entries[nr] = zram_bd_cache_add(zram, blk);
+		if (!entries[nr])
+			break;
+		nr++;
+	}
+
+	if (!nr)
+		return;
+
+	bio = bio_alloc(GFP_NOWAIT | __GFP_NOWARN, nr);
+	if (!bio)
+		goto error;
+
+	bio->bi_iter.bi_sector = (blk_idx + 1) * (PAGE_SIZE >> 9);
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bd_ra_end_io;
+	bio->bi_private = zram;
+	for (i = 0; i < nr; i++) {
+		if (!bio_add_page(bio, entries[i]->page, PAGE_SIZE, 0)) {
+			bio_put(bio);
+			goto error;
+		}
+	}
+
+	atomic_inc(&zram->bd_ra_inflight);
+	atomic64_add(nr, &zram->stats.bd_ra_reads);
+	submit_bio(READA, bio);
+	return;
+
+error:
+	for (i = 0; i < nr; i++) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&zram->bd_cache_lock, flags);
+		entries[i]->pending = false;
+		if (entries[i]->stale)
+			zram_bd_cache_free(entries[i]);
+		else
+			zram_bd_cache_remove(zram, entries[i]);
+		spin_unlock_irqrestore(&zram->bd_cache_lock, flags);
+	}
+}
+
+static ssize_t bd_readahead_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val) || val > ZRAM_BD_RA_MAX_PAGES)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->bd_ra_pages, val);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t bd_readahead_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(zram->bd_ra_pages));
+}
+
 static unsigned long alloc_block_bdev(struct zram *zram)
 {
 	unsigned long blk_idx = 1;
@@ -570,6 +859,7 @@ static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
 {
 	int was_set;
 
+	zram_bd_cache_invalidate(zram, blk_idx);
 	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
 	WARN_ON_ONCE(!was_set);
 	atomic64_dec(&zram->stats.bd_count);
@@ -614,20 +904,168 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 	return 1;
 }
 
+static unsigned long alloc_block_bdev_next(struct zram *zram,
+					unsigned long blk_idx)
+{
+	if (blk_idx >= zram->nr_pages || test_and_set_bit(blk_idx, zram->bitmap))
+		return 0;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
 #define HUGE_WRITEBACK 1
 #define IDLE_WRITEBACK 2
 
+/* Max pages per writeback bio and max writeback bios in flight */
+#define ZRAM_WB_BIO_PAGES	32
+#define ZRAM_WB_MAX_INFLIGHT	8
+
+struct zram_wb_ctl {
+	struct zram *zram;
+	/* bounds the number of bios in flight, drained before returning */
+	struct semaphore inflight;
+};
+
+/* One writeback bio covering nr_pages contiguous blocks from blk_idx */
+struct zram_wb_req {
+	struct work_struct work;
+	struct zram_wb_ctl *ctl;
+	struct bio *bio;
+	unsigned long blk_idx;
+	unsigned int nr_pages;
+	u32 index[ZRAM_WB_BIO_PAGES];
+};
+
+static void zram_wb_abort_slot(struct zram *zram, u32 index)
+{
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_slot_unlock(zram, index);
+}
+
+static void zram_wb_complete(struct work_struct *work)
+{
+	struct zram_wb_req *req = container_of(work, struct zram_wb_req, work);
+	struct zram_wb_ctl *ctl = req->ctl;
+	struct zram *zram = ctl->zram;
+	struct bio *bio = req->bio;
+	struct bio_vec *bvec;
+	int i;
+
+	for (i = 0; i < req->nr_pages; i++) {
+		u32 index = req->index[i];
+		unsigned long blk_idx = req->blk_idx + i;
+
+		/* Drop anything read around the block before it was written */
+		zram_bd_cache_invalidate(zram, blk_idx);
+		if (bio->bi_error) {
+			zram_wb_abort_slot(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		atomic64_inc(&zram->stats.bd_writes);
+		/*
+		 * We released zram_slot_lock so need to check if the slot was
+		 * changed. If there is freeing for the slot, we can catch it
+		 * easily by zram_allocated.
+		 * A subtle case is the slot is freed/reallocated/marked as
+		 * ZRAM_IDLE again. To close the race, idle_store doesn't
+		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+		 * Thus, we could close the race by checking ZRAM_IDLE bit.
+		 */
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, blk_idx);
+		atomic64_inc(&zram->stats.pages_stored);
+		spin_lock(&zram->wb_limit_lock);
+		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+		spin_unlock(&zram->wb_limit_lock);
+		zram_slot_unlock(zram, index);
+	}
+
+	bio_for_each_segment_all(bvec, bio, i)
+		__free_page(bvec->bv_page);
+	bio_put(bio);
+	kfree(req);
+
+	/* ctl may go away as soon as the last request is released */
+	up(&ctl->inflight);
+}
+
+/*
+ * Slots are freed in process context: zram_free_page() and zs_free()
+ * must not be called from the bio completion interrupt.
+ */
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_req *req = bio->bi_private;
+
+	INIT_WORK(&req->work, zram_wb_complete);
+	queue_work(system_unbound_wq, &req->work);
+}
+
+static struct zram_wb_req *zram_wb_req_alloc(struct zram_wb_ctl *ctl,
+					unsigned long blk_idx)
+{
+	struct zram *zram = ctl->zram;
+	struct zram_wb_req *req;
+
+	req = kmalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return NULL;
+
+	req->bio = bio_alloc(GFP_KERNEL, ZRAM_WB_BIO_PAGES);
+	if (!req->bio) {
+		kfree(req);
+		return NULL;
+	}
+
+	req->ctl = ctl;
+	req->blk_idx = blk_idx;
+	req->nr_pages = 0;
+	req->bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
+	req->bio->bi_bdev = zram->bdev;
+	req->bio->bi_end_io = zram_wb_end_io;
+	req->bio->bi_private = req;
+
+	return req;
+}
+
+static void zram_wb_req_submit(struct zram_wb_ctl *ctl,
+				struct zram_wb_req *req)
+{
+	down(&ctl->inflight);
+	submit_bio(WRITE, req->bio);
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
 	unsigned long index;
-	struct bio bio;
-	struct page *page;
+	struct zram_wb_ctl ctl;
+	struct zram_wb_req *req = NULL;
+	struct blk_plug plug;
+	struct page *page = NULL;
 	ssize_t ret;
-	int mode;
-	unsigned long blk_idx = 0;
+	int mode, i;
+	unsigned long blk_idx;
 
 	if (sysfs_streq(buf, "idle"))
 		mode = IDLE_WRITEBACK;
@@ -647,15 +1085,21 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
-		ret = -ENOMEM;
-		goto release_init_lock;
-	}
+	ctl.zram = zram;
+	sema_init(&ctl.inflight, ZRAM_WB_MAX_INFLIGHT);
 
+	blk_start_plug(&plug);
 	for (index = 0; index < nr_pages; index++) {
 		struct bio_vec bvec;
 
+		if (!page) {
+			page = alloc_page(GFP_KERNEL);
+			if (!page) {
+				ret = -ENOMEM;
+				break;
+			}
+		}
+
 		bvec.bv_page = page;
 		bvec.bv_len = PAGE_SIZE;
 		bvec.bv_offset = 0;
@@ -668,14 +1112,6 @@ static ssize_t writeback_store(struct device *dev,
 		}
 		spin_unlock(&zram->wb_limit_lock);
 
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
-
 		zram_slot_lock(zram, index);
 		if (!zram_allocated(zram, index))
 			goto next;
@@ -700,71 +1136,67 @@ static ssize_t writeback_store(struct device *dev,
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
 		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
+			zram_wb_abort_slot(zram, index);
 			continue;
 		}
 
-		bio_init(&bio);
+		/* Extend the current bio if the next block is free */
+		blk_idx = 0;
+		if (req && req->nr_pages < ZRAM_WB_BIO_PAGES)
+			blk_idx = alloc_block_bdev_next(zram,
+					req->blk_idx + req->nr_pages);
+		if (!blk_idx) {
+			if (req) {
+				zram_wb_req_submit(&ctl, req);
+				req = NULL;
+			}
 
-		bio.bi_max_vecs = 1;
-		bio.bi_io_vec = &bvec;
-		bio.bi_bdev = zram->bdev;
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				zram_wb_abort_slot(zram, index);
+				ret = -ENOSPC;
+				break;
+			}
 
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
-				bvec.bv_offset);
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		ret = submit_bio_wait(REQ_WRITE|REQ_SYNC, &bio);
-		if (ret) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
+			req = zram_wb_req_alloc(&ctl, blk_idx);
+			if (!req) {
+				free_block_bdev(zram, blk_idx);
+				zram_wb_abort_slot(zram, index);
+				ret = -ENOMEM;
+				break;
+			}
 		}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+		if (WARN_ON(!bio_add_page(req->bio, page, PAGE_SIZE, 0))) {
+			free_block_bdev(zram, blk_idx);
+			zram_wb_abort_slot(zram, index);
+			continue;
 		}
-
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
+		req->index[req->nr_pages++] = index;
+		/* the page now belongs to the bio */
+		page = NULL;
+		continue;
 next:
 		zram_slot_unlock(zram, index);
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
+	if (req) {
+		if (req->nr_pages)
+			zram_wb_req_submit(&ctl, req);
+		else {
+			bio_put(req->bio);
+			kfree(req);
+		}
+	}
+	blk_finish_plug(&plug);
+
+	/* Wait for all the in-flight bios to be completed */
+	for (i = 0; i < ZRAM_WB_MAX_INFLIGHT; i++)
+		down(&ctl.inflight);
+
+	if (page)
+		__free_page(page);
 	ret = len;
-	__free_page(page);
 release_init_lock:
 	up_read(&zram->init_lock);
 
@@ -823,11 +1255,21 @@ static int read_from_bdev_sync(struct zram *zram, struct bio_vec *bvec,
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
+	int ret;
+
+	if (zram_bd_cache_read(zram, bvec, entry))
+		return 0;
+
 	atomic64_inc(&zram->stats.bd_reads);
 	if (sync)
-		return read_from_bdev_sync(zram, bvec, entry, parent);
+		ret = read_from_bdev_sync(zram, bvec, entry, parent);
 	else
-		return read_from_bdev_async(zram, bvec, entry, parent);
+		ret = read_from_bdev_async(zram, bvec, entry, parent);
+
+	if (ret > 0 && READ_ONCE(zram->bd_ra_pages))
+		zram_bd_readahead(zram, entry);
+
+	return ret;
 }
 #else
 static inline void reset_bdev(struct zram *zram) {};
@@ -897,13 +1339,15 @@ static ssize_t read_block_state(struct file *file, char __user *buf,
 
 		ts = ktime_to_timespec64(zram->table[index].ac_time);
 		copied = snprintf(kbuf + written, count,
-			"%12zd %12lld.%06lu %c%c%c%c\n",
+			"%12zd %12lld.%06lu %c%c%c%c%c%c\n",
 			index, (s64)ts.tv_sec,
 			ts.tv_nsec / NSEC_PER_USEC,
 			zram_test_flag(zram, index, ZRAM_SAME) ? 's' : '.',
 			zram_test_flag(zram, index, ZRAM_WB) ? 'w' : '.',
 			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.',
-			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.');
+			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.',
+			zram_test_flag(zram, index, ZRAM_RECOMP) ? 'r' : '.',
+			zram_test_flag(zram, index, ZRAM_DEDUP) ? 'd' : '.');
 
 		if (count < copied) {
 			zram_slot_unlock(zram, index);
@@ -930,6 +1374,152 @@ static const struct file_operations proc_zram_block_state_op = {
 	.llseek = default_llseek,
 };
 
+/* Encode a slot as a block_age byte, see ZRAM_AGE_* */
+static u8 zram_slot_age(struct zram *zram, u32 index, ktime_t now)
+{
+	unsigned int bucket;
+	s64 age;
+	u8 val;
+
+	zram_slot_lock(zram, index);
+	if (!zram_allocated(zram, index)) {
+		zram_slot_unlock(zram, index);
+		return 0;
+	}
+
+	age = ktime_divns(ktime_sub(now, zram->table[index].ac_time),
+			NSEC_PER_SEC);
+	bucket = age > 0 ? ilog2(age + 1) : 0;
+	val = min_t(unsigned int, bucket, ZRAM_AGE_BUCKETS - 1) |
+		ZRAM_AGE_ALLOCATED;
+	if (zram_test_flag(zram, index, ZRAM_IDLE))
+		val |= ZRAM_AGE_IDLE;
+	if (zram_test_flag(zram, index, ZRAM_HUGE))
+		val |= ZRAM_AGE_HUGE;
+	if (zram_test_flag(zram, index, ZRAM_WB))
+		val |= ZRAM_AGE_WB;
+	zram_slot_unlock(zram, index);
+
+	return val;
+}
+
+/*
+ * Binary per-slot view of block_state: byte N of the file describes
+ * slot N, so userspace can seek and read the whole table in one go
+ * instead of parsing text.
+ */
+static ssize_t read_block_age(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	u8 *kbuf;
+	ssize_t index, written = 0;
+	struct zram *zram = file->private_data;
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	gfp_t kmalloc_flags;
+	ktime_t now;
+
+	if (*ppos >= nr_pages)
+		return 0;
+
+	count = min_t(size_t, count, nr_pages - *ppos);
+	kmalloc_flags = GFP_KERNEL;
+	if (count > PAGE_SIZE)
+		kmalloc_flags |= __GFP_NOWARN | __GFP_NORETRY;
+
+	kbuf = kmalloc_node(count, kmalloc_flags, NUMA_NO_NODE);
+	if (!kbuf && count > PAGE_SIZE)
+		kbuf = vmalloc(count);
+
+	if (!kbuf)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		kvfree(kbuf);
+		return -EINVAL;
+	}
+
+	now = ktime_get_boottime();
+	for (index = *ppos; index < nr_pages && written < count; index++)
+		kbuf[written++] = zram_slot_age(zram, index, now);
+	up_read(&zram->init_lock);
+
+	if (copy_to_user(buf, kbuf, written))
+		written = -EFAULT;
+	else
+		*ppos += written;
+	kvfree(kbuf);
+
+	return written;
+}
+
+static const struct file_operations proc_zram_block_age_op = {
+	.open = simple_open,
+	.read = read_block_age,
+	.llseek = default_llseek,
+};
+
+/*
+ * Aggregate of block_age: for each age bucket, the lower bound of the
+ * bucket in seconds and the number of stored, idle, huge and
+ * written-back pages.
+ */
+static int zram_age_histogram_show(struct seq_file *m, void *v)
+{
+	struct zram *zram = m->private;
+	unsigned long hist[ZRAM_AGE_BUCKETS][4];
+	unsigned long nr_pages, index;
+	ktime_t now;
+	int i;
+
+	memset(hist, 0, sizeof(hist));
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	now = ktime_get_boottime();
+	for (index = 0; index < nr_pages; index++) {
+		u8 val = zram_slot_age(zram, index, now);
+		unsigned int bucket = val & ZRAM_AGE_MASK;
+
+		if (!(val & ZRAM_AGE_ALLOCATED))
+			continue;
+
+		hist[bucket][0]++;
+		if (val & ZRAM_AGE_IDLE)
+			hist[bucket][1]++;
+		if (val & ZRAM_AGE_HUGE)
+			hist[bucket][2]++;
+		if (val & ZRAM_AGE_WB)
+			hist[bucket][3]++;
+	}
+	up_read(&zram->init_lock);
+
+	for (i = 0; i < ZRAM_AGE_BUCKETS; i++)
+		seq_printf(m, "%8lu %8lu %8lu %8lu %8lu\n",
+			(1UL << i) - 1, hist[i][0], hist[i][1],
+			hist[i][2], hist[i][3]);
+
+	return 0;
+}
+
+static int zram_age_histogram_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zram_age_histogram_show, inode->i_private);
+}
+
+static const struct file_operations proc_zram_age_histogram_op = {
+	.open = zram_age_histogram_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void zram_debugfs_register(struct zram *zram)
 {
 	if (!zram_debugfs_root)
@@ -939,6 +1529,10 @@ static void zram_debugfs_register(struct zram *zram)
 						zram_debugfs_root);
 	debugfs_create_file("block_state", 0400, zram->debugfs_dir,
 				zram, &proc_zram_block_state_op);
+	debugfs_create_file("block_age", 0400, zram->debugfs_dir,
+				zram, &proc_zram_block_age_op);
+	debugfs_create_file("age_histogram", 0400, zram->debugfs_dir,
+				zram, &proc_zram_age_histogram_op);
 }
 
 static void zram_debugfs_unregister(struct zram *zram)
@@ -987,36 +1581,260 @@ static ssize_t comp_algorithm_show(struct device *dev,
 	sz = zcomp_available_show(zram->compressor, buf);
 	up_read(&zram->init_lock);
 
-	return sz;
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->compressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	/* an empty string disables recompression */
+	if (compressor[0] && !zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_algorithm, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+/*
+ * Recompress the object of a slot with the secondary algorithm and
+ * replace it if the result is smaller. The object is first decompressed
+ * into @page. The caller must hold the slot lock, so nothing here may
+ * sleep.
+ *
+ * Returns 0 if the slot now holds a recompressed object.
+ */
+static int zram_recompress_slot(struct zram *zram, u32 index,
+				struct page *page)
+{
+	unsigned long handle, new_handle;
+	unsigned int comp_len, new_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret = 0;
+
+	handle = zram_get_handle(zram, index);
+	comp_len = zram_get_obj_size(zram, index);
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	if (comp_len == PAGE_SIZE) {
+		memcpy(dst, src, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		ret = zcomp_decompress(zstrm, src, comp_len, dst);
+		zcomp_stream_put(zram->comp);
+	}
+	kunmap_atomic(dst);
+	zs_unmap_object(zram->mem_pool, handle);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &new_len);
+	kunmap_atomic(src);
+	if (ret)
+		goto out;
+
+	/* Not worth it, keep the object compressed by the primary one */
+	if (new_len >= huge_class_size || new_len >= comp_len) {
+		ret = -E2BIG;
+		goto out;
+	}
+
+	new_handle = zs_malloc(zram->mem_pool, new_len,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!new_handle) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, new_len);
+	zs_unmap_object(zram->mem_pool, new_handle);
+	zcomp_stream_put(zram->recomp);
+
+	update_used_max(zram, zs_get_total_pages(zram->mem_pool));
+	zs_free(zram->mem_pool, handle);
+	atomic64_sub(comp_len, &zram->stats.compr_data_size);
+	atomic64_add(new_len, &zram->stats.compr_data_size);
+
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, new_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	atomic64_inc(&zram->stats.recomp_pages);
+	return 0;
+out:
+	zcomp_stream_put(zram->recomp);
+	return ret;
+}
+
+#define RECOMPRESS_IDLE	(1 << 0)
+#define RECOMPRESS_HUGE	(1 << 1)
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct page *page;
+	ssize_t ret = len;
+	int mode;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = RECOMPRESS_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = RECOMPRESS_HUGE;
+	else if (sysfs_streq(buf, "huge_idle"))
+		mode = RECOMPRESS_IDLE | RECOMPRESS_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->recomp) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_RECOMP) ||
+				zram_test_flag(zram, index, ZRAM_DEDUP))
+			goto next;
+
+		if ((mode & RECOMPRESS_IDLE) &&
+			  !zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+		if ((mode & RECOMPRESS_HUGE) &&
+			  !zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		zram_recompress_slot(zram, index, page);
+next:
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
 }
 
-static ssize_t comp_algorithm_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
+static int zram_recomp_create(struct zram *zram)
 {
-	struct zram *zram = dev_to_zram(dev);
-	char compressor[ARRAY_SIZE(zram->compressor)];
-	size_t sz;
-
-	strlcpy(compressor, buf, sizeof(compressor));
-	/* ignore trailing newline */
-	sz = strlen(compressor);
-	if (sz > 0 && compressor[sz - 1] == '\n')
-		compressor[sz - 1] = 0x00;
+	struct zcomp *comp;
 
-	if (!zcomp_available_algorithm(compressor))
-		return -EINVAL;
+	if (!zram->recomp_algorithm[0])
+		return 0;
 
-	down_write(&zram->init_lock);
-	if (init_done(zram)) {
-		up_write(&zram->init_lock);
-		pr_info("Can't change algorithm for initialized device\n");
-		return -EBUSY;
+	comp = zcomp_create(zram->recomp_algorithm);
+	if (IS_ERR(comp)) {
+		pr_err("Cannot initialise %s recompressing backend\n",
+				zram->recomp_algorithm);
+		return PTR_ERR(comp);
 	}
 
-	strcpy(zram->compressor, compressor);
-	up_write(&zram->init_lock);
-	return len;
+	zram->recomp = comp;
+	return 0;
+}
+
+static void zram_recomp_destroy(struct zram *zram)
+{
+	if (zram->recomp)
+		zcomp_destroy(zram->recomp);
+	zram->recomp = NULL;
 }
+#else
+static inline int zram_recomp_create(struct zram *zram) { return 0; };
+static inline void zram_recomp_destroy(struct zram *zram) {};
+#endif
 
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
@@ -1074,7 +1892,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1083,6 +1901,10 @@ static ssize_t mm_stat_show(struct device *dev,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			atomic_long_read(&pool_stats.pages_compacted),
 			(u64)atomic64_read(&zram->stats.huge_pages));
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, " %8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1098,10 +1920,13 @@ static ssize_t bd_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-		"%8llu %8llu %8llu\n",
+		"%8llu %8llu %8llu %8llu %8llu %8llu\n",
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
-			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_ra_reads)),
+			(u64)atomic64_read(&zram->stats.bd_cache_hits),
+			(u64)atomic64_read(&zram->stats.bd_cache_misses));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1133,6 +1958,231 @@ static DEVICE_ATTR_RO(bd_stat);
 #endif
 static DEVICE_ATTR_RO(debug_stat);
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->dedup_buckets;
+}
+
+static struct zram_dedup_bucket *zram_dedup_bucket(struct zram *zram,
+						u32 checksum)
+{
+	return &zram->dedup_buckets[checksum & (zram->dedup_nr_buckets - 1)];
+}
+
+static u32 zram_dedup_checksum(const void *mem, unsigned int len)
+{
+	return jhash(mem, len, 0);
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_dedup_entry *entry,
+				const void *mem, unsigned int len)
+{
+	void *src;
+	bool match;
+
+	if (entry->len != len)
+		return false;
+
+	src = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	match = !memcmp(src, mem, len);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Find an object with the same compressed content and take a reference
+ * to it. Called with the compression stream held, so it must not sleep.
+ */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+			const void *mem, unsigned int len, u32 checksum)
+{
+	struct zram_dedup_bucket *bucket = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry, *found = NULL;
+	struct rb_node *node, *first = NULL;
+
+	spin_lock(&bucket->lock);
+	/* Entries with equal checksums are adjacent, find the leftmost one */
+	node = bucket->rb_root.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (checksum <= entry->checksum) {
+			if (checksum == entry->checksum)
+				first = node;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	for (node = first; node; node = rb_next(node)) {
+		entry = rb_entry(node, struct zram_dedup_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+		if (zram_dedup_match(zram, entry, mem, len)) {
+			entry->refcount++;
+			found = entry;
+			break;
+		}
+	}
+	spin_unlock(&bucket->lock);
+
+	if (found)
+		atomic64_add(len, &zram->stats.dup_data_size);
+
+	return found;
+}
+
+static struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		unsigned long handle, unsigned int len, u32 checksum)
+{
+	struct zram_dedup_bucket *bucket = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry;
+	struct rb_node **link, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->handle = handle;
+	entry->refcount = 1;
+
+	spin_lock(&bucket->lock);
+	link = &bucket->rb_root.rb_node;
+	while (*link) {
+		struct zram_dedup_entry *tmp;
+
+		parent = *link;
+		tmp = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < tmp->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &bucket->rb_root);
+	spin_unlock(&bucket->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+	return entry;
+}
+
+/* Drop a slot's reference, freeing the object with the last one */
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_dedup_bucket *bucket;
+	unsigned int len = entry->len;
+
+	bucket = zram_dedup_bucket(zram, entry->checksum);
+	spin_lock(&bucket->lock);
+	if (--entry->refcount) {
+		spin_unlock(&bucket->lock);
+		atomic64_sub(len, &zram->stats.dup_data_size);
+		return;
+	}
+	rb_erase(&entry->rb_node, &bucket->rb_root);
+	spin_unlock(&bucket->lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	atomic64_sub(len, &zram->stats.compr_data_size);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	kfree(entry);
+}
+
+static bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	unsigned long i, nr_buckets;
+
+	if (!zram->use_dedup)
+		return true;
+
+	nr_buckets = roundup_pow_of_two(max_t(size_t, num_pages >> 4, 1));
+	zram->dedup_buckets = vzalloc(nr_buckets *
+					sizeof(*zram->dedup_buckets));
+	if (!zram->dedup_buckets)
+		return false;
+
+	for (i = 0; i < nr_buckets; i++) {
+		spin_lock_init(&zram->dedup_buckets[i].lock);
+		zram->dedup_buckets[i].rb_root = RB_ROOT;
+	}
+	zram->dedup_nr_buckets = nr_buckets;
+	atomic64_add(nr_buckets * sizeof(*zram->dedup_buckets),
+			&zram->stats.meta_data_size);
+
+	return true;
+}
+
+static void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->dedup_buckets);
+	zram->dedup_buckets = NULL;
+	zram->dedup_nr_buckets = 0;
+}
+#else
+struct zram_dedup_entry;
+
+static inline bool zram_dedup_enabled(struct zram *zram) { return false; };
+static inline u32 zram_dedup_checksum(const void *mem, unsigned int len)
+{
+	return 0;
+};
+static inline struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+			const void *mem, unsigned int len, u32 checksum)
+{
+	return NULL;
+};
+static inline struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+		unsigned long handle, unsigned int len, u32 checksum)
+{
+	return NULL;
+};
+static inline void zram_dedup_put(struct zram *zram,
+				struct zram_dedup_entry *entry) {};
+static inline bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return true;
+};
+static inline void zram_dedup_fini(struct zram *zram) {};
+#endif
+
 static void zram_meta_free(struct zram *zram, u64 disksize)
 {
 	size_t num_pages = disksize >> PAGE_SHIFT;
@@ -1142,6 +2192,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -1161,6 +2212,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (!zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -1176,7 +2233,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 	unsigned long handle;
 
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
-	zram->table[index].ac_time = 0;
+	zram->table[index].ac_time = ktime_set(0, 0);
 #endif
 	if (zram_test_flag(zram, index, ZRAM_IDLE))
 		zram_clear_flag(zram, index, ZRAM_IDLE);
@@ -1186,6 +2243,13 @@ static void zram_free_page(struct zram *zram, size_t index)
 		atomic64_dec(&zram->stats.huge_pages);
 	}
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram_test_flag(zram, index, ZRAM_RECOMP)) {
+		zram_clear_flag(zram, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+#endif
+
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_clear_flag(zram, index, ZRAM_WB);
 		free_block_bdev(zram, zram_get_element(zram, index));
@@ -1206,6 +2270,12 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
+		goto out;
+	}
+
 	zs_free(zram->mem_pool, handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
@@ -1253,6 +2323,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		return 0;
 	}
 
+	handle = zram_get_zs_handle(zram, index);
 	size = zram_get_obj_size(zram, index);
 
 	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
@@ -1262,12 +2333,13 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
@@ -1324,6 +2396,8 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	struct page *page = bvec->bv_page;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	struct zram_dedup_entry *entry;
+	u32 checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1351,6 +2425,20 @@ compress_again:
 	if (comp_len >= huge_class_size)
 		comp_len = PAGE_SIZE;
 
+	if (zram_dedup_enabled(zram) && comp_len != PAGE_SIZE) {
+		checksum = zram_dedup_checksum(zstrm->buffer, comp_len);
+		entry = zram_dedup_find(zram, zstrm->buffer, comp_len,
+					checksum);
+		if (entry) {
+			zcomp_stream_put(zram->comp);
+			if (handle)
+				zs_free(zram->mem_pool, handle);
+			flags = ZRAM_DEDUP;
+			element = (unsigned long)entry;
+			goto out;
+		}
+	}
+
 	/*
 	 * handle allocation has 2 paths:
 	 * a) fast path is executed with preemption disabled (for
@@ -1402,6 +2490,14 @@ compress_again:
 	zcomp_stream_put(zram->comp);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	if (zram_dedup_enabled(zram) && comp_len != PAGE_SIZE) {
+		entry = zram_dedup_insert(zram, handle, comp_len, checksum);
+		if (entry) {
+			flags = ZRAM_DEDUP;
+			element = (unsigned long)entry;
+		}
+	}
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1418,6 +2514,9 @@ out:
 	if (flags) {
 		zram_set_flag(zram, index, flags);
 		zram_set_element(zram, index, element);
+		/* shared objects keep their compressed size in the slot */
+		if (flags == ZRAM_DEDUP)
+			zram_set_obj_size(zram, index, comp_len);
 	}  else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
@@ -1508,6 +2607,185 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 	}
 }
 
+static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
+			int offset, int rw, struct bio *bio);
+
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+static struct workqueue_struct *zram_batch_wq;
+
+struct zram_batch;
+
+/* One page of a batched write bio */
+struct zram_batch_slot {
+	struct work_struct work;
+	struct zram_batch *batch;
+	struct bio_vec bvec;
+	u32 index;
+	int cpu;
+};
+
+struct zram_batch {
+	struct zram *zram;
+	struct bio *bio;
+	/* slots not stored yet, plus one reference held by the submitter */
+	atomic_t pending;
+	int error;
+	unsigned int nr_slots;
+	struct zram_batch_slot slots[0];
+};
+
+static ssize_t batch_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->batch_write, val);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t batch_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(zram->batch_write));
+}
+
+static void zram_batch_put(struct zram_batch *batch)
+{
+	struct bio *bio = batch->bio;
+
+	if (!atomic_dec_and_test(&batch->pending))
+		return;
+
+	if (READ_ONCE(batch->error))
+		bio_io_error(bio);
+	else
+		bio_endio(bio);
+	kfree(batch);
+}
+
+static void zram_batch_slot_work(struct work_struct *work)
+{
+	struct zram_batch_slot *slot = container_of(work,
+					struct zram_batch_slot, work);
+	struct zram_batch *batch = slot->batch;
+
+	if (zram_bvec_rw(batch->zram, &slot->bvec, slot->index, 0,
+				WRITE, batch->bio) < 0)
+		WRITE_ONCE(batch->error, -EIO);
+
+	zram_batch_put(batch);
+}
+
+/*
+ * Spread the pages of a write bio over the online CPUs so that each of
+ * them compresses its share with its own per-cpu stream. Slots which
+ * land on the submitting CPU are handled inline. The bio is completed by
+ * whoever stores the last slot.
+ *
+ * Returns false if the bio is not eligible (partial pages, a single page
+ * or no memory for the batch), in which case the caller falls back to
+ * the inline path.
+ */
+static bool zram_batch_write(struct zram *zram, struct bio *bio)
+{
+	struct zram_batch *batch;
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+	unsigned int nr_slots, i = 0;
+	u32 index;
+	int cpu, this_cpu;
+
+	if (!READ_ONCE(zram->batch_write))
+		return false;
+
+	nr_slots = bio_segments(bio);
+	if (nr_slots < 2)
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_offset || bvec.bv_len != PAGE_SIZE)
+			return false;
+	}
+
+	batch = kmalloc(sizeof(*batch) + nr_slots * sizeof(batch->slots[0]),
+			GFP_NOIO | __GFP_NOWARN);
+	if (!batch)
+		return false;
+
+	batch->zram = zram;
+	batch->bio = bio;
+	batch->error = 0;
+	batch->nr_slots = nr_slots;
+	atomic_set(&batch->pending, nr_slots + 1);
+
+	index = bio->bi_iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
+	bio_for_each_segment(bvec, bio, iter) {
+		struct zram_batch_slot *slot = &batch->slots[i++];
+
+		INIT_WORK(&slot->work, zram_batch_slot_work);
+		slot->batch = batch;
+		slot->bvec = bvec;
+		slot->index = index++;
+	}
+
+	/* Keep the online mask stable while the slots are being queued */
+	this_cpu = get_cpu();
+	cpu = this_cpu;
+	for (i = 0; i < nr_slots; i++) {
+		struct zram_batch_slot *slot = &batch->slots[i];
+
+		slot->cpu = cpu;
+		if (cpu != this_cpu)
+			queue_work_on(cpu, zram_batch_wq, &slot->work);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+	put_cpu();
+
+	for (i = 0; i < nr_slots; i++) {
+		struct zram_batch_slot *slot = &batch->slots[i];
+
+		if (slot->cpu == this_cpu)
+			zram_batch_slot_work(&slot->work);
+	}
+
+	zram_batch_put(batch);
+	return true;
+}
+
+static int zram_batch_init(void)
+{
+	zram_batch_wq = alloc_workqueue("zram_batch",
+			WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	return zram_batch_wq ? 0 : -ENOMEM;
+}
+
+static void zram_batch_destroy(void)
+{
+	if (zram_batch_wq)
+		destroy_workqueue(zram_batch_wq);
+	zram_batch_wq = NULL;
+}
+#else
+static inline bool zram_batch_write(struct zram *zram, struct bio *bio)
+{
+	return false;
+}
+static inline int zram_batch_init(void) { return 0; };
+static inline void zram_batch_destroy(void) {};
+#endif
+
 /*
  * Returns errno if it has some problem. Otherwise return 0 or 1.
  * Returns 0 if IO request was done synchronously
@@ -1565,6 +2843,9 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 	}
 
 	rw = bio_data_dir(bio);
+	if (rw == WRITE && !offset && zram_batch_write(zram, bio))
+		return;
+
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
 		unsigned int unwritten = bvec.bv_len;
@@ -1702,6 +2983,7 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+	zram_recomp_destroy(zram);
 	reset_bdev(zram);
 }
 
@@ -1738,6 +3020,12 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	err = zram_recomp_create(zram);
+	if (err) {
+		zcomp_destroy(comp);
+		goto out_free_meta;
+	}
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
@@ -1835,6 +3123,17 @@ static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
+static DEVICE_ATTR_RW(bd_readahead);
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+static DEVICE_ATTR_RW(batch_write);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1852,6 +3151,17 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_bd_readahead.attr,
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+	&dev_attr_batch_write.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1893,6 +3203,11 @@ static int zram_add(void)
 	init_rwsem(&zram->init_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
+	spin_lock_init(&zram->bd_cache_lock);
+	INIT_RADIX_TREE(&zram->bd_cache_tree, GFP_ATOMIC);
+	INIT_LIST_HEAD(&zram->bd_cache_lru);
+	atomic_set(&zram->bd_ra_inflight, 0);
+	init_waitqueue_head(&zram->bd_ra_wait);
 #endif
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -2081,6 +3396,7 @@ static void destroy_devices(void)
 {
 	class_unregister(&zram_control_class);
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
+	zram_batch_destroy();
 	zram_debugfs_destroy();
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
@@ -2096,10 +3412,19 @@ static int __init zram_init(void)
 		return ret;
 	}
 
+	ret = zram_batch_init();
+	if (ret) {
+		pr_err("Unable to allocate batch write workqueue\n");
+		class_unregister(&zram_control_class);
+		return ret;
+	}
+
 	zram_debugfs_create();
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
+		zram_debugfs_destroy();
+		zram_batch_destroy();
 		class_unregister(&zram_control_class);
 		return -EBUSY;
 	}
@@ -18,6 +18,9 @@
 #include <linux/rwsem.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
+#include <linux/radix-tree.h>
+#include <linux/rbtree.h>
+#include <linux/wait.h>
 
 #include "zcomp.h"
 
@@ -50,12 +53,42 @@ enum zram_pageflags {
 	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_RECOMP,	/* compressed with the secondary algorithm */
+	ZRAM_DEDUP,	/* handle points to a shared zram_dedup_entry */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+/*
+ * debugfs block_age encoding, one byte per slot. The age is the time
+ * since the slot was last accessed, bucketed as
+ * ilog2(seconds + 1), saturating at ZRAM_AGE_BUCKETS - 1.
+ */
+#define ZRAM_AGE_BUCKETS	16
+#define ZRAM_AGE_MASK		0x0f
+#define ZRAM_AGE_ALLOCATED	(1 << 4)
+#define ZRAM_AGE_IDLE		(1 << 5)
+#define ZRAM_AGE_HUGE		(1 << 6)
+#define ZRAM_AGE_WB		(1 << 7)
+
 /*-- Data structures */
 
+#ifdef CONFIG_ZRAM_DEDUP
+/* A compressed object shared by all the slots holding the same data */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned int len;
+	unsigned long handle;
+	unsigned long refcount;	/* protected by the bucket lock */
+};
+
+struct zram_dedup_bucket {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+#endif
+
 /* Allocated for each disk page */
 struct zram_table_entry {
 	union {
@@ -82,10 +115,16 @@ struct zram_stats {
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t recomp_pages;	/* no. of recompressed pages stored */
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
+	atomic64_t meta_data_size;	/* size of the dedup index */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
+	atomic64_t bd_ra_reads;		/* no. of blocks read ahead */
+	atomic64_t bd_cache_hits;	/* no. of reads served by bd cache */
+	atomic64_t bd_cache_misses;	/* no. of reads missing bd cache */
 #endif
 };
 
@@ -108,6 +147,11 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	/* secondary compressor, used only by recompress */
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+#endif
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -121,6 +165,26 @@ struct zram {
 	unsigned int old_block_size;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
+	/*
+	 * Read-around cache of backing device blocks, keyed by block index.
+	 * Protected by bd_cache_lock, which is taken from bio completion.
+	 */
+	unsigned int bd_ra_pages;
+	spinlock_t bd_cache_lock;
+	struct radix_tree_root bd_cache_tree;
+	struct list_head bd_cache_lru;
+	unsigned int bd_cache_nr;
+	atomic_t bd_ra_inflight;
+	wait_queue_head_t bd_ra_wait;
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_dedup_bucket *dedup_buckets;
+	unsigned long dedup_nr_buckets;
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+	/* compress multi-page write bios on all online CPUs */
+	bool batch_write;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
@@ -551,6 +551,7 @@ static ssize_t diag_dbgfs_read_smdinfo(struct file *file, char __user *ubuf,
 				"buf_2 busy\t:\t%d\n"
 				"bytes read\t:\t%lu\n"
 				"bytes written\t:\t%lu\n"
+				"bytes dropped\t:\t%lu\n"
 				"fwd inited\t:\t%d\n"
 				"fwd opened\t:\t%d\n"
 				"fwd ch_open\t:\t%d\n\n",
@@ -569,6 +570,7 @@ static ssize_t diag_dbgfs_read_smdinfo(struct file *file, char __user *ubuf,
 				atomic_read(&fwd_ctxt->buf_2->in_busy) : -1,
 				(fwd_ctxt) ? fwd_ctxt->read_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->write_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->drop_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->inited : -1,
 				(fwd_ctxt) ?
 				atomic_read(&fwd_ctxt->opened) : -1,
@@ -657,6 +659,7 @@ static ssize_t diag_dbgfs_read_socketinfo(struct file *file, char __user *ubuf,
 				"read pending\t:\t%d\n"
 				"bytes read\t:\t%lu\n"
 				"bytes written\t:\t%lu\n"
+				"bytes dropped\t:\t%lu\n"
 				"fwd inited\t:\t%d\n"
 				"fwd opened\t:\t%d\n"
 				"fwd ch_open\t:\t%d\n\n",
@@ -675,6 +678,7 @@ static ssize_t diag_dbgfs_read_socketinfo(struct file *file, char __user *ubuf,
 				work_pending(&info->read_work),
 				(fwd_ctxt) ? fwd_ctxt->read_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->write_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->drop_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->inited : -1,
 				(fwd_ctxt) ?
 				atomic_read(&fwd_ctxt->opened) : -1,
@@ -761,6 +765,7 @@ static ssize_t diag_dbgfs_read_glinkinfo(struct file *file, char __user *ubuf,
 				"read pending\t:\t%d\n"
 				"bytes read\t:\t%lu\n"
 				"bytes written\t:\t%lu\n"
+				"bytes dropped\t:\t%lu\n"
 				"fwd inited\t:\t%d\n"
 				"fwd opened\t:\t%d\n"
 				"fwd ch_open\t:\t%d\n\n",
@@ -779,6 +784,7 @@ static ssize_t diag_dbgfs_read_glinkinfo(struct file *file, char __user *ubuf,
 				work_pending(&info->read_work),
 				(fwd_ctxt) ? fwd_ctxt->read_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->write_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->drop_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->inited : -1,
 				(fwd_ctxt) ?
 				atomic_read(&fwd_ctxt->opened) : -1,
@@ -22,6 +22,11 @@
 #include <linux/delay.h>
 #include <linux/kmemleak.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/kref.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include "diagchar.h"
 #include "diag_memorydevice.h"
 #include "diagfwd_bridge.h"
@@ -72,6 +77,231 @@ struct diag_md_info diag_md[NUM_DIAG_MD_DEV] = {
 #endif
 };
 
+#define DIAG_MD_RING_MAX_SIZE	SZ_64M
+
+/*
+ * Optional shared ring for the memory device client. Data written to it
+ * is handed back to its producer right away instead of being held in the
+ * table until the client reads it.
+ */
+struct diag_md_ring {
+	struct kref ref;
+	int pid;
+	struct diag_md_ring_hdr *hdr;
+	unsigned char *data;
+};
+
+static struct diag_md_ring *diag_md_ring;
+static DEFINE_SPINLOCK(diag_md_ring_lock);
+
+static void diag_md_ring_free(struct kref *ref)
+{
+	struct diag_md_ring *ring = container_of(ref, struct diag_md_ring,
+						 ref);
+
+	vfree(ring->hdr);
+	kfree(ring);
+}
+
+static void diag_md_ring_swap(int pid, struct diag_md_ring *new)
+{
+	struct diag_md_ring *old = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&diag_md_ring_lock, flags);
+	if (diag_md_ring && diag_md_ring->pid == pid) {
+		old = diag_md_ring;
+		diag_md_ring = NULL;
+	}
+	if (new && !diag_md_ring) {
+		diag_md_ring = new;
+		new = NULL;
+	}
+	spin_unlock_irqrestore(&diag_md_ring_lock, flags);
+
+	if (old)
+		kref_put(&old->ref, diag_md_ring_free);
+	if (new)
+		kref_put(&new->ref, diag_md_ring_free);
+}
+
+int diag_md_ring_config(int pid, uint32_t size)
+{
+	struct diag_md_ring *ring;
+	int err = 0;
+
+	if (size && (size < PAGE_SIZE || size > DIAG_MD_RING_MAX_SIZE ||
+		     !is_power_of_2(size)))
+		return -EINVAL;
+
+	mutex_lock(&driver->md_session_lock);
+	if (!diag_md_session_get_pid(pid))
+		err = -EPERM;
+	mutex_unlock(&driver->md_session_lock);
+	if (err)
+		return err;
+
+	if (!size) {
+		diag_md_ring_release(pid);
+		return 0;
+	}
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+	ring->hdr = vmalloc_user(PAGE_SIZE + size);
+	if (!ring->hdr) {
+		kfree(ring);
+		return -ENOMEM;
+	}
+	kref_init(&ring->ref);
+	ring->pid = pid;
+	ring->data = (unsigned char *)ring->hdr + PAGE_SIZE;
+	ring->hdr->version = DIAG_MD_RING_VERSION;
+	ring->hdr->data_offset = PAGE_SIZE;
+	ring->hdr->size = size;
+
+	diag_md_ring_swap(pid, ring);
+	spin_lock_irq(&diag_md_ring_lock);
+	if (diag_md_ring != ring)
+		err = -EBUSY;
+	spin_unlock_irq(&diag_md_ring_lock);
+
+	DIAG_LOG(DIAG_DEBUG_USERSPACE, "md ring of %u bytes for pid %d, err: %d\n",
+		 size, pid, err);
+	return err;
+}
+
+void diag_md_ring_release(int pid)
+{
+	diag_md_ring_swap(pid, NULL);
+}
+
+static void diag_md_ring_vm_open(struct vm_area_struct *vma)
+{
+	struct diag_md_ring *ring = vma->vm_private_data;
+
+	kref_get(&ring->ref);
+}
+
+static void diag_md_ring_vm_close(struct vm_area_struct *vma)
+{
+	struct diag_md_ring *ring = vma->vm_private_data;
+
+	kref_put(&ring->ref, diag_md_ring_free);
+}
+
+static const struct vm_operations_struct diag_md_ring_vm_ops = {
+	.open = diag_md_ring_vm_open,
+	.close = diag_md_ring_vm_close,
+};
+
+int diag_md_ring_mmap(int pid, struct vm_area_struct *vma)
+{
+	struct diag_md_ring *ring;
+	int err;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	spin_lock_irq(&diag_md_ring_lock);
+	ring = diag_md_ring;
+	if (ring && ring->pid == pid)
+		kref_get(&ring->ref);
+	else
+		ring = NULL;
+	spin_unlock_irq(&diag_md_ring_lock);
+	if (!ring)
+		return -ENODEV;
+
+	err = remap_vmalloc_range(vma, ring->hdr, 0);
+	if (err) {
+		kref_put(&ring->ref, diag_md_ring_free);
+		return err;
+	}
+	vma->vm_flags |= VM_DONTCOPY;
+	vma->vm_private_data = ring;
+	vma->vm_ops = &diag_md_ring_vm_ops;
+	return 0;
+}
+
+int diag_md_ring_pending(int pid)
+{
+	struct diag_md_ring *ring;
+	unsigned long flags;
+	int pending = 0;
+
+	spin_lock_irqsave(&diag_md_ring_lock, flags);
+	ring = diag_md_ring;
+	if (ring && ring->pid == pid)
+		pending = ring->hdr->head != READ_ONCE(ring->hdr->tail);
+	spin_unlock_irqrestore(&diag_md_ring_lock, flags);
+
+	return pending;
+}
+
+static void diag_md_ring_copy(struct diag_md_ring *ring, uint32_t pos,
+			      const void *src, uint32_t len)
+{
+	uint32_t size = ring->hdr->size;
+	uint32_t off = pos & (size - 1);
+	uint32_t n = min(len, size - off);
+
+	memcpy(ring->data + off, src, n);
+	if (n < len)
+		memcpy(ring->data, src + n, len - n);
+}
+
+/*
+ * Returns -ENODEV when pid has no ring, so the caller falls back to the
+ * table, and -ENOSPC when the record was dropped for lack of room.
+ */
+static int diag_md_ring_write(int id, int pid, unsigned char *buf, int len)
+{
+	struct diag_md_ring *ring;
+	struct diag_md_ring_hdr *hdr;
+	struct diag_md_ring_rec rec;
+	unsigned long flags;
+	uint32_t head, tail, need;
+	int err = 0;
+
+	spin_lock_irqsave(&diag_md_ring_lock, flags);
+	ring = diag_md_ring;
+	if (!ring || ring->pid != pid) {
+		spin_unlock_irqrestore(&diag_md_ring_lock, flags);
+		return -ENODEV;
+	}
+
+	hdr = ring->hdr;
+	head = hdr->head;
+	tail = READ_ONCE(hdr->tail);
+	/* Order the consumer's reads before we overwrite what it freed */
+	smp_mb();
+	if (head - tail > hdr->size)
+		tail = head;
+
+	need = ALIGN(sizeof(rec) + len, DIAG_MD_RING_ALIGN);
+	if (need > hdr->size - (head - tail)) {
+		hdr->dropped_records++;
+		hdr->dropped_bytes += len;
+		err = -ENOSPC;
+		goto out;
+	}
+
+	rec.remote_token = (id > 0) ? diag_get_remote(id) : 0;
+	rec.len = len;
+	diag_md_ring_copy(ring, head, &rec, sizeof(rec));
+	diag_md_ring_copy(ring, head + sizeof(rec), buf, len);
+	hdr->records++;
+	hdr->bytes += len;
+	/* Publish the record only once its data is in place */
+	smp_wmb();
+	WRITE_ONCE(hdr->head, head + need);
+out:
+	spin_unlock_irqrestore(&diag_md_ring_lock, flags);
+	return err;
+}
+
 int diag_md_register(int id, int ctx, struct diag_mux_ops *ops)
 {
 	if (id < 0 || id >= NUM_DIAG_MD_DEV || !ops)
@@ -139,7 +369,7 @@ void diag_md_close_all(void)
 
 int diag_md_write(int id, unsigned char *buf, int len, int ctx)
 {
-	int i, pid = 0;
+	int i, pid = 0, err;
 	uint8_t found = 0;
 	unsigned long flags;
 	struct diag_md_info *ch = NULL;
@@ -171,6 +401,19 @@ int diag_md_write(int id, unsigned char *buf, int len, int ctx)
 		return -EINVAL;
 	}
 
+	err = diag_md_ring_write(id, pid, buf, len);
+	if (err != -ENODEV) {
+		mutex_unlock(&driver->md_session_lock);
+		if (err)
+			return err;
+		/* The data lives in the ring now, the buffer can go back */
+		if (ch->ops && ch->ops->write_done)
+			ch->ops->write_done(buf, len, ctx,
+					    DIAG_MEMORY_DEVICE_MODE);
+		wake_up_interruptible(&driver->wait_q);
+		return 0;
+	}
+
 	spin_lock_irqsave(&ch->lock, flags);
 	for (i = 0; i < ch->num_tbl_entries && !found; i++) {
 		if (ch->tbl[i].buf != buf)
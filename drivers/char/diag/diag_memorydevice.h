@@ -57,4 +57,8 @@ int diag_md_close_peripheral(int id, uint8_t peripheral);
 int diag_md_write(int id, unsigned char *buf, int len, int ctx);
 int diag_md_copy_to_user(char __user *buf, int *pret, size_t buf_size,
 			 struct diag_md_session_t *info);
+int diag_md_ring_config(int pid, uint32_t size);
+void diag_md_ring_release(int pid);
+int diag_md_ring_mmap(int pid, struct vm_area_struct *vma);
+int diag_md_ring_pending(int pid);
 #endif
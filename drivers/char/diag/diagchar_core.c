@@ -22,6 +22,7 @@
 #include <linux/sched.h>
 #include <linux/ratelimit.h>
 #include <linux/timer.h>
+#include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/platform_device.h>
 #include <linux/msm_mhi.h>
@@ -1454,6 +1455,7 @@ static void diag_md_session_close(int pid)
 	kfree(session_info->event_mask);
 	session_info->event_mask = NULL;
 	del_timer(&session_info->hdlc_reset_timer);
+	diag_md_ring_release(pid);
 
 	for (i = 0; i < NUM_MD_SESSIONS && !found; i++) {
 		if (driver->md_session_map[i] != NULL)
@@ -2225,6 +2227,16 @@ static int diag_ioctl_query_pd_logging(struct diag_logging_mode_param_t *param)
 	return ret;
 }
 
+static int diag_ioctl_md_ring_config(unsigned long ioarg)
+{
+	uint32_t size;
+
+	if (copy_from_user(&size, (void __user *)ioarg, sizeof(size)))
+		return -EFAULT;
+
+	return diag_md_ring_config(current->tgid, size);
+}
+
 static int diag_ioctl_register_callback(unsigned long ioarg)
 {
 	int err = 0;
@@ -2470,6 +2482,9 @@ long diagchar_compat_ioctl(struct file *filp,
 			return -EFAULT;
 		result = diag_ioctl_query_pd_logging(&mode_param);
 		break;
+	case DIAG_IOCTL_MD_RING_CONFIG:
+		result = diag_ioctl_md_ring_config(ioarg);
+		break;
 	}
 	return result;
 }
@@ -2601,6 +2616,9 @@ long diagchar_ioctl(struct file *filp,
 			return -EFAULT;
 		result = diag_ioctl_query_pd_logging(&mode_param);
 		break;
+	case DIAG_IOCTL_MD_RING_CONFIG:
+		result = diag_ioctl_md_ring_config(ioarg);
+		break;
 	}
 	return result;
 }
@@ -3712,10 +3730,40 @@ static int diag_real_time_info_init(void)
 	return 0;
 }
 
+static int diagchar_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	return diag_md_ring_mmap(current->tgid, vma);
+}
+
+static unsigned int diagchar_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+	int i;
+
+	poll_wait(file, &driver->wait_q, wait);
+
+	if (diag_md_ring_pending(current->tgid))
+		mask |= POLLIN | POLLRDNORM;
+
+	mutex_lock(&driver->diagchar_mutex);
+	for (i = 0; i < driver->num_clients; i++) {
+		if (driver->client_map[i].pid == current->tgid &&
+		    atomic_read(&driver->data_ready_notif[i]) > 0) {
+			mask |= POLLIN | POLLRDNORM;
+			break;
+		}
+	}
+	mutex_unlock(&driver->diagchar_mutex);
+
+	return mask;
+}
+
 static const struct file_operations diagcharfops = {
 	.owner = THIS_MODULE,
 	.read = diagchar_read,
 	.write = diagchar_write,
+	.mmap = diagchar_mmap,
+	.poll = diagchar_poll,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = diagchar_compat_ioctl,
 #endif
@@ -163,6 +163,50 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 	return;
 }
 
+/*
+ * Encode a complete packet in one pass. The caller guarantees room for
+ * HDLC_ENC_MAX_LEN(len) bytes at dest, so unlike diag_hdlc_encode() no
+ * bounds are checked per byte: the CRC is computed by the table driven
+ * crc_ccitt() and runs of bytes that need no escaping are copied whole.
+ * Returns the number of bytes written.
+ */
+int diag_hdlc_encode_pkt(uint8_t *dest, const uint8_t *src, int len)
+{
+	const uint8_t *end = src + len;
+	const uint8_t *run;
+	uint8_t *d = dest;
+	uint8_t fcs[2];
+	uint16_t crc;
+	int i;
+
+	crc = ~crc_ccitt(CRC_16_L_SEED, src, len);
+	fcs[0] = crc & 0xFF;
+	fcs[1] = crc >> 8;
+
+	while (src < end) {
+		run = src;
+		while (src < end && *src != CONTROL_CHAR && *src != ESC_CHAR)
+			src++;
+		memcpy(d, run, src - run);
+		d += src - run;
+		if (src < end) {
+			*d++ = ESC_CHAR;
+			*d++ = *src++ ^ ESC_MASK;
+		}
+	}
+
+	for (i = 0; i < sizeof(fcs); i++) {
+		if (fcs[i] == CONTROL_CHAR || fcs[i] == ESC_CHAR) {
+			*d++ = ESC_CHAR;
+			*d++ = fcs[i] ^ ESC_MASK;
+		} else {
+			*d++ = fcs[i];
+		}
+	}
+	*d++ = CONTROL_CHAR;
+
+	return d - dest;
+}
 
 int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 {
@@ -52,6 +52,8 @@ struct diag_hdlc_decode_type {
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc);
 
+int diag_hdlc_encode_pkt(uint8_t *dest, const uint8_t *src, int len);
+
 int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc);
 
 int crc_check(uint8_t *buf, uint16_t len);
@@ -63,4 +65,6 @@ int crc_check(uint8_t *buf, uint16_t len);
 #define HDLC_COMPLETE		1
 
 #define HDLC_FOOTER_LEN		3
+/* Every byte and both CRC bytes escaped, plus the closing control char */
+#define HDLC_ENC_MAX_LEN(len)	(2 * (len) + 2 * 2 + 1)
 #endif
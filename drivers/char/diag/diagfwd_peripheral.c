@@ -161,6 +161,18 @@ static int diag_add_hdlc_encoding(unsigned char *dest_buf, int *dest_len,
 			break;
 		}
 
+		if (bytes_remaining >= HDLC_ENC_MAX_LEN(header->length)) {
+			encoded_pkt_length = diag_hdlc_encode_pkt(
+						temp_encode_buf, payload,
+						header->length);
+			src_pkt_len = (header_size + header->length + 1);
+			total_processed += src_pkt_len;
+			temp_buf += src_pkt_len;
+			bytes_remaining -= encoded_pkt_length;
+			temp_encode_buf += encoded_pkt_length;
+			continue;
+		}
+
 		/* Prepare for encoding the data */
 		send.state = DIAG_STATE_START;
 		send.pkt = payload;
@@ -725,6 +737,7 @@ end:
 	mutex_unlock(&fwd_info->data_mutex);
 	mutex_unlock(&driver->hdlc_disable_mutex);
 end_write:
+	fwd_info->drop_bytes += len;
 	diag_ws_release();
 	if (temp_buf) {
 		DIAG_LOG(DIAG_DEBUG_PERIPHERALS,
@@ -860,6 +873,7 @@ int diagfwd_peripheral_init(void)
 			fwd_info->inited = 1;
 			fwd_info->read_bytes = 0;
 			fwd_info->write_bytes = 0;
+			fwd_info->drop_bytes = 0;
 			fwd_info->cpd_len_1 = 0;
 			fwd_info->cpd_len_2 = 0;
 			fwd_info->upd_len_1_a = 0;
@@ -882,6 +896,7 @@ int diagfwd_peripheral_init(void)
 			fwd_info->ch_open = 0;
 			fwd_info->read_bytes = 0;
 			fwd_info->write_bytes = 0;
+			fwd_info->drop_bytes = 0;
 			fwd_info->cpd_len_1 = 0;
 			fwd_info->cpd_len_2 = 0;
 			fwd_info->upd_len_1_a = 0;
@@ -1107,6 +1122,7 @@ void diagfwd_close_transport(uint8_t transport, uint8_t peripheral)
 	dest_info->ch_open = fwd_info->ch_open;
 	dest_info->read_bytes = fwd_info->read_bytes;
 	dest_info->write_bytes = fwd_info->write_bytes;
+	dest_info->drop_bytes = fwd_info->drop_bytes;
 	dest_info->inited = fwd_info->inited;
 	dest_info->buf_1 = fwd_info->buf_1;
 	dest_info->buf_2 = fwd_info->buf_2;
@@ -72,6 +72,7 @@ struct diagfwd_info {
 	atomic_t opened;
 	unsigned long read_bytes;
 	unsigned long write_bytes;
+	unsigned long drop_bytes;
 	spinlock_t write_buf_lock;
 	struct mutex buf_mutex;
 	struct mutex data_mutex;
@@ -22,11 +22,22 @@
 #include <linux/slab.h>
 #include <linux/input.h>
 #include <linux/time.h>
+#include <linux/kthread.h>
+#include <linux/cgroup.h>
 
 struct cpu_sync {
 	int cpu;
 	unsigned int input_boost_min;
 	unsigned int input_boost_freq;
+	spinlock_t lock;
+	wait_queue_head_t sync_wq;
+	struct task_struct *thread;
+	struct delayed_work boost_rem;
+	bool pending;
+	int src_cpu;
+	int task_load;
+	unsigned int boost_min;
+	atomic_t being_woken;
 };
 
 static DEFINE_PER_CPU(struct cpu_sync, sync_info);
@@ -38,6 +49,38 @@ static bool input_boost_enabled;
 static unsigned int input_boost_ms = 40;
 module_param(input_boost_ms, uint, 0644);
 
+/*
+ * Number of steps the input boost decays in over input_boost_ms. At step
+ * n of N the boost is input_boost_freq * (N - n) / N, 1 keeps the flat
+ * boost.
+ */
+static unsigned int input_boost_steps = 1;
+module_param(input_boost_steps, uint, 0644);
+static unsigned int input_boost_step;
+static unsigned int input_boost_nr_steps;
+
+/* Boost only the clusters running the tasks of the top-app cpuset */
+static bool input_boost_top_app;
+module_param(input_boost_top_app, bool, 0644);
+static struct cpumask input_boost_cpus;
+
+/*
+ * Migration boost: a task moving from a faster CPU lifts the destination's
+ * min frequency to the source's for boost_ms, so that it does not lose
+ * the ramp it had.
+ */
+static unsigned int boost_ms;
+module_param(boost_ms, uint, 0644);
+
+static unsigned int sync_threshold;
+module_param(sync_threshold, uint, 0644);
+
+static bool load_based_syncs = true;
+module_param(load_based_syncs, bool, 0644);
+
+static unsigned int migration_load_threshold = 15;
+module_param(migration_load_threshold, uint, 0644);
+
 static bool sched_boost_on_input;
 module_param(sched_boost_on_input, bool, 0644);
 
@@ -131,22 +174,31 @@ static int boost_adjust_notify(struct notifier_block *nb, unsigned long val,
 	struct cpufreq_policy *policy = data;
 	unsigned int cpu = policy->cpu;
 	struct cpu_sync *s = &per_cpu(sync_info, cpu);
+	unsigned int b_min = s->boost_min;
 	unsigned int ib_min = s->input_boost_min;
+	unsigned int min;
 
 	switch (val) {
 	case CPUFREQ_ADJUST:
-		if (!ib_min)
+		if (!b_min && !ib_min)
 			break;
 
+		min = max(b_min, ib_min);
+
 		pr_debug("CPU%u policy min before boost: %u kHz\n",
 			 cpu, policy->min);
-		pr_debug("CPU%u boost min: %u kHz\n", cpu, ib_min);
+		pr_debug("CPU%u boost min: %u kHz\n", cpu, min);
 
-		cpufreq_verify_within_limits(policy, ib_min, UINT_MAX);
+		cpufreq_verify_within_limits(policy, min, UINT_MAX);
 
 		pr_debug("CPU%u policy min after boost: %u kHz\n",
 			 cpu, policy->min);
 		break;
+
+	case CPUFREQ_START:
+		if (s->thread)
+			set_cpus_allowed_ptr(s->thread, cpumask_of(cpu));
+		break;
 	}
 
 	return NOTIFY_OK;
@@ -169,17 +221,52 @@ static void update_policy_online(void)
 	put_online_cpus();
 }
 
-static void do_input_boost_rem(struct work_struct *work)
+static void do_boost_rem(struct work_struct *work)
+{
+	struct cpu_sync *s = container_of(work, struct cpu_sync,
+						boost_rem.work);
+
+	pr_debug("Removing boost for CPU%d\n", s->cpu);
+	s->boost_min = 0;
+	/* Force policy re-evaluation to trigger adjust notifier. */
+	get_online_cpus();
+	if (cpu_online(s->cpu))
+		cpufreq_update_policy(s->cpu);
+	put_online_cpus();
+}
+
+static void set_input_boost_min(unsigned int step)
 {
-	unsigned int i, ret;
+	unsigned int i, n = input_boost_nr_steps;
 	struct cpu_sync *i_sync_info;
 
-	/* Reset the input_boost_min for all CPUs in the system */
-	pr_debug("Resetting input boost min for all CPUs\n");
 	for_each_possible_cpu(i) {
 		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = 0;
+		if (step >= n || !cpumask_test_cpu(i, &input_boost_cpus))
+			i_sync_info->input_boost_min = 0;
+		else
+			i_sync_info->input_boost_min =
+				i_sync_info->input_boost_freq * (n - step) / n;
 	}
+}
+
+static void do_input_boost_rem(struct work_struct *work)
+{
+	unsigned int ret;
+
+	/* Step the boost down, or remove it after the last step */
+	if (++input_boost_step < input_boost_nr_steps) {
+		pr_debug("Decaying input boost, step %u\n", input_boost_step);
+		set_input_boost_min(input_boost_step);
+		update_policy_online();
+		queue_delayed_work(cpu_boost_wq, &input_boost_rem,
+			msecs_to_jiffies(input_boost_ms / input_boost_nr_steps));
+		return;
+	}
+
+	/* Reset the input_boost_min for all CPUs in the system */
+	pr_debug("Resetting input boost min for all CPUs\n");
+	set_input_boost_min(input_boost_nr_steps);
 
 	/* Update policies for all online CPUs */
 	update_policy_online();
@@ -192,10 +279,63 @@ static void do_input_boost_rem(struct work_struct *work)
 	}
 }
 
+#ifdef CONFIG_CPUSETS
+/*
+ * Collect the clusters of the CPUs the runnable tasks of the top-app
+ * cpuset are on. Returns false if there is no such cpuset or it has no
+ * runnable task.
+ */
+static bool top_app_cpus(struct cpumask *mask)
+{
+	struct cgroup_subsys_state *root, *pos, *top_app = NULL;
+	struct cpufreq_policy *policy;
+	struct css_task_iter it;
+	struct task_struct *p;
+	char name[16];
+	int cpu;
+
+	cpumask_clear(mask);
+
+	rcu_read_lock();
+	root = task_css(&init_task, cpuset_cgrp_id);
+	css_for_each_child(pos, root) {
+		if (cgroup_name(pos->cgroup, name, sizeof(name)) > 0 &&
+		    !strcmp(name, "top-app") && css_tryget_online(pos)) {
+			top_app = pos;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	if (!top_app)
+		return false;
+
+	css_task_iter_start(top_app, 0, &it);
+	while ((p = css_task_iter_next(&it)))
+		if (p->state == TASK_RUNNING)
+			cpumask_set_cpu(task_cpu(p), mask);
+	css_task_iter_end(&it);
+	css_put(top_app);
+
+	for_each_cpu(cpu, mask) {
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+		cpumask_or(mask, mask, policy->related_cpus);
+		cpufreq_cpu_put(policy);
+	}
+
+	return !cpumask_empty(mask);
+}
+#else
+static bool top_app_cpus(struct cpumask *mask)
+{
+	return false;
+}
+#endif
+
 static void do_input_boost(struct work_struct *work)
 {
-	unsigned int i, ret;
-	struct cpu_sync *i_sync_info;
+	unsigned int ret;
 
 	cancel_delayed_work_sync(&input_boost_rem);
 	if (sched_boost_active) {
@@ -203,12 +343,15 @@ static void do_input_boost(struct work_struct *work)
 		sched_boost_active = false;
 	}
 
-	/* Set the input_boost_min for all CPUs in the system */
-	pr_debug("Setting input boost min for all CPUs\n");
-	for_each_possible_cpu(i) {
-		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = i_sync_info->input_boost_freq;
-	}
+	if (!input_boost_top_app || !top_app_cpus(&input_boost_cpus))
+		cpumask_copy(&input_boost_cpus, cpu_possible_mask);
+
+	/* Set the input_boost_min for the CPUs being boosted */
+	pr_debug("Setting input boost min for CPUs %*pbl\n",
+		 cpumask_pr_args(&input_boost_cpus));
+	input_boost_nr_steps = max(input_boost_steps, 1U);
+	input_boost_step = 0;
+	set_input_boost_min(0);
 
 	/* Update policies for all online CPUs */
 	update_policy_online();
@@ -223,9 +366,130 @@ static void do_input_boost(struct work_struct *work)
 	}
 
 	queue_delayed_work(cpu_boost_wq, &input_boost_rem,
-					msecs_to_jiffies(input_boost_ms));
+			msecs_to_jiffies(input_boost_ms / input_boost_nr_steps));
+}
+
+static int boost_mig_sync_thread(void *data)
+{
+	int dest_cpu = (long)data;
+	int src_cpu, ret;
+	struct cpu_sync *s = &per_cpu(sync_info, dest_cpu);
+	struct cpufreq_policy dest_policy;
+	struct cpufreq_policy src_policy;
+	unsigned long flags;
+	unsigned int req_freq;
+
+	while (1) {
+		wait_event_interruptible(s->sync_wq, s->pending ||
+					 kthread_should_stop());
+
+		if (kthread_should_stop())
+			break;
+
+		spin_lock_irqsave(&s->lock, flags);
+		s->pending = false;
+		src_cpu = s->src_cpu;
+		spin_unlock_irqrestore(&s->lock, flags);
+
+		ret = cpufreq_get_policy(&src_policy, src_cpu);
+		if (ret)
+			continue;
+
+		ret = cpufreq_get_policy(&dest_policy, dest_cpu);
+		if (ret)
+			continue;
+
+		req_freq = load_based_syncs ?
+			(s->task_load * src_policy.max) / 100 : src_policy.cur;
+
+		if (req_freq <= dest_policy.cpuinfo.min_freq) {
+			pr_debug("No sync. Sync Freq:%u\n", req_freq);
+			continue;
+		}
+
+		if (sync_threshold)
+			req_freq = min(sync_threshold, req_freq);
+
+		cancel_delayed_work_sync(&s->boost_rem);
+
+		s->boost_min = req_freq;
+
+		/* Force policy re-evaluation to trigger adjust notifier. */
+		get_online_cpus();
+		if (cpu_online(src_cpu))
+			/*
+			 * Send an unchanged policy update to the source
+			 * CPU. Even though the policy isn't changed from
+			 * its existing boosted or non-boosted state
+			 * notifying the source CPU will let the governor
+			 * know a boost happened on another CPU and that it
+			 * should re-evaluate the frequency at the next timer
+			 * event without interference from a min sample time.
+			 */
+			cpufreq_update_policy(src_cpu);
+		if (cpu_online(dest_cpu)) {
+			cpufreq_update_policy(dest_cpu);
+			queue_delayed_work_on(dest_cpu, cpu_boost_wq,
+				&s->boost_rem, msecs_to_jiffies(boost_ms));
+		} else {
+			s->boost_min = 0;
+		}
+		put_online_cpus();
+	}
+
+	return 0;
 }
 
+static int boost_migration_notify(struct notifier_block *nb,
+				unsigned long unused, void *arg)
+{
+	struct migration_notify_data *mnd = arg;
+	unsigned long flags;
+	struct cpu_sync *s = &per_cpu(sync_info, mnd->dest_cpu);
+
+	if (!boost_ms)
+		return NOTIFY_OK;
+
+	/* Avoid deadlock in try_to_wake_up() */
+	if (s->thread == current)
+		return NOTIFY_OK;
+
+	if (load_based_syncs && (mnd->load <= migration_load_threshold))
+		return NOTIFY_OK;
+
+	if (load_based_syncs && ((mnd->load < 0) || (mnd->load > 100))) {
+		pr_err("Invalid load: %d\n", mnd->load);
+		return NOTIFY_OK;
+	}
+
+	/* Avoid usage of load if load based syncs are disabled */
+	if (!load_based_syncs)
+		mnd->load = 0;
+
+	pr_debug("Migration: CPU%d --> CPU%d\n", mnd->src_cpu, mnd->dest_cpu);
+	spin_lock_irqsave(&s->lock, flags);
+	s->pending = true;
+	s->src_cpu = mnd->src_cpu;
+	s->task_load = mnd->load;
+	spin_unlock_irqrestore(&s->lock, flags);
+	/*
+	 * Avoid issuing recursive wakeup call, as sync thread itself could be
+	 * seen as migrating triggering this notification. Note that sync thread
+	 * of a cpu could be running for a short while with its affinity broken
+	 * because of CPU hotplug.
+	 */
+	if (!atomic_cmpxchg(&s->being_woken, 0, 1)) {
+		wake_up(&s->sync_wq);
+		atomic_set(&s->being_woken, 0);
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block boost_migration_nb = {
+	.notifier_call = boost_migration_notify,
+};
+
 static void cpuboost_input_event(struct input_handle *handle,
 		unsigned int type, unsigned int code, int value)
 {
@@ -331,8 +595,22 @@ static int cpu_boost_init(void)
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
 		s->cpu = cpu;
+		init_waitqueue_head(&s->sync_wq);
+		atomic_set(&s->being_woken, 0);
+		spin_lock_init(&s->lock);
+		INIT_DELAYED_WORK(&s->boost_rem, do_boost_rem);
+		s->thread = kthread_run(boost_mig_sync_thread,
+				(void *) (long)cpu, "boost_sync/%d", cpu);
+		if (IS_ERR(s->thread)) {
+			pr_err("Failed to start sync thread for CPU%d\n", cpu);
+			s->thread = NULL;
+			continue;
+		}
+		set_cpus_allowed_ptr(s->thread, cpumask_of(cpu));
 	}
 	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
+	atomic_notifier_chain_register(&migration_notifier_head,
+					&boost_migration_nb);
 	ret = input_register_handler(&cpuboost_input_handler);
 
 	return ret;
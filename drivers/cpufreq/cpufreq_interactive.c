@@ -58,6 +58,18 @@ struct cpufreq_interactive_policyinfo {
 	int governor_enabled;
 	struct cpufreq_interactive_tunables *cached_tunables;
 	struct sched_load *sl;
+	/* frame deadline hint, protected by load_lock */
+	u64 frame_start;
+	u64 frame_deadline;
+	u64 frame_pred;
+	/* window prediction, protected by target_freq_lock */
+	s64 wp_level;
+	s64 wp_trend;
+	unsigned int wp_pred;
+	u64 wp_samples;
+	u64 wp_err_sum;
+	u64 wp_under;
+	u64 wp_over;
 };
 
 /* Protected by per-policy load_lock */
@@ -67,6 +79,10 @@ struct cpufreq_interactive_cpuinfo {
 	u64 cputime_speedadj;
 	u64 cputime_speedadj_timestamp;
 	unsigned int loadadjfreq;
+	/* busy time scaled by frequency since the current frame started */
+	u64 frame_idle;
+	u64 frame_timestamp;
+	u64 frame_work;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_policyinfo *, polinfo);
@@ -160,6 +176,16 @@ struct cpufreq_interactive_tunables {
 
 	/* Whether to enable prediction or not */
 	bool enable_prediction;
+
+	/*
+	 * Margin, in percent of the predicted frame work, kept when picking
+	 * the frequency that finishes a frame before its deadline.
+	 */
+#define DEFAULT_FRAME_HEADROOM 10
+	unsigned int frame_headroom;
+
+	/* Project the next window's load from the recent windows */
+	bool window_predict;
 };
 
 /* For cases where we have single governor instance for system */
@@ -439,6 +465,120 @@ static u64 update_load(int cpu)
 	return now;
 }
 
+/*
+ * Frame deadline hints: the frame producer writes the vsync period to
+ * frame_deadline when it starts a frame. The busy time of each CPU,
+ * scaled by frequency, is accumulated until the next hint and the
+ * busiest CPU's total is the work of the frame. The prediction follows a
+ * heavier frame at once and decays by a quarter per lighter frame.
+ * While a frame is in flight the governor keeps at least the frequency
+ * that completes the predicted remaining work before the deadline.
+ *
+ * Called with load_lock held.
+ */
+static u64 frame_update_work(struct cpufreq_interactive_policyinfo *ppol)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		ppol->policy->governor_data;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	u64 now, now_idle, delta_idle, active_time;
+	u64 work = 0;
+	int cpu;
+
+	for_each_cpu(cpu, ppol->policy->cpus) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+		now_idle = get_cpu_idle_time(cpu, &now, tunables->io_is_busy);
+		delta_idle = now_idle - pcpu->frame_idle;
+		active_time = now - pcpu->frame_timestamp;
+		active_time = active_time > delta_idle ?
+			      active_time - delta_idle : 0;
+		pcpu->frame_work += active_time * ppol->policy->cur;
+		pcpu->frame_idle = now_idle;
+		pcpu->frame_timestamp = now;
+		work = max(work, pcpu->frame_work);
+	}
+
+	return work;
+}
+
+static u64 frame_pred_work(struct cpufreq_interactive_policyinfo *ppol)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		ppol->policy->governor_data;
+
+	return div_u64(ppol->frame_pred * (100 + tunables->frame_headroom),
+		       100);
+}
+
+/* Called with load_lock held. */
+static unsigned int frame_deadline_freq(
+		struct cpufreq_interactive_policyinfo *ppol, u64 now)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		ppol->policy->governor_data;
+	u64 done, pred;
+
+	if (!ppol->frame_deadline)
+		return 0;
+
+	done = frame_update_work(ppol);
+	if (now >= ppol->frame_deadline) {
+		/* No new frame for a whole period, the producer went idle */
+		if (now - ppol->frame_deadline >=
+		    ppol->frame_deadline - ppol->frame_start)
+			ppol->frame_deadline = 0;
+		return 0;
+	}
+
+	pred = frame_pred_work(ppol);
+	if (!pred)
+		return 0;
+	/* Frame is heavier than predicted, avoid missing the deadline */
+	if (done >= pred)
+		return tunables->hispeed_freq;
+
+	return div64_u64(pred - done, ppol->frame_deadline - now);
+}
+
+/*
+ * Window prediction: Holt's double exponential smoothing of the policy's
+ * loadadjfreq, with the level weighted 1/2 and the trend 1/4, projects
+ * the demand of the next window so that the governor ramps ahead of a
+ * growing burst instead of a window behind it.
+ *
+ * Called with target_freq_lock held.
+ */
+static unsigned int window_predict(struct cpufreq_interactive_policyinfo *ppol,
+				   unsigned int laf)
+{
+	s64 level, prev_level, pred, err;
+	unsigned int base;
+
+	if (!ppol->wp_samples) {
+		level = laf;
+		ppol->wp_trend = 0;
+	} else {
+		err = (s64)laf - ppol->wp_pred;
+		base = max(laf, ppol->wp_pred);
+		if (err > 0)
+			ppol->wp_under++;
+		else if (err < 0)
+			ppol->wp_over++;
+		if (base)
+			ppol->wp_err_sum += div_u64(abs(err) * 100, base);
+
+		prev_level = ppol->wp_level;
+		level = (laf + prev_level + ppol->wp_trend) >> 1;
+		ppol->wp_trend = (level - prev_level + 3 * ppol->wp_trend) >> 2;
+	}
+	ppol->wp_level = level;
+	ppol->wp_samples++;
+
+	pred = clamp_t(s64, level + ppol->wp_trend, 0, UINT_MAX);
+	ppol->wp_pred = pred;
+	return ppol->wp_pred;
+}
+
 static unsigned int sl_busy_to_laf(struct cpufreq_interactive_policyinfo *ppol,
 				   unsigned long busy)
 {
@@ -480,6 +620,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	bool jump_to_max_no_ts = false;
 	bool jump_to_max = false;
 	bool start_hyst = true;
+	unsigned int frame_freq;
+	unsigned int wp_laf;
 
 	if (!down_read_trylock(&ppol->enable_sem))
 		return;
@@ -552,8 +694,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 		}
 		i++;
 	}
+	frame_freq = frame_deadline_freq(ppol, now);
 	spin_unlock(&ppol->load_lock);
 
+	if (tunables->window_predict) {
+		wp_laf = window_predict(ppol, prev_laf);
+		pred_laf = max(pred_laf, wp_laf);
+		/* The burst is ending, let the frequency drop right away */
+		if (ppol->wp_trend < 0 && wp_laf < prev_laf)
+			skip_min_sample_time = true;
+	}
+
 	tunables->boosted = tunables->boost_val || now < tunables->boostpulse_endtime;
 
 	prev_chfreq = choose_freq(ppol, prev_laf);
@@ -588,6 +739,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 		}
 	}
 
+	/* The frame deadline overrides above_hispeed_delay */
+	if (frame_freq > new_freq) {
+		new_freq = frame_freq;
+		skip_hispeed_logic = true;
+	}
+
 	if (now - ppol->max_freq_hyst_start_time <
 	    tunables->max_freq_hysteresis) {
 		if (new_freq < ppol->policy->max &&
@@ -790,6 +947,72 @@ static void cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunab
 		wake_up_process_no_notif(speedchange_task);
 }
 
+static void cpufreq_interactive_frame_start(
+		struct cpufreq_interactive_tunables *tunables,
+		unsigned long period_us)
+{
+	int cpu, index;
+	int anyraise = 0;
+	unsigned long flags;
+	unsigned int freq;
+	u64 now, work;
+	struct cpufreq_interactive_policyinfo *ppol;
+
+	for_each_online_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol || tunables != ppol->policy->governor_data)
+			continue;
+		if (cpu != cpumask_first(ppol->policy->cpus))
+			continue;
+		if (!down_read_trylock(&ppol->enable_sem))
+			continue;
+		if (!ppol->governor_enabled) {
+			up_read(&ppol->enable_sem);
+			continue;
+		}
+
+		now = ktime_to_us(ktime_get());
+		spin_lock_irqsave(&ppol->load_lock, flags);
+		work = frame_update_work(ppol);
+		if (ppol->frame_deadline)
+			ppol->frame_pred = max(work, ppol->frame_pred -
+					       (ppol->frame_pred >> 2));
+		else
+			ppol->frame_pred = 0;
+		for_each_cpu(index, ppol->policy->cpus)
+			per_cpu(cpuinfo, index).frame_work = 0;
+		ppol->frame_start = now;
+		ppol->frame_deadline = period_us ? now + period_us : 0;
+		freq = period_us ?
+		       div64_u64(frame_pred_work(ppol), period_us) : 0;
+		spin_unlock_irqrestore(&ppol->load_lock, flags);
+
+		if (freq) {
+			spin_lock_irqsave(&ppol->target_freq_lock, flags);
+			if (!cpufreq_frequency_table_target(&ppol->p_nolim,
+					ppol->freq_table, freq,
+					CPUFREQ_RELATION_L, &index) &&
+			    ppol->target_freq <
+			    ppol->freq_table[index].frequency) {
+				ppol->target_freq =
+					ppol->freq_table[index].frequency;
+				ppol->floor_freq = ppol->target_freq;
+				ppol->floor_validate_time = now;
+				ppol->hispeed_validate_time = now;
+				spin_lock(&speedchange_cpumask_lock);
+				cpumask_set_cpu(cpu, &speedchange_cpumask);
+				spin_unlock(&speedchange_cpumask_lock);
+				anyraise = 1;
+			}
+			spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
+		}
+		up_read(&ppol->enable_sem);
+	}
+
+	if (anyraise)
+		wake_up_process_no_notif(speedchange_task);
+}
+
 static int load_change_callback(struct notifier_block *nb, unsigned long val,
 				void *data)
 {
@@ -1058,6 +1281,79 @@ show_store_one(align_windows);
 show_store_one(ignore_hispeed_on_notif);
 show_store_one(fast_ramp_down);
 show_store_one(enable_prediction);
+show_store_one(frame_headroom);
+
+static ssize_t show_window_predict(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->window_predict);
+}
+
+static ssize_t store_window_predict(
+		struct cpufreq_interactive_tunables *tunables,
+		const char *buf, size_t count)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	unsigned long flags;
+	int ret, cpu;
+	bool val;
+
+	ret = strtobool(buf, &val);
+	if (ret < 0)
+		return ret;
+
+	for_each_possible_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol || ppol->policy->governor_data != tunables ||
+		    cpu != cpumask_first(ppol->policy->related_cpus))
+			continue;
+		spin_lock_irqsave(&ppol->target_freq_lock, flags);
+		ppol->wp_samples = 0;
+		ppol->wp_err_sum = 0;
+		ppol->wp_under = 0;
+		ppol->wp_over = 0;
+		spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
+	}
+	tunables->window_predict = val;
+	return count;
+}
+
+/*
+ * Prediction error of the windows seen since window_predict was last
+ * written: the mean absolute error in percent of the larger of the
+ * predicted and actual load, and how often the actual load was above
+ * (under) or below (over) the prediction.
+ */
+static ssize_t show_window_predict_stats(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	unsigned long flags;
+	ssize_t ret = 0;
+	u64 samples, err_sum, under, over;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol || ppol->policy->governor_data != tunables ||
+		    cpu != cpumask_first(ppol->policy->related_cpus))
+			continue;
+		spin_lock_irqsave(&ppol->target_freq_lock, flags);
+		samples = ppol->wp_samples;
+		err_sum = ppol->wp_err_sum;
+		under = ppol->wp_under;
+		over = ppol->wp_over;
+		spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
+
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"cpu%d: samples %llu err_pct %llu under %llu over %llu\n",
+				cpu, samples,
+				samples > 1 ? div64_u64(err_sum, samples - 1) : 0,
+				under, over);
+	}
+
+	return ret;
+}
 
 static ssize_t show_go_hispeed_load(struct cpufreq_interactive_tunables
 		*tunables, char *buf)
@@ -1204,6 +1500,21 @@ static ssize_t store_boostpulse(struct cpufreq_interactive_tunables *tunables,
 	return count;
 }
 
+static ssize_t store_frame_deadline(
+		struct cpufreq_interactive_tunables *tunables,
+		const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	cpufreq_interactive_frame_start(tunables, val);
+	return count;
+}
+
 static ssize_t show_boostpulse_duration(struct cpufreq_interactive_tunables
 		*tunables, char *buf)
 {
@@ -1453,6 +1764,10 @@ show_store_gov_pol_sys(align_windows);
 show_store_gov_pol_sys(ignore_hispeed_on_notif);
 show_store_gov_pol_sys(fast_ramp_down);
 show_store_gov_pol_sys(enable_prediction);
+show_store_gov_pol_sys(frame_headroom);
+show_store_gov_pol_sys(window_predict);
+show_gov_pol_sys(window_predict_stats);
+store_gov_pol_sys(frame_deadline);
 
 #define gov_sys_attr_rw(_name)						\
 static struct kobj_attribute _name##_gov_sys =				\
@@ -1483,6 +1798,16 @@ gov_sys_pol_attr_rw(align_windows);
 gov_sys_pol_attr_rw(ignore_hispeed_on_notif);
 gov_sys_pol_attr_rw(fast_ramp_down);
 gov_sys_pol_attr_rw(enable_prediction);
+gov_sys_pol_attr_rw(frame_headroom);
+gov_sys_pol_attr_rw(window_predict);
+
+static struct kobj_attribute window_predict_stats_gov_sys =
+	__ATTR(window_predict_stats, 0444, show_window_predict_stats_gov_sys,
+	       NULL);
+
+static struct freq_attr window_predict_stats_gov_pol =
+	__ATTR(window_predict_stats, 0444, show_window_predict_stats_gov_pol,
+	       NULL);
 
 static struct kobj_attribute boostpulse_gov_sys =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_sys);
@@ -1490,6 +1815,12 @@ static struct kobj_attribute boostpulse_gov_sys =
 static struct freq_attr boostpulse_gov_pol =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_pol);
 
+static struct kobj_attribute frame_deadline_gov_sys =
+	__ATTR(frame_deadline, 0200, NULL, store_frame_deadline_gov_sys);
+
+static struct freq_attr frame_deadline_gov_pol =
+	__ATTR(frame_deadline, 0200, NULL, store_frame_deadline_gov_pol);
+
 /* One Governor instance for entire system */
 static struct attribute *interactive_attributes_gov_sys[] = {
 	&target_loads_gov_sys.attr,
@@ -1510,6 +1841,10 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&ignore_hispeed_on_notif_gov_sys.attr,
 	&fast_ramp_down_gov_sys.attr,
 	&enable_prediction_gov_sys.attr,
+	&frame_headroom_gov_sys.attr,
+	&frame_deadline_gov_sys.attr,
+	&window_predict_gov_sys.attr,
+	&window_predict_stats_gov_sys.attr,
 	NULL,
 };
 
@@ -1538,6 +1873,10 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&ignore_hispeed_on_notif_gov_pol.attr,
 	&fast_ramp_down_gov_pol.attr,
 	&enable_prediction_gov_pol.attr,
+	&frame_headroom_gov_pol.attr,
+	&frame_deadline_gov_pol.attr,
+	&window_predict_gov_pol.attr,
+	&window_predict_stats_gov_pol.attr,
 	NULL,
 };
 
@@ -1577,6 +1916,7 @@ static struct cpufreq_interactive_tunables *alloc_tunable(
 	tunables->timer_rate = DEFAULT_TIMER_RATE;
 	tunables->boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
 	tunables->timer_slack_val = DEFAULT_TIMER_SLACK;
+	tunables->frame_headroom = DEFAULT_FRAME_HEADROOM;
 
 	spin_lock_init(&tunables->target_loads_lock);
 	spin_lock_init(&tunables->above_hispeed_delay_lock);
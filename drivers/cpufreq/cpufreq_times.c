@@ -18,6 +18,7 @@
 #include <linux/cputime.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
@@ -32,18 +33,24 @@ DECLARE_HASHTABLE(uid_hash_table, UID_HASH_BITS);
 static DEFINE_SPINLOCK(task_time_in_state_lock); /* task->time_in_state */
 static DEFINE_SPINLOCK(uid_lock); /* uid_hash_table */
 
+/*
+ * The per-UID times are accumulated per CPU by the tick of that CPU and
+ * folded on read, so the update path only needs rcu_read_lock() to find
+ * the entry.
+ */
 struct concurrent_times {
-	atomic64_t active[NR_CPUS];
-	atomic64_t policy[NR_CPUS];
+	u64 active[NR_CPUS];
+	u64 policy[NR_CPUS];
 };
 
 struct uid_entry {
 	uid_t uid;
 	unsigned int max_state;
+	u64 last_gen;
 	struct hlist_node hash;
 	struct rcu_head rcu;
-	struct concurrent_times *concurrent_times;
-	u64 time_in_state[0];
+	struct concurrent_times __percpu *concurrent_times;
+	u64 __percpu *time_in_state;
 };
 
 /**
@@ -51,12 +58,14 @@ struct uid_entry {
  * @offset: start of these freqs' stats in task time_in_state array
  * @max_state: number of entries in freq_table
  * @last_index: index in freq_table of last frequency switched to
+ * @first_cpu: first of the policy's related CPUs
  * @freq_table: list of available frequencies
  */
 struct cpu_freqs {
 	unsigned int offset;
 	unsigned int max_state;
 	unsigned int last_index;
+	unsigned int first_cpu;
 	unsigned int freq_table[0];
 };
 
@@ -64,6 +73,34 @@ static struct cpu_freqs *all_freqs[NR_CPUS];
 
 static unsigned int next_offset;
 
+/*
+ * Generation of the binary uid_time_in_state export, bumped by each read
+ * of it. An entry records the generation it was last charged in.
+ */
+static atomic64_t uid_times_gen = ATOMIC64_INIT(1);
+
+#define UID_TIMES_BIN_VERSION	1
+
+/**
+ * struct uid_times_bin_hdr - header of /proc/uid_time_in_state_bin
+ * @version: UID_TIMES_BIN_VERSION
+ * @nr_freqs: number of frequencies, each a u32 in kHz following the header
+ * @gen: generation to write back to only get the UIDs charged since
+ *
+ * The frequencies are followed by one record per UID: the uid as a u32,
+ * a u32 of padding and nr_freqs u64 times in clock ticks.
+ */
+struct uid_times_bin_hdr {
+	u32 version;
+	u32 nr_freqs;
+	u64 gen;
+};
+
+struct uid_times_bin_iter {
+	u64 since;
+	u64 gen;
+};
+
 
 /* Caller must hold rcu_read_lock() */
 static struct uid_entry *find_uid_entry_rcu(uid_t uid)
@@ -89,41 +126,74 @@ static struct uid_entry *find_uid_entry_locked(uid_t uid)
 	return NULL;
 }
 
+static u64 __percpu *alloc_uid_time_in_state(unsigned int max_state)
+{
+	return __alloc_percpu_gfp(max_state * sizeof(u64), sizeof(u64),
+				  GFP_ATOMIC);
+}
+
+static u64 uid_entry_time_in_state(struct uid_entry *uid_entry,
+				   unsigned int state)
+{
+	u64 time = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		time += per_cpu_ptr(uid_entry->time_in_state, cpu)[state];
+	return time;
+}
+
+static void uid_entry_resize_reclaim(struct rcu_head *rcu)
+{
+	struct uid_entry *uid_entry = container_of(rcu, struct uid_entry, rcu);
+
+	free_percpu(uid_entry->time_in_state);
+	kfree(uid_entry);
+}
+
 /* Caller must hold uid lock */
 static struct uid_entry *find_or_register_uid_locked(uid_t uid)
 {
 	struct uid_entry *uid_entry, *temp;
-	struct concurrent_times *times;
+	struct concurrent_times __percpu *times;
 	unsigned int max_state = READ_ONCE(next_offset);
-	size_t alloc_size = sizeof(*uid_entry) + max_state *
-		sizeof(uid_entry->time_in_state[0]);
+	int cpu;
 
 	uid_entry = find_uid_entry_locked(uid);
 	if (uid_entry) {
 		if (uid_entry->max_state == max_state)
 			return uid_entry;
 		/* uid_entry->time_in_state is too small to track all freqs, so
-		 * expand it.
+		 * replace the entry with a larger one. Ticks on other CPUs
+		 * still adding to the old entry while it is copied may be
+		 * lost, this only happens when a policy is added.
 		 */
-		temp = __krealloc(uid_entry, alloc_size, GFP_ATOMIC);
+		temp = kmemdup(uid_entry, sizeof(*uid_entry), GFP_ATOMIC);
 		if (!temp)
 			return uid_entry;
-		temp->max_state = max_state;
-		memset(temp->time_in_state + uid_entry->max_state, 0,
-		       (max_state - uid_entry->max_state) *
-		       sizeof(uid_entry->time_in_state[0]));
-		if (temp != uid_entry) {
-			hlist_replace_rcu(&uid_entry->hash, &temp->hash);
-			kfree_rcu(uid_entry, rcu);
+		temp->time_in_state = alloc_uid_time_in_state(max_state);
+		if (!temp->time_in_state) {
+			kfree(temp);
+			return uid_entry;
 		}
+		temp->max_state = max_state;
+		for_each_possible_cpu(cpu)
+			memcpy(per_cpu_ptr(temp->time_in_state, cpu),
+			       per_cpu_ptr(uid_entry->time_in_state, cpu),
+			       uid_entry->max_state * sizeof(u64));
+		hlist_replace_rcu(&uid_entry->hash, &temp->hash);
+		call_rcu(&uid_entry->rcu, uid_entry_resize_reclaim);
 		return temp;
 	}
 
-	uid_entry = kzalloc(alloc_size, GFP_ATOMIC);
+	uid_entry = kzalloc(sizeof(*uid_entry), GFP_ATOMIC);
 	if (!uid_entry)
 		return NULL;
-	times = kzalloc(sizeof(*times), GFP_ATOMIC);
-	if (!times) {
+	uid_entry->time_in_state = alloc_uid_time_in_state(max_state);
+	times = alloc_percpu_gfp(struct concurrent_times, GFP_ATOMIC);
+	if (!uid_entry->time_in_state || !times) {
+		free_percpu(uid_entry->time_in_state);
+		free_percpu(times);
 		kfree(uid_entry);
 		return NULL;
 	}
@@ -174,7 +244,8 @@ static int single_uid_time_in_state_show(struct seq_file *m, void *ptr)
 	for (i = 0; i < uid_entry->max_state; ++i) {
 		if (freq_index_invalid(i))
 			continue;
-		time = cputime_to_clock_t(uid_entry->time_in_state[i]);
+		time = cputime_to_clock_t(uid_entry_time_in_state(uid_entry,
+								   i));
 		seq_write(m, &time, sizeof(time));
 	}
 
@@ -240,7 +311,8 @@ static int uid_time_in_state_seq_show(struct seq_file *m, void *v)
 			u64 time;
 			if (freq_index_invalid(i))
 				continue;
-			time = cputime_to_clock_t(uid_entry->time_in_state[i]);
+			time = cputime_to_clock_t(
+				uid_entry_time_in_state(uid_entry, i));
 			seq_put_decimal_ull(m, " ", time);
 		}
 		if (uid_entry->max_state)
@@ -251,23 +323,88 @@ static int uid_time_in_state_seq_show(struct seq_file *m, void *v)
 	return 0;
 }
 
-static int concurrent_time_seq_show(struct seq_file *m, void *v,
-	atomic64_t *(*get_times)(struct concurrent_times *))
+static void *uid_times_bin_seq_start(struct seq_file *seq, loff_t *pos)
 {
+	struct uid_times_bin_iter *iter = seq->private;
+
+	/* Entries charged from here on are reported again next time */
+	if (!*pos)
+		iter->gen = atomic64_inc_return(&uid_times_gen);
+
+	return uid_seq_start(seq, pos);
+}
+
+static int uid_times_bin_seq_show(struct seq_file *m, void *v)
+{
+	struct uid_times_bin_iter *iter = m->private;
+	struct uid_times_bin_hdr hdr = { .version = UID_TIMES_BIN_VERSION };
 	struct uid_entry *uid_entry;
-	int i, num_possible_cpus = num_possible_cpus();
+	struct cpu_freqs *freqs, *last_freqs = NULL;
+	unsigned int i, max_state;
+	u32 uid[2] = { 0 };
+	u64 time;
+	int cpu;
+
+	max_state = READ_ONCE(next_offset);
+	if (v == uid_hash_table) {
+		for (i = 0; i < max_state; i++)
+			if (!freq_index_invalid(i))
+				hdr.nr_freqs++;
+		hdr.gen = iter->gen;
+		seq_write(m, &hdr, sizeof(hdr));
+
+		for_each_possible_cpu(cpu) {
+			freqs = all_freqs[cpu];
+			if (!freqs || freqs == last_freqs)
+				continue;
+			last_freqs = freqs;
+			for (i = 0; i < freqs->max_state; i++)
+				if (freqs->freq_table[i] !=
+				    CPUFREQ_ENTRY_INVALID)
+					seq_write(m, &freqs->freq_table[i],
+						  sizeof(u32));
+		}
+	}
 
 	rcu_read_lock();
 
 	hlist_for_each_entry_rcu(uid_entry, (struct hlist_head *)v, hash) {
-		atomic64_t *times = get_times(uid_entry->concurrent_times);
+		if (READ_ONCE(uid_entry->last_gen) < iter->since)
+			continue;
+		uid[0] = uid_entry->uid;
+		seq_write(m, uid, sizeof(uid));
+		for (i = 0; i < max_state; ++i) {
+			if (freq_index_invalid(i))
+				continue;
+			time = i < uid_entry->max_state ? cputime_to_clock_t(
+				uid_entry_time_in_state(uid_entry, i)) : 0;
+			seq_write(m, &time, sizeof(time));
+		}
+	}
 
+	rcu_read_unlock();
+	return 0;
+}
+
+static int concurrent_time_seq_show(struct seq_file *m, void *v,
+	u64 *(*get_times)(struct concurrent_times *))
+{
+	struct uid_entry *uid_entry;
+	int i, cpu, num_possible_cpus = num_possible_cpus();
+
+	rcu_read_lock();
+
+	hlist_for_each_entry_rcu(uid_entry, (struct hlist_head *)v, hash) {
 		seq_put_decimal_ull(m, "", (u64)uid_entry->uid);
 		seq_putc(m, ':');
 
 		for (i = 0; i < num_possible_cpus; ++i) {
-			u64 time = cputime_to_clock_t(atomic64_read(&times[i]));
+			u64 time = 0;
 
+			for_each_possible_cpu(cpu)
+				time += get_times(per_cpu_ptr(
+					uid_entry->concurrent_times, cpu))[i];
+			time = cputime_to_clock_t(time);
 			seq_put_decimal_ull(m, " ", time);
 		}
 		seq_putc(m, '\n');
@@ -278,7 +415,7 @@ static int concurrent_time_seq_show(struct seq_file *m, void *v,
 	return 0;
 }
 
-static inline atomic64_t *get_active_times(struct concurrent_times *times)
+static inline u64 *get_active_times(struct concurrent_times *times)
 {
 	return times->active;
 }
@@ -293,7 +430,7 @@ static int concurrent_active_time_seq_show(struct seq_file *m, void *v)
 	return concurrent_time_seq_show(m, v, get_active_times);
 }
 
-static inline atomic64_t *get_policy_times(struct concurrent_times *times)
+static inline u64 *get_policy_times(struct concurrent_times *times)
 {
 	return times->policy;
 }
@@ -421,16 +558,20 @@ int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
 	return 0;
 }
 
+/*
+ * Called from the tick for the task running on the local CPU, so p can
+ * neither exit nor run anywhere else meanwhile: its time_in_state only
+ * needs the lock when it is reallocated, against readers in procfs.
+ */
 void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime)
 {
 	unsigned long flags;
 	unsigned int state;
 	unsigned int active_cpu_cnt = 0;
 	unsigned int policy_cpu_cnt = 0;
-	unsigned int policy_first_cpu;
 	struct uid_entry *uid_entry;
+	struct concurrent_times *times;
 	struct cpu_freqs *freqs = all_freqs[task_cpu(p)];
-	struct cpufreq_policy *policy;
 	uid_t uid = from_kuid_munged(current_user_ns(), task_uid(p));
 	int cpu = 0;
 
@@ -439,52 +580,50 @@ void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime)
 
 	state = freqs->offset + READ_ONCE(freqs->last_index);
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	if ((state < p->max_state || !cpufreq_task_times_realloc_locked(p)) &&
-	    p->time_in_state)
+	if (likely(state < p->max_state && p->time_in_state)) {
 		p->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
-
-	spin_lock_irqsave(&uid_lock, flags);
-	uid_entry = find_or_register_uid_locked(uid);
-	if (uid_entry && state < uid_entry->max_state)
-		uid_entry->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&uid_lock, flags);
+	} else {
+		spin_lock_irqsave(&task_time_in_state_lock, flags);
+		if ((state < p->max_state ||
+		     !cpufreq_task_times_realloc_locked(p)) &&
+		    p->time_in_state)
+			p->time_in_state[state] += cputime;
+		spin_unlock_irqrestore(&task_time_in_state_lock, flags);
+	}
 
 	rcu_read_lock();
 	uid_entry = find_uid_entry_rcu(uid);
-	if (!uid_entry) {
+	if (unlikely(!uid_entry ||
+		     uid_entry->max_state != READ_ONCE(next_offset))) {
 		rcu_read_unlock();
-		return;
+		spin_lock_irqsave(&uid_lock, flags);
+		find_or_register_uid_locked(uid);
+		spin_unlock_irqrestore(&uid_lock, flags);
+		rcu_read_lock();
+		uid_entry = find_uid_entry_rcu(uid);
+		if (!uid_entry) {
+			rcu_read_unlock();
+			return;
+		}
 	}
 
-	for_each_possible_cpu(cpu)
-		if (!idle_cpu(cpu))
-			++active_cpu_cnt;
-
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->active[active_cpu_cnt - 1]);
+	if (state < uid_entry->max_state)
+		this_cpu_ptr(uid_entry->time_in_state)[state] += cputime;
+	if (READ_ONCE(uid_entry->last_gen) != atomic64_read(&uid_times_gen))
+		WRITE_ONCE(uid_entry->last_gen, atomic64_read(&uid_times_gen));
 
-	policy = cpufreq_cpu_get(task_cpu(p));
-	if (!policy) {
-		/*
-		 * This CPU may have just come up and not have a cpufreq policy
-		 * yet.
-		 */
-		rcu_read_unlock();
-		return;
-	}
-
-	for_each_cpu(cpu, policy->related_cpus)
-		if (!idle_cpu(cpu))
+	/* The policy count covers the busy CPUs sharing this CPU's freqs */
+	for_each_possible_cpu(cpu) {
+		if (idle_cpu(cpu))
+			continue;
+		++active_cpu_cnt;
+		if (all_freqs[cpu] == freqs)
 			++policy_cpu_cnt;
+	}
 
-	policy_first_cpu = cpumask_first(policy->related_cpus);
-	cpufreq_cpu_put(policy);
-
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->policy[policy_first_cpu +
-							  policy_cpu_cnt - 1]);
+	times = this_cpu_ptr(uid_entry->concurrent_times);
+	times->active[active_cpu_cnt - 1] += cputime;
+	times->policy[freqs->first_cpu + policy_cpu_cnt - 1] += cputime;
 	rcu_read_unlock();
 }
 
@@ -521,6 +660,7 @@ void cpufreq_times_create_policy(struct cpufreq_policy *policy)
 	cpufreq_for_each_entry(pos, table)
 		freqs->freq_table[pos - table] = pos->frequency;
 
+	freqs->first_cpu = cpumask_first(policy->related_cpus);
 	freqs->offset = next_offset;
 	WRITE_ONCE(next_offset, freqs->offset + count);
 	for_each_cpu(cpu, policy->related_cpus)
@@ -531,7 +671,8 @@ static void uid_entry_reclaim(struct rcu_head *rcu)
 {
 	struct uid_entry *uid_entry = container_of(rcu, struct uid_entry, rcu);
 
-	kfree(uid_entry->concurrent_times);
+	free_percpu(uid_entry->concurrent_times);
+	free_percpu(uid_entry->time_in_state);
 	kfree(uid_entry);
 }
 
@@ -601,6 +742,44 @@ static const struct file_operations uid_time_in_state_fops = {
 	.release	= seq_release,
 };
 
+static const struct seq_operations uid_times_bin_seq_ops = {
+	.start = uid_times_bin_seq_start,
+	.next = uid_seq_next,
+	.stop = uid_seq_stop,
+	.show = uid_times_bin_seq_show,
+};
+
+static int uid_times_bin_open(struct inode *inode, struct file *file)
+{
+	return seq_open_private(file, &uid_times_bin_seq_ops,
+				sizeof(struct uid_times_bin_iter));
+}
+
+/* Writing the gen of an earlier read limits the next reads to changed UIDs */
+static ssize_t uid_times_bin_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct uid_times_bin_iter *iter = m->private;
+	u64 since;
+	int ret;
+
+	ret = kstrtou64_from_user(ubuf, count, 0, &since);
+	if (ret)
+		return ret;
+
+	iter->since = since;
+	return count;
+}
+
+static const struct file_operations uid_times_bin_fops = {
+	.open		= uid_times_bin_open,
+	.read		= seq_read,
+	.write		= uid_times_bin_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release_private,
+};
+
 static const struct seq_operations concurrent_active_time_seq_ops = {
 	.start = uid_seq_start,
 	.next = uid_seq_next,
@@ -644,6 +823,9 @@ static int __init cpufreq_times_init(void)
 	proc_create_data("uid_time_in_state", 0444, NULL,
 			 &uid_time_in_state_fops, NULL);
 
+	proc_create_data("uid_time_in_state_bin", 0644, NULL,
+			 &uid_times_bin_fops, NULL);
+
 	proc_create_data("uid_concurrent_active_time", 0444, NULL,
 			 &concurrent_active_time_fops, NULL);
 
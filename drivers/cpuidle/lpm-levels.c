@@ -21,6 +21,7 @@
 #include <linux/mutex.h>
 #include <linux/cpu.h>
 #include <linux/of.h>
+#include <linux/interrupt.h>
 #include <linux/irqchip/msm-mpm-irq.h>
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
@@ -37,6 +38,8 @@
 #include <linux/sched.h>
 #include <linux/cpu_pm.h>
 #include <linux/arm-smccc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/spm.h>
 #include <soc/qcom/pm.h>
 #include <soc/qcom/rpm-notifier.h>
@@ -117,6 +120,66 @@ struct lpm_history {
 
 static DEFINE_PER_CPU(struct lpm_history, hist);
 
+/*
+ * Predictors of the idle residency: the history one looks at the spread
+ * of the last MAXSAMPLES residencies, the table one learns the residency
+ * that follows each combination of the last two residencies and of how
+ * the last idle period ended.
+ */
+enum lpm_predictor {
+	LPM_PRED_HISTORY,
+	LPM_PRED_TABLE,
+};
+
+static uint32_t lpm_predictor = LPM_PRED_HISTORY;
+module_param_named(
+	lpm_predictor, lpm_predictor, uint, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+/* log4 buckets of the residency in us, from <32us to >=128ms */
+#define LPM_TBL_BUCKETS		8
+#define LPM_TBL_MIN_CONF	2
+#define LPM_TBL_MAX_CONF	8
+
+/**
+ * struct lpm_pred_table - per-CPU lookup table predictor
+ * @resi: running average of the residency that followed each feature key
+ * @conf: number of periods averaged into @resi, saturating
+ * @last_resi: residency of the last idle period
+ * @prev_resi: residency of the one before
+ * @timer_wake: the last period ended on the timer rather than an IRQ
+ * @next_wakeup: timer wakeup expected when the current period was entered
+ */
+struct lpm_pred_table {
+	uint32_t resi[2][LPM_TBL_BUCKETS][LPM_TBL_BUCKETS];
+	uint8_t conf[2][LPM_TBL_BUCKETS][LPM_TBL_BUCKETS];
+	uint32_t last_resi;
+	uint32_t prev_resi;
+	bool timer_wake;
+	uint32_t next_wakeup;
+};
+
+static DEFINE_PER_CPU(struct lpm_pred_table, pred_table);
+
+/**
+ * struct lpm_pred_stats - per-CPU outcome of the level selection
+ * @hit: the selected level was the best one for the actual residency
+ * @shallow: a deeper level would have paid off
+ * @deep: the residency did not pay for the selected level
+ * @predicted: selections made on a predicted rather than timer residency
+ * @energy: energy model cost of the misses, in the DT's power units x us
+ */
+struct lpm_pred_stats {
+	uint64_t hit;
+	uint64_t shallow;
+	uint64_t deep;
+	uint64_t predicted;
+	uint64_t energy;
+	bool used_prediction;
+};
+
+static DEFINE_PER_CPU(struct lpm_pred_stats, pred_stats);
+
 static DEFINE_PER_CPU(struct lpm_cluster*, cpu_cluster);
 static bool suspend_in_progress;
 static struct hrtimer lpm_hrtimer;
@@ -138,6 +201,12 @@ static struct notifier_block __refdata lpm_cpu_nblk = {
 	.notifier_call = lpm_cpu_callback,
 };
 
+/* Cut the cluster sleep time short of the next periodic device IRQ */
+static bool lpm_irq_pred = true;
+module_param_named(
+	lpm_irq_pred, lpm_irq_pred, bool, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
 static bool menu_select;
 module_param_named(
 	menu_select, menu_select, bool, S_IRUGO | S_IWUSR | S_IWGRP
@@ -543,6 +612,95 @@ static int set_device_mode(struct lpm_cluster *cluster, int ndevice,
 		return -EINVAL;
 }
 
+static int lpm_tbl_bucket(uint32_t resi)
+{
+	return min(fls(resi >> 4) >> 1, LPM_TBL_BUCKETS - 1);
+}
+
+static uint64_t lpm_table_predict(struct cpuidle_device *dev)
+{
+	struct lpm_pred_table *t = &per_cpu(pred_table, dev->cpu);
+	struct lpm_history *history = &per_cpu(hist, dev->cpu);
+	int b0 = lpm_tbl_bucket(t->last_resi);
+	int b1 = lpm_tbl_bucket(t->prev_resi);
+
+	if (t->conf[t->timer_wake][b0][b1] < LPM_TBL_MIN_CONF) {
+		history->stime = 0;
+		return 0;
+	}
+
+	history->stime = ktime_to_us(ktime_get()) +
+				t->resi[t->timer_wake][b0][b1];
+	return t->resi[t->timer_wake][b0][b1];
+}
+
+/* Train the table on the residency of the idle period that just ended */
+static void lpm_table_update(struct cpuidle_device *dev)
+{
+	struct lpm_pred_table *t = &per_cpu(pred_table, dev->cpu);
+	uint32_t resi = dev->last_residency;
+	int b0 = lpm_tbl_bucket(t->last_resi);
+	int b1 = lpm_tbl_bucket(t->prev_resi);
+	uint32_t *avg = &t->resi[t->timer_wake][b0][b1];
+	uint8_t *conf = &t->conf[t->timer_wake][b0][b1];
+
+	if (!*conf)
+		*avg = resi;
+	else
+		*avg = *avg - (*avg >> 2) + (resi >> 2);
+	if (*conf < LPM_TBL_MAX_CONF)
+		(*conf)++;
+
+	t->prev_resi = t->last_resi;
+	t->last_resi = resi;
+	t->timer_wake = t->next_wakeup && resi + tmr_add >= t->next_wakeup;
+}
+
+static uint32_t lpm_level_energy(struct power_params *pwr, uint32_t resi)
+{
+	uint32_t t = resi > pwr->time_overhead_us ?
+			resi - pwr->time_overhead_us : 0;
+
+	return pwr->energy_overhead + pwr->ss_power * t;
+}
+
+/*
+ * Compare the selected level with the level that the actual residency
+ * called for, and charge the energy model's cost of the difference.
+ */
+static void lpm_pred_account(struct cpuidle_device *dev, struct lpm_cpu *cpu,
+		int idx)
+{
+	struct lpm_pred_stats *st = &per_cpu(pred_stats, dev->cpu);
+	uint32_t *max_residency = get_per_cpu_max_residency(dev->cpu);
+	uint32_t resi = dev->last_residency;
+	uint32_t used, best;
+	int ideal;
+
+	for (ideal = 0; ideal < cpu->nlevels - 1; ideal++)
+		if (max_residency[ideal] && resi <= max_residency[ideal])
+			break;
+
+	if (st->used_prediction)
+		st->predicted++;
+	st->used_prediction = false;
+
+	if (idx == ideal) {
+		st->hit++;
+		return;
+	}
+
+	if (idx < ideal)
+		st->shallow++;
+	else
+		st->deep++;
+
+	used = lpm_level_energy(&cpu->levels[idx].pwr, resi);
+	best = lpm_level_energy(&cpu->levels[ideal].pwr, resi);
+	if (used > best)
+		st->energy += used - best;
+}
+
 static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 		struct lpm_cpu *cpu, int *idx_restrict,
 		uint32_t *idx_restrict_time)
@@ -556,6 +714,9 @@ static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 	if (!lpm_prediction)
 		return 0;
 
+	if (lpm_predictor == LPM_PRED_TABLE)
+		return lpm_table_predict(dev);
+
 	/*
 	 * Samples are marked invalid when woken-up due to timer,
 	 * so donot predict.
@@ -773,6 +934,10 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	if (modified_time_us)
 		msm_pm_set_timer(modified_time_us);
 
+	per_cpu(pred_table, dev->cpu).next_wakeup = next_wakeup_us;
+	per_cpu(pred_stats, dev->cpu).used_prediction = predicted ||
+				idx_restrict != (cpu->nlevels + 1);
+
 	/*
 	 * Start timer to avoid staying in shallower mode forever
 	 * incase of misprediciton
@@ -1029,6 +1194,28 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 	sleep_us = (uint32_t)get_cluster_sleep_time(cluster, NULL,
 						from_idle, &cpupred_us);
 
+	cluster->irq_pred = 0;
+	if (from_idle && lpm_irq_pred) {
+		u64 now = local_clock();
+		u64 irq_at;
+		unsigned int irq;
+
+		irq_at = irq_timings_next_event(now, &cluster->child_cpus,
+						&irq);
+		if (irq_at) {
+			uint64_t irq_us = irq_at - now;
+
+			do_div(irq_us, NSEC_PER_USEC);
+			if (irq_us < sleep_us) {
+				trace_cluster_irq_pred(cluster->cluster_name,
+						irq, sleep_us, irq_us);
+				sleep_us = irq_us;
+				cluster->irq_pred = irq;
+				cluster->irq_pred_time = irq_at;
+			}
+		}
+	}
+
 	if (from_idle) {
 		pred_mode = cluster_predict(cluster, &pred_us);
 
@@ -1345,6 +1532,15 @@ static void cluster_unprepare(struct lpm_cluster *cluster,
 			cluster->num_children_in_sync.bits[0],
 			cluster->child_cpus.bits[0], from_idle);
 
+	if (cluster->irq_pred) {
+		s64 err_us = (s64)(local_clock() - cluster->irq_pred_time);
+
+		trace_cluster_irq_pred_exit(cluster->cluster_name,
+				cluster->irq_pred, cluster->last_level,
+				div_s64(err_us, NSEC_PER_USEC));
+		cluster->irq_pred = 0;
+	}
+
 	last_level = cluster->last_level;
 	cluster->last_level = cluster->default_level;
 
@@ -1549,6 +1745,8 @@ static void update_history(struct cpuidle_device *dev, int idx)
 	if (!lpm_prediction)
 		return;
 
+	lpm_table_update(dev);
+
 	if (history->htmr_wkup) {
 		if (!history->hptr)
 			history->hptr = MAXSAMPLES-1;
@@ -1612,6 +1810,7 @@ exit:
 	do_div(end_time, 1000);
 	dev->last_residency = end_time;
 	update_history(dev, idx);
+	lpm_pred_account(dev, cluster->cpu, idx);
 	trace_cpu_idle_exit(idx, success);
 	local_irq_enable();
 	if (lpm_prediction) {
@@ -1864,6 +2063,64 @@ static const struct platform_suspend_ops lpm_suspend_ops = {
 	.wake = lpm_suspend_wake,
 };
 
+static int lpm_prediction_show(struct seq_file *m, void *unused)
+{
+	struct lpm_pred_stats *st;
+	uint64_t total;
+	int cpu;
+
+	seq_printf(m, "predictor: %s\n", lpm_predictor == LPM_PRED_TABLE ?
+		   "table" : "history");
+	seq_puts(m, "cpu      total   hit%%   shallow      deep  predicted     energy\n");
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(pred_stats, cpu);
+		total = st->hit + st->shallow + st->deep;
+		seq_printf(m, "%3d %10llu %6llu %9llu %9llu %10llu %10llu\n",
+			   cpu, total, total ? div64_u64(st->hit * 100, total) : 0,
+			   st->shallow, st->deep, st->predicted, st->energy);
+	}
+
+	return 0;
+}
+
+static int lpm_prediction_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_prediction_show, NULL);
+}
+
+/* Any write clears the counters */
+static ssize_t lpm_prediction_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(pred_stats, cpu), 0,
+		       sizeof(struct lpm_pred_stats));
+
+	return count;
+}
+
+static const struct file_operations lpm_prediction_fops = {
+	.open		= lpm_prediction_open,
+	.read		= seq_read,
+	.write		= lpm_prediction_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lpm_prediction_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lpm_levels", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("prediction", 0644, dir, NULL,
+			    &lpm_prediction_fops);
+}
+
 static int lpm_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -1938,6 +2195,8 @@ static int lpm_probe(struct platform_device *pdev)
 	if (msm_minidump_add_region(&md_entry))
 		pr_info("Failed to add lpm_debug in Minidump\n");
 
+	lpm_prediction_debugfs_init();
+
 	return 0;
 failed:
 	free_cluster_node(lpm_root_node);
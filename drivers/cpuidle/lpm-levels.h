@@ -126,6 +126,8 @@ struct lpm_cluster {
 	bool no_saw_devices;
 	struct cluster_history history;
 	struct hrtimer histtimer;
+	unsigned int irq_pred;
+	u64 irq_pred_time;
 };
 
 int set_l2_mode(struct low_power_ops *ops, int mode, bool notify_rpm);
@@ -61,6 +61,12 @@
 #define MAX_ALIGN_SIZE  0x40
 
 #define QCRYPTO_HIGH_BANDWIDTH_TIMEOUT 1000
+/*
+ * Extra idle QCRYPTO_HIGH_BANDWIDTH_TIMEOUT periods the bus vote is kept
+ * for. One is earned per busy period and one is spent per idle period, so
+ * an engine that has been busy for a while rides out short gaps.
+ */
+#define QCRYPTO_BW_MAX_HOLD 4
 
 
 
@@ -133,6 +139,7 @@ struct qcrypto_req_control {
 	struct crypto_async_request *req;
 	struct qcrypto_resp_ctx *arsp;
 	int res; /* execution result */
+	ktime_t issue_ts; /* time the request was handed to qce */
 };
 
 struct crypto_engine {
@@ -163,6 +170,13 @@ struct crypto_engine {
 	u32    active_seq;
 	/* last QCRYPTO_HIGH_BANDWIDTH_TIMEOUT active_seq */
 	u32    last_active_seq;
+	/* idle periods to keep the bus vote for, see QCRYPTO_BW_MAX_HOLD */
+	u32    bw_hold;
+	u32    bw_allocs; /* debug stats */
+	u32    bw_releases; /* debug stats */
+	u64    lat_cnt; /* debug stats */
+	u64    lat_sum_us; /* debug stats */
+	u32    lat_max_us; /* debug stats */
 
 	bool   check_flag;
 	/*Added to support multi-requests*/
@@ -667,6 +681,7 @@ static void qcrypto_bw_allocate_work(struct work_struct *work)
 	pengine->high_bw_req = false;
 	pengine->active_seq++;
 	pengine->check_flag = true;
+	pengine->bw_allocs++;
 	spin_unlock_irqrestore(&cp->lock, flags);
 	_start_qcrypto_process(cp, pengine);
 };
@@ -696,7 +711,12 @@ static void qcrypto_bw_reaper_work(struct work_struct *work)
 		}
 		if (cp->platform_support.bus_scale_table == NULL)
 			goto ret;
+		if (pengine->bw_hold) {
+			pengine->bw_hold--;
+			goto ret;
+		}
 		pengine->bw_state = BUS_BANDWIDTH_RELEASING;
+		pengine->bw_releases++;
 		spin_unlock_irqrestore(&cp->lock, flags);
 
 		qcrypto_ce_set_bus(pengine, false);
@@ -716,6 +736,9 @@ static void qcrypto_bw_reaper_work(struct work_struct *work)
 			restart = true;
 		} else
 			pengine->bw_state = BUS_NO_BANDWIDTH;
+	} else if (active_seq != pengine->last_active_seq &&
+			pengine->bw_hold < QCRYPTO_BW_MAX_HOLD) {
+		pengine->bw_hold++;
 	}
 ret:
 	pengine->last_active_seq = active_seq;
@@ -1264,6 +1287,23 @@ static int _disp_stats(int id)
 			pe->unit,
 			pe->err_req
 		);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Bus vote on, off        : %u %u\n",
+			pe->unit,
+			pe->bw_allocs,
+			pe->bw_releases
+		);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Latency avg, max (us)   : %llu %u\n",
+			pe->unit,
+			pe->lat_cnt ? div64_u64(pe->lat_sum_us,
+				pe->lat_cnt) : 0,
+			pe->lat_max_us
+		);
 		qce_get_driver_stats(pe->qce);
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
@@ -1675,6 +1715,15 @@ static void req_done(struct qcrypto_req_control *pqcrypto_req_control)
 	areq = pqcrypto_req_control->req;
 	arsp = pqcrypto_req_control->arsp;
 	res = pqcrypto_req_control->res;
+	if (areq) {
+		u32 lat_us = ktime_us_delta(ktime_get(),
+				pqcrypto_req_control->issue_ts);
+
+		pengine->lat_cnt++;
+		pengine->lat_sum_us += lat_us;
+		if (lat_us > pengine->lat_max_us)
+			pengine->lat_max_us = lat_us;
+	}
 	qcrypto_free_req_control(pengine, pqcrypto_req_control);
 
 	if (areq) {
@@ -2302,6 +2351,7 @@ again:
 	pqcrypto_req_control->pce = pengine;
 	pqcrypto_req_control->req = async_req;
 	pqcrypto_req_control->arsp = arsp;
+	pqcrypto_req_control->issue_ts = ktime_get();
 	pengine->active_seq++;
 	pengine->check_flag = true;
 
@@ -2362,6 +2412,21 @@ static inline struct crypto_engine *_next_eng(struct crypto_priv *cp,
 		p = list_entry(p->elist.next, struct crypto_engine, elist);
 	return p;
 }
+/* true if engine p is a better pick than q, call with spinlock set */
+static inline bool _eng_better(struct crypto_engine *p,
+		struct crypto_engine *q)
+{
+	bool p_bw, q_bw;
+
+	if (q == NULL)
+		return true;
+	p_bw = p->bw_state == BUS_HAS_BANDWIDTH;
+	q_bw = q->bw_state == BUS_HAS_BANDWIDTH;
+	if (p_bw != q_bw)
+		return p_bw;
+	return atomic_read(&p->req_count) < atomic_read(&q->req_count);
+}
+
 static struct crypto_engine *_avail_eng(struct crypto_priv *cp)
 {
 	/* call this function with spinlock set */
@@ -2375,18 +2440,24 @@ static struct crypto_engine *_avail_eng(struct crypto_priv *cp)
 		return NULL;
 	}
 
+	/*
+	 * Among the engines with a free slot prefer one that already holds
+	 * its bus vote, so a request does not wait for a vote while another
+	 * engine could run it, then the one with fewest requests in flight.
+	 * Ties go round robin starting after the last scheduled engine.
+	 */
 	p = _next_eng(cp, p);
 	q1 = p;
 	while (eng_cnt-- > 0) {
-		if (!p->issue_req && atomic_read(&p->req_count) < p->max_req) {
+		if (!p->issue_req && atomic_read(&p->req_count) < p->max_req &&
+				_eng_better(p, q))
 			q = p;
-			break;
-		}
 		p = _next_eng(cp, p);
 		if (q1 == p)
 			break;
 	}
-	cp->scheduled_eng = q;
+	if (q)
+		cp->scheduled_eng = q;
 	return q;
 }
 
@@ -4916,6 +4987,7 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 	pengine->high_bw_req = false;
 	pengine->active_seq = 0;
 	pengine->last_active_seq = 0;
+	pengine->bw_hold = 0;
 	pengine->check_flag = false;
 	pengine->max_req_used = 0;
 	pengine->issue_req = false;
@@ -5461,6 +5533,11 @@ static ssize_t _debug_stats_write(struct file *file, const char __user *buf,
 		pe->err_req = 0;
 		qce_clear_driver_stats(pe->qce);
 		pe->max_req_used = 0;
+		pe->bw_allocs = 0;
+		pe->bw_releases = 0;
+		pe->lat_cnt = 0;
+		pe->lat_sum_us = 0;
+		pe->lat_max_us = 0;
 	}
 	cp->max_qlen = 0;
 	cp->resp_start = 0;
@@ -36,11 +36,15 @@ enum ev_index {
 	INST_IDX,
 	L2DM_IDX,
 	CYC_IDX,
+	STALL_IDX,
 	NUM_EVENTS
 };
 #define INST_EV		0x08
 #define L2DM_EV		0x17
 #define CYC_EV		0x11
+#define STALL_EV	0x24
+
+#define MAX_TARGETS	4
 
 struct event_data {
 	struct perf_event *pevent;
@@ -49,30 +53,46 @@ struct event_data {
 
 struct memlat_hwmon_data {
 	struct event_data events[NUM_EVENTS];
-	ktime_t prev_ts;
 	bool init_pending;
 };
 static DEFINE_PER_CPU(struct memlat_hwmon_data, pm_data);
 
+/* Counts of one core gathered since a target's governor last sampled */
+struct core_acc {
+	unsigned long inst;
+	unsigned long mem;
+	unsigned long cyc;
+	unsigned long stall;
+};
+
+struct cpu_grp_info;
+
+struct memlat_target {
+	struct memlat_hwmon hw;
+	struct core_acc *acc;
+	ktime_t prev_ts;
+	struct cpu_grp_info *grp;
+};
+
+/*
+ * A group of CPUs can vote for several devices, e.g. DDR and the LLCC,
+ * from one set of perf counters. Every read is added to the accumulators
+ * of all targets and each target consumes its own when sampled, so the
+ * governors of the targets may run at different polling intervals.
+ */
 struct cpu_grp_info {
 	cpumask_t cpus;
-	struct memlat_hwmon hw;
+	unsigned int num_targets;
+	struct memlat_target targets[MAX_TARGETS];
+	unsigned int started;
+	struct mutex lock;
 	struct notifier_block arm_memlat_cpu_notif;
 };
 
-static unsigned long compute_freq(struct memlat_hwmon_data *hw_data,
-						unsigned long cyc_cnt)
+static unsigned long compute_freq(unsigned long cyc_cnt, unsigned int diff)
 {
-	ktime_t ts;
-	unsigned int diff;
-	unsigned long freq = 0;
+	unsigned long freq = cyc_cnt;
 
-	ts = ktime_get();
-	diff = ktime_to_us(ktime_sub(ts, hw_data->prev_ts));
-	if (!diff)
-		diff = 1;
-	hw_data->prev_ts = ts;
-	freq = cyc_cnt;
 	do_div(freq, diff);
 
 	return freq;
@@ -84,6 +104,9 @@ static inline unsigned long read_event(struct event_data *event)
 	unsigned long ev_count;
 	u64 total, enabled, running;
 
+	if (!event->pevent)
+		return 0;
+
 	total = perf_event_read_value(event->pevent, &enabled, &running);
 	if (total >= event->prev_count)
 		ev_count = total - event->prev_count;
@@ -97,35 +120,61 @@ static inline unsigned long read_event(struct event_data *event)
 
 static void read_perf_counters(int cpu, struct cpu_grp_info *cpu_grp)
 {
-	int cpu_idx;
+	int cpu_idx, i;
 	struct memlat_hwmon_data *hw_data = &per_cpu(pm_data, cpu);
-	struct memlat_hwmon *hw = &cpu_grp->hw;
-	unsigned long cyc_cnt;
+	unsigned long inst, mem, cyc, stall;
+	struct core_acc *acc;
 
 	if (hw_data->init_pending)
 		return;
 
 	cpu_idx = cpu - cpumask_first(&cpu_grp->cpus);
 
-	hw->core_stats[cpu_idx].inst_count =
-			read_event(&hw_data->events[INST_IDX]);
-
-	hw->core_stats[cpu_idx].mem_count =
-			read_event(&hw_data->events[L2DM_IDX]);
-
-	cyc_cnt = read_event(&hw_data->events[CYC_IDX]);
-	hw->core_stats[cpu_idx].freq = compute_freq(hw_data, cyc_cnt);
+	inst = read_event(&hw_data->events[INST_IDX]);
+	mem = read_event(&hw_data->events[L2DM_IDX]);
+	cyc = read_event(&hw_data->events[CYC_IDX]);
+	stall = read_event(&hw_data->events[STALL_IDX]);
+
+	for (i = 0; i < cpu_grp->num_targets; i++) {
+		acc = &cpu_grp->targets[i].acc[cpu_idx];
+		acc->inst += inst;
+		acc->mem += mem;
+		acc->cyc += cyc;
+		acc->stall += stall;
+	}
 }
 
 static unsigned long get_cnt(struct memlat_hwmon *hw)
 {
-	int cpu;
-	struct cpu_grp_info *cpu_grp = container_of(hw,
-					struct cpu_grp_info, hw);
+	int cpu, i;
+	struct memlat_target *t = container_of(hw, struct memlat_target, hw);
+	struct cpu_grp_info *cpu_grp = t->grp;
+	struct core_acc *acc;
+	unsigned int diff;
+	ktime_t ts;
 
+	mutex_lock(&cpu_grp->lock);
 	for_each_cpu(cpu, &cpu_grp->cpus)
 		read_perf_counters(cpu, cpu_grp);
 
+	ts = ktime_get();
+	diff = ktime_to_us(ktime_sub(ts, t->prev_ts));
+	if (!diff)
+		diff = 1;
+	t->prev_ts = ts;
+
+	for (i = 0; i < hw->num_cores; i++) {
+		acc = &t->acc[i];
+		hw->core_stats[i].inst_count = acc->inst;
+		hw->core_stats[i].mem_count = acc->mem;
+		hw->core_stats[i].freq = compute_freq(acc->cyc, diff);
+		hw->core_stats[i].stall_pct = acc->cyc ?
+			min_t(u64, div64_u64((u64)acc->stall * 100, acc->cyc),
+			      100) : 0;
+		memset(acc, 0, sizeof(*acc));
+	}
+	mutex_unlock(&cpu_grp->lock);
+
 	return 0;
 }
 
@@ -135,7 +184,9 @@ static void delete_events(struct memlat_hwmon_data *hw_data)
 
 	for (i = 0; i < NUM_EVENTS; i++) {
 		hw_data->events[i].prev_count = 0;
-		perf_event_release_kernel(hw_data->events[i].pevent);
+		if (hw_data->events[i].pevent)
+			perf_event_release_kernel(hw_data->events[i].pevent);
+		hw_data->events[i].pevent = NULL;
 	}
 }
 
@@ -143,8 +194,22 @@ static void stop_hwmon(struct memlat_hwmon *hw)
 {
 	int cpu, idx;
 	struct memlat_hwmon_data *hw_data;
-	struct cpu_grp_info *cpu_grp = container_of(hw,
-					struct cpu_grp_info, hw);
+	struct memlat_target *t = container_of(hw, struct memlat_target, hw);
+	struct cpu_grp_info *cpu_grp = t->grp;
+
+	mutex_lock(&cpu_grp->lock);
+	/* Clear governor data */
+	for (idx = 0; idx < hw->num_cores; idx++) {
+		hw->core_stats[idx].inst_count = 0;
+		hw->core_stats[idx].mem_count = 0;
+		hw->core_stats[idx].freq = 0;
+		hw->core_stats[idx].stall_pct = 0;
+	}
+
+	if (--cpu_grp->started) {
+		mutex_unlock(&cpu_grp->lock);
+		return;
+	}
 
 	get_online_cpus();
 	for_each_cpu(cpu, &cpu_grp->cpus) {
@@ -153,14 +218,9 @@ static void stop_hwmon(struct memlat_hwmon *hw)
 			hw_data->init_pending = false;
 		else
 			delete_events(hw_data);
-
-		/* Clear governor data */
-		idx = cpu - cpumask_first(&cpu_grp->cpus);
-		hw->core_stats[idx].inst_count = 0;
-		hw->core_stats[idx].mem_count = 0;
-		hw->core_stats[idx].freq = 0;
 	}
 	put_online_cpus();
+	mutex_unlock(&cpu_grp->lock);
 
 	unregister_cpu_notifier(&cpu_grp->arm_memlat_cpu_notif);
 }
@@ -213,6 +273,14 @@ static int set_events(struct memlat_hwmon_data *hw_data, int cpu)
 	hw_data->events[CYC_IDX].pevent = pevent;
 	perf_event_enable(hw_data->events[CYC_IDX].pevent);
 
+	/* Not all cores count backend stalls, the governor copes without */
+	attr->config = STALL_EV;
+	pevent = perf_event_create_kernel_counter(attr, cpu, NULL, NULL, NULL);
+	if (!IS_ERR(pevent)) {
+		hw_data->events[STALL_IDX].pevent = pevent;
+		perf_event_enable(hw_data->events[STALL_IDX].pevent);
+	}
+
 	kfree(attr);
 	return 0;
 
@@ -243,8 +311,16 @@ static int start_hwmon(struct memlat_hwmon *hw)
 {
 	int cpu, ret = 0;
 	struct memlat_hwmon_data *hw_data;
-	struct cpu_grp_info *cpu_grp = container_of(hw,
-					struct cpu_grp_info, hw);
+	struct memlat_target *t = container_of(hw, struct memlat_target, hw);
+	struct cpu_grp_info *cpu_grp = t->grp;
+
+	mutex_lock(&cpu_grp->lock);
+	memset(t->acc, 0, hw->num_cores * sizeof(*t->acc));
+	t->prev_ts = ktime_get();
+	if (cpu_grp->started++) {
+		mutex_unlock(&cpu_grp->lock);
+		return 0;
+	}
 
 	register_cpu_notifier(&cpu_grp->arm_memlat_cpu_notif);
 
@@ -265,6 +341,9 @@ static int start_hwmon(struct memlat_hwmon *hw)
 	}
 
 	put_online_cpus();
+	if (ret)
+		cpu_grp->started--;
+	mutex_unlock(&cpu_grp->lock);
 	return ret;
 }
 
@@ -298,44 +377,83 @@ static int arm_memlat_mon_driver_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
 	struct memlat_hwmon *hw;
+	struct memlat_target *t;
 	struct cpu_grp_info *cpu_grp;
-	int cpu, ret;
+	int cpu, ret, i, num_targets, num_cores;
 
 	cpu_grp = devm_kzalloc(dev, sizeof(*cpu_grp), GFP_KERNEL);
 	if (!cpu_grp)
 		return -ENOMEM;
 	cpu_grp->arm_memlat_cpu_notif.notifier_call = arm_memlat_cpu_callback;
-	hw = &cpu_grp->hw;
+	mutex_init(&cpu_grp->lock);
 
-	hw->dev = dev;
-	hw->of_node = of_parse_phandle(dev->of_node, "qcom,target-dev", 0);
-	if (!hw->of_node) {
+	num_targets = of_count_phandle_with_args(dev->of_node,
+						 "qcom,target-dev", NULL);
+	if (num_targets <= 0) {
 		dev_err(dev, "Couldn't find a target device\n");
 		return -ENODEV;
 	}
+	if (num_targets > MAX_TARGETS) {
+		dev_warn(dev, "Only the first %d target devices are used\n",
+			 MAX_TARGETS);
+		num_targets = MAX_TARGETS;
+	}
 
 	if (get_mask_from_dev_handle(pdev, &cpu_grp->cpus)) {
 		dev_err(dev, "CPU list is empty\n");
 		return -ENODEV;
 	}
+	num_cores = cpumask_weight(&cpu_grp->cpus);
+
+	for (i = 0; i < num_targets; i++) {
+		t = &cpu_grp->targets[i];
+		t->grp = cpu_grp;
+		hw = &t->hw;
+
+		hw->dev = dev;
+		hw->of_node = of_parse_phandle(dev->of_node,
+					       "qcom,target-dev", i);
+		if (!hw->of_node) {
+			dev_err(dev, "Couldn't find target device %d\n", i);
+			return -ENODEV;
+		}
 
-	hw->num_cores = cpumask_weight(&cpu_grp->cpus);
-	hw->core_stats = devm_kzalloc(dev, hw->num_cores *
-				sizeof(*(hw->core_stats)), GFP_KERNEL);
-	if (!hw->core_stats)
-		return -ENOMEM;
-
-	for_each_cpu(cpu, &cpu_grp->cpus)
-		hw->core_stats[cpu - cpumask_first(&cpu_grp->cpus)].id = cpu;
+		/*
+		 * The first target keeps the legacy table name, the others
+		 * use qcom,core-dev-table-<index>.
+		 */
+		if (i) {
+			hw->freq_map_prop = devm_kasprintf(dev, GFP_KERNEL,
+						"qcom,core-dev-table-%d", i);
+			if (!hw->freq_map_prop)
+				return -ENOMEM;
+		}
 
-	hw->start_hwmon = &start_hwmon;
-	hw->stop_hwmon = &stop_hwmon;
-	hw->get_cnt = &get_cnt;
+		hw->num_cores = num_cores;
+		hw->core_stats = devm_kzalloc(dev, hw->num_cores *
+					sizeof(*(hw->core_stats)), GFP_KERNEL);
+		t->acc = devm_kzalloc(dev, hw->num_cores * sizeof(*t->acc),
+				      GFP_KERNEL);
+		if (!hw->core_stats || !t->acc)
+			return -ENOMEM;
+
+		for_each_cpu(cpu, &cpu_grp->cpus)
+			hw->core_stats[cpu - cpumask_first(&cpu_grp->cpus)].id =
+									cpu;
+
+		hw->start_hwmon = &start_hwmon;
+		hw->stop_hwmon = &stop_hwmon;
+		hw->get_cnt = &get_cnt;
+	}
 
-	ret = register_memlat(dev, hw);
-	if (ret) {
-		pr_err("Mem Latency Gov registration failed\n");
-		return ret;
+	/* All accumulators must exist before any governor can sample */
+	cpu_grp->num_targets = num_targets;
+	for (i = 0; i < num_targets; i++) {
+		ret = register_memlat(dev, &cpu_grp->targets[i].hw);
+		if (ret) {
+			pr_err("Mem Latency Gov registration failed\n");
+			return ret;
+		}
 	}
 
 	return 0;
@@ -34,6 +34,9 @@
 #include "governor_bw_hwmon.h"
 
 #define NUM_MBPS_ZONES		10
+/* Measured bandwidth histogram: <256 MBps, doubling, last is the rest */
+#define NUM_BW_BUCKETS		8
+#define BW_BUCKET_SHIFT		8
 struct hwmon_node {
 	unsigned int guard_band_mbps;
 	unsigned int decay_rate;
@@ -51,6 +54,7 @@ struct hwmon_node {
 	unsigned int low_power_ceil_mbps;
 	unsigned int low_power_io_percent;
 	unsigned int low_power_delay;
+	unsigned int fast_ramp;
 	unsigned int mbps_zones[NUM_MBPS_ZONES];
 
 	unsigned long prev_ab;
@@ -69,7 +73,11 @@ struct hwmon_node {
 	unsigned long prev_req;
 	unsigned int wake;
 	unsigned int down_cnt;
+	u64 bw_hist[NUM_BW_BUCKETS];
+	u64 up_wakes;
+	u64 down_wakes;
 	ktime_t prev_ts;
+	ktime_t prev_vote_ts;
 	ktime_t hist_max_ts;
 	bool sampled;
 	bool mon_started;
@@ -308,6 +316,43 @@ unsigned long to_mbps_zone(struct hwmon_node *node, unsigned long mbps)
 	return node->hw->df->max_freq;
 }
 
+static void account_bw_hist(struct hwmon_node *node, unsigned long mbps)
+{
+	int i = min_t(int, fls_long(mbps >> BW_BUCKET_SHIFT),
+		      NUM_BW_BUCKETS - 1);
+
+	node->bw_hist[i]++;
+	if (node->wake == UP_WAKE)
+		node->up_wakes++;
+	else if (node->wake == DOWN_WAKE)
+		node->down_wakes++;
+}
+
+/*
+ * Decay from prev_ab towards adj_mbps by decay_rate once per elapsed
+ * polling interval instead of once per evaluation. With fast_ramp the
+ * threshold IRQs re-vote at any time, and counting those evaluations
+ * would make the ramp down faster the burstier the traffic is.
+ */
+static unsigned int decay_bw(struct hwmon_node *node, unsigned long adj_mbps,
+			     unsigned int polling_ms)
+{
+	unsigned long new_bw = node->prev_ab;
+	unsigned int ms, n;
+	ktime_t now = ktime_get();
+
+	ms = ktime_to_ms(ktime_sub(now, node->prev_vote_ts));
+	if (!polling_ms || ms < polling_ms)
+		return new_bw;
+	node->prev_vote_ts = now;
+
+	for (n = min(ms / polling_ms, 10U); n && new_bw > adj_mbps; n--)
+		new_bw = (adj_mbps * node->decay_rate
+			  + new_bw * (100 - node->decay_rate)) / 100;
+
+	return new_bw;
+}
+
 #define MIN_MBPS	500UL
 #define HIST_PEAK_TOL	60
 static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
@@ -333,6 +378,7 @@ static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 
 	req_mbps = meas_mbps = node->max_mbps;
 	node->max_mbps = 0;
+	account_bw_hist(node, meas_mbps);
 
 	hist_lo_tol = (node->hist_max_mbps * HIST_PEAK_TOL) / 100;
 	/* Remember historic peak in the past hist_mem decision windows. */
@@ -395,6 +441,14 @@ static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 			req_mbps = node->hist_max_mbps;
 
 		req_mbps = min(req_mbps, meas_mbps_zone);
+
+		/*
+		 * In fast ramp mode a threshold IRQ jumps straight to the
+		 * top of the zone the surge falls in instead of growing the
+		 * vote over several windows.
+		 */
+		if (node->fast_ramp)
+			req_mbps = max(req_mbps, meas_mbps_zone);
 	}
 
 	hyst_lo_tol = (node->hyst_mbps * HIST_PEAK_TOL) / 100;
@@ -474,6 +528,10 @@ static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 
 	if (adj_mbps > node->prev_ab) {
 		new_bw = adj_mbps;
+		node->prev_vote_ts = ktime_get();
+	} else if (node->fast_ramp) {
+		new_bw = decay_bw(node, adj_mbps,
+				  node->hw->df->profile->polling_ms);
 	} else {
 		new_bw = adj_mbps * node->decay_rate
 			+ node->prev_ab * (100 - node->decay_rate);
@@ -554,6 +612,8 @@ static int start_monitor(struct devfreq *df, bool init)
 
 	node->prev_ts = ktime_get();
 
+	node->prev_vote_ts = node->prev_ts;
+
 	if (init) {
 		node->prev_ab = 0;
 		node->resume_freq = 0;
@@ -773,6 +833,56 @@ static ssize_t show_throttle_adj(struct device *dev,
 static DEVICE_ATTR(throttle_adj, 0644, show_throttle_adj,
 						store_throttle_adj);
 
+static ssize_t show_bw_hist(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+	struct hwmon_node *node = df->data;
+	u64 hist[NUM_BW_BUCKETS], up, down;
+	unsigned long flags;
+	unsigned int i, cnt = 0;
+
+	spin_lock_irqsave(&irq_lock, flags);
+	memcpy(hist, node->bw_hist, sizeof(hist));
+	up = node->up_wakes;
+	down = node->down_wakes;
+	spin_unlock_irqrestore(&irq_lock, flags);
+
+	for (i = 0; i < NUM_BW_BUCKETS; i++) {
+		if (i < NUM_BW_BUCKETS - 1)
+			cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
+					"<%u: %llu\n",
+					1U << (BW_BUCKET_SHIFT + i), hist[i]);
+		else
+			cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
+					">=%u: %llu\n",
+					1U << (BW_BUCKET_SHIFT + i - 1),
+					hist[i]);
+	}
+	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
+			"up_wakes: %llu\ndown_wakes: %llu\n", up, down);
+
+	return cnt;
+}
+
+static ssize_t store_bw_hist(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	struct hwmon_node *node = df->data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&irq_lock, flags);
+	memset(node->bw_hist, 0, sizeof(node->bw_hist));
+	node->up_wakes = 0;
+	node->down_wakes = 0;
+	spin_unlock_irqrestore(&irq_lock, flags);
+
+	return count;
+}
+
+static DEVICE_ATTR(bw_hist, 0644, show_bw_hist, store_bw_hist);
+
 gov_attr(guard_band_mbps, 0U, 2000U);
 gov_attr(decay_rate, 0U, 100U);
 gov_attr(io_percent, 1U, 100U);
@@ -789,6 +899,7 @@ gov_attr(idle_mbps, 0U, 2000U);
 gov_attr(low_power_ceil_mbps, 0U, 2500U);
 gov_attr(low_power_io_percent, 1U, 100U);
 gov_attr(low_power_delay, 1U, 60U);
+gov_attr(fast_ramp, 0U, 1U);
 gov_list_attr(mbps_zones, NUM_MBPS_ZONES, 0U, UINT_MAX);
 
 static struct attribute *dev_attr[] = {
@@ -808,8 +919,10 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_low_power_ceil_mbps.attr,
 	&dev_attr_low_power_io_percent.attr,
 	&dev_attr_low_power_delay.attr,
+	&dev_attr_fast_ramp.attr,
 	&dev_attr_mbps_zones.attr,
 	&dev_attr_throttle_adj.attr,
+	&dev_attr_bw_hist.attr,
 	NULL,
 };
 
@@ -944,6 +1057,7 @@ int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon)
 	node->low_power_ceil_mbps = 0;
 	node->low_power_io_percent = 16;
 	node->low_power_delay = 60;
+	node->fast_ramp = 0;
 	node->bw_step = 190;
 	node->sample_ms = 50;
 	node->up_scale = 0;
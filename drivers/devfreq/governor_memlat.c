@@ -35,6 +35,15 @@
 
 struct memlat_node {
 	unsigned int ratio_ceil;
+	unsigned int stall_floor;
+	unsigned int hyst_samples;
+	unsigned int ramp_pct;
+	unsigned int hyst_left;
+	unsigned long prev_core_freq;
+	unsigned long prev_vote;
+	u64 over_ms;
+	u64 under_ms;
+	u64 exact_ms;
 	bool mon_started;
 	struct list_head list;
 	void *orig_data;
@@ -104,6 +113,19 @@ static ssize_t show_map(struct device *dev, struct device_attribute *attr,
 
 static DEVICE_ATTR(freq_map, 0444, show_map, NULL);
 
+static ssize_t show_vote_stats(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+	struct memlat_node *n = df->data;
+
+	return snprintf(buf, PAGE_SIZE, "over_ms: %llu\nunder_ms: %llu\n"
+			"exact_ms: %llu\n", n->over_ms, n->under_ms,
+			n->exact_ms);
+}
+
+static DEVICE_ATTR(vote_stats, 0444, show_vote_stats, NULL);
+
 static unsigned long core_to_dev_freq(struct memlat_node *node,
 		unsigned long coref)
 {
@@ -157,6 +179,9 @@ static int start_monitor(struct devfreq *df)
 
 	devfreq_monitor_start(df);
 
+	node->hyst_left = 0;
+	node->prev_core_freq = 0;
+	node->prev_vote = 0;
 	node->mon_started = true;
 
 	return 0;
@@ -228,8 +253,9 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 	int i, lat_dev;
 	struct memlat_node *node = df->data;
 	struct memlat_hwmon *hw = node->hw;
-	unsigned long max_freq = 0;
+	unsigned long max_freq = 0, need, core_freq;
 	unsigned int ratio;
+	bool stalled;
 
 	hw->get_cnt(hw);
 
@@ -249,13 +275,41 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 		    || !hw->core_stats[i].freq)
 			continue;
 
-		if (ratio <= node->ratio_ceil
+		/*
+		 * A core stalled on memory for a good part of its cycles is
+		 * latency bound even when its miss ratio alone looks fine,
+		 * e.g. when the misses are few but far away.
+		 */
+		stalled = node->stall_floor &&
+			  hw->core_stats[i].stall_pct >= node->stall_floor;
+
+		if ((ratio <= node->ratio_ceil || stalled)
 		    && hw->core_stats[i].freq > max_freq) {
 			lat_dev = i;
 			max_freq = hw->core_stats[i].freq;
 		}
 	}
 
+	/* What the last window needed, against what was voted for it */
+	need = max_freq ? core_to_dev_freq(node, max_freq) : 0;
+	if (node->prev_vote > need)
+		node->over_ms += df->profile->polling_ms;
+	else if (node->prev_vote < need)
+		node->under_ms += df->profile->polling_ms;
+	else
+		node->exact_ms += df->profile->polling_ms;
+
+	/*
+	 * Ramp ahead of a rising memory bound core by extrapolating its
+	 * frequency into the next window, so the vote does not trail a
+	 * ramping workload by a sample.
+	 */
+	core_freq = max_freq;
+	if (max_freq && node->ramp_pct && max_freq > node->prev_core_freq)
+		max_freq += (max_freq - node->prev_core_freq) *
+			    node->ramp_pct / 100;
+	node->prev_core_freq = core_freq;
+
 	if (max_freq) {
 		max_freq = core_to_dev_freq(node, max_freq);
 		trace_memlat_dev_update(dev_name(df->dev.parent),
@@ -266,15 +320,31 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 					max_freq);
 	}
 
+	/* Hold a higher vote for hyst_samples windows before dropping it */
+	if (max_freq >= node->prev_vote)
+		node->hyst_left = node->hyst_samples;
+	else if (node->hyst_left) {
+		node->hyst_left--;
+		max_freq = node->prev_vote;
+	}
+	node->prev_vote = max_freq;
+
 	*freq = max_freq;
 	return 0;
 }
 
 gov_attr(ratio_ceil, 1U, 10000U);
+gov_attr(stall_floor, 0U, 100U);
+gov_attr(hyst_samples, 0U, 100U);
+gov_attr(ramp_pct, 0U, 200U);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_ratio_ceil.attr,
+	&dev_attr_stall_floor.attr,
+	&dev_attr_hyst_samples.attr,
+	&dev_attr_ramp_pct.attr,
 	&dev_attr_freq_map.attr,
+	&dev_attr_vote_stats.attr,
 	NULL,
 };
 
@@ -389,7 +459,9 @@ int register_memlat(struct device *dev, struct memlat_hwmon *hw)
 	node->ratio_ceil = 10;
 	node->hw = hw;
 
-	hw->freq_map = init_core_dev_map(dev, "qcom,core-dev-table");
+	hw->freq_map = init_core_dev_map(dev, hw->freq_map_prop ?
+					 (char *)hw->freq_map_prop :
+					 "qcom,core-dev-table");
 	if (!hw->freq_map) {
 		dev_err(dev, "Couldn't find the core-dev freq table!\n");
 		return -EINVAL;
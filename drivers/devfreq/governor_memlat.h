@@ -23,12 +23,16 @@
  * @mem_count:			Number of memory accesses made.
  * @freq:			Effective frequency of the device in the
  *				last interval.
+ * @stall_pct:			Percentage of the cycles in the last interval
+ *				the core was stalled in the backend, 0 if the
+ *				stall counter is not available.
  */
 struct dev_stats {
 	int id;
 	unsigned long inst_count;
 	unsigned long mem_count;
 	unsigned long freq;
+	unsigned int stall_pct;
 };
 
 struct core_dev_map {
@@ -53,6 +57,8 @@ struct core_dev_map {
  *				hardware monitor.
  * @core_stats:			Array containing instruction count, memory
  *				accesses and effective frequency for each core.
+ * @freq_map_prop:		DT property holding the core to device
+ *				frequency map, "qcom,core-dev-table" if NULL.
  *
  * One of dev or of_node needs to be specified for a successful registration.
  *
@@ -69,6 +75,7 @@ struct memlat_hwmon {
 
 	struct devfreq *df;
 	struct core_dev_map *freq_map;
+	const char *freq_map_prop;
 };
 
 #ifdef CONFIG_DEVFREQ_GOV_MEMLAT
@@ -21,6 +21,20 @@
 #include "msm_gem.h"
 #include "sde_trace.h"
 
+/* number of not yet programmed commits a single commit can replace */
+#define MSM_COMMIT_MAX_LATCH	4
+
+static bool commit_latch = true;
+module_param(commit_latch, bool, 0600);
+MODULE_PARM_DESC(commit_latch,
+	"Let a flip replace a queued flip that has not reached the hardware");
+
+enum msm_commit_stage {
+	MSM_COMMIT_QUEUED,
+	MSM_COMMIT_RUNNING,
+	MSM_COMMIT_LATCHED,
+};
+
 struct msm_commit {
 	struct drm_device *dev;
 	struct drm_atomic_state *state;
@@ -29,17 +43,90 @@ struct msm_commit {
 	uint32_t crtc_mask;
 	uint32_t plane_mask;
 	struct kthread_work commit_work;
+
+	/* display thread of the single crtc of this commit, if any */
+	struct msm_drm_commit *thread;
+	enum msm_commit_stage stage;
+	bool modeset;
+	uint32_t target_vblank;
+	ktime_t queued;
+
+	/*
+	 * Queued commits this one replaced. Their states are cleaned up
+	 * once this commit has been presented. holds_event is set when the
+	 * old crtc states of a state carry a flip event that was never
+	 * given to the hardware.
+	 */
+	bool holds_event;
+	int nr_replaced;
+	struct {
+		struct drm_atomic_state *state;
+		bool holds_event;
+	} replaced[MSM_COMMIT_MAX_LATCH];
 };
 
+/*
+ * Late-latch: if the commit owning our crtc is a flip that is still waiting
+ * for its fences, take its place instead of waiting for it to be shown.
+ * Only plane updates without a modeset are replaced, and only when the new
+ * commit touches every plane of the old one, so that programming the new
+ * state leaves the hardware exactly where the sequence of both would.
+ * Called with pending_crtcs_event.lock held.
+ */
+static bool try_latch(struct msm_drm_private *priv, struct msm_commit *commit)
+{
+	struct msm_commit *prev;
+	int nr;
+
+	if (!commit_latch || !commit->thread || commit->modeset)
+		return false;
+
+	prev = commit->thread->pending;
+	if (!prev || prev->stage != MSM_COMMIT_QUEUED || prev->modeset ||
+			prev->crtc_mask != commit->crtc_mask ||
+			(prev->plane_mask & ~commit->plane_mask) ||
+			(priv->pending_planes & commit->plane_mask &
+			 ~prev->plane_mask))
+		return false;
+
+	nr = prev->nr_replaced;
+	if (nr >= MSM_COMMIT_MAX_LATCH)
+		return false;
+
+	memcpy(commit->replaced, prev->replaced, nr * sizeof(prev->replaced[0]));
+	commit->replaced[nr].state = prev->state;
+	commit->replaced[nr].holds_event = prev->holds_event;
+	commit->nr_replaced = nr + 1;
+	/* prev's new crtc states become our old ones on swap */
+	commit->holds_event = true;
+
+	prev->stage = MSM_COMMIT_LATCHED;
+	prev->state = NULL;
+
+	priv->pending_planes |= commit->plane_mask;
+	commit->thread->pending = commit;
+	commit->thread->latched++;
+
+	return true;
+}
+
 /* block until specified crtcs are no longer pending update, and
  * atomically mark them as pending update
  */
-static int start_atomic(struct msm_drm_private *priv, uint32_t crtc_mask,
-			uint32_t plane_mask)
+static int start_atomic(struct msm_drm_private *priv,
+			struct msm_commit *commit)
 {
+	uint32_t crtc_mask = commit->crtc_mask;
+	uint32_t plane_mask = commit->plane_mask;
 	int ret;
 
 	spin_lock(&priv->pending_crtcs_event.lock);
+	if (try_latch(priv, commit)) {
+		DBG("latch: %08x", crtc_mask);
+		spin_unlock(&priv->pending_crtcs_event.lock);
+		return 0;
+	}
+
 	ret = wait_event_interruptible_locked(priv->pending_crtcs_event,
 			!(priv->pending_crtcs & crtc_mask) &&
 			!(priv->pending_planes & plane_mask));
@@ -47,6 +134,8 @@ static int start_atomic(struct msm_drm_private *priv, uint32_t crtc_mask,
 		DBG("start: %08x", crtc_mask);
 		priv->pending_crtcs |= crtc_mask;
 		priv->pending_planes |= plane_mask;
+		if (commit->thread)
+			commit->thread->pending = commit;
 	}
 	spin_unlock(&priv->pending_crtcs_event.lock);
 
@@ -55,24 +144,114 @@ static int start_atomic(struct msm_drm_private *priv, uint32_t crtc_mask,
 
 /* clear specified crtcs (no longer pending update)
  */
-static void end_atomic(struct msm_drm_private *priv, uint32_t crtc_mask,
-			uint32_t plane_mask)
+static void end_atomic(struct msm_drm_private *priv,
+			struct msm_commit *commit)
 {
 	spin_lock(&priv->pending_crtcs_event.lock);
-	DBG("end: %08x", crtc_mask);
-	priv->pending_crtcs &= ~crtc_mask;
-	priv->pending_planes &= ~plane_mask;
+	/* a replaced commit hands its crtcs over to the one replacing it */
+	if (commit->stage == MSM_COMMIT_LATCHED) {
+		spin_unlock(&priv->pending_crtcs_event.lock);
+		return;
+	}
+	DBG("end: %08x", commit->crtc_mask);
+	priv->pending_crtcs &= ~commit->crtc_mask;
+	priv->pending_planes &= ~commit->plane_mask;
+	if (commit->thread && commit->thread->pending == commit)
+		commit->thread->pending = NULL;
 	wake_up_all_locked(&priv->pending_crtcs_event);
 	spin_unlock(&priv->pending_crtcs_event.lock);
 }
 
 static void commit_destroy(struct msm_commit *commit)
 {
-	end_atomic(commit->dev->dev_private, commit->crtc_mask,
-			commit->plane_mask);
+	end_atomic(commit->dev->dev_private, commit);
 	kfree(commit);
 }
 
+/* send the flip events left in the old crtc states of @state */
+static void commit_send_events(struct drm_device *dev,
+		struct drm_atomic_state *state)
+{
+	struct drm_crtc *crtc;
+	struct drm_crtc_state *crtc_state;
+	unsigned long flags;
+	int i;
+
+	for_each_crtc_in_state(state, crtc, crtc_state, i) {
+		if (!crtc_state->event)
+			continue;
+
+		spin_lock_irqsave(&dev->event_lock, flags);
+		drm_crtc_send_vblank_event(crtc, crtc_state->event);
+		crtc_state->event = NULL;
+		spin_unlock_irqrestore(&dev->event_lock, flags);
+	}
+}
+
+/*
+ * The commit is on screen: complete the events of the flips it replaced,
+ * with the present time of this one, and account how it was paced.
+ */
+static void commit_present(struct msm_commit *commit)
+{
+	struct drm_device *dev = commit->dev;
+	struct msm_drm_private *priv = dev->dev_private;
+	struct msm_drm_commit *thread = commit->thread;
+	struct drm_crtc *crtc;
+	uint32_t vblank = 0;
+	u32 present_us;
+	int i;
+
+	if (commit->holds_event)
+		commit_send_events(dev, commit->state);
+	for (i = 0; i < commit->nr_replaced; i++)
+		if (commit->replaced[i].holds_event)
+			commit_send_events(dev, commit->replaced[i].state);
+
+	if (!thread)
+		return;
+
+	for (i = 0; i < priv->num_crtcs; i++) {
+		crtc = priv->crtcs[i];
+		if (crtc && crtc->base.id == thread->crtc_id) {
+			vblank = drm_crtc_vblank_count(crtc);
+			break;
+		}
+	}
+
+	present_us = ktime_us_delta(ktime_get(), commit->queued);
+
+	spin_lock(&priv->pending_crtcs_event.lock);
+	thread->commits++;
+	if ((int)(vblank - commit->target_vblank) > 0)
+		thread->late++;
+	thread->present_us_sum += present_us;
+	thread->present_us_max = max(thread->present_us_max, present_us);
+	spin_unlock(&priv->pending_crtcs_event.lock);
+}
+
+int msm_atomic_commit_show(struct drm_device *dev, struct seq_file *m)
+{
+	struct msm_drm_private *priv = dev->dev_private;
+	struct msm_drm_commit *thread;
+	u64 avg;
+	int i;
+
+	seq_puts(m, "crtc commits latched late present_avg_us present_max_us\n");
+	spin_lock(&priv->pending_crtcs_event.lock);
+	for (i = 0; i < priv->num_crtcs; i++) {
+		thread = &priv->disp_thread[i];
+		avg = thread->commits ?
+			div64_u64(thread->present_us_sum, thread->commits) : 0;
+		seq_printf(m, "%u %llu %llu %llu %llu %u\n", thread->crtc_id,
+			   thread->commits, thread->latched, thread->late, avg,
+			   thread->present_us_max);
+	}
+	spin_unlock(&priv->pending_crtcs_event.lock);
+
+	return 0;
+}
+
 static void msm_atomic_wait_for_commit_done(
 		struct drm_device *dev,
 		struct drm_atomic_state *old_state,
@@ -411,10 +590,23 @@ static void msm_atomic_helper_commit_modeset_enables(struct drm_device *dev,
  */
 static void complete_commit(struct msm_commit *commit)
 {
-	struct drm_atomic_state *state = commit->state;
-	struct drm_device *dev = state->dev;
+	struct drm_device *dev = commit->dev;
 	struct msm_drm_private *priv = dev->dev_private;
 	struct msm_kms *kms = priv->kms;
+	struct drm_atomic_state *state;
+	int i;
+
+	/* a later flip took over, its state is programmed in our place */
+	spin_lock(&priv->pending_crtcs_event.lock);
+	if (commit->stage == MSM_COMMIT_LATCHED) {
+		spin_unlock(&priv->pending_crtcs_event.lock);
+		kfree(commit);
+		return;
+	}
+	commit->stage = MSM_COMMIT_RUNNING;
+	spin_unlock(&priv->pending_crtcs_event.lock);
+
+	state = commit->state;
 
 	kms->funcs->prepare_commit(kms, state);
 
@@ -439,8 +631,15 @@ static void complete_commit(struct msm_commit *commit)
 
 	msm_atomic_wait_for_commit_done(dev, state, 0);
 
+	commit_present(commit);
+
 	drm_atomic_helper_cleanup_planes(dev, state);
 
+	for (i = 0; i < commit->nr_replaced; i++) {
+		drm_atomic_helper_cleanup_planes(dev, commit->replaced[i].state);
+		drm_atomic_state_free(commit->replaced[i].state);
+	}
+
 	kms->funcs->complete_commit(kms, state);
 
 	drm_atomic_state_free(state);
@@ -455,8 +654,27 @@ static void fence_cb(struct msm_fence_cb *cb)
 {
 	struct msm_commit *commit =
 			container_of(cb, struct msm_commit, fence_cb);
+	struct msm_drm_private *priv = commit->dev->dev_private;
 	int ret = -EINVAL;
 
+	spin_lock(&priv->pending_crtcs_event.lock);
+	if (commit->stage == MSM_COMMIT_LATCHED) {
+		spin_unlock(&priv->pending_crtcs_event.lock);
+		kfree(commit);
+		return;
+	}
+	spin_unlock(&priv->pending_crtcs_event.lock);
+
+	/*
+	 * The state can be taken over from here on, so don't walk it when
+	 * the display thread is already known.
+	 */
+	if (commit->thread && commit->thread->thread) {
+		queue_kthread_work(&commit->thread->worker,
+				&commit->commit_work);
+		return;
+	}
+
 	ret = msm_atomic_commit_dispatch(commit->dev, commit->state, commit);
 	if (ret) {
 		DRM_ERROR("%s: atomic commit failed\n", __func__);
@@ -572,7 +790,8 @@ int msm_atomic_commit(struct drm_device *dev,
 	int ncrtcs = dev->mode_config.num_crtc;
 	ktime_t timeout;
 	struct msm_commit *commit;
-	int i, ret;
+	struct drm_crtc *single_crtc = NULL;
+	int i, j, ret;
 
 	if (!priv || priv->shutdown_in_progress) {
 		DRM_ERROR("priv is null or shutdwon is in-progress\n");
@@ -601,7 +820,20 @@ int msm_atomic_commit(struct drm_device *dev,
 		if (!crtc)
 			continue;
 		commit->crtc_mask |= (1 << i);
+		if (drm_atomic_crtc_needs_modeset(state->crtc_states[i]))
+			commit->modeset = true;
+		single_crtc = crtc;
+	}
+
+	/* only single crtc commits are queued on a display thread */
+	if (hweight32(commit->crtc_mask) == 1) {
+		for (j = 0; j < priv->num_crtcs; j++)
+			if (priv->disp_thread[j].crtc_id ==
+					single_crtc->base.id)
+				commit->thread = &priv->disp_thread[j];
+		commit->target_vblank = drm_crtc_vblank_count(single_crtc) + 1;
 	}
+	commit->queued = ktime_get();
 
 	/*
 	 * Figure out what fence to wait for:
@@ -623,8 +855,7 @@ int msm_atomic_commit(struct drm_device *dev,
 	 * Wait for pending updates on any of the same crtc's and then
 	 * mark our set of crtc's as busy:
 	 */
-	ret = start_atomic(dev->dev_private, commit->crtc_mask,
-			commit->plane_mask);
+	ret = start_atomic(dev->dev_private, commit);
 	if (ret) {
 		DRM_ERROR("start_atomic failed: %d\n", ret);
 		commit_destroy(commit);
@@ -287,6 +287,8 @@ static int msm_unload(struct drm_device *dev)
 		}
 	}
 
+	msm_gem_shrinker_cleanup(dev);
+
 	drm_kms_helper_poll_fini(dev);
 	drm_mode_config_cleanup(dev);
 	drm_vblank_cleanup(dev);
@@ -473,6 +475,7 @@ static int msm_load(struct drm_device *dev, unsigned long flags)
 	}
 
 	dev->dev_private = priv;
+	priv->dev = dev;
 
 	priv->wq = alloc_ordered_workqueue("msm_drm", 0);
 	init_waitqueue_head(&priv->fence_event);
@@ -487,6 +490,8 @@ static int msm_load(struct drm_device *dev, unsigned long flags)
 	hash_init(priv->mn_hash);
 	mutex_init(&priv->mn_lock);
 
+	msm_gem_shrinker_init(dev);
+
 	drm_mode_config_init(dev);
 
 	platform_set_drvdata(pdev, dev);
@@ -710,6 +715,7 @@ static int msm_open(struct drm_device *dev, struct drm_file *file)
 		return PTR_ERR(ctx);
 
 	if (ctx) {
+		ctx->dev = dev;
 		INIT_LIST_HEAD(&ctx->counters);
 		msm_submitqueue_init(ctx);
 	}
@@ -954,6 +960,16 @@ static int msm_gpu_show(struct drm_device *dev, struct seq_file *m)
 	return 0;
 }
 
+static int msm_gpu_latency_show(struct drm_device *dev, struct seq_file *m)
+{
+	struct msm_drm_private *priv = dev->dev_private;
+
+	if (priv->gpu)
+		msm_gpu_submit_stats_show(priv->gpu, m);
+
+	return 0;
+}
+
 static int msm_snapshot_show(struct drm_device *dev, struct seq_file *m)
 {
 	struct msm_drm_private *priv = dev->dev_private;
@@ -1037,10 +1053,12 @@ static int show_unlocked(struct seq_file *m, void *arg)
 
 static struct drm_info_list msm_debugfs_list[] = {
 		{"gpu", show_locked, 0, msm_gpu_show},
+		{"gpu_latency", show_locked, 0, msm_gpu_latency_show},
 		{"gem", show_locked, 0, msm_gem_show},
 		{ "mm", show_locked, 0, msm_mm_show },
 		{ "fb", show_locked, 0, msm_fb_show },
 		{ "snapshot", show_unlocked, 0, msm_snapshot_show },
+		{ "commits", show_unlocked, 0, msm_atomic_commit_show },
 };
 
 static int late_init_minor(struct drm_minor *minor)
@@ -1714,6 +1732,44 @@ static int msm_ioctl_gem_sync(struct drm_device *dev, void *data,
 	return 0;
 }
 
+static int msm_ioctl_gem_madvise(struct drm_device *dev, void *data,
+		struct drm_file *file)
+{
+	struct drm_msm_gem_madvise *args = data;
+	struct drm_gem_object *obj;
+	int ret;
+
+	switch (args->madv) {
+	case MSM_MADV_DONTNEED:
+	case MSM_MADV_WILLNEED:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ret = mutex_lock_interruptible(&dev->struct_mutex);
+	if (ret)
+		return ret;
+
+	obj = drm_gem_object_lookup(dev, file, args->handle);
+	if (!obj) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+
+	ret = msm_gem_madvise(obj, args->madv);
+	if (ret >= 0) {
+		args->retained = ret;
+		ret = 0;
+	}
+
+	drm_gem_object_unreference(obj);
+
+unlock:
+	mutex_unlock(&dev->struct_mutex);
+	return ret;
+}
+
 void msm_send_crtc_notification(struct drm_crtc *crtc,
 				struct drm_event *event, u8 *payload)
 {
@@ -1925,6 +1981,7 @@ static const struct drm_ioctl_desc msm_ioctls[] = {
 	DRM_IOCTL_DEF_DRV(MSM_GEM_CPU_FINI, msm_ioctl_gem_cpu_fini, DRM_AUTH|DRM_RENDER_ALLOW),
 	DRM_IOCTL_DEF_DRV(MSM_GEM_SUBMIT,   msm_ioctl_gem_submit,   DRM_AUTH|DRM_RENDER_ALLOW),
 	DRM_IOCTL_DEF_DRV(MSM_WAIT_FENCE,   msm_ioctl_wait_fence,   DRM_AUTH|DRM_RENDER_ALLOW),
+	DRM_IOCTL_DEF_DRV(MSM_GEM_MADVISE,  msm_ioctl_gem_madvise,  DRM_AUTH|DRM_RENDER_ALLOW),
 	DRM_IOCTL_DEF_DRV(SDE_WB_CONFIG, sde_wb_config, DRM_UNLOCKED|DRM_AUTH),
 	DRM_IOCTL_DEF_DRV(MSM_REGISTER_EVENT,  msm_ioctl_register_event,
 			  DRM_UNLOCKED|DRM_CONTROL_ALLOW),
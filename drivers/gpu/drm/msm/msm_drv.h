@@ -76,6 +76,7 @@ struct msm_gem_vma;
 #define MAX_CONNECTORS 8
 
 struct msm_file_private {
+	struct drm_device *dev;
 	struct msm_gem_address_space *aspace;
 	struct list_head counters;
 	rwlock_t queuelock;
@@ -264,17 +265,29 @@ struct msm_drm_event {
 };
 
 /* Commit thread specific structure */
+struct msm_commit;
+
 struct msm_drm_commit {
 	struct drm_device *dev;
 	struct task_struct *thread;
 	unsigned int crtc_id;
 	struct kthread_worker worker;
+
+	/* commit owning the crtc and its statistics, pending_crtcs_event.lock */
+	struct msm_commit *pending;
+	u64 commits;
+	u64 latched;
+	u64 late;
+	u64 present_us_sum;
+	u32 present_us_max;
 };
 
 #define MSM_GPU_MAX_RINGS 4
 
 struct msm_drm_private {
 
+	struct drm_device *dev;
+
 	struct msm_kms *kms;
 
 	struct sde_power_handle phandle;
@@ -312,6 +325,9 @@ struct msm_drm_private {
 	/* list of GEM objects: */
 	struct list_head inactive_list;
 
+	/* reclaims the pages of idle bo's userspace marked as DONTNEED: */
+	struct shrinker shrinker;
+
 	struct workqueue_struct *wq;
 
 	/* callbacks deferred until bo is inactive: */
@@ -437,6 +453,7 @@ static inline bool msm_is_suspend_state(struct drm_device *dev)
 
 int msm_atomic_commit(struct drm_device *dev,
 		struct drm_atomic_state *state, bool async);
+int msm_atomic_commit_show(struct drm_device *dev, struct seq_file *m);
 
 int msm_wait_fence(struct drm_device *dev, uint32_t fence,
 		ktime_t *timeout, bool interruptible);
@@ -502,6 +519,10 @@ struct drm_gem_object *msm_gem_prime_import_sg_table(struct drm_device *dev,
 int msm_gem_prime_pin(struct drm_gem_object *obj);
 void msm_gem_prime_unpin(struct drm_gem_object *obj);
 void *msm_gem_vaddr(struct drm_gem_object *obj);
+int msm_gem_madvise(struct drm_gem_object *obj, unsigned madv);
+void msm_gem_purge(struct drm_gem_object *obj);
+void msm_gem_shrinker_init(struct drm_device *dev);
+void msm_gem_shrinker_cleanup(struct drm_device *dev);
 int msm_gem_queue_inactive_cb(struct drm_gem_object *obj,
 		struct msm_fence_cb *cb);
 void msm_gem_move_to_active(struct drm_gem_object *obj,
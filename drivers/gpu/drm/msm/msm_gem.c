@@ -220,6 +220,10 @@ static struct page **get_pages(struct drm_gem_object *obj)
 {
 	struct msm_gem_object *msm_obj = to_msm_bo(obj);
 
+	/* Backing pages are only allocated, on first use, for WILLNEED bo's */
+	if (msm_obj->madv != MSM_MADV_WILLNEED)
+		return ERR_PTR(-EBUSY);
+
 	if (!msm_obj->pages) {
 		struct drm_device *dev = obj->dev;
 		struct page **p;
@@ -398,6 +402,12 @@ int msm_gem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (ret)
 		goto out;
 
+	/* a purged (or purgeable) bo must not be touched any more */
+	if (msm_obj->madv != MSM_MADV_WILLNEED) {
+		ret = -EFAULT;
+		goto out_unlock;
+	}
+
 	/* make sure we have pages attached now */
 	pages = get_pages(obj);
 	if (IS_ERR(pages)) {
@@ -676,6 +686,69 @@ void *msm_gem_vaddr(struct drm_gem_object *obj)
 	return msm_obj->vaddr;
 }
 
+/* Update madvise status, returns true if not purged, else false. */
+int msm_gem_madvise(struct drm_gem_object *obj, unsigned madv)
+{
+	struct msm_gem_object *msm_obj = to_msm_bo(obj);
+
+	WARN_ON(!mutex_is_locked(&obj->dev->struct_mutex));
+
+	mutex_lock(&msm_obj->lock);
+
+	/* Once purged, the backing pages are gone for good */
+	if (msm_obj->madv != __MSM_MADV_PURGED)
+		msm_obj->madv = madv;
+
+	madv = msm_obj->madv;
+
+	mutex_unlock(&msm_obj->lock);
+
+	return (madv != __MSM_MADV_PURGED);
+}
+
+/*
+ * Drop the backing pages of a purgeable object: tear down the iommu
+ * mappings and the kernel and userspace CPU mappings, then give the pages
+ * back to shmem.  The object keeps its handle and size but any later
+ * attempt to use it fails with -EBUSY.
+ */
+void msm_gem_purge(struct drm_gem_object *obj)
+{
+	struct drm_device *dev = obj->dev;
+	struct msm_gem_object *msm_obj = to_msm_bo(obj);
+
+	WARN_ON(!mutex_is_locked(&dev->struct_mutex));
+	WARN_ON(!is_purgeable(msm_obj));
+
+	mutex_lock(&msm_obj->lock);
+
+	put_iova(obj);
+
+	if (msm_obj->vaddr) {
+		vunmap(msm_obj->vaddr);
+		msm_obj->vaddr = NULL;
+	}
+
+	put_pages(obj);
+
+	msm_obj->madv = __MSM_MADV_PURGED;
+
+	drm_vma_node_unmap(&obj->vma_node, dev->anon_inode->i_mapping);
+	drm_gem_free_mmap_offset(obj);
+
+	/* Our goal here is to return as much of the memory as
+	 * is possible back to the system as we are called from OOM.
+	 * To do this we must instruct the shmfs to drop all of its
+	 * backing pages, *now*.
+	 */
+	shmem_truncate_range(file_inode(obj->filp), 0, (loff_t)-1);
+
+	invalidate_mapping_pages(file_inode(obj->filp)->i_mapping,
+			0, (loff_t)-1);
+
+	mutex_unlock(&msm_obj->lock);
+}
+
 /* setup callback for when bo is no longer busy..
  * TODO probably want to differentiate read vs write..
  */
@@ -750,6 +823,10 @@ void msm_gem_sync(struct drm_gem_object *obj, u32 op)
 	if (msm_obj->flags & (MSM_BO_WC|MSM_BO_UNCACHED))
 		return;
 
+	/* nothing to sync before first use or once purged */
+	if (!msm_obj->sgt)
+		return;
+
 	switch (op) {
 	case MSM_GEM_SYNC_TO_CPU:
 		dma_sync_sg_for_cpu(dev->dev, msm_obj->sgt->sgl,
@@ -771,11 +848,27 @@ void msm_gem_describe(struct drm_gem_object *obj, struct seq_file *m)
 	uint64_t off = drm_vma_node_start(&obj->vma_node);
 
 	WARN_ON(!mutex_is_locked(&dev->struct_mutex));
-	seq_printf(m, "%08x: %c(r=%u,w=%u) %2d (%2d) %08llx %pK\t",
+	const char *madv;
+
+	switch (msm_obj->madv) {
+	case __MSM_MADV_PURGED:
+		madv = " purged";
+		break;
+	case MSM_MADV_DONTNEED:
+		madv = " purgeable";
+		break;
+	case MSM_MADV_WILLNEED:
+	default:
+		madv = "";
+		break;
+	}
+
+	WARN_ON(!mutex_is_locked(&dev->struct_mutex));
+	seq_printf(m, "%08x: %c(r=%u,w=%u) %2d (%2d) %08llx %pK%s\t",
 			msm_obj->flags, is_active(msm_obj) ? 'A' : 'I',
 			msm_obj->read_fence, msm_obj->write_fence,
 			obj->name, obj->refcount.refcount.counter,
-			off, msm_obj->vaddr);
+			off, msm_obj->vaddr, madv);
 
 	/* FIXME: we need to print the address space here too */
 	list_for_each_entry(domain, &msm_obj->domains, list)
@@ -51,6 +51,11 @@ struct msm_gem_object {
 
 	uint32_t flags;
 
+	/**
+	 * Advice: are the backing pages purgeable?
+	 */
+	uint8_t madv;
+
 	/* And object is either:
 	 *  inactive - on priv->inactive_list
 	 *  active   - on one one of the gpu's active_list..  well, at
@@ -119,6 +124,20 @@ static inline bool is_active(struct msm_gem_object *msm_obj)
 	return msm_obj->gpu != NULL;
 }
 
+/*
+ * Only idle, driver owned shmem backed objects that userspace marked as
+ * DONTNEED can have their pages dropped.  Secure and SVM objects are never
+ * purged, their pages are not ours to discard.
+ */
+static inline bool is_purgeable(struct msm_gem_object *msm_obj)
+{
+	return (msm_obj->madv == MSM_MADV_DONTNEED) && msm_obj->sgt &&
+			!is_active(msm_obj) && !msm_obj->vram_node &&
+			!msm_obj->base.dma_buf && !msm_obj->base.import_attach &&
+			!(msm_obj->flags & (MSM_BO_SVM | MSM_BO_SECURE)) &&
+			list_empty(&msm_obj->submit_entry);
+}
+
 static inline uint32_t msm_gem_fence(struct msm_gem_object *msm_obj,
 		uint32_t op)
 {
@@ -154,6 +173,8 @@ struct msm_gem_submit {
 	bool secure;
 	struct msm_gpu_submitqueue *queue;
 	int tick_index;
+	ktime_t submit_time;
+	unsigned int depth;
 	unsigned int nr_cmds;
 	unsigned int nr_bos;
 	struct {
@@ -169,4 +190,21 @@ struct msm_gem_submit {
 	} bos[0];
 };
 
+/*
+ * Buffer table kept by a submitqueue between MSM_SUBMIT_BO_CACHE submits.
+ * Each object is referenced and pinned in its address space, so the iova
+ * stays valid until the cache is released.
+ */
+struct msm_gem_submit_bo_cache {
+	unsigned int nr_bos;
+	bool secure;
+	struct {
+		uint32_t handle;
+		uint32_t flags;
+		struct msm_gem_object *obj;
+		struct msm_gem_address_space *aspace;
+		uint64_t iova;
+	} bos[0];
+};
+
 #endif /* __MSM_GEM_H__ */
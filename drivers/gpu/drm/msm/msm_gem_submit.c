@@ -28,6 +28,7 @@
 #define BO_VALID    0x8000
 #define BO_LOCKED   0x4000
 #define BO_PINNED   0x2000
+#define BO_CACHED   0x1000
 
 static struct msm_gem_submit *submit_create(struct drm_device *dev,
 		struct msm_gem_address_space *aspace,
@@ -162,6 +163,13 @@ static int submit_lookup_objects(struct msm_gpu *gpu,
 			goto out_unlock;
 		}
 
+		if (msm_obj->madv != MSM_MADV_WILLNEED) {
+			DRM_ERROR("invalid madv state for handle %u at index %u\n",
+					submit_bo.handle, i);
+			ret = -EINVAL;
+			goto out_unlock;
+		}
+
 		drm_gem_object_reference(obj);
 
 		submit->bos[i].obj = msm_obj;
@@ -188,7 +196,9 @@ static void submit_unlock_unpin_bo(struct msm_gpu *gpu,
 	aspace = (msm_obj->flags & MSM_BO_SECURE) ?
 			gpu->secure_aspace : submit->aspace;
 
-	if (submit->bos[i].flags & BO_PINNED)
+	/* the pin of a cached buffer is owned by the submitqueue */
+	if ((submit->bos[i].flags & BO_PINNED) &&
+			!(submit->bos[i].flags & BO_CACHED))
 		msm_gem_put_iova(&msm_obj->base, aspace);
 
 	if (submit->bos[i].flags & BO_LOCKED)
@@ -197,7 +207,136 @@ static void submit_unlock_unpin_bo(struct msm_gpu *gpu,
 	if (!(submit->bos[i].flags & BO_VALID))
 		submit->bos[i].iova = 0;
 
-	submit->bos[i].flags &= ~(BO_LOCKED | BO_PINNED);
+	submit->bos[i].flags &= ~(BO_LOCKED | BO_PINNED | BO_CACHED);
+}
+
+/* Drop the references and pins of a buffer cache, with struct_mutex held */
+static void submit_bo_cache_free(struct msm_gem_submit_bo_cache *cache)
+{
+	unsigned int i;
+
+	if (!cache)
+		return;
+
+	for (i = 0; i < cache->nr_bos; i++) {
+		msm_gem_put_iova(&cache->bos[i].obj->base,
+				cache->bos[i].aspace);
+		drm_gem_object_unreference(&cache->bos[i].obj->base);
+	}
+
+	kfree(cache);
+}
+
+void msm_gem_submit_release_bo_cache(struct drm_device *dev,
+		struct msm_gpu_submitqueue *queue)
+{
+	mutex_lock(&dev->struct_mutex);
+	queue->closed = true;
+	submit_bo_cache_free(queue->bo_cache);
+	queue->bo_cache = NULL;
+	mutex_unlock(&dev->struct_mutex);
+}
+
+/*
+ * Take the buffer table of this submit from the queue's cache. This is only
+ * done when userspace passes the same handles with the same flags as last
+ * time, and every handle still names the cached object. The cached iovas
+ * are used as is, a buffer is valid if its presumed address matches.
+ */
+static bool submit_lookup_cached(struct msm_gem_submit *submit,
+		struct msm_gpu_submitqueue *queue,
+		const struct drm_msm_gem_submit_bo *table, unsigned int nr_bos,
+		struct drm_file *file)
+{
+	struct msm_gem_submit_bo_cache *cache = queue->bo_cache;
+	unsigned int i;
+
+	if (!cache || cache->nr_bos != nr_bos)
+		return false;
+
+	for (i = 0; i < nr_bos; i++)
+		if (table[i].handle != cache->bos[i].handle ||
+				table[i].flags != cache->bos[i].flags)
+			return false;
+
+	spin_lock(&file->table_lock);
+
+	for (i = 0; i < nr_bos; i++) {
+		struct msm_gem_object *msm_obj = cache->bos[i].obj;
+
+		if (idr_find(&file->object_idr, table[i].handle) !=
+				&msm_obj->base ||
+				msm_obj->madv != MSM_MADV_WILLNEED ||
+				!list_empty(&msm_obj->submit_entry)) {
+			spin_unlock(&file->table_lock);
+			return false;
+		}
+	}
+
+	for (i = 0; i < nr_bos; i++) {
+		struct msm_gem_object *msm_obj = cache->bos[i].obj;
+
+		drm_gem_object_reference(&msm_obj->base);
+
+		submit->bos[i].obj = msm_obj;
+		submit->bos[i].iova = cache->bos[i].iova;
+		submit->bos[i].flags = table[i].flags | BO_PINNED | BO_CACHED;
+		if (table[i].presumed == cache->bos[i].iova)
+			submit->bos[i].flags |= BO_VALID;
+
+		list_add_tail(&msm_obj->submit_entry, &submit->bo_list);
+	}
+
+	spin_unlock(&file->table_lock);
+
+	submit->nr_bos = nr_bos;
+	submit->secure = cache->secure;
+
+	return true;
+}
+
+/* Replace the queue's buffer cache with the table of this submit */
+static void submit_update_bo_cache(struct msm_gpu *gpu,
+		struct msm_gem_submit *submit,
+		struct msm_gpu_submitqueue *queue,
+		const struct drm_msm_gem_submit_bo *table)
+{
+	struct msm_gem_submit_bo_cache *cache;
+	unsigned int i;
+
+	if (queue->closed)
+		return;
+
+	cache = kzalloc(sizeof(*cache) +
+		(u64)submit->nr_bos * sizeof(cache->bos[0]), GFP_KERNEL);
+	if (!cache)
+		return;
+
+	for (i = 0; i < submit->nr_bos; i++) {
+		struct msm_gem_object *msm_obj = submit->bos[i].obj;
+		struct msm_gem_address_space *aspace;
+
+		aspace = (msm_obj->flags & MSM_BO_SECURE) ?
+			gpu->secure_aspace : submit->aspace;
+
+		if (msm_gem_get_iova(&msm_obj->base, aspace,
+				&cache->bos[i].iova)) {
+			submit_bo_cache_free(cache);
+			return;
+		}
+
+		drm_gem_object_reference(&msm_obj->base);
+		cache->bos[i].handle = table[i].handle;
+		cache->bos[i].flags = table[i].flags;
+		cache->bos[i].obj = msm_obj;
+		cache->bos[i].aspace = aspace;
+		cache->nr_bos = i + 1;
+	}
+
+	cache->secure = submit->secure;
+
+	submit_bo_cache_free(queue->bo_cache);
+	queue->bo_cache = cache;
 }
 
 /* This is where we make sure all the bo's are reserved and pin'd: */
@@ -435,6 +574,10 @@ int msm_ioctl_gem_submit(struct drm_device *dev, void *data,
 	struct msm_gem_submit *submit;
 	struct msm_gpu_submitqueue *queue;
 	struct msm_gpu *gpu;
+	struct drm_msm_gem_submit_bo *table = NULL;
+	struct drm_msm_gem_submit_timings timings = { 0 };
+	bool cached = false, skip_relocs = false;
+	ktime_t start, phase;
 	unsigned i;
 	int ret;
 
@@ -461,14 +604,50 @@ int msm_ioctl_gem_submit(struct drm_device *dev, void *data,
 		goto out;
 	}
 
-	ret = submit_lookup_objects(gpu, submit, args, file);
-	if (ret)
-		goto out;
+	start = ktime_get();
+
+	if ((args->flags & MSM_SUBMIT_BO_CACHE) && args->nr_bos) {
+		table = kmalloc_array(args->nr_bos, sizeof(*table),
+			GFP_TEMPORARY | __GFP_NOWARN);
+		if (table && copy_from_user(table, u64_to_user_ptr(args->bos),
+				args->nr_bos * sizeof(*table))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		if (table)
+			cached = submit_lookup_cached(submit, queue, table,
+				args->nr_bos, file);
+	}
+
+	if (!cached) {
+		ret = submit_lookup_objects(gpu, submit, args, file);
+		if (ret)
+			goto out;
+	}
+
+	phase = ktime_get();
+	timings.lookup_ns = ktime_to_ns(ktime_sub(phase, start));
+	start = phase;
 
 	ret = submit_validate_objects(gpu, submit);
 	if (ret)
 		goto out;
 
+	phase = ktime_get();
+	timings.validate_ns = ktime_to_ns(ktime_sub(phase, start));
+	start = phase;
+
+	/*
+	 * With a cached table every buffer is already pinned, so if userspace
+	 * presumed all of the addresses correctly there is nothing to patch.
+	 */
+	if (cached) {
+		skip_relocs = true;
+		for (i = 0; i < submit->nr_bos; i++)
+			if (!(submit->bos[i].flags & BO_VALID))
+				skip_relocs = false;
+	}
+
 	for (i = 0; i < args->nr_cmds; i++) {
 		struct drm_msm_gem_submit_cmd submit_cmd;
 		void __user *userptr =
@@ -529,6 +708,9 @@ int msm_ioctl_gem_submit(struct drm_device *dev, void *data,
 				+ submit_cmd.submit_offset;
 		}
 
+		if (skip_relocs && !(msm_obj->flags & MSM_BO_SECURE))
+			continue;
+
 		ret = submit_reloc(gpu, submit, msm_obj,
 				submit_cmd.submit_offset, submit_cmd.nr_relocs,
 				submit_cmd.relocs);
@@ -541,14 +723,33 @@ int msm_ioctl_gem_submit(struct drm_device *dev, void *data,
 	/* Clamp the user submitted ring to the range of available rings */
 	submit->ring = clamp_t(uint32_t, queue->prio, 0, gpu->nr_rings - 1);
 
+	phase = ktime_get();
+	timings.cmds_ns = ktime_to_ns(ktime_sub(phase, start));
+	start = phase;
+
 	ret = msm_gpu_submit(gpu, submit);
 
 	args->fence = submit->fence;
 
+	timings.submit_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	timings.cached = cached;
+	timings.relocs_skipped = skip_relocs;
+
+	if (!ret && table && !cached)
+		submit_update_bo_cache(gpu, submit, queue, table);
+
 out:
 	submit_cleanup(gpu, submit, !!ret);
 	if (ret)
 		msm_gem_submit_free(submit);
 	mutex_unlock(&dev->struct_mutex);
+	kfree(table);
+
+	/* the submit has been queued, a bad timings pointer doesn't fail it */
+	if (!ret && args->timings &&
+			copy_to_user(u64_to_user_ptr(args->timings), &timings,
+				sizeof(timings)))
+		DRM_DEBUG("unable to copy submit timings\n");
+
 	return ret;
 }
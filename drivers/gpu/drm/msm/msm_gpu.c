@@ -431,6 +431,52 @@ out:
  * Cmdstream submission/retirement:
  */
 
+/* The CP always on counter the start and retire ticks come from is 19.2MHz */
+static inline u64 ticks_to_us(u64 ticks)
+{
+	return div_u64(ticks * 10, 192);
+}
+
+static inline int submit_lat_bucket(u32 us)
+{
+	return min(fls(us), MSM_SUBMIT_LAT_BUCKETS - 1);
+}
+
+static void submit_stats_add(struct msm_submit_stats *stats,
+		unsigned int depth, u32 queue_us, u32 exec_us)
+{
+	stats->count++;
+	stats->queue_hist[submit_lat_bucket(queue_us)]++;
+	stats->exec_hist[submit_lat_bucket(exec_us)]++;
+	stats->depth_hist[min(fls(depth), MSM_SUBMIT_DEPTH_BUCKETS - 1)]++;
+	stats->queue_us_max = max(stats->queue_us_max, queue_us);
+	stats->exec_us_max = max(stats->exec_us_max, exec_us);
+}
+
+/*
+ * The GPU stamps the start and the end of each submit. The CPU side submit
+ * time is not in the same timebase, so the time spent waiting for the GPU
+ * is the wall time to retire less the execution time.
+ */
+static void submit_account(struct msm_ringbuffer *ring,
+		struct msm_gem_submit *submit, struct msm_memptr_ticks *ticks)
+{
+	u64 total_us = ktime_us_delta(ktime_get(), submit->submit_time);
+	u64 exec_us = 0;
+	u32 queue_us;
+
+	if (ticks->retired > ticks->started)
+		exec_us = min(ticks_to_us(ticks->retired - ticks->started),
+			total_us);
+	queue_us = min_t(u64, total_us - exec_us, U32_MAX);
+
+	submit_stats_add(&ring->stats, submit->depth, queue_us, exec_us);
+	submit_stats_add(&submit->queue->stats, submit->depth, queue_us,
+		exec_us);
+
+	trace_msm_submit_latency(submit, queue_us, exec_us);
+}
+
 static void retire_submits(struct msm_gpu *gpu, struct msm_ringbuffer *ring,
 		uint32_t fence)
 {
@@ -451,6 +497,7 @@ static void retire_submits(struct msm_gpu *gpu, struct msm_ringbuffer *ring,
 		rmb();
 
 		trace_msm_retired(submit, ticks->started, ticks->retired);
+		submit_account(ring, submit, ticks);
 
 		pm_runtime_mark_last_busy(&gpu->pdev->dev);
 		pm_runtime_put_autosuspend(&gpu->pdev->dev);
@@ -514,12 +561,18 @@ int msm_gpu_submit(struct msm_gpu *gpu, struct msm_gem_submit *submit)
 {
 	struct drm_device *dev = gpu->dev;
 	struct msm_ringbuffer *ring = gpu->rb[submit->ring];
+	struct list_head *pos;
 	int i;
 
 	WARN_ON(!mutex_is_locked(&dev->struct_mutex));
 
 	submit->fence = FENCE(submit->ring, ++ring->seqno);
 
+	submit->submit_time = ktime_get();
+	submit->depth = 0;
+	list_for_each(pos, &ring->submits)
+		submit->depth++;
+
 	pm_runtime_get_sync(&gpu->pdev->dev);
 
 	msm_gpu_hw_init(gpu);
@@ -573,6 +626,80 @@ int msm_gpu_submit(struct msm_gpu *gpu, struct msm_gem_submit *submit)
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/* upper bound, in microseconds, of the bucket holding percentile pct */
+static u32 submit_percentile(const u32 *hist, u64 count, int pct, u32 max)
+{
+	u64 want = div_u64(count * pct + 99, 100);
+	u64 seen = 0;
+	int i;
+
+	for (i = 0; i < MSM_SUBMIT_LAT_BUCKETS - 1; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return min_t(u32, 1U << i, max);
+	}
+	return max;
+}
+
+static void submit_stats_show_one(struct seq_file *m, const char *name,
+		int id, int prio, const struct msm_submit_stats *stats)
+{
+	int i;
+
+	if (!stats->count)
+		return;
+
+	seq_printf(m, "%-6s %3d %4d %10llu %8u %8u %8u %8u %8u %8u ",
+		name, id, prio, stats->count,
+		submit_percentile(stats->queue_hist, stats->count, 50,
+			stats->queue_us_max),
+		submit_percentile(stats->queue_hist, stats->count, 99,
+			stats->queue_us_max),
+		stats->queue_us_max,
+		submit_percentile(stats->exec_hist, stats->count, 50,
+			stats->exec_us_max),
+		submit_percentile(stats->exec_hist, stats->count, 99,
+			stats->exec_us_max),
+		stats->exec_us_max);
+	for (i = 0; i < MSM_SUBMIT_DEPTH_BUCKETS; i++)
+		seq_printf(m, " %u", stats->depth_hist[i]);
+	seq_puts(m, "\n");
+}
+
+/* Per ring and per submitqueue latency summary, called with struct_mutex */
+void msm_gpu_submit_stats_show(struct msm_gpu *gpu, struct seq_file *m)
+{
+	struct drm_device *dev = gpu->dev;
+	struct msm_ringbuffer *ring;
+	struct drm_file *file;
+	int i;
+
+	seq_puts(m, "# queue: submit to start, exec: start to retire, in us\n");
+	seq_puts(m, "#          id prio      count  q_p50    q_p99    q_max  e_p50    e_p99    e_max    depth 0 1 2-3 ...\n");
+
+	FOR_EACH_RING(gpu, ring, i) {
+		if (ring)
+			submit_stats_show_one(m, "ring", ring->id, ring->id,
+				&ring->stats);
+	}
+
+	list_for_each_entry(file, &dev->filelist, lhead) {
+		struct msm_file_private *ctx = file->driver_priv;
+		struct msm_gpu_submitqueue *queue;
+
+		if (!ctx)
+			continue;
+
+		read_lock(&ctx->queuelock);
+		list_for_each_entry(queue, &ctx->submitqueues, node)
+			submit_stats_show_one(m, "queue", queue->id,
+				queue->prio, &queue->stats);
+		read_unlock(&ctx->queuelock);
+	}
+}
+#endif
+
 struct msm_context_counter {
 	u32 groupid;
 	int counterid;
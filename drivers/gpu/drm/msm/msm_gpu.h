@@ -154,6 +154,11 @@ struct msm_gpu_submitqueue {
 	int faults;
 	struct list_head node;
 	struct kref ref;
+	/* buffer table of the last MSM_SUBMIT_BO_CACHE submit, struct_mutex */
+	struct msm_gem_submit_bo_cache *bo_cache;
+	bool closed;
+	/* updated on retire, under struct_mutex */
+	struct msm_submit_stats stats;
 };
 
 /* It turns out that all targets use the same ringbuffer size. */
@@ -285,6 +290,13 @@ void msm_gpu_cleanup_counters(struct msm_gpu *gpu,
 u64 msm_gpu_counter_read(struct msm_gpu *gpu,
 		struct drm_msm_counter_read *data);
 
+void msm_gem_submit_release_bo_cache(struct drm_device *dev,
+		struct msm_gpu_submitqueue *queue);
+
+#ifdef CONFIG_DEBUG_FS
+void msm_gpu_submit_stats_show(struct msm_gpu *gpu, struct seq_file *m);
+#endif
+
 static inline void msm_submitqueue_put(struct msm_gpu_submitqueue *queue)
 {
 	if (queue)
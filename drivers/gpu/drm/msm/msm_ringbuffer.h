@@ -41,6 +41,23 @@ struct msm_memptrs {
 	 ((index) * sizeof(struct msm_memptr_ticks)) + \
 	 offsetof(struct msm_memptr_ticks, field))
 
+/*
+ * Latency of the submits of a queue or ring, in log2 buckets of
+ * microseconds: queue is submit to start on the GPU, exec is start to
+ * retire. depth is the number of submits already on the ring.
+ */
+#define MSM_SUBMIT_LAT_BUCKETS 20
+#define MSM_SUBMIT_DEPTH_BUCKETS 8
+
+struct msm_submit_stats {
+	u64 count;
+	u32 queue_us_max;
+	u32 exec_us_max;
+	u32 queue_hist[MSM_SUBMIT_LAT_BUCKETS];
+	u32 exec_hist[MSM_SUBMIT_LAT_BUCKETS];
+	u32 depth_hist[MSM_SUBMIT_DEPTH_BUCKETS];
+};
+
 struct msm_ringbuffer {
 	struct msm_gpu *gpu;
 	int id;
@@ -56,6 +73,9 @@ struct msm_ringbuffer {
 	struct msm_memptrs *memptrs;
 	uint64_t memptrs_iova;
 	int tick_index;
+
+	/* all submits of this priority, under struct_mutex */
+	struct msm_submit_stats stats;
 };
 
 struct msm_ringbuffer *msm_ringbuffer_new(struct msm_gpu *gpu, int id,
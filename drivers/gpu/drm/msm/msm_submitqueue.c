@@ -12,6 +12,7 @@
  */
 
 #include <linux/kref.h>
+#include "msm_drv.h"
 #include "msm_gpu.h"
 
 void msm_submitqueue_destroy(struct kref *kref)
@@ -54,8 +55,10 @@ void msm_submitqueue_close(struct msm_file_private *ctx)
 	 * be any more user ioctls coming our way
 	 */
 
-	list_for_each_entry_safe(entry, tmp, &ctx->submitqueues, node)
+	list_for_each_entry_safe(entry, tmp, &ctx->submitqueues, node) {
+		msm_gem_submit_release_bo_cache(ctx->dev, entry);
 		msm_submitqueue_put(entry);
+	}
 }
 
 int msm_submitqueue_create(struct msm_file_private *ctx, u32 prio, u32 flags,
@@ -140,6 +143,7 @@ int msm_submitqueue_remove(struct msm_file_private *ctx, u32 id)
 			list_del(&entry->node);
 			write_unlock(&ctx->queuelock);
 
+			msm_gem_submit_release_bo_cache(ctx->dev, entry);
 			msm_submitqueue_put(entry);
 			return 0;
 		}
@@ -88,6 +88,31 @@ TRACE_EVENT(msm_retired,
 	)
 );
 
+TRACE_EVENT(msm_submit_latency,
+	TP_PROTO(struct msm_gem_submit *submit, u32 queue_us, u32 exec_us),
+	TP_ARGS(submit, queue_us, exec_us),
+	TP_STRUCT__entry(
+		__field(uint32_t, queue_id)
+		__field(uint32_t, fence_id)
+		__field(int, ring)
+		__field(uint32_t, depth)
+		__field(uint32_t, queue_us)
+		__field(uint32_t, exec_us)
+	),
+	TP_fast_assign(
+		__entry->queue_id = submit->queue->id;
+		__entry->fence_id = submit->fence;
+		__entry->ring = submit->ring;
+		__entry->depth = submit->depth;
+		__entry->queue_us = queue_us;
+		__entry->exec_us = exec_us;
+	),
+	TP_printk(
+		"queue=%u fence=%u ring=%d depth=%u queue_us=%u exec_us=%u",
+		__entry->queue_id, __entry->fence_id, __entry->ring,
+		__entry->depth, __entry->queue_us, __entry->exec_us
+	)
+);
 
 #endif
 
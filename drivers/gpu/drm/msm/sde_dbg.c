@@ -20,6 +20,7 @@
 #include <linux/dma-buf.h>
 #include <linux/slab.h>
 #include <linux/list_sort.h>
+#include <linux/vmalloc.h>
 
 #include "sde_dbg.h"
 #include "sde/sde_hw_catalog.h"
@@ -1684,6 +1685,63 @@ static const struct file_operations sde_evtlog_fops = {
 	.write = sde_evtlog_dump_write,
 };
 
+/**
+ * struct sde_evtlog_raw_buf - snapshot of the event log for binary dump
+ * @buf: array of struct sde_dbg_evtlog_raw
+ * @len: size of buf in bytes
+ */
+struct sde_evtlog_raw_buf {
+	void *buf;
+	size_t len;
+};
+
+/*
+ * sde_evtlog_raw_open - debugfs open handler for binary evtlog dump, the
+ *	whole log is snapshotted at open so the reader sees one consistent copy
+ * @inode: debugfs inode
+ * @file: file handle
+ */
+static int sde_evtlog_raw_open(struct inode *inode, struct file *file)
+{
+	struct sde_evtlog_raw_buf *raw;
+
+	raw = kzalloc(sizeof(*raw), GFP_KERNEL);
+	if (!raw)
+		return -ENOMEM;
+
+	raw->buf = sde_evtlog_dump_raw(sde_dbg_base.evtlog, &raw->len);
+	if (!raw->buf) {
+		kfree(raw);
+		return -ENOMEM;
+	}
+
+	file->private_data = raw;
+	return 0;
+}
+
+static ssize_t sde_evtlog_raw_read(struct file *file, char __user *buff,
+		size_t count, loff_t *ppos)
+{
+	struct sde_evtlog_raw_buf *raw = file->private_data;
+
+	return simple_read_from_buffer(buff, count, ppos, raw->buf, raw->len);
+}
+
+static int sde_evtlog_raw_release(struct inode *inode, struct file *file)
+{
+	struct sde_evtlog_raw_buf *raw = file->private_data;
+
+	vfree(raw->buf);
+	kfree(raw);
+	return 0;
+}
+
+static const struct file_operations sde_evtlog_raw_fops = {
+	.open = sde_evtlog_raw_open,
+	.read = sde_evtlog_raw_read,
+	.release = sde_evtlog_raw_release,
+};
+
 /**
  * sde_dbg_ctrl_read - debugfs read handler for debug ctrl read
  * @file: file handler
@@ -1806,8 +1864,6 @@ void sde_dbg_init_dbg_buses(u32 hwversion)
 int sde_dbg_init(struct dentry *debugfs_root, struct device *dev,
 		struct sde_dbg_power_ctrl *power_ctrl)
 {
-	int i;
-
 	mutex_init(&sde_dbg_base.mutex);
 	INIT_LIST_HEAD(&sde_dbg_base.reg_base_list);
 	sde_dbg_base.dev = dev;
@@ -1831,13 +1887,12 @@ int sde_dbg_init(struct dentry *debugfs_root, struct device *dev,
 	INIT_WORK(&sde_dbg_base.dump_work, _sde_dump_work);
 	sde_dbg_base.work_panic = false;
 
-	for (i = 0; i < SDE_EVTLOG_ENTRY; i++)
-		sde_dbg_base.evtlog->logs[i].counter = i;
-
 	debugfs_create_file("dbg_ctrl", 0600, sde_dbg_base.root, NULL,
 			&sde_dbg_ctrl_fops);
 	debugfs_create_file("dump", 0600, sde_dbg_base.root, NULL,
 						&sde_evtlog_fops);
+	debugfs_create_file("dump_raw", 0400, sde_dbg_base.root, NULL,
+						&sde_evtlog_raw_fops);
 	debugfs_create_u32("enable", 0600, sde_dbg_base.root,
 			&(sde_dbg_base.evtlog->enable));
 	debugfs_create_u32("panic", 0600, sde_dbg_base.root,
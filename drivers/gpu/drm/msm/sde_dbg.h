@@ -49,14 +49,16 @@ enum sde_dbg_dump_flag {
 #define SDE_EVTLOG_PRINT_ENTRY	256
 
 /*
- * evtlog keeps this number of entries in memory for debug purpose. This
- * number must be greater than print entry to prevent out of bound evtlog
- * entry array access.
+ * evtlog keeps this number of entries in memory for debug purpose, per cpu.
+ * Every cpu logs into its own ring so that writers never contend on a lock
+ * or a cache line, the rings are merged by timestamp when dumped. This
+ * number must be a power of 2.
  */
-#define SDE_EVTLOG_ENTRY	(SDE_EVTLOG_PRINT_ENTRY * 8)
+#define SDE_EVTLOG_ENTRY	(SDE_EVTLOG_PRINT_ENTRY * 2)
 #define SDE_EVTLOG_MAX_DATA 15
 #define SDE_EVTLOG_BUF_MAX 512
 #define SDE_EVTLOG_BUF_ALIGN 32
+#define SDE_EVTLOG_NAME_MAX 32
 
 struct sde_dbg_power_ctrl {
 	void *handle;
@@ -64,6 +66,12 @@ struct sde_dbg_power_ctrl {
 	int (*enable_fn)(void *handle, void *client, bool enable);
 };
 
+/**
+ * struct sde_dbg_evtlog_log - raw event log entry, formatted only on dump
+ * @counter:	sequence number of the entry in its cpu ring plus one, zero
+ *		while the entry is being written
+ * @time:	ktime in ns
+ */
 struct sde_dbg_evtlog_log {
 	u32 counter;
 	s64 time;
@@ -74,17 +82,49 @@ struct sde_dbg_evtlog_log {
 	int pid;
 };
 
-struct sde_dbg_evtlog {
+/**
+ * struct sde_dbg_evtlog_cpu - event log ring of one cpu
+ * @head:	sequence number of the next entry, only written by the owner
+ * @rd:		next entry to dump, reader side
+ * @end:	entry at which the current dump stops, reader side
+ */
+struct sde_dbg_evtlog_cpu {
 	struct sde_dbg_evtlog_log logs[SDE_EVTLOG_ENTRY];
-	u32 first;
-	u32 last;
-	u32 last_dump;
-	u32 curr;
-	u32 next;
+	u32 head;
+	u32 rd;
+	u32 end;
+} ____cacheline_aligned_in_smp;
+
+/**
+ * struct sde_dbg_evtlog - event log
+ * @cpu:	per cpu rings, indexed by cpu number
+ * @last_time:	time of the last entry dumped
+ * @spin_lock:	serializes dumps, never taken by writers
+ */
+struct sde_dbg_evtlog {
+	struct sde_dbg_evtlog_cpu *cpu;
+	s64 last_time;
 	u32 enable;
 	spinlock_t spin_lock;
 };
 
+/**
+ * struct sde_dbg_evtlog_raw - fixed size record of the binary evtlog dump
+ * @time:	ktime in ns
+ * @counter:	sequence number of the entry in its cpu ring
+ * @name:	nul terminated function name of the call site
+ */
+struct sde_dbg_evtlog_raw {
+	u64 time;
+	u32 counter;
+	u16 cpu;
+	u16 line;
+	s32 pid;
+	u32 data_cnt;
+	u32 data[SDE_EVTLOG_MAX_DATA];
+	char name[SDE_EVTLOG_NAME_MAX];
+};
+
 extern struct sde_dbg_evtlog *sde_dbg_base_evtlog;
 
 /**
@@ -188,6 +228,15 @@ ssize_t sde_evtlog_dump_to_buffer(struct sde_dbg_evtlog *evtlog,
 		char *evtlog_buf, ssize_t evtlog_buf_size,
 		bool update_last_entry);
 
+/**
+ * sde_evtlog_dump_raw - copy every entry of the event log out as an array of
+ *	struct sde_dbg_evtlog_raw, ordered by cpu and then by time
+ * @evtlog:	pointer to evtlog
+ * @len:	returns the number of bytes in the buffer
+ * Returns:	vmalloc'ed buffer the caller must vfree, or NULL
+ */
+void *sde_evtlog_dump_raw(struct sde_dbg_evtlog *evtlog, size_t *len);
+
 /**
  * sde_dbg_init_dbg_buses - initialize debug bus dumping support for the chipset
  * @hwversion:		Chipset revision
@@ -298,6 +347,12 @@ static inline ssize_t sde_evtlog_dump_to_buffer(struct sde_dbg_evtlog *evtlog,
 	return 0;
 }
 
+static inline void *sde_evtlog_dump_raw(struct sde_dbg_evtlog *evtlog,
+		size_t *len)
+{
+	return NULL;
+}
+
 void sde_dbg_init_dbg_buses(u32 hwversion)
 {
 }
@@ -19,6 +19,7 @@
 #include <linux/uaccess.h>
 #include <linux/dma-buf.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 
 #include "sde_dbg.h"
 #include "sde_trace.h"
@@ -38,7 +39,9 @@ void sde_evtlog_log(struct sde_dbg_evtlog *evtlog, const char *name, int line,
 	unsigned long flags;
 	int i, val = 0;
 	va_list args;
+	struct sde_dbg_evtlog_cpu *ring;
 	struct sde_dbg_evtlog_log *log;
+	u32 seq;
 
 	if (!evtlog)
 		return;
@@ -46,12 +49,22 @@ void sde_evtlog_log(struct sde_dbg_evtlog *evtlog, const char *name, int line,
 	if (!sde_evtlog_is_enabled(evtlog, flag))
 		return;
 
-	spin_lock_irqsave(&evtlog->spin_lock, flags);
-	log = &evtlog->logs[evtlog->curr];
-	log->time = ktime_to_us(ktime_get());
+	/*
+	 * Only this cpu writes to its ring, irqs off is all the exclusion
+	 * needed. The entry counter is cleared while the entry is updated so
+	 * that a concurrent dump can tell a torn entry from a complete one.
+	 */
+	local_irq_save(flags);
+	ring = &evtlog->cpu[smp_processor_id()];
+	seq = ring->head;
+	log = &ring->logs[seq & (SDE_EVTLOG_ENTRY - 1)];
+
+	WRITE_ONCE(log->counter, 0);
+	smp_wmb();
+
+	log->time = ktime_get_ns();
 	log->name = name;
 	log->line = line;
-	log->data_cnt = 0;
 	log->pid = current->pid;
 
 	va_start(args, flag);
@@ -65,56 +78,97 @@ void sde_evtlog_log(struct sde_dbg_evtlog *evtlog, const char *name, int line,
 	}
 	va_end(args);
 	log->data_cnt = i;
-	evtlog->curr = (evtlog->curr + 1) % SDE_EVTLOG_ENTRY;
-	evtlog->last++;
 
 	trace_sde_evtlog(name, line, i > 0 ? log->data[0] : 0,
 			i > 1 ? log->data[1] : 0);
 
-	spin_unlock_irqrestore(&evtlog->spin_lock, flags);
+	smp_wmb();
+	WRITE_ONCE(log->counter, seq + 1);
+	WRITE_ONCE(ring->head, seq + 1);
+	local_irq_restore(flags);
 }
 
-/* always dump the last entries which are not dumped yet */
-static bool _sde_evtlog_dump_calc_range(struct sde_dbg_evtlog *evtlog,
-	bool update_last_entry)
+/* copy out entry seq of a ring, fails if it is being or was overwritten */
+static bool _sde_evtlog_read(struct sde_dbg_evtlog_cpu *ring, u32 seq,
+		struct sde_dbg_evtlog_log *out)
 {
-	bool need_dump = true;
-	unsigned long flags;
+	struct sde_dbg_evtlog_log *log =
+		&ring->logs[seq & (SDE_EVTLOG_ENTRY - 1)];
 
-	if (!evtlog)
+	if (READ_ONCE(log->counter) != seq + 1)
 		return false;
+	smp_rmb();
 
-	spin_lock_irqsave(&evtlog->spin_lock, flags);
+	*out = *log;
 
-	evtlog->first = evtlog->next;
+	smp_rmb();
+	return READ_ONCE(log->counter) == seq + 1;
+}
 
-	if (update_last_entry)
-		evtlog->last_dump = evtlog->last;
+/*
+ * Find the ring holding the oldest entry not dumped yet and copy that entry
+ * out, the caller consumes it by advancing rd. Entries overwritten since the
+ * range was calculated are dropped on the way.
+ */
+static struct sde_dbg_evtlog_cpu *_sde_evtlog_next(
+		struct sde_dbg_evtlog *evtlog, struct sde_dbg_evtlog_log *out)
+{
+	struct sde_dbg_evtlog_cpu *ring, *oldest = NULL;
+	struct sde_dbg_evtlog_log log;
+	int cpu;
 
-	if (evtlog->last_dump == evtlog->first) {
-		need_dump = false;
-		goto dump_exit;
-	}
+	for_each_possible_cpu(cpu) {
+		ring = &evtlog->cpu[cpu];
+
+		while (ring->rd != ring->end &&
+				!_sde_evtlog_read(ring, ring->rd, &log))
+			ring->rd++;
+
+		if (ring->rd == ring->end)
+			continue;
 
-	if (evtlog->last_dump < evtlog->first) {
-		evtlog->first %= SDE_EVTLOG_ENTRY;
-		if (evtlog->last_dump < evtlog->first)
-			evtlog->last_dump += SDE_EVTLOG_ENTRY;
+		if (!oldest || log.time < out->time) {
+			oldest = ring;
+			*out = log;
+		}
 	}
 
-	if ((evtlog->last_dump - evtlog->first) > SDE_EVTLOG_PRINT_ENTRY) {
-		pr_info("evtlog skipping %d entries, last=%d\n",
-			evtlog->last_dump - evtlog->first -
-			SDE_EVTLOG_PRINT_ENTRY,
-			evtlog->last_dump - 1);
-		evtlog->first = evtlog->last_dump - SDE_EVTLOG_PRINT_ENTRY;
+	return oldest;
+}
+
+/* always dump the last entries which are not dumped yet */
+static bool _sde_evtlog_dump_calc_range(struct sde_dbg_evtlog *evtlog,
+	bool update_last_entry)
+{
+	struct sde_dbg_evtlog_cpu *ring;
+	struct sde_dbg_evtlog_log log;
+	u32 pending = 0, skip;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = &evtlog->cpu[cpu];
+
+		if (update_last_entry)
+			ring->end = READ_ONCE(ring->head);
+
+		/* older entries have been overwritten by now */
+		if (ring->end - ring->rd > SDE_EVTLOG_ENTRY)
+			ring->rd = ring->end - SDE_EVTLOG_ENTRY;
+
+		pending += ring->end - ring->rd;
 	}
-	evtlog->next = evtlog->first + 1;
 
-dump_exit:
-	spin_unlock_irqrestore(&evtlog->spin_lock, flags);
+	if (!pending)
+		return false;
 
-	return need_dump;
+	if (pending > SDE_EVTLOG_PRINT_ENTRY) {
+		skip = pending - SDE_EVTLOG_PRINT_ENTRY;
+		pr_info("evtlog skipping %d entries\n", skip);
+		while (skip-- && (ring = _sde_evtlog_next(evtlog, &log)))
+			ring->rd++;
+	}
+
+	return true;
 }
 
 ssize_t sde_evtlog_dump_to_buffer(struct sde_dbg_evtlog *evtlog,
@@ -123,25 +177,26 @@ ssize_t sde_evtlog_dump_to_buffer(struct sde_dbg_evtlog *evtlog,
 {
 	int i;
 	ssize_t off = 0;
-	struct sde_dbg_evtlog_log *log, *prev_log;
+	struct sde_dbg_evtlog_cpu *ring;
+	struct sde_dbg_evtlog_log log;
 	unsigned long flags;
 
 	if (!evtlog || !evtlog_buf)
 		return 0;
 
-	/* update markers, exit if nothing to print */
-	if (!_sde_evtlog_dump_calc_range(evtlog, update_last_entry))
-		return 0;
-
 	spin_lock_irqsave(&evtlog->spin_lock, flags);
 
-	log = &evtlog->logs[evtlog->first % SDE_EVTLOG_ENTRY];
+	/* update markers, exit if nothing to print */
+	if (!_sde_evtlog_dump_calc_range(evtlog, update_last_entry))
+		goto unlock;
 
-	prev_log = &evtlog->logs[(evtlog->first - 1) %
-		SDE_EVTLOG_ENTRY];
+	ring = _sde_evtlog_next(evtlog, &log);
+	if (!ring)
+		goto unlock;
+	ring->rd++;
 
 	off = snprintf((evtlog_buf + off), (evtlog_buf_size - off), "%s:%-4d",
-		log->name, log->line);
+		log.name, log.line);
 
 	if (off < SDE_EVTLOG_BUF_ALIGN) {
 		memset((evtlog_buf + off), 0x20, (SDE_EVTLOG_BUF_ALIGN - off));
@@ -149,15 +204,19 @@ ssize_t sde_evtlog_dump_to_buffer(struct sde_dbg_evtlog *evtlog,
 	}
 
 	off += snprintf((evtlog_buf + off), (evtlog_buf_size - off),
-		"=>[%-8d:%-11llu:%9llu][%-4d]:", evtlog->first,
-		log->time, (log->time - prev_log->time), log->pid);
+		"=>[%-8d:%-11lld:%9lld][%-4d][%d]:", log.counter - 1,
+		div_s64(log.time, NSEC_PER_USEC),
+		div_s64(log.time - evtlog->last_time, NSEC_PER_USEC),
+		log.pid, (int)(ring - evtlog->cpu));
+	evtlog->last_time = log.time;
 
-	for (i = 0; i < log->data_cnt; i++)
+	for (i = 0; i < log.data_cnt; i++)
 		off += snprintf((evtlog_buf + off), (evtlog_buf_size - off),
-			"%x ", log->data[i]);
+			"%x ", log.data[i]);
 
 	off += snprintf((evtlog_buf + off), (evtlog_buf_size - off), "\n");
 
+unlock:
 	spin_unlock_irqrestore(&evtlog->spin_lock, flags);
 
 	return off;
@@ -178,14 +237,65 @@ void sde_evtlog_dump_all(struct sde_dbg_evtlog *evtlog)
 	}
 }
 
+void *sde_evtlog_dump_raw(struct sde_dbg_evtlog *evtlog, size_t *len)
+{
+	struct sde_dbg_evtlog_cpu *ring;
+	struct sde_dbg_evtlog_raw *buf, *raw;
+	struct sde_dbg_evtlog_log log;
+	u32 seq, head;
+	int cpu;
+
+	if (!evtlog || !len)
+		return NULL;
+
+	buf = vmalloc(num_possible_cpus() * SDE_EVTLOG_ENTRY * sizeof(*buf));
+	if (!buf)
+		return NULL;
+
+	raw = buf;
+	for_each_possible_cpu(cpu) {
+		ring = &evtlog->cpu[cpu];
+		head = READ_ONCE(ring->head);
+		seq = head > SDE_EVTLOG_ENTRY ? head - SDE_EVTLOG_ENTRY : 0;
+
+		for (; seq != head; seq++) {
+			if (!_sde_evtlog_read(ring, seq, &log))
+				continue;
+
+			memset(raw, 0, sizeof(*raw));
+			raw->time = log.time;
+			raw->counter = log.counter - 1;
+			raw->cpu = cpu;
+			raw->line = log.line;
+			raw->pid = log.pid;
+			raw->data_cnt = log.data_cnt;
+			memcpy(raw->data, log.data, sizeof(raw->data));
+			strlcpy(raw->name, log.name, sizeof(raw->name));
+			raw++;
+		}
+	}
+
+	*len = (raw - buf) * sizeof(*buf);
+
+	return buf;
+}
+
 struct sde_dbg_evtlog *sde_evtlog_init(void)
 {
 	struct sde_dbg_evtlog *evtlog;
 
+	BUILD_BUG_ON_NOT_POWER_OF_2(SDE_EVTLOG_ENTRY);
+
 	evtlog = kzalloc(sizeof(*evtlog), GFP_KERNEL);
 	if (!evtlog)
 		return ERR_PTR(-ENOMEM);
 
+	evtlog->cpu = vzalloc(nr_cpu_ids * sizeof(*evtlog->cpu));
+	if (!evtlog->cpu) {
+		kfree(evtlog);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	spin_lock_init(&evtlog->spin_lock);
 	evtlog->enable = SDE_EVTLOG_DEFAULT_ENABLE;
 
@@ -194,5 +304,9 @@ struct sde_dbg_evtlog *sde_evtlog_init(void)
 
 void sde_evtlog_destroy(struct sde_dbg_evtlog *evtlog)
 {
+	if (!evtlog)
+		return;
+
+	vfree(evtlog->cpu);
 	kfree(evtlog);
 }
@@ -60,6 +60,13 @@ struct evdev_client {
 	bool revoked;
 	unsigned long *evmasks[EV_CNT];
 	unsigned int bufsize;
+	/*
+	 * Once mmap()ed, events go to ring_events and head/packet_head
+	 * count freely; the consumer's tail is ring->tail, tail is unused.
+	 */
+	struct input_event_ring *ring;
+	struct input_event *ring_events;
+	bool ring_dropping;
 	struct input_event buffer[];
 };
 
@@ -117,6 +124,10 @@ static void __evdev_flush_queue(struct evdev_client *client, unsigned int type)
 
 	BUG_ON(type == EV_SYN);
 
+	/* events already published in the ring cannot be taken back */
+	if (client->ring)
+		return;
+
 	head = client->tail;
 	client->packet_head = client->tail;
 
@@ -158,6 +169,11 @@ static void __evdev_queue_syn_dropped(struct evdev_client *client)
 	struct input_event ev;
 	ktime_t time;
 
+	if (client->ring) {
+		client->ring_dropping = true;
+		return;
+	}
+
 	time = client->clk_type == EV_CLK_REAL ?
 			ktime_get_real() :
 			client->clk_type == EV_CLK_MONO ?
@@ -217,7 +233,10 @@ static int evdev_set_clk_type(struct evdev_client *client, unsigned int clkid)
 		 */
 		spin_lock_irqsave(&client->buffer_lock, flags);
 
-		if (client->head != client->tail) {
+		if (client->ring) {
+			client->head = client->packet_head;
+			__evdev_queue_syn_dropped(client);
+		} else if (client->head != client->tail) {
 			client->packet_head = client->head = client->tail;
 			__evdev_queue_syn_dropped(client);
 		}
@@ -255,6 +274,46 @@ static void __pass_event(struct evdev_client *client,
 	}
 }
 
+/*
+ * The kernel only writes the head of an mmap()ed ring and userspace only
+ * the tail, so instead of overwriting unread events, a full ring drops
+ * the packet being queued.
+ */
+static void __pass_event_ring(struct evdev_client *client,
+			      const struct input_event *event)
+{
+	struct input_event_ring *ring = client->ring;
+	unsigned int used = client->head - READ_ONCE(ring->tail);
+	unsigned int mask = client->bufsize - 1;
+
+	if (unlikely(client->ring_dropping)) {
+		/* room for EV_SYN/SYN_DROPPED and this event */
+		if (used > client->bufsize - 2)
+			return;
+
+		client->ring_events[client->head & mask] = (struct input_event) {
+			.time = event->time,
+			.type = EV_SYN,
+			.code = SYN_DROPPED,
+		};
+		client->head++;
+		client->ring_dropping = false;
+	} else if (unlikely(used >= client->bufsize)) {
+		client->head = client->packet_head;
+		client->ring_dropping = true;
+		ring->dropped++;
+		return;
+	}
+
+	client->ring_events[client->head++ & mask] = *event;
+
+	if (event->type == EV_SYN && event->code == SYN_REPORT) {
+		client->packet_head = client->head;
+		smp_store_release(&ring->head, client->head);
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	}
+}
+
 static void evdev_pass_values(struct evdev_client *client,
 			const struct input_value *vals, unsigned int count,
 			ktime_t *ev_time)
@@ -287,7 +346,10 @@ static void evdev_pass_values(struct evdev_client *client,
 		event.type = v->type;
 		event.code = v->code;
 		event.value = v->value;
-		__pass_event(client, &event);
+		if (client->ring)
+			__pass_event_ring(client, &event);
+		else
+			__pass_event(client, &event);
 	}
 
 	spin_unlock(&client->buffer_lock);
@@ -467,6 +529,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 	for (i = 0; i < EV_CNT; ++i)
 		kfree(client->evmasks[i]);
 
+	vfree(client->ring);
 	kvfree(client);
 
 	evdev_close_device(evdev);
@@ -562,7 +625,8 @@ static int evdev_fetch_next_event(struct evdev_client *client,
 
 	spin_lock_irq(&client->buffer_lock);
 
-	have_event = client->packet_head != client->tail;
+	/* a concurrent mmap() took the queue over */
+	have_event = !client->ring && client->packet_head != client->tail;
 	if (have_event) {
 		*event = client->buffer[client->tail++];
 		client->tail &= client->bufsize - 1;
@@ -589,6 +653,9 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 		if (!evdev->exist || client->revoked)
 			return -ENODEV;
 
+		if (client->ring)
+			return -EINVAL;
+
 		if (client->packet_head == client->tail &&
 		    (file->f_flags & O_NONBLOCK))
 			return -EAGAIN;
@@ -638,12 +705,75 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	else
 		mask = POLLHUP | POLLERR;
 
-	if (client->packet_head != client->tail)
+	if (client->packet_head !=
+	    (client->ring ? READ_ONCE(client->ring->tail) : client->tail))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+static unsigned int evdev_ring_size(struct evdev_client *client)
+{
+	return PAGE_SIZE +
+		PAGE_ALIGN(client->bufsize * sizeof(struct input_event));
+}
+
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+	struct evdev *evdev = client->evdev;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct input_event_ring *ring;
+	int retval;
+
+	if (input_event_size() != sizeof(struct input_event))
+		return -EINVAL;
+
+	if (vma->vm_pgoff || size != evdev_ring_size(client))
+		return -EINVAL;
+
+	retval = mutex_lock_interruptible(&evdev->mutex);
+	if (retval)
+		return retval;
+
+	if (!evdev->exist || client->revoked) {
+		retval = -ENODEV;
+		goto out;
+	}
+
+	if (client->ring) {
+		retval = -EBUSY;
+		goto out;
+	}
+
+	ring = vmalloc_user(size);
+	if (!ring) {
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	ring->bufsize = client->bufsize;
+	ring->offset = PAGE_SIZE;
+
+	retval = remap_vmalloc_range(vma, ring, 0);
+	if (retval) {
+		vfree(ring);
+		goto out;
+	}
+
+	/* events still queued for read() are lost, tell the client so */
+	spin_lock_irq(&client->buffer_lock);
+	client->ring_dropping = client->head != client->tail;
+	client->head = client->packet_head = 0;
+	client->ring_events = (void *)ring + PAGE_SIZE;
+	client->ring = ring;
+	spin_unlock_irq(&client->buffer_lock);
+
+ out:
+	mutex_unlock(&evdev->mutex);
+	return retval;
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -1145,6 +1275,9 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 
 		return evdev_set_clk_type(client, i);
 
+	case EVIOCGRINGSIZE:
+		return put_user(evdev_ring_size(client), ip);
+
 	case EVIOCGKEYCODE:
 		return evdev_handle_get_keycode(dev, p);
 
@@ -1314,6 +1447,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
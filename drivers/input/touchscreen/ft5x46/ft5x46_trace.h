@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2019 XiaoMi, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ft5x46
+
+#if !defined(_FT5X46_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _FT5X46_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * One touch report: how many finger records were valid, how long the
+ * i2c reads took and the time from the hard irq to input_sync().
+ */
+TRACE_EVENT(ft5x46_touch,
+
+	TP_PROTO(unsigned int points, u64 read_ns, u64 latency_ns),
+
+	TP_ARGS(points, read_ns, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, points)
+		__field(u64, read_ns)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->points = points;
+		__entry->read_ns = read_ns;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("points=%u read_ns=%llu latency_ns=%llu",
+		  __entry->points, __entry->read_ns, __entry->latency_ns)
+);
+
+#endif /* _FT5X46_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ft5x46_trace
+#include <trace/define_trace.h>
@@ -15,6 +15,9 @@
 #include <linux/input/ft5x46_ts.h>
 #include "ft8716_pramboot.h"
 
+#define CREATE_TRACE_POINTS
+#include "ft5x46_trace.h"
+
 
 #define FT5X46_APK_DEBUG_CHANNEL
 
@@ -98,6 +101,17 @@
 
 #define FT5X46_POINT_READ_BUF		(3 + FT5X46_TOUCH_LENGTH * FT5X0X_MAX_FINGER)
 
+/*
+ * Most reports carry one or two fingers, so only that many records are
+ * read at first, a quarter of the bus time of the whole point buffer.
+ */
+#define FT5X46_FAST_POINTS		2
+#define FT5X46_POINT_READ_FAST		(3 + FT5X46_TOUCH_LENGTH * FT5X46_FAST_POINTS)
+
+/* keep the touch irq CPU out of deep idle while fingers are moving */
+#define FT5X46_PM_QOS_LATENCY_US	100
+#define FT5X46_PM_QOS_TIMEOUT_US	(100 * USEC_PER_MSEC)
+
 #define NOISE_FILTER_DELAY	HZ
 
 #define FT_VTG_MIN_UV		2600000
@@ -1578,7 +1592,7 @@ static int ft8716_load_firmware(struct ft5x46_data *ft5x46,
 static int ft5x46_read_touchdata(struct ft5x46_data *ft5x46)
 {
 	struct ft5x46_ts_event *event = &ft5x46->event;
-	u8 buf[FT5X46_POINT_READ_BUF] = {0};
+	u8 buf[FT5X46_POINT_READ_BUF];
 	int i, ret;
 	u8 point_id;
 	u16 xh, xl, yh, yl;
@@ -1586,13 +1600,28 @@ static int ft5x46_read_touchdata(struct ft5x46_data *ft5x46)
 	bool proximity_near = 0;
 #endif
 
+	/* records that are not read end the loop below like invalid ones */
+	memset(buf, 0xff, sizeof(buf));
+
 	ret = ft5x46_read_block(ft5x46, 0,
-				buf, FT5X46_POINT_READ_BUF);
+				buf, FT5X46_POINT_READ_FAST);
 	if (ret < 0) {
 		dev_err(ft5x46->dev, "read touchdata failed\n");
 		return ret;
 	}
 
+	point_id = buf[FT5X46_TOUCH_LENGTH * (FT5X46_FAST_POINTS - 1) +
+		       FT5X46_ID_POS] >> 4;
+	if (point_id < FT5X46_MAX_ID) {
+		ret = ft5x46_read_block(ft5x46, FT5X46_POINT_READ_FAST,
+				buf + FT5X46_POINT_READ_FAST,
+				FT5X46_POINT_READ_BUF - FT5X46_POINT_READ_FAST);
+		if (ret < 0) {
+			dev_err(ft5x46->dev, "read touchdata failed\n");
+			return ret;
+		}
+	}
+
 #ifdef CONFIG_TOUCHSCREEN_FT5X46P_PROXIMITY
 	if (ft5x46->proximity_enable) {
 		if (buf[1] == 0xC0) {
@@ -1764,11 +1793,25 @@ static int ft5x46_wakeup_reconfigure(struct ft5x46_data *ft5x46, bool enable)
 	return error;
 }
 
+static irqreturn_t ft5x46_hardirq(int irq, void *dev_id)
+{
+	struct ft5x46_data *ft5x46 = dev_id;
+
+	ft5x46->irq_ts = ktime_get();
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * Runs in the irq thread, which is SCHED_FIFO already; the pm_qos
+ * request follows the irq's affinity.
+ */
 static irqreturn_t ft5x46_interrupt(int irq, void *dev_id)
 {
 	struct ft5x46_data *ft5x46 = dev_id;
 	int error = 0;
 	u8 val = 0;
+	ktime_t start;
+	u64 read_ns;
 
 	mutex_lock(&ft5x46->mutex);
 
@@ -1787,9 +1830,17 @@ static irqreturn_t ft5x46_interrupt(int irq, void *dev_id)
 			goto out;
 	}
 
+	pm_qos_update_request_timeout(&ft5x46->pm_qos_req,
+				      FT5X46_PM_QOS_LATENCY_US,
+				      FT5X46_PM_QOS_TIMEOUT_US);
+
+	start = ktime_get();
 	error = ft5x46_read_touchdata(ft5x46);
+	read_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 	if (!error) {
 		ft5x46_report_value(ft5x46);
+		trace_ft5x46_touch(ft5x46->event.touch_point, read_ns,
+			ktime_to_ns(ktime_sub(ktime_get(), ft5x46->irq_ts)));
 	}
 
 out:
@@ -3646,6 +3697,7 @@ failed:
 #endif
 	sysfs_remove_group(&ft5x46->dev->kobj, &ft5x46_attr_group);
 	free_irq(ft5x46->irq, ft5x46);
+	pm_qos_remove_request(&ft5x46->pm_qos_req);
 #ifdef CONFIG_TOUCHSCREEN_FT5X46P_PROXIMITY
 	kfree(ft5x46->proximity->phys);
 #endif
@@ -3906,10 +3958,17 @@ struct ft5x46_data *ft5x46_probe(struct device *dev,
 #endif
 
 	/* start interrupt process */
-	error = request_threaded_irq(ft5x46->irq, NULL, ft5x46_interrupt,
+	ft5x46->pm_qos_req.type = PM_QOS_REQ_AFFINE_IRQ;
+	ft5x46->pm_qos_req.irq = ft5x46->irq;
+	pm_qos_add_request(&ft5x46->pm_qos_req, PM_QOS_CPU_DMA_LATENCY,
+			   PM_QOS_DEFAULT_VALUE);
+
+	error = request_threaded_irq(ft5x46->irq, ft5x46_hardirq,
+				ft5x46_interrupt,
 				IRQF_TRIGGER_FALLING | IRQF_ONESHOT, "ft5x46", ft5x46);
 	if (error) {
 		dev_err(dev, "fail to request interrupt\n");
+		pm_qos_remove_request(&ft5x46->pm_qos_req);
 #ifdef CONFIG_TOUCHSCREEN_FT5X46P_PROXIMITY
 		goto err_free_proximity_phys;
 #else
@@ -3992,6 +4051,7 @@ err_sysfs_create_group:
 	sysfs_remove_group(&dev->kobj, &ft5x46_attr_group);
 err_free_irq:
 	free_irq(ft5x46->irq, ft5x46);
+	pm_qos_remove_request(&ft5x46->pm_qos_req);
 #ifdef CONFIG_TOUCHSCREEN_FT5X46P_PROXIMITY
 err_free_proximity_phys:
 	kfree(ft5x46->proximity->phys);
@@ -4072,6 +4132,7 @@ void ft5x46_remove(struct ft5x46_data *ft5x46)
 #endif
 	sysfs_remove_group(&ft5x46->dev->kobj, &ft5x46_attr_group);
 	free_irq(ft5x46->irq, ft5x46);
+	pm_qos_remove_request(&ft5x46->pm_qos_req);
 #ifdef CONFIG_TOUCHSCREEN_FT5X46P_PROXIMITY
 	kfree(ft5x46->proximity->phys);
 #endif
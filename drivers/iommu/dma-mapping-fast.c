@@ -14,6 +14,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/dma-mapping-fast.h>
 #include <linux/io-pgtable-fast.h>
+#include <linux/module.h>
 #include <linux/vmalloc.h>
 #include <asm/cacheflush.h>
 #include <asm/dma-iommu.h>
@@ -33,6 +34,18 @@
 #define FAST_PTE_SH_OS             (((av8l_fast_iopte)2) << FAST_PTE_SH_SHIFT)
 #define FAST_PTE_SH_IS             (((av8l_fast_iopte)3) << FAST_PTE_SH_SHIFT)
 
+/*
+ * Number of unmapped IOVAs a mapping holds back before returning them to
+ * the allocator with a single TLB invalidate-all, and the longest they
+ * are held. Zero disables the deferral and falls back to invalidating
+ * when a stale IOVA is about to be re-allocated. Read at attach time.
+ */
+static unsigned int fast_smmu_defer_max = 64;
+module_param_named(defer_max, fast_smmu_defer_max, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int fast_smmu_defer_ms = 10;
+module_param_named(defer_ms, fast_smmu_defer_ms, uint, S_IRUGO | S_IWUSR);
+
 static pgprot_t __get_dma_pgprot(struct dma_attrs *attrs, pgprot_t prot,
 				 bool coherent)
 {
@@ -148,6 +161,9 @@ static bool __bit_covered_stale(unsigned long upcoming_stale,
 	return true;
 }
 
+static void __fast_smmu_flush_deferred(struct dma_fast_smmu_mapping *mapping,
+				       bool skip_sync);
+
 static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 					 struct dma_attrs *attrs,
 					 size_t size)
@@ -164,6 +180,16 @@ static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 		bit = bitmap_find_next_zero_area(
 			mapping->bitmap, mapping->num_4k_pages, 0, nbits,
 			align);
+		if (unlikely(bit > mapping->num_4k_pages) &&
+		    mapping->nr_deferred) {
+			/* give back what the deferred unmaps are holding */
+			mapping->stats.alloc_flushes++;
+			__fast_smmu_flush_deferred(mapping,
+				dma_get_attr(DMA_ATTR_SKIP_CPU_SYNC, attrs));
+			bit = bitmap_find_next_zero_area(
+				mapping->bitmap, mapping->num_4k_pages, 0,
+				nbits, align);
+		}
 		if (unlikely(bit > mapping->num_4k_pages))
 			return DMA_ERROR_CODE;
 	}
@@ -186,6 +212,7 @@ static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 				bit + nbits - 1)) {
 		bool skip_sync = dma_get_attr(DMA_ATTR_SKIP_CPU_SYNC, attrs);
 
+		mapping->stats.stale_flushes++;
 		iommu_tlbiall(mapping->domain);
 		mapping->have_stale_tlbs = false;
 		av8l_fast_clear_stale_ptes(mapping->pgtbl_pmds,
@@ -304,6 +331,89 @@ static void __fast_smmu_free_iova(struct dma_fast_smmu_mapping *mapping,
 	mapping->have_stale_tlbs = true;
 }
 
+/*
+ * Invalidate the whole TLB once and hand every IOVA queued by
+ * __fast_smmu_release_iova() back to the allocator. Their TLB entries
+ * are gone, so unlike __fast_smmu_free_iova() they don't make the
+ * bitmap stale. Called with mapping->lock held.
+ */
+static void __fast_smmu_flush_deferred(struct dma_fast_smmu_mapping *mapping,
+				       bool skip_sync)
+{
+	struct dma_fast_smmu_deferred *d;
+	unsigned int i;
+
+	iommu_tlbiall(mapping->domain);
+
+	for (i = 0; i < mapping->nr_deferred; i++) {
+		d = &mapping->deferred[i];
+		av8l_fast_clear_stale_ptes(mapping->pgtbl_pmds,
+				mapping->domain->geometry.aperture_start,
+				d->iova, d->iova + d->size - 1, skip_sync);
+		bitmap_clear(mapping->bitmap,
+			     (d->iova - mapping->base) >> FAST_PAGE_SHIFT,
+			     d->size >> FAST_PAGE_SHIFT);
+	}
+	mapping->nr_deferred = 0;
+
+	/* the invalidate also covered anything freed the old way */
+	if (mapping->have_stale_tlbs) {
+		mapping->have_stale_tlbs = false;
+		av8l_fast_clear_stale_ptes(mapping->pgtbl_pmds,
+				mapping->domain->geometry.aperture_start,
+				mapping->base,
+				mapping->base + mapping->size - 1,
+				skip_sync);
+	}
+}
+
+/*
+ * Release the IOVA of a range that has just been unmapped. In deferred
+ * mode the range stays allocated until a batch is flushed, so no access
+ * can be made through a stale TLB entry and the per unmap cost is just
+ * queueing it.
+ */
+static void __fast_smmu_release_iova(struct dma_fast_smmu_mapping *mapping,
+				     dma_addr_t iova, size_t size,
+				     bool skip_sync)
+{
+	struct dma_fast_smmu_deferred *d;
+
+	if (!mapping->max_deferred) {
+		__fast_smmu_free_iova(mapping, iova, size);
+		return;
+	}
+
+	if (mapping->nr_deferred == mapping->max_deferred) {
+		mapping->stats.batch_flushes++;
+		__fast_smmu_flush_deferred(mapping, skip_sync);
+	}
+
+	d = &mapping->deferred[mapping->nr_deferred++];
+	d->iova = round_down(iova, FAST_PAGE_SIZE);
+	d->size = size;
+	mapping->stats.deferred++;
+
+	if (mapping->nr_deferred == 1)
+		schedule_delayed_work(&mapping->flush_work,
+				      msecs_to_jiffies(fast_smmu_defer_ms));
+}
+
+static void fast_smmu_flush_work(struct work_struct *work)
+{
+	struct dma_fast_smmu_mapping *mapping = container_of(
+		to_delayed_work(work), struct dma_fast_smmu_mapping,
+		flush_work);
+	unsigned long flags;
+
+	spin_lock_irqsave(&mapping->lock, flags);
+	if (mapping->nr_deferred) {
+		mapping->stats.timeout_flushes++;
+		__fast_smmu_flush_deferred(mapping, false);
+	}
+	spin_unlock_irqrestore(&mapping->lock, flags);
+}
+
 
 static void __fast_dma_page_cpu_to_dev(struct page *page, unsigned long off,
 				       size_t size, enum dma_data_direction dir)
@@ -409,7 +519,7 @@ static void fast_smmu_unmap_page(struct device *dev, dma_addr_t iova,
 	spin_lock_irqsave(&mapping->lock, flags);
 	av8l_fast_unmap_public(pmd, len);
 	fast_dmac_clean_range(mapping, pmd, pmd + nptes);
-	__fast_smmu_free_iova(mapping, iova, len);
+	__fast_smmu_release_iova(mapping, iova, len, skip_sync);
 	spin_unlock_irqrestore(&mapping->lock, flags);
 }
 
@@ -640,7 +750,7 @@ static void fast_smmu_free(struct device *dev, size_t size,
 	spin_lock_irqsave(&mapping->lock, flags);
 	av8l_fast_unmap_public(ptep, size);
 	fast_dmac_clean_range(mapping, ptep, ptep + count);
-	__fast_smmu_free_iova(mapping, dma_handle, size);
+	__fast_smmu_release_iova(mapping, dma_handle, size, false);
 	spin_unlock_irqrestore(&mapping->lock, flags);
 	__fast_smmu_free_pages(pages, count);
 }
@@ -767,6 +877,15 @@ static struct dma_fast_smmu_mapping *__fast_smmu_create_mapping_sized(
 	if (!fast->bitmap)
 		goto err2;
 
+	fast->max_deferred = fast_smmu_defer_max;
+	if (fast->max_deferred) {
+		fast->deferred = kcalloc(fast->max_deferred,
+					 sizeof(*fast->deferred), GFP_KERNEL);
+		if (!fast->deferred)
+			fast->max_deferred = 0;
+	}
+	INIT_DELAYED_WORK(&fast->flush_work, fast_smmu_flush_work);
+
 	spin_lock_init(&fast->lock);
 
 	return fast;
@@ -850,11 +969,29 @@ EXPORT_SYMBOL(fast_smmu_attach_device);
 void fast_smmu_detach_device(struct device *dev,
 			     struct dma_iommu_mapping *mapping)
 {
+	cancel_delayed_work_sync(&mapping->fast->flush_work);
 	iommu_detach_device(mapping->domain, dev);
 	dev->archdata.mapping = NULL;
 	set_dma_ops(dev, NULL);
 
+	kfree(mapping->fast->deferred);
 	kvfree(mapping->fast->bitmap);
 	kfree(mapping->fast);
 }
 EXPORT_SYMBOL(fast_smmu_detach_device);
+
+/**
+ * fast_smmu_get_stats
+ * @mapping: fast mapping of an attached device
+ * @stats: filled with a snapshot of the mapping's TLB maintenance counters
+ */
+void fast_smmu_get_stats(struct dma_fast_smmu_mapping *mapping,
+			 struct dma_fast_smmu_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mapping->lock, flags);
+	*stats = mapping->stats;
+	spin_unlock_irqrestore(&mapping->lock, flags);
+}
+EXPORT_SYMBOL(fast_smmu_get_stats);
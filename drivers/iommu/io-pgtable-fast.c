@@ -58,6 +58,7 @@ struct av8l_fast_io_pgtable {
 
 #define AV8L_FAST_PTE_NSTABLE		(((av8l_fast_iopte)1) << 63)
 #define AV8L_FAST_PTE_XN		(((av8l_fast_iopte)3) << 53)
+#define AV8L_FAST_PTE_CONT		(((av8l_fast_iopte)1) << 52)
 #define AV8L_FAST_PTE_AF		(((av8l_fast_iopte)1) << 10)
 #define AV8L_FAST_PTE_SH_NS		(((av8l_fast_iopte)0) << 8)
 #define AV8L_FAST_PTE_SH_OS		(((av8l_fast_iopte)2) << 8)
@@ -147,6 +148,10 @@ struct av8l_fast_io_pgtable {
 
 #define AV8L_FAST_PAGE_SHIFT		12
 
+/* 16 naturally aligned 4K PTEs can share one TLB entry (contiguous hint) */
+#define AV8L_FAST_CONT_PTES		16
+#define AV8L_FAST_CONT_SIZE		(AV8L_FAST_CONT_PTES << AV8L_FAST_PAGE_SHIFT)
+
 
 #ifdef CONFIG_IOMMU_IO_PGTABLE_FAST_PROVE_TLB
 
@@ -197,11 +202,40 @@ static void __av8l_check_for_stale_tlb(av8l_fast_iopte *ptep)
 }
 #endif
 
+/*
+ * The pmds are a page aligned array starting at a 2M aligned base, so
+ * a PTE pointer aligned to a whole contiguous set also means the IOVA
+ * is aligned to AV8L_FAST_CONT_SIZE.
+ */
+static bool av8l_fast_can_cont(av8l_fast_iopte *ptep, phys_addr_t paddr,
+			       int nptes)
+{
+	return nptes >= AV8L_FAST_CONT_PTES &&
+		IS_ALIGNED(paddr, AV8L_FAST_CONT_SIZE) &&
+		IS_ALIGNED((unsigned long)ptep,
+			   AV8L_FAST_CONT_PTES * sizeof(*ptep));
+}
+
+/*
+ * All PTEs of a contiguous set must agree, so before part of a set is
+ * unmapped the hint is dropped from the rest of it.
+ */
+static void av8l_fast_split_cont(av8l_fast_iopte *ptep)
+{
+	av8l_fast_iopte *start = (av8l_fast_iopte *)((unsigned long)ptep &
+				~(AV8L_FAST_CONT_PTES * sizeof(*ptep) - 1));
+	int i;
+
+	for (i = 0; i < AV8L_FAST_CONT_PTES; i++)
+		start[i] &= ~AV8L_FAST_PTE_CONT;
+	dmac_clean_range(start, start + AV8L_FAST_CONT_PTES);
+}
+
 /* caller must take care of cache maintenance on *ptep */
 int av8l_fast_map_public(av8l_fast_iopte *ptep, phys_addr_t paddr, size_t size,
 			 int prot)
 {
-	int i, nptes = size >> AV8L_FAST_PAGE_SHIFT;
+	int i, j, nptes = size >> AV8L_FAST_PAGE_SHIFT;
 	av8l_fast_iopte pte = AV8L_FAST_PTE_XN
 		| AV8L_FAST_PTE_TYPE_PAGE
 		| AV8L_FAST_PTE_AF
@@ -221,9 +255,19 @@ int av8l_fast_map_public(av8l_fast_iopte *ptep, phys_addr_t paddr, size_t size,
 		pte |= AV8L_FAST_PTE_AP_RW;
 
 	paddr &= AV8L_FAST_PTE_ADDR_MASK;
-	for (i = 0; i < nptes; i++, paddr += SZ_4K) {
-		__av8l_check_for_stale_tlb(ptep + i);
-		*(ptep + i) = pte | paddr;
+	for (i = 0; i < nptes; ) {
+		av8l_fast_iopte cont = 0;
+		int n = 1;
+
+		if (av8l_fast_can_cont(ptep + i, paddr, nptes - i)) {
+			cont = AV8L_FAST_PTE_CONT;
+			n = AV8L_FAST_CONT_PTES;
+		}
+
+		for (j = 0; j < n; j++, i++, paddr += SZ_4K) {
+			__av8l_check_for_stale_tlb(ptep + i);
+			*(ptep + i) = pte | cont | paddr;
+		}
 	}
 
 	return 0;
@@ -246,10 +290,20 @@ static void __av8l_fast_unmap(av8l_fast_iopte *ptep, size_t size,
 			      bool need_stale_tlb_tracking)
 {
 	unsigned long nptes = size >> AV8L_FAST_PAGE_SHIFT;
+	av8l_fast_iopte *last = ptep + nptes - 1;
 	int val = need_stale_tlb_tracking
 		? AV8L_FAST_PTE_UNMAPPED_NEED_TLBI
 		: 0;
 
+	if ((*ptep & AV8L_FAST_PTE_CONT) &&
+	    !IS_ALIGNED((unsigned long)ptep,
+			AV8L_FAST_CONT_PTES * sizeof(*ptep)))
+		av8l_fast_split_cont(ptep);
+	if ((*last & AV8L_FAST_PTE_CONT) &&
+	    !IS_ALIGNED((unsigned long)(last + 1),
+			AV8L_FAST_CONT_PTES * sizeof(*ptep)))
+		av8l_fast_split_cont(last);
+
 	memset(ptep, val, sizeof(*ptep) * nptes);
 }
 
@@ -320,7 +374,33 @@ static int av8l_fast_map_sg(struct io_pgtable_ops *ops, unsigned long iova,
 			    struct scatterlist *sg, unsigned int nents,
 			    int prot, size_t *size)
 {
-	return -ENODEV;
+	struct av8l_fast_io_pgtable *data = iof_pgtable_ops_to_data(ops);
+	av8l_fast_iopte *start = iopte_pmd_offset(data->pmds, data->base, iova);
+	av8l_fast_iopte *ptep = start;
+	struct scatterlist *s;
+	size_t mapped = 0;
+	int i;
+
+	for_each_sg(sg, s, nents, i) {
+		phys_addr_t phys = page_to_phys(sg_page(s)) + s->offset;
+		size_t len = ALIGN(s->length, SZ_4K);
+
+		if (!IS_ALIGNED(s->offset, SZ_4K))
+			goto out_err;
+
+		av8l_fast_map_public(ptep, phys, len, prot);
+		ptep += len >> AV8L_FAST_PAGE_SHIFT;
+		mapped += len;
+	}
+
+	dmac_clean_range(start, ptep);
+	return mapped;
+
+out_err:
+	/* Return the size of the partial mapping so that they can be undone */
+	dmac_clean_range(start, ptep);
+	*size = mapped;
+	return 0;
 }
 
 static struct av8l_fast_io_pgtable *
@@ -484,7 +564,7 @@ av8l_fast_alloc_pgtable(struct io_pgtable_cfg *cfg, void *cookie)
 
 	/* restrict according to the fast map requirements */
 	cfg->ias = 32;
-	cfg->pgsize_bitmap = SZ_4K;
+	cfg->pgsize_bitmap = SZ_4K | AV8L_FAST_CONT_SIZE;
 
 	/* TCR */
 	if (cfg->quirks & IO_PGTABLE_QUIRK_PAGE_TABLE_COHERENT)
@@ -737,11 +817,124 @@ static int __init av8l_fast_positive_testing(void)
 	return failed;
 }
 
+/*
+ * Returns true if every PTE of the iova range has the contiguous hint
+ * set, or every one has it clear, as asked by @cont.
+ */
+static bool av8l_fast_range_has_cont(av8l_fast_iopte *pmds, u64 base,
+				     u64 iova, size_t size, bool cont)
+{
+	av8l_fast_iopte *ptep = iopte_pmd_offset(pmds, base, iova);
+	int i;
+
+	for (i = 0; i < (size >> AV8L_FAST_PAGE_SHIFT); i++)
+		if (!!(ptep[i] & AV8L_FAST_PTE_CONT) != cont)
+			return false;
+	return true;
+}
+
+static int __init av8l_fast_cont_testing(void)
+{
+	int failed = 0;
+	struct io_pgtable_ops *ops;
+	struct io_pgtable_cfg cfg;
+	struct av8l_fast_io_pgtable *data;
+	av8l_fast_iopte *pmds;
+	u64 max = SZ_1G * 4ULL - 1;
+	u64 base = 0;
+	u64 iova = SZ_1G;
+
+	cfg = (struct io_pgtable_cfg) {
+		.quirks = 0,
+		.tlb = &dummy_tlb_ops,
+		.ias = 32,
+		.oas = 32,
+		.pgsize_bitmap = SZ_4K,
+		.iova_base = base,
+		.iova_end = max,
+	};
+
+	cfg_cookie = &cfg;
+	ops = alloc_io_pgtable_ops(ARM_V8L_FAST, &cfg, &cfg);
+
+	if (WARN_ON(!ops))
+		return 1;
+
+	data = iof_pgtable_ops_to_data(ops);
+	pmds = data->pmds;
+
+	/* aligned iova and phys: the whole range carries the hint */
+	if (WARN_ON(ops->map(ops, iova, iova, SZ_1M, IOMMU_READ)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_specific_mapping(ops, iova,
+							   iova, SZ_1M)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova, SZ_1M, true)))
+		failed++;
+	if (WARN_ON(ops->unmap(ops, iova, SZ_1M) != SZ_1M))
+		failed++;
+	av8l_fast_clear_stale_ptes(pmds, base, iova, iova + SZ_1M - 1, false);
+
+	/* phys only 4K aligned: no hint anywhere */
+	if (WARN_ON(ops->map(ops, iova, iova + SZ_4K, SZ_1M, IOMMU_READ)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_specific_mapping(ops, iova,
+						iova + SZ_4K, SZ_1M)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova, SZ_1M,
+					      false)))
+		failed++;
+	if (WARN_ON(ops->unmap(ops, iova, SZ_1M) != SZ_1M))
+		failed++;
+	av8l_fast_clear_stale_ptes(pmds, base, iova, iova + SZ_1M - 1, false);
+
+	/* a short tail after a full set is mapped without the hint */
+	if (WARN_ON(ops->map(ops, iova, iova, SZ_64K + SZ_8K, IOMMU_READ)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova, SZ_64K,
+					      true)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova + SZ_64K,
+					      SZ_8K, false)))
+		failed++;
+	if (WARN_ON(ops->unmap(ops, iova, SZ_64K + SZ_8K) != SZ_64K + SZ_8K))
+		failed++;
+	av8l_fast_clear_stale_ptes(pmds, base, iova, iova + SZ_128K - 1,
+				   false);
+
+	/* unmapping part of a set drops the hint from the rest of that set */
+	if (WARN_ON(ops->map(ops, iova, iova, SZ_128K, IOMMU_READ)))
+		failed++;
+	if (WARN_ON(ops->unmap(ops, iova + SZ_16K, SZ_4K) != SZ_4K))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova, SZ_16K,
+					      false)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova + SZ_16K +
+					      SZ_4K, SZ_64K - SZ_16K - SZ_4K,
+					      false)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_cont(pmds, base, iova + SZ_64K,
+					      SZ_64K, true)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_specific_mapping(ops, iova,
+							   iova, SZ_16K)))
+		failed++;
+	if (WARN_ON(!av8l_fast_range_has_specific_mapping(ops,
+				iova + SZ_16K + SZ_4K, iova + SZ_16K + SZ_4K,
+				SZ_128K - SZ_16K - SZ_4K)))
+		failed++;
+
+	free_io_pgtable_ops(ops);
+	return failed;
+}
+
 static int __init av8l_fast_do_selftests(void)
 {
 	int failed = 0;
 
 	failed += av8l_fast_positive_testing();
+	failed += av8l_fast_cont_testing();
 
 	pr_err("selftest: completed with %d failures\n", failed);
 
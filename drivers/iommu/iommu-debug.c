@@ -20,12 +20,15 @@
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/workqueue.h>
 #include <linux/uaccess.h>
 #include <linux/dma-contiguous.h>
 #include <soc/qcom/secure_buffer.h>
 #include <linux/qcom_iommu.h>
 #include <linux/module.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-mapping-fast.h>
 #include <asm/cacheflush.h>
 #include <asm/dma-iommu.h>
 #include "iommu-debug.h"
@@ -509,6 +512,285 @@ static const struct file_operations iommu_debug_profiling_fast_fops = {
 	.release = single_release,
 };
 
+/*
+ * profiling_suite: one line per measurement, whitespace separated, so
+ * runs before and after a page table or IOVA change can be diffed by a
+ * script:
+ *
+ *	<domain> <test> <size> <chunk> <cpus> <map_ns> <unmap_ns>
+ *
+ * Times are averages over nr_iters iterations (and CPUs).
+ */
+#define IOMMU_BENCH_IOVA	SZ_16M
+#define IOMMU_BENCH_PADDR	((phys_addr_t)SZ_1G)
+#define IOMMU_BENCH_CPU_WINDOW	SZ_4M
+
+/*
+ * Maps size bytes with map_chunk sized iommu_map() calls and unmaps them
+ * with unmap_chunk sized iommu_unmap() calls. A single unmap lets the
+ * driver invalidate the TLB once for the whole range.
+ */
+static int iommu_debug_bench_map(struct iommu_domain *domain,
+				 unsigned long iova, size_t size,
+				 size_t map_chunk, size_t unmap_chunk,
+				 u64 *map_ns, u64 *unmap_ns)
+{
+	size_t off;
+	u64 start;
+	int i;
+
+	*map_ns = *unmap_ns = 0;
+	for (i = 0; i < iters_per_op; ++i) {
+		start = ktime_get_ns();
+		for (off = 0; off < size; off += map_chunk) {
+			if (iommu_map(domain, iova + off,
+				      IOMMU_BENCH_PADDR + off, map_chunk,
+				      IOMMU_READ | IOMMU_WRITE)) {
+				if (off)
+					iommu_unmap(domain, iova, off);
+				return -ENOMEM;
+			}
+		}
+		*map_ns += ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		for (off = 0; off < size; off += unmap_chunk) {
+			if (iommu_unmap(domain, iova + off, unmap_chunk) !=
+			    unmap_chunk) {
+				iommu_unmap(domain, iova, size);
+				return -EINVAL;
+			}
+		}
+		*unmap_ns += ktime_get_ns() - start;
+	}
+
+	*map_ns = div_u64(*map_ns, iters_per_op);
+	*unmap_ns = div_u64(*unmap_ns, iters_per_op);
+	return 0;
+}
+
+/* map_sg of size bytes split into chunk sized sg entries */
+static int iommu_debug_bench_map_sg(struct device *dev,
+				    struct iommu_domain *domain,
+				    unsigned long iova, size_t size,
+				    size_t chunk, u64 *map_ns, u64 *unmap_ns)
+{
+	struct sg_table table;
+	u64 start;
+	int i, ret = 0;
+
+	if (iommu_debug_build_phoney_sg_table(dev, &table, size, chunk))
+		return -ENOMEM;
+
+	*map_ns = *unmap_ns = 0;
+	for (i = 0; i < iters_per_op; ++i) {
+		start = ktime_get_ns();
+		if (iommu_map_sg(domain, iova, table.sgl, table.nents,
+				 IOMMU_READ | IOMMU_WRITE) != size) {
+			ret = -ENOMEM;
+			break;
+		}
+		*map_ns += ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		if (iommu_unmap(domain, iova, size) != size) {
+			ret = -EINVAL;
+			break;
+		}
+		*unmap_ns += ktime_get_ns() - start;
+	}
+
+	iommu_debug_destroy_phoney_sg_table(dev, &table, chunk);
+
+	*map_ns = div_u64(*map_ns, iters_per_op);
+	*unmap_ns = div_u64(*unmap_ns, iters_per_op);
+	return ret;
+}
+
+struct iommu_debug_bench_work {
+	struct work_struct work;
+	struct iommu_domain *domain;
+	unsigned long iova;
+	u64 map_ns;
+	u64 unmap_ns;
+	int ret;
+};
+
+static void iommu_debug_bench_work_fn(struct work_struct *work)
+{
+	struct iommu_debug_bench_work *w =
+		container_of(work, struct iommu_debug_bench_work, work);
+
+	w->ret = iommu_debug_bench_map(w->domain, w->iova, SZ_64K, SZ_4K,
+				       SZ_4K, &w->map_ns, &w->unmap_ns);
+}
+
+/* every online CPU maps and unmaps its own 64K window at the same time */
+static void iommu_debug_bench_concurrent(struct seq_file *s,
+					 struct iommu_domain *domain,
+					 const char *label)
+{
+	struct iommu_debug_bench_work *works;
+	u64 map_ns = 0, unmap_ns = 0;
+	unsigned int nr = 0;
+	int cpu, ret = 0;
+
+	works = kcalloc(nr_cpu_ids, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		works[cpu].domain = domain;
+		works[cpu].iova = IOMMU_BENCH_IOVA +
+				  (cpu + 1) * (unsigned long)IOMMU_BENCH_CPU_WINDOW;
+		INIT_WORK(&works[cpu].work, iommu_debug_bench_work_fn);
+		queue_work_on(cpu, system_highpri_wq, &works[cpu].work);
+	}
+	for_each_online_cpu(cpu) {
+		flush_work(&works[cpu].work);
+		if (works[cpu].ret)
+			ret = works[cpu].ret;
+		map_ns += works[cpu].map_ns;
+		unmap_ns += works[cpu].unmap_ns;
+		nr++;
+	}
+	put_online_cpus();
+
+	if (ret)
+		seq_printf(s, "# %s concurrent failed: %d\n", label, ret);
+	else
+		seq_printf(s, "%s concurrent 64K 4K %u %llu %llu\n", label, nr,
+			   div_u64(map_ns, nr), div_u64(unmap_ns, nr));
+	kfree(works);
+}
+
+static void iommu_debug_bench_domain(struct seq_file *s, struct device *dev,
+				     const char *label, enum iommu_attr attrs[],
+				     void *attr_values[], int nattrs)
+{
+	static const size_t sizes[] = { SZ_4K, SZ_64K, SZ_2M, 0 };
+	unsigned long iova = IOMMU_BENCH_IOVA;
+	struct iommu_domain *domain;
+	struct bus_type *bus;
+	const size_t *sz;
+	u64 map_ns, unmap_ns;
+	int i, ret;
+
+	bus = msm_iommu_get_bus(dev);
+	if (!bus)
+		return;
+
+	domain = iommu_domain_alloc(bus);
+	if (!domain) {
+		seq_printf(s, "# %s: couldn't allocate domain\n", label);
+		return;
+	}
+
+	for (i = 0; i < nattrs; ++i) {
+		if (iommu_domain_set_attr(domain, attrs[i], attr_values[i])) {
+			seq_printf(s, "# %s: couldn't set %s\n", label,
+				   iommu_debug_attr_to_string(attrs[i]));
+			goto out_domain_free;
+		}
+	}
+
+	if (iommu_attach_device(domain, dev)) {
+		seq_printf(s, "# %s: couldn't attach, is it already attached?\n",
+			   label);
+		goto out_domain_free;
+	}
+
+#define BENCH_EMIT(test, size, chunk)					\
+	do {								\
+		if (ret)						\
+			seq_printf(s, "# %s %s %s %s failed: %d\n", label, \
+				   test, _size_to_string(size),		\
+				   _size_to_string(chunk), ret);	\
+		else							\
+			seq_printf(s, "%s %s %s %s 1 %llu %llu\n", label, \
+				   test, _size_to_string(size),		\
+				   _size_to_string(chunk), map_ns,	\
+				   unmap_ns);				\
+	} while (0)
+
+	for (sz = sizes; *sz; ++sz) {
+		/* one call each way: large pages and a single TLB flush */
+		ret = iommu_debug_bench_map(domain, iova, *sz, *sz, *sz,
+					    &map_ns, &unmap_ns);
+		BENCH_EMIT("map", *sz, *sz);
+		if (*sz == SZ_4K)
+			continue;
+
+		/* 4K pages only, still unmapped with a single call */
+		ret = iommu_debug_bench_map(domain, iova, *sz, SZ_4K, *sz,
+					    &map_ns, &unmap_ns);
+		BENCH_EMIT("map_4k", *sz, SZ_4K);
+
+		/* a TLB invalidation for every 4K unmapped */
+		ret = iommu_debug_bench_map(domain, iova, *sz, *sz, SZ_4K,
+					    &map_ns, &unmap_ns);
+		BENCH_EMIT("unmap_4k", *sz, SZ_4K);
+
+		ret = iommu_debug_bench_map_sg(dev, domain, iova, *sz, *sz,
+					       &map_ns, &unmap_ns);
+		BENCH_EMIT("map_sg", *sz, *sz);
+
+		ret = iommu_debug_bench_map_sg(dev, domain, iova, *sz, SZ_4K,
+					       &map_ns, &unmap_ns);
+		BENCH_EMIT("map_sg", *sz, SZ_4K);
+	}
+#undef BENCH_EMIT
+
+	iommu_debug_bench_concurrent(s, domain, label);
+
+	iommu_detach_device(domain, dev);
+out_domain_free:
+	iommu_domain_free(domain);
+}
+
+static int iommu_debug_profiling_suite_show(struct seq_file *s, void *ignored)
+{
+	struct iommu_debug_device *ddev = s->private;
+	enum iommu_attr attrs[] = {
+		DOMAIN_ATTR_ATOMIC,
+	};
+	enum iommu_attr fast_attrs[] = {
+		DOMAIN_ATTR_FAST,
+		DOMAIN_ATTR_ATOMIC,
+		DOMAIN_ATTR_GEOMETRY,
+	};
+	int one = 1;
+	struct iommu_domain_geometry geometry = {0, 0, 0};
+	void *attr_values[] = { &one };
+	void *fast_attr_values[] = { &one, &one, &geometry };
+
+	geometry.aperture_end = (dma_addr_t)(SZ_1G * 4ULL - 1);
+
+	seq_printf(s, "# %u iterations\n", iters_per_op);
+	seq_puts(s, "# domain test size chunk cpus map_ns unmap_ns\n");
+	iommu_debug_bench_domain(s, ddev->dev, "lpae", attrs, attr_values,
+				 ARRAY_SIZE(attrs));
+	iommu_debug_bench_domain(s, ddev->dev, "fast", fast_attrs,
+				 fast_attr_values, ARRAY_SIZE(fast_attrs));
+
+	return 0;
+}
+
+static int iommu_debug_profiling_suite_open(struct inode *inode,
+					    struct file *file)
+{
+	return single_open(file, iommu_debug_profiling_suite_show,
+			   inode->i_private);
+}
+
+static const struct file_operations iommu_debug_profiling_suite_fops = {
+	.open	 = iommu_debug_profiling_suite_open,
+	.read	 = seq_read,
+	.llseek	 = seq_lseek,
+	.release = single_release,
+};
+
 static int iommu_debug_profiling_fast_dma_api_show(struct seq_file *s,
 						 void *ignored)
 {
@@ -1386,6 +1668,49 @@ static const struct file_operations iommu_debug_dma_attach_fops = {
 	.read	= iommu_debug_dma_attach_read,
 };
 
+static int iommu_debug_fast_stats_show(struct seq_file *s, void *ignored)
+{
+	struct iommu_debug_device *ddev = s->private;
+	struct device *dev = ddev->dev;
+#ifdef CONFIG_IOMMU_IO_PGTABLE_FAST
+	struct dma_fast_smmu_stats stats;
+#endif
+	int is_fast = 0;
+
+	mutex_lock(&ddev->dev_lock);
+	if (!dev->archdata.mapping || !dev->archdata.mapping->domain ||
+	    iommu_domain_get_attr(dev->archdata.mapping->domain,
+				  DOMAIN_ATTR_FAST, &is_fast) || !is_fast) {
+		seq_puts(s, "No fast mapping attached\n");
+		goto out;
+	}
+
+#ifdef CONFIG_IOMMU_IO_PGTABLE_FAST
+	fast_smmu_get_stats(dev->archdata.mapping->fast, &stats);
+	seq_printf(s, "deferred unmaps:  %llu\n", stats.deferred);
+	seq_printf(s, "batch flushes:    %llu\n", stats.batch_flushes);
+	seq_printf(s, "timeout flushes:  %llu\n", stats.timeout_flushes);
+	seq_printf(s, "alloc flushes:    %llu\n", stats.alloc_flushes);
+	seq_printf(s, "stale flushes:    %llu\n", stats.stale_flushes);
+#endif
+out:
+	mutex_unlock(&ddev->dev_lock);
+	return 0;
+}
+
+static int iommu_debug_fast_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iommu_debug_fast_stats_show,
+			   inode->i_private);
+}
+
+static const struct file_operations iommu_debug_fast_stats_fops = {
+	.open	 = iommu_debug_fast_stats_open,
+	.read	 = seq_read,
+	.llseek	 = seq_lseek,
+	.release = single_release,
+};
+
 static ssize_t iommu_debug_virt_addr_read(struct file *file, char __user *ubuf,
 				     size_t count, loff_t *offset)
 {
@@ -2183,6 +2508,13 @@ static int snarf_iommu_devices(struct device *dev, const char *name)
 		goto err_rmdir;
 	}
 
+	if (!debugfs_create_file("profiling_suite", S_IRUSR, dir, ddev,
+				 &iommu_debug_profiling_suite_fops)) {
+		pr_err("Couldn't create iommu/devices/%s/profiling_suite debugfs file\n",
+		       name);
+		goto err_rmdir;
+	}
+
 	if (!debugfs_create_file("functional_fast_dma_api", S_IRUSR, dir, ddev,
 				 &iommu_debug_functional_fast_dma_api_fops)) {
 		pr_err("Couldn't create iommu/devices/%s/functional_fast_dma_api debugfs file\n",
@@ -2204,6 +2536,13 @@ static int snarf_iommu_devices(struct device *dev, const char *name)
 		goto err_rmdir;
 	}
 
+	if (!debugfs_create_file("fast_stats", S_IRUSR, dir, ddev,
+				 &iommu_debug_fast_stats_fops)) {
+		pr_err("Couldn't create iommu/devices/%s/fast_stats debugfs file\n",
+		       name);
+		goto err_rmdir;
+	}
+
 	if (!debugfs_create_file("attach", S_IRUSR, dir, ddev,
 				 &iommu_debug_attach_fops)) {
 		pr_err("Couldn't create iommu/devices/%s/attach debugfs file\n",
@@ -12,6 +12,8 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
 #include <linux/kref.h>
 #include <linux/slab.h>
 #include <linux/rbtree.h>
@@ -57,6 +59,10 @@ struct msm_iommu_meta {
 static struct rb_root iommu_root;
 static DEFINE_MUTEX(msm_iommu_map_mutex);
 
+/* Lookups that reused an existing mapping vs. created a new one */
+static atomic_t msm_iommu_map_hits;
+static atomic_t msm_iommu_map_misses;
+
 static void msm_iommu_meta_add(struct msm_iommu_meta *meta)
 {
 	struct rb_root *root = &iommu_root;
@@ -203,6 +209,7 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 			goto out_unlock;
 		}
 
+		atomic_inc(&msm_iommu_map_misses);
 		kref_init(&iommu_map->ref);
 		if (late_unmap)
 			kref_get(&iommu_map->ref);
@@ -216,6 +223,7 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 		sg->dma_address = iommu_map->sgl.dma_address;
 		sg->dma_length = iommu_map->sgl.dma_length;
 
+		atomic_inc(&msm_iommu_map_hits);
 		kref_get(&iommu_map->ref);
 		if (is_device_dma_coherent(dev))
 			/*
@@ -421,3 +429,17 @@ out:
 
 }
 
+static int __init msm_dma_iommu_mapping_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("msm_dma_iommu_mapping", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return 0;
+
+	debugfs_create_atomic_t("map_hits", 0444, root, &msm_iommu_map_hits);
+	debugfs_create_atomic_t("map_misses", 0444, root,
+				&msm_iommu_map_misses);
+	return 0;
+}
+late_initcall(msm_dma_iommu_mapping_debugfs_init);
@@ -16,6 +16,7 @@
 #include <linux/shrinker.h>
 #include <linux/module.h>
 #include <linux/rbtree.h>
+#include <linux/rculist.h>
 
 #define DM_MSG_PREFIX "bufio"
 
@@ -54,6 +55,15 @@
  */
 #define DM_BUFIO_INLINE_VECS		16
 
+/*
+ * Buffers are also linked to a hash table that dm_bufio_get and
+ * dm_bufio_read search under RCU, without the client lock.
+ */
+#define DM_BUFIO_HASH_BITS	12
+#define DM_BUFIO_HASH(block) \
+	((((block) >> DM_BUFIO_HASH_BITS) ^ (block)) & \
+	 ((1 << DM_BUFIO_HASH_BITS) - 1))
+
 /*
  * Don't try to use kmem_cache_alloc for blocks larger than this.
  * For explanation, see alloc_buffer_data below.
@@ -70,7 +80,8 @@
 
 /*
  * Linking of buffers:
- *	All buffers are linked to cache_hash with their hash_list field.
+ *	All buffers are linked to buffer_tree with their node field and to
+ *	buffer_hash with their hash_list field.
  *
  *	Clean buffers that are not being written (B_WRITING not set)
  *	are linked to lru[LIST_CLEAN] with their lru_list field.
@@ -106,7 +117,9 @@ struct dm_bufio_client {
 	unsigned minimum_buffers;
 
 	struct rb_root buffer_tree;
+	struct hlist_head *buffer_hash;
 	wait_queue_head_t free_buffer_wait;
+	atomic_t release_seq;	/* bumped when a hold is dropped locklessly */
 
 	int async_write_error;
 
@@ -133,14 +146,23 @@ enum data_mode {
 	DATA_MODE_LIMIT = 3
 };
 
+/*
+ * hold_count is -1 while an unheld buffer is being freed or reused, which
+ * makes the lockless lookup skip it.  Buffers hit by the lockless lookup
+ * are not moved in the LRU, they get "accessed" set instead and are moved
+ * to the LRU head when reclaim comes across them.
+ */
 struct dm_buffer {
 	struct rb_node node;
+	struct hlist_node hash_list;
+	struct rcu_head rcu;
 	struct list_head lru_list;
 	sector_t block;
 	void *data;
 	enum data_mode data_mode;
 	unsigned char list_mode;		/* LIST_* */
-	unsigned hold_count;
+	unsigned char accessed;
+	atomic_t hold_count;
 	int read_error;
 	int write_error;
 	unsigned long state;
@@ -445,6 +467,7 @@ static struct dm_buffer *alloc_buffer(struct dm_bufio_client *c, gfp_t gfp_mask)
 		return NULL;
 
 	b->c = c;
+	atomic_set(&b->hold_count, 0);
 
 	b->data = alloc_buffer_data(c, gfp_mask, &b->data_mode);
 	if (!b->data) {
@@ -467,7 +490,8 @@ static void free_buffer(struct dm_buffer *b)
 	adjust_total_allocated(b->data_mode, -(long)c->block_size);
 
 	free_buffer_data(c, b->data, b->data_mode);
-	kfree(b);
+	/* a lockless lookup may still be looking at the buffer */
+	kfree_rcu(b, rcu);
 }
 
 /*
@@ -482,6 +506,9 @@ static void __link_buffer(struct dm_buffer *b, sector_t block, int dirty)
 	b->list_mode = dirty;
 	list_add(&b->lru_list, &c->lru[dirty]);
 	__insert(b->c, b);
+	hlist_add_head_rcu(&b->hash_list,
+			   &c->buffer_hash[DM_BUFIO_HASH(block)]);
+	b->accessed = 0;
 	b->last_accessed = jiffies;
 }
 
@@ -496,6 +523,7 @@ static void __unlink_buffer(struct dm_buffer *b)
 
 	c->n_buffers[b->list_mode]--;
 	__remove(b->c, b);
+	hlist_del_rcu(&b->hash_list);
 	list_del(&b->lru_list);
 }
 
@@ -512,9 +540,52 @@ static void __relink_lru(struct dm_buffer *b, int dirty)
 	c->n_buffers[dirty]++;
 	b->list_mode = dirty;
 	list_move(&b->lru_list, &c->lru[dirty]);
+	b->accessed = 0;
 	b->last_accessed = jiffies;
 }
 
+/*
+ * If the buffer was hit by a lockless lookup since it was last moved in the
+ * LRU, give it the promotion it missed and return true.
+ */
+static bool __promote_accessed(struct dm_buffer *b)
+{
+	if (likely(!ACCESS_ONCE(b->accessed)))
+		return false;
+
+	__relink_lru(b, b->list_mode);
+	return true;
+}
+
+/*
+ * Take an unheld buffer away from lockless lookups before freeing or
+ * reusing it.
+ */
+static bool __claim_buffer(struct dm_buffer *b)
+{
+	return atomic_cmpxchg(&b->hold_count, 0, -1) == 0;
+}
+
+/*
+ * Wake up threads waiting in __wait_for_free_buffer after a hold was
+ * dropped without the client lock.
+ */
+static void dm_bufio_wake_waiters(struct dm_bufio_client *c)
+{
+	atomic_inc(&c->release_seq);
+	smp_mb__after_atomic();
+	if (waitqueue_active(&c->free_buffer_wait))
+		wake_up(&c->free_buffer_wait);
+}
+
+static unsigned dm_bufio_release_seq(struct dm_bufio_client *c)
+{
+	unsigned seq = atomic_read(&c->release_seq);
+
+	smp_rmb();
+	return seq;
+}
+
 /*----------------------------------------------------------------
  * Submit I/O on the buffer.
  *
@@ -731,7 +802,7 @@ static void __flush_write_list(struct list_head *write_list)
  */
 static void __make_buffer_clean(struct dm_buffer *b)
 {
-	BUG_ON(b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) > 0);
 
 	if (!b->state)	/* fast case */
 		return;
@@ -747,13 +818,14 @@ static void __make_buffer_clean(struct dm_buffer *b)
  */
 static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 {
-	struct dm_buffer *b;
+	struct dm_buffer *b, *tmp;
 
-	list_for_each_entry_reverse(b, &c->lru[LIST_CLEAN], lru_list) {
+	list_for_each_entry_safe_reverse(b, tmp, &c->lru[LIST_CLEAN], lru_list) {
 		BUG_ON(test_bit(B_WRITING, &b->state));
 		BUG_ON(test_bit(B_DIRTY, &b->state));
 
-		if (!b->hold_count) {
+		if (!atomic_read(&b->hold_count) && !__promote_accessed(b) &&
+		    __claim_buffer(b)) {
 			__make_buffer_clean(b);
 			__unlink_buffer(b);
 			return b;
@@ -761,10 +833,10 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 		dm_bufio_cond_resched();
 	}
 
-	list_for_each_entry_reverse(b, &c->lru[LIST_DIRTY], lru_list) {
+	list_for_each_entry_safe_reverse(b, tmp, &c->lru[LIST_DIRTY], lru_list) {
 		BUG_ON(test_bit(B_READING, &b->state));
 
-		if (!b->hold_count) {
+		if (__claim_buffer(b)) {
 			__make_buffer_clean(b);
 			__unlink_buffer(b);
 			return b;
@@ -777,12 +849,14 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 
 /*
  * Wait until some other threads free some buffer or release hold count on
- * some buffer.
+ * some buffer.  @seq is the release_seq sampled before the caller looked
+ * for a free buffer: holds dropped locklessly since then end the wait
+ * right away.
  *
  * This function is entered with c->lock held, drops it and regains it
  * before exiting.
  */
-static void __wait_for_free_buffer(struct dm_bufio_client *c)
+static void __wait_for_free_buffer(struct dm_bufio_client *c, unsigned seq)
 {
 	DECLARE_WAITQUEUE(wait, current);
 
@@ -790,7 +864,10 @@ static void __wait_for_free_buffer(struct dm_bufio_client *c)
 	set_task_state(current, TASK_UNINTERRUPTIBLE);
 	dm_bufio_unlock(c);
 
-	io_schedule();
+	if (atomic_read(&c->release_seq) == seq)
+		io_schedule();
+	else
+		__set_current_state(TASK_RUNNING);
 
 	remove_wait_queue(&c->free_buffer_wait, &wait);
 
@@ -814,6 +891,7 @@ static struct dm_buffer *__alloc_buffer_wait_no_callback(struct dm_bufio_client
 {
 	struct dm_buffer *b;
 	bool tried_noio_alloc = false;
+	unsigned seq;
 
 	/*
 	 * dm-bufio is resistant to allocation failures (it just keeps
@@ -829,6 +907,8 @@ static struct dm_buffer *__alloc_buffer_wait_no_callback(struct dm_bufio_client
 	 * be allocated.
 	 */
 	while (1) {
+		seq = dm_bufio_release_seq(c);
+
 		if (dm_bufio_cache_size_latch != 1) {
 			b = alloc_buffer(c, GFP_NOWAIT | __GFP_NORETRY | __GFP_NOMEMALLOC | __GFP_NOWARN);
 			if (b)
@@ -860,7 +940,7 @@ static struct dm_buffer *__alloc_buffer_wait_no_callback(struct dm_bufio_client
 		if (b)
 			return b;
 
-		__wait_for_free_buffer(c);
+		__wait_for_free_buffer(c, seq);
 	}
 }
 
@@ -1006,19 +1086,19 @@ static struct dm_buffer *__bufio_new(struct dm_bufio_client *c, sector_t block,
 
 	__check_watermark(c, write_list);
 
+	/*
+	 * Set everything up before the hold count makes the buffer usable
+	 * for lockless lookups.
+	 */
 	b = new_b;
-	b->hold_count = 1;
 	b->read_error = 0;
 	b->write_error = 0;
+	b->state = nf == NF_FRESH ? 0 : 1 << B_READING;
 	__link_buffer(b, block, LIST_CLEAN);
+	smp_wmb();
+	atomic_set(&b->hold_count, 1);
 
-	if (nf == NF_FRESH) {
-		b->state = 0;
-		return b;
-	}
-
-	b->state = 1 << B_READING;
-	*need_submit = 1;
+	*need_submit = nf != NF_FRESH;
 
 	return b;
 
@@ -1035,12 +1115,48 @@ found_buffer:
 	if (nf == NF_GET && unlikely(test_bit(B_READING, &b->state)))
 		return NULL;
 
-	b->hold_count++;
+	atomic_inc(&b->hold_count);
 	__relink_lru(b, test_bit(B_DIRTY, &b->state) ||
 		     test_bit(B_WRITING, &b->state));
 	return b;
 }
 
+/*
+ * Look up a cached buffer and take a hold on it without the client lock.
+ * Returns NULL if the buffer isn't cached or is being freed or reused, the
+ * caller then falls back to __bufio_new.
+ */
+static struct dm_buffer *dm_bufio_find_fast(struct dm_bufio_client *c,
+					    sector_t block)
+{
+	struct dm_buffer *b;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(b, &c->buffer_hash[DM_BUFIO_HASH(block)],
+				 hash_list) {
+		if (b->block != block)
+			continue;
+
+		if (!atomic_inc_unless_negative(&b->hold_count))
+			break;
+
+		/* the buffer may have been reused for another block */
+		if (unlikely(b->block != block)) {
+			rcu_read_unlock();
+			dm_bufio_release(b);
+			return NULL;
+		}
+
+		if (!ACCESS_ONCE(b->accessed))
+			ACCESS_ONCE(b->accessed) = 1;
+		rcu_read_unlock();
+		return b;
+	}
+	rcu_read_unlock();
+
+	return NULL;
+}
+
 /*
  * The endio routine for reading: set the error, clear the bit and wake up
  * anyone waiting on the buffer.
@@ -1074,6 +1190,19 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 
 	LIST_HEAD(write_list);
 
+	if (nf == NF_GET || nf == NF_READ) {
+		b = dm_bufio_find_fast(c, block);
+		if (b) {
+			/* see the comment in __bufio_new */
+			if (nf == NF_GET &&
+			    unlikely(test_bit(B_READING, &b->state))) {
+				dm_bufio_release(b);
+				return NULL;
+			}
+			goto wait_read;
+		}
+	}
+
 	dm_bufio_lock(c);
 	b = __bufio_new(c, block, nf, &need_submit, &write_list);
 	dm_bufio_unlock(c);
@@ -1086,6 +1215,7 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 	if (need_submit)
 		submit_io(b, READ, b->block, read_endio);
 
+wait_read:
 	wait_on_bit_io(&b->state, B_READING, TASK_UNINTERRUPTIBLE);
 
 	if (b->read_error) {
@@ -1176,12 +1306,24 @@ void dm_bufio_release(struct dm_buffer *b)
 {
 	struct dm_bufio_client *c = b->c;
 
+	/*
+	 * Only the last hold on a buffer with errors needs the lock, to
+	 * get rid of the buffer.
+	 */
+	if (atomic_add_unless(&b->hold_count, -1, 1))
+		return;
+
+	if (likely(!b->read_error && !b->write_error)) {
+		if (atomic_dec_and_test(&b->hold_count))
+			dm_bufio_wake_waiters(c);
+		return;
+	}
+
 	dm_bufio_lock(c);
 
-	BUG_ON(!b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) <= 0);
 
-	b->hold_count--;
-	if (!b->hold_count) {
+	if (atomic_dec_and_test(&b->hold_count)) {
 		wake_up(&c->free_buffer_wait);
 
 		/*
@@ -1192,7 +1334,8 @@ void dm_bufio_release(struct dm_buffer *b)
 		if ((b->read_error || b->write_error) &&
 		    !test_bit(B_READING, &b->state) &&
 		    !test_bit(B_WRITING, &b->state) &&
-		    !test_bit(B_DIRTY, &b->state)) {
+		    !test_bit(B_DIRTY, &b->state) &&
+		    __claim_buffer(b)) {
 			__unlink_buffer(b);
 			__free_buffer_wake(b);
 		}
@@ -1263,12 +1406,12 @@ again:
 		if (test_bit(B_WRITING, &b->state)) {
 			if (buffers_processed < c->n_buffers[LIST_DIRTY]) {
 				dropped_lock = 1;
-				b->hold_count++;
+				atomic_inc(&b->hold_count);
 				dm_bufio_unlock(c);
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
 				dm_bufio_lock(c);
-				b->hold_count--;
+				atomic_dec(&b->hold_count);
 			} else
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
@@ -1348,16 +1491,18 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 {
 	struct dm_bufio_client *c = b->c;
 	struct dm_buffer *new;
+	unsigned seq;
 
 	BUG_ON(dm_bufio_in_request());
 
 	dm_bufio_lock(c);
 
 retry:
+	seq = dm_bufio_release_seq(c);
 	new = __find(c, new_block);
 	if (new) {
-		if (new->hold_count) {
-			__wait_for_free_buffer(c);
+		if (!__claim_buffer(new)) {
+			__wait_for_free_buffer(c, seq);
 			goto retry;
 		}
 
@@ -1370,11 +1515,11 @@ retry:
 		__free_buffer_wake(new);
 	}
 
-	BUG_ON(!b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) <= 0);
 	BUG_ON(test_bit(B_READING, &b->state));
 
 	__write_dirty_buffer(b, NULL);
-	if (b->hold_count == 1) {
+	if (atomic_read(&b->hold_count) == 1) {
 		wait_on_bit_io(&b->state, B_WRITING,
 			       TASK_UNINTERRUPTIBLE);
 		set_bit(B_DIRTY, &b->state);
@@ -1419,7 +1564,7 @@ void dm_bufio_forget(struct dm_bufio_client *c, sector_t block)
 	dm_bufio_lock(c);
 
 	b = __find(c, block);
-	if (b && likely(!b->hold_count) && likely(!b->state)) {
+	if (b && likely(!b->state) && __claim_buffer(b)) {
 		__unlink_buffer(b);
 		__free_buffer_wake(b);
 	}
@@ -1490,8 +1635,9 @@ static void drop_buffers(struct dm_bufio_client *c)
 
 	for (i = 0; i < LIST_SIZE; i++)
 		list_for_each_entry(b, &c->lru[i], lru_list)
-			DMERR("leaked buffer %llx, hold count %u, list %d",
-			      (unsigned long long)b->block, b->hold_count, i);
+			DMERR("leaked buffer %llx, hold count %d, list %d",
+			      (unsigned long long)b->block,
+			      atomic_read(&b->hold_count), i);
 
 	for (i = 0; i < LIST_SIZE; i++)
 		BUG_ON(!list_empty(&c->lru[i]));
@@ -1516,7 +1662,8 @@ static bool __try_evict_buffer(struct dm_buffer *b, gfp_t gfp)
 			return false;
 	}
 
-	if (b->hold_count)
+	if (atomic_read(&b->hold_count) || __promote_accessed(b) ||
+	    !__claim_buffer(b))
 		return false;
 
 	__make_buffer_clean(b);
@@ -1604,6 +1751,12 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	}
 	c->buffer_tree = RB_ROOT;
 
+	c->buffer_hash = vzalloc(sizeof(struct hlist_head) << DM_BUFIO_HASH_BITS);
+	if (!c->buffer_hash) {
+		r = -ENOMEM;
+		goto bad_hash;
+	}
+
 	c->bdev = bdev;
 	c->block_size = block_size;
 	c->sectors_per_block_bits = __ffs(block_size) - SECTOR_SHIFT;
@@ -1628,6 +1781,7 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	c->minimum_buffers = DM_BUFIO_MIN_BUFFERS;
 
 	init_waitqueue_head(&c->free_buffer_wait);
+	atomic_set(&c->release_seq, 0);
 	c->async_write_error = 0;
 
 	c->dm_io = dm_io_client_create();
@@ -1694,6 +1848,8 @@ bad_cache:
 	}
 	dm_io_client_destroy(c->dm_io);
 bad_dm_io:
+	vfree(c->buffer_hash);
+bad_hash:
 	kfree(c);
 bad_client:
 	return ERR_PTR(r);
@@ -1738,6 +1894,7 @@ void dm_bufio_client_destroy(struct dm_bufio_client *c)
 		BUG_ON(c->n_buffers[i]);
 
 	dm_io_client_destroy(c->dm_io);
+	vfree(c->buffer_hash);
 	kfree(c);
 }
 EXPORT_SYMBOL_GPL(dm_bufio_client_destroy);
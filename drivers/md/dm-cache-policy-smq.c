@@ -790,6 +790,12 @@ struct smq_policy {
 	unsigned long *hotspot_hit_bits;
 	unsigned long *cache_hit_bits;
 
+	/*
+	 * Hotspot blocks userspace told us are about to be read, read
+	 * misses to them are promoted regardless of their level.
+	 */
+	unsigned long *hotspot_hint_bits;
+
 	/*
 	 * We maintain three queues of entries.  The cache proper,
 	 * consisting of a clean and dirty queue, containing the currently
@@ -1147,7 +1153,9 @@ static enum promote_result should_promote(struct smq_policy *mq, struct entry *h
 		else
 			return maybe_promote(hs_e->level >= mq->write_promote_level);
 	} else
-		return maybe_promote(hs_e->level >= mq->read_promote_level);
+		return maybe_promote(hs_e->level >= mq->read_promote_level ||
+				     test_bit(get_index(&mq->hotspot_alloc, hs_e),
+					      mq->hotspot_hint_bits));
 }
 
 static void insert_in_cache(struct smq_policy *mq, dm_oblock_t oblock,
@@ -1187,6 +1195,35 @@ static dm_oblock_t to_hblock(struct smq_policy *mq, dm_oblock_t b)
 	return to_oblock(r);
 }
 
+/*
+ * Starts tracking hotspot block hb, recycling the coldest entry if the
+ * hotspot queue is full.
+ */
+static struct entry *insert_hotspot(struct smq_policy *mq, dm_oblock_t hb)
+{
+	unsigned hi;
+	struct entry *e = alloc_entry(&mq->hotspot_alloc);
+
+	if (!e) {
+		e = q_pop(&mq->hotspot);
+		if (e) {
+			h_remove(&mq->hotspot_table, e);
+			hi = get_index(&mq->hotspot_alloc, e);
+			clear_bit(hi, mq->hotspot_hit_bits);
+			clear_bit(hi, mq->hotspot_hint_bits);
+		}
+
+	}
+
+	if (e) {
+		e->oblock = hb;
+		q_push(&mq->hotspot, e);
+		h_insert(&mq->hotspot_table, e);
+	}
+
+	return e;
+}
+
 static struct entry *update_hotspot_queue(struct smq_policy *mq, dm_oblock_t b, struct bio *bio)
 {
 	unsigned hi;
@@ -1203,26 +1240,41 @@ static struct entry *update_hotspot_queue(struct smq_policy *mq, dm_oblock_t b,
 
 	} else {
 		stats_miss(&mq->hotspot_stats);
+		e = insert_hotspot(mq, hb);
+	}
 
-		e = alloc_entry(&mq->hotspot_alloc);
-		if (!e) {
-			e = q_pop(&mq->hotspot);
-			if (e) {
-				h_remove(&mq->hotspot_table, e);
-				hi = get_index(&mq->hotspot_alloc, e);
-				clear_bit(hi, mq->hotspot_hit_bits);
-			}
+	return e;
+}
 
-		}
+/*
+ * Userspace knows which files are about to be read, eg. the code of an
+ * app living on an sd card that is being launched.  The hotspot blocks
+ * covering [begin, end) move to the top level, where they are the last
+ * to be recycled, and are flagged so their read misses get promoted
+ * without first having to warm up.
+ */
+static void hint_hotspot_range(struct smq_policy *mq, dm_oblock_t begin,
+			       dm_oblock_t end)
+{
+	dm_oblock_t hb = to_hblock(mq, begin);
+	dm_oblock_t hend = to_hblock(mq, to_oblock(from_oblock(end) - 1));
+	unsigned n;
+	struct entry *e;
 
-		if (e) {
-			e->oblock = hb;
-			q_push(&mq->hotspot, e);
-			h_insert(&mq->hotspot_table, e);
-		}
-	}
+	for (n = 0; n < mq->nr_hotspot_blocks &&
+	     from_oblock(hb) <= from_oblock(hend);
+	     n++, hb = to_oblock(from_oblock(hb) + 1)) {
+		e = h_lookup(&mq->hotspot_table, hb);
+		if (!e)
+			e = insert_hotspot(mq, hb);
+		if (!e)
+			break;
 
-	return e;
+		q_del(&mq->hotspot, e);
+		e->level = mq->hotspot.nr_levels - 1u;
+		q_push(&mq->hotspot, e);
+		set_bit(get_index(&mq->hotspot_alloc, e), mq->hotspot_hint_bits);
+	}
 }
 
 /*
@@ -1284,6 +1336,7 @@ static void smq_destroy(struct dm_cache_policy *p)
 
 	h_exit(&mq->hotspot_table);
 	h_exit(&mq->table);
+	free_bitset(mq->hotspot_hint_bits);
 	free_bitset(mq->hotspot_hit_bits);
 	free_bitset(mq->cache_hit_bits);
 	space_exit(&mq->es);
@@ -1554,6 +1607,37 @@ static dm_cblock_t smq_residency(struct dm_cache_policy *p)
 	return r;
 }
 
+/*
+ * Supports "promote_oblocks <begin>[-<end>]", the end being exclusive as
+ * for the target's invalidate_cblocks message.
+ */
+static int smq_set_config_value(struct dm_cache_policy *p,
+				 const char *key, const char *value)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+	unsigned long long b, e;
+	unsigned long flags;
+	char dummy;
+
+	if (strcasecmp(key, "promote_oblocks"))
+		return -EINVAL;
+
+	if (sscanf(value, "%llu-%llu%c", &b, &e, &dummy) != 2) {
+		if (sscanf(value, "%llu%c", &b, &dummy) != 1)
+			return -EINVAL;
+		e = b + 1;
+	}
+
+	if (e <= b)
+		return -EINVAL;
+
+	spin_lock_irqsave(&mq->lock, flags);
+	hint_hotspot_range(mq, to_oblock(b), to_oblock(e));
+	spin_unlock_irqrestore(&mq->lock, flags);
+
+	return 0;
+}
+
 static void smq_tick(struct dm_cache_policy *p, bool can_block)
 {
 	struct smq_policy *mq = to_smq_policy(p);
@@ -1583,6 +1667,7 @@ static void init_policy_functions(struct smq_policy *mq)
 	mq->policy.force_mapping = smq_force_mapping;
 	mq->policy.residency = smq_residency;
 	mq->policy.tick = smq_tick;
+	mq->policy.set_config_value = smq_set_config_value;
 }
 
 static bool too_many_hotspot_blocks(sector_t origin_size,
@@ -1654,6 +1739,13 @@ static struct dm_cache_policy *smq_create(dm_cblock_t cache_size,
 	}
 	clear_bitset(mq->hotspot_hit_bits, mq->nr_hotspot_blocks);
 
+	mq->hotspot_hint_bits = alloc_bitset(mq->nr_hotspot_blocks);
+	if (!mq->hotspot_hint_bits) {
+		DMERR("couldn't allocate hotspot hint bitset");
+		goto bad_hotspot_hint_bits;
+	}
+	clear_bitset(mq->hotspot_hint_bits, mq->nr_hotspot_blocks);
+
 	if (from_cblock(cache_size)) {
 		mq->cache_hit_bits = alloc_bitset(from_cblock(cache_size));
 		if (!mq->cache_hit_bits) {
@@ -1697,6 +1789,8 @@ bad_alloc_hotspot_table:
 bad_alloc_table:
 	free_bitset(mq->cache_hit_bits);
 bad_cache_hit_bits:
+	free_bitset(mq->hotspot_hint_bits);
+bad_hotspot_hint_bits:
 	free_bitset(mq->hotspot_hit_bits);
 bad_hotspot_hit_bits:
 	space_exit(&mq->es);
@@ -1710,7 +1804,7 @@ bad_pool_init:
 
 static struct dm_cache_policy_type smq_policy_type = {
 	.name = "smq",
-	.version = {1, 0, 0},
+	.version = {1, 1, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = smq_create
@@ -1718,7 +1812,7 @@ static struct dm_cache_policy_type smq_policy_type = {
 
 static struct dm_cache_policy_type default_policy_type = {
 	.name = "default",
-	.version = {1, 4, 0},
+	.version = {1, 5, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = smq_create,
@@ -261,6 +261,13 @@ struct cache {
 	struct list_head need_commit_migrations;
 	sector_t migration_threshold;
 	wait_queue_head_t migration_wait;
+
+	/*
+	 * Interval between metadata commits, and whether writeback is held
+	 * back to the critical minimum (eg. while running on battery).
+	 */
+	unsigned long commit_period;
+	bool lazy_writeback;
 	atomic_t nr_allocated_migrations;
 
 	/*
@@ -1911,7 +1918,7 @@ static void process_bio(struct cache *cache, struct prealloc *structs,
 static int need_commit_due_to_time(struct cache *cache)
 {
 	return jiffies < cache->last_commit_jiffies ||
-	       jiffies > cache->last_commit_jiffies + COMMIT_PERIOD;
+	       jiffies > cache->last_commit_jiffies + cache->commit_period;
 }
 
 /*
@@ -2074,7 +2081,8 @@ static void writeback_some_dirty_blocks(struct cache *cache)
 	dm_cblock_t cblock;
 	struct prealloc structs;
 	struct dm_bio_prison_cell *old_ocell;
-	bool busy = !iot_idle_for(&cache->origin_tracker, HZ);
+	bool busy = cache->lazy_writeback ||
+		    !iot_idle_for(&cache->origin_tracker, HZ);
 
 	memset(&structs, 0, sizeof(structs));
 
@@ -2658,6 +2666,22 @@ static int process_config_option(struct cache *cache, const char *key, const cha
 		return 0;
 	}
 
+	if (!strcasecmp(key, "commit_period_ms")) {
+		if (kstrtoul(value, 10, &tmp) || !tmp)
+			return -EINVAL;
+
+		cache->commit_period = msecs_to_jiffies(tmp);
+		return 0;
+	}
+
+	if (!strcasecmp(key, "lazy_writeback")) {
+		if (kstrtoul(value, 10, &tmp) || tmp > 1)
+			return -EINVAL;
+
+		cache->lazy_writeback = tmp;
+		return 0;
+	}
+
 	return NOT_CORE_OPTION;
 }
 
@@ -2816,6 +2840,7 @@ static int cache_create(struct cache_args *ca, struct cache **result)
 
 	cache->policy_nr_args = ca->policy_argc;
 	cache->migration_threshold = DEFAULT_MIGRATION_THRESHOLD;
+	cache->commit_period = COMMIT_PERIOD;
 
 	r = set_config_values(cache, ca->policy_argc, ca->policy_argv);
 	if (r) {
@@ -3580,7 +3605,15 @@ static void cache_status(struct dm_target *ti, status_type_t type,
 			goto err;
 		}
 
-		DMEMIT("2 migration_threshold %llu ", (unsigned long long) cache->migration_threshold);
+		DMEMIT("%u migration_threshold %llu ",
+		       2 + (cache->commit_period != COMMIT_PERIOD ? 2 : 0) +
+		       (cache->lazy_writeback ? 2 : 0),
+		       (unsigned long long) cache->migration_threshold);
+		if (cache->commit_period != COMMIT_PERIOD)
+			DMEMIT("commit_period_ms %u ",
+			       jiffies_to_msecs(cache->commit_period));
+		if (cache->lazy_writeback)
+			DMEMIT("lazy_writeback 1 ");
 
 		DMEMIT("%s ", dm_cache_policy_get_name(cache->policy));
 		if (sz < maxlen) {
@@ -3752,7 +3785,8 @@ static int process_invalidate_cblocks_message(struct cache *cache, unsigned coun
  * and
  *     "invalidate_cblocks [(<begin>)|(<begin>-<end>)]*
  *
- * The key migration_threshold is supported by the cache target core.
+ * The keys migration_threshold, commit_period_ms and lazy_writeback are
+ * supported by the cache target core.
  */
 static int cache_message(struct dm_target *ti, unsigned argc, char **argv)
 {
@@ -3820,7 +3854,7 @@ static void cache_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type cache_target = {
 	.name = "cache",
-	.version = {1, 8, 0},
+	.version = {1, 9, 0},
 	.module = THIS_MODULE,
 	.ctr = cache_ctr,
 	.dtr = cache_dtr,
@@ -112,7 +112,8 @@ struct iv_tcw_private {
  * and encrypts / decrypts at the same time.
  */
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
-	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD };
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
+	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE };
 
 /*
  * The fields in here must be read only after initialization.
@@ -883,7 +884,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
 
 static void crypt_alloc_req(struct crypt_config *cc,
-			    struct convert_context *ctx)
+			    struct convert_context *ctx, bool atomic)
 {
 	unsigned key_index = ctx->cc_sector & (cc->tfms_count - 1);
 
@@ -897,7 +898,8 @@ static void crypt_alloc_req(struct crypt_config *cc,
 	 * requests if driver request queue is full.
 	 */
 	ablkcipher_request_set_callback(ctx->req,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	    CRYPTO_TFM_REQ_MAY_BACKLOG |
+	    (atomic ? 0 : CRYPTO_TFM_REQ_MAY_SLEEP),
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->req));
 }
 
@@ -911,10 +913,13 @@ static void crypt_free_req(struct crypt_config *cc,
 }
 
 /*
- * Encrypt / decrypt data from one bio to another one (can be the same one)
+ * Encrypt / decrypt data from one bio to another one (can be the same one).
+ * With atomic set the caller cannot sleep, which is only allowed for
+ * synchronous ciphers: they never return -EBUSY and always complete on
+ * the request embedded in the per-bio data.
  */
 static int crypt_convert(struct crypt_config *cc,
-			 struct convert_context *ctx)
+			 struct convert_context *ctx, bool atomic)
 {
 	int r;
 
@@ -922,7 +927,7 @@ static int crypt_convert(struct crypt_config *cc,
 
 	while (ctx->iter_in.bi_size && ctx->iter_out.bi_size) {
 
-		crypt_alloc_req(cc, ctx);
+		crypt_alloc_req(cc, ctx, atomic);
 
 		atomic_inc(&ctx->cc_pending);
 
@@ -951,7 +956,8 @@ static int crypt_convert(struct crypt_config *cc,
 		case 0:
 			atomic_dec(&ctx->cc_pending);
 			ctx->cc_sector++;
-			cond_resched();
+			if (!atomic)
+				cond_resched();
 			continue;
 
 		/* There was an error while processing the request. */
@@ -1313,7 +1319,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, false);
 	if (r)
 		io->error = -EIO;
 	crypt_finished = atomic_dec_and_test(&io->ctx.cc_pending);
@@ -1333,7 +1339,7 @@ static void kcryptd_crypt_read_done(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
-static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
+static void kcryptd_crypt_read_convert(struct dm_crypt_io *io, bool atomic)
 {
 	struct crypt_config *cc = io->cc;
 	int r = 0;
@@ -1343,7 +1349,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, atomic);
 	if (r < 0)
 		io->error = -EIO;
 
@@ -1393,7 +1399,7 @@ static void kcryptd_crypt(struct work_struct *work)
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
 
 	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_crypt_read_convert(io);
+		kcryptd_crypt_read_convert(io, false);
 	else
 		kcryptd_crypt_write_convert(io);
 }
@@ -1402,6 +1408,24 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
 
+	/*
+	 * Reads are queued from crypt_endio(), usually in softirq context,
+	 * so decrypting inline must not sleep. Writes are queued from
+	 * crypt_map() in the submitter's context. Hard irq context is
+	 * always deferred: the cipher walks the pages with kmap_atomic()
+	 * and may use the FPU.
+	 */
+	if (bio_data_dir(io->base_bio) == READ) {
+		if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags) &&
+		    !in_irq() && !irqs_disabled()) {
+			kcryptd_crypt_read_convert(io, true);
+			return;
+		}
+	} else if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags)) {
+		kcryptd_crypt_write_convert(io);
+		return;
+	}
+
 	INIT_WORK(&io->work, kcryptd_crypt);
 	queue_work(cc->crypt_queue, &io->work);
 }
@@ -1741,7 +1765,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 3, "Invalid number of feature args"},
+		{0, 5, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1856,6 +1880,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 				set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 
+			else if (!strcasecmp(opt_string, "no_read_workqueue"))
+				set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+
+			else if (!strcasecmp(opt_string, "no_write_workqueue"))
+				set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+
 			else {
 				ti->error = "Invalid feature arguments";
 				goto bad;
@@ -1863,6 +1893,14 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		}
 	}
 
+	/* an asynchronous cipher may sleep on a full queue */
+	if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags) &&
+	    crypto_ablkcipher_tfm(any_tfm(cc))->__crt_alg->cra_flags &
+	    CRYPTO_ALG_ASYNC) {
+		DMWARN("no_read_workqueue ignored with an asynchronous cipher");
+		clear_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+	}
+
 	ret = -ENOMEM;
 	cc->io_queue = alloc_workqueue("kcryptd_io",
 				       WQ_HIGHPRI |
@@ -1982,6 +2020,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
 		if (num_feature_args) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -1990,6 +2030,10 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_read_workqueue");
+			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_write_workqueue");
 		}
 
 		break;
@@ -2083,7 +2127,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 14, 1},
+	.version = {1, 15, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
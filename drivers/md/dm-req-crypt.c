@@ -12,6 +12,7 @@
 #include <linux/completion.h>
 #include <linux/err.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/bio.h>
@@ -65,11 +66,26 @@
 
 #define DM_REQ_CRYPT_QUEUE_SIZE 256
 
+/*
+ * Completion shared by all the cipher requests of one dm request: @pending
+ * holds one reference per request in flight plus one for the submitter, the
+ * completion fires when the last one is dropped.  @err keeps the first error.
+ */
 struct req_crypt_result {
 	struct completion completion;
+	atomic_t pending;
 	int err;
 };
 
+/*
+ * Per engine occupancy, reported through the engine_stats module parameter.
+ */
+struct req_crypt_engine_stats {
+	atomic_t inflight;
+	atomic_long_t submitted;
+	atomic_long_t bytes;
+};
+
 #define FDE_KEY_ID	0
 #define PFE_KEY_ID	1
 
@@ -78,7 +94,6 @@ static struct kmem_cache *_req_crypt_io_pool;
 static struct kmem_cache *_req_dm_scatterlist_pool;
 static sector_t start_sector_orig;
 static struct workqueue_struct *req_crypt_queue;
-static struct workqueue_struct *req_crypt_split_io_queue;
 static mempool_t *req_io_pool;
 static mempool_t *req_page_pool;
 static mempool_t *req_scatterlist_pool;
@@ -91,6 +106,7 @@ unsigned int num_engines;
 unsigned int num_engines_fde, fde_cursor;
 unsigned int num_engines_pfe, pfe_cursor;
 struct crypto_engine_entry *fde_eng, *pfe_eng;
+static struct req_crypt_engine_stats *fde_eng_stats, *pfe_eng_stats;
 DEFINE_MUTEX(engine_list_mutex);
 
 struct req_dm_crypt_io {
@@ -106,10 +122,11 @@ struct req_dm_crypt_io {
 };
 
 struct req_dm_split_req_io {
-	struct work_struct work;
+	struct ablkcipher_request *req;
 	struct scatterlist *req_split_sg_read;
-	struct req_crypt_result result;
+	struct req_crypt_result *result;
 	struct crypto_engine_entry *engine;
+	struct req_crypt_engine_stats *stats;
 	u8 IV[AES_XTS_IV_LEN];
 	int size;
 	struct request *clone;
@@ -127,12 +144,36 @@ static struct qcrypto_func_set dm_qcrypto_func = {
 #endif
 static void req_crypt_cipher_complete
 		(struct crypto_async_request *req, int err);
-static void req_cryptd_split_req_queue_cb
-		(struct work_struct *work);
-static void req_cryptd_split_req_queue
-		(struct req_dm_split_req_io *io);
 static void req_crypt_split_io_complete
-		(struct req_crypt_result *res, int err);
+		(struct crypto_async_request *req, int err);
+
+static void req_crypt_result_init(struct req_crypt_result *res)
+{
+	init_completion(&res->completion);
+	atomic_set(&res->pending, 1);
+	res->err = 0;
+}
+
+static void req_crypt_result_put(struct req_crypt_result *res, int err)
+{
+	if (err)
+		cmpxchg(&res->err, 0, err);
+	if (atomic_dec_and_test(&res->pending))
+		complete(&res->completion);
+}
+
+static void req_crypt_engine_start(struct req_crypt_engine_stats *stats,
+				   unsigned int bytes)
+{
+	atomic_inc(&stats->inflight);
+	atomic_long_inc(&stats->submitted);
+	atomic_long_add(bytes, &stats->bytes);
+}
+
+static void req_crypt_engine_done(struct req_crypt_engine_stats *stats)
+{
+	atomic_dec(&stats->inflight);
+}
 
 static  bool req_crypt_should_encrypt(struct req_dm_crypt_io *req)
 {
@@ -267,6 +308,66 @@ static void req_crypt_dec_pending_decrypt(struct req_dm_crypt_io *io)
  * The callback that will be called by the worker queue to perform Decryption
  * for reads and use the dm function to complete the bios and requests.
  */
+/*
+ * Hand one piece of a read to its engine without waiting for it, so that all
+ * the pieces of a request are in flight on different engines at once.  The
+ * piece drops its reference on the shared result when it completes.
+ */
+static void req_crypt_submit_split(struct req_dm_split_req_io *io)
+{
+	struct crypto_engine_entry *engine = io->engine;
+	int err;
+
+	atomic_inc(&io->result->pending);
+
+	io->req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!io->req) {
+		DMERR("%s ablkcipher request allocation failed\n", __func__);
+		req_crypt_result_put(io->result, DM_REQ_CRYPT_ERROR);
+		return;
+	}
+
+	ablkcipher_request_set_callback(io->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					req_crypt_split_io_complete, io);
+
+	err = (dm_qcrypto_func.cipher_set)(io->req, engine->ce_device,
+			engine->hw_instance);
+	if (err) {
+		DMERR("%s qcrypto_cipher_set_device_hw failed with err %d\n",
+				__func__, err);
+		req_crypt_result_put(io->result, DM_REQ_CRYPT_ERROR);
+		return;
+	}
+	(dm_qcrypto_func.cipher_flag)(io->req,
+		QCRYPTO_CTX_USE_PIPE_KEY | QCRYPTO_CTX_XTS_DU_SIZE_512B);
+
+	ablkcipher_request_set_crypt(io->req, io->req_split_sg_read,
+			io->req_split_sg_read, io->size, (void *) io->IV);
+
+	req_crypt_engine_start(io->stats, io->size);
+	err = crypto_ablkcipher_decrypt(io->req);
+	switch (err) {
+	case -EBUSY:
+		/* backlogged, the callback will still be invoked */
+	case -EINPROGRESS:
+		break;
+
+	default:
+		if (err)
+			DMERR("%s error = %d decrypting the request\n",
+				 __func__, err);
+		req_crypt_engine_done(io->stats);
+		req_crypt_result_put(io->result, err ? DM_REQ_CRYPT_ERROR : 0);
+		break;
+	}
+}
+
+/*
+ * The callback that will be called by the worker queue to perform Decryption
+ * for reads. Requests of at least MIN_CRYPTO_TRANSFER_SIZE per engine are
+ * split so that every engine works on a share of it concurrently, smaller
+ * ones go to the engines in turn.
+ */
 static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 {
 	struct request *clone = NULL;
@@ -275,9 +376,11 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 	struct scatterlist *sg = NULL;
 	struct scatterlist *req_sg_read = NULL;
 
-	unsigned int engine_list_total = 0;
+	unsigned int engine_list_total = 0, nr_split = 1, first_engine = 0;
 	struct crypto_engine_entry *curr_engine_list = NULL;
-	bool split_transfers = 0;
+	struct req_crypt_engine_stats *curr_stats = NULL;
+	unsigned int *engine_cursor = NULL;
+	struct req_crypt_result result;
 	sector_t tempiv;
 	struct req_dm_split_req_io *split_io = NULL;
 
@@ -310,6 +413,32 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 						   (io->key_id == PFE_KEY_ID ?
 							pfe_eng : NULL));
 
+	curr_stats = (io->key_id == FDE_KEY_ID ? fde_eng_stats :
+						(io->key_id == PFE_KEY_ID ?
+						pfe_eng_stats : NULL));
+
+	engine_cursor = (io->key_id == FDE_KEY_ID ? &fde_cursor :
+					(io->key_id == PFE_KEY_ID ? &pfe_cursor
+					: NULL));
+	if ((engine_list_total < 1) || (NULL == curr_engine_list)
+	   || (NULL == engine_cursor)) {
+		DMERR("%s Unknown Key ID!\n",
+						   __func__);
+		error = DM_REQ_CRYPT_ERROR;
+		mutex_unlock(&engine_list_mutex);
+		goto ablkcipher_req_alloc_failure;
+	}
+
+	if ((clone->__data_len >= (MIN_CRYPTO_TRANSFER_SIZE *
+		engine_list_total))
+		&& (engine_list_total > 1))
+		nr_split = engine_list_total;
+
+	/* unsplit requests are spread over the engines like writes are */
+	first_engine = *engine_cursor;
+	(*engine_cursor) += nr_split;
+	(*engine_cursor) %= engine_list_total;
+
 	mutex_unlock(&engine_list_mutex);
 
 	req_sg_read = (struct scatterlist *)mempool_alloc(req_scatterlist_pool,
@@ -337,84 +466,63 @@ static void req_cryptd_crypt_read_convert(struct req_dm_crypt_io *io)
 		goto ablkcipher_req_alloc_failure;
 	}
 
+	split_io = kzalloc(sizeof(struct req_dm_split_req_io) * nr_split,
+			GFP_KERNEL);
+	if (!split_io) {
+		DMERR("%s split_io allocation failed\n", __func__);
+		error = DM_REQ_CRYPT_ERROR;
+		goto ablkcipher_req_alloc_failure;
+	}
 
-	if ((clone->__data_len >= (MIN_CRYPTO_TRANSFER_SIZE *
-		engine_list_total))
-		&& (engine_list_total > 1))
-		split_transfers = 1;
-
-	if (split_transfers) {
-		split_io = kzalloc(sizeof(struct req_dm_split_req_io)
-				* engine_list_total, GFP_KERNEL);
-		if (!split_io) {
-			DMERR("%s split_io allocation failed\n", __func__);
-			error = DM_REQ_CRYPT_ERROR;
-			goto ablkcipher_req_alloc_failure;
-		}
-
-		split_io[0].req_split_sg_read = sg = req_sg_read;
-		split_io[engine_list_total - 1].size = total_bytes_in_req;
-		for (i = 0; i < (engine_list_total); i++) {
-			while ((sg) && i < (engine_list_total - 1)) {
-				split_io[i].size += sg->length;
-				split_io[engine_list_total - 1].size -=
-						sg->length;
-				if (split_io[i].size >=
-						(total_bytes_in_req /
-							engine_list_total)) {
-					split_io[i + 1].req_split_sg_read =
-							sg_next(sg);
-					sg_mark_end(sg);
-					break;
-				}
-				sg = sg_next(sg);
-			}
-			split_io[i].engine = &curr_engine_list[i];
-			init_completion(&split_io[i].result.completion);
-			memset(&split_io[i].IV, 0, AES_XTS_IV_LEN);
-			tempiv = clone->__sector + (temp_size / SECTOR_SIZE);
-			memcpy(&split_io[i].IV, &tempiv, sizeof(sector_t));
-			temp_size +=  split_io[i].size;
-			split_io[i].clone = clone;
-			req_cryptd_split_req_queue(&split_io[i]);
-		}
-	} else {
-		split_io = kzalloc(sizeof(struct req_dm_split_req_io),
-				GFP_KERNEL);
-		if (!split_io) {
-			DMERR("%s split_io allocation failed\n", __func__);
-			error = DM_REQ_CRYPT_ERROR;
-			goto ablkcipher_req_alloc_failure;
-		}
-		split_io->engine = &curr_engine_list[0];
-		init_completion(&split_io->result.completion);
-		memcpy(split_io->IV, &clone->__sector, sizeof(sector_t));
-		split_io->req_split_sg_read = req_sg_read;
-		split_io->size = total_bytes_in_req;
-		split_io->clone = clone;
-		req_cryptd_split_req_queue(split_io);
-	}
-
-	if (!split_transfers) {
-		wait_for_completion_interruptible(&split_io->result.completion);
-		if (split_io->result.err) {
-			DMERR("%s error = %d for request\n",
-				 __func__, split_io->result.err);
-			error = DM_REQ_CRYPT_ERROR;
-			goto ablkcipher_req_alloc_failure;
-		}
-	} else {
-		for (i = 0; i < (engine_list_total); i++) {
-			wait_for_completion_interruptible(
-					&split_io[i].result.completion);
-			if (split_io[i].result.err) {
-				DMERR("%s error = %d for %dst request\n",
-					 __func__, split_io[i].result.err, i);
-				error = DM_REQ_CRYPT_ERROR;
-				goto ablkcipher_req_alloc_failure;
+	split_io[0].req_split_sg_read = sg = req_sg_read;
+	split_io[nr_split - 1].size = total_bytes_in_req;
+	for (i = 0; i < (nr_split - 1); i++) {
+		while (sg) {
+			split_io[i].size += sg->length;
+			split_io[nr_split - 1].size -= sg->length;
+			if (split_io[i].size >=
+					(total_bytes_in_req / nr_split)) {
+				split_io[i + 1].req_split_sg_read =
+						sg_next(sg);
+				sg_mark_end(sg);
+				break;
 			}
+			sg = sg_next(sg);
 		}
 	}
+
+	req_crypt_result_init(&result);
+	crypto_ablkcipher_clear_flags(tfm, ~0);
+	crypto_ablkcipher_setkey(tfm, NULL, KEY_SIZE_XTS);
+
+	for (i = 0; i < nr_split; i++) {
+		unsigned int e = (first_engine + i) % engine_list_total;
+
+		split_io[i].engine = &curr_engine_list[e];
+		split_io[i].stats = &curr_stats[e];
+		split_io[i].result = &result;
+		memset(&split_io[i].IV, 0, AES_XTS_IV_LEN);
+		tempiv = clone->__sector + (temp_size / SECTOR_SIZE);
+		memcpy(&split_io[i].IV, &tempiv, sizeof(sector_t));
+		temp_size +=  split_io[i].size;
+		split_io[i].clone = clone;
+		req_crypt_submit_split(&split_io[i]);
+	}
+
+	/* drop the submitter's reference and wait for all the pieces */
+	req_crypt_result_put(&result, 0);
+	wait_for_completion_io(&result.completion);
+
+	for (i = 0; i < nr_split; i++)
+		if (split_io[i].req)
+			ablkcipher_request_free(split_io[i].req);
+
+	if (result.err) {
+		DMERR("%s error = %d for request\n",
+			 __func__, result.err);
+		error = DM_REQ_CRYPT_ERROR;
+		goto ablkcipher_req_alloc_failure;
+	}
 	error = 0;
 ablkcipher_req_alloc_failure:
 
@@ -471,6 +579,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 	struct crypto_engine_entry engine;
 	unsigned int engine_list_total = 0;
 	struct crypto_engine_entry *curr_engine_list = NULL;
+	struct req_crypt_engine_stats *stats = NULL;
 	unsigned int *engine_cursor = NULL;
 
 
@@ -525,6 +634,8 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 	}
 
 	engine = curr_engine_list[*engine_cursor];
+	stats = (io->key_id == FDE_KEY_ID ? fde_eng_stats : pfe_eng_stats) +
+		*engine_cursor;
 	(*engine_cursor)++;
 	(*engine_cursor) %= engine_list_total;
 
@@ -538,7 +649,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 	}
 	mutex_unlock(&engine_list_mutex);
 
-	init_completion(&result.completion);
+	req_crypt_result_init(&result);
 
 	(dm_qcrypto_func.cipher_flag)(req,
 		QCRYPTO_CTX_USE_PIPE_KEY | QCRYPTO_CTX_XTS_DU_SIZE_512B);
@@ -619,10 +730,12 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 	ablkcipher_request_set_crypt(req, req_sg_in, req_sg_out,
 			total_bytes_in_req, (void *) IV);
 
+	req_crypt_engine_start(stats, total_bytes_in_req);
 	rc = crypto_ablkcipher_encrypt(req);
 
 	switch (rc) {
 	case 0:
+		req_crypt_engine_done(stats);
 		break;
 
 	case -EBUSY:
@@ -632,6 +745,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		 */
 	case -EINPROGRESS:
 		wait_for_completion_interruptible(&result.completion);
+		req_crypt_engine_done(stats);
 		if (result.err) {
 			DMERR("%s error = %d encrypting the request\n",
 				 __func__, result.err);
@@ -641,6 +755,7 @@ static void req_cryptd_crypt_write_convert(struct req_dm_crypt_io *io)
 		break;
 
 	default:
+		req_crypt_engine_done(stats);
 		error = DM_REQ_CRYPT_ERROR_AFTER_PAGE_MALLOC;
 		goto ablkcipher_req_alloc_failure;
 	}
@@ -720,89 +835,6 @@ static void req_cryptd_crypt(struct work_struct *work)
 	}
 }
 
-static void req_cryptd_split_req_queue_cb(struct work_struct *work)
-{
-	struct req_dm_split_req_io *io =
-			container_of(work, struct req_dm_split_req_io, work);
-	struct ablkcipher_request *req = NULL;
-	struct req_crypt_result result;
-	int err = 0;
-	struct crypto_engine_entry *engine = NULL;
-
-	if ((!io) || (!io->req_split_sg_read) || (!io->engine)) {
-		DMERR("%s Input invalid\n",
-			 __func__);
-		err = DM_REQ_CRYPT_ERROR;
-		/* If io is not populated this should not be called */
-		BUG();
-	}
-	req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
-	if (!req) {
-		DMERR("%s ablkcipher request allocation failed\n", __func__);
-		err = DM_REQ_CRYPT_ERROR;
-		goto ablkcipher_req_alloc_failure;
-	}
-
-	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-					req_crypt_cipher_complete, &result);
-
-	engine = io->engine;
-
-	err = (dm_qcrypto_func.cipher_set)(req, engine->ce_device,
-			engine->hw_instance);
-	if (err) {
-		DMERR("%s qcrypto_cipher_set_device_hw failed with err %d\n",
-				__func__, err);
-		goto ablkcipher_req_alloc_failure;
-	}
-	init_completion(&result.completion);
-	(dm_qcrypto_func.cipher_flag)(req,
-		QCRYPTO_CTX_USE_PIPE_KEY | QCRYPTO_CTX_XTS_DU_SIZE_512B);
-
-	crypto_ablkcipher_clear_flags(tfm, ~0);
-	crypto_ablkcipher_setkey(tfm, NULL, KEY_SIZE_XTS);
-
-	ablkcipher_request_set_crypt(req, io->req_split_sg_read,
-			io->req_split_sg_read, io->size, (void *) io->IV);
-
-	err = crypto_ablkcipher_decrypt(req);
-	switch (err) {
-	case 0:
-		break;
-
-	case -EBUSY:
-		/*
-		 * Lets make this synchronous request by waiting on
-		 * in progress as well
-		 */
-	case -EINPROGRESS:
-		wait_for_completion_io(&result.completion);
-		if (result.err) {
-			DMERR("%s error = %d encrypting the request\n",
-				 __func__, result.err);
-			err = DM_REQ_CRYPT_ERROR;
-			goto ablkcipher_req_alloc_failure;
-		}
-		break;
-
-	default:
-		err = DM_REQ_CRYPT_ERROR;
-		goto ablkcipher_req_alloc_failure;
-	}
-	err = 0;
-ablkcipher_req_alloc_failure:
-	if (req)
-		ablkcipher_request_free(req);
-
-	req_crypt_split_io_complete(&io->result, err);
-}
-
-static void req_cryptd_split_req_queue(struct req_dm_split_req_io *io)
-{
-	INIT_WORK(&io->work, req_cryptd_split_req_queue_cb);
-	queue_work(req_crypt_split_io_queue, &io->work);
-}
-
 static void req_cryptd_queue_crypt(struct req_dm_crypt_io *io)
 {
 	INIT_WORK(&io->work, req_cryptd_crypt);
@@ -821,17 +853,22 @@ static void req_crypt_cipher_complete(struct crypto_async_request *req, int err)
 	if (err == -EINPROGRESS)
 		return;
 
-	res->err = err;
-	complete(&res->completion);
+	req_crypt_result_put(res, err);
 }
 
-static void req_crypt_split_io_complete(struct req_crypt_result *res, int err)
+/*
+ * Completion of one piece of a split read, see req_crypt_submit_split().
+ */
+static void req_crypt_split_io_complete(struct crypto_async_request *req,
+					int err)
 {
+	struct req_dm_split_req_io *io = req->data;
+
 	if (err == -EINPROGRESS)
 		return;
 
-	res->err = err;
-	complete(&res->completion);
+	req_crypt_engine_done(io->stats);
+	req_crypt_result_put(io->result, err ? DM_REQ_CRYPT_ERROR : 0);
 }
 /*
  * If bio->bi_dev is a partition, remap the location
@@ -1011,10 +1048,6 @@ static void deconfigure_qcrypto(void)
 		req_scatterlist_pool = NULL;
 	}
 
-	if (req_crypt_split_io_queue) {
-		destroy_workqueue(req_crypt_split_io_queue);
-		req_crypt_split_io_queue = NULL;
-	}
 	if (req_crypt_queue) {
 		destroy_workqueue(req_crypt_queue);
 		req_crypt_queue = NULL;
@@ -1027,6 +1060,10 @@ static void deconfigure_qcrypto(void)
 	pfe_eng = NULL;
 	kfree(fde_eng);
 	fde_eng = NULL;
+	kfree(pfe_eng_stats);
+	pfe_eng_stats = NULL;
+	kfree(fde_eng_stats);
+	fde_eng_stats = NULL;
 	mutex_unlock(&engine_list_mutex);
 
 	if (tfm) {
@@ -1121,6 +1158,16 @@ static int configure_qcrypto(void)
 		goto exit_err;
 	}
 
+	fde_eng_stats = kcalloc(num_engines_fde, sizeof(*fde_eng_stats),
+				GFP_KERNEL);
+	pfe_eng_stats = kcalloc(num_engines_pfe, sizeof(*pfe_eng_stats),
+				GFP_KERNEL);
+	if (!fde_eng_stats || !pfe_eng_stats) {
+		DMERR("%s engine stats allocation failed\n", __func__);
+		mutex_unlock(&engine_list_mutex);
+		goto exit_err;
+	}
+
 	fde_cursor = 0;
 	pfe_cursor = 0;
 
@@ -1151,15 +1198,6 @@ static int configure_qcrypto(void)
 		goto exit_err;
 	}
 
-	req_crypt_split_io_queue = alloc_workqueue("req_crypt_split",
-					WQ_UNBOUND |
-					WQ_CPU_INTENSIVE |
-					WQ_MEM_RECLAIM,
-					0);
-	if (!req_crypt_split_io_queue) {
-		DMERR("%s req_crypt_split_io_queue not allocated\n", __func__);
-		goto exit_err;
-	}
 	req_scatterlist_pool = mempool_create_slab_pool(MIN_IOS,
 					_req_dm_scatterlist_pool);
 	if (!req_scatterlist_pool) {
@@ -1308,6 +1346,46 @@ ctr_exit:
 	return err;
 }
 
+static int req_crypt_show_engines(char *buf, int len, const char *type,
+				  struct crypto_engine_entry *eng,
+				  struct req_crypt_engine_stats *stats,
+				  unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; eng && stats && i < n; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s %u %u %d %lu %lu\n", type,
+				 eng[i].ce_device, eng[i].hw_instance,
+				 atomic_read(&stats[i].inflight),
+				 atomic_long_read(&stats[i].submitted),
+				 atomic_long_read(&stats[i].bytes));
+	return len;
+}
+
+/*
+ * One line per engine: key type, ce device, hw instance, cipher requests in
+ * flight, cipher requests submitted and bytes submitted.
+ */
+static int req_crypt_engine_stats_get(char *buf, const struct kernel_param *kp)
+{
+	int len = 0;
+
+	mutex_lock(&engine_list_mutex);
+	len = req_crypt_show_engines(buf, len, "fde", fde_eng, fde_eng_stats,
+				     num_engines_fde);
+	len = req_crypt_show_engines(buf, len, "pfe", pfe_eng, pfe_eng_stats,
+				     num_engines_pfe);
+	mutex_unlock(&engine_list_mutex);
+
+	return len;
+}
+
+static const struct kernel_param_ops req_crypt_engine_stats_ops = {
+	.get = req_crypt_engine_stats_get,
+};
+module_param_cb(engine_stats, &req_crypt_engine_stats_ops, NULL, S_IRUGO);
+
 static int req_crypt_iterate_devices(struct dm_target *ti,
 				 iterate_devices_callout_fn fn, void *data)
 {
@@ -12,6 +12,12 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * The cluster is adapted to the access pattern: it is widened (up to
+ * 1 << DM_VERITY_PREFETCH_MAX_SHIFT times) while reads keep following each
+ * other sequentially and shrunk for random reads.  Hash block lookups that
+ * found the block cached (or already being read) and those that had to wait
+ * for I/O are reported after the V/C flag in the device status.
  */
 
 #include "dm-verity.h"
@@ -19,6 +25,7 @@
 
 #include <linux/module.h>
 #include <linux/reboot.h>
+#include <linux/shrinker.h>
 #include <linux/vmalloc.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -27,6 +34,8 @@
 #define DM_VERITY_ENV_VAR_NAME		"DM_VERITY_ERR_BLOCK_NR"
 
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_PREFETCH_MAX_SHIFT	3
+#define DM_VERITY_PREFETCH_RANDOM_SHIFT	2
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
@@ -46,6 +55,7 @@ struct dm_verity_prefetch_work {
 	struct dm_verity *v;
 	sector_t block;
 	unsigned n_blocks;
+	unsigned cluster;	/* level 0 prefetch cluster in hash blocks */
 };
 
 /*
@@ -198,6 +208,152 @@ static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
 		*offset = idx << (v->hash_dev_block_bits - v->hash_per_block_bits);
 }
 
+/*
+ * check_at_most_once bookkeeping.  The bitset is split into page sized chunks
+ * that are only allocated once a block in their range has been verified, and
+ * that the shrinker may take away again at any time: a missing chunk only
+ * means the blocks it covered get hashed again on their next read.  Readers
+ * look chunks up under RCU, freed chunks go through call_rcu().
+ */
+#define VERITY_BITS_PER_CHUNK	(PAGE_SIZE * BITS_PER_BYTE)
+
+static LIST_HEAD(verity_validated_devs);
+static DEFINE_SPINLOCK(verity_validated_lock);
+
+static void verity_free_validated_rcu(struct rcu_head *head)
+{
+	__free_page(container_of(head, struct page, rcu_head));
+}
+
+/*
+ * Detach chunk @idx, if present, and free it after a grace period.
+ */
+static bool verity_drop_validated_chunk(struct dm_verity *v, unsigned idx)
+{
+	struct page *page;
+
+	page = (__force struct page *)xchg(&v->validated_pages[idx], NULL);
+	if (!page)
+		return false;
+
+	atomic_dec(&v->validated_nr_alloc);
+	call_rcu(&page->rcu_head, verity_free_validated_rcu);
+	return true;
+}
+
+/*
+ * Forget every block verified so far.
+ */
+static void verity_drop_validated(struct dm_verity *v)
+{
+	unsigned i;
+
+	if (!v->validated_pages)
+		return;
+
+	for (i = 0; i < v->validated_nr_pages; i++)
+		verity_drop_validated_chunk(v, i);
+}
+
+static bool verity_is_validated(struct dm_verity *v, sector_t block)
+{
+	struct page *page;
+	bool r = false;
+
+	if (!v->validated_pages)
+		return false;
+
+	rcu_read_lock();
+	page = rcu_dereference(v->validated_pages[block / VERITY_BITS_PER_CHUNK]);
+	if (page)
+		r = test_bit(block % VERITY_BITS_PER_CHUNK, page_address(page));
+	rcu_read_unlock();
+
+	return r;
+}
+
+static void verity_set_validated(struct dm_verity *v, sector_t block)
+{
+	struct page __rcu **slot;
+	struct page *page, *new;
+
+	if (!v->validated_pages)
+		return;
+
+	slot = &v->validated_pages[block / VERITY_BITS_PER_CHUNK];
+
+	rcu_read_lock();
+	page = rcu_dereference(*slot);
+	if (unlikely(!page)) {
+		rcu_read_unlock();
+
+		/* if memory is tight, just don't remember this block */
+		new = alloc_page(GFP_NOIO | __GFP_NOWARN | __GFP_ZERO);
+		if (!new)
+			return;
+
+		if (cmpxchg(slot, NULL, (__force struct page __rcu *)new))
+			__free_page(new);
+		else
+			atomic_inc(&v->validated_nr_alloc);
+
+		rcu_read_lock();
+		page = rcu_dereference(*slot);
+		if (!page)
+			goto out;
+	}
+
+	set_bit(block % VERITY_BITS_PER_CHUNK, page_address(page));
+out:
+	rcu_read_unlock();
+}
+
+static unsigned long verity_validated_count(struct shrinker *shrink,
+					    struct shrink_control *sc)
+{
+	struct dm_verity *v;
+	unsigned long count = 0;
+
+	spin_lock(&verity_validated_lock);
+	list_for_each_entry(v, &verity_validated_devs, validated_list)
+		count += atomic_read(&v->validated_nr_alloc);
+	spin_unlock(&verity_validated_lock);
+
+	return count;
+}
+
+static unsigned long verity_validated_scan(struct shrinker *shrink,
+					   struct shrink_control *sc)
+{
+	struct dm_verity *v;
+	unsigned long freed = 0;
+	unsigned n;
+
+	spin_lock(&verity_validated_lock);
+	list_for_each_entry(v, &verity_validated_devs, validated_list) {
+		for (n = 0; n < v->validated_nr_pages &&
+			    atomic_read(&v->validated_nr_alloc); n++) {
+			if (freed >= sc->nr_to_scan)
+				goto out;
+
+			if (verity_drop_validated_chunk(v, v->validated_scan))
+				freed++;
+			if (++v->validated_scan >= v->validated_nr_pages)
+				v->validated_scan = 0;
+		}
+	}
+out:
+	spin_unlock(&verity_validated_lock);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker verity_validated_shrinker = {
+	.count_objects = verity_validated_count,
+	.scan_objects = verity_validated_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 /*
  * Handle verification errors.
  */
@@ -212,6 +368,9 @@ static int verity_handle_err(struct dm_verity *v, enum verity_block_type type,
 	/* Corruption should be visible in device status in all modes */
 	v->hash_failed = 1;
 
+	/* Don't trust anything verified before the device went bad */
+	verity_drop_validated(v);
+
 	if (v->corrupted_errs >= DM_VERITY_MAX_CORRUPTED_ERRS)
 		goto out;
 
@@ -277,7 +436,13 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 	verity_hash_at_level(v, block, level, &hash_block, &offset);
 
-	data = dm_bufio_read(v->bufio, hash_block, &buf);
+	data = dm_bufio_get(v->bufio, hash_block, &buf);
+	if (data) {
+		atomic_long_inc(&v->prefetch_hits);
+	} else {
+		atomic_long_inc(&v->prefetch_misses);
+		data = dm_bufio_read(v->bufio, hash_block, &buf);
+	}
 	if (IS_ERR(data))
 		return PTR_ERR(data);
 
@@ -420,6 +585,91 @@ static inline void verity_bv_skip_block(struct dm_verity *v,
 	bio_advance_iter(bio, iter, 1 << v->data_dev_block_bits);
 }
 
+/*
+ * Hash the data block at @iter and the one after it with one multi-buffer
+ * call.  Returns -EAGAIN if either block is not contiguous in memory.
+ */
+static int verity_hash_2x(struct dm_verity *v, struct dm_verity_io *io,
+			  struct bvec_iter *iter, u8 *digest1, u8 *digest2)
+{
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_bio_data_size);
+	struct shash_desc *desc = verity_io_hash_desc(v, io);
+	unsigned block_size = 1 << v->data_dev_block_bits;
+	struct bvec_iter iter2 = *iter;
+	struct bio_vec bv1, bv2;
+	const u8 *data[2];
+	u8 *outs[2] = { digest1, digest2 };
+	u8 *page1, *page2;
+	int r;
+
+	bv1 = bio_iter_iovec(bio, *iter);
+	bio_advance_iter(bio, &iter2, block_size);
+	bv2 = bio_iter_iovec(bio, iter2);
+	if (bv1.bv_len < block_size || bv2.bv_len < block_size)
+		return -EAGAIN;
+
+	r = verity_hash_init(v, desc);
+	if (unlikely(r < 0))
+		return r;
+
+	page1 = kmap_atomic(bv1.bv_page);
+	page2 = kmap_atomic(bv2.bv_page);
+	data[0] = page1 + bv1.bv_offset;
+	data[1] = page2 + bv2.bv_offset;
+	r = crypto_shash_finup_mb(desc, data, block_size, outs, 2);
+	kunmap_atomic(page2);
+	kunmap_atomic(page1);
+
+	if (unlikely(r < 0))
+		DMERR("crypto_shash_finup_mb failed: %d", r);
+
+	return r;
+}
+
+/*
+ * Verify @cur_block, whose expected digest is already in want_digest, together
+ * with the block after it.  Returns -EAGAIN when the pair can't be handled
+ * here (the second block is already validated or a zero block, the data is
+ * not contiguous, or a digest mismatches); the caller then verifies
+ * @cur_block on its own, with the usual error handling.
+ */
+static int verity_verify_2x(struct dm_verity_io *io, sector_t cur_block)
+{
+	struct dm_verity *v = io->v;
+	sector_t next_block = cur_block + 1;
+	struct bvec_iter iter = io->iter;
+	bool is_zero;
+	int r;
+
+	if (verity_is_validated(v, next_block))
+		return -EAGAIN;
+
+	r = verity_hash_for_block(v, io, next_block,
+				  verity_io_want_digest2(v, io), &is_zero);
+	if (unlikely(r < 0))
+		return r;
+	if (is_zero)
+		return -EAGAIN;
+
+	r = verity_hash_2x(v, io, &iter, verity_io_real_digest(v, io),
+			   verity_io_real_digest2(v, io));
+	if (r)
+		return r;
+
+	if (memcmp(verity_io_real_digest(v, io),
+		   verity_io_want_digest(v, io), v->digest_size) ||
+	    memcmp(verity_io_real_digest2(v, io),
+		   verity_io_want_digest2(v, io), v->digest_size))
+		return -EAGAIN;
+
+	verity_set_validated(v, cur_block);
+	verity_set_validated(v, next_block);
+	verity_bv_skip_block(v, io, &io->iter);
+	verity_bv_skip_block(v, io, &io->iter);
+
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -435,8 +685,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 		sector_t cur_block = io->block + b;
 		struct shash_desc *desc = verity_io_hash_desc(v, io);
 
-		if (v->validated_blocks &&
-		    likely(test_bit(cur_block, v->validated_blocks))) {
+		if (verity_is_validated(v, cur_block)) {
 			verity_bv_skip_block(v, io, &io->iter);
 			continue;
 		}
@@ -460,6 +709,16 @@ static int verity_verify_io(struct dm_verity_io *io)
 			continue;
 		}
 
+		if (v->use_mb && b + 1 < io->n_blocks) {
+			r = verity_verify_2x(io, cur_block);
+			if (!r) {
+				b++;
+				continue;
+			}
+			if (r != -EAGAIN)
+				return r;
+		}
+
 		r = verity_hash_init(v, desc);
 		if (unlikely(r < 0))
 			return r;
@@ -475,8 +734,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
-			if (v->validated_blocks)
-				set_bit(cur_block, v->validated_blocks);
+			verity_set_validated(v, cur_block);
 			continue;
 		}
 		else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
@@ -545,15 +803,11 @@ static void verity_prefetch_io(struct work_struct *work)
 		verity_hash_at_level(v, pw->block, i, &hash_block_start, NULL);
 		verity_hash_at_level(v, pw->block + pw->n_blocks - 1, i, &hash_block_end, NULL);
 		if (!i) {
-			unsigned cluster = ACCESS_ONCE(dm_verity_prefetch_cluster);
+			unsigned cluster = pw->cluster;
 
-			cluster >>= v->data_dev_block_bits;
-			if (unlikely(!cluster))
+			if (!cluster)
 				goto no_prefetch_cluster;
 
-			if (unlikely(cluster & (cluster - 1)))
-				cluster = 1 << __fls(cluster);
-
 			hash_block_start &= ~(sector_t)(cluster - 1);
 			hash_block_end |= cluster - 1;
 			if (unlikely(hash_block_end >= v->hash_blocks))
@@ -567,6 +821,42 @@ no_prefetch_cluster:
 	kfree(pw);
 }
 
+/*
+ * Pick the level 0 prefetch cluster for @io: widen it while the reads form a
+ * sequential stream, shrink it when @io doesn't follow the previous one.
+ * The stream state is updated without locking, a race only costs a
+ * misjudged cluster size.
+ */
+static unsigned verity_prefetch_cluster(struct dm_verity *v,
+					struct dm_verity_io *io)
+{
+	unsigned cluster = ACCESS_ONCE(dm_verity_prefetch_cluster);
+	unsigned seq = ACCESS_ONCE(v->prefetch_seq);
+
+	if (io->block == ACCESS_ONCE(v->prefetch_next)) {
+		if (seq < DM_VERITY_PREFETCH_MAX_SHIFT)
+			seq++;
+	} else {
+		seq = 0;
+	}
+	ACCESS_ONCE(v->prefetch_seq) = seq;
+	ACCESS_ONCE(v->prefetch_next) = io->block + io->n_blocks;
+
+	if (seq)
+		cluster = cluster > (UINT_MAX >> seq) ? UINT_MAX : cluster << seq;
+	else
+		cluster >>= DM_VERITY_PREFETCH_RANDOM_SHIFT;
+
+	cluster >>= v->data_dev_block_bits;
+	if (unlikely(!cluster))
+		return 0;
+
+	if (unlikely(cluster & (cluster - 1)))
+		cluster = 1 << __fls(cluster);
+
+	return cluster;
+}
+
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
 	struct dm_verity_prefetch_work *pw;
@@ -581,6 +871,7 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 	pw->v = v;
 	pw->block = io->block;
 	pw->n_blocks = io->n_blocks;
+	pw->cluster = verity_prefetch_cluster(v, io);
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -644,7 +935,9 @@ void verity_status(struct dm_target *ti, status_type_t type,
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		DMEMIT("%c", v->hash_failed ? 'C' : 'V');
+		DMEMIT("%c %lu %lu", v->hash_failed ? 'C' : 'V',
+		       atomic_long_read(&v->prefetch_hits),
+		       atomic_long_read(&v->prefetch_misses));
 		break;
 	case STATUSTYPE_TABLE:
 		DMEMIT("%u %s %s %u %u %llu %llu %s ",
@@ -671,7 +964,7 @@ void verity_status(struct dm_target *ti, status_type_t type,
 			args += DM_VERITY_OPTS_FEC;
 		if (v->zero_digest)
 			args++;
-		if (v->validated_blocks)
+		if (v->validated_pages)
 			args++;
 		if (!args)
 			return;
@@ -691,7 +984,7 @@ void verity_status(struct dm_target *ti, status_type_t type,
 		}
 		if (v->zero_digest)
 			DMEMIT(" " DM_VERITY_OPT_IGN_ZEROES);
-		if (v->validated_blocks)
+		if (v->validated_pages)
 			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
 		sz = verity_fec_status_table(v, sz, result, maxlen);
 		break;
@@ -746,7 +1039,17 @@ void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
-	vfree(v->validated_blocks);
+	if (v->validated_pages) {
+		unsigned i;
+
+		spin_lock(&verity_validated_lock);
+		list_del(&v->validated_list);
+		spin_unlock(&verity_validated_lock);
+
+		for (i = 0; i < v->validated_nr_pages; i++)
+			verity_drop_validated_chunk(v, i);
+		vfree(v->validated_pages);
+	}
 	kfree(v->salt);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
@@ -772,18 +1075,29 @@ static int verity_alloc_most_once(struct dm_verity *v)
 {
 	struct dm_target *ti = v->ti;
 
+	sector_t nr_pages;
+
 	/* the bitset can only handle INT_MAX blocks */
 	if (v->data_blocks > INT_MAX) {
 		ti->error = "device too large to use check_at_most_once";
 		return -E2BIG;
 	}
 
-	v->validated_blocks = vzalloc(BITS_TO_LONGS(v->data_blocks) *
-				       sizeof(unsigned long));
-	if (!v->validated_blocks) {
+	if (v->validated_pages)
+		return 0;
+
+	nr_pages = DIV_ROUND_UP_SECTOR_T(v->data_blocks, VERITY_BITS_PER_CHUNK);
+	v->validated_pages = vzalloc(nr_pages * sizeof(*v->validated_pages));
+	if (!v->validated_pages) {
 		ti->error = "failed to allocate bitset for check_at_most_once";
 		return -ENOMEM;
 	}
+	v->validated_nr_pages = nr_pages;
+	atomic_set(&v->validated_nr_alloc, 0);
+
+	spin_lock(&verity_validated_lock);
+	list_add_tail(&v->validated_list, &verity_validated_devs);
+	spin_unlock(&verity_validated_lock);
 
 	return 0;
 }
@@ -1056,7 +1370,7 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	}
 
 #ifdef CONFIG_DM_ANDROID_VERITY_AT_MOST_ONCE_DEFAULT_ENABLED
-	if (!v->validated_blocks) {
+	if (!v->validated_pages) {
 		r = verity_alloc_most_once(v);
 		if (r)
 			goto bad;
@@ -1118,8 +1432,15 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	/*
+	 * The salt of format version 1 is a common prefix, which is what the
+	 * multi-buffer interface can share between messages.
+	 */
+	v->use_mb = v->version >= 1 && crypto_shash_mb_max_msgs(v->tfm) >= 2;
+
 	ti->per_bio_data_size = sizeof(struct dm_verity_io) +
-				v->shash_descsize + v->digest_size * 2;
+				v->shash_descsize +
+				v->digest_size * (v->use_mb ? 4 : 2);
 
 	r = verity_fec_ctr(v);
 	if (r)
@@ -1154,9 +1475,17 @@ static int __init dm_verity_init(void)
 {
 	int r;
 
+	r = register_shrinker(&verity_validated_shrinker);
+	if (r < 0) {
+		DMERR("shrinker registration failed %d", r);
+		return r;
+	}
+
 	r = dm_register_target(&verity_target);
-	if (r < 0)
+	if (r < 0) {
 		DMERR("register failed %d", r);
+		unregister_shrinker(&verity_validated_shrinker);
+	}
 
 	return r;
 }
@@ -1164,6 +1493,9 @@ static int __init dm_verity_init(void)
 static void __exit dm_verity_exit(void)
 {
 	dm_unregister_target(&verity_target);
+	unregister_shrinker(&verity_validated_shrinker);
+	/* wait for chunks still queued by verity_drop_validated_chunk() */
+	rcu_barrier();
 }
 
 module_init(dm_verity_init);
@@ -54,16 +54,32 @@ struct dm_verity {
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
 	int hash_failed;	/* set to 1 if hash of any block failed */
+	bool use_mb;		/* hash pairs of data blocks at once */
 	enum verity_mode mode;	/* mode for handling verification errors */
 	unsigned corrupted_errs;/* Number of errors for corrupted blocks */
 
 	struct workqueue_struct *verify_wq;
 
+	/* adaptive prefetch state, see verity_prefetch_cluster() */
+	sector_t prefetch_next;	/* block following the last mapped io */
+	unsigned prefetch_seq;	/* length of the current sequential run */
+	atomic_long_t prefetch_hits;	/* hash blocks found in the cache */
+	atomic_long_t prefetch_misses;	/* hash blocks read synchronously */
+
 	/* starting blocks for each tree level. 0 is the lowest level. */
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 
 	struct dm_verity_fec *fec;	/* forward error correction */
-	unsigned long *validated_blocks; /* bitset blocks validated */
+
+	/*
+	 * check_at_most_once bitset, in page sized chunks that are allocated
+	 * on first use and can be reclaimed by the shrinker.
+	 */
+	struct page __rcu **validated_pages;
+	unsigned validated_nr_pages;	/* number of chunk slots */
+	unsigned validated_scan;	/* next slot for the shrinker to look at */
+	atomic_t validated_nr_alloc;	/* chunks currently allocated */
+	struct list_head validated_list; /* on verity_validated_devs */
 };
 
 struct dm_verity_io {
@@ -88,6 +104,9 @@ struct dm_verity_io {
 	 *
 	 * To access them use: verity_io_hash_desc(), verity_io_real_digest()
 	 * and verity_io_want_digest().
+	 *
+	 * If v->use_mb is set, the digests of a second data block follow,
+	 * in the same order: verity_io_real_digest2(), verity_io_want_digest2().
 	 */
 };
 
@@ -109,10 +128,23 @@ static inline u8 *verity_io_want_digest(struct dm_verity *v,
 	return (u8 *)(io + 1) + v->shash_descsize + v->digest_size;
 }
 
+static inline u8 *verity_io_real_digest2(struct dm_verity *v,
+					 struct dm_verity_io *io)
+{
+	return verity_io_want_digest(v, io) + v->digest_size;
+}
+
+static inline u8 *verity_io_want_digest2(struct dm_verity *v,
+					 struct dm_verity_io *io)
+{
+	return verity_io_real_digest2(v, io) + v->digest_size;
+}
+
 static inline u8 *verity_io_digest_end(struct dm_verity *v,
 				       struct dm_verity_io *io)
 {
-	return verity_io_want_digest(v, io) + v->digest_size;
+	return verity_io_want_digest(v, io) +
+		v->digest_size * (v->use_mb ? 3 : 1);
 }
 
 extern int verity_for_bv_block(struct dm_verity *v, struct dm_verity_io *io,
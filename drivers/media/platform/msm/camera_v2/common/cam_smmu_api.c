@@ -12,6 +12,8 @@
 #define pr_fmt(fmt) "CAM-SMMU %s:%d " fmt, __func__, __LINE__
 
 #include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/dma-buf.h>
 #include <asm/dma-iommu.h>
 #include <asm/cacheflush.h>
@@ -42,6 +44,16 @@
 #define CAM_SMMU_CB_MAX 2
 #define CAM_SMMU_SID_MAX 4
 
+/*
+ * Mappings whose last user went away are kept for cache_ms so a buffer
+ * that is queued again, typically by the next session, skips the
+ * attach and map. At most cache_max of them are kept per context bank.
+ */
+static unsigned int cam_smmu_cache_ms = 2000;
+module_param_named(cache_ms, cam_smmu_cache_ms, uint, 0644);
+static unsigned int cam_smmu_cache_max = 64;
+module_param_named(cache_max, cam_smmu_cache_max, uint, 0644);
+
 
 #define GET_SMMU_HDL(x, y) (((x) << COOKIE_SIZE) | ((y) & COOKIE_MASK))
 #define GET_SMMU_TABLE_IDX(x) (((x) >> COOKIE_SIZE) & COOKIE_MASK)
@@ -96,6 +108,13 @@ struct scratch_mapping {
 	dma_addr_t base;
 };
 
+struct cam_smmu_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t released;
+	uint64_t evicted;
+};
+
 struct cam_context_bank_info {
 	struct device *dev;
 	struct dma_iommu_mapping *mapping;
@@ -107,6 +126,10 @@ struct cam_context_bank_info {
 	uint8_t scratch_buf_support;
 	struct scratch_mapping scratch_map;
 	struct list_head smmu_buf_list;
+	struct list_head smmu_cache_list;
+	int cache_cnt;
+	struct delayed_work cache_work;
+	struct cam_smmu_cache_stats cache_stats;
 	struct mutex lock;
 	int handle;
 	enum cam_smmu_ops_param state;
@@ -125,6 +148,7 @@ struct cam_iommu_cb_set {
 	struct work_struct smmu_work;
 	struct mutex payload_list_lock;
 	struct list_head payload_list;
+	struct dentry *dentry;
 };
 
 static struct of_device_id msm_cam_smmu_dt_match[] = {
@@ -146,6 +170,7 @@ struct cam_dma_buff_info {
 	int ion_fd;
 	size_t len;
 	size_t phys_len;
+	unsigned long release_jiffies;
 };
 
 struct cam_sec_buff_info {
@@ -217,6 +242,10 @@ static int cam_smmu_probe(struct platform_device *pdev);
 
 static void cam_smmu_check_vaddr_in_range(int idx, void *vaddr);
 
+static void cam_smmu_cache_work(struct work_struct *work);
+
+static void cam_smmu_cache_flush(int idx);
+
 static void cam_smmu_page_fault_work(struct work_struct *work)
 {
 	int j;
@@ -519,6 +548,15 @@ void cam_smmu_reset_iommu_table(enum cam_smmu_init_dir ops)
 	unsigned int i;
 	int j = 0;
 	for (i = 0; i < iommu_cb_set.cb_num; i++) {
+		if (ops == CAM_SMMU_TABLE_INIT) {
+			INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_cache_list);
+			INIT_DELAYED_WORK(&iommu_cb_set.cb_info[i].cache_work,
+				cam_smmu_cache_work);
+		} else {
+			cancel_delayed_work_sync(
+				&iommu_cb_set.cb_info[i].cache_work);
+			cam_smmu_cache_flush(i);
+		}
 		iommu_cb_set.cb_info[i].handle = HANDLE_INIT;
 		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_buf_list);
 		iommu_cb_set.cb_info[i].state = CAM_SMMU_DETACH;
@@ -1270,6 +1308,112 @@ static int cam_smmu_unmap_buf_and_remove_from_list(
 	return 0;
 }
 
+/* called with the context bank lock held */
+static void cam_smmu_cache_flush(int idx)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+	struct cam_dma_buff_info *mapping, *temp;
+
+	list_for_each_entry_safe(mapping, temp, &cb->smmu_cache_list, list) {
+		cam_smmu_unmap_buf_and_remove_from_list(mapping, idx);
+		cb->cache_stats.evicted++;
+	}
+	cb->cache_cnt = 0;
+}
+
+static void cam_smmu_cache_work(struct work_struct *work)
+{
+	struct cam_context_bank_info *cb = container_of(to_delayed_work(work),
+		struct cam_context_bank_info, cache_work);
+	int idx = cb - iommu_cb_set.cb_info;
+	unsigned long timeout = msecs_to_jiffies(cam_smmu_cache_ms);
+	struct cam_dma_buff_info *mapping, *temp;
+
+	mutex_lock(&cb->lock);
+	/* oldest first */
+	list_for_each_entry_safe(mapping, temp, &cb->smmu_cache_list, list) {
+		if (time_before(jiffies, mapping->release_jiffies + timeout)) {
+			schedule_delayed_work(&cb->cache_work,
+				mapping->release_jiffies + timeout - jiffies);
+			break;
+		}
+		cam_smmu_unmap_buf_and_remove_from_list(mapping, idx);
+		cb->cache_cnt--;
+		cb->cache_stats.evicted++;
+	}
+	mutex_unlock(&cb->lock);
+}
+
+/*
+ * Keep an unused mapping around instead of tearing it down. Returns
+ * false when caching is off and the caller should unmap it.
+ */
+static bool cam_smmu_cache_release(int idx,
+	struct cam_dma_buff_info *mapping_info)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+	struct cam_dma_buff_info *oldest;
+
+	if (!cam_smmu_cache_ms || !cam_smmu_cache_max)
+		return false;
+
+	mapping_info->release_jiffies = jiffies;
+	list_move_tail(&mapping_info->list, &cb->smmu_cache_list);
+	cb->cache_cnt++;
+	cb->cache_stats.released++;
+
+	while (cb->cache_cnt > cam_smmu_cache_max) {
+		oldest = list_first_entry(&cb->smmu_cache_list,
+			struct cam_dma_buff_info, list);
+		cam_smmu_unmap_buf_and_remove_from_list(oldest, idx);
+		cb->cache_cnt--;
+		cb->cache_stats.evicted++;
+	}
+
+	if (!delayed_work_pending(&cb->cache_work))
+		schedule_delayed_work(&cb->cache_work,
+			msecs_to_jiffies(cam_smmu_cache_ms));
+	return true;
+}
+
+/*
+ * Look for a cached mapping of the dma-buf behind ion_fd. The fd itself
+ * usually differs between sessions, the dma-buf does not.
+ */
+static enum cam_smmu_buf_state cam_smmu_check_fd_in_cache(int idx,
+	int ion_fd, enum dma_data_direction dma_dir, dma_addr_t *paddr_ptr,
+	size_t *len_ptr)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+	struct cam_dma_buff_info *mapping;
+	struct dma_buf *buf;
+
+	if (list_empty(&cb->smmu_cache_list))
+		return CAM_SMMU_BUFF_NOT_EXIST;
+
+	buf = dma_buf_get(ion_fd);
+	if (IS_ERR_OR_NULL(buf))
+		return CAM_SMMU_BUFF_NOT_EXIST;
+
+	list_for_each_entry(mapping, &cb->smmu_cache_list, list) {
+		if (mapping->buf == buf && mapping->dir == dma_dir) {
+			list_move(&mapping->list, &cb->smmu_buf_list);
+			cb->cache_cnt--;
+			cb->cache_stats.hits++;
+			mapping->ion_fd = ion_fd;
+			mapping->ref_count = 1;
+			*paddr_ptr = mapping->paddr;
+			*len_ptr = mapping->len;
+			/* the mapping holds its own reference */
+			dma_buf_put(buf);
+			return CAM_SMMU_BUFF_EXIST;
+		}
+	}
+	cb->cache_stats.misses++;
+	dma_buf_put(buf);
+	return CAM_SMMU_BUFF_NOT_EXIST;
+}
+
 static enum cam_smmu_buf_state cam_smmu_check_fd_in_list(int idx,
 					int ion_fd, dma_addr_t *paddr_ptr,
 					size_t *len_ptr)
@@ -2144,6 +2288,13 @@ int cam_smmu_get_phy_addr(int handle, int ion_fd,
 		rc = 0;
 		goto get_addr_end;
 	}
+	buf_state = cam_smmu_check_fd_in_cache(idx, ion_fd, dma_dir,
+			paddr_ptr, len_ptr);
+	if (buf_state == CAM_SMMU_BUFF_EXIST) {
+		CDBG("ion_fd:%d mapping reused from cache", ion_fd);
+		rc = 0;
+		goto get_addr_end;
+	}
 	rc = cam_smmu_map_buffer_and_add_to_list(idx, ion_fd, dma_dir,
 			paddr_ptr, len_ptr);
 	if (rc < 0) {
@@ -2195,6 +2346,11 @@ int cam_smmu_put_phy_addr(int handle, int ion_fd)
 		goto put_addr_end;
 	}
 
+	if (cam_smmu_cache_release(idx, mapping_info)) {
+		rc = 0;
+		goto put_addr_end;
+	}
+
 	/* unmapping one buffer from device */
 	rc = cam_smmu_unmap_buf_and_remove_from_list(mapping_info, idx);
 	if (rc < 0) {
@@ -2458,6 +2614,36 @@ cb_init_fail:
 	return rc;
 }
 
+static int cam_smmu_cache_show(struct seq_file *s, void *unused)
+{
+	struct cam_context_bank_info *cb;
+	int i;
+
+	seq_puts(s, "# name cached hits misses released evicted\n");
+	for (i = 0; i < iommu_cb_set.cb_num; i++) {
+		cb = &iommu_cb_set.cb_info[i];
+		mutex_lock(&cb->lock);
+		seq_printf(s, "%s %d %llu %llu %llu %llu\n",
+			cb->name ? cb->name : "-", cb->cache_cnt,
+			cb->cache_stats.hits, cb->cache_stats.misses,
+			cb->cache_stats.released, cb->cache_stats.evicted);
+		mutex_unlock(&cb->lock);
+	}
+	return 0;
+}
+
+static int cam_smmu_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_smmu_cache_show, NULL);
+}
+
+static const struct file_operations cam_smmu_cache_fops = {
+	.open = cam_smmu_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int cam_smmu_probe(struct platform_device *pdev)
 {
 	int rc = 0;
@@ -2497,11 +2683,16 @@ static int cam_smmu_probe(struct platform_device *pdev)
 	mutex_init(&iommu_cb_set.payload_list_lock);
 	INIT_LIST_HEAD(&iommu_cb_set.payload_list);
 
+	iommu_cb_set.dentry = debugfs_create_file("cam_smmu_cache", S_IRUGO,
+		NULL, NULL, &cam_smmu_cache_fops);
+
 	return rc;
 }
 
 static int cam_smmu_remove(struct platform_device *pdev)
 {
+	if (of_device_is_compatible(pdev->dev.of_node, "qcom,msm-cam-smmu"))
+		debugfs_remove(iommu_cb_set.dentry);
 	/* release all the context banks and memory allocated */
 	cam_smmu_reset_iommu_table(CAM_SMMU_TABLE_DEINIT);
 	if (of_device_is_compatible(pdev->dev.of_node, "qcom,msm-cam-smmu"))
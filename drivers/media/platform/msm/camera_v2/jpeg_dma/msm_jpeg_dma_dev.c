@@ -35,6 +35,11 @@
 /* Jpeg dma stream off timeout */
 #define MSM_JPEGDMA_STREAM_OFF_TIMEOUT_MS 500
 
+/* Max jobs of one context started back to back from the irq */
+static unsigned int msm_jpegdma_max_chain = 4;
+module_param_named(max_chain, msm_jpegdma_max_chain, uint, 0644);
+MODULE_PARM_DESC(max_chain, "Max queued jobs run per m2m schedule");
+
 /* Jpeg dma formats lookup table */
 static struct msm_jpegdma_format formats[] = {
 	{
@@ -1201,6 +1206,7 @@ static void msm_jpegdma_device_run(void *priv)
 		ctx->pending_config = 0;
 	}
 
+	ctx->chained = 0;
 	msm_jpegdma_process_buffers(ctx, src_buf, dst_buf);
 	dev_dbg(ctx->jdma_device->dev, "Jpeg v4l2 dma device run X\n");
 }
@@ -1239,6 +1245,47 @@ static struct v4l2_m2m_ops msm_jpegdma_m2m_ops = {
 	.job_ready = msm_jpegdma_job_ready,
 };
 
+/*
+ * msm_jpegdma_chain_next_job - Start next queued job of the current context.
+ * @ctx: Pointer dma context.
+ *
+ * When both queues of the context still hold buffers the next job is
+ * programmed right away instead of going through job_finish and the m2m
+ * scheduler, so the core is not left idle between jobs of a burst. The
+ * chain length is bounded to keep the device fair to other contexts.
+ * Returns true if a job was started.
+ */
+static bool msm_jpegdma_chain_next_job(struct jpegdma_ctx *ctx)
+{
+	struct vb2_v4l2_buffer *src_buf;
+	struct vb2_v4l2_buffer *dst_buf;
+
+	if (!atomic_read(&ctx->active))
+		return false;
+
+	if (ctx->chained + 1 >= msm_jpegdma_max_chain)
+		return false;
+
+	if (!v4l2_m2m_num_src_bufs_ready(ctx->m2m_ctx) ||
+		!v4l2_m2m_num_dst_bufs_ready(ctx->m2m_ctx))
+		return false;
+
+	dst_buf = v4l2_m2m_next_dst_buf(ctx->m2m_ctx);
+	src_buf = v4l2_m2m_next_src_buf(ctx->m2m_ctx);
+	if (src_buf == NULL || dst_buf == NULL)
+		return false;
+
+	if (ctx->pending_config) {
+		msm_jpegdma_schedule_next_config(ctx);
+		ctx->pending_config = 0;
+	}
+
+	ctx->chained++;
+	msm_jpegdma_process_buffers(ctx, src_buf, dst_buf);
+
+	return true;
+}
+
 /*
  * msm_jpegdma_isr_processing_done - Invoked by dma_hw when processing is done.
  * @dma: Pointer dma device.
@@ -1264,9 +1311,19 @@ void msm_jpegdma_isr_processing_done(struct msm_jpegdma_device *dma)
 				mutex_unlock(&dma->lock);
 				return;
 			}
-			complete_all(&ctx->completion);
 			ctx->plane_idx = 0;
 
+			/* Keep the core busy before returning the buffers */
+			if (msm_jpegdma_chain_next_job(ctx)) {
+				v4l2_m2m_buf_done(src_buf, VB2_BUF_STATE_DONE);
+				v4l2_m2m_buf_done(dst_buf, VB2_BUF_STATE_DONE);
+				mutex_unlock(&ctx->lock);
+				mutex_unlock(&dma->lock);
+				return;
+			}
+
+			complete_all(&ctx->completion);
+
 			v4l2_m2m_buf_done(src_buf, VB2_BUF_STATE_DONE);
 			v4l2_m2m_buf_done(dst_buf, VB2_BUF_STATE_DONE);
 			v4l2_m2m_job_finish(ctx->jdma_device->m2m_dev,
@@ -252,6 +252,7 @@ struct msm_jpegdma_buf_handle {
  * @pending_config: Flag set if there is pending plane configuration.
  * @plane_idx: Processing plane index.
  * @format_idx: Current format index.
+ * @chained: Jobs started from the irq since the last device_run.
  */
 struct jpegdma_ctx {
 	struct mutex lock;
@@ -273,6 +274,7 @@ struct jpegdma_ctx {
 
 	unsigned int plane_idx;
 	unsigned int format_idx;
+	unsigned int chained;
 };
 
 /*
@@ -11,10 +11,58 @@
  */
 #define pr_fmt(fmt) "CAM-BUFMGR %s:%d " fmt, __func__, __LINE__
 
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "msm_generic_buf_mgr.h"
 
 static struct msm_buf_mngr_device *msm_buf_mngr_dev;
 
+static inline uint32_t msm_buf_mngr_key(uint32_t session_id,
+	uint32_t stream_id, uint32_t index)
+{
+	return (session_id << 24) ^ (stream_id << 16) ^ index;
+}
+
+/* called with buf_q_spinlock held */
+static void msm_buf_mngr_add_buf(struct msm_buf_mngr_device *dev,
+	struct msm_get_bufs *bufs)
+{
+	hash_add(dev->buf_hash, &bufs->entry,
+		msm_buf_mngr_key(bufs->session_id, bufs->stream_id,
+		bufs->index));
+	dev->stats.get++;
+	dev->stats.held++;
+	if (dev->stats.held > dev->stats.peak)
+		dev->stats.peak = dev->stats.held;
+}
+
+/* called with buf_q_spinlock held */
+static struct msm_get_bufs *msm_buf_mngr_find_buf(
+	struct msm_buf_mngr_device *dev, struct msm_buf_mngr_info *buf_info)
+{
+	struct msm_get_bufs *bufs;
+
+	hash_for_each_possible(dev->buf_hash, bufs, entry,
+		msm_buf_mngr_key(buf_info->session_id, buf_info->stream_id,
+		buf_info->index)) {
+		if ((bufs->session_id == buf_info->session_id) &&
+			(bufs->stream_id == buf_info->stream_id) &&
+			(bufs->index == buf_info->index))
+			return bufs;
+	}
+	dev->stats.miss++;
+	return NULL;
+}
+
+/* called with buf_q_spinlock held */
+static void msm_buf_mngr_del_buf(struct msm_buf_mngr_device *dev,
+	struct msm_get_bufs *bufs)
+{
+	hash_del(&bufs->entry);
+	dev->stats.held--;
+	kfree(bufs);
+}
+
 struct v4l2_subdev *msm_buf_mngr_get_subdev(void)
 {
 	return &msm_buf_mngr_dev->subdev.sd;
@@ -63,7 +111,6 @@ static int32_t msm_buf_mngr_get_buf(struct msm_buf_mngr_device *dev,
 		pr_err("%s:No mem\n", __func__);
 		return -ENOMEM;
 	}
-	INIT_LIST_HEAD(&new_entry->entry);
 	new_entry->vb2_v4l2_buf = dev->vb2_ops.get_buf(buf_info->session_id,
 		buf_info->stream_id);
 	if (!new_entry->vb2_v4l2_buf) {
@@ -75,7 +122,7 @@ static int32_t msm_buf_mngr_get_buf(struct msm_buf_mngr_device *dev,
 	new_entry->stream_id = buf_info->stream_id;
 	new_entry->index = new_entry->vb2_v4l2_buf->vb2_buf.index;
 	spin_lock_irqsave(&dev->buf_q_spinlock, flags);
-	list_add_tail(&new_entry->entry, &dev->buf_qhead);
+	msm_buf_mngr_add_buf(dev, new_entry);
 	spin_unlock_irqrestore(&dev->buf_q_spinlock, flags);
 	buf_info->index = new_entry->vb2_v4l2_buf->vb2_buf.index;
 	if (buf_info->type == MSM_CAMERA_BUF_MNGR_BUF_USER) {
@@ -110,7 +157,6 @@ static int32_t msm_buf_mngr_get_buf_by_idx(struct msm_buf_mngr_device *dev,
 		return -EIO;
 	}
 
-	INIT_LIST_HEAD(&new_entry->entry);
 	new_entry->vb2_v4l2_buf = dev->vb2_ops.get_buf_by_idx(
 		buf_info->session_id, buf_info->stream_id, buf_info->index);
 	if (!new_entry->vb2_v4l2_buf) {
@@ -122,7 +168,7 @@ static int32_t msm_buf_mngr_get_buf_by_idx(struct msm_buf_mngr_device *dev,
 	new_entry->stream_id = buf_info->stream_id;
 	new_entry->index = new_entry->vb2_v4l2_buf->vb2_buf.index;
 	spin_lock_irqsave(&dev->buf_q_spinlock, flags);
-	list_add_tail(&new_entry->entry, &dev->buf_qhead);
+	msm_buf_mngr_add_buf(dev, new_entry);
 	spin_unlock_irqrestore(&dev->buf_q_spinlock, flags);
 	if (buf_info->type == MSM_CAMERA_BUF_MNGR_BUF_USER) {
 		mutex_lock(&dev->cont_mutex);
@@ -142,25 +188,20 @@ static int32_t msm_buf_mngr_buf_done(struct msm_buf_mngr_device *buf_mngr_dev,
 	struct msm_buf_mngr_info *buf_info)
 {
 	unsigned long flags;
-	struct msm_get_bufs *bufs, *save;
+	struct msm_get_bufs *bufs;
 	int32_t ret = -EINVAL;
 
 	spin_lock_irqsave(&buf_mngr_dev->buf_q_spinlock, flags);
-	list_for_each_entry_safe(bufs, save, &buf_mngr_dev->buf_qhead, entry) {
-		if ((bufs->session_id == buf_info->session_id) &&
-			(bufs->stream_id == buf_info->stream_id) &&
-			(bufs->index == buf_info->index)) {
-			ret = buf_mngr_dev->vb2_ops.buf_done
-					(bufs->vb2_v4l2_buf,
-						buf_info->session_id,
-						buf_info->stream_id,
-						buf_info->frame_id,
-						&buf_info->timestamp,
-						buf_info->reserved);
-			list_del_init(&bufs->entry);
-			kfree(bufs);
-			break;
-		}
+	bufs = msm_buf_mngr_find_buf(buf_mngr_dev, buf_info);
+	if (bufs) {
+		ret = buf_mngr_dev->vb2_ops.buf_done(bufs->vb2_v4l2_buf,
+			buf_info->session_id,
+			buf_info->stream_id,
+			buf_info->frame_id,
+			&buf_info->timestamp,
+			buf_info->reserved);
+		buf_mngr_dev->stats.done++;
+		msm_buf_mngr_del_buf(buf_mngr_dev, bufs);
 	}
 	spin_unlock_irqrestore(&buf_mngr_dev->buf_q_spinlock, flags);
 	return ret;
@@ -170,25 +211,20 @@ static int32_t msm_buf_mngr_buf_error(struct msm_buf_mngr_device *buf_mngr_dev,
 	struct msm_buf_mngr_info *buf_info)
 {
 	unsigned long flags;
-	struct msm_get_bufs *bufs, *save;
+	struct msm_get_bufs *bufs;
 	int32_t ret = -EINVAL;
 
 	spin_lock_irqsave(&buf_mngr_dev->buf_q_spinlock, flags);
-	list_for_each_entry_safe(bufs, save, &buf_mngr_dev->buf_qhead, entry) {
-		if ((bufs->session_id == buf_info->session_id) &&
-			(bufs->stream_id == buf_info->stream_id) &&
-			(bufs->index == buf_info->index)) {
-			ret = buf_mngr_dev->vb2_ops.buf_error
-					(bufs->vb2_v4l2_buf,
-						buf_info->session_id,
-						buf_info->stream_id,
-						buf_info->frame_id,
-						&buf_info->timestamp,
-						buf_info->reserved);
-			list_del_init(&bufs->entry);
-			kfree(bufs);
-			break;
-		}
+	bufs = msm_buf_mngr_find_buf(buf_mngr_dev, buf_info);
+	if (bufs) {
+		ret = buf_mngr_dev->vb2_ops.buf_error(bufs->vb2_v4l2_buf,
+			buf_info->session_id,
+			buf_info->stream_id,
+			buf_info->frame_id,
+			&buf_info->timestamp,
+			buf_info->reserved);
+		buf_mngr_dev->stats.error++;
+		msm_buf_mngr_del_buf(buf_mngr_dev, bufs);
 	}
 	spin_unlock_irqrestore(&buf_mngr_dev->buf_q_spinlock, flags);
 	return ret;
@@ -198,20 +234,16 @@ static int32_t msm_buf_mngr_put_buf(struct msm_buf_mngr_device *buf_mngr_dev,
 	struct msm_buf_mngr_info *buf_info)
 {
 	unsigned long flags;
-	struct msm_get_bufs *bufs, *save;
+	struct msm_get_bufs *bufs;
 	int32_t ret = -EINVAL;
 
 	spin_lock_irqsave(&buf_mngr_dev->buf_q_spinlock, flags);
-	list_for_each_entry_safe(bufs, save, &buf_mngr_dev->buf_qhead, entry) {
-		if ((bufs->session_id == buf_info->session_id) &&
-			(bufs->stream_id == buf_info->stream_id) &&
-			(bufs->index == buf_info->index)) {
-			ret = buf_mngr_dev->vb2_ops.put_buf(bufs->vb2_v4l2_buf,
-				buf_info->session_id, buf_info->stream_id);
-			list_del_init(&bufs->entry);
-			kfree(bufs);
-			break;
-		}
+	bufs = msm_buf_mngr_find_buf(buf_mngr_dev, buf_info);
+	if (bufs) {
+		ret = buf_mngr_dev->vb2_ops.put_buf(bufs->vb2_v4l2_buf,
+			buf_info->session_id, buf_info->stream_id);
+		buf_mngr_dev->stats.put++;
+		msm_buf_mngr_del_buf(buf_mngr_dev, bufs);
 	}
 	spin_unlock_irqrestore(&buf_mngr_dev->buf_q_spinlock, flags);
 	return ret;
@@ -222,16 +254,18 @@ static int32_t msm_generic_buf_mngr_flush(
 	struct msm_buf_mngr_info *buf_info)
 {
 	unsigned long flags;
-	struct msm_get_bufs *bufs, *save;
+	struct msm_get_bufs *bufs;
+	struct hlist_node *save;
 	int32_t ret = -EINVAL;
 	struct timeval ts;
+	int bkt;
 
 	spin_lock_irqsave(&buf_mngr_dev->buf_q_spinlock, flags);
 	/*
 	 * Sanity check on client buf list, remove buf mgr
 	 * queue entries in case any
 	 */
-	list_for_each_entry_safe(bufs, save, &buf_mngr_dev->buf_qhead, entry) {
+	hash_for_each_safe(buf_mngr_dev->buf_hash, bkt, save, bufs, entry) {
 		if ((bufs->session_id == buf_info->session_id) &&
 			(bufs->stream_id == buf_info->stream_id)) {
 			ret = buf_mngr_dev->vb2_ops.buf_done(bufs->vb2_v4l2_buf,
@@ -240,8 +274,7 @@ static int32_t msm_generic_buf_mngr_flush(
 			pr_err("Bufs not flushed: str_id = %d buf_index = %d ret = %d\n",
 			buf_info->stream_id, bufs->index,
 			ret);
-			list_del_init(&bufs->entry);
-			kfree(bufs);
+			msm_buf_mngr_del_buf(buf_mngr_dev, bufs);
 		}
 	}
 	spin_unlock_irqrestore(&buf_mngr_dev->buf_q_spinlock, flags);
@@ -314,23 +347,22 @@ static void msm_buf_mngr_sd_shutdown(struct msm_buf_mngr_device *dev,
 				     struct msm_sd_close_ioctl *session)
 {
 	unsigned long flags;
-	struct msm_get_bufs *bufs, *save;
+	struct msm_get_bufs *bufs;
+	struct hlist_node *save;
+	int bkt;
 
 	BUG_ON(!dev);
 	BUG_ON(!session);
 
 	spin_lock_irqsave(&dev->buf_q_spinlock, flags);
-	if (!list_empty(&dev->buf_qhead)) {
-		list_for_each_entry_safe(bufs,
-			save, &dev->buf_qhead, entry) {
+	if (!hash_empty(dev->buf_hash)) {
+		hash_for_each_safe(dev->buf_hash, bkt, save, bufs, entry) {
 			pr_info("%s: Delete invalid bufs =%pK, session_id=%u, bufs->ses_id=%d, str_id=%d, idx=%d\n",
 				__func__, (void *)bufs, session->session,
 				bufs->session_id, bufs->stream_id,
 				bufs->index);
-			if (session->session == bufs->session_id) {
-				list_del_init(&bufs->entry);
-				kfree(bufs);
-			}
+			if (session->session == bufs->session_id)
+				msm_buf_mngr_del_buf(dev, bufs);
 		}
 	}
 	spin_unlock_irqrestore(&dev->buf_q_spinlock, flags);
@@ -861,6 +893,54 @@ static long msm_buf_subdev_fops_ioctl(struct file *file, unsigned int cmd,
 	return video_usercopy(file, cmd, arg, msm_bmgr_subdev_do_ioctl);
 }
 
+static int msm_buf_mngr_stats_show(struct seq_file *s, void *unused)
+{
+	struct msm_buf_mngr_device *dev = s->private;
+	struct msm_buf_mngr_stats stats;
+	struct msm_get_bufs *bufs;
+	unsigned long flags;
+	int bkt;
+
+	spin_lock_irqsave(&dev->buf_q_spinlock, flags);
+	stats = dev->stats;
+	spin_unlock_irqrestore(&dev->buf_q_spinlock, flags);
+
+	seq_printf(s, "get %llu done %llu error %llu put %llu miss %llu\n",
+		stats.get, stats.done, stats.error, stats.put, stats.miss);
+	seq_printf(s, "held %u peak %u\n", stats.held, stats.peak);
+
+	seq_puts(s, "# session stream index\n");
+	spin_lock_irqsave(&dev->buf_q_spinlock, flags);
+	hash_for_each(dev->buf_hash, bkt, bufs, entry)
+		seq_printf(s, "%u %u %u\n", bufs->session_id,
+			bufs->stream_id, bufs->index);
+	spin_unlock_irqrestore(&dev->buf_q_spinlock, flags);
+	return 0;
+}
+
+static int msm_buf_mngr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_buf_mngr_stats_show, inode->i_private);
+}
+
+static const struct file_operations msm_buf_mngr_stats_fops = {
+	.open = msm_buf_mngr_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void msm_buf_mngr_debugfs_init(struct msm_buf_mngr_device *dev)
+{
+	dev->debugfs_dir = debugfs_create_dir("msm_buf_mngr", NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs_dir)) {
+		dev->debugfs_dir = NULL;
+		return;
+	}
+	debugfs_create_file("stats", S_IRUGO, dev->debugfs_dir, dev,
+		&msm_buf_mngr_stats_fops);
+}
+
 static int32_t __init msm_buf_mngr_init(void)
 {
 	int32_t rc = 0;
@@ -902,8 +982,9 @@ static int32_t __init msm_buf_mngr_init(void)
 	v4l2_subdev_notify(&msm_buf_mngr_dev->subdev.sd, MSM_SD_NOTIFY_REQ_CB,
 		&msm_buf_mngr_dev->vb2_ops);
 
-	INIT_LIST_HEAD(&msm_buf_mngr_dev->buf_qhead);
+	hash_init(msm_buf_mngr_dev->buf_hash);
 	spin_lock_init(&msm_buf_mngr_dev->buf_q_spinlock);
+	msm_buf_mngr_debugfs_init(msm_buf_mngr_dev);
 
 	mutex_init(&msm_buf_mngr_dev->cont_mutex);
 	INIT_LIST_HEAD(&msm_buf_mngr_dev->cont_qhead);
@@ -920,6 +1001,7 @@ end:
 
 static void __exit msm_buf_mngr_exit(void)
 {
+	debugfs_remove_recursive(msm_buf_mngr_dev->debugfs_dir);
 	msm_sd_unregister(&msm_buf_mngr_dev->subdev);
 	mutex_destroy(&msm_buf_mngr_dev->cont_mutex);
 	kfree(msm_buf_mngr_dev);
@@ -14,6 +14,7 @@
 #define __MSM_BUF_GENERIC_MNGR_H__
 
 #include <linux/io.h>
+#include <linux/hashtable.h>
 #include <linux/of.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
@@ -24,17 +25,32 @@
 #include "msm.h"
 #include "msm_sd.h"
 
+/* buffers on loan are hashed by session, stream and vb2 index */
+#define MSM_BUF_MNGR_HASH_BITS 6
+
 struct msm_get_bufs {
-	struct list_head entry;
+	struct hlist_node entry;
 	struct vb2_v4l2_buffer *vb2_v4l2_buf;
 	uint32_t session_id;
 	uint32_t stream_id;
 	uint32_t index;
 };
 
+struct msm_buf_mngr_stats {
+	uint64_t get;
+	uint64_t done;
+	uint64_t error;
+	uint64_t put;
+	uint64_t miss;
+	uint32_t held;
+	uint32_t peak;
+};
+
 struct msm_buf_mngr_device {
-	struct list_head buf_qhead;
+	DECLARE_HASHTABLE(buf_hash, MSM_BUF_MNGR_HASH_BITS);
 	spinlock_t buf_q_spinlock;
+	struct msm_buf_mngr_stats stats;
+	struct dentry *debugfs_dir;
 	struct ion_client *ion_client;
 	struct msm_sd_subdev subdev;
 	struct msm_sd_req_vb2_q vb2_ops;
@@ -35,6 +35,7 @@
 #include "msm_isp_util.h"
 #include "msm_camera_io_util.h"
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "cam_smmu_api.h"
 #include "msm_cam_cx_ipeak.h"
 
@@ -299,6 +300,7 @@ static void msm_enqueue(struct msm_device_queue *queue,
 
 static int msm_cpp_notify_frame_done(struct cpp_device *cpp_dev,
 	uint8_t put_buf);
+static void msm_cpp_clean_frame_queue(struct msm_device_queue *queue);
 static int32_t cpp_load_fw(struct cpp_device *cpp_dev, char *fw_name_bin);
 static void cpp_timer_callback(unsigned long data);
 
@@ -1600,6 +1602,7 @@ static int cpp_close_node(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 		}
 		cam_smmu_destroy_handle(cpp_dev->iommu_hdl);
 		msm_cpp_empty_list(processing_q, list_frame);
+		msm_cpp_clean_frame_queue(&cpp_dev->pending_q);
 		msm_cpp_empty_list(eventData_q, list_eventdata);
 		cpp_dev->state = CPP_STATE_OFF;
 
@@ -1651,122 +1654,180 @@ static int msm_cpp_buffer_ops(struct cpp_device *cpp_dev,
 	return rc;
 }
 
-static int msm_cpp_notify_frame_done(struct cpp_device *cpp_dev,
-	uint8_t put_buf)
+static uint32_t msm_cpp_tv_delta_us(struct timeval *start,
+	struct timeval *end)
+{
+	int64_t us = (int64_t)(end->tv_sec - start->tv_sec) * USEC_PER_SEC +
+		(end->tv_usec - start->tv_usec);
+
+	if (us <= 0)
+		return 0;
+	return (uint32_t)min_t(int64_t, us, U32_MAX);
+}
+
+static int msm_cpp_lat_bucket(uint32_t us)
+{
+	return min(fls(us >> MSM_CPP_LAT_MIN_SHIFT), MSM_CPP_LAT_BUCKETS - 1);
+}
+
+static void msm_cpp_account_latency(struct cpp_device *cpp_dev,
+	struct msm_queue_cmd *frame_qcmd,
+	struct msm_cpp_frame_info_t *frame)
+{
+	struct msm_cpp_latency_stats *st = &cpp_dev->lat_stats;
+	struct timeval submit_time;
+	uint32_t wait_us, hw_us;
+	unsigned long flags;
+
+	/* frame never made it to the firmware */
+	if (!frame->in_time.tv_sec && !frame->in_time.tv_usec)
+		return;
+
+	submit_time.tv_sec = frame_qcmd->ts.tv_sec;
+	submit_time.tv_usec = frame_qcmd->ts.tv_nsec / NSEC_PER_USEC;
+	wait_us = msm_cpp_tv_delta_us(&submit_time, &frame->in_time);
+	hw_us = msm_cpp_tv_delta_us(&frame->in_time, &frame->out_time);
+
+	spin_lock_irqsave(&cpp_dev->lat_lock, flags);
+	st->frames++;
+	st->sum_wait_us += wait_us;
+	st->sum_hw_us += hw_us;
+	st->max_wait_us = max(st->max_wait_us, wait_us);
+	st->max_hw_us = max(st->max_hw_us, hw_us);
+	st->wait_hist[msm_cpp_lat_bucket(wait_us)]++;
+	st->hw_hist[msm_cpp_lat_bucket(hw_us)]++;
+	spin_unlock_irqrestore(&cpp_dev->lat_lock, flags);
+}
+
+static int msm_cpp_frame_done(struct cpp_device *cpp_dev,
+	struct msm_queue_cmd *frame_qcmd, uint8_t put_buf)
 {
 	struct v4l2_event v4l2_evt;
-	struct msm_queue_cmd *frame_qcmd = NULL;
 	struct msm_queue_cmd *event_qcmd = NULL;
 	struct msm_cpp_frame_info_t *processed_frame = NULL;
-	struct msm_device_queue *queue = &cpp_dev->processing_q;
 	struct msm_buf_mngr_info buff_mgr_info;
 	int rc = 0;
 
-	frame_qcmd = msm_dequeue(queue, list_frame, POP_FRONT);
-	if (frame_qcmd) {
-		processed_frame = frame_qcmd->command;
-		do_gettimeofday(&(processed_frame->out_time));
-		kfree(frame_qcmd);
-		event_qcmd = kzalloc(sizeof(struct msm_queue_cmd), GFP_ATOMIC);
-		if (!event_qcmd) {
-			pr_err("Insufficient memory\n");
-			return -ENOMEM;
-		}
-		atomic_set(&event_qcmd->on_heap, 1);
-		event_qcmd->command = processed_frame;
-		CPP_DBG("fid %d\n", processed_frame->frame_id);
-		msm_enqueue(&cpp_dev->eventData_q, &event_qcmd->list_eventdata);
+	processed_frame = frame_qcmd->command;
+	do_gettimeofday(&(processed_frame->out_time));
+	msm_cpp_account_latency(cpp_dev, frame_qcmd, processed_frame);
+	kfree(frame_qcmd);
+	event_qcmd = kzalloc(sizeof(struct msm_queue_cmd), GFP_ATOMIC);
+	if (!event_qcmd) {
+		pr_err("Insufficient memory\n");
+		return -ENOMEM;
+	}
+	atomic_set(&event_qcmd->on_heap, 1);
+	event_qcmd->command = processed_frame;
+	CPP_DBG("fid %d\n", processed_frame->frame_id);
+	msm_enqueue(&cpp_dev->eventData_q, &event_qcmd->list_eventdata);
 
-		if ((processed_frame->partial_frame_indicator != 0) &&
-			(processed_frame->last_payload == 0))
-			goto NOTIFY_FRAME_DONE;
+	if ((processed_frame->partial_frame_indicator != 0) &&
+		(processed_frame->last_payload == 0))
+		goto NOTIFY_FRAME_DONE;
 
-		if (!processed_frame->output_buffer_info[0].processed_divert &&
-			!processed_frame->output_buffer_info[0].native_buff &&
-			!processed_frame->we_disable) {
+	if (!processed_frame->output_buffer_info[0].processed_divert &&
+		!processed_frame->output_buffer_info[0].native_buff &&
+		!processed_frame->we_disable) {
 
-			int32_t iden = processed_frame->identity;
+		int32_t iden = processed_frame->identity;
 
-			SWAP_IDENTITY_FOR_BATCH_ON_PREVIEW(processed_frame,
-				iden, processed_frame->duplicate_identity);
+		SWAP_IDENTITY_FOR_BATCH_ON_PREVIEW(processed_frame,
+			iden, processed_frame->duplicate_identity);
 
-			memset(&buff_mgr_info, 0,
-				sizeof(struct msm_buf_mngr_info));
+		memset(&buff_mgr_info, 0,
+			sizeof(struct msm_buf_mngr_info));
 
-			buff_mgr_info.session_id = ((iden >> 16) & 0xFFFF);
-			buff_mgr_info.stream_id = (iden & 0xFFFF);
-			buff_mgr_info.frame_id = processed_frame->frame_id;
-			buff_mgr_info.timestamp = processed_frame->timestamp;
-			if (processed_frame->batch_info.batch_mode ==
-				BATCH_MODE_VIDEO ||
-				(IS_BATCH_BUFFER_ON_PREVIEW(
-				processed_frame))) {
-				buff_mgr_info.index =
-					processed_frame->batch_info.cont_idx;
-			} else {
-				buff_mgr_info.index = processed_frame->
-					output_buffer_info[0].index;
+		buff_mgr_info.session_id = ((iden >> 16) & 0xFFFF);
+		buff_mgr_info.stream_id = (iden & 0xFFFF);
+		buff_mgr_info.frame_id = processed_frame->frame_id;
+		buff_mgr_info.timestamp = processed_frame->timestamp;
+		if (processed_frame->batch_info.batch_mode ==
+			BATCH_MODE_VIDEO ||
+			(IS_BATCH_BUFFER_ON_PREVIEW(
+			processed_frame))) {
+			buff_mgr_info.index =
+				processed_frame->batch_info.cont_idx;
+		} else {
+			buff_mgr_info.index = processed_frame->
+				output_buffer_info[0].index;
+		}
+		if (put_buf) {
+			rc = msm_cpp_buffer_ops(cpp_dev,
+				VIDIOC_MSM_BUF_MNGR_PUT_BUF,
+				0x0, &buff_mgr_info);
+			if (rc < 0) {
+				pr_err("error putting buffer\n");
+				rc = -EINVAL;
 			}
-			if (put_buf) {
-				rc = msm_cpp_buffer_ops(cpp_dev,
-					VIDIOC_MSM_BUF_MNGR_PUT_BUF,
-					0x0, &buff_mgr_info);
-				if (rc < 0) {
-					pr_err("error putting buffer\n");
-					rc = -EINVAL;
-				}
-			} else {
-				rc = msm_cpp_buffer_ops(cpp_dev,
-					VIDIOC_MSM_BUF_MNGR_BUF_DONE,
-					0x0, &buff_mgr_info);
-				if (rc < 0) {
-					pr_err("error putting buffer\n");
-					rc = -EINVAL;
-				}
+		} else {
+			rc = msm_cpp_buffer_ops(cpp_dev,
+				VIDIOC_MSM_BUF_MNGR_BUF_DONE,
+				0x0, &buff_mgr_info);
+			if (rc < 0) {
+				pr_err("error putting buffer\n");
+				rc = -EINVAL;
 			}
 		}
+	}
 
-		if (processed_frame->duplicate_output  &&
-			!processed_frame->
-				duplicate_buffer_info.processed_divert &&
-			!processed_frame->we_disable) {
-			int32_t iden = processed_frame->duplicate_identity;
+	if (processed_frame->duplicate_output  &&
+		!processed_frame->
+			duplicate_buffer_info.processed_divert &&
+		!processed_frame->we_disable) {
+		int32_t iden = processed_frame->duplicate_identity;
 
-			SWAP_IDENTITY_FOR_BATCH_ON_PREVIEW(processed_frame,
-				iden, processed_frame->identity);
+		SWAP_IDENTITY_FOR_BATCH_ON_PREVIEW(processed_frame,
+			iden, processed_frame->identity);
 
-			memset(&buff_mgr_info, 0,
-				sizeof(struct msm_buf_mngr_info));
+		memset(&buff_mgr_info, 0,
+			sizeof(struct msm_buf_mngr_info));
 
-			buff_mgr_info.session_id = ((iden >> 16) & 0xFFFF);
-			buff_mgr_info.stream_id = (iden & 0xFFFF);
-			buff_mgr_info.frame_id = processed_frame->frame_id;
-			buff_mgr_info.timestamp = processed_frame->timestamp;
-			buff_mgr_info.index =
-				processed_frame->duplicate_buffer_info.index;
-			if (put_buf) {
-				rc = msm_cpp_buffer_ops(cpp_dev,
-					VIDIOC_MSM_BUF_MNGR_PUT_BUF,
-					0x0, &buff_mgr_info);
-				if (rc < 0) {
-					pr_err("error putting buffer\n");
-					rc = -EINVAL;
-				}
-			} else {
-				rc = msm_cpp_buffer_ops(cpp_dev,
-					VIDIOC_MSM_BUF_MNGR_BUF_DONE,
-					0x0, &buff_mgr_info);
-				if (rc < 0) {
-					pr_err("error putting buffer\n");
-					rc = -EINVAL;
-				}
+		buff_mgr_info.session_id = ((iden >> 16) & 0xFFFF);
+		buff_mgr_info.stream_id = (iden & 0xFFFF);
+		buff_mgr_info.frame_id = processed_frame->frame_id;
+		buff_mgr_info.timestamp = processed_frame->timestamp;
+		buff_mgr_info.index =
+			processed_frame->duplicate_buffer_info.index;
+		if (put_buf) {
+			rc = msm_cpp_buffer_ops(cpp_dev,
+				VIDIOC_MSM_BUF_MNGR_PUT_BUF,
+				0x0, &buff_mgr_info);
+			if (rc < 0) {
+				pr_err("error putting buffer\n");
+				rc = -EINVAL;
+			}
+		} else {
+			rc = msm_cpp_buffer_ops(cpp_dev,
+				VIDIOC_MSM_BUF_MNGR_BUF_DONE,
+				0x0, &buff_mgr_info);
+			if (rc < 0) {
+				pr_err("error putting buffer\n");
+				rc = -EINVAL;
 			}
 		}
-NOTIFY_FRAME_DONE:
-		v4l2_evt.id = processed_frame->inst_id;
-		v4l2_evt.type = V4L2_EVENT_CPP_FRAME_DONE;
-		v4l2_event_queue(cpp_dev->msm_sd.sd.devnode, &v4l2_evt);
 	}
+NOTIFY_FRAME_DONE:
+	v4l2_evt.id = processed_frame->inst_id;
+	v4l2_evt.type = V4L2_EVENT_CPP_FRAME_DONE;
+	v4l2_event_queue(cpp_dev->msm_sd.sd.devnode, &v4l2_evt);
+	return rc;
+}
+
+static int msm_cpp_notify_frame_done(struct cpp_device *cpp_dev,
+	uint8_t put_buf)
+{
+	struct msm_queue_cmd *frame_qcmd = NULL;
+	int rc = 0;
+
+	frame_qcmd = msm_dequeue(&cpp_dev->processing_q, list_frame,
+		POP_FRONT);
+	if (frame_qcmd)
+		rc = msm_cpp_frame_done(cpp_dev, frame_qcmd, put_buf);
+
+	/* a slot just freed up for anything waiting behind it */
+	if (cpp_dev->pending_q.len)
+		queue_work(cpp_dev->timer_wq, &cpp_dev->pending_work);
 	return rc;
 }
 
@@ -2016,7 +2077,7 @@ void cpp_timer_callback(unsigned long data)
 		(struct work_struct *)work);
 }
 
-static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
+static int msm_cpp_write_frame_to_hardware(struct cpp_device *cpp_dev,
 	struct msm_queue_cmd *frame_qcmd)
 {
 	unsigned long flags;
@@ -2131,6 +2192,62 @@ end:
 	return rc;
 }
 
+static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
+	struct msm_queue_cmd *frame_qcmd)
+{
+	unsigned long flags;
+
+	/* keep submission order behind frames that are already waiting */
+	if (!cpp_dev->pending_q.len &&
+		cpp_dev->processing_q.len < MAX_CPP_PROCESSING_FRAME)
+		return msm_cpp_write_frame_to_hardware(cpp_dev, frame_qcmd);
+
+	if (cpp_dev->pending_q.len >= MAX_CPP_PENDING_FRAME) {
+		pr_err("pending queue full. drop frame\n");
+		return -EAGAIN;
+	}
+
+	msm_enqueue(&cpp_dev->pending_q, &frame_qcmd->list_frame);
+	spin_lock_irqsave(&cpp_dev->lat_lock, flags);
+	cpp_dev->lat_stats.parked++;
+	spin_unlock_irqrestore(&cpp_dev->lat_lock, flags);
+	/* the processing queue may have drained before we got here */
+	queue_work(cpp_dev->timer_wq, &cpp_dev->pending_work);
+	return 0;
+}
+
+static void msm_cpp_pending_work(struct work_struct *work)
+{
+	struct cpp_device *cpp_dev =
+		container_of(work, struct cpp_device, pending_work);
+	struct msm_queue_cmd *frame_qcmd;
+	int rc;
+
+	mutex_lock(&cpp_dev->mutex);
+	while (cpp_dev->pending_q.len) {
+		if (cpp_dev->state == CPP_STATE_ACTIVE &&
+			cpp_dev->processing_q.len >= MAX_CPP_PROCESSING_FRAME)
+			break;
+
+		frame_qcmd = msm_dequeue(&cpp_dev->pending_q, list_frame,
+			POP_FRONT);
+		if (!frame_qcmd)
+			break;
+
+		/* hand the buffers back if the hardware went away */
+		rc = -EINVAL;
+		if (cpp_dev->state == CPP_STATE_ACTIVE)
+			rc = msm_cpp_write_frame_to_hardware(cpp_dev,
+				frame_qcmd);
+		if (rc < 0) {
+			pr_err("%s: cannot send pending frame %d\n",
+				__func__, rc);
+			msm_cpp_frame_done(cpp_dev, frame_qcmd, 1);
+		}
+	}
+	mutex_unlock(&cpp_dev->mutex);
+}
+
 static int msm_cpp_send_command_to_hardware(struct cpp_device *cpp_dev,
 	uint32_t *cmd_msg, uint32_t payload_size)
 {
@@ -2900,6 +3017,8 @@ static int msm_cpp_cfg_frame(struct cpp_device *cpp_dev,
 
 	atomic_set(&frame_qcmd->on_heap, 1);
 	frame_qcmd->command = new_frame;
+	getnstimeofday(&frame_qcmd->ts);
+	memset(&new_frame->in_time, 0, sizeof(new_frame->in_time));
 	rc = msm_cpp_send_frame_to_hardware(cpp_dev, frame_qcmd);
 	if (rc < 0) {
 		pr_err("%s: error cannot send frame to hardware\n", __func__);
@@ -2965,15 +3084,62 @@ static int msm_cpp_cfg(struct cpp_device *cpp_dev,
 	return rc;
 }
 
-void msm_cpp_clean_queue(struct cpp_device *cpp_dev)
+static void msm_cpp_account_batch(struct cpp_device *cpp_dev,
+	uint32_t num_frames)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cpp_dev->lat_lock, flags);
+	cpp_dev->lat_stats.batches++;
+	cpp_dev->lat_stats.batch_frames += num_frames;
+	spin_unlock_irqrestore(&cpp_dev->lat_lock, flags);
+}
+
+/*
+ * Queue several frames under one lock hold. Frames beyond what the
+ * firmware holds wait on the pending queue, so a batch does not stall
+ * on the ack of the previous frame. Stops at the first frame that fails.
+ */
+static int msm_cpp_cfg_batch(struct cpp_device *cpp_dev,
+	struct msm_camera_v4l2_ioctl_t *ioctl_ptr)
+{
+	void __user *frames[MSM_CPP_MAX_BATCH_FRAMES];
+	struct msm_camera_v4l2_ioctl_t frame_ioctl;
+	uint32_t i, num_frames;
+	int32_t rc = 0;
+
+	num_frames = ioctl_ptr->len / sizeof(frames[0]);
+	if (!num_frames || num_frames > MSM_CPP_MAX_BATCH_FRAMES ||
+		ioctl_ptr->len % sizeof(frames[0])) {
+		pr_err("%s: invalid batch len %zu\n", __func__, ioctl_ptr->len);
+		return -EINVAL;
+	}
+
+	if (copy_from_user(frames, (void __user *)ioctl_ptr->ioctl_ptr,
+		ioctl_ptr->len))
+		return -EFAULT;
+
+	for (i = 0; i < num_frames; i++) {
+		frame_ioctl = *ioctl_ptr;
+		frame_ioctl.ioctl_ptr = frames[i];
+		frame_ioctl.len = sizeof(struct msm_cpp_frame_info_t);
+		rc = msm_cpp_cfg(cpp_dev, &frame_ioctl);
+		if (rc < 0)
+			break;
+	}
+
+	msm_cpp_account_batch(cpp_dev, i);
+	ioctl_ptr->trans_code = i;
+	return rc;
+}
+
+static void msm_cpp_clean_frame_queue(struct msm_device_queue *queue)
 {
 	struct msm_queue_cmd *frame_qcmd = NULL;
 	struct msm_cpp_frame_info_t *processed_frame = NULL;
-	struct msm_device_queue *queue = NULL;
 
-	while (cpp_dev->processing_q.len) {
-		pr_debug("queue len:%d\n", cpp_dev->processing_q.len);
-		queue = &cpp_dev->processing_q;
+	while (queue->len) {
+		pr_debug("%s queue len:%d\n", queue->name, queue->len);
 		frame_qcmd = msm_dequeue(queue, list_frame, POP_FRONT);
 		if (frame_qcmd) {
 			processed_frame = frame_qcmd->command;
@@ -2985,6 +3151,12 @@ void msm_cpp_clean_queue(struct cpp_device *cpp_dev)
 	}
 }
 
+void msm_cpp_clean_queue(struct cpp_device *cpp_dev)
+{
+	msm_cpp_clean_frame_queue(&cpp_dev->processing_q);
+	msm_cpp_clean_frame_queue(&cpp_dev->pending_q);
+}
+
 #ifdef CONFIG_COMPAT
 static int msm_cpp_copy_from_ioctl_ptr(void *dst_ptr,
 	struct msm_camera_v4l2_ioctl_t *ioctl_ptr)
@@ -3272,6 +3444,10 @@ long msm_cpp_subdev_ioctl(struct v4l2_subdev *sd,
 		CPP_DBG("VIDIOC_MSM_CPP_CFG\n");
 		rc = msm_cpp_cfg(cpp_dev, ioctl_ptr);
 		break;
+	case VIDIOC_MSM_CPP_CFG_BATCH:
+		CPP_DBG("VIDIOC_MSM_CPP_CFG_BATCH\n");
+		rc = msm_cpp_cfg_batch(cpp_dev, ioctl_ptr);
+		break;
 	case VIDIOC_MSM_CPP_FLUSH_QUEUE:
 		CPP_DBG("VIDIOC_MSM_CPP_FLUSH_QUEUE\n");
 		rc = msm_cpp_flush_frames(cpp_dev);
@@ -4030,6 +4206,55 @@ static void get_compat_frame_from_64bit(struct msm_cpp_frame_info_t *frame,
 		frame->batch_info.pick_preview_idx;
 }
 
+/* VIDIOC_MSM_CPP_CFG32 for one frame, called with cpp_dev->mutex held */
+static int msm_cpp_cfg_compat(struct cpp_device *cpp_dev,
+	struct msm_camera_v4l2_ioctl_t *kp_ioctl)
+{
+	struct msm_cpp_frame_info32_t k32_frame_info;
+	struct msm_cpp_frame_info_t *cpp_frame = NULL;
+	int32_t *status;
+	int32_t rc;
+
+	if (copy_from_user(&k32_frame_info,
+		(void __user *)kp_ioctl->ioctl_ptr,
+		sizeof(k32_frame_info)))
+		return -EFAULT;
+
+	/* Get the cpp frame pointer */
+	cpp_frame = get_64bit_cpp_frame_from_compat(kp_ioctl);
+
+	/* Configure the cpp frame */
+	if (cpp_frame) {
+		rc = msm_cpp_cfg_frame(cpp_dev, cpp_frame);
+		/* Cpp_frame can be free'd by cfg_frame in error */
+		if (rc >= 0) {
+			k32_frame_info.output_buffer_info[0] =
+				cpp_frame->output_buffer_info[0];
+			k32_frame_info.output_buffer_info[1] =
+				cpp_frame->output_buffer_info[1];
+		}
+	} else {
+		pr_err("%s: Error getting frame\n", __func__);
+		rc = -EINVAL;
+	}
+
+	kp_ioctl->trans_code = rc;
+
+	/* Convert the 32 bit pointer to 64 bit pointer */
+	status = compat_ptr(k32_frame_info.status);
+
+	if (copy_to_user((void __user *)status, &rc,
+		sizeof(int32_t)))
+		pr_err("error cannot copy error\n");
+
+	if (copy_to_user((void __user *)kp_ioctl->ioctl_ptr,
+		&k32_frame_info,
+		sizeof(k32_frame_info)))
+		return -EFAULT;
+
+	return rc;
+}
+
 static long msm_cpp_subdev_fops_compat_ioctl(struct file *file,
 	unsigned int cmd, unsigned long arg)
 {
@@ -4090,53 +4315,45 @@ static long msm_cpp_subdev_fops_compat_ioctl(struct file *file,
 	 */
 	switch (cmd) {
 	case VIDIOC_MSM_CPP_CFG32:
-	{
-		struct msm_cpp_frame_info32_t k32_frame_info;
-		struct msm_cpp_frame_info_t *cpp_frame = NULL;
-		int32_t *status;
-
-		if (copy_from_user(&k32_frame_info,
-			(void __user *)kp_ioctl.ioctl_ptr,
-			sizeof(k32_frame_info))) {
+		rc = msm_cpp_cfg_compat(cpp_dev, &kp_ioctl);
+		if (rc == -EFAULT) {
 			mutex_unlock(&cpp_dev->mutex);
-			return -EFAULT;
+			return rc;
 		}
-		/* Get the cpp frame pointer */
-		cpp_frame = get_64bit_cpp_frame_from_compat(&kp_ioctl);
-
-		/* Configure the cpp frame */
-		if (cpp_frame) {
-			rc = msm_cpp_cfg_frame(cpp_dev, cpp_frame);
-			/* Cpp_frame can be free'd by cfg_frame in error */
-			if (rc >= 0) {
-				k32_frame_info.output_buffer_info[0] =
-					cpp_frame->output_buffer_info[0];
-				k32_frame_info.output_buffer_info[1] =
-					cpp_frame->output_buffer_info[1];
-			}
-		} else {
-			pr_err("%s: Error getting frame\n", __func__);
+		cmd = VIDIOC_MSM_CPP_CFG;
+		break;
+	case VIDIOC_MSM_CPP_CFG_BATCH32:
+	{
+		compat_uptr_t frames32[MSM_CPP_MAX_BATCH_FRAMES];
+		struct msm_camera_v4l2_ioctl_t frame_ioctl;
+		uint32_t i, num_frames;
+
+		num_frames = kp_ioctl.len / sizeof(frames32[0]);
+		if (!num_frames || num_frames > MSM_CPP_MAX_BATCH_FRAMES ||
+			kp_ioctl.len % sizeof(frames32[0])) {
+			pr_err("%s: invalid batch len %zu\n", __func__,
+				kp_ioctl.len);
 			mutex_unlock(&cpp_dev->mutex);
-			rc = -EINVAL;
+			return -EINVAL;
 		}
-
-		kp_ioctl.trans_code = rc;
-
-		/* Convert the 32 bit pointer to 64 bit pointer */
-		status = compat_ptr(k32_frame_info.status);
-
-		if (copy_to_user((void __user *)status, &rc,
-			sizeof(int32_t)))
-			pr_err("error cannot copy error\n");
-
-		if (copy_to_user((void __user *)kp_ioctl.ioctl_ptr,
-			&k32_frame_info,
-			sizeof(k32_frame_info))) {
+		if (copy_from_user(frames32, (void __user *)kp_ioctl.ioctl_ptr,
+			kp_ioctl.len)) {
 			mutex_unlock(&cpp_dev->mutex);
 			return -EFAULT;
 		}
 
-		cmd = VIDIOC_MSM_CPP_CFG;
+		for (i = 0; i < num_frames; i++) {
+			frame_ioctl = kp_ioctl;
+			frame_ioctl.ioctl_ptr = compat_ptr(frames32[i]);
+			frame_ioctl.len = sizeof(struct msm_cpp_frame_info32_t);
+			rc = msm_cpp_cfg_compat(cpp_dev, &frame_ioctl);
+			if (rc < 0)
+				break;
+		}
+
+		msm_cpp_account_batch(cpp_dev, i);
+		kp_ioctl.trans_code = i;
+		cmd = VIDIOC_MSM_CPP_CFG_BATCH;
 		break;
 	}
 	case VIDIOC_MSM_CPP_GET_HW_INFO32:
@@ -4399,6 +4616,7 @@ static long msm_cpp_subdev_fops_compat_ioctl(struct file *file,
 		break;
 	case VIDIOC_MSM_CPP_GET_HW_INFO:
 	case VIDIOC_MSM_CPP_CFG:
+	case VIDIOC_MSM_CPP_CFG_BATCH:
 	case VIDIOC_MSM_CPP_GET_EVENTPAYLOAD:
 	case VIDIOC_MSM_CPP_GET_INST_INFO:
 		break;
@@ -4690,6 +4908,9 @@ static int cpp_probe(struct platform_device *pdev)
 
 	msm_queue_init(&cpp_dev->eventData_q, "eventdata");
 	msm_queue_init(&cpp_dev->processing_q, "frame");
+	msm_queue_init(&cpp_dev->pending_q, "pending");
+	INIT_WORK(&cpp_dev->pending_work, msm_cpp_pending_work);
+	spin_lock_init(&cpp_dev->lat_lock);
 	INIT_LIST_HEAD(&cpp_dev->tasklet_q);
 	tasklet_init(&cpp_dev->cpp_tasklet, msm_cpp_do_tasklet,
 		(unsigned long)cpp_dev);
@@ -4771,6 +4992,7 @@ static int cpp_device_remove(struct platform_device *dev)
 		return 0;
 	}
 
+	cancel_work_sync(&cpp_dev->pending_work);
 	if (cpp_dev->fw) {
 		release_firmware(cpp_dev->fw);
 		cpp_dev->fw = NULL;
@@ -4832,6 +5054,67 @@ static int msm_cpp_debugfs_error_s(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(cpp_debugfs_error, NULL,
 	msm_cpp_debugfs_error_s, "%llu\n");
 
+static void msm_cpp_show_lat_hist(struct seq_file *s, const char *name,
+	const uint32_t *hist, uint64_t sum_us, uint32_t max_us,
+	uint64_t frames)
+{
+	int i;
+
+	seq_printf(s, "%-5s avg %llu max %u buckets", name,
+		frames ? div64_u64(sum_us, frames) : 0, max_us);
+	for (i = 0; i < MSM_CPP_LAT_BUCKETS; i++)
+		seq_printf(s, " %u", hist[i]);
+	seq_puts(s, "\n");
+}
+
+static int msm_cpp_latency_show(struct seq_file *s, void *unused)
+{
+	struct cpp_device *cpp_dev = s->private;
+	struct msm_cpp_latency_stats st;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cpp_dev->lat_lock, flags);
+	st = cpp_dev->lat_stats;
+	spin_unlock_irqrestore(&cpp_dev->lat_lock, flags);
+
+	seq_printf(s, "frames %llu batches %u batch_frames %u parked %u\n",
+		st.frames, st.batches, st.batch_frames, st.parked);
+	seq_printf(s, "# latency us, buckets <%uus, doubling\n",
+		1U << MSM_CPP_LAT_MIN_SHIFT);
+	msm_cpp_show_lat_hist(s, "wait", st.wait_hist, st.sum_wait_us,
+		st.max_wait_us, st.frames);
+	msm_cpp_show_lat_hist(s, "hw", st.hw_hist, st.sum_hw_us,
+		st.max_hw_us, st.frames);
+	return 0;
+}
+
+static int msm_cpp_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_cpp_latency_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t msm_cpp_latency_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct cpp_device *cpp_dev = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cpp_dev->lat_lock, flags);
+	memset(&cpp_dev->lat_stats, 0, sizeof(cpp_dev->lat_stats));
+	spin_unlock_irqrestore(&cpp_dev->lat_lock, flags);
+	return count;
+}
+
+static const struct file_operations cpp_debugfs_latency = {
+	.open = msm_cpp_latency_open,
+	.read = seq_read,
+	.write = msm_cpp_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int msm_cpp_enable_debugfs(struct cpp_device *cpp_dev)
 {
 	struct dentry *debugfs_base;
@@ -4844,6 +5127,10 @@ static int msm_cpp_enable_debugfs(struct cpp_device *cpp_dev)
 		(void *)cpp_dev, &cpp_debugfs_error))
 		return -ENOMEM;
 
+	if (!debugfs_create_file("latency", S_IRUGO | S_IWUSR, debugfs_base,
+		(void *)cpp_dev, &cpp_debugfs_latency))
+		return -ENOMEM;
+
 	return 0;
 }
 
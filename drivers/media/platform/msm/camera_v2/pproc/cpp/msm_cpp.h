@@ -43,6 +43,7 @@
 
 #define MAX_ACTIVE_CPP_INSTANCE 8
 #define MAX_CPP_PROCESSING_FRAME 2
+#define MAX_CPP_PENDING_FRAME 8
 #define MAX_CPP_V4l2_EVENTS 30
 
 #define MSM_CPP_MICRO_BASE          0x4000
@@ -203,6 +204,27 @@ struct msm_cpp_work_t {
 	struct cpp_device *cpp_dev;
 };
 
+/* frame latency buckets: <256us, doubling, last is the rest */
+#define MSM_CPP_LAT_MIN_SHIFT 8
+#define MSM_CPP_LAT_BUCKETS 12
+
+/*
+ * wait is from submission to the frame being written to the firmware,
+ * hw from there to the frame ack
+ */
+struct msm_cpp_latency_stats {
+	uint64_t frames;
+	uint32_t batches;
+	uint32_t batch_frames;
+	uint32_t parked;
+	uint32_t max_wait_us;
+	uint32_t max_hw_us;
+	uint64_t sum_wait_us;
+	uint64_t sum_hw_us;
+	uint32_t wait_hist[MSM_CPP_LAT_BUCKETS];
+	uint32_t hw_hist[MSM_CPP_LAT_BUCKETS];
+};
+
 struct msm_cpp_payload_params {
 	uint32_t stripe_base;
 	uint32_t stripe_size;
@@ -281,6 +303,16 @@ struct cpp_device {
 	 */
 	struct msm_device_queue processing_q;
 
+	/* Pending Queue
+	 * frames accepted while the processing queue is full, sent
+	 * from pending_work as the firmware acks earlier ones
+	 */
+	struct msm_device_queue pending_q;
+	struct work_struct pending_work;
+
+	spinlock_t lat_lock;
+	struct msm_cpp_latency_stats lat_stats;
+
 	struct msm_cpp_buff_queue_info_t *buff_queue;
 	uint32_t num_buffq;
 	struct msm_cam_buf_mgr_req_ops buf_mgr_ops;
@@ -12,11 +12,13 @@
 
 #include <linux/delay.h>
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/io.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
 #include <linux/of_platform.h>
+#include <linux/seq_file.h>
 #include "msm_sd.h"
 #include "msm_cci.h"
 #include "msm_cam_cci_hwreg.h"
@@ -580,20 +582,28 @@ static int32_t msm_cci_transfer_end(struct cci_device *cci_dev,
 	return rc;
 }
 
-static int32_t msm_cci_get_queue_free_size(struct cci_device *cci_dev,
-	enum cci_i2c_master_t master,
-	enum cci_i2c_queue_t queue)
+static void msm_cci_account_xfer(struct cci_device *cci_dev,
+	enum cci_i2c_master_t master, enum cci_i2c_queue_t queue,
+	uint32_t regs, uint32_t words, ktime_t start, int32_t rc)
 {
-	uint32_t read_val = 0;
-	uint32_t reg_offset = master * 0x200 + queue * 0x100;
-	read_val = msm_camera_io_r_mb(cci_dev->base +
-		CCI_I2C_M0_Q0_CUR_WORD_CNT_ADDR + reg_offset);
-	CDBG("%s line %d CCI_I2C_M0_Q0_CUR_WORD_CNT_ADDR %d max %d\n",
-		__func__, __LINE__, read_val,
-		cci_dev->cci_i2c_queue_info[master][queue].max_queue_size);
-	return (cci_dev->
-		cci_i2c_queue_info[master][queue].max_queue_size) -
-		read_val;
+	struct msm_camera_cci_master_info *info =
+		&cci_dev->cci_master_info[master];
+	struct msm_cci_xfer_stats *st = &info->stats[queue];
+	uint32_t us = ktime_us_delta(ktime_get(), start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&info->lock_q[queue], flags);
+	if (rc < 0) {
+		st->errors++;
+	} else {
+		st->xfers++;
+		st->regs += regs;
+		st->words += words;
+		st->sum_us += us;
+		if (us > st->max_us)
+			st->max_us = us;
+	}
+	spin_unlock_irqrestore(&info->lock_q[queue], flags);
 }
 
 static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
@@ -615,6 +625,8 @@ static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
 	uint32_t reg_offset;
 	uint32_t val = 0;
 	uint32_t max_queue_size;
+	uint32_t words = 0;
+	ktime_t start;
 	unsigned long flags;
 
 	if (i2c_cmd == NULL) {
@@ -643,6 +655,7 @@ static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
 		return -EINVAL;
 	}
 	reg_offset = master * 0x200 + queue * 0x100;
+	start = ktime_get();
 
 	msm_camera_io_w_mb(cci_dev->cci_wait_sync_cfg.cid,
 		cci_dev->base + CCI_SET_CID_SYNC_TIMER_ADDR +
@@ -758,8 +771,9 @@ static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
 			--cmd_size;
 		} while (((c_ctrl->cmd == MSM_CCI_I2C_WRITE_SEQ) || pack--) &&
 				(cmd_size > 0) && (i <= cci_dev->payload_size));
-		free_size = msm_cci_get_queue_free_size(cci_dev, master,
-				queue);
+		read_val = msm_camera_io_r_mb(cci_dev->base +
+			CCI_I2C_M0_Q0_CUR_WORD_CNT_ADDR + reg_offset);
+		free_size = max_queue_size - read_val;
 		if ((c_ctrl->cmd == MSM_CCI_I2C_WRITE_SEQ) &&
 			((i-1) == MSM_CCI_WRITE_DATA_PAYLOAD_SIZE_11) &&
 			cci_dev->support_seq_write && cmd_size > 0 &&
@@ -772,22 +786,23 @@ static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
 		}
 		len = ((i-1)/4) + 1;
 
-		read_val = msm_camera_io_r_mb(cci_dev->base +
-			CCI_I2C_M0_Q0_CUR_WORD_CNT_ADDR + reg_offset);
+		/*
+		 * Load the whole packet, and the wait after it, with relaxed
+		 * writes and expose it to the queue with a single ordered
+		 * update of the exec word count.
+		 */
 		for (h = 0, k = 0; h < len; h++) {
 			cmd = 0;
 			for (j = 0; (j < 4 && k < i); j++)
 				cmd |= (data[k++] << (j * 8));
 			CDBG("%s LOAD_DATA_ADDR 0x%x, q: %d, len:%d, cnt: %d\n",
 				__func__, cmd, queue, len, read_val);
-			msm_camera_io_w_mb(cmd, cci_dev->base +
+			msm_camera_io_w(cmd, cci_dev->base +
 				CCI_I2C_M0_Q0_LOAD_DATA_ADDR +
 				master * 0x200 + queue * 0x100);
-
 			read_val += 1;
-			msm_camera_io_w_mb(read_val, cci_dev->base +
-				CCI_I2C_M0_Q0_EXEC_WORD_CNT_ADDR + reg_offset);
 		}
+		words += len;
 
 		if ((delay > 0) && (delay < CCI_MAX_DELAY) &&
 			en_seq_write == 0) {
@@ -797,16 +812,19 @@ static int32_t msm_cci_data_queue(struct cci_device *cci_dev,
 			cmd |= CCI_I2C_WAIT_CMD;
 			CDBG("%s CCI_I2C_M0_Q0_LOAD_DATA_ADDR 0x%x\n",
 				__func__, cmd);
-			msm_camera_io_w_mb(cmd, cci_dev->base +
+			msm_camera_io_w(cmd, cci_dev->base +
 				CCI_I2C_M0_Q0_LOAD_DATA_ADDR +
 				master * 0x200 + queue * 0x100);
 			read_val += 1;
-			msm_camera_io_w_mb(read_val, cci_dev->base +
-				CCI_I2C_M0_Q0_EXEC_WORD_CNT_ADDR + reg_offset);
+			words++;
 		}
+		msm_camera_io_w_mb(read_val, cci_dev->base +
+			CCI_I2C_M0_Q0_EXEC_WORD_CNT_ADDR + reg_offset);
 	}
 
 	rc = msm_cci_transfer_end(cci_dev, master, queue);
+	msm_cci_account_xfer(cci_dev, master, queue, i2c_msg->size, words,
+		start, rc);
 	if (rc < 0) {
 		pr_err("%s: %d failed rc %d\n", __func__, __LINE__, rc);
 		return rc;
@@ -2074,6 +2092,86 @@ struct v4l2_subdev *msm_cci_get_subdev(void)
 	return g_cci_subdev;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int msm_cci_stats_show(struct seq_file *s, void *unused)
+{
+	struct cci_device *cci_dev = s->private;
+	struct msm_camera_cci_master_info *info;
+	struct msm_cci_xfer_stats st;
+	unsigned long flags;
+	int m, q;
+
+	seq_puts(s, "# m q      xfers       regs      words   avg_us   max_us errors\n");
+	for (m = 0; m < NUM_MASTERS; m++) {
+		info = &cci_dev->cci_master_info[m];
+		for (q = 0; q < NUM_QUEUES; q++) {
+			spin_lock_irqsave(&info->lock_q[q], flags);
+			st = info->stats[q];
+			spin_unlock_irqrestore(&info->lock_q[q], flags);
+			seq_printf(s, "  %d %d %10llu %10llu %10llu %8llu %8u %6u\n",
+				m, q, st.xfers, st.regs, st.words,
+				st.xfers ? div64_u64(st.sum_us, st.xfers) : 0,
+				st.max_us, st.errors);
+		}
+	}
+	return 0;
+}
+
+static int msm_cci_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_cci_stats_show, inode->i_private);
+}
+
+/* Any write clears the statistics */
+static ssize_t msm_cci_stats_write(struct file *file,
+	const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct cci_device *cci_dev =
+		((struct seq_file *)file->private_data)->private;
+	struct msm_camera_cci_master_info *info;
+	unsigned long flags;
+	int m, q;
+
+	for (m = 0; m < NUM_MASTERS; m++) {
+		info = &cci_dev->cci_master_info[m];
+		for (q = 0; q < NUM_QUEUES; q++) {
+			spin_lock_irqsave(&info->lock_q[q], flags);
+			memset(&info->stats[q], 0, sizeof(info->stats[q]));
+			spin_unlock_irqrestore(&info->lock_q[q], flags);
+		}
+	}
+	return count;
+}
+
+static const struct file_operations msm_cci_stats_fops = {
+	.open = msm_cci_stats_open,
+	.read = seq_read,
+	.write = msm_cci_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void msm_cci_debugfs_init(struct cci_device *cci_dev)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir(dev_name(&cci_dev->pdev->dev), NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	if (!debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir, cci_dev,
+		&msm_cci_stats_fops)) {
+		debugfs_remove_recursive(dir);
+		return;
+	}
+	cci_dev->debugfs_dir = dir;
+}
+#else
+static void msm_cci_debugfs_init(struct cci_device *cci_dev)
+{
+}
+#endif
+
 static int msm_cci_probe(struct platform_device *pdev)
 {
 	struct cci_device *new_cci_dev;
@@ -2137,6 +2235,7 @@ static int msm_cci_probe(struct platform_device *pdev)
 	msm_cci_init_cci_params(new_cci_dev);
 	msm_cci_init_clk_params(new_cci_dev);
 	msm_cci_init_gpio_params(new_cci_dev);
+	msm_cci_debugfs_init(new_cci_dev);
 
 	rc = msm_camera_get_dt_vreg_data(new_cci_dev->pdev->dev.of_node,
 		&(new_cci_dev->cci_vreg), &(new_cci_dev->regulator_count));
@@ -2189,6 +2288,7 @@ static int msm_cci_exit(struct platform_device *pdev)
 		&cci_dev->cci_clk_rates, cci_dev->num_clk_cases,
 		cci_dev->num_clk);
 
+	debugfs_remove_recursive(cci_dev->debugfs_dir);
 	msm_camera_put_reg_base(pdev, cci_dev->base, "cci", true);
 	kfree(cci_dev);
 	return 0;
@@ -115,6 +115,19 @@ struct msm_camera_cci_ctrl {
 	} cfg;
 };
 
+/*
+ * Per queue write transaction statistics, protected by the queue lock.
+ * Latency is measured from the first word loaded until the final report.
+ */
+struct msm_cci_xfer_stats {
+	uint64_t xfers;
+	uint64_t regs;
+	uint64_t words;
+	uint64_t sum_us;
+	uint32_t max_us;
+	uint32_t errors;
+};
+
 struct msm_camera_cci_master_info {
 	uint32_t status;
 	atomic_t q_free[NUM_QUEUES];
@@ -126,6 +139,7 @@ struct msm_camera_cci_master_info {
 	struct completion report_q[NUM_QUEUES];
 	atomic_t done_pending[NUM_QUEUES];
 	spinlock_t lock_q[NUM_QUEUES];
+	struct msm_cci_xfer_stats stats[NUM_QUEUES];
 };
 
 struct msm_cci_clk_params_t {
@@ -181,6 +195,7 @@ struct cci_device {
 	struct workqueue_struct *write_wq[MASTER_MAX];
 	struct msm_camera_cci_wait_sync_cfg cci_wait_sync_cfg;
 	uint8_t valid_sync;
+	struct dentry *debugfs_dir;
 };
 
 enum msm_cci_i2c_cmd_type {
@@ -56,6 +56,9 @@
 /* waiting for hw time out, 3 vsync for 30fps*/
 #define ROT_HW_ACQUIRE_TIMEOUT_IN_MS 100
 
+/* drop the clock/bw votes of sessions without queued work after this idle */
+#define ROT_PERF_IDLE_TIMEOUT_IN_MS 20
+
 /* default pixel per clock ratio */
 #define ROT_PIXEL_PER_CLK_NUMERATOR	36
 #define ROT_PIXEL_PER_CLK_DENOMINATOR	10
@@ -187,10 +190,14 @@ static int sde_rotator_enable_reg_bus(struct sde_rot_mgr *mgr, u64 quota)
 	return ret;
 }
 
+static bool sde_rotator_perf_in_use(struct sde_rot_mgr *mgr,
+	struct sde_rot_perf *perf);
+
 /*
  * Clock rate of all open sessions working a particular hw block
  * are added together to get the required rate for that hw block.
- * The max of each hw block becomes the final clock rate voted for
+ * The max of each hw block becomes the final clock rate voted for.
+ * Once the rotator went idle, only sessions with queued work count.
  */
 static unsigned long sde_rotator_clk_rate_calc(
 	struct sde_rot_mgr *mgr,
@@ -203,6 +210,9 @@ static unsigned long sde_rotator_clk_rate_calc(
 
 	list_for_each_entry(perf, &private->perf_list, list) {
 		bool rate_accounted_for = false;
+
+		if (!sde_rotator_perf_in_use(mgr, perf))
+			continue;
 		/*
 		 * If there is one session that has two work items across
 		 * different hw blocks rate is accounted for in both blocks.
@@ -460,6 +470,70 @@ static bool sde_rotator_is_work_pending(struct sde_rot_mgr *mgr,
 	return false;
 }
 
+/* check whether the votes of the session must be held */
+static bool sde_rotator_perf_in_use(struct sde_rot_mgr *mgr,
+	struct sde_rot_perf *perf)
+{
+	return !mgr->perf_idle || sde_rotator_is_work_pending(mgr, perf);
+}
+
+static bool sde_rotator_any_work_pending(struct sde_rot_mgr *mgr)
+{
+	struct sde_rot_file_private *priv;
+	struct sde_rot_perf *perf;
+
+	list_for_each_entry(priv, &mgr->file_list, list)
+		list_for_each_entry(perf, &priv->perf_list, list)
+			if (sde_rotator_is_work_pending(mgr, perf))
+				return true;
+
+	return false;
+}
+
+static int sde_rotator_update_perf(struct sde_rot_mgr *mgr);
+
+/*
+ * sde_rotator_perf_wake - restore the full clock/bw votes ahead of new work
+ * @mgr: Pointer to rotator manager
+ *
+ * Caller must hold the rotator manager lock.
+ */
+static void sde_rotator_perf_wake(struct sde_rot_mgr *mgr)
+{
+	cancel_delayed_work(&mgr->perf_idle_work);
+
+	if (!mgr->perf_idle)
+		return;
+
+	mgr->perf_idle = false;
+	SDEROT_EVTLOG(mgr->perf_idle);
+	sde_rotator_update_perf(mgr);
+	sde_rotator_update_clk(mgr);
+}
+
+/*
+ * sde_rotator_perf_idle_work - drop the votes of sessions without work
+ * @work: Pointer to work struct
+ *
+ * Runs once no work was queued for perf_idle_ms, so the rotator does not
+ * keep voting for the peak rate of every open session between frames.
+ */
+static void sde_rotator_perf_idle_work(struct work_struct *work)
+{
+	struct sde_rot_mgr *mgr = container_of(to_delayed_work(work),
+			struct sde_rot_mgr, perf_idle_work);
+
+	sde_rot_mgr_lock(mgr);
+	if (!mgr->perf_idle && mgr->perf_idle_ms &&
+			!sde_rotator_any_work_pending(mgr)) {
+		mgr->perf_idle = true;
+		SDEROT_EVTLOG(mgr->perf_idle);
+		sde_rotator_update_perf(mgr);
+		sde_rotator_update_clk(mgr);
+	}
+	sde_rot_mgr_unlock(mgr);
+}
+
 static void sde_rotator_clear_fence(struct sde_rot_entry *entry)
 {
 	if (entry->input_fence) {
@@ -731,6 +805,52 @@ end:
 	return ret;
 }
 
+/*
+ * sde_rotator_prepare_data - attach smmu and map/check the entry buffers
+ * @entry: Pointer to rotation entry
+ *
+ * On success the smmu stays attached until the entry is done.
+ */
+static int sde_rotator_prepare_data(struct sde_rot_entry *entry)
+{
+	int ret;
+
+	ATRACE_INT("sde_smmu_ctrl", 0);
+	ret = sde_smmu_ctrl(1);
+	if (IS_ERR_VALUE(ret)) {
+		SDEROT_ERR("IOMMU attach failed\n");
+		return ret;
+	}
+	ATRACE_INT("sde_smmu_ctrl", 1);
+
+	ret = sde_rotator_map_and_check_data(entry);
+	if (ret) {
+		SDEROT_ERR("fail to prepare input/output data %d\n", ret);
+		sde_smmu_ctrl(0);
+	}
+
+	return ret;
+}
+
+/*
+ * sde_rotator_can_premap - check if entry can be prepared ahead of hw
+ * @mgr: Pointer to rotator manager
+ * @entry: Pointer to rotation entry
+ *
+ * Buffers can be mapped while earlier entries are still running on the
+ * hw unless the entry switches the secure camera state, which must only
+ * happen once the hw queue has drained.
+ */
+static bool sde_rotator_can_premap(struct sde_rot_mgr *mgr,
+		struct sde_rot_entry *entry)
+{
+	struct sde_rot_data_type *mdata = sde_rot_get_mdata();
+	bool secure = (entry->item.flags & SDE_ROTATION_SECURE_CAMERA) ?
+			true : false;
+
+	return mgr->premap && (!!mdata->sec_cam_en == secure);
+}
+
 static struct sde_rot_perf *__sde_rotator_find_session(
 	struct sde_rot_file_private *private,
 	u32 session_id)
@@ -1186,6 +1306,9 @@ void sde_rotator_queue_request(struct sde_rot_mgr *mgr,
 		entry->work_assigned = true;
 	}
 
+	/* ramp the votes back up before the work reaches the hw */
+	sde_rotator_perf_wake(mgr);
+
 	for (i = 0; i < req->count; i++) {
 		entry = req->entries + i;
 		queue = entry->commitq;
@@ -1327,7 +1450,7 @@ static int sde_rotator_update_perf(struct sde_rot_mgr *mgr)
 	struct sde_rot_file_private *priv;
 	struct sde_rot_perf *perf;
 	int not_in_suspend_mode;
-	u64 total_bw = 0;
+	u64 total_bw = 0, active_bw = 0;
 
 	not_in_suspend_mode = !atomic_read(&mgr->device_suspended);
 
@@ -1335,14 +1458,18 @@ static int sde_rotator_update_perf(struct sde_rot_mgr *mgr)
 		list_for_each_entry(priv, &mgr->file_list, list) {
 			list_for_each_entry(perf, &priv->perf_list, list) {
 				total_bw += perf->bw;
+				if (sde_rotator_perf_in_use(mgr, perf))
+					active_bw += perf->bw;
 			}
 		}
 	}
 
+	/* register access stays possible while the data bus is idle */
 	total_bw += mgr->pending_close_bw_vote;
+	active_bw += mgr->pending_close_bw_vote;
 	sde_rotator_enable_reg_bus(mgr, total_bw);
-	ATRACE_INT("bus_quota", total_bw);
-	sde_rotator_bus_scale_set_quota(&mgr->data_bus, total_bw);
+	ATRACE_INT("bus_quota", active_bw);
+	sde_rotator_bus_scale_set_quota(&mgr->data_bus, active_bw);
 
 	return 0;
 }
@@ -1365,6 +1492,11 @@ static void sde_rotator_release_from_work_distribution(
 		}
 
 		entry->work_assigned = false;
+
+		if (mgr->perf_idle_ms && !sde_rotator_any_work_pending(mgr))
+			mod_delayed_work(system_wq, &mgr->perf_idle_work,
+				msecs_to_jiffies(mgr->perf_idle_ms));
+
 		if (free_perf) {
 			if (mgr->pending_close_bw_vote < entry->perf->bw) {
 				SDEROT_ERR(
@@ -1411,6 +1543,7 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 	struct sde_rot_hw_resource *hw;
 	struct sde_rot_mgr *mgr;
 	struct sched_param param = { .sched_priority = 5 };
+	bool premapped;
 	int ret;
 
 	entry = container_of(work, struct sde_rot_entry, commit_work);
@@ -1450,9 +1583,20 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 
 	sde_rot_mgr_lock(mgr);
 
+	/*
+	 * Map and check the buffers before waiting for a free hw queue slot,
+	 * so that preparing this entry overlaps with the entries still
+	 * running on the hw instead of adding to the per frame latency.
+	 */
+	premapped = sde_rotator_can_premap(mgr, entry);
+	if (premapped && sde_rotator_prepare_data(entry))
+		goto get_hw_res_err;
+
 	hw = sde_rotator_get_hw_resource(entry->commitq, entry);
 	if (!hw) {
 		SDEROT_ERR("no hw for the queue\n");
+		if (premapped)
+			sde_smmu_ctrl(0);
 		goto get_hw_res_err;
 	}
 
@@ -1471,19 +1615,17 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 		entry->item.dst_rect.x, entry->item.dst_rect.y,
 		entry->item.dst_rect.w, entry->item.dst_rect.h);
 
-	ATRACE_INT("sde_smmu_ctrl", 0);
-	ret = sde_smmu_ctrl(1);
-	if (IS_ERR_VALUE(ret)) {
-		SDEROT_ERR("IOMMU attach failed\n");
-		goto smmu_error;
+	/*
+	 * Another queue may have switched the secure state while we waited,
+	 * prepare again so the switch back happens with the hw acquired.
+	 */
+	if (premapped && !sde_rotator_can_premap(mgr, entry)) {
+		sde_smmu_ctrl(0);
+		premapped = false;
 	}
-	ATRACE_INT("sde_smmu_ctrl", 1);
 
-	ret = sde_rotator_map_and_check_data(entry);
-	if (ret) {
-		SDEROT_ERR("fail to prepare input/output data %d\n", ret);
-		goto error;
-	}
+	if (!premapped && sde_rotator_prepare_data(entry))
+		goto smmu_error;
 
 	ret = mgr->ops_config_hw(hw, entry);
 	if (ret) {
@@ -2432,6 +2574,7 @@ static ssize_t sde_rotator_show_state(struct device *dev,
 	SPRINT("reg_bus_bw=%llu\n", mgr->reg_bus.curr_quota_val);
 	SPRINT("data_bus_bw=%llu\n", mgr->data_bus.curr_quota_val);
 	SPRINT("pending_close_bw_vote=%llu\n", mgr->pending_close_bw_vote);
+	SPRINT("perf_idle=%d\n", mgr->perf_idle);
 	SPRINT("device_suspended=%d\n", atomic_read(&mgr->device_suspended));
 	SPRINT("footswitch_cnt=%d\n", mgr->res_ref_cnt);
 	SPRINT("regulator_enable=%d\n", mgr->regulator_enable);
@@ -2775,6 +2918,9 @@ int sde_rotator_core_init(struct sde_rot_mgr **pmgr,
 	mgr->device = &pdev->dev;
 	mgr->pending_close_bw_vote = 0;
 	mgr->hwacquire_timeout = ROT_HW_ACQUIRE_TIMEOUT_IN_MS;
+	mgr->premap = 1;
+	mgr->perf_idle_ms = ROT_PERF_IDLE_TIMEOUT_IN_MS;
+	INIT_DELAYED_WORK(&mgr->perf_idle_work, sde_rotator_perf_idle_work);
 	mgr->queue_count = 1;
 	mgr->pixel_per_clk.numer = ROT_PIXEL_PER_CLK_NUMERATOR;
 	mgr->pixel_per_clk.denom = ROT_PIXEL_PER_CLK_DENOMINATOR;
@@ -2879,6 +3025,7 @@ void sde_rotator_core_destroy(struct sde_rot_mgr *mgr)
 	}
 
 	dev = mgr->device;
+	cancel_delayed_work_sync(&mgr->perf_idle_work);
 	sde_rotator_deinit_queue(mgr);
 	mgr->ops_hw_destroy(mgr);
 	sde_rotator_release_all(mgr);
@@ -22,6 +22,7 @@
 #include <linux/cdev.h>
 #include <linux/pm_runtime.h>
 #include <linux/kthread.h>
+#include <linux/workqueue.h>
 
 #include "sde_rotator_base.h"
 #include "sde_rotator_util.h"
@@ -293,6 +294,10 @@ struct sde_rot_mgr {
 	u32 wrot_limit;
 
 	u32 hwacquire_timeout;
+	u32 premap; /* map entry buffers before waiting for hw */
+	u32 perf_idle_ms; /* idle time before dropping votes, 0 to disable */
+	bool perf_idle; /* only sessions with queued work are voted for */
+	struct delayed_work perf_idle_work;
 	struct sde_mult_factor pixel_per_clk;
 	struct sde_mult_factor fudge_factor;
 	struct sde_mult_factor overhead;
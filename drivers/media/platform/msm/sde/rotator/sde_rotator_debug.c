@@ -861,6 +861,18 @@ static int sde_rotator_core_create_debugfs(
 		return -EINVAL;
 	}
 
+	if (!debugfs_create_u32("premap", S_IRUGO | S_IWUSR,
+			debugfs_root, &mgr->premap)) {
+		SDEROT_WARN("failed to create debugfs premap\n");
+		return -EINVAL;
+	}
+
+	if (!debugfs_create_u32("perf_idle_ms", S_IRUGO | S_IWUSR,
+			debugfs_root, &mgr->perf_idle_ms)) {
+		SDEROT_WARN("failed to create debugfs perf idle ms\n");
+		return -EINVAL;
+	}
+
 	if (!debugfs_create_u32("ppc_numer", S_IRUGO | S_IWUSR,
 			debugfs_root, &mgr->pixel_per_clk.numer)) {
 		SDEROT_WARN("failed to create debugfs ppc numerator\n");
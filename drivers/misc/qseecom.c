@@ -21,6 +21,7 @@
 #include <linux/fs.h>
 #include <linux/platform_device.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
 #include <linux/sched.h>
@@ -220,6 +221,14 @@ struct qseecom_unregister_pending_list {
 	struct qseecom_dev_handle	*data;
 };
 
+/* Per TA send command latency, protected by registered_app_list_lock */
+struct qseecom_app_stats {
+	u64 cmds;
+	u64 cache_us;
+	u64 smc_us;
+	u32 max_smc_us;
+};
+
 struct qseecom_registered_app_list {
 	struct list_head                 list;
 	u32  app_id;
@@ -229,6 +238,7 @@ struct qseecom_registered_app_list {
 	bool app_blocked;
 	u32  check_block;
 	u32  blocked_on_listener_id;
+	struct qseecom_app_stats stats;
 };
 
 struct qseecom_registered_kclient_list {
@@ -322,6 +332,8 @@ struct qseecom_control {
 	struct task_struct *unload_app_kthread_task;
 	wait_queue_head_t unload_app_kthread_wq;
 	atomic_t unload_app_kthread_state;
+
+	struct dentry *dent;
 };
 
 struct qseecom_unload_app_pending_list {
@@ -3373,12 +3385,32 @@ int __qseecom_process_reentrancy(struct qseecom_command_scm_resp *resp,
 	}
 }
 
+/*
+ * t0: before the pre-call cache clean, t1: before the scm call,
+ * t2: after the scm call and any listener or reentrancy handling.
+ */
+static void __qseecom_account_cmd(struct qseecom_registered_app_list *app,
+				ktime_t t0, ktime_t t1, ktime_t t2)
+{
+	struct qseecom_app_stats *st = &app->stats;
+	u32 smc_us = ktime_us_delta(t2, t1);
+	unsigned long flags;
+
+	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
+	st->cmds++;
+	st->cache_us += ktime_us_delta(t1, t0) +
+			ktime_us_delta(ktime_get(), t2);
+	st->smc_us += smc_us;
+	if (smc_us > st->max_smc_us)
+		st->max_smc_us = smc_us;
+	spin_unlock_irqrestore(&qseecom.registered_app_list_lock, flags);
+}
+
 static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 				struct qseecom_send_cmd_req *req)
 {
 	int ret = 0;
 	int ret2 = 0;
-	u32 reqd_len_sb_in = 0;
 	struct qseecom_client_send_data_ireq send_data_req = {0};
 	struct qseecom_client_send_data_64bit_ireq send_data_req_64bit = {0};
 	struct qseecom_command_scm_resp resp;
@@ -3388,8 +3420,19 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 	void *cmd_buf = NULL;
 	size_t cmd_len;
 	struct sglist_info *table = data->sglistinfo_ptr;
+	uintptr_t sb_start, sb_end;
+	ktime_t t0, t1, t2;
 
-	reqd_len_sb_in = req->cmd_req_len + req->resp_len;
+	/*
+	 * Only the request and response buffers are exchanged with the TA,
+	 * keep cache maintenance to the part of the shared buffer they span
+	 * instead of the whole buffer.
+	 */
+	sb_start = min((uintptr_t)req->cmd_req_buf, (uintptr_t)req->resp_buf);
+	sb_end = max((uintptr_t)req->cmd_req_buf + req->cmd_req_len,
+			(uintptr_t)req->resp_buf + req->resp_len);
+	sb_start = __qseecom_uvirt_to_kvirt(data, sb_start);
+	sb_end = __qseecom_uvirt_to_kvirt(data, sb_end);
 	/* find app_id & img_name from list */
 	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
 	list_for_each_entry(ptr_app, &qseecom.registered_app_list_head,
@@ -3466,9 +3509,9 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 	else
 		*(uint32_t *)cmd_buf = QSEOS_CLIENT_SEND_DATA_COMMAND_WHITELIST;
 
+	t0 = ktime_get();
 	ret = msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-					data->client.sb_virt,
-					reqd_len_sb_in,
+					(void *)sb_start, sb_end - sb_start,
 					ION_IOC_CLEAN_INV_CACHES);
 	if (ret) {
 		pr_err("cache operation failed %d\n", ret);
@@ -3477,6 +3520,7 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 
 	__qseecom_reentrancy_check_if_this_app_blocked(ptr_app);
 
+	t1 = ktime_get();
 	ret = qseecom_scm_call(SCM_SVC_TZSCHEDULER, 1,
 				cmd_buf, cmd_len,
 				&resp, sizeof(resp));
@@ -3508,9 +3552,11 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 		}
 	}
 exit:
+	t2 = ktime_get();
 	ret2 = msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-				data->client.sb_virt, data->client.sb_length,
+				(void *)sb_start, sb_end - sb_start,
 				ION_IOC_INV_CACHES);
+	__qseecom_account_cmd(ptr_app, t0, t1, t2);
 	if (ret2) {
 		pr_err("cache operation failed %d\n", ret2);
 		return ret2;
@@ -8831,6 +8877,74 @@ static int qseecom_check_whitelist_feature(void)
 	return (ret == 0) && (version >= MAKE_WHITELIST_VERSION(1, 0, 0));
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int qseecom_app_stats_show(struct seq_file *s, void *unused)
+{
+	struct qseecom_registered_app_list *app;
+	struct qseecom_app_stats *st;
+	unsigned long flags;
+
+	seq_puts(s, "# app_id name               cmds  avg_cache_us    avg_smc_us    max_smc_us\n");
+	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
+	list_for_each_entry(app, &qseecom.registered_app_list_head, list) {
+		st = &app->stats;
+		if (!st->cmds)
+			continue;
+		seq_printf(s, "%8u %-16s %8llu %13llu %13llu %13u\n",
+			app->app_id, app->app_name, st->cmds,
+			div64_u64(st->cache_us, st->cmds),
+			div64_u64(st->smc_us, st->cmds), st->max_smc_us);
+	}
+	spin_unlock_irqrestore(&qseecom.registered_app_list_lock, flags);
+	return 0;
+}
+
+static int qseecom_app_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qseecom_app_stats_show, NULL);
+}
+
+/* Any write clears the statistics */
+static ssize_t qseecom_app_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct qseecom_registered_app_list *app;
+	unsigned long flags;
+
+	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
+	list_for_each_entry(app, &qseecom.registered_app_list_head, list)
+		memset(&app->stats, 0, sizeof(app->stats));
+	spin_unlock_irqrestore(&qseecom.registered_app_list_lock, flags);
+	return count;
+}
+
+static const struct file_operations qseecom_app_stats_fops = {
+	.open = qseecom_app_stats_open,
+	.read = seq_read,
+	.write = qseecom_app_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void qseecom_debugfs_init(void)
+{
+	qseecom.dent = debugfs_create_dir(QSEECOM_DEV, NULL);
+	if (IS_ERR_OR_NULL(qseecom.dent)) {
+		qseecom.dent = NULL;
+		return;
+	}
+	if (!debugfs_create_file("app_stats", S_IRUGO | S_IWUSR,
+			qseecom.dent, NULL, &qseecom_app_stats_fops)) {
+		debugfs_remove_recursive(qseecom.dent);
+		qseecom.dent = NULL;
+	}
+}
+#else
+static void qseecom_debugfs_init(void)
+{
+}
+#endif
+
 static int qseecom_probe(struct platform_device *pdev)
 {
 	int rc;
@@ -9135,6 +9249,7 @@ static int qseecom_probe(struct platform_device *pdev)
 	atomic_set(&qseecom.unload_app_kthread_state,
 						UNLOAD_APP_KT_SLEEP);
 
+	qseecom_debugfs_init();
 	atomic_set(&qseecom.qseecom_state, QSEECOM_STATE_READY);
 	return 0;
 
@@ -9186,6 +9301,7 @@ static int qseecom_remove(struct platform_device *pdev)
 	struct qseecom_ce_info_use *pce_info_use;
 
 	atomic_set(&qseecom.qseecom_state, QSEECOM_STATE_NOT_READY);
+	debugfs_remove_recursive(qseecom.dent);
 	spin_lock_irqsave(&qseecom.registered_kclient_list_lock, flags);
 
 	list_for_each_entry_safe(kclient, kclient_tmp,
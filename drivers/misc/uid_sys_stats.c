@@ -21,6 +21,7 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 #include <linux/proc_fs.h>
 #include <linux/profile.h>
 #include <linux/rtmutex.h>
@@ -49,17 +50,12 @@ struct io_stats {
 #define UID_STATE_BACKGROUND	1
 #define UID_STATE_BUCKET_SIZE	2
 
-#define UID_STATE_TOTAL_CURR	2
-#define UID_STATE_TOTAL_LAST	3
-#define UID_STATE_DEAD_TASKS	4
-#define UID_STATE_SIZE		5
-
 #define MAX_TASK_COMM_LEN 256
 
 struct task_entry {
 	char comm[MAX_TASK_COMM_LEN];
 	pid_t pid;
-	struct io_stats io[UID_STATE_SIZE];
+	struct io_stats io[UID_STATE_BUCKET_SIZE];
 	struct hlist_node hash;
 };
 
@@ -70,7 +66,7 @@ struct uid_entry {
 	cputime_t active_utime;
 	cputime_t active_stime;
 	int state;
-	struct io_stats io[UID_STATE_SIZE];
+	struct io_stats io[UID_STATE_BUCKET_SIZE];
 	struct hlist_node hash;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 	DECLARE_HASHTABLE(task_entries, UID_HASH_BITS);
@@ -85,37 +81,50 @@ static u64 compute_write_bytes(struct task_struct *task)
 	return task->ioac.write_bytes - task->ioac.cancelled_write_bytes;
 }
 
-static void compute_io_bucket_stats(struct io_stats *io_bucket,
-					struct io_stats *io_curr,
-					struct io_stats *io_last,
-					struct io_stats *io_dead)
+/*
+ * I/O is charged to the UID incrementally: a task charges the growth of
+ * its ioac since its last charge to the current state of its UID, from
+ * its own read, write and fsync accounting at most every io_charge_ms,
+ * and once more when it exits. Reading the stats and switching states
+ * then walk no tasks, at the cost of attributing up to io_charge_ms of
+ * a task's I/O to the state its UID is in when the task next charges.
+ */
+static unsigned int io_charge_ms = 100;
+module_param(io_charge_ms, uint, 0644);
+
+static void compute_io_delta(struct io_stats *delta, struct task_struct *task)
 {
-	/* tasks could switch to another uid group, but its io_last in the
-	 * previous uid group could still be positive.
-	 * therefore before each update, do an overflow check first
-	 */
-	int64_t delta;
-
-	delta = io_curr->read_bytes + io_dead->read_bytes -
-		io_last->read_bytes;
-	io_bucket->read_bytes += delta > 0 ? delta : 0;
-	delta = io_curr->write_bytes + io_dead->write_bytes -
-		io_last->write_bytes;
-	io_bucket->write_bytes += delta > 0 ? delta : 0;
-	delta = io_curr->rchar + io_dead->rchar - io_last->rchar;
-	io_bucket->rchar += delta > 0 ? delta : 0;
-	delta = io_curr->wchar + io_dead->wchar - io_last->wchar;
-	io_bucket->wchar += delta > 0 ? delta : 0;
-	delta = io_curr->fsync + io_dead->fsync - io_last->fsync;
-	io_bucket->fsync += delta > 0 ? delta : 0;
-
-	io_last->read_bytes = io_curr->read_bytes;
-	io_last->write_bytes = io_curr->write_bytes;
-	io_last->rchar = io_curr->rchar;
-	io_last->wchar = io_curr->wchar;
-	io_last->fsync = io_curr->fsync;
-
-	memset(io_dead, 0, sizeof(struct io_stats));
+	struct task_io_accounting *last = &task->uid_ioac;
+	u64 write_bytes = compute_write_bytes(task);
+
+	/* uid_ioac was inherited from the parent, nothing charged yet */
+	if (task->uid_ioac_owner != task) {
+		memset(last, 0, sizeof(*last));
+		task->uid_ioac_owner = task;
+	}
+
+	delta->read_bytes = task->ioac.read_bytes - last->read_bytes;
+	/* cancelled writes can shrink write_bytes, never charge that back */
+	delta->write_bytes = write_bytes > last->write_bytes ?
+			     write_bytes - last->write_bytes : 0;
+	delta->rchar = task->ioac.rchar - last->rchar;
+	delta->wchar = task->ioac.wchar - last->wchar;
+	delta->fsync = task->ioac.syscfs - last->syscfs;
+
+	last->read_bytes = task->ioac.read_bytes;
+	last->write_bytes = max(write_bytes, last->write_bytes);
+	last->rchar = task->ioac.rchar;
+	last->wchar = task->ioac.wchar;
+	last->syscfs = task->ioac.syscfs;
+}
+
+static void add_io_stats(struct io_stats *io, struct io_stats *delta)
+{
+	io->read_bytes += delta->read_bytes;
+	io->write_bytes += delta->write_bytes;
+	io->rchar += delta->rchar;
+	io->wchar += delta->wchar;
+	io->fsync += delta->fsync;
 }
 
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
@@ -228,41 +237,14 @@ static void remove_uid_tasks(struct uid_entry *uid_entry)
 	}
 }
 
-static void set_io_uid_tasks_zero(struct uid_entry *uid_entry)
-{
-	struct task_entry *task_entry;
-	unsigned long bkt_task;
-
-	hash_for_each(uid_entry->task_entries, bkt_task, task_entry, hash) {
-		memset(&task_entry->io[UID_STATE_TOTAL_CURR], 0,
-			sizeof(struct io_stats));
-	}
-}
-
 static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
-		struct task_struct *task, int slot)
+		struct task_struct *task, struct io_stats *delta)
 {
 	struct task_entry *task_entry = find_or_register_task(uid_entry, task);
-	struct io_stats *task_io_slot = &task_entry->io[slot];
-
-	task_io_slot->read_bytes += task->ioac.read_bytes;
-	task_io_slot->write_bytes += compute_write_bytes(task);
-	task_io_slot->rchar += task->ioac.rchar;
-	task_io_slot->wchar += task->ioac.wchar;
-	task_io_slot->fsync += task->ioac.syscfs;
-}
-
-static void compute_io_uid_tasks(struct uid_entry *uid_entry)
-{
-	struct task_entry *task_entry;
-	unsigned long bkt_task;
 
-	hash_for_each(uid_entry->task_entries, bkt_task, task_entry, hash) {
-		compute_io_bucket_stats(&task_entry->io[uid_entry->state],
-					&task_entry->io[UID_STATE_TOTAL_CURR],
-					&task_entry->io[UID_STATE_TOTAL_LAST],
-					&task_entry->io[UID_STATE_DEAD_TASKS]);
-	}
+	if (!task_entry)
+		return;
+	add_io_stats(&task_entry->io[uid_entry->state], delta);
 }
 
 static void show_io_uid_tasks(struct seq_file *m, struct uid_entry *uid_entry)
@@ -289,10 +271,8 @@ static void show_io_uid_tasks(struct seq_file *m, struct uid_entry *uid_entry)
 }
 #else
 static void remove_uid_tasks(struct uid_entry *uid_entry) {};
-static void set_io_uid_tasks_zero(struct uid_entry *uid_entry) {};
 static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
-		struct task_struct *task, int slot) {};
-static void compute_io_uid_tasks(struct uid_entry *uid_entry) {};
+		struct task_struct *task, struct io_stats *delta) {};
 static void show_io_uid_tasks(struct seq_file *m,
 		struct uid_entry *uid_entry) {}
 #endif
@@ -450,78 +430,40 @@ static const struct file_operations uid_remove_fops = {
 };
 
 
-static void add_uid_io_stats(struct uid_entry *uid_entry,
-			struct task_struct *task, int slot)
+/* Caller must hold uid_lock */
+static void charge_uid_io_locked(struct uid_entry *uid_entry,
+			struct task_struct *task)
 {
-	struct io_stats *io_slot = &uid_entry->io[slot];
+	struct io_stats delta;
 
-	io_slot->read_bytes += task->ioac.read_bytes;
-	io_slot->write_bytes += compute_write_bytes(task);
-	io_slot->rchar += task->ioac.rchar;
-	io_slot->wchar += task->ioac.wchar;
-	io_slot->fsync += task->ioac.syscfs;
-
-	add_uid_tasks_io_stats(uid_entry, task, slot);
+	compute_io_delta(&delta, task);
+	add_io_stats(&uid_entry->io[uid_entry->state], &delta);
+	add_uid_tasks_io_stats(uid_entry, task, &delta);
 }
 
-static void update_io_stats_all_locked(void)
+/*
+ * Called from the I/O accounting of the current task once io_charge_ms
+ * has passed since its last charge. The charge is simply retried on the
+ * next I/O if uid_lock is busy.
+ */
+void uid_sys_stats_charge_io(struct task_struct *task)
 {
-	struct uid_entry *uid_entry = NULL;
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-	unsigned long bkt;
+	struct uid_entry *uid_entry;
 	uid_t uid;
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-			sizeof(struct io_stats));
-		set_io_uid_tasks_zero(uid_entry);
-	}
+	task->uid_ioac_next = jiffies + msecs_to_jiffies(io_charge_ms);
 
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		uid = from_kuid_munged(user_ns, task_uid(task));
-		if (!uid_entry || uid_entry->uid != uid)
-			uid_entry = find_or_register_uid(uid);
-		if (!uid_entry)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-					&uid_entry->io[UID_STATE_TOTAL_CURR],
-					&uid_entry->io[UID_STATE_TOTAL_LAST],
-					&uid_entry->io[UID_STATE_DEAD_TASKS]);
-		compute_io_uid_tasks(uid_entry);
-	}
-}
+	if (!rt_mutex_trylock(&uid_lock))
+		return;
 
-static void update_io_stats_uid_locked(struct uid_entry *uid_entry)
-{
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-
-	memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-		sizeof(struct io_stats));
-	set_io_uid_tasks_zero(uid_entry);
-
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		if (from_kuid_munged(user_ns, task_uid(task)) != uid_entry->uid)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
+	uid = from_kuid_munged(current_user_ns(), task_uid(task));
+	uid_entry = find_or_register_uid(uid);
+	if (uid_entry)
+		charge_uid_io_locked(uid_entry, task);
 
-	compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-				&uid_entry->io[UID_STATE_TOTAL_CURR],
-				&uid_entry->io[UID_STATE_TOTAL_LAST],
-				&uid_entry->io[UID_STATE_DEAD_TASKS]);
-	compute_io_uid_tasks(uid_entry);
+	rt_mutex_unlock(&uid_lock);
 }
-
+EXPORT_SYMBOL_GPL(uid_sys_stats_charge_io);
 
 static int uid_io_show(struct seq_file *m, void *v)
 {
@@ -530,8 +472,6 @@ static int uid_io_show(struct seq_file *m, void *v)
 
 	rt_mutex_lock(&uid_lock);
 
-	update_io_stats_all_locked();
-
 	hash_for_each(hash_table, bkt, uid_entry, hash) {
 		seq_printf(m, "%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
 				uid_entry->uid,
@@ -601,13 +541,6 @@ static ssize_t uid_procstat_write(struct file *file,
 		return -EINVAL;
 	}
 
-	if (uid_entry->state == state) {
-		rt_mutex_unlock(&uid_lock);
-		return count;
-	}
-
-	update_io_stats_uid_locked(uid_entry);
-
 	uid_entry->state = state;
 
 	rt_mutex_unlock(&uid_lock);
@@ -644,7 +577,7 @@ static int process_notifier(struct notifier_block *self,
 	uid_entry->utime += utime;
 	uid_entry->stime += stime;
 
-	add_uid_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
+	charge_uid_io_locked(uid_entry, task);
 
 exit:
 	rt_mutex_unlock(&uid_lock);
@@ -1897,6 +1897,7 @@ static int mmc_blk_cmdq_issue_discard_rq(struct mmc_queue *mq,
 	struct mmc_card *card = md->queue.card;
 	struct mmc_cmdq_req *cmdq_req = NULL;
 	unsigned int from, nr, arg;
+	ktime_t start = ktime_get();
 	int err = 0;
 
 	if (!mmc_can_erase(card)) {
@@ -1930,6 +1931,8 @@ static int mmc_blk_cmdq_issue_discard_rq(struct mmc_queue *mq,
 	}
 	err = mmc_cmdq_erase(cmdq_req, card, from, nr, arg);
 clear_dcmd:
+	mmc_io_stats_account(card->host, MMC_IO_DISCARD, blk_rq_bytes(req),
+			     from, start, err);
 	mmc_host_clk_hold(card->host);
 	blk_complete_request(req);
 out:
@@ -1941,6 +1944,7 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
 	unsigned int from, nr, arg;
+	ktime_t start = ktime_get();
 	int err = 0, type = MMC_BLK_DISCARD;
 
 	if (!mmc_can_erase(card)) {
@@ -1974,6 +1978,9 @@ out:
 		goto retry;
 	if (!err)
 		mmc_blk_reset_success(md, type);
+	if (err != -EOPNOTSUPP)
+		mmc_io_stats_account(card->host, MMC_IO_DISCARD,
+				     blk_rq_bytes(req), from, start, err);
 	blk_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
@@ -3157,6 +3164,14 @@ static struct mmc_cmdq_req *mmc_blk_cmdq_rw_prep(
 		 card->ext_csd.data_tag_unit_size);
 	if (do_data_tag)
 		cmdq_rq->cmdq_req_flags |= DAT_TAG;
+	/*
+	 * The queue thread knows more requests follow, leave the doorbell to
+	 * the last one. Not at low load, where we wait for the queue to
+	 * drain right after issuing.
+	 */
+	if (mq->cmdq_defer_db &&
+	    card->host->clk_scaling.state != MMC_LOAD_LOW)
+		cmdq_rq->cmdq_req_flags |= DEFER_DB;
 	cmdq_rq->data.sg = mqrq->sg;
 	cmdq_rq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
@@ -3689,6 +3704,7 @@ void mmc_blk_cmdq_req_done(struct mmc_request *mrq)
 {
 	struct request *req = mrq->req;
 
+	mmc_io_stats_req_done(mrq->host, mrq);
 	blk_complete_request(req);
 }
 EXPORT_SYMBOL(mmc_blk_cmdq_req_done);
@@ -4059,6 +4075,7 @@ static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 		if ((cmd_flags & (REQ_FLUSH | REQ_DISCARD)) &&
 		    (card->quirks & MMC_QUIRK_CMDQ_EMPTY_BEFORE_DCMD) &&
 		    ctx->active_small_sector_read_reqs) {
+			mmc_cmdq_commit(host);
 			ret = wait_event_interruptible(ctx->queue_empty_wq,
 						      !ctx->active_reqs);
 			if (ret) {
@@ -33,6 +33,9 @@
  */
 #define DEFAULT_NUM_REQS_TO_START_PACK 17
 
+/* Max requests prepared by the cmdq thread before ringing the doorbell */
+#define MMC_CMDQ_DB_BATCH 8
+
 /*
  * Prepare a MMC request. This just filters out odd stuff.
  */
@@ -81,14 +84,13 @@ static bool mmc_check_blk_queue_start_tag(struct request_queue *q,
 	return !!ret;
 }
 
-static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
-					struct mmc_queue *mq)
+static inline bool mmc_cmdq_ready(struct mmc_host *host,
+				  struct mmc_queue *mq)
 {
-	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
 	struct request_queue *q = mq->queue;
 
 	/*
-	 * Wait until all of the following conditions are true:
+	 * Ready when all of the following conditions are true:
 	 * 1. There is a request pending in the block layer queue
 	 *    to be processed.
 	 * 2. If the peeked request is flush/discard then there shouldn't
@@ -99,17 +101,23 @@ static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
 	 * 6. free tag available to process the new request.
 	 *    (This must be the last condtion to check)
 	 */
-	wait_event(ctx->wait, kthread_should_stop()
-		|| (mmc_peek_request(mq) &&
+	return mmc_peek_request(mq) &&
 		!((mq->cmdq_req_peeked->cmd_flags & (REQ_FLUSH | REQ_DISCARD))
-		  && test_bit(CMDQ_STATE_DCMD_ACTIVE, &ctx->curr_state))
+		  && test_bit(CMDQ_STATE_DCMD_ACTIVE, &host->cmdq_ctx.curr_state))
 		&& !(!host->card->part_curr && !mmc_card_suspended(host->card)
 		     && mmc_host_halt(host))
 		&& !(!host->card->part_curr && mmc_host_cq_disable(host) &&
 			!mmc_card_suspended(host->card))
-		&& !test_bit(CMDQ_STATE_ERR, &ctx->curr_state)
+		&& !test_bit(CMDQ_STATE_ERR, &host->cmdq_ctx.curr_state)
 		&& !atomic_read(&host->rpmb_req_pending)
-		&& !mmc_check_blk_queue_start_tag(q, mq->cmdq_req_peeked)));
+		&& !mmc_check_blk_queue_start_tag(q, mq->cmdq_req_peeked);
+}
+
+static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
+					struct mmc_queue *mq)
+{
+	wait_event(host->cmdq_ctx.wait, kthread_should_stop()
+		   || mmc_cmdq_ready(host, mq));
 }
 
 static int mmc_cmdq_thread(void *d)
@@ -130,12 +138,24 @@ static int mmc_cmdq_thread(void *d)
 
 	while (1) {
 		int ret = 0;
+		int batched = 0;
 
 		mmc_cmdq_ready_wait(host, mq);
 		if (kthread_should_stop())
 			break;
 
-		ret = mq->cmdq_issue_fn(mq, mq->cmdq_req_peeked);
+		/*
+		 * Keep issuing while requests are ready, with their doorbell
+		 * deferred, and ring it once for the whole batch when the
+		 * queue runs dry or the batch is full.
+		 */
+		do {
+			mq->cmdq_defer_db = ++batched < MMC_CMDQ_DB_BATCH;
+			ret = mq->cmdq_issue_fn(mq, mq->cmdq_req_peeked);
+		} while (mq->cmdq_defer_db && !kthread_should_stop() &&
+			 mmc_cmdq_ready(host, mq));
+		mq->cmdq_defer_db = false;
+		mmc_cmdq_commit(host);
 		/*
 		 * Don't requeue if issue_fn fails.
 		 * Recovery will be come by completion softirq
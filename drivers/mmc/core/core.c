@@ -365,6 +365,7 @@ int mmc_cmdq_halt_on_empty_queue(struct mmc_host *host)
 {
 	int err = 0;
 
+	mmc_cmdq_commit(host);
 	err = wait_event_interruptible(host->cmdq_ctx.queue_empty_wq,
 				(!host->cmdq_ctx.active_reqs));
 	if (host->cmdq_ctx.active_reqs) {
@@ -1029,6 +1030,7 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 			pr_debug("%s:     %d bytes transferred: %d\n",
 				mmc_hostname(host),
 				mrq->data->bytes_xfered, mrq->data->error);
+			mmc_io_stats_req_done(host, mrq);
 #ifdef CONFIG_BLOCK
 			if (mrq->lat_hist_enabled) {
 				ktime_t completion;
@@ -1155,6 +1157,9 @@ static int mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 		mrq->cmd->data = mrq->data;
 		mrq->data->error = 0;
 		mrq->data->mrq = mrq;
+#ifdef CONFIG_MMC_IO_STATS
+		mrq->io_start = ktime_get();
+#endif
 		if (mrq->stop) {
 			mrq->data->stop = mrq->stop;
 			mrq->stop->error = 0;
@@ -1236,6 +1241,9 @@ static int mmc_start_cmdq_request(struct mmc_host *host,
 			host->max_req_size);
 		mrq->data->error = 0;
 		mrq->data->mrq = mrq;
+#ifdef CONFIG_MMC_IO_STATS
+		mrq->io_start = ktime_get();
+#endif
 	}
 
 	if (mrq->cmd) {
@@ -1691,6 +1699,20 @@ void mmc_cmdq_post_req(struct mmc_host *host, int tag, int err)
 }
 EXPORT_SYMBOL(mmc_cmdq_post_req);
 
+/**
+ *	mmc_cmdq_commit - submit the requests issued with DEFER_DB
+ *	@host: host instance
+ *
+ *	Must be called before waiting on anything that needs the deferred
+ *	requests to complete, e.g. the queue to become empty.
+ */
+void mmc_cmdq_commit(struct mmc_host *host)
+{
+	if (host->cmdq_ops && host->cmdq_ops->commit)
+		host->cmdq_ops->commit(host);
+}
+EXPORT_SYMBOL(mmc_cmdq_commit);
+
 /**
  *	mmc_cmdq_halt - halt/un-halt the command queue engine
  *	@host: host instance
@@ -16,6 +16,7 @@
 #include <linux/stat.h>
 #include <linux/fault-inject.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -52,6 +53,66 @@ static const struct file_operations mmc_ring_buffer_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_MMC_IO_STATS
+static int mmc_io_latency_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *mmc = s->private;
+
+	mmc_io_stats_show(mmc, s);
+	return 0;
+}
+
+static int mmc_io_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_io_latency_show, inode->i_private);
+}
+
+/* Any write clears the histograms and the record ring */
+static ssize_t mmc_io_latency_write(struct file *file,
+		const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct mmc_host *mmc = file_inode(file)->i_private;
+
+	mmc_io_stats_reset(mmc);
+	return cnt;
+}
+
+static const struct file_operations mmc_io_latency_fops = {
+	.open		= mmc_io_latency_open,
+	.read		= seq_read,
+	.write		= mmc_io_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Dumps the records as an array of struct mmc_io_record, oldest first */
+static int mmc_io_records_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *mmc = s->private;
+	size_t len;
+	void *buf;
+
+	buf = mmc_io_stats_snapshot(mmc, &len);
+	if (!buf)
+		return -ENOMEM;
+	seq_write(s, buf, len);
+	vfree(buf);
+	return 0;
+}
+
+static int mmc_io_records_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_io_records_show, inode->i_private);
+}
+
+static const struct file_operations mmc_io_records_fops = {
+	.open		= mmc_io_records_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int mmc_ios_show(struct seq_file *s, void *data)
 {
 	static const char *vdd_str[] = {
@@ -424,6 +485,15 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 	if (!debugfs_create_file("ring_buffer", S_IRUSR,
 				root, host, &mmc_ring_buffer_fops))
 		goto err_node;
+#endif
+#ifdef CONFIG_MMC_IO_STATS
+	if (!debugfs_create_file("io_latency", S_IRUSR | S_IWUSR,
+				root, host, &mmc_io_latency_fops))
+		goto err_node;
+
+	if (!debugfs_create_file("io_records", S_IRUSR,
+				root, host, &mmc_io_records_fops))
+		goto err_node;
 #endif
 	if (!debugfs_create_file("err_state", S_IRUSR | S_IWUSR, root, host,
 		&mmc_err_state))
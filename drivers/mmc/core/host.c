@@ -696,6 +696,7 @@ int mmc_add_host(struct mmc_host *host)
 #endif
 	mmc_host_clk_sysfs_init(host);
 	mmc_trace_init(host);
+	mmc_io_stats_init(host);
 
 #ifdef CONFIG_BLOCK
 	mmc_latency_hist_sysfs_init(host);
@@ -732,6 +733,7 @@ void mmc_remove_host(struct mmc_host *host)
 #ifdef CONFIG_BLOCK
 	mmc_latency_hist_sysfs_exit(host);
 #endif
+	mmc_io_stats_free(host);
 
 	device_del(&host->class_dev);
 
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Per-host request latency statistics. Every completed read, write and
+ * discard is binned into a log2 latency histogram by operation and size
+ * and stored in a ring of fixed size binary records, following the
+ * layout of the text ring buffer tracer.
+ */
+
+#include <linux/blkdev.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/mmc/core.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/ring_buffer.h>
+
+static const char * const mmc_io_op_name[MMC_IO_NR_OPS] = {
+	[MMC_IO_READ]		= "read",
+	[MMC_IO_WRITE]		= "write",
+	[MMC_IO_DISCARD]	= "discard",
+};
+
+/* upper bounds of the size classes, the last class is open ended */
+static const unsigned int mmc_io_size_kb[MMC_IO_NR_SIZES - 1] = {
+	4, 64, 512
+};
+static const char * const mmc_io_size_name[MMC_IO_NR_SIZES] = {
+	"<=4K", "<=64K", "<=512K", ">512K"
+};
+
+static int mmc_io_size(unsigned int bytes)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mmc_io_size_kb); i++)
+		if (bytes <= mmc_io_size_kb[i] * 1024)
+			break;
+	return i;
+}
+
+static int mmc_io_bucket(u32 lat_us)
+{
+	return min(fls(lat_us >> MMC_IO_LAT_MIN_SHIFT), MMC_IO_NR_BUCKETS - 1);
+}
+
+void mmc_io_stats_account(struct mmc_host *mmc, enum mmc_io_op op,
+		unsigned int bytes, u32 addr, ktime_t start, int error)
+{
+	struct mmc_io_stats *st = &mmc->io_stats;
+	struct mmc_io_record *rec;
+	unsigned long flags;
+	u32 lat_us;
+
+	if (unlikely(!st->records))
+		return;
+
+	lat_us = ktime_us_delta(ktime_get(), start);
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->hist[op][mmc_io_size(bytes)][mmc_io_bucket(lat_us)]++;
+	st->sum_us[op] += lat_us;
+	if (lat_us > st->max_us[op])
+		st->max_us[op] = lat_us;
+
+	rec = &st->records[st->wr_idx++ & (MMC_IO_NR_RECORDS - 1)];
+	rec->start_ns = ktime_to_ns(start);
+	rec->lat_us = lat_us;
+	rec->addr = addr;
+	rec->bytes = bytes;
+	rec->op = op;
+	rec->error = !!error;
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+EXPORT_SYMBOL(mmc_io_stats_account);
+
+/*
+ * Account a completed data request, started at mrq->io_start. Discards
+ * take several commands and are accounted by their issuer.
+ */
+void mmc_io_stats_req_done(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+	int error;
+	u32 addr;
+
+	if (!data)
+		return;
+
+	error = data->error || (mrq->cmd && mrq->cmd->error);
+	addr = mrq->cmdq_req ? mrq->cmdq_req->blk_addr : mrq->cmd->arg;
+	mmc_io_stats_account(mmc, (data->flags & MMC_DATA_READ) ?
+			     MMC_IO_READ : MMC_IO_WRITE,
+			     data->blocks * data->blksz, addr,
+			     mrq->io_start, error);
+}
+EXPORT_SYMBOL(mmc_io_stats_req_done);
+
+/* upper bound of the bucket holding the pct percentile of hist */
+static u32 mmc_io_percentile(const u32 *hist, u64 count, int pct, u32 max)
+{
+	u64 want = div_u64(count * pct + 99, 100);
+	u64 seen = 0;
+	int i;
+
+	for (i = 0; i < MMC_IO_NR_BUCKETS - 1; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return min_t(u32, (1U << MMC_IO_LAT_MIN_SHIFT) << i, max);
+	}
+	return max;
+}
+
+static void mmc_io_stats_show_row(struct seq_file *s, const char *op,
+		const char *size, const u32 *hist, u32 max)
+{
+	u64 count = 0;
+	int i;
+
+	for (i = 0; i < MMC_IO_NR_BUCKETS; i++)
+		count += hist[i];
+	if (!count)
+		return;
+
+	seq_printf(s, "%-8s %-7s %10llu %8u %8u", op, size, count,
+		   mmc_io_percentile(hist, count, 50, max),
+		   mmc_io_percentile(hist, count, 99, max));
+	for (i = 0; i < MMC_IO_NR_BUCKETS; i++)
+		seq_printf(s, " %u", hist[i]);
+	seq_puts(s, "\n");
+}
+
+void mmc_io_stats_show(struct mmc_host *mmc, struct seq_file *s)
+{
+	struct mmc_io_stats *st = &mmc->io_stats;
+	u32 hist[MMC_IO_NR_OPS][MMC_IO_NR_SIZES][MMC_IO_NR_BUCKETS];
+	u32 total[MMC_IO_NR_BUCKETS];
+	u64 sum_us[MMC_IO_NR_OPS];
+	u32 max_us[MMC_IO_NR_OPS];
+	unsigned long flags;
+	u64 count;
+	int op, sz, i;
+
+	spin_lock_irqsave(&st->lock, flags);
+	memcpy(hist, st->hist, sizeof(hist));
+	memcpy(sum_us, st->sum_us, sizeof(sum_us));
+	memcpy(max_us, st->max_us, sizeof(max_us));
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	seq_printf(s, "# latency buckets: <%uus, doubling, last is the rest\n",
+		   1U << MMC_IO_LAT_MIN_SHIFT);
+	seq_puts(s, "# op      size         count   p50_us   p99_us buckets\n");
+	for (op = 0; op < MMC_IO_NR_OPS; op++) {
+		memset(total, 0, sizeof(total));
+		for (sz = 0; sz < MMC_IO_NR_SIZES; sz++) {
+			mmc_io_stats_show_row(s, mmc_io_op_name[op],
+					      mmc_io_size_name[sz],
+					      hist[op][sz], max_us[op]);
+			for (i = 0; i < MMC_IO_NR_BUCKETS; i++)
+				total[i] += hist[op][sz][i];
+		}
+		mmc_io_stats_show_row(s, mmc_io_op_name[op], "all", total,
+				      max_us[op]);
+	}
+
+	seq_puts(s, "# op      avg_us   max_us\n");
+	for (op = 0; op < MMC_IO_NR_OPS; op++) {
+		count = 0;
+		for (sz = 0; sz < MMC_IO_NR_SIZES; sz++)
+			for (i = 0; i < MMC_IO_NR_BUCKETS; i++)
+				count += hist[op][sz][i];
+		seq_printf(s, "%-8s %8llu %8u\n", mmc_io_op_name[op],
+			   count ? div64_u64(sum_us[op], count) : 0,
+			   max_us[op]);
+	}
+}
+
+/*
+ * Copy the records out, oldest first, into a vmalloc'ed buffer that the
+ * caller frees with vfree().
+ */
+void *mmc_io_stats_snapshot(struct mmc_host *mmc, size_t *len)
+{
+	struct mmc_io_stats *st = &mmc->io_stats;
+	struct mmc_io_record *buf;
+	unsigned long flags;
+	unsigned int n, first, i;
+
+	buf = vmalloc(MMC_IO_NR_RECORDS * sizeof(*buf));
+	if (!buf)
+		return NULL;
+
+	spin_lock_irqsave(&st->lock, flags);
+	n = min_t(unsigned int, st->wr_idx, MMC_IO_NR_RECORDS);
+	first = st->wr_idx - n;
+	for (i = 0; i < n; i++)
+		buf[i] = st->records[(first + i) & (MMC_IO_NR_RECORDS - 1)];
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	*len = n * sizeof(*buf);
+	return buf;
+}
+
+void mmc_io_stats_reset(struct mmc_host *mmc)
+{
+	struct mmc_io_stats *st = &mmc->io_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	memset(st->hist, 0, sizeof(st->hist));
+	memset(st->sum_us, 0, sizeof(st->sum_us));
+	memset(st->max_us, 0, sizeof(st->max_us));
+	st->wr_idx = 0;
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
+void mmc_io_stats_init(struct mmc_host *mmc)
+{
+	struct mmc_io_stats *st = &mmc->io_stats;
+
+	BUILD_BUG_ON_NOT_POWER_OF_2(MMC_IO_NR_RECORDS);
+
+	spin_lock_init(&st->lock);
+	st->records = vzalloc(MMC_IO_NR_RECORDS * sizeof(*st->records));
+	if (!st->records)
+		pr_err("%s: %s: Unable to allocate io stats for mmc\n",
+			__func__, mmc_hostname(mmc));
+}
+
+void mmc_io_stats_free(struct mmc_host *mmc)
+{
+	vfree(mmc->io_stats.records);
+	mmc->io_stats.records = NULL;
+}
@@ -497,6 +497,7 @@ static void cmdq_disable_nosync(struct mmc_host *mmc, bool soft)
 		cq_host->ops->enhanced_strobe_mask(mmc, false);
 
 	cq_host->enabled = false;
+	cq_host->pending_db = 0;
 	mmc_host_set_cq_disable(mmc);
 	MMC_TRACE(mmc, "%s: CQ disabled\n", __func__);
 }
@@ -773,6 +774,34 @@ static void cmdq_pm_qos_unvote(struct sdhci_host *host, struct mmc_request *mrq)
 	sdhci_msm_pm_qos_cpu_unvote(host, mrq->req->cpu, true);
 }
 
+static void cmdq_ring_doorbell(struct cmdq_host *cq_host, u32 db)
+{
+	/* Ensure the task descriptor list is flushed before ringing doorbell */
+	wmb();
+	if (cmdq_readl(cq_host, CQTDBR) & db) {
+		cmdq_dumpregs(cq_host);
+		BUG_ON(1);
+	}
+	MMC_TRACE(cq_host->mmc, "%s: doorbell: 0x%08x\n", __func__, db);
+	cmdq_writel(cq_host, db, CQTDBR);
+	/* Commit the doorbell write immediately */
+	wmb();
+}
+
+/*
+ * Ring the doorbell for the slots prepared with DEFER_DB, so that a batch
+ * of tasks is handed to the CQE with a single register write.
+ */
+static void cmdq_commit(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = (struct cmdq_host *)mmc_cmdq_private(mmc);
+	u32 db;
+
+	db = xchg(&cq_host->pending_db, 0);
+	if (db && cq_host->enabled)
+		cmdq_ring_doorbell(cq_host, db);
+}
+
 static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
 {
 	int err = 0;
@@ -832,16 +861,14 @@ static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	sdhci_msm_pm_qos_irq_vote(host);
 	cmdq_pm_qos_vote(host, mrq);
 ring_doorbell:
-	/* Ensure the task descriptor list is flushed before ringing doorbell */
-	wmb();
-	if (cmdq_readl(cq_host, CQTDBR) & (1 << tag)) {
-		cmdq_dumpregs(cq_host);
-		BUG_ON(1);
-	}
 	MMC_TRACE(mmc, "%s: tag: %d\n", __func__, tag);
-	cmdq_writel(cq_host, 1 << tag, CQTDBR);
-	/* Commit the doorbell write immediately */
-	wmb();
+	if (mrq->cmdq_req->cmdq_req_flags & DEFER_DB) {
+		set_bit(tag, &cq_host->pending_db);
+		return err;
+	}
+	/* pick up the slots deferred so far along with this one */
+	cmdq_ring_doorbell(cq_host,
+			   xchg(&cq_host->pending_db, 0) | (1 << tag));
 
 	return err;
 
@@ -1201,6 +1228,8 @@ static int cmdq_halt(struct mmc_host *mmc, bool halt)
 
 	cmdq_runtime_pm_get(cq_host);
 	if (halt) {
+		/* tasks already prepared must not be lost behind the halt */
+		cmdq_commit(mmc);
 		while (retries) {
 			cmdq_writel(cq_host, cmdq_readl(cq_host, CQCTL) | HALT,
 				    CQCTL);
@@ -1313,6 +1342,7 @@ static const struct mmc_cmdq_host_ops cmdq_host_ops = {
 	.enable = cmdq_enable,
 	.disable = cmdq_disable,
 	.request = cmdq_request,
+	.commit = cmdq_commit,
 	.post_req = cmdq_post_req,
 	.halt = cmdq_halt,
 	.reset	= cmdq_reset,
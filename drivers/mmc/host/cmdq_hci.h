@@ -207,6 +207,8 @@ struct cmdq_host {
 
 	struct completion halt_comp;
 	struct mmc_request **mrq_slot;
+	/* prepared slots whose doorbell write was deferred */
+	unsigned long pending_db;
 	void *private;
 };
 
@@ -1276,6 +1276,39 @@ int rndis_ipa_pipe_disconnect_notify(void *private)
 }
 EXPORT_SYMBOL(rndis_ipa_pipe_disconnect_notify);
 
+/**
+ * rndis_ipa_set_dl_aggr() - switch IPA->USB aggregation on or off
+ * @enable: use the aggregation negotiated at connect if true, send every
+ *  packet in its own transfer otherwise
+ *
+ * Lets the USB function trade DL efficiency for latency at runtime
+ * without renegotiating the transfer size with the host.
+ *
+ * Returns negative errno, or zero on success
+ */
+int rndis_ipa_set_dl_aggr(bool enable)
+{
+	struct rndis_ipa_dev *rndis_ipa_ctx = rndis_ipa;
+	struct ipa_ep_cfg_aggr aggr = ipa_to_usb_ep_cfg.aggr;
+
+	NULL_CHECK_RETVAL(rndis_ipa_ctx);
+
+	if (rndis_ipa_ctx->state != RNDIS_IPA_CONNECTED &&
+	    rndis_ipa_ctx->state != RNDIS_IPA_CONNECTED_AND_UP)
+		return -EPERM;
+
+	if (!enable) {
+		aggr.aggr_byte_limit = 0;
+		aggr.aggr_time_limit = 0;
+		aggr.aggr_pkt_limit = 1;
+	}
+
+	RNDIS_IPA_DEBUG("DL aggregation %s\n", enable ? "on" : "off");
+
+	return ipa_cfg_ep_aggr(rndis_ipa_ctx->ipa_to_usb_hdl, &aggr);
+}
+EXPORT_SYMBOL(rndis_ipa_set_dl_aggr);
+
 /**
  * rndis_ipa_cleanup() - unregister the network interface driver and free
  *  internal data structs.
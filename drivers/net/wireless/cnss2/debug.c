@@ -447,6 +447,62 @@ static const struct file_operations cnss_reg_write_debug_fops = {
 	.llseek		= seq_lseek,
 };
 
+static ssize_t cnss_irq_affinity_write(struct file *fp,
+				       const char __user *user_buf,
+				       size_t count, loff_t *off)
+{
+	struct cnss_plat_data *plat_priv =
+		((struct seq_file *)fp->private_data)->private;
+	char buf[32];
+	unsigned int len = 0, vector;
+	int cpu, ret;
+
+	if (plat_priv->bus_type != CNSS_BUS_PCI)
+		return -EOPNOTSUPP;
+
+	len = min(count, sizeof(buf) - 1);
+	if (copy_from_user(buf, user_buf, len))
+		return -EFAULT;
+
+	buf[len] = '\0';
+	if (sscanf(buf, "%u %d", &vector, &cpu) != 2) {
+		cnss_pr_err("Usage: echo <vector> <cpu, -1 to unpin> > irq_affinity\n");
+		return -EINVAL;
+	}
+
+	ret = cnss_pci_set_irq_cpu(plat_priv->bus_priv, vector, cpu);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static int cnss_irq_affinity_show(struct seq_file *s, void *data)
+{
+	struct cnss_plat_data *plat_priv = s->private;
+
+	if (plat_priv->bus_type != CNSS_BUS_PCI)
+		return 0;
+
+	cnss_pci_irq_affinity_show(plat_priv->bus_priv, s);
+
+	return 0;
+}
+
+static int cnss_irq_affinity_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cnss_irq_affinity_show, inode->i_private);
+}
+
+static const struct file_operations cnss_irq_affinity_fops = {
+	.read		= seq_read,
+	.write		= cnss_irq_affinity_write,
+	.release	= single_release,
+	.open		= cnss_irq_affinity_open,
+	.owner		= THIS_MODULE,
+	.llseek		= seq_lseek,
+};
+
 #ifdef CONFIG_CNSS2_DEBUG
 static int cnss_create_debug_only_node(struct cnss_plat_data *plat_priv)
 {
@@ -486,6 +542,8 @@ int cnss_debugfs_create(struct cnss_plat_data *plat_priv)
 			    &cnss_pin_connect_fops);
 	debugfs_create_file("stats", 0644, root_dentry, plat_priv,
 			    &cnss_stats_fops);
+	debugfs_create_file("irq_affinity", 0600, root_dentry, plat_priv,
+			    &cnss_irq_affinity_fops);
 
 	cnss_create_debug_only_node(plat_priv);
 
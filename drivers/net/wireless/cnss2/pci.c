@@ -63,6 +63,11 @@ module_param(pci_link_down_panic, uint, 0600);
 MODULE_PARM_DESC(pci_link_down_panic,
 		 "Trigger kernel panic when PCI link down is detected");
 
+static unsigned int irq_balance_ms = 1000;
+module_param(irq_balance_ms, uint, 0600);
+MODULE_PARM_DESC(irq_balance_ms,
+		 "Interval of CE/DP MSI rebalancing by load, 0 for static");
+
 static bool fbc_bypass;
 #ifdef CONFIG_CNSS2_DEBUG
 module_param(fbc_bypass, bool, 0600);
@@ -294,6 +299,311 @@ int cnss_pci_recovery_update_status(struct cnss_pci_data *pci_priv)
 	return 0;
 }
 
+static struct cnss_msi_user *cnss_pci_vector_user(struct cnss_pci_data *pci_priv,
+						  unsigned int vector)
+{
+	struct cnss_msi_config *msi_config = pci_priv->msi_config;
+	struct cnss_msi_user *user;
+	int idx;
+
+	for (idx = 0; idx < msi_config->total_users; idx++) {
+		user = &msi_config->users[idx];
+		if (vector >= user->base_vector &&
+		    vector < user->base_vector + user->num_vectors)
+			return user;
+	}
+
+	return NULL;
+}
+
+/*
+ * Data path rings go to the gold (highest numbered) cluster and CE rings
+ * to the remaining cores. MHI and WAKE vectors are left alone.
+ */
+static bool cnss_pci_vector_cpus(struct cnss_pci_data *pci_priv,
+				 unsigned int vector, struct cpumask *mask)
+{
+	struct cnss_msi_user *user = cnss_pci_vector_user(pci_priv, vector);
+	int cpu, gold = 0;
+	bool is_dp;
+
+	if (!user)
+		return false;
+	if (!strcmp(user->name, "DP"))
+		is_dp = true;
+	else if (!strcmp(user->name, "CE"))
+		is_dp = false;
+	else
+		return false;
+
+	for_each_online_cpu(cpu)
+		gold = max(gold, topology_physical_package_id(cpu));
+
+	cpumask_clear(mask);
+	for_each_online_cpu(cpu)
+		if ((topology_physical_package_id(cpu) == gold) == is_dp)
+			cpumask_set_cpu(cpu, mask);
+	if (cpumask_empty(mask))
+		cpumask_copy(mask, cpu_online_mask);
+
+	return true;
+}
+
+static void cnss_pci_apply_irq_cpu(struct cnss_pci_data *pci_priv,
+				   unsigned int vector)
+{
+	struct cnss_msi_irq *msi_irq = &pci_priv->msi_irqs[vector];
+	int ret;
+
+	if (msi_irq->cpu < 0 || !cpu_online(msi_irq->cpu))
+		return;
+
+	ret = irq_set_affinity_hint(pci_priv->pci_dev->irq + vector,
+				    cpumask_of(msi_irq->cpu));
+	if (ret)
+		cnss_pr_dbg("Failed to set MSI vector %u affinity, err = %d\n",
+			    vector, ret);
+}
+
+static unsigned int cnss_pci_irq_count(unsigned int irq)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	unsigned int sum = 0;
+	int cpu;
+
+	if (!desc || !desc->kstat_irqs)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		sum += *per_cpu_ptr(desc->kstat_irqs, cpu);
+
+	return sum;
+}
+
+/*
+ * Greedily place the managed vectors, busiest first, on the least loaded
+ * core of their cluster. Pinned vectors count towards the load of their
+ * core but are not moved. Every vector weighs at least one so that idle
+ * ones are still spread. The new placement is only applied when it
+ * lowers the load of the busiest core by more than an eighth.
+ */
+static void cnss_pci_balance_irqs(struct cnss_pci_data *pci_priv, bool force)
+{
+	int total = pci_priv->msi_config->total_vectors;
+	unsigned int cpu_load[NR_CPUS] = { 0 };
+	unsigned int old_load[NR_CPUS] = { 0 };
+	unsigned int old_max = 0, new_max = 0;
+	int new_cpu[CNSS_MAX_MSI_VECTORS];
+	struct cnss_msi_irq *msi_irq;
+	struct cpumask mask;
+	bool done[CNSS_MAX_MSI_VECTORS] = { 0 };
+	int vector, best, cpu, i;
+
+	for (vector = 0; vector < total; vector++) {
+		msi_irq = &pci_priv->msi_irqs[vector];
+		new_cpu[vector] = msi_irq->cpu;
+		if (msi_irq->cpu >= 0)
+			old_load[msi_irq->cpu] += msi_irq->load + 1;
+		if (!msi_irq->managed || msi_irq->pinned) {
+			done[vector] = true;
+			if (msi_irq->cpu >= 0)
+				cpu_load[msi_irq->cpu] += msi_irq->load + 1;
+		}
+	}
+
+	for (i = 0; i < total; i++) {
+		best = -1;
+		for (vector = 0; vector < total; vector++)
+			if (!done[vector] && (best < 0 ||
+			    pci_priv->msi_irqs[vector].load >
+			    pci_priv->msi_irqs[best].load))
+				best = vector;
+		if (best < 0)
+			break;
+		done[best] = true;
+
+		if (!cnss_pci_vector_cpus(pci_priv, best, &mask))
+			continue;
+		new_cpu[best] = cpumask_first(&mask);
+		for_each_cpu(cpu, &mask)
+			if (cpu_load[cpu] < cpu_load[new_cpu[best]])
+				new_cpu[best] = cpu;
+		cpu_load[new_cpu[best]] += pci_priv->msi_irqs[best].load + 1;
+	}
+
+	for_each_online_cpu(cpu) {
+		old_max = max(old_max, old_load[cpu]);
+		new_max = max(new_max, cpu_load[cpu]);
+	}
+	if (!force && new_max >= old_max - old_max / 8)
+		return;
+
+	for (vector = 0; vector < total; vector++) {
+		msi_irq = &pci_priv->msi_irqs[vector];
+		if (msi_irq->cpu == new_cpu[vector] && !force)
+			continue;
+		msi_irq->cpu = new_cpu[vector];
+		cnss_pci_apply_irq_cpu(pci_priv, vector);
+	}
+}
+
+static void cnss_pci_irq_balance_work(struct work_struct *work)
+{
+	struct cnss_pci_data *pci_priv =
+		container_of(to_delayed_work(work), struct cnss_pci_data,
+			     irq_balance_work);
+	struct cnss_msi_irq *msi_irq;
+	unsigned int count;
+	int vector;
+
+	mutex_lock(&pci_priv->irq_lock);
+	for (vector = 0; vector < pci_priv->msi_config->total_vectors;
+	     vector++) {
+		msi_irq = &pci_priv->msi_irqs[vector];
+		count = cnss_pci_irq_count(pci_priv->pci_dev->irq + vector);
+		msi_irq->load = count - msi_irq->count;
+		msi_irq->count = count;
+	}
+	cnss_pci_balance_irqs(pci_priv, false);
+	mutex_unlock(&pci_priv->irq_lock);
+
+	if (irq_balance_ms)
+		schedule_delayed_work(&pci_priv->irq_balance_work,
+				      msecs_to_jiffies(irq_balance_ms));
+}
+
+static void cnss_pci_irq_balance_start(struct cnss_pci_data *pci_priv)
+{
+	if (!pci_priv->msi_irqs)
+		return;
+
+	mutex_lock(&pci_priv->irq_lock);
+	pci_priv->irq_balance_on = true;
+	cnss_pci_balance_irqs(pci_priv, true);
+	mutex_unlock(&pci_priv->irq_lock);
+
+	if (irq_balance_ms)
+		schedule_delayed_work(&pci_priv->irq_balance_work,
+				      msecs_to_jiffies(irq_balance_ms));
+}
+
+/* The host driver frees its IRQs on remove, drop our hints before that */
+static void cnss_pci_irq_balance_stop(struct cnss_pci_data *pci_priv)
+{
+	int vector;
+
+	if (!pci_priv->msi_irqs)
+		return;
+
+	cancel_delayed_work_sync(&pci_priv->irq_balance_work);
+
+	mutex_lock(&pci_priv->irq_lock);
+	pci_priv->irq_balance_on = false;
+	for (vector = 0; vector < pci_priv->msi_config->total_vectors;
+	     vector++)
+		irq_set_affinity_hint(pci_priv->pci_dev->irq + vector, NULL);
+	mutex_unlock(&pci_priv->irq_lock);
+}
+
+int cnss_pci_set_irq_cpu(struct cnss_pci_data *pci_priv, unsigned int vector,
+			 int cpu)
+{
+	struct cnss_msi_irq *msi_irq;
+
+	if (!pci_priv || !pci_priv->msi_irqs ||
+	    vector >= pci_priv->msi_config->total_vectors)
+		return -EINVAL;
+	if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu)))
+		return -EINVAL;
+
+	mutex_lock(&pci_priv->irq_lock);
+	msi_irq = &pci_priv->msi_irqs[vector];
+	msi_irq->pinned = cpu >= 0;
+	if (cpu >= 0) {
+		msi_irq->cpu = cpu;
+		if (pci_priv->irq_balance_on)
+			cnss_pci_apply_irq_cpu(pci_priv, vector);
+	}
+	mutex_unlock(&pci_priv->irq_lock);
+
+	cnss_pr_dbg("MSI vector %u %s CPU %d\n", vector,
+		    cpu >= 0 ? "pinned to" : "unpinned from", msi_irq->cpu);
+
+	return 0;
+}
+
+void cnss_pci_irq_affinity_show(struct cnss_pci_data *pci_priv,
+				struct seq_file *s)
+{
+	struct cnss_msi_user *user;
+	struct cnss_msi_irq *msi_irq;
+	int vector;
+
+	if (!pci_priv || !pci_priv->msi_irqs) {
+		seq_puts(s, "MSI is not enabled\n");
+		return;
+	}
+
+	seq_printf(s, "Balance interval: %u ms, %s\n", irq_balance_ms,
+		   pci_priv->irq_balance_on ? "active" : "inactive");
+	seq_puts(s, "vector irq user cpu pinned count load\n");
+
+	mutex_lock(&pci_priv->irq_lock);
+	for (vector = 0; vector < pci_priv->msi_config->total_vectors;
+	     vector++) {
+		msi_irq = &pci_priv->msi_irqs[vector];
+		user = cnss_pci_vector_user(pci_priv, vector);
+		seq_printf(s, "%6d %3d %4s %3d %6d %u %u\n", vector,
+			   pci_priv->pci_dev->irq + vector,
+			   user ? user->name : "-", msi_irq->cpu,
+			   msi_irq->pinned,
+			   cnss_pci_irq_count(pci_priv->pci_dev->irq + vector),
+			   msi_irq->load);
+	}
+	mutex_unlock(&pci_priv->irq_lock);
+}
+
+static int cnss_pci_init_irq_affinity(struct cnss_pci_data *pci_priv)
+{
+	int total = pci_priv->msi_config->total_vectors;
+	struct cpumask mask;
+	int vector;
+
+	if (WARN_ON(total > CNSS_MAX_MSI_VECTORS))
+		return -EINVAL;
+
+	pci_priv->msi_irqs = kcalloc(total, sizeof(*pci_priv->msi_irqs),
+				     GFP_KERNEL);
+	if (!pci_priv->msi_irqs)
+		return -ENOMEM;
+
+	for (vector = 0; vector < total; vector++) {
+		pci_priv->msi_irqs[vector].cpu = -1;
+		pci_priv->msi_irqs[vector].managed =
+			cnss_pci_vector_cpus(pci_priv, vector, &mask);
+	}
+
+	mutex_init(&pci_priv->irq_lock);
+	INIT_DELAYED_WORK(&pci_priv->irq_balance_work,
+			  cnss_pci_irq_balance_work);
+
+	return 0;
+}
+
+static void cnss_pci_deinit_irq_affinity(struct cnss_pci_data *pci_priv)
+{
+	kfree(pci_priv->msi_irqs);
+	pci_priv->msi_irqs = NULL;
+}
+
+int cnss_set_msi_irq_cpu(struct device *dev, unsigned int vector, int cpu)
+{
+	struct pci_dev *pci_dev = to_pci_dev(dev);
+
+	return cnss_pci_set_irq_cpu(cnss_get_pci_priv(pci_dev), vector, cpu);
+}
+EXPORT_SYMBOL(cnss_set_msi_irq_cpu);
+
 int cnss_pci_call_driver_probe(struct cnss_pci_data *pci_priv)
 {
 	int ret = 0;
@@ -339,6 +649,8 @@ int cnss_pci_call_driver_probe(struct cnss_pci_data *pci_priv)
 		set_bit(CNSS_DRIVER_PROBED, &plat_priv->driver_state);
 	}
 
+	cnss_pci_irq_balance_start(pci_priv);
+
 	return 0;
 
 out:
@@ -366,6 +678,8 @@ int cnss_pci_call_driver_remove(struct cnss_pci_data *pci_priv)
 		return -EINVAL;
 	}
 
+	cnss_pci_irq_balance_stop(pci_priv);
+
 	if (test_bit(CNSS_DRIVER_RECOVERY, &plat_priv->driver_state) &&
 	    test_bit(CNSS_DRIVER_PROBED, &plat_priv->driver_state)) {
 		pci_priv->driver_ops->shutdown(pci_priv->pci_dev);
@@ -1730,6 +2044,10 @@ static int cnss_pci_enable_msi(struct cnss_pci_data *pci_priv)
 
 	cnss_pr_dbg("MSI base data is %d\n", pci_priv->msi_ep_base_data);
 
+	ret = cnss_pci_init_irq_affinity(pci_priv);
+	if (ret)
+		cnss_pr_err("Failed to init MSI affinity, err = %d\n", ret);
+
 	return 0;
 
 disable_msi:
@@ -1742,6 +2060,7 @@ out:
 
 static void cnss_pci_disable_msi(struct cnss_pci_data *pci_priv)
 {
+	cnss_pci_deinit_irq_affinity(pci_priv);
 	pci_disable_msi(pci_priv->pci_dev);
 }
 
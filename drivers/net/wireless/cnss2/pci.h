@@ -18,6 +18,7 @@
 #include <linux/msm_mhi.h>
 #include <linux/msm_pcie.h>
 #include <linux/pci.h>
+#include <linux/seq_file.h>
 
 #include "main.h"
 
@@ -51,6 +52,24 @@ struct cnss_msi_user {
 	u32 base_vector;
 };
 
+#define CNSS_MAX_MSI_VECTORS		32
+
+/**
+ * struct cnss_msi_irq - placement of one MSI vector
+ * @cpu: CPU the vector is steered to, -1 if never placed
+ * @pinned: placed by the user, not moved by the balancer
+ * @managed: CE or DP vector, placed by the balancer
+ * @count: interrupt count at the last balance pass
+ * @load: interrupts taken during the last balance interval
+ */
+struct cnss_msi_irq {
+	int cpu;
+	bool pinned;
+	bool managed;
+	unsigned int count;
+	unsigned int load;
+};
+
 struct cnss_msi_config {
 	int total_vectors;
 	int total_users;
@@ -80,6 +99,10 @@ struct cnss_pci_data {
 	void __iomem *bar;
 	struct cnss_msi_config *msi_config;
 	u32 msi_ep_base_data;
+	struct cnss_msi_irq *msi_irqs;
+	struct mutex irq_lock;
+	struct delayed_work irq_balance_work;
+	bool irq_balance_on;
 	struct mhi_device mhi_dev;
 	unsigned long mhi_state;
 };
@@ -158,6 +181,10 @@ void cnss_pci_collect_dump_info(struct cnss_pci_data *pci_priv);
 void cnss_pci_clear_dump_info(struct cnss_pci_data *pci_priv);
 int cnss_pm_request_resume(struct cnss_pci_data *pci_priv);
 u32 cnss_pci_get_wake_msi(struct cnss_pci_data *pci_priv);
+int cnss_pci_set_irq_cpu(struct cnss_pci_data *pci_priv, unsigned int vector,
+			 int cpu);
+void cnss_pci_irq_affinity_show(struct cnss_pci_data *pci_priv,
+				struct seq_file *s);
 int cnss_pci_force_fw_assert_hdlr(struct cnss_pci_data *pci_priv);
 void cnss_pci_fw_boot_timeout_hdlr(struct cnss_pci_data *pci_priv);
 int cnss_pci_call_driver_probe(struct cnss_pci_data *pci_priv);
@@ -17,6 +17,8 @@
 #include <linux/wcnss_wlan.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/workqueue.h>
 #include <net/cnss_prealloc.h>
 #ifdef	CONFIG_WCNSS_SKB_PRE_ALLOC
 #include <linux/skbuff.h>
@@ -31,98 +33,136 @@ static DEFINE_SPINLOCK(alloc_lock);
 #define PRE_ALLOC_DEBUGFS_DIR		"cnss-prealloc"
 #define PRE_ALLOC_DEBUGFS_FILE_OBJ	"status"
 
+/*
+ * Slots a class may grow by on top of its boot time reserve. Grown slots
+ * are allocated from process context once the class ran dry and are given
+ * back to the system under memory pressure.
+ */
+static unsigned int prealloc_grow_max = 4;
+module_param(prealloc_grow_max, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(prealloc_grow_max, "Max slots grown per size class");
+
 static struct dentry *debug_base;
 
+struct wcnss_prealloc_class;
+
 struct wcnss_prealloc {
 	int occupied;
-	size_t size;
+	bool grown;
 	void *ptr;
+	struct wcnss_prealloc_class *cls;
+	struct list_head list;
+	struct hlist_node node;
 #ifdef CONFIG_SLUB_DEBUG
 	unsigned long stack_trace[WCNSS_MAX_STACK_TRACE];
 	struct stack_trace trace;
 #endif
 };
 
-/* pre-alloced mem for WLAN driver */
-static struct wcnss_prealloc wcnss_allocs[] = {
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 128 * 1024, NULL},
-	{0, 128 * 1024, NULL},
+/**
+ * struct wcnss_prealloc_class - slots of one buffer size
+ * @size: buffer size of every slot in the class
+ * @reserve: slots allocated at init, never given back
+ * @free: slots ready to be handed out
+ * @used: slots handed out
+ * @total: slots in the class, reserve and grown
+ * @nr_used: slots on @used
+ * @high_water: max of @nr_used since init
+ * @grown: slots added on demand since init
+ * @spill: gets served from a bigger class because this one was empty
+ * @fail: gets that left empty handed
+ */
+struct wcnss_prealloc_class {
+	size_t size;
+	unsigned int reserve;
+	struct list_head free;
+	struct list_head used;
+	unsigned int total;
+	unsigned int nr_used;
+	unsigned int high_water;
+	unsigned int grown;
+	unsigned int spill;
+	unsigned int fail;
+};
+
+/* pre-alloced mem for WLAN driver, each class doubles the previous one */
+static struct wcnss_prealloc_class wcnss_classes[] = {
+	{ .size = 8 * 1024,	.reserve = 8 },
+	{ .size = 16 * 1024,	.reserve = 42 },
+	{ .size = 32 * 1024,	.reserve = 10 },
+	{ .size = 64 * 1024,	.reserve = 5 },
+	{ .size = 128 * 1024,	.reserve = 2 },
 };
 
+/* slot lookup by buffer address for wcnss_prealloc_put() */
+static DEFINE_HASHTABLE(wcnss_prealloc_hash, 7);
+
+static void wcnss_prealloc_grow_work(struct work_struct *work);
+static DECLARE_WORK(grow_work, wcnss_prealloc_grow_work);
+
+/* smallest class whose buffers hold size bytes, ARRAY_SIZE if none */
+static int wcnss_prealloc_class_idx(size_t size)
+{
+	int idx = 0;
+
+	if (size > wcnss_classes[0].size)
+		idx = order_base_2(DIV_ROUND_UP(size, wcnss_classes[0].size));
+
+	return min_t(int, idx, ARRAY_SIZE(wcnss_classes));
+}
+
+static int wcnss_prealloc_add(struct wcnss_prealloc_class *cls, bool grown,
+			      gfp_t gfp)
+{
+	struct wcnss_prealloc *entry;
+	unsigned long flags;
+
+	entry = kzalloc(sizeof(*entry), gfp);
+	if (!entry)
+		return -ENOMEM;
+
+	entry->ptr = kmalloc(cls->size, gfp);
+	if (!entry->ptr) {
+		kfree(entry);
+		return -ENOMEM;
+	}
+	entry->cls = cls;
+	entry->grown = grown;
+
+	spin_lock_irqsave(&alloc_lock, flags);
+	list_add_tail(&entry->list, &cls->free);
+	hash_add(wcnss_prealloc_hash, &entry->node, (unsigned long)entry->ptr);
+	cls->total++;
+	if (grown)
+		cls->grown++;
+	spin_unlock_irqrestore(&alloc_lock, flags);
+
+	return 0;
+}
+
+static void wcnss_prealloc_free(struct wcnss_prealloc *entry)
+{
+	kfree(entry->ptr);
+	kfree(entry);
+}
+
 int wcnss_prealloc_init(void)
 {
-	int i;
+	int i, j, ret;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		wcnss_allocs[i].occupied = 0;
-		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
-		if (wcnss_allocs[i].ptr == NULL)
-			return -ENOMEM;
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		INIT_LIST_HEAD(&wcnss_classes[i].free);
+		INIT_LIST_HEAD(&wcnss_classes[i].used);
+		WARN_ON(wcnss_classes[i].size != wcnss_classes[0].size << i);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		for (j = 0; j < wcnss_classes[i].reserve; j++) {
+			ret = wcnss_prealloc_add(&wcnss_classes[i], false,
+						 GFP_KERNEL);
+			if (ret)
+				return ret;
+		}
 	}
 
 	return 0;
@@ -130,11 +170,22 @@ int wcnss_prealloc_init(void)
 
 void wcnss_prealloc_deinit(void)
 {
-	int i = 0;
+	struct wcnss_prealloc *entry, *tmp;
+	int i;
+
+	cancel_work_sync(&grow_work);
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		struct wcnss_prealloc_class *cls = &wcnss_classes[i];
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		kfree(wcnss_allocs[i].ptr);
-		wcnss_allocs[i].ptr = NULL;
+		list_splice_init(&cls->used, &cls->free);
+		list_for_each_entry_safe(entry, tmp, &cls->free, list) {
+			hash_del(&entry->node);
+			list_del(&entry->list);
+			wcnss_prealloc_free(entry);
+		}
+		cls->total = 0;
+		cls->nr_used = 0;
 	}
 }
 
@@ -160,23 +211,58 @@ static inline void wcnss_prealloc_save_stack_trace(struct wcnss_prealloc *entry)
 }
 #endif
 
+/* Top up every class that ran dry, up to prealloc_grow_max extra slots */
+static void wcnss_prealloc_grow_work(struct work_struct *work)
+{
+	struct wcnss_prealloc_class *cls;
+	unsigned long flags;
+	bool grow;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		cls = &wcnss_classes[i];
+		do {
+			spin_lock_irqsave(&alloc_lock, flags);
+			grow = list_empty(&cls->free) &&
+				cls->total < cls->reserve + prealloc_grow_max;
+			spin_unlock_irqrestore(&alloc_lock, flags);
+		} while (grow && !wcnss_prealloc_add(cls, true, GFP_KERNEL));
+	}
+}
+
 void *wcnss_prealloc_get(size_t size)
 {
-	int i = 0;
+	struct wcnss_prealloc_class *cls;
+	struct wcnss_prealloc *entry;
 	unsigned long flags;
+	int want, i;
+
+	want = wcnss_prealloc_class_idx(size);
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	for (i = want; i < ARRAY_SIZE(wcnss_classes); i++) {
+		cls = &wcnss_classes[i];
+		if (list_empty(&cls->free))
 			continue;
 
-		if (wcnss_allocs[i].size >= size) {
-			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			wcnss_prealloc_save_stack_trace(&wcnss_allocs[i]);
-			return wcnss_allocs[i].ptr;
-		}
+		/* we found the slot */
+		entry = list_first_entry(&cls->free, struct wcnss_prealloc,
+					 list);
+		list_move(&entry->list, &cls->used);
+		entry->occupied = 1;
+		if (++cls->nr_used > cls->high_water)
+			cls->high_water = cls->nr_used;
+		if (i != want)
+			wcnss_classes[want].spill++;
+		if (list_empty(&cls->free) || i != want)
+			schedule_work(&grow_work);
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		wcnss_prealloc_save_stack_trace(entry);
+		return entry->ptr;
+	}
+	if (want < ARRAY_SIZE(wcnss_classes)) {
+		wcnss_classes[want].fail++;
+		schedule_work(&grow_work);
 	}
 	spin_unlock_irqrestore(&alloc_lock, flags);
 
@@ -187,15 +273,23 @@ void *wcnss_prealloc_get(size_t size)
 }
 EXPORT_SYMBOL(wcnss_prealloc_get);
 
+static void wcnss_prealloc_release(struct wcnss_prealloc *entry)
+{
+	entry->occupied = 0;
+	entry->cls->nr_used--;
+	list_move(&entry->list, &entry->cls->free);
+}
+
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
+	struct wcnss_prealloc *entry;
 	unsigned long flags;
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
+	hash_for_each_possible(wcnss_prealloc_hash, entry, node,
+			       (unsigned long)ptr) {
+		if (entry->ptr == ptr && entry->occupied) {
+			wcnss_prealloc_release(entry);
 			spin_unlock_irqrestore(&alloc_lock, flags);
 			return 1;
 		}
@@ -209,20 +303,20 @@ EXPORT_SYMBOL(wcnss_prealloc_put);
 #ifdef CONFIG_SLUB_DEBUG
 void wcnss_prealloc_check_memory_leak(void)
 {
+	struct wcnss_prealloc *entry;
 	int i, j = 0;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (!wcnss_allocs[i].occupied)
-			continue;
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		list_for_each_entry(entry, &wcnss_classes[i].used, list) {
+			if (j == 0) {
+				pr_err("wcnss_prealloc: Memory leak detected\n");
+				j++;
+			}
 
-		if (j == 0) {
-			pr_err("wcnss_prealloc: Memory leak detected\n");
-			j++;
+			pr_err("Size: %zu, addr: %pK, backtrace:\n",
+			       entry->cls->size, entry->ptr);
+			print_stack_trace(&entry->trace, 1);
 		}
-
-		pr_err("Size: %zu, addr: %pK, backtrace:\n",
-		       wcnss_allocs[i].size, wcnss_allocs[i].ptr);
-		print_stack_trace(&wcnss_allocs[i].trace, 1);
 	}
 
 }
@@ -233,50 +327,97 @@ EXPORT_SYMBOL(wcnss_prealloc_check_memory_leak);
 
 int wcnss_pre_alloc_reset(void)
 {
+	struct wcnss_prealloc *entry, *tmp;
+	unsigned long flags;
 	int i, n = 0;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (!wcnss_allocs[i].occupied)
-			continue;
-
-		wcnss_allocs[i].occupied = 0;
-		n++;
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		list_for_each_entry_safe(entry, tmp, &wcnss_classes[i].used,
+					 list) {
+			wcnss_prealloc_release(entry);
+			n++;
+		}
 	}
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return n;
 }
 EXPORT_SYMBOL(wcnss_pre_alloc_reset);
 
-int prealloc_memory_stats_show(struct seq_file *fp, void *data)
+static unsigned long wcnss_prealloc_shrink_count(struct shrinker *shrink,
+						 struct shrink_control *sc)
 {
-	int i = 0;
-	int used_slots = 0, free_slots = 0;
-	unsigned int tsize = 0, tused = 0, size = 0;
-
-	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\n");
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		tsize += wcnss_allocs[i].size;
-		if (size != wcnss_allocs[i].size) {
-			if (size) {
-				seq_printf(
-					fp, "[%d : %d]\n",
-					used_slots, free_slots);
-			}
+	struct wcnss_prealloc *entry;
+	unsigned long flags, count = 0;
+	int i;
 
-			size = wcnss_allocs[i].size;
-			used_slots = 0;
-			free_slots = 0;
-			seq_printf(fp, "%d Kb\t\t\t", size / 1024);
-		}
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++)
+		list_for_each_entry(entry, &wcnss_classes[i].free, list)
+			if (entry->grown)
+				count++;
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
-		if (wcnss_allocs[i].occupied) {
-			tused += wcnss_allocs[i].size;
-			++used_slots;
-		} else {
-			++free_slots;
+	return count;
+}
+
+/* Give the free grown slots back, the boot time reserve stays */
+static unsigned long wcnss_prealloc_shrink_scan(struct shrinker *shrink,
+						struct shrink_control *sc)
+{
+	struct wcnss_prealloc *entry, *tmp;
+	unsigned long flags, freed = 0;
+	LIST_HEAD(victims);
+	int i;
+
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		list_for_each_entry_safe(entry, tmp, &wcnss_classes[i].free,
+					 list) {
+			if (freed >= sc->nr_to_scan)
+				break;
+			if (!entry->grown)
+				continue;
+			hash_del(&entry->node);
+			list_move(&entry->list, &victims);
+			entry->cls->total--;
+			freed++;
 		}
 	}
-	seq_printf(fp, "[%d : %d]\n", used_slots, free_slots);
+	spin_unlock_irqrestore(&alloc_lock, flags);
+
+	list_for_each_entry_safe(entry, tmp, &victims, list)
+		wcnss_prealloc_free(entry);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker wcnss_prealloc_shrinker = {
+	.count_objects = wcnss_prealloc_shrink_count,
+	.scan_objects = wcnss_prealloc_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+int prealloc_memory_stats_show(struct seq_file *fp, void *data)
+{
+	struct wcnss_prealloc_class *cls;
+	unsigned int tsize = 0, tused = 0;
+	unsigned long flags;
+	int i;
+
+	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\tHigh\tGrown\tSpill\tFail\n");
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		cls = &wcnss_classes[i];
+		tsize += cls->total * cls->size;
+		tused += cls->nr_used * cls->size;
+		seq_printf(fp, "%zu Kb\t\t\t[%u : %u]\t%u\t%u\t%u\t%u\n",
+			   cls->size / 1024, cls->nr_used,
+			   cls->total - cls->nr_used, cls->high_water,
+			   cls->grown, cls->spill, cls->fail);
+	}
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	/* Convert byte to Kb */
 	if (tsize)
@@ -309,9 +450,12 @@ static int __init wcnss_pre_alloc_init(void)
 	ret = wcnss_prealloc_init();
 	if (ret) {
 		pr_err("%s: Failed to init the prealloc pool\n", __func__);
+		wcnss_prealloc_deinit();
 		return ret;
 	}
 
+	register_shrinker(&wcnss_prealloc_shrinker);
+
 	debug_base = debugfs_create_dir(PRE_ALLOC_DEBUGFS_DIR, NULL);
 	if (IS_ERR_OR_NULL(debug_base)) {
 		pr_err("%s: Failed to create debugfs dir\n", __func__);
@@ -328,6 +472,7 @@ static int __init wcnss_pre_alloc_init(void)
 
 static void __exit wcnss_pre_alloc_exit(void)
 {
+	unregister_shrinker(&wcnss_prealloc_shrinker);
 	wcnss_prealloc_deinit();
 	debugfs_remove_recursive(debug_base);
 }
@@ -22,6 +22,15 @@
 #include "gsi.h"
 #include "gsi_reg.h"
 
+/*
+ * Events per IEOB poll. When non zero the IEOB interrupt of an event ring
+ * masks itself and the ring is drained from a tasklet, up to this many
+ * events per run with a single doorbell, until it is found empty.
+ */
+static unsigned int ieob_poll_budget;
+module_param(ieob_poll_budget, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ieob_poll_budget, "Events per IEOB poll, 0 to process them in the IRQ");
+
 #define GSI_CMD_TIMEOUT (5*HZ)
 #define GSI_STOP_CMD_TIMEOUT_MS 20
 #define GSI_MAX_CH_LOW_WEIGHT 15
@@ -459,6 +468,14 @@ static void gsi_handle_ieob(int ee)
 
 			ctx = &gsi_ctx->evtr[i];
 			BUG_ON(ctx->props.intf != GSI_EVT_CHTYPE_GPI_EV);
+			if (ieob_poll_budget) {
+				spin_lock_irqsave(&gsi_ctx->slock, flags);
+				__gsi_config_ieob_irq(ee, 1 << i, 0);
+				spin_unlock_irqrestore(&gsi_ctx->slock, flags);
+				tasklet_schedule(&ctx->poll_tasklet);
+				continue;
+			}
+
 			spin_lock_irqsave(&ctx->ring.slock, flags);
 check_again:
 			cntr = 0;
@@ -484,6 +501,83 @@ check_again:
 	}
 }
 
+static uint64_t gsi_read_evt_ring_rp(struct gsi_evt_ctx *ctx, int ee)
+{
+	uint64_t rp;
+
+	rp = gsi_readl(gsi_ctx->base +
+		GSI_EE_n_EV_CH_k_CNTXT_4_OFFS(ctx->id, ee));
+	rp |= ((uint64_t)gsi_readl(gsi_ctx->base +
+		GSI_EE_n_EV_CH_k_CNTXT_5_OFFS(ctx->id, ee))) << 32;
+
+	return rp;
+}
+
+static bool gsi_evt_ring_client_poll(struct gsi_evt_ctx *ctx)
+{
+	return ctx->props.exclusive && ctx->chan &&
+		atomic_read(&ctx->chan->poll_mode);
+}
+
+/*
+ * IEOB poller, runs with the IEOB interrupt of the event ring masked. The
+ * interrupt is only unmasked once the ring is seen empty after its status
+ * was cleared, so events arriving meanwhile either get polled here or
+ * raise a new interrupt. A client that switched its channel to poll mode
+ * owns the mask and is left alone.
+ */
+static void gsi_ieob_poll(unsigned long data)
+{
+	struct gsi_evt_ctx *ctx = (struct gsi_evt_ctx *)data;
+	struct gsi_chan_xfer_notify notify;
+	unsigned int budget = ieob_poll_budget ?: UINT_MAX;
+	int ee = gsi_ctx->per.ee;
+	unsigned long flags;
+	unsigned long cntr = 0;
+	uint64_t rp;
+
+	spin_lock_irqsave(&ctx->ring.slock, flags);
+	rp = gsi_read_evt_ring_rp(ctx, ee);
+	while (cntr < budget) {
+		if (ctx->ring.rp_local == rp) {
+			rp = gsi_read_evt_ring_rp(ctx, ee);
+			if (ctx->ring.rp_local == rp)
+				break;
+		}
+		if (gsi_evt_ring_client_poll(ctx))
+			break;
+		ctx->ring.rp = rp;
+		gsi_process_evt_re(ctx, &notify, true);
+		++cntr;
+	}
+	if (cntr)
+		gsi_ring_evt_doorbell(ctx);
+
+	ctx->stats.poll++;
+	ctx->stats.poll_evts += cntr;
+	if (cntr > ctx->stats.poll_max)
+		ctx->stats.poll_max = cntr;
+	if (cntr == budget)
+		ctx->stats.poll_full++;
+	spin_unlock_irqrestore(&ctx->ring.slock, flags);
+
+	if (cntr == budget) {
+		tasklet_schedule(&ctx->poll_tasklet);
+		return;
+	}
+
+	spin_lock_irqsave(&gsi_ctx->slock, flags);
+	if (!gsi_evt_ring_client_poll(ctx)) {
+		gsi_writel(1 << ctx->id, gsi_ctx->base +
+			GSI_EE_n_CNTXT_SRC_IEOB_IRQ_CLR_OFFS(ee));
+		if (gsi_read_evt_ring_rp(ctx, ee) != ctx->ring.rp_local)
+			tasklet_schedule(&ctx->poll_tasklet);
+		else
+			__gsi_config_ieob_irq(ee, 1 << ctx->id, ~0);
+	}
+	spin_unlock_irqrestore(&gsi_ctx->slock, flags);
+}
+
 static void gsi_handle_inter_ee_ch_ctrl(int ee)
 {
 	uint32_t ch;
@@ -1155,6 +1249,7 @@ int gsi_alloc_evt_ring(struct gsi_evt_ring_props *props, unsigned long dev_hdl,
 
 	spin_lock_init(&ctx->ring.slock);
 	gsi_init_evt_ring(props, &ctx->ring);
+	tasklet_init(&ctx->poll_tasklet, gsi_ieob_poll, (unsigned long)ctx);
 
 	ctx->id = evt_id;
 	*evt_ring_hdl = evt_id;
@@ -1250,6 +1345,8 @@ int gsi_dealloc_evt_ring(unsigned long evt_ring_hdl)
 		return -GSI_STATUS_UNSUPPORTED_OP;
 	}
 
+	tasklet_kill(&ctx->poll_tasklet);
+
 	mutex_lock(&gsi_ctx->mlock);
 	reinit_completion(&ctx->compl);
 	val = (((evt_ring_hdl << GSI_EE_n_EV_CH_CMD_CHID_SHFT) &
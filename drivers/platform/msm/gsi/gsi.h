@@ -15,6 +15,7 @@
 #include <linux/device.h>
 #include <linux/types.h>
 #include <linux/completion.h>
+#include <linux/interrupt.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/msm_gsi.h>
@@ -136,6 +137,10 @@ struct gsi_chan_ctx {
 
 struct gsi_evt_stats {
 	unsigned long completed;
+	unsigned long poll;
+	unsigned long poll_evts;
+	unsigned long poll_max;
+	unsigned long poll_full;
 };
 
 struct gsi_evt_ctx {
@@ -149,6 +154,7 @@ struct gsi_evt_ctx {
 	atomic_t chan_ref_cnt;
 	union __packed gsi_evt_scratch scratch;
 	struct gsi_evt_stats stats;
+	struct tasklet_struct poll_tasklet;
 };
 
 struct gsi_ee_scratch {
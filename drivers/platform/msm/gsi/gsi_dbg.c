@@ -277,9 +277,16 @@ static void gsi_dump_ch_stats(struct gsi_chan_ctx *ctx)
 		ctx->stats.invalid_tre_error);
 	PRT_STAT("poll_ok=%lu poll_empty=%lu\n",
 		ctx->stats.poll_ok, ctx->stats.poll_empty);
-	if (ctx->evtr)
+	if (ctx->evtr) {
 		PRT_STAT("compl_evt=%lu\n",
 			ctx->evtr->stats.completed);
+		PRT_STAT("ieob_poll=%lu evts/poll=%lu max=%lu full=%lu\n",
+			ctx->evtr->stats.poll,
+			ctx->evtr->stats.poll ? ctx->evtr->stats.poll_evts /
+				ctx->evtr->stats.poll : 0,
+			ctx->evtr->stats.poll_max,
+			ctx->evtr->stats.poll_full);
+	}
 
 	PRT_STAT("ch_below_lo=%lu\n", ctx->stats.dp.ch_below_lo);
 	PRT_STAT("ch_below_hi=%lu\n", ctx->stats.dp.ch_below_hi);
@@ -563,9 +570,13 @@ static ssize_t gsi_rst_stats(struct file *file,
 		max = ch_id + 1;
 	}
 
-	for (ch_id = min; ch_id < max; ch_id++)
+	for (ch_id = min; ch_id < max; ch_id++) {
 		memset(&gsi_ctx->chan[ch_id].stats, 0,
 			sizeof(gsi_ctx->chan[ch_id].stats));
+		if (gsi_ctx->chan[ch_id].evtr)
+			memset(&gsi_ctx->chan[ch_id].evtr->stats, 0,
+				sizeof(gsi_ctx->chan[ch_id].evtr->stats));
+	}
 
 	return count;
 error:
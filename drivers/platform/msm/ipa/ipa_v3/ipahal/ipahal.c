@@ -1006,6 +1006,8 @@ static void ipahal_debugfs_init(void)
 		goto fail;
 	}
 
+	ipahal_fltrt_debugfs_init(ipahal_ctx->dent);
+
 	return;
 fail:
 	debugfs_remove_recursive(ipahal_ctx->dent);
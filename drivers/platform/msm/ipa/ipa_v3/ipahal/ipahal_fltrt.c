@@ -2530,6 +2530,75 @@ static int ipa_flt_parse_hw_rule(u8 *addr, struct ipahal_flt_rule_entry *rule)
 		atrb, &rule->rule_size);
 }
 
+/*
+ * Commit images cache. Every commit allocates the table images anew from
+ *  coherent memory although their sizes rarely change between commits.
+ *  The cache keeps two slots per image so a commit can build its images
+ *  while the images of the previous one are still being DMA'ed.
+ */
+enum ipa_fltrt_img_type {
+	IPA_FLTRT_IMG_NHASH_HDR,
+	IPA_FLTRT_IMG_HASH_HDR,
+	IPA_FLTRT_IMG_NHASH_BDY,
+	IPA_FLTRT_IMG_HASH_BDY,
+	IPA_FLTRT_IMG_MAX
+};
+
+#define IPA_FLTRT_IMG_SLOTS 2
+
+/*
+ * struct ipa_fltrt_img_slot - Cached image buffer
+ * @mem: The allocation. Its size is the allocated size
+ * @busy: Handed out to a commit and not released yet
+ */
+struct ipa_fltrt_img_slot {
+	struct ipa_mem_buffer mem;
+	bool busy;
+};
+
+/*
+ * struct ipa_fltrt_img_cache - Cached table images and commit stats
+ * @lock: Protects the slots and the stats
+ * @slot: Slots per flt/rt, IP family and image type
+ * @start: Time the images of the pending commit were handed out
+ * @hits: Images handed out from a cached slot
+ * @allocs: Images that needed a new (larger) slot allocation
+ * @overflow: Images allocated outside the cache as all slots were busy
+ * @commits: Commits completed and released
+ * @last_ns/max_ns/total_ns: Time from images get to release
+ */
+struct ipa_fltrt_img_cache {
+	struct mutex lock;
+	struct ipa_fltrt_img_slot slot[2][IPA_IP_MAX][IPA_FLTRT_IMG_MAX]
+		[IPA_FLTRT_IMG_SLOTS];
+	ktime_t start[2][IPA_IP_MAX];
+	u64 hits;
+	u64 allocs;
+	u64 overflow;
+	u64 commits;
+	u64 last_ns;
+	u64 max_ns;
+	u64 total_ns;
+};
+
+static struct ipa_fltrt_img_cache ipa_fltrt_img_cache;
+
+static void ipa_fltrt_img_cache_destroy(void)
+{
+	struct ipa_fltrt_img_cache *cache = &ipa_fltrt_img_cache;
+	struct ipa_fltrt_img_slot *slot;
+	int i;
+
+	mutex_lock(&cache->lock);
+	slot = &cache->slot[0][0][0][0];
+	for (i = 0; i < sizeof(cache->slot) / sizeof(*slot); i++, slot++) {
+		WARN_ON(slot->busy);
+		if (slot->mem.base)
+			ipahal_free_dma_mem(&slot->mem);
+	}
+	mutex_unlock(&cache->lock);
+}
+
 /*
  * ipahal_fltrt_init() - Build the FLT/RT information table
  *  See ipahal_fltrt_objs[] comments
@@ -2551,6 +2620,8 @@ int ipahal_fltrt_init(enum ipa_hw_type ipa_hw_type)
 		return -EFAULT;
 	}
 
+	mutex_init(&ipa_fltrt_img_cache.lock);
+
 	memset(&zero_obj, 0, sizeof(zero_obj));
 	for (i = IPA_HW_v3_0 ; i < ipa_hw_type ; i++) {
 		if (!memcmp(&ipahal_fltrt_objs[i+1], &zero_obj,
@@ -2711,6 +2782,8 @@ void ipahal_fltrt_destroy(void)
 {
 	IPAHAL_DBG("Entry\n");
 
+	ipa_fltrt_img_cache_destroy();
+
 	if (ipahal_ctx && ipahal_ctx->empty_fltrt_tbl.base)
 		dma_free_coherent(ipahal_ctx->ipa_pdev,
 			ipahal_ctx->empty_fltrt_tbl.size,
@@ -2956,6 +3029,32 @@ int ipahal_flt_generate_empty_img(u32 tbls_num, u32 hash_hdr_size,
 	return 0;
 }
 
+/*
+ * ipa_fltrt_init_tbl_hdr() - Init each table of the headers to point to
+ *  the empty system table
+ * @params: headers to init
+ */
+static void ipa_fltrt_init_tbl_hdr(
+	struct ipahal_fltrt_alloc_imgs_params *params)
+{
+	u64 addr;
+	int i;
+	struct ipahal_fltrt_obj *obj;
+
+	obj = &ipahal_fltrt_objs[ipahal_ctx->hw_type];
+
+	addr = obj->create_tbl_addr(true,
+		ipahal_ctx->empty_fltrt_tbl.phys_base);
+	for (i = 0; i < params->tbls_num; i++) {
+		obj->write_val_to_hdr(addr,
+			params->nhash_hdr.base + i * obj->tbl_hdr_width);
+		if (obj->support_hash)
+			obj->write_val_to_hdr(addr,
+				params->hash_hdr.base +
+				i * obj->tbl_hdr_width);
+	}
+}
+
 /*
  * ipa_fltrt_alloc_init_tbl_hdr() - allocate and initialize buffers for
  *  flt/rt tables headers to be filled into sram. Init each table to point
@@ -2967,8 +3066,6 @@ int ipahal_flt_generate_empty_img(u32 tbls_num, u32 hash_hdr_size,
 static int ipa_fltrt_alloc_init_tbl_hdr(
 	struct ipahal_fltrt_alloc_imgs_params *params)
 {
-	u64 addr;
-	int i;
 	struct ipahal_fltrt_obj *obj;
 
 	obj = &ipahal_fltrt_objs[ipahal_ctx->hw_type];
@@ -3000,16 +3097,7 @@ static int ipa_fltrt_alloc_init_tbl_hdr(
 		}
 	}
 
-	addr = obj->create_tbl_addr(true,
-		ipahal_ctx->empty_fltrt_tbl.phys_base);
-	for (i = 0; i < params->tbls_num; i++) {
-		obj->write_val_to_hdr(addr,
-			params->nhash_hdr.base + i * obj->tbl_hdr_width);
-		if (obj->support_hash)
-			obj->write_val_to_hdr(addr,
-				params->hash_hdr.base +
-				i * obj->tbl_hdr_width);
-	}
+	ipa_fltrt_init_tbl_hdr(params);
 
 	return 0;
 
@@ -3019,6 +3107,32 @@ nhash_alloc_fail:
 	return -ENOMEM;
 }
 
+/*
+ * ipa_fltrt_calc_lcl_bdy_size() - H/W size of a local tables body
+ *  Align the size to coop with termination word and H/W local table
+ *  start offset alignment
+ * @total_sz: Total effective size of the local tables
+ * @tbls_num: Number of local tables
+ */
+static u32 ipa_fltrt_calc_lcl_bdy_size(u32 total_sz, u32 tbls_num)
+{
+	struct ipahal_fltrt_obj *obj;
+	u32 size;
+
+	obj = &ipahal_fltrt_objs[ipahal_ctx->hw_type];
+
+	size = total_sz;
+	/* for table terminator */
+	size += obj->tbl_width * tbls_num;
+	/* align the start of local rule-set */
+	size += obj->lcladdr_alignment * tbls_num;
+	/* SRAM block size alignment */
+	size += obj->blk_sz_alignment;
+	size &= ~(obj->blk_sz_alignment);
+
+	return size;
+}
+
 /*
  * ipa_fltrt_alloc_lcl_bdy() - allocate and initialize buffers for
  *  local flt/rt tables bodies to be filled into sram
@@ -3044,20 +3158,10 @@ static int ipa_fltrt_alloc_lcl_bdy(
 		params->num_lcl_hash_tbls,
 		params->num_lcl_nhash_tbls);
 
-	/* Align the sizes to coop with termination word
-	 *  and H/W local table start offset alignment
-	 */
 	if (params->nhash_bdy.size) {
-		params->nhash_bdy.size = params->total_sz_lcl_nhash_tbls;
-		/* for table terminator */
-		params->nhash_bdy.size += obj->tbl_width *
-			params->num_lcl_nhash_tbls;
-		/* align the start of local rule-set */
-		params->nhash_bdy.size += obj->lcladdr_alignment *
-			params->num_lcl_nhash_tbls;
-		/* SRAM block size alignment */
-		params->nhash_bdy.size += obj->blk_sz_alignment;
-		params->nhash_bdy.size &= ~(obj->blk_sz_alignment);
+		params->nhash_bdy.size = ipa_fltrt_calc_lcl_bdy_size(
+			params->total_sz_lcl_nhash_tbls,
+			params->num_lcl_nhash_tbls);
 
 		IPAHAL_DBG_LOW("nhash lcl tbl bdy total h/w size = %u\n",
 			params->nhash_bdy.size);
@@ -3079,16 +3183,9 @@ static int ipa_fltrt_alloc_lcl_bdy(
 	}
 
 	if (obj->support_hash && params->hash_bdy.size) {
-		params->hash_bdy.size = params->total_sz_lcl_hash_tbls;
-		/* for table terminator */
-		params->hash_bdy.size += obj->tbl_width *
-			params->num_lcl_hash_tbls;
-		/* align the start of local rule-set */
-		params->hash_bdy.size += obj->lcladdr_alignment *
-			params->num_lcl_hash_tbls;
-		/* SRAM block size alignment */
-		params->hash_bdy.size += obj->blk_sz_alignment;
-		params->hash_bdy.size &= ~(obj->blk_sz_alignment);
+		params->hash_bdy.size = ipa_fltrt_calc_lcl_bdy_size(
+			params->total_sz_lcl_hash_tbls,
+			params->num_lcl_hash_tbls);
 
 		IPAHAL_DBG_LOW("hash lcl tbl bdy total h/w size = %u\n",
 			params->hash_bdy.size);
@@ -3154,6 +3251,246 @@ bdy_alloc_fail:
 	return -ENOMEM;
 }
 
+static int ipa_fltrt_img_get(bool flt, enum ipa_ip_type ipt,
+	enum ipa_fltrt_img_type type, struct ipa_mem_buffer *mem)
+{
+	struct ipa_fltrt_img_cache *cache = &ipa_fltrt_img_cache;
+	struct ipa_fltrt_img_slot *slots = cache->slot[flt][ipt][type];
+	struct ipa_fltrt_img_slot *slot = NULL;
+	u32 size = mem->size;
+	int i;
+
+	for (i = 0; i < IPA_FLTRT_IMG_SLOTS; i++) {
+		if (!slots[i].busy && slots[i].mem.base &&
+			slots[i].mem.size >= size) {
+			slot = &slots[i];
+			cache->hits++;
+			goto found;
+		}
+	}
+
+	for (i = 0; i < IPA_FLTRT_IMG_SLOTS; i++) {
+		if (!slots[i].busy) {
+			slot = &slots[i];
+			break;
+		}
+	}
+
+	if (!slot) {
+		cache->overflow++;
+		mem->base = dma_alloc_coherent(ipahal_ctx->ipa_pdev, size,
+			&mem->phys_base, GFP_KERNEL);
+		goto out;
+	}
+
+	if (slot->mem.base)
+		ipahal_free_dma_mem(&slot->mem);
+	slot->mem.size = roundup_pow_of_two(size);
+	slot->mem.base = dma_alloc_coherent(ipahal_ctx->ipa_pdev,
+		slot->mem.size, &slot->mem.phys_base, GFP_KERNEL);
+	if (!slot->mem.base) {
+		slot->mem.size = 0;
+		mem->base = NULL;
+		goto out;
+	}
+	cache->allocs++;
+
+found:
+	slot->busy = true;
+	mem->base = slot->mem.base;
+	mem->phys_base = slot->mem.phys_base;
+out:
+	if (!mem->base) {
+		IPAHAL_ERR_RL("fail to alloc DMA buff of size %d\n", size);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void ipa_fltrt_img_put(bool flt, enum ipa_ip_type ipt,
+	enum ipa_fltrt_img_type type, struct ipa_mem_buffer *mem)
+{
+	struct ipa_fltrt_img_slot *slots =
+		ipa_fltrt_img_cache.slot[flt][ipt][type];
+	int i;
+
+	if (!mem->base)
+		return;
+
+	for (i = 0; i < IPA_FLTRT_IMG_SLOTS; i++) {
+		if (slots[i].busy && slots[i].mem.base == mem->base) {
+			slots[i].busy = false;
+			memset(mem, 0, sizeof(*mem));
+			return;
+		}
+	}
+
+	ipahal_free_dma_mem(mem);
+}
+
+static void ipa_fltrt_put_imgs_locked(
+	struct ipahal_fltrt_alloc_imgs_params *params, bool flt)
+{
+	ipa_fltrt_img_put(flt, params->ipt, IPA_FLTRT_IMG_NHASH_HDR,
+		&params->nhash_hdr);
+	ipa_fltrt_img_put(flt, params->ipt, IPA_FLTRT_IMG_HASH_HDR,
+		&params->hash_hdr);
+	ipa_fltrt_img_put(flt, params->ipt, IPA_FLTRT_IMG_NHASH_BDY,
+		&params->nhash_bdy);
+	ipa_fltrt_img_put(flt, params->ipt, IPA_FLTRT_IMG_HASH_BDY,
+		&params->hash_bdy);
+}
+
+/*
+ * ipahal_fltrt_get_hw_tbl_imgs() - Get tbl images DMA structures for commit
+ *  Same as ipahal_fltrt_allocate_hw_tbl_imgs() but the images come from a
+ *  cache of pre-sized buffers. Must be released by
+ *  ipahal_fltrt_put_hw_tbl_imgs() once the commit completed, and not
+ *  by ipahal_free_dma_mem().
+ * @params: Parameters for IN and OUT regard the allocation.
+ * @flt: Images of filtering (true) or routing (false) tables
+ */
+int ipahal_fltrt_get_hw_tbl_imgs(
+	struct ipahal_fltrt_alloc_imgs_params *params, bool flt)
+{
+	struct ipa_fltrt_img_cache *cache = &ipa_fltrt_img_cache;
+	struct ipahal_fltrt_obj *obj;
+	bool nhash_bdy, hash_bdy;
+
+	IPAHAL_DBG_LOW("Entry\n");
+
+	if (!params) {
+		IPAHAL_ERR_RL("Input err: no params\n");
+		return -EINVAL;
+	}
+	if (params->ipt >= IPA_IP_MAX) {
+		IPAHAL_ERR_RL("Input err: Invalid ip type %d\n", params->ipt);
+		return -EINVAL;
+	}
+
+	obj = &ipahal_fltrt_objs[ipahal_ctx->hw_type];
+
+	if (!obj->support_hash && params->hash_bdy.size) {
+		IPAHAL_ERR("No HAL Hash tbls support - Will be ignored\n");
+		WARN_ON(1);
+	}
+	nhash_bdy = params->nhash_bdy.size;
+	hash_bdy = obj->support_hash && params->hash_bdy.size;
+	memset(&params->nhash_hdr, 0, sizeof(params->nhash_hdr));
+	memset(&params->hash_hdr, 0, sizeof(params->hash_hdr));
+	memset(&params->nhash_bdy, 0, sizeof(params->nhash_bdy));
+	memset(&params->hash_bdy, 0, sizeof(params->hash_bdy));
+
+	mutex_lock(&cache->lock);
+
+	params->nhash_hdr.size = params->tbls_num * obj->tbl_hdr_width;
+	if (ipa_fltrt_img_get(flt, params->ipt, IPA_FLTRT_IMG_NHASH_HDR,
+		&params->nhash_hdr))
+		goto fail;
+
+	if (obj->support_hash) {
+		params->hash_hdr.size = params->tbls_num * obj->tbl_hdr_width;
+		if (ipa_fltrt_img_get(flt, params->ipt,
+			IPA_FLTRT_IMG_HASH_HDR, &params->hash_hdr))
+			goto fail;
+	}
+
+	ipa_fltrt_init_tbl_hdr(params);
+
+	if (nhash_bdy) {
+		params->nhash_bdy.size = ipa_fltrt_calc_lcl_bdy_size(
+			params->total_sz_lcl_nhash_tbls,
+			params->num_lcl_nhash_tbls);
+		if (ipa_fltrt_img_get(flt, params->ipt,
+			IPA_FLTRT_IMG_NHASH_BDY, &params->nhash_bdy))
+			goto fail;
+		memset(params->nhash_bdy.base, 0, params->nhash_bdy.size);
+	}
+
+	if (hash_bdy) {
+		params->hash_bdy.size = ipa_fltrt_calc_lcl_bdy_size(
+			params->total_sz_lcl_hash_tbls,
+			params->num_lcl_hash_tbls);
+		if (ipa_fltrt_img_get(flt, params->ipt,
+			IPA_FLTRT_IMG_HASH_BDY, &params->hash_bdy))
+			goto fail;
+		memset(params->hash_bdy.base, 0, params->hash_bdy.size);
+	}
+
+	cache->start[flt][params->ipt] = ktime_get();
+	mutex_unlock(&cache->lock);
+
+	return 0;
+
+fail:
+	ipa_fltrt_put_imgs_locked(params, flt);
+	mutex_unlock(&cache->lock);
+	return -ENOMEM;
+}
+
+/*
+ * ipahal_fltrt_put_hw_tbl_imgs() - Release tbl images of a completed commit
+ * @params: The images as returned by ipahal_fltrt_get_hw_tbl_imgs()
+ * @flt: Images of filtering (true) or routing (false) tables
+ */
+void ipahal_fltrt_put_hw_tbl_imgs(
+	struct ipahal_fltrt_alloc_imgs_params *params, bool flt)
+{
+	struct ipa_fltrt_img_cache *cache = &ipa_fltrt_img_cache;
+	u64 ns;
+
+	if (!params || params->ipt >= IPA_IP_MAX) {
+		IPAHAL_ERR_RL("Input err\n");
+		return;
+	}
+
+	mutex_lock(&cache->lock);
+	ipa_fltrt_put_imgs_locked(params, flt);
+	ns = ktime_to_ns(ktime_sub(ktime_get(),
+		cache->start[flt][params->ipt]));
+	cache->commits++;
+	cache->last_ns = ns;
+	cache->total_ns += ns;
+	if (ns > cache->max_ns)
+		cache->max_ns = ns;
+	mutex_unlock(&cache->lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static ssize_t ipa_fltrt_read_img_stats(struct file *file,
+	char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct ipa_fltrt_img_cache *cache = &ipa_fltrt_img_cache;
+	char buf[256];
+	int nbytes;
+
+	mutex_lock(&cache->lock);
+	nbytes = scnprintf(buf, sizeof(buf),
+		"hits=%llu allocs=%llu overflow=%llu\n"
+		"commits=%llu last_us=%llu max_us=%llu avg_us=%llu\n",
+		cache->hits, cache->allocs, cache->overflow,
+		cache->commits, div_u64(cache->last_ns, NSEC_PER_USEC),
+		div_u64(cache->max_ns, NSEC_PER_USEC),
+		cache->commits ? div64_u64(cache->total_ns,
+			cache->commits * NSEC_PER_USEC) : 0);
+	mutex_unlock(&cache->lock);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, nbytes);
+}
+
+static const struct file_operations ipa_fltrt_img_stats_ops = {
+	.read = ipa_fltrt_read_img_stats,
+};
+
+void ipahal_fltrt_debugfs_init(struct dentry *dent)
+{
+	if (!debugfs_create_file("fltrt_img_stats", S_IRUSR, dent, NULL,
+		&ipa_fltrt_img_stats_ops))
+		IPAHAL_ERR("fail to create fltrt_img_stats\n");
+}
+#endif /* CONFIG_DEBUG_FS */
+
 /*
  * ipahal_fltrt_allocate_hw_sys_tbl() - Allocate DMA mem for H/W flt/rt sys tbl
  * @tbl_mem: IN/OUT param. size for effective table size. Pointer, for the
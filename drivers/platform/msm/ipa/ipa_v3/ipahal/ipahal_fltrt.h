@@ -202,6 +202,26 @@ int ipahal_flt_generate_empty_img(u32 tbls_num, u32 hash_hdr_size,
 int ipahal_fltrt_allocate_hw_tbl_imgs(
 	struct ipahal_fltrt_alloc_imgs_params *params);
 
+/*
+ * ipahal_fltrt_get_hw_tbl_imgs() - Get tbl images DMA structures for commit
+ *  Same as ipahal_fltrt_allocate_hw_tbl_imgs() but the images are taken
+ *  from a cache of pre-sized buffers, double buffered per flt/rt and IP
+ *  family, instead of being allocated for every commit.
+ * @params: Parameters for IN and OUT regard the allocation.
+ * @flt: Images of filtering (true) or routing (false) tables
+ */
+int ipahal_fltrt_get_hw_tbl_imgs(
+	struct ipahal_fltrt_alloc_imgs_params *params, bool flt);
+
+/*
+ * ipahal_fltrt_put_hw_tbl_imgs() - Release the images of a completed commit
+ *  back to the cache. Accounts the commit time since the images were got.
+ * @params: The images as returned by ipahal_fltrt_get_hw_tbl_imgs()
+ * @flt: Images of filtering (true) or routing (false) tables
+ */
+void ipahal_fltrt_put_hw_tbl_imgs(
+	struct ipahal_fltrt_alloc_imgs_params *params, bool flt);
+
 /*
  * ipahal_fltrt_allocate_hw_sys_tbl() - Allocate DMA mem for H/W flt/rt sys tbl
  * @tbl_mem: IN/OUT param. size for effective table size. Pointer, for the
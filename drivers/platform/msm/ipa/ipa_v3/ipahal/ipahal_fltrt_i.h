@@ -140,4 +140,10 @@ struct ipa3_0_flt_rule_hw_hdr {
 int ipahal_fltrt_init(enum ipa_hw_type ipa_hw_type);
 void ipahal_fltrt_destroy(void);
 
+#ifdef CONFIG_DEBUG_FS
+void ipahal_fltrt_debugfs_init(struct dentry *dent);
+#else
+static inline void ipahal_fltrt_debugfs_init(struct dentry *dent) {}
+#endif
+
 #endif /* _IPAHAL_FLTRT_I_H_ */
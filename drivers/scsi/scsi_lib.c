@@ -1967,6 +1967,16 @@ static void scsi_mq_done(struct scsi_cmnd *cmd)
 	blk_mq_complete_request(cmd->request, cmd->request->errors);
 }
 
+static void scsi_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct scsi_device *sdev = q->queuedata;
+	struct Scsi_Host *shost = sdev->host;
+
+	if (shost->hostt->commit_rqs)
+		shost->hostt->commit_rqs(shost, hctx->queue_num);
+}
+
 static int scsi_queue_rq(struct blk_mq_hw_ctx *hctx,
 			 const struct blk_mq_queue_data *bd)
 {
@@ -2008,6 +2018,11 @@ static int scsi_queue_rq(struct blk_mq_hw_ctx *hctx,
 	else
 		cmd->flags &= ~SCMD_TAGGED;
 
+	if (bd->last)
+		cmd->flags |= SCMD_LAST;
+	else
+		cmd->flags &= ~SCMD_LAST;
+
 	scsi_init_cmd_errh(cmd);
 	cmd->scsi_done = scsi_mq_done;
 
@@ -2170,6 +2185,7 @@ struct request_queue *scsi_alloc_queue(struct scsi_device *sdev)
 static struct blk_mq_ops scsi_mq_ops = {
 	.map_queue	= blk_mq_map_queue,
 	.queue_rq	= scsi_queue_rq,
+	.commit_rqs	= scsi_commit_rqs,
 	.complete	= scsi_softirq_done,
 	.timeout	= scsi_timeout,
 	.init_request	= scsi_init_request,
@@ -1396,6 +1396,73 @@ static const struct file_operations ufsdbg_req_stats_desc = {
 };
 
 
+static int ufsdbg_intr_aggr_show(struct seq_file *file, void *data)
+{
+	struct ufs_hba *hba = (struct ufs_hba *)file->private;
+	struct ufs_intr_aggr aggr;
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	aggr = hba->intr_aggr;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	seq_printf(file, "allowed: %d\n", ufshcd_is_intr_aggr_allowed(hba));
+	seq_printf(file, "cnt: %u\ntimeout: %u (x40us)\nqd_on: %d\n",
+		   aggr.cnt, aggr.timeout, aggr.qd_on);
+	seq_printf(file, "irqs: %llu\ncompletions: %llu\n",
+		   aggr.irqs, aggr.completions);
+	seq_printf(file, "compl_per_irq: %llu\nmax_batch: %u\n",
+		   aggr.irqs ? div64_u64(aggr.completions, aggr.irqs) : 0,
+		   aggr.max_batch);
+	seq_printf(file, "aggregated: %llu\nimmediate: %llu\n",
+		   aggr.aggregated, aggr.immediate);
+	seq_puts(file, "\nwrite '<cnt> <timeout> <qd_on>' to reconfigure\n");
+
+	return 0;
+}
+
+static int ufsdbg_intr_aggr_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_intr_aggr_show, inode->i_private);
+}
+
+static ssize_t ufsdbg_intr_aggr_write(struct file *filp,
+		const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+	char buf[BUFF_LINE_SIZE] = {0};
+	loff_t buff_pos = 0;
+	unsigned int aggr_cnt, tmout;
+	int qd_on;
+	int ret;
+
+	ret = simple_write_to_buffer(buf, BUFF_LINE_SIZE - 1, &buff_pos,
+				     ubuf, cnt);
+	if (ret < 0)
+		return ret;
+
+	if (sscanf(buf, "%u %u %d", &aggr_cnt, &tmout, &qd_on) != 3 ||
+	    !aggr_cnt || aggr_cnt > 0x1F || !tmout || tmout > 0xFF ||
+	    qd_on < 1) {
+		dev_err(hba->dev, "%s: Invalid argument\n", __func__);
+		return -EINVAL;
+	}
+
+	pm_runtime_get_sync(hba->dev);
+	ufshcd_hold(hba, false);
+	ufshcd_set_intr_aggr(hba, aggr_cnt, tmout, qd_on);
+	ufshcd_release(hba, false);
+	pm_runtime_put_sync(hba->dev);
+
+	return cnt;
+}
+
+static const struct file_operations ufsdbg_intr_aggr_fops = {
+	.open		= ufsdbg_intr_aggr_open,
+	.read		= seq_read,
+	.write		= ufsdbg_intr_aggr_write,
+};
+
 static int ufsdbg_reset_controller_show(struct seq_file *file, void *data)
 {
 	seq_puts(file, "echo 1 > /sys/kernel/debug/.../reset_controller\n");
@@ -1628,6 +1695,17 @@ void ufsdbg_add_debugfs(struct ufs_hba *hba)
 		goto err;
 	}
 
+	hba->debugfs_files.intr_aggr =
+		debugfs_create_file("intr_aggr", S_IRUSR | S_IWUSR,
+			hba->debugfs_files.stats_folder, hba,
+			&ufsdbg_intr_aggr_fops);
+	if (!hba->debugfs_files.intr_aggr) {
+		dev_err(hba->dev,
+			"%s:  failed create intr_aggr debugfs entry\n",
+			__func__);
+		goto err;
+	}
+
 	hba->debugfs_files.reset_controller =
 		debugfs_create_file("reset_controller", S_IRUSR | S_IWUSR,
 			hba->debugfs_files.debugfs_root, hba,
@@ -23,6 +23,7 @@
 
 #include <soc/qcom/scm.h>
 #include <linux/phy/phy.h>
+#include <linux/blk-mq.h>
 #include <linux/phy/phy-qcom-ufs.h>
 
 #include "ufshcd.h"
@@ -1526,6 +1527,7 @@ static void ufs_qcom_set_caps(struct ufs_hba *hba)
 	hba->caps |= UFSHCD_CAP_AUTO_BKOPS_SUSPEND;
 
 	if (host->hw_ver.major >= 0x2) {
+		hba->caps |= UFSHCD_CAP_INTR_AGGR;
 		if (!host->disable_lpm)
 			hba->caps |= UFSHCD_CAP_POWER_COLLAPSE_DURING_HIBERN8;
 		host->caps = UFS_QCOM_CAP_QUNIPRO |
@@ -1545,6 +1547,10 @@ static void ufs_qcom_set_caps(struct ufs_hba *hba)
 		 */
 		host->caps |= UFS_QCOM_CAP_SVS2;
 	}
+
+	/* contexts are provisioned per device, so leave it to the board */
+	if (of_property_read_bool(hba->dev->of_node, "qcom,write-hints"))
+		hba->caps |= UFSHCD_CAP_WRITE_HINT;
 }
 
 /**
@@ -1627,6 +1633,13 @@ static int ufs_qcom_cpu_to_group(struct ufs_qcom_host *host, int cpu)
 	return host->pm_qos.default_cpu;
 }
 
+static int ufs_qcom_req_cpu(struct request *req)
+{
+	if (req->mq_ctx)
+		return blk_mq_rq_cpu(req);
+	return req->cpu;
+}
+
 static void ufs_qcom_pm_qos_req_start(struct ufs_hba *hba, struct request *req)
 {
 	unsigned long flags;
@@ -1640,7 +1653,7 @@ static void ufs_qcom_pm_qos_req_start(struct ufs_hba *hba, struct request *req)
 	if (!host->pm_qos.groups)
 		return;
 
-	group = &host->pm_qos.groups[ufs_qcom_cpu_to_group(host, req->cpu)];
+	group = &host->pm_qos.groups[ufs_qcom_cpu_to_group(host, ufs_qcom_req_cpu(req))];
 
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	if (!host->pm_qos.is_enabled)
@@ -1682,7 +1695,8 @@ static void ufs_qcom_pm_qos_req_end(struct ufs_hba *hba, struct request *req,
 
 	if (should_lock)
 		spin_lock_irqsave(hba->host->host_lock, flags);
-	__ufs_qcom_pm_qos_req_end(ufshcd_get_variant(hba), req->cpu);
+	__ufs_qcom_pm_qos_req_end(ufshcd_get_variant(hba),
+				  ufs_qcom_req_cpu(req));
 	if (should_lock)
 		spin_unlock_irqrestore(hba->host->host_lock, flags);
 }
@@ -145,16 +145,16 @@ enum desc_header_offset {
 };
 
 enum ufs_desc_max_size {
-	QUERY_DESC_DEVICE_MAX_SIZE		= 0x40,
+	QUERY_DESC_DEVICE_MAX_SIZE		= 0x59,
 	QUERY_DESC_CONFIGURAION_MAX_SIZE	= 0x90,
-	QUERY_DESC_UNIT_MAX_SIZE		= 0x23,
+	QUERY_DESC_UNIT_MAX_SIZE		= 0x2D,
 	QUERY_DESC_INTERCONNECT_MAX_SIZE	= 0x06,
 	/*
 	 * Max. 126 UNICODE characters (2 bytes per character) plus 2 bytes
 	 * of descriptor header.
 	 */
 	QUERY_DESC_STRING_MAX_SIZE		= 0xFE,
-	QUERY_DESC_GEOMETRY_MAZ_SIZE		= 0x44,
+	QUERY_DESC_GEOMETRY_MAZ_SIZE		= 0x57,
 	QUERY_DESC_POWER_MAX_SIZE		= 0x62,
 	QUERY_DESC_HEALTH_MAX_SIZE		= 0x25,
 	QUERY_DESC_RFU_MAX_SIZE			= 0x00,
@@ -178,6 +178,20 @@ enum unit_desc_param {
 	UNIT_DESC_PARAM_PHY_MEM_RSRC_CNT	= 0x18,
 	UNIT_DESC_PARAM_CTX_CAPABILITIES	= 0x20,
 	UNIT_DESC_PARAM_LARGE_UNIT_SIZE_M1	= 0x22,
+	UNIT_DESC_PARAM_HPB_LU_MAX_ACTIVE_RGNS	= 0x23,
+	UNIT_DESC_PARAM_HPB_PIN_RGN_START_OFF	= 0x25,
+	UNIT_DESC_PARAM_HPB_NUM_PIN_RGNS	= 0x27,
+};
+
+/* bLUEnable value of a logical unit with HPB enabled */
+#define UFS_LU_HPB_ENABLE	0x02
+
+/* Geometry descriptor parameters offsets in bytes */
+enum geometry_desc_param {
+	GEOMETRY_DESC_PARAM_HPB_REGION_SIZE	= 0x48,
+	GEOMETRY_DESC_PARAM_HPB_NUMBER_LU	= 0x49,
+	GEOMETRY_DESC_PARAM_HPB_SUBREGION_SIZE	= 0x4A,
+	GEOMETRY_DESC_PARAM_HPB_MAX_ACTIVE_RGNS	= 0x4B,
 };
 
 /* Device descriptor parameters offsets in bytes*/
@@ -209,6 +223,34 @@ enum device_desc_param {
 	DEVICE_DESC_PARAM_UD_LEN		= 0x1B,
 	DEVICE_DESC_PARAM_RTT_CAP		= 0x1C,
 	DEVICE_DESC_PARAM_FRQ_RTC		= 0x1D,
+	DEVICE_DESC_PARAM_UFS_FEAT		= 0x1F,
+	DEVICE_DESC_PARAM_HPB_VER		= 0x40,
+	DEVICE_DESC_PARAM_HPB_CONTROL		= 0x42,
+	DEVICE_DESC_PARAM_EXT_UFS_FEATURE_SUP	= 0x4F,
+	DEVICE_DESC_PARAM_WB_PRESRV_USRSPC_EN	= 0x53,
+	DEVICE_DESC_PARAM_WB_TYPE		= 0x54,
+	DEVICE_DESC_PARAM_WB_SHARED_ALLOC_UNITS	= 0x55,
+};
+
+/* bUFSFeaturesSupport bits */
+#define UFS_DEV_HPB_SUPPORT		(1 << 7)
+
+/* dExtendedUFSFeaturesSupport bits */
+#define UFS_DEV_WRITE_BOOSTER_SUP	(1 << 8)
+
+/* bWriteBoosterBufferType */
+enum {
+	UFS_WB_BUF_TYPE_LU_DEDICATED	= 0x0,
+	UFS_WB_BUF_TYPE_SHARED		= 0x1,
+};
+
+/* bWBBufferFlushStatus */
+enum {
+	UFS_WB_FLUSH_IDLE		= 0x0,
+	UFS_WB_FLUSH_IN_PROGRESS	= 0x1,
+	UFS_WB_FLUSH_STOPPED		= 0x2,
+	UFS_WB_FLUSH_COMPLETED		= 0x3,
+	UFS_WB_FLUSH_FAILED		= 0x4,
 };
 
 /* Health descriptor parameters offsets in bytes*/
@@ -147,6 +147,12 @@ struct ufs_card_fix {
  */
 #define UFS_DEVICE_QUIRK_HS_G1_TO_HS_G3_SWITCH (1 << 8)
 
+/*
+ * Some UFS devices advertise a WriteBooster buffer in the device
+ * descriptor but misbehave once it is enabled. Leave it alone on those.
+ */
+#define UFS_DEVICE_QUIRK_BROKEN_WB		(1 << 9)
+
 struct ufs_hba;
 void ufs_advertise_fixup_device(struct ufs_hba *hba);
 #endif /* UFS_QUIRKS_H_ */
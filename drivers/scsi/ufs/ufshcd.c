@@ -39,6 +39,7 @@
 
 #include <linux/async.h>
 #include <scsi/ufs/ioctl.h>
+#include <scsi/ufs_power.h>
 #include <linux/devfreq.h>
 #include <linux/nls.h>
 #include <linux/of.h>
@@ -49,6 +50,7 @@
 #include "ufshci.h"
 #include "ufs_quirks.h"
 #include "ufs-debugfs.h"
+#include "ufshpb.h"
 #include "ufs-qcom.h"
 
 #define CREATE_TRACE_POINTS
@@ -215,6 +217,15 @@ void ufshcd_update_query_stats(struct ufs_hba *hba,
 
 /* Interrupt aggregation default timeout, unit: 40us */
 #define INT_AGGR_DEF_TO	0x02
+/* Interrupt aggregation counter threshold limit (5 bit field) */
+#define INT_AGGR_MAX_CNT	0x1F
+/* Queue depth from which commands are aggregated */
+#define INT_AGGR_DEF_QD_ON	4
+
+/* longest runtime suspend deferral to let the WriteBooster buffer drain */
+#define UFSHCD_WB_MAX_DEFER_MS	30000
+/* default bAvailableWBBufferSize (30%) that keeps the device flushing */
+#define UFSHCD_WB_DEF_FLUSH_THLD	0x3
 
 /* default value of auto suspend is 3 seconds */
 #define UFSHCD_AUTO_SUSPEND_DELAY_MS 3000 /* millisecs */
@@ -1224,6 +1235,70 @@ static inline void ufshcd_disable_intr_aggr(struct ufs_hba *hba)
 	ufshcd_writel(hba, 0, REG_UTP_TRANSFER_REQ_INT_AGG_CONTROL);
 }
 
+/**
+ * ufshcd_init_intr_aggr - set default adaptive aggregation parameters
+ * @hba: per adapter instance
+ *
+ * The counter threshold defaults to a quarter of the queue so that a
+ * saturated queue takes about four interrupts per round trip.
+ */
+static void ufshcd_init_intr_aggr(struct ufs_hba *hba)
+{
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+
+	memset(aggr, 0, sizeof(*aggr));
+	aggr->cnt = clamp_t(int, hba->nutrs / 4, 1, INT_AGGR_MAX_CNT);
+	aggr->timeout = INT_AGGR_DEF_TO;
+	aggr->qd_on = INT_AGGR_DEF_QD_ON;
+}
+
+/**
+ * ufshcd_set_intr_aggr - change adaptive aggregation parameters
+ * @hba: per adapter instance
+ * @cnt: counter threshold, 1..31
+ * @tmout: timeout in 40us units, 1..255
+ * @qd_on: queue depth from which commands are aggregated; setting it
+ *	above nutrs stops aggregating altogether
+ *
+ * Statistics are reset. Caller must make sure the controller is powered.
+ */
+void ufshcd_set_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout, int qd_on)
+{
+	struct ufs_intr_aggr *aggr = &hba->intr_aggr;
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(aggr, 0, sizeof(*aggr));
+	aggr->cnt = clamp_t(u8, cnt, 1, INT_AGGR_MAX_CNT);
+	aggr->timeout = max_t(u8, tmout, 1);
+	aggr->qd_on = max(qd_on, 1);
+	if (ufshcd_is_intr_aggr_allowed(hba))
+		ufshcd_config_intr_aggr(hba, aggr->cnt, aggr->timeout);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+}
+EXPORT_SYMBOL_GPL(ufshcd_set_intr_aggr);
+
+/**
+ * ufshcd_need_intr_now - decide whether a command bypasses aggregation
+ * @hba: per adapter instance
+ *
+ * Aggregating at low queue depth only adds the aggregation timeout to
+ * every completion, so shallow commands ask for an immediate interrupt
+ * and only a deep queue is coalesced. The outstanding count is sampled
+ * without the host_lock; being off by one only shifts the threshold.
+ */
+static inline bool ufshcd_need_intr_now(struct ufs_hba *hba)
+{
+	unsigned long busy;
+
+	if (!ufshcd_is_intr_aggr_allowed(hba))
+		return true;
+
+	busy = READ_ONCE(hba->outstanding_reqs) |
+		READ_ONCE(hba->pending_doorbell);
+	return hweight_long(busy) < hba->intr_aggr.qd_on;
+}
+
 /**
  * ufshcd_enable_run_stop_reg - Enable run-stop registers,
  *			When run-stop registers are set to 1, it indicates the
@@ -1409,6 +1484,26 @@ static inline void ufshcd_cancel_gate_work(struct ufs_hba *hba)
 	cancel_work_sync(&hba->clk_gating.gate_work);
 }
 
+static ATOMIC_NOTIFIER_HEAD(ufshcd_power_chain);
+
+int ufshcd_register_power_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&ufshcd_power_chain, nb);
+}
+EXPORT_SYMBOL_GPL(ufshcd_register_power_notifier);
+
+int ufshcd_unregister_power_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&ufshcd_power_chain, nb);
+}
+EXPORT_SYMBOL_GPL(ufshcd_unregister_power_notifier);
+
+static void ufshcd_power_notify(struct ufs_hba *hba,
+				enum ufshcd_power_event event)
+{
+	atomic_notifier_call_chain(&ufshcd_power_chain, event, hba->host);
+}
+
 static void ufshcd_ungate_work(struct work_struct *work)
 {
 	int ret;
@@ -1442,6 +1537,7 @@ static void ufshcd_ungate_work(struct work_struct *work)
 		}
 		hba->clk_gating.is_suspended = false;
 	}
+	ufshcd_power_notify(hba, UFSHCD_POWER_AWAKE);
 unblock_reqs:
 	ufshcd_scsi_unblock_requests(hba);
 }
@@ -1621,6 +1717,7 @@ static void ufshcd_gate_work(struct work_struct *work)
 		hba->clk_gating.state = CLKS_OFF;
 		trace_ufshcd_clk_gating(dev_name(hba->dev),
 			hba->clk_gating.state);
+		ufshcd_power_notify(hba, UFSHCD_POWER_IDLE);
 	}
 rel_lock:
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
@@ -1975,6 +2072,252 @@ out:
 	return rc;
 }
 
+/* Request arrival predictor defaults */
+#define UFSHCD_IO_PREDICT_BURST_GAP_US	50000
+#define UFSHCD_IO_PREDICT_BOOST_BURST	16
+#define UFSHCD_IO_PREDICT_INPUT_MS	500
+
+/*
+ * Expected burst length, in requests. burst_ewma moves by a quarter of the
+ * difference per completed burst and keeps 4 fractional bits.
+ */
+static inline u32 ufshcd_io_predict_burst(struct ufs_io_predict *p)
+{
+	return p->burst_ewma >> 4;
+}
+
+static void ufshcd_io_predict_trace(struct ufs_hba *hba, const char *decision,
+				    unsigned long val)
+{
+	struct ufs_io_predict *p = &hba->io_predict;
+
+	trace_ufshcd_io_predict(dev_name(hba->dev), decision, p->burst_len,
+				ufshcd_io_predict_burst(p), p->gap_ewma_us, val);
+}
+
+/* host lock must be held before calling this function */
+static void ufshcd_io_predict_boost(struct ufs_hba *hba, const char *why)
+{
+	if (!ufshcd_is_clkscaling_supported(hba) || !hba->devfreq ||
+	    !hba->clk_scaling.is_allowed || hba->clk_scaling.is_scaled_up ||
+	    hba->pm_op_in_progress)
+		return;
+
+	if (queue_work(hba->clk_scaling.workq, &hba->io_predict.boost_work))
+		ufshcd_io_predict_trace(hba, why, 1);
+}
+
+/*
+ * Scale up straight away instead of waiting for the devfreq polling window
+ * to see the busy time. devfreq->lock serializes this against the governor.
+ * The governor scales back down once the burst is over.
+ */
+static void ufshcd_io_predict_boost_work(struct work_struct *work)
+{
+	struct ufs_hba *hba = container_of(work, struct ufs_hba,
+					   io_predict.boost_work);
+	unsigned long freq = UINT_MAX;
+
+	if (!hba->devfreq)
+		return;
+
+	mutex_lock(&hba->devfreq->lock);
+	if (!ufshcd_devfreq_target(hba->dev, &freq, 0))
+		hba->devfreq->previous_freq = freq;
+	mutex_unlock(&hba->devfreq->lock);
+}
+
+/**
+ * ufshcd_io_predict_arrival - account a batch of issued requests
+ * @hba: per adapter instance
+ * @now: issue time
+ * @nr: number of requests issued
+ *
+ * A gap longer than burst_gap_us starts a new burst. If the bursts seen so
+ * far are long, or the user just touched the screen, clocks get scaled up
+ * as the first request of the burst goes out rather than tens of ms later.
+ *
+ * host lock must be held before calling this function.
+ */
+static void ufshcd_io_predict_arrival(struct ufs_hba *hba, ktime_t now, int nr)
+{
+	struct ufs_io_predict *p = &hba->io_predict;
+	s64 gap;
+
+	if (!p->is_enabled)
+		return;
+
+	gap = ktime_us_delta(now, p->last_arrival);
+	p->last_arrival = now;
+
+	if (gap > p->burst_gap_us) {
+		if (p->burst_len)
+			p->burst_ewma += ((s32)(p->burst_len << 4) -
+					  (s32)p->burst_ewma) / 4;
+		p->burst_len = nr;
+		if (time_before(jiffies, p->boost_until))
+			ufshcd_io_predict_boost(hba, "input");
+		else if (ufshcd_io_predict_burst(p) >= p->boost_burst)
+			ufshcd_io_predict_boost(hba, "burst");
+		return;
+	}
+
+	p->gap_ewma_us += ((s32)gap - (s32)p->gap_ewma_us) / 8;
+	if (p->burst_len < p->boost_burst && p->burst_len + nr >= p->boost_burst)
+		ufshcd_io_predict_boost(hba, "long burst");
+	p->burst_len += nr;
+}
+
+/**
+ * ufshcd_io_predict_h8_delay - pick the hibern8 on idle delay
+ * @hba: per adapter instance
+ *
+ * While a burst is expected to continue, keep the link active for about
+ * twice the usual gap between its requests (bounded by the clock gating
+ * delay) so that it does not bounce in and out of hibern8. Once the burst
+ * has reached its usual length, let the link go down twice as fast.
+ *
+ * host lock must be held before calling this function.
+ */
+static unsigned long ufshcd_io_predict_h8_delay(struct ufs_hba *hba)
+{
+	struct ufs_io_predict *p = &hba->io_predict;
+	unsigned long delay_ms = hba->hibern8_on_idle.delay_ms;
+	unsigned long max_ms, want_ms;
+
+	if (!p->is_enabled || !p->burst_ewma)
+		return delay_ms;
+
+	if (p->burst_len >= ufshcd_io_predict_burst(p)) {
+		want_ms = max_t(unsigned long, delay_ms / 2, 1);
+	} else {
+		max_ms = min(hba->clk_gating.delay_ms_pwr_save,
+			     hba->clk_gating.delay_ms_perf);
+		max_ms = min_t(unsigned long, max_ms,
+			       p->burst_gap_us / USEC_PER_MSEC);
+		want_ms = DIV_ROUND_UP(2 * p->gap_ewma_us, USEC_PER_MSEC);
+		want_ms = clamp_t(unsigned long, want_ms, delay_ms,
+				  max_t(unsigned long, max_ms, delay_ms + 1) - 1);
+	}
+
+	if (want_ms != delay_ms)
+		ufshcd_io_predict_trace(hba, "h8 delay", want_ms);
+	return want_ms;
+}
+
+#ifdef CONFIG_SCSI_UFSHCD_INPUT_BOOST
+static void ufshcd_io_predict_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	struct ufs_hba *hba = handle->private;
+	struct ufs_io_predict *p = &hba->io_predict;
+	unsigned long flags;
+
+	/* one boost per touch gesture is plenty */
+	if (!p->is_enabled || time_before(jiffies, p->boost_until))
+		return;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	p->boost_until = jiffies +
+			 msecs_to_jiffies(UFSHCD_IO_PREDICT_INPUT_MS);
+	if (!hba->clk_scaling.is_suspended)
+		ufshcd_io_predict_boost(hba, "input");
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+}
+
+static int ufshcd_io_predict_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct ufs_hba *hba = container_of(handler, struct ufs_hba,
+					   io_predict.input_handler);
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = UFSHCD;
+	handle->private = hba;
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void ufshcd_io_predict_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id ufshcd_io_predict_input_ids[] = {
+	/* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) |
+			BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	/* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	/* Keypad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static void ufshcd_io_predict_init_input(struct ufs_hba *hba)
+{
+	struct input_handler *handler = &hba->io_predict.input_handler;
+
+	handler->event = ufshcd_io_predict_input_event;
+	handler->connect = ufshcd_io_predict_input_connect;
+	handler->disconnect = ufshcd_io_predict_input_disconnect;
+	handler->name = UFSHCD;
+	handler->id_table = ufshcd_io_predict_input_ids;
+	if (input_register_handler(handler))
+		dev_err(hba->dev, "%s: failed to register input handler\n",
+			__func__);
+	else
+		hba->io_predict.input_registered = true;
+}
+
+static void ufshcd_io_predict_exit_input(struct ufs_hba *hba)
+{
+	if (hba->io_predict.input_registered)
+		input_unregister_handler(&hba->io_predict.input_handler);
+}
+#else
+static inline void ufshcd_io_predict_init_input(struct ufs_hba *hba) {}
+static inline void ufshcd_io_predict_exit_input(struct ufs_hba *hba) {}
+#endif
+
 /* host lock must be held before calling this variant */
 static void __ufshcd_hibern8_release(struct ufs_hba *hba, bool no_sched)
 {
@@ -2005,7 +2348,7 @@ static void __ufshcd_hibern8_release(struct ufs_hba *hba, bool no_sched)
 	 * work gets scheduled atleast after 2 jiffies (any time between
 	 * 1000/HZ ms to 2000/HZ ms).
 	 */
-	delay_in_jiffies = msecs_to_jiffies(hba->hibern8_on_idle.delay_ms);
+	delay_in_jiffies = msecs_to_jiffies(ufshcd_io_predict_h8_delay(hba));
 	if (delay_in_jiffies == 1)
 		delay_in_jiffies++;
 
@@ -2277,6 +2620,99 @@ static void ufshcd_exit_hibern8_on_idle(struct ufs_hba *hba)
 	device_remove_file(hba->dev, &hba->hibern8_on_idle.enable_attr);
 }
 
+static ssize_t ufshcd_io_predict_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->io_predict.is_enabled);
+}
+
+static ssize_t ufshcd_io_predict_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_io_predict *p = &hba->io_predict;
+	unsigned long flags;
+	u32 value;
+
+	if (kstrtou32(buf, 0, &value))
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	p->is_enabled = !!value;
+	/* start learning from scratch */
+	p->gap_ewma_us = 0;
+	p->burst_len = 0;
+	p->burst_ewma = 0;
+	p->boost_until = jiffies;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static ssize_t ufshcd_io_predict_burst_gap_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", hba->io_predict.burst_gap_us);
+}
+
+static ssize_t ufshcd_io_predict_burst_gap_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 value;
+
+	if (kstrtou32(buf, 0, &value) || !value)
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	hba->io_predict.burst_gap_us = value;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static void ufshcd_init_io_predict(struct ufs_hba *hba)
+{
+	struct ufs_io_predict *p = &hba->io_predict;
+
+	p->burst_gap_us = UFSHCD_IO_PREDICT_BURST_GAP_US;
+	p->boost_burst = UFSHCD_IO_PREDICT_BOOST_BURST;
+	p->boost_until = jiffies;
+	p->is_enabled = true;
+	INIT_WORK(&p->boost_work, ufshcd_io_predict_boost_work);
+
+	p->enable_attr.show = ufshcd_io_predict_enable_show;
+	p->enable_attr.store = ufshcd_io_predict_enable_store;
+	sysfs_attr_init(&p->enable_attr.attr);
+	p->enable_attr.attr.name = "io_predict_enable";
+	p->enable_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &p->enable_attr))
+		dev_err(hba->dev, "Failed to create sysfs for io_predict_enable\n");
+
+	p->burst_gap_attr.show = ufshcd_io_predict_burst_gap_show;
+	p->burst_gap_attr.store = ufshcd_io_predict_burst_gap_store;
+	sysfs_attr_init(&p->burst_gap_attr.attr);
+	p->burst_gap_attr.attr.name = "io_predict_burst_gap_us";
+	p->burst_gap_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &p->burst_gap_attr))
+		dev_err(hba->dev, "Failed to create sysfs for io_predict_burst_gap_us\n");
+
+	ufshcd_io_predict_init_input(hba);
+}
+
+static void ufshcd_exit_io_predict(struct ufs_hba *hba)
+{
+	ufshcd_io_predict_exit_input(hba);
+	device_remove_file(hba->dev, &hba->io_predict.enable_attr);
+	device_remove_file(hba->dev, &hba->io_predict.burst_gap_attr);
+	cancel_work_sync(&hba->io_predict.boost_work);
+}
+
 static void ufshcd_hold_all(struct ufs_hba *hba)
 {
 	ufshcd_hold(hba, false);
@@ -2334,26 +2770,81 @@ static void ufshcd_clk_scaling_update_busy(struct ufs_hba *hba)
 	}
 }
 
+/**
+ * __ufshcd_ring_doorbell - issue all commands deferred in pending_doorbell
+ * @hba: per adapter instance
+ *
+ * Hands every tag collected in hba->pending_doorbell to the controller
+ * with a single doorbell write. Caller must hold the host_lock.
+ */
+static void __ufshcd_ring_doorbell(struct ufs_hba *hba)
+{
+	unsigned long pending;
+	ktime_t now;
+	int tag;
+
+	pending = xchg(&hba->pending_doorbell, 0);
+	if (!pending)
+		return;
+
+	now = ktime_get();
+	for_each_set_bit(tag, &pending, hba->nutrs) {
+		hba->lrb[tag].issue_time_stamp = now;
+		hba->lrb[tag].complete_time_stamp = ktime_set(0, 0);
+	}
+	ufshcd_io_predict_arrival(hba, now, hweight_long(pending));
+	ufshcd_clk_scaling_start_busy(hba);
+	hba->outstanding_reqs |= pending;
+	ufshcd_writel(hba, pending, REG_UTP_TRANSFER_REQ_DOOR_BELL);
+	/* Make sure that doorbell is committed immediately */
+	wmb();
+	for_each_set_bit(tag, &pending, hba->nutrs) {
+		if (hba->lrb[tag].cmd) {
+			if (hba->lrb[tag].intr_cmd)
+				hba->intr_aggr.immediate++;
+			else
+				hba->intr_aggr.aggregated++;
+		}
+		ufshcd_cond_add_cmd_trace(hba, tag, "send");
+		ufshcd_update_tag_stats(hba, tag);
+	}
+}
+
 /**
  * ufshcd_send_command - Send SCSI or device management commands
  * @hba: per adapter instance
  * @task_tag: Task tag of the command
+ *
+ * Any commands still waiting in pending_doorbell are issued along with
+ * @task_tag. Caller must hold the host_lock.
  */
 static inline
 int ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag)
 {
-	int ret = 0;
+	set_bit(task_tag, &hba->pending_doorbell);
+	__ufshcd_ring_doorbell(hba);
+	return 0;
+}
 
-	hba->lrb[task_tag].issue_time_stamp = ktime_get();
-	hba->lrb[task_tag].complete_time_stamp = ktime_set(0, 0);
-	ufshcd_clk_scaling_start_busy(hba);
-	__set_bit(task_tag, &hba->outstanding_reqs);
-	ufshcd_writel(hba, 1 << task_tag, REG_UTP_TRANSFER_REQ_DOOR_BELL);
-	/* Make sure that doorbell is committed immediately */
-	wmb();
-	ufshcd_cond_add_cmd_trace(hba, task_tag, "send");
-	ufshcd_update_tag_stats(hba, task_tag);
-	return ret;
+/**
+ * ufshcd_commit_rqs - ring the doorbell for deferred commands
+ * @host: SCSI host
+ * @hwq: hardware queue index (UFS has a single transfer request list)
+ *
+ * Called by the block layer when it stops dispatching before the request
+ * carrying SCMD_LAST, so that batched commands are not left unissued.
+ */
+static void ufshcd_commit_rqs(struct Scsi_Host *host, u16 hwq)
+{
+	struct ufs_hba *hba = shost_priv(host);
+	unsigned long flags;
+
+	if (!READ_ONCE(hba->pending_doorbell))
+		return;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	__ufshcd_ring_doorbell(hba);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
 }
 
 /**
@@ -2853,6 +3344,7 @@ static int ufshcd_compose_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 			ret = ufshcd_prepare_req_desc_hdr(hba, lrbp,
 				&upiu_flags, lrbp->cmd->sc_data_direction);
 			ufshcd_prepare_utp_scsi_cmd_upiu(lrbp, upiu_flags);
+			ufshpb_prep(hba, lrbp);
 		} else {
 			ret = -EINVAL;
 		}
@@ -3091,7 +3583,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->sense_buffer = cmd->sense_buffer;
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
-	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->intr_cmd = ufshcd_need_intr_now(hba);
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 	lrbp->req_abort_skip = false;
 
@@ -3137,6 +3629,17 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	/* Make sure descriptors are ready before ringing the doorbell */
 	wmb();
+
+	/*
+	 * With blk-mq, only the last request of a dispatch batch rings the
+	 * doorbell; the ones before it are just marked pending and get
+	 * issued together, either here or from ufshcd_commit_rqs().
+	 */
+	if (shost_use_blk_mq(host) && !(cmd->flags & SCMD_LAST)) {
+		set_bit(tag, &hba->pending_doorbell);
+		goto out;
+	}
+
 	/* issue command to the controller */
 	spin_lock_irqsave(hba->host->host_lock, flags);
 
@@ -3158,6 +3661,12 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 out_unlock:
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
 out:
+	/*
+	 * The last request of the batch may have bailed out before reaching
+	 * the doorbell; don't strand the ones queued ahead of it.
+	 */
+	if (err == 0 && shost_use_blk_mq(host) && (cmd->flags & SCMD_LAST))
+		ufshcd_commit_rqs(host, 0);
 	if (has_read_lock)
 		ufshcd_put_read_lock(hba);
 	return err;
@@ -3730,12 +4239,12 @@ EXPORT_SYMBOL(ufshcd_query_descriptor);
  *
  * Return 0 in case of success, non-zero otherwise
  */
-static int ufshcd_read_desc_param(struct ufs_hba *hba,
-				  enum desc_idn desc_id,
-				  int desc_index,
-				  u32 param_offset,
-				  u8 *param_read_buf,
-				  u32 param_size)
+int ufshcd_read_desc_param(struct ufs_hba *hba,
+			   enum desc_idn desc_id,
+			   int desc_index,
+			   u32 param_offset,
+			   u8 *param_read_buf,
+			   u32 param_size)
 {
 	int ret;
 	u8 *desc_buf;
@@ -3800,6 +4309,12 @@ static int ufshcd_read_desc_param(struct ufs_hba *hba,
 		goto out;
 	}
 
+	/* descriptors shorter than we know about lack the newer fields */
+	if (param_offset + param_size > buff_len) {
+		ret = -EINVAL;
+		goto out;
+	}
+
 	if (is_kmalloc)
 		memcpy(param_read_buf, &desc_buf[param_offset], param_size);
 out:
@@ -3807,6 +4322,7 @@ out:
 		kfree(desc_buf);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(ufshcd_read_desc_param);
 
 static inline int ufshcd_read_desc(struct ufs_hba *hba,
 				   enum desc_idn desc_id,
@@ -4835,7 +5351,8 @@ static int ufshcd_make_hba_operational(struct ufs_hba *hba)
 
 	/* Configure interrupt aggregation */
 	if (ufshcd_is_intr_aggr_allowed(hba))
-		ufshcd_config_intr_aggr(hba, hba->nutrs - 1, INT_AGGR_DEF_TO);
+		ufshcd_config_intr_aggr(hba, hba->intr_aggr.cnt,
+					hba->intr_aggr.timeout);
 	else
 		ufshcd_disable_intr_aggr(hba);
 
@@ -5269,6 +5786,10 @@ static int ufshcd_slave_configure(struct scsi_device *sdev)
 
 	sdev->autosuspend_delay = UFSHCD_AUTO_SUSPEND_DELAY_MS;
 	sdev->use_rpm_auto = 1;
+	if (ufshcd_is_write_hint_allowed(shost_priv(sdev->host)))
+		sdev->group_number_hints = 1;
+
+	ufshpb_slave_configure(shost_priv(sdev->host), sdev);
 
 	return 0;
 }
@@ -5282,6 +5803,7 @@ static void ufshcd_slave_destroy(struct scsi_device *sdev)
 	struct ufs_hba *hba;
 
 	hba = shost_priv(sdev->host);
+	ufshpb_slave_destroy(hba, sdev);
 	/* Drop the reference as it won't be needed anymore */
 	if (ufshcd_scsi_to_upiu_lun(sdev->lun) == UFS_UPIU_UFS_DEVICE_WLUN) {
 		unsigned long flags;
@@ -5403,6 +5925,9 @@ ufshcd_transfer_rsp_status(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 			scsi_status = result & MASK_SCSI_STATUS;
 			result = ufshcd_scsi_cmd_status(lrbp, scsi_status);
 
+			/* HPB hints ride on regular responses */
+			ufshpb_rsp_upiu(hba, lrbp);
+
 			/*
 			 * Currently we are only supporting BKOPs exception
 			 * events hence we can ignore BKOPs exception event
@@ -5697,6 +6222,12 @@ static irqreturn_t ufshcd_transfer_req_compl(struct ufs_hba *hba)
 	completed_reqs = tr_doorbell ^ hba->outstanding_reqs;
 
 	if (completed_reqs) {
+		u32 nr = hweight_long(completed_reqs);
+
+		hba->intr_aggr.irqs++;
+		hba->intr_aggr.completions += nr;
+		if (nr > hba->intr_aggr.max_batch)
+			hba->intr_aggr.max_batch = nr;
 		__ufshcd_transfer_req_compl(hba, completed_reqs);
 		return IRQ_HANDLED;
 	} else {
@@ -5928,6 +6459,137 @@ static int ufshcd_urgent_bkops(struct ufs_hba *hba)
 	return ufshcd_bkops_ctrl(hba, hba->urgent_bkops_lvl);
 }
 
+/**
+ * ufshcd_wb_ctrl - set or clear a WriteBooster flag
+ * @hba: per-adapter instance
+ * @idn: QUERY_FLAG_IDN_WB_* flag to change
+ * @set: true to set, false to clear
+ *
+ * Returns zero on success, non-zero on failure.
+ */
+static int ufshcd_wb_ctrl(struct ufs_hba *hba, enum flag_idn idn, bool set)
+{
+	int err;
+
+	err = ufshcd_query_flag_retry(hba, set ? UPIU_QUERY_OPCODE_SET_FLAG :
+				      UPIU_QUERY_OPCODE_CLEAR_FLAG, idn, NULL);
+	if (err)
+		dev_err(hba->dev, "%s: failed to %s WB flag %d, err %d\n",
+			__func__, set ? "set" : "clear", idn, err);
+	return err;
+}
+
+static inline int ufshcd_wb_get_avail(struct ufs_hba *hba, u32 *avail)
+{
+	return ufshcd_query_attr_retry(hba, UPIU_QUERY_OPCODE_READ_ATTR,
+			QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE, 0, 0, avail);
+}
+
+/**
+ * ufshcd_wb_probe - discover the device WriteBooster buffer
+ * @hba: per-adapter instance
+ *
+ * The write buffer is an SLC cache in front of the TLC/QLC user area.
+ * Only the shared buffer configuration is handled; devices with LU
+ * dedicated buffers configure their own through the unit descriptors and
+ * are left alone.
+ */
+static void ufshcd_wb_probe(struct ufs_hba *hba)
+{
+	struct ufs_write_booster *wb = &hba->wb;
+	u8 buf[4];
+	int err;
+
+	wb->supported = false;
+	if (hba->dev_quirks & UFS_DEVICE_QUIRK_BROKEN_WB)
+		return;
+
+	/* older descriptors end before these fields and fail the read */
+	err = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_DEVICE, 0,
+			DEVICE_DESC_PARAM_EXT_UFS_FEATURE_SUP, buf, 4);
+	if (err || !(get_unaligned_be32(buf) & UFS_DEV_WRITE_BOOSTER_SUP))
+		return;
+
+	err = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_DEVICE, 0,
+			DEVICE_DESC_PARAM_WB_TYPE, buf, 1);
+	if (err || buf[0] != UFS_WB_BUF_TYPE_SHARED)
+		return;
+
+	err = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_DEVICE, 0,
+			DEVICE_DESC_PARAM_WB_SHARED_ALLOC_UNITS, buf, 4);
+	if (err || !get_unaligned_be32(buf))
+		return;
+
+	wb->alloc_units = get_unaligned_be32(buf);
+	wb->supported = true;
+	dev_info(hba->dev, "%s: shared WriteBooster buffer, %u alloc units\n",
+		 __func__, wb->alloc_units);
+}
+
+/**
+ * ufshcd_wb_config - (re)apply the WriteBooster policy to the device
+ * @hba: per-adapter instance
+ *
+ * Called after every device reset since the flags do not survive it.
+ * Writes go through the buffer, and the device is allowed to migrate it
+ * to the user area whenever the link sits in hibern8.
+ */
+static void ufshcd_wb_config(struct ufs_hba *hba)
+{
+	struct ufs_write_booster *wb = &hba->wb;
+
+	if (!wb->supported)
+		return;
+
+	wb->enabled = !ufshcd_wb_ctrl(hba, QUERY_FLAG_IDN_WB_EN, wb->want_on);
+	wb->enabled = wb->enabled && wb->want_on;
+	if (wb->enabled)
+		wb->flush_in_h8 = !ufshcd_wb_ctrl(hba,
+				QUERY_FLAG_IDN_WB_BUFF_FLUSH_DURING_HIBERN8, true);
+	wb->defer_start = 0;
+}
+
+/**
+ * ufshcd_wb_defer_suspend - check whether runtime suspend should wait
+ * @hba: per-adapter instance
+ *
+ * The device flushes the buffer only while it is powered with the link in
+ * hibern8; runtime suspend powers it down and the flush stops. When the
+ * buffer is running low, keep the device up (its link still goes to
+ * hibern8 on idle) for up to UFSHCD_WB_MAX_DEFER_MS so that the next
+ * write burst does not hit the slow user area directly.
+ *
+ * Returns true if runtime suspend should be retried later.
+ */
+static bool ufshcd_wb_defer_suspend(struct ufs_hba *hba)
+{
+	struct ufs_write_booster *wb = &hba->wb;
+	u32 avail;
+
+	if (!wb->enabled || !wb->flush_in_h8)
+		return false;
+
+	if (wb->defer_start && time_after(jiffies, wb->defer_start +
+			msecs_to_jiffies(UFSHCD_WB_MAX_DEFER_MS)))
+		goto stop;
+
+	if (ufshcd_wb_get_avail(hba, &avail))
+		goto stop;
+	wb->avail = avail;
+
+	if (avail > wb->flush_thld)
+		goto stop;
+
+	if (!wb->defer_start)
+		wb->defer_start = jiffies;
+	wb->nr_suspend_deferred++;
+	return true;
+
+stop:
+	wb->defer_start = 0;
+	return false;
+}
+
 static inline int ufshcd_get_ee_status(struct ufs_hba *hba, u32 *status)
 {
 	return ufshcd_query_attr_retry(hba, UPIU_QUERY_OPCODE_READ_ATTR,
@@ -7555,6 +8217,13 @@ static int ufshcd_probe_hba(struct ufs_hba *hba)
 	/* UFS device is also active now */
 	ufshcd_set_ufs_dev_active(hba);
 	ufshcd_force_reset_auto_bkops(hba);
+	if (!hba->is_init_prefetch) {
+		ufshcd_wb_probe(hba);
+		ufshpb_probe(hba);
+	} else {
+		ufshpb_reset(hba);
+	}
+	ufshcd_wb_config(hba);
 	hba->wlun_dev_clr_ua = true;
 
 	if (ufshcd_get_max_pwr_mode(hba)) {
@@ -7950,6 +8619,7 @@ static struct scsi_host_template ufshcd_driver_template = {
 	.name			= UFSHCD,
 	.proc_name		= UFSHCD,
 	.queuecommand		= ufshcd_queuecommand,
+	.commit_rqs		= ufshcd_commit_rqs,
 	.slave_alloc		= ufshcd_slave_alloc,
 	.slave_configure	= ufshcd_slave_configure,
 	.slave_destroy		= ufshcd_slave_destroy,
@@ -7968,6 +8638,7 @@ static struct scsi_host_template ufshcd_driver_template = {
 	.can_queue		= UFSHCD_CAN_QUEUE,
 	.max_host_blocked	= 1,
 	.track_queue_depth	= 1,
+	.force_blk_mq		= IS_ENABLED(CONFIG_SCSI_UFSHCD_BLK_MQ),
 };
 
 static int ufshcd_config_vreg_load(struct device *dev, struct ufs_vreg *vreg,
@@ -9086,8 +9757,15 @@ int ufshcd_runtime_suspend(struct ufs_hba *hba)
 
 	if (!hba->is_powered)
 		goto out;
-	else
-		ret = ufshcd_suspend(hba, UFS_RUNTIME_PM);
+
+	if (ufshcd_wb_defer_suspend(hba)) {
+		/* let the rpm core retry after another autosuspend delay */
+		pm_runtime_mark_last_busy(hba->dev);
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = ufshcd_suspend(hba, UFS_RUNTIME_PM);
 out:
 	trace_ufshcd_runtime_suspend(dev_name(hba->dev), ret,
 		ktime_to_us(ktime_sub(ktime_get(), start)),
@@ -9333,8 +10011,141 @@ static const struct attribute_group ufs_sysfs_health_descriptor_group = {
 	.attrs = ufs_sysfs_health_descriptor,
 };
 
+static ssize_t ufs_sysfs_wb_read_attr(struct ufs_hba *hba, enum attr_idn idn,
+				      char *buf)
+{
+	u32 val;
+	int ret;
+
+	if (!hba->wb.supported)
+		return -EOPNOTSUPP;
+
+	pm_runtime_get_sync(hba->dev);
+	ret = ufshcd_query_attr_retry(hba, UPIU_QUERY_OPCODE_READ_ATTR,
+				      idn, 0, 0, &val);
+	pm_runtime_put_sync(hba->dev);
+	if (ret)
+		return -EINVAL;
+
+	return snprintf(buf, PAGE_SIZE, "0x%02X\n", val);
+}
+
+#define UFS_WB_ATTR(_name, _idn)					\
+static ssize_t _name##_show(struct device *dev,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct ufs_hba *hba = dev_get_drvdata(dev);			\
+	return ufs_sysfs_wb_read_attr(hba, QUERY_ATTR_IDN_##_idn, buf);	\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+UFS_WB_ATTR(wb_flush_status, WB_FLUSH_STATUS);
+UFS_WB_ATTR(wb_avail_buf, AVAIL_WB_BUFF_SIZE);
+UFS_WB_ATTR(wb_life_time_est, WB_BUFF_LIFE_TIME_EST);
+UFS_WB_ATTR(wb_cur_buf, CURR_WB_BUFF_SIZE);
+
+static ssize_t wb_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->wb.enabled);
+}
+
+static ssize_t wb_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	bool value;
+
+	if (!hba->wb.supported)
+		return -EOPNOTSUPP;
+	if (strtobool(buf, &value))
+		return -EINVAL;
+
+	pm_runtime_get_sync(hba->dev);
+	hba->wb.want_on = value;
+	ufshcd_wb_config(hba);
+	pm_runtime_put_sync(hba->dev);
+
+	return hba->wb.enabled == value ? count : -EIO;
+}
+static DEVICE_ATTR_RW(wb_enable);
+
+/* Trigger an explicit flush of the whole buffer while the device is active */
+static ssize_t wb_flush_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	bool value;
+	int ret;
+
+	if (!hba->wb.enabled)
+		return -EOPNOTSUPP;
+	if (strtobool(buf, &value))
+		return -EINVAL;
+
+	pm_runtime_get_sync(hba->dev);
+	ret = ufshcd_wb_ctrl(hba, QUERY_FLAG_IDN_WB_BUFF_FLUSH_EN, value);
+	pm_runtime_put_sync(hba->dev);
+
+	return ret ? -EIO : count;
+}
+static DEVICE_ATTR_WO(wb_flush);
+
+static ssize_t wb_flush_threshold_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", hba->wb.flush_thld);
+}
+
+static ssize_t wb_flush_threshold_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	u32 value;
+
+	/* bAvailableWBBufferSize units: 0x0 (empty) to 0xA (100% free) */
+	if (kstrtou32(buf, 0, &value) || value > 0xA)
+		return -EINVAL;
+
+	hba->wb.flush_thld = value;
+	return count;
+}
+static DEVICE_ATTR_RW(wb_flush_threshold);
+
+static ssize_t wb_suspend_deferred_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", hba->wb.nr_suspend_deferred);
+}
+static DEVICE_ATTR_RO(wb_suspend_deferred);
+
+static struct attribute *ufs_sysfs_write_booster[] = {
+	&dev_attr_wb_enable.attr,
+	&dev_attr_wb_flush.attr,
+	&dev_attr_wb_flush_threshold.attr,
+	&dev_attr_wb_flush_status.attr,
+	&dev_attr_wb_avail_buf.attr,
+	&dev_attr_wb_life_time_est.attr,
+	&dev_attr_wb_cur_buf.attr,
+	&dev_attr_wb_suspend_deferred.attr,
+	NULL,
+};
+
+static const struct attribute_group ufs_sysfs_write_booster_group = {
+	.name = "write_booster",
+	.attrs = ufs_sysfs_write_booster,
+};
+
+
 static const struct attribute_group *ufs_sysfs_groups[] = {
 	&ufs_sysfs_health_descriptor_group,
+	&ufs_sysfs_write_booster_group,
 	NULL,
 };
 
@@ -9495,12 +10306,14 @@ ufshcd_exit_latency_hist(struct ufs_hba *hba)
 void ufshcd_remove(struct ufs_hba *hba)
 {
 	scsi_remove_host(hba->host);
+	ufshpb_remove(hba);
 	/* disable interrupts */
 	ufshcd_disable_intr(hba, hba->intr_mask);
 	ufshcd_hba_stop(hba, true);
 
 	ufshcd_exit_clk_gating(hba);
 	ufshcd_exit_hibern8_on_idle(hba);
+	ufshcd_exit_io_predict(hba);
 	if (ufshcd_is_clkscaling_supported(hba)) {
 		device_remove_file(hba->dev, &hba->clk_scaling.enable_attr);
 		ufshcd_exit_latency_hist(hba);
@@ -10063,6 +10876,10 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 
 	/* Read capabilities registers */
 	ufshcd_hba_capabilities(hba);
+	ufshcd_init_intr_aggr(hba);
+
+	hba->wb.want_on = true;
+	hba->wb.flush_thld = UFSHCD_WB_DEF_FLUSH_THLD;
 
 	/* Get UFS version supported by the controller */
 	hba->ufs_version = ufshcd_get_ufs_version(hba);
@@ -10193,6 +11010,8 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 		ufshcd_clkscaling_init_sysfs(hba);
 	}
 
+	ufshcd_init_io_predict(hba);
+
 	/*
 	 * If rpm_lvl and and spm_lvl are not already set to valid levels,
 	 * set the default power management level for UFS runtime and system
@@ -57,6 +57,7 @@
 #include <linux/completion.h>
 #include <linux/regulator/consumer.h>
 #include <linux/reset.h>
+#include <linux/input.h>
 #include "unipro.h"
 
 #include <asm/irq.h>
@@ -470,6 +471,68 @@ struct ufs_hibern8_on_idle {
 	bool is_enabled;
 };
 
+/**
+ * struct ufs_io_predict - request arrival history driving clocks and hibern8
+ * @last_arrival: time the previous batch of requests was issued
+ * @gap_ewma_us: moving average of request gaps within a burst
+ * @burst_len: requests issued so far in the current burst
+ * @burst_ewma: moving average of burst lengths, in 1/16 request units
+ * @burst_gap_us: idle gap that ends a burst
+ * @boost_burst: expected burst length that scales clocks up at burst start
+ * @boost_until: jiffies until which recent user input forces a scale up
+ * @boost_work: scales clocks up ahead of the devfreq busy-time window
+ * @enable_attr: sysfs attribute to enable or disable the predictor
+ * @burst_gap_attr: sysfs attribute to tune @burst_gap_us
+ * @input_handler: input event hook, see CONFIG_SCSI_UFSHCD_INPUT_BOOST
+ * @input_registered: @input_handler was registered successfully
+ * @is_enabled: predictor enabled
+ *
+ * All fields except the work and the sysfs/input plumbing are protected by
+ * the host_lock.
+ */
+struct ufs_io_predict {
+	ktime_t last_arrival;
+	u32 gap_ewma_us;
+	u32 burst_len;
+	u32 burst_ewma;
+	u32 burst_gap_us;
+	u32 boost_burst;
+	unsigned long boost_until;
+	struct work_struct boost_work;
+	struct device_attribute enable_attr;
+	struct device_attribute burst_gap_attr;
+#ifdef CONFIG_SCSI_UFSHCD_INPUT_BOOST
+	struct input_handler input_handler;
+	bool input_registered;
+#endif
+	bool is_enabled;
+};
+
+/**
+ * struct ufs_write_booster - device SLC write buffer (WriteBooster) state
+ * @supported: device has a shared WriteBooster buffer
+ * @want_on: user policy, WriteBooster should be enabled
+ * @enabled: fWriteBoosterEn is set on the device
+ * @flush_in_h8: fWBBufferFlushDuringHibernate is set on the device
+ * @alloc_units: dNumSharedWriteBoosterBufferAllocUnits
+ * @avail: last bAvailableWBBufferSize read, in 10% steps
+ * @flush_thld: @avail at or below which runtime suspend is deferred so
+ *	that the device keeps flushing while the link is in hibern8
+ * @defer_start: jiffies when the current deferral began, 0 if none
+ * @nr_suspend_deferred: runtime suspends deferred to let the buffer drain
+ */
+struct ufs_write_booster {
+	bool supported;
+	bool want_on;
+	bool enabled;
+	bool flush_in_h8;
+	u32 alloc_units;
+	u32 avail;
+	u32 flush_thld;
+	unsigned long defer_start;
+	u32 nr_suspend_deferred;
+};
+
 struct ufs_saved_pwr_info {
 	struct ufs_pa_layer_attr info;
 	bool is_valid;
@@ -547,6 +610,7 @@ struct debugfs_files {
 	struct dentry *dbg_print_en;
 	struct dentry *req_stats;
 	struct dentry *query_stats;
+	struct dentry *intr_aggr;
 	u32 dme_local_attr_id;
 	u32 dme_peer_attr_id;
 	struct dentry *reset_controller;
@@ -646,6 +710,30 @@ struct ufs_stats {
 	struct ufs_uic_err_reg_hist dme_err;
 };
 
+/**
+ * struct ufs_intr_aggr - adaptive transfer completion interrupt aggregation
+ * @cnt: UTRIACR counter threshold
+ * @timeout: UTRIACR timeout, in 40us units
+ * @qd_on: outstanding requests at or above which new commands are
+ *	aggregated; below it commands request an immediate interrupt
+ * @irqs: transfer completion interrupts handled
+ * @completions: requests completed by those interrupts
+ * @aggregated: commands issued with interrupt aggregation
+ * @immediate: commands issued with the interrupt bit set
+ * @max_batch: most requests completed by a single interrupt
+ */
+struct ufs_intr_aggr {
+	u8 cnt;
+	u8 timeout;
+	int qd_on;
+
+	u64 irqs;
+	u64 completions;
+	u64 aggregated;
+	u64 immediate;
+	u32 max_batch;
+};
+
 /* UFS Host Controller debug print bitmask */
 #define UFSHCD_DBG_PRINT_CLK_FREQ_EN		UFS_BIT(0)
 #define UFSHCD_DBG_PRINT_UIC_ERR_HIST_EN	UFS_BIT(1)
@@ -777,6 +865,8 @@ struct ufs_hba {
 
 	unsigned long outstanding_tasks;
 	unsigned long outstanding_reqs;
+	/* tags queued by blk-mq but not yet written to the doorbell */
+	unsigned long pending_doorbell;
 
 	u32 capabilities;
 	int nutrs;
@@ -874,8 +964,13 @@ struct ufs_hba {
 	/* Keeps information of the UFS device connected to this host */
 	struct ufs_dev_info dev_info;
 	bool auto_bkops_enabled;
+	struct ufs_write_booster wb;
+#ifdef CONFIG_SCSI_UFS_HPB
+	struct ufshpb *hpb;
+#endif
 
 	struct ufs_stats ufs_stats;
+	struct ufs_intr_aggr intr_aggr;
 #ifdef CONFIG_DEBUG_FS
 	struct debugfs_files debugfs_files;
 #endif
@@ -899,6 +994,7 @@ struct ufs_hba {
 
 	struct ufs_clk_gating clk_gating;
 	struct ufs_hibern8_on_idle hibern8_on_idle;
+	struct ufs_io_predict io_predict;
 	struct ufshcd_cmd_log cmd_log;
 
 	/* Control to enable/disable host capabilities */
@@ -913,8 +1009,9 @@ struct ufs_hba {
 #define UFSHCD_CAP_AUTO_BKOPS_SUSPEND (1 << 3)
 	/*
 	 * This capability allows host controller driver to use the UFS HCI's
-	 * interrupt aggregation capability.
-	 * CAUTION: Enabling this might reduce overall UFS throughput.
+	 * interrupt aggregation capability. Aggregation is applied only while
+	 * the queue is deep (see struct ufs_intr_aggr), so QD1 latency is
+	 * not affected.
 	 */
 #define UFSHCD_CAP_INTR_AGGR (1 << 4)
 	/* Allow standalone Hibern8 enter on idle */
@@ -932,6 +1029,12 @@ struct ufs_hba {
 	 * in hibern8 then enable this cap.
 	 */
 #define UFSHCD_CAP_POWER_COLLAPSE_DURING_HIBERN8 (1 << 7)
+	/*
+	 * Pass the block layer write hints to the device as the context ID
+	 * of WRITE commands, for devices with contexts WRITE_LIFE_NONE (1)
+	 * to WRITE_LIFE_EXTREME (5) configured.
+	 */
+#define UFSHCD_CAP_WRITE_HINT (1 << 8)
 
 	struct devfreq *devfreq;
 	struct ufs_clk_scaling clk_scaling;
@@ -997,6 +1100,11 @@ static inline bool ufshcd_is_power_collapse_during_hibern8_allowed(
 	return !!(hba->caps & UFSHCD_CAP_POWER_COLLAPSE_DURING_HIBERN8);
 }
 
+static inline bool ufshcd_is_write_hint_allowed(struct ufs_hba *hba)
+{
+	return !!(hba->caps & UFSHCD_CAP_WRITE_HINT);
+}
+
 static inline bool ufshcd_keep_autobkops_enabled_except_suspend(
 							struct ufs_hba *hba)
 {
@@ -1159,6 +1267,9 @@ out:
 }
 
 int ufshcd_read_device_desc(struct ufs_hba *hba, u8 *buf, u32 size);
+int ufshcd_read_desc_param(struct ufs_hba *hba, enum desc_idn desc_id,
+			   int desc_index, u32 param_offset,
+			   u8 *param_read_buf, u32 param_size);
 
 static inline bool ufshcd_is_hs_mode(struct ufs_pa_layer_attr *pwr_info)
 {
@@ -1191,6 +1302,7 @@ int ufshcd_query_descriptor(struct ufs_hba *hba, enum query_opcode opcode,
 	enum desc_idn idn, u8 index, u8 selector, u8 *desc_buf, int *buf_len);
 
 int ufshcd_hold(struct ufs_hba *hba, bool async);
+void ufshcd_set_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout, int qd_on);
 void ufshcd_release(struct ufs_hba *hba, bool no_sched);
 int ufshcd_wait_for_doorbell_clr(struct ufs_hba *hba, u64 wait_timeout_us);
 int ufshcd_change_power_mode(struct ufs_hba *hba,
@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2016, Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * UFS Host Performance Booster, device control mode.
+ *
+ * The device tells us in the response UPIU of regular commands which
+ * sub-regions it would like the host to cache and which regions it
+ * dropped. Requested sub-regions are loaded with HPB READ BUFFER from a
+ * per-LU work item; afterwards 4KB READ(10)s that hit a clean entry of an
+ * active sub-region are sent as HPB READ carrying the physical address, so
+ * the device skips its own map lookup. Host writes mark the entries they
+ * cover dirty until the device asks for the sub-region to be reloaded.
+ */
+
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/bitmap.h>
+#include <linux/math64.h>
+#include <linux/blkdev.h>
+#include <linux/moduleparam.h>
+#include <asm/unaligned.h>
+#include <scsi/scsi_cmnd.h>
+#include <scsi/scsi_device.h>
+
+#include "ufshcd.h"
+#include "ufshpb.h"
+
+#define UFSHPB_MAP_TIMEOUT	(30 * HZ)
+#define UFSHPB_MAP_RETRIES	3
+
+static unsigned int max_map_kb = 16384;
+module_param(max_map_kb, uint, 0444);
+MODULE_PARM_DESC(max_map_kb,
+	"Host memory per HPB logical unit for cached L2P entries, in KB");
+
+static inline int ufshpb_map_len(struct ufshpb *hpb)
+{
+	return hpb->entries_per_srgn * UFSHPB_ENTRY_SIZE;
+}
+
+static struct ufshpb_lu *ufshpb_get_lu(struct ufs_hba *hba, int lun)
+{
+	if (!hba->hpb || lun < 0 || lun >= UFS_UPIU_MAX_GENERAL_LUN)
+		return NULL;
+	return hba->hpb->lu[lun];
+}
+
+/* Drop the cached map of a sub-region, must be called with lu->lock held */
+static void ufshpb_srgn_release(struct ufshpb_lu *lu, struct ufshpb_srgn *s)
+{
+	if (s->state == HPB_SRGN_INACTIVE)
+		return;
+
+	list_del_init(&s->lru);
+	list_del_init(&s->act);
+	kfree(s->map);
+	s->map = NULL;
+	kfree(s->dirty);
+	s->dirty = NULL;
+	s->state = HPB_SRGN_INACTIVE;
+	if (!s->pinned)
+		lu->nr_active--;
+}
+
+/* Queue the map of a sub-region for loading, lu->lock held */
+static void ufshpb_srgn_activate(struct ufshpb_lu *lu, int idx)
+{
+	struct ufshpb_srgn *s, *victim;
+
+	if (idx < 0 || idx >= lu->total_srgns)
+		return;
+
+	s = &lu->srgns[idx];
+	switch (s->state) {
+	case HPB_SRGN_LOADING:
+		/* re-queue if the load is already in flight */
+		if (list_empty(&s->act))
+			list_add_tail(&s->act, &lu->act_list);
+		return;
+	case HPB_SRGN_ACTIVE:
+		/* the device moved data around, reload the map */
+		list_del_init(&s->lru);
+		break;
+	default:
+		if (!s->pinned && lu->nr_active >= lu->max_active) {
+			if (list_empty(&lu->lru))
+				return;
+			victim = list_last_entry(&lu->lru, struct ufshpb_srgn,
+						 lru);
+			ufshpb_srgn_release(lu, victim);
+			lu->stats.evict++;
+		}
+		if (!s->pinned)
+			lu->nr_active++;
+		break;
+	}
+
+	s->state = HPB_SRGN_LOADING;
+	list_add_tail(&s->act, &lu->act_list);
+	lu->stats.activate++;
+}
+
+static void ufshpb_rgn_inactivate(struct ufshpb_lu *lu, int rgn)
+{
+	struct ufshpb *hpb = lu->hpb;
+	int idx = rgn * hpb->srgns_per_rgn;
+	int end = min(idx + hpb->srgns_per_rgn, lu->total_srgns);
+
+	if (rgn < 0 || idx >= lu->total_srgns)
+		return;
+
+	for (; idx < end; idx++) {
+		if (!lu->srgns[idx].pinned)
+			ufshpb_srgn_release(lu, &lu->srgns[idx]);
+	}
+	lu->stats.inactivate++;
+}
+
+/* Forget every cached map and queue the pinned regions again */
+static void ufshpb_lu_reset(struct ufshpb_lu *lu)
+{
+	int idx;
+
+	for (idx = 0; idx < lu->total_srgns; idx++) {
+		ufshpb_srgn_release(lu, &lu->srgns[idx]);
+		if (lu->srgns[idx].pinned)
+			ufshpb_srgn_activate(lu, idx);
+	}
+}
+
+static int ufshpb_read_buffer(struct ufshpb_lu *lu, int idx, u8 *map)
+{
+	struct ufshpb *hpb = lu->hpb;
+	struct scsi_device *sdev;
+	unsigned long flags;
+	u8 cdb[10] = { 0 };
+	int rgn = idx / hpb->srgns_per_rgn;
+	int srgn = idx % hpb->srgns_per_rgn;
+	int len = ufshpb_map_len(hpb);
+	int ret;
+
+	spin_lock_irqsave(&lu->lock, flags);
+	sdev = lu->sdev;
+	if (sdev && scsi_device_get(sdev))
+		sdev = NULL;
+	spin_unlock_irqrestore(&lu->lock, flags);
+	if (!sdev)
+		return -ENODEV;
+
+	cdb[0] = UFSHPB_READ_BUFFER;
+	cdb[1] = UFSHPB_READ_BUFFER_ID;
+	put_unaligned_be16(rgn, &cdb[2]);
+	put_unaligned_be16(srgn, &cdb[4]);
+	cdb[6] = (len >> 16) & 0xff;
+	put_unaligned_be16(len & 0xffff, &cdb[7]);
+
+	ret = scsi_execute(sdev, cdb, DMA_FROM_DEVICE, map, len, NULL,
+			   UFSHPB_MAP_TIMEOUT, UFSHPB_MAP_RETRIES, 0, NULL);
+	if (ret)
+		dev_err_ratelimited(hpb->hba->dev,
+			"%s: lun %d rgn %d srgn %d failed, result 0x%x\n",
+			__func__, lu->lun, rgn, srgn, ret);
+	scsi_device_put(sdev);
+
+	return ret ? -EIO : 0;
+}
+
+static void ufshpb_map_work(struct work_struct *work)
+{
+	struct ufshpb_lu *lu = container_of(work, struct ufshpb_lu, map_work);
+	struct ufshpb *hpb = lu->hpb;
+	int nr_longs = BITS_TO_LONGS(hpb->entries_per_srgn);
+	struct ufshpb_srgn *s;
+	unsigned long *dirty;
+	unsigned long flags;
+	bool need_dirty, tracked;
+	u8 *map;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&lu->lock, flags);
+		if (list_empty(&lu->act_list)) {
+			spin_unlock_irqrestore(&lu->lock, flags);
+			break;
+		}
+		s = list_first_entry(&lu->act_list, struct ufshpb_srgn, act);
+		list_del_init(&s->act);
+		/* the buffer belongs to us until the load completes */
+		map = s->map;
+		s->map = NULL;
+		need_dirty = !s->dirty;
+		spin_unlock_irqrestore(&lu->lock, flags);
+
+		if (!map)
+			map = kmalloc(ufshpb_map_len(hpb),
+				      GFP_KERNEL | __GFP_NOWARN);
+		dirty = NULL;
+		if (need_dirty)
+			dirty = kcalloc(nr_longs, sizeof(long), GFP_KERNEL);
+
+		/*
+		 * Writes issued from now on are tracked in the dirty bitmap,
+		 * the map read below may predate them.
+		 */
+		spin_lock_irqsave(&lu->lock, flags);
+		if (s->state == HPB_SRGN_LOADING && !s->dirty) {
+			s->dirty = dirty;
+			dirty = NULL;
+		}
+		tracked = s->state == HPB_SRGN_LOADING && s->dirty;
+		if (tracked)
+			bitmap_zero(s->dirty, hpb->entries_per_srgn);
+		spin_unlock_irqrestore(&lu->lock, flags);
+
+		ret = -ENOMEM;
+		if (map && tracked)
+			ret = ufshpb_read_buffer(lu, s - lu->srgns, map);
+
+		spin_lock_irqsave(&lu->lock, flags);
+		if (s->state == HPB_SRGN_LOADING && !list_empty(&s->act)) {
+			/* asked for again while loading, keep the buffer */
+			s->map = map;
+			map = NULL;
+		} else if (s->state == HPB_SRGN_LOADING && !ret) {
+			s->map = map;
+			map = NULL;
+			s->state = HPB_SRGN_ACTIVE;
+			if (!s->pinned)
+				list_add(&s->lru, &lu->lru);
+		} else if (s->state == HPB_SRGN_LOADING) {
+			lu->stats.map_fail++;
+			ufshpb_srgn_release(lu, s);
+		}
+		spin_unlock_irqrestore(&lu->lock, flags);
+
+		kfree(map);
+		kfree(dirty);
+	}
+}
+
+static void ufshpb_set_dirty(struct ufshpb_lu *lu, u64 lba, u64 end)
+{
+	struct ufshpb *hpb = lu->hpb;
+	struct ufshpb_srgn *s;
+	unsigned long flags;
+	u64 srgn_end;
+	int idx, off;
+
+	end = min(end, lu->blocks);
+
+	spin_lock_irqsave(&lu->lock, flags);
+	while (lba < end) {
+		idx = lba >> hpb->srgn_shift;
+		off = lba & (hpb->entries_per_srgn - 1);
+		srgn_end = min_t(u64, end, (u64)(idx + 1) << hpb->srgn_shift);
+		s = &lu->srgns[idx];
+		if (s->state != HPB_SRGN_INACTIVE && s->dirty)
+			bitmap_set(s->dirty, off, srgn_end - lba);
+		lba = srgn_end;
+	}
+	spin_unlock_irqrestore(&lu->lock, flags);
+}
+
+/**
+ * ufshpb_prep - turn a 4KB READ(10) into HPB READ on a map hit
+ * @hba: per adapter instance
+ * @lrbp: request whose command UPIU was just composed
+ *
+ * Also invalidates the cached entries covered by writes and discards.
+ */
+void ufshpb_prep(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	struct scsi_cmnd *cmd = lrbp->cmd;
+	struct ufshpb_lu *lu = ufshpb_get_lu(hba, lrbp->lun);
+	struct ufshpb *hpb;
+	struct ufshpb_srgn *s;
+	struct request *rq;
+	unsigned long flags;
+	u8 entry[UFSHPB_ENTRY_SIZE];
+	u8 *cdb;
+	u64 lba;
+	int idx, off;
+
+	if (!lu || !cmd)
+		return;
+	hpb = lu->hpb;
+
+	rq = cmd->request;
+	if (rq && rq->cmd_type == REQ_TYPE_FS && rq_data_dir(rq) == WRITE) {
+		if (blk_rq_sectors(rq))
+			ufshpb_set_dirty(lu,
+				blk_rq_pos(rq) >> (UFSHPB_BLK_SHIFT - 9),
+				DIV_ROUND_UP_ULL(blk_rq_pos(rq) +
+						 blk_rq_sectors(rq),
+						 1 << (UFSHPB_BLK_SHIFT - 9)));
+		return;
+	}
+
+	if (cmd->cmnd[0] != READ_10 || get_unaligned_be16(&cmd->cmnd[7]) != 1)
+		return;
+
+	lba = get_unaligned_be32(&cmd->cmnd[2]);
+	if (lba >= lu->blocks)
+		return;
+	idx = lba >> hpb->srgn_shift;
+	off = lba & (hpb->entries_per_srgn - 1);
+
+	spin_lock_irqsave(&lu->lock, flags);
+	s = &lu->srgns[idx];
+	if (s->state != HPB_SRGN_ACTIVE || test_bit(off, s->dirty)) {
+		lu->stats.miss++;
+		spin_unlock_irqrestore(&lu->lock, flags);
+		return;
+	}
+	memcpy(entry, s->map + off * UFSHPB_ENTRY_SIZE, UFSHPB_ENTRY_SIZE);
+	if (!s->pinned)
+		list_move(&s->lru, &lu->lru);
+	lu->stats.hit++;
+	spin_unlock_irqrestore(&lu->lock, flags);
+
+	cdb = lrbp->ucd_req_ptr->sc.cdb;
+	cdb[0] = UFSHPB_READ;
+	cdb[1] = cmd->cmnd[1];
+	memcpy(&cdb[2], &cmd->cmnd[2], 4);
+	memcpy(&cdb[6], entry, UFSHPB_ENTRY_SIZE);
+	cdb[14] = 1;
+	cdb[15] = cmd->cmnd[9];
+}
+
+/**
+ * ufshpb_rsp_upiu - act on the HPB hints carried by a response UPIU
+ * @hba: per adapter instance
+ * @lrbp: completed request
+ *
+ * Called from the completion path, map loads are deferred to the LU work.
+ */
+void ufshpb_rsp_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	struct utp_upiu_rsp *rsp = lrbp->ucd_rsp_ptr;
+	u8 *data = rsp->sr.sense_data;
+	struct ufshpb_lu *lu;
+	unsigned long flags;
+	int i, cnt, rgn, srgn;
+
+	if (!hba->hpb || !(rsp->header.dword_2 & UFSHPB_UPDATE_ALERT))
+		return;
+
+	if (be16_to_cpu(rsp->sr.sense_data_len) !=
+			RESPONSE_UPIU_SENSE_DATA_LENGTH ||
+	    data[0] != UFSHPB_RSP_DESC_TYPE ||
+	    data[1] != UFSHPB_RSP_ADDITIONAL_LEN)
+		return;
+
+	lu = ufshpb_get_lu(hba, data[3]);
+	if (!lu)
+		return;
+
+	spin_lock_irqsave(&lu->lock, flags);
+	switch (data[2]) {
+	case UFSHPB_RSP_REQ_REGION_UPDATE:
+		cnt = min_t(int, data[4], UFSHPB_RSP_MAX_ACTIVE);
+		for (i = 0; i < cnt; i++) {
+			rgn = get_unaligned_be16(&data[6 + i * 4]);
+			srgn = get_unaligned_be16(&data[8 + i * 4]);
+			if (rgn >= lu->rgns || srgn >= lu->hpb->srgns_per_rgn)
+				continue;
+			ufshpb_srgn_activate(lu,
+					rgn * lu->hpb->srgns_per_rgn + srgn);
+		}
+		cnt = min_t(int, data[5], UFSHPB_RSP_MAX_INACTIVE);
+		for (i = 0; i < cnt; i++)
+			ufshpb_rgn_inactivate(lu,
+				get_unaligned_be16(&data[14 + i * 2]));
+		break;
+	case UFSHPB_RSP_RESET:
+		ufshpb_lu_reset(lu);
+		break;
+	default:
+		break;
+	}
+	if (!list_empty(&lu->act_list) && lu->sdev)
+		schedule_work(&lu->map_work);
+	spin_unlock_irqrestore(&lu->lock, flags);
+}
+
+void ufshpb_slave_configure(struct ufs_hba *hba, struct scsi_device *sdev)
+{
+	struct ufshpb_lu *lu = ufshpb_get_lu(hba, sdev->lun);
+	unsigned long flags;
+
+	if (!lu)
+		return;
+
+	spin_lock_irqsave(&lu->lock, flags);
+	lu->sdev = sdev;
+	ufshpb_lu_reset(lu);
+	if (!list_empty(&lu->act_list))
+		schedule_work(&lu->map_work);
+	spin_unlock_irqrestore(&lu->lock, flags);
+}
+
+void ufshpb_slave_destroy(struct ufs_hba *hba, struct scsi_device *sdev)
+{
+	struct ufshpb_lu *lu = ufshpb_get_lu(hba, sdev->lun);
+	unsigned long flags;
+	int idx;
+
+	if (!lu || lu->sdev != sdev)
+		return;
+
+	spin_lock_irqsave(&lu->lock, flags);
+	lu->sdev = NULL;
+	spin_unlock_irqrestore(&lu->lock, flags);
+	cancel_work_sync(&lu->map_work);
+
+	spin_lock_irqsave(&lu->lock, flags);
+	for (idx = 0; idx < lu->total_srgns; idx++)
+		ufshpb_srgn_release(lu, &lu->srgns[idx]);
+	spin_unlock_irqrestore(&lu->lock, flags);
+}
+
+/**
+ * ufshpb_reset - the device forgot its active regions
+ * @hba: per adapter instance
+ *
+ * Called after the link and device were re-initialized.
+ */
+void ufshpb_reset(struct ufs_hba *hba)
+{
+	struct ufshpb_lu *lu;
+	unsigned long flags;
+	int lun;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		lu = ufshpb_get_lu(hba, lun);
+		if (!lu)
+			continue;
+		spin_lock_irqsave(&lu->lock, flags);
+		ufshpb_lu_reset(lu);
+		if (!list_empty(&lu->act_list) && lu->sdev)
+			schedule_work(&lu->map_work);
+		spin_unlock_irqrestore(&lu->lock, flags);
+	}
+}
+
+static ssize_t ufshpb_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufshpb_stats st;
+	struct ufshpb_lu *lu;
+	unsigned long flags;
+	int lun, nr_active;
+	ssize_t len = 0;
+	u64 reads;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		lu = ufshpb_get_lu(hba, lun);
+		if (!lu)
+			continue;
+		spin_lock_irqsave(&lu->lock, flags);
+		st = lu->stats;
+		nr_active = lu->nr_active;
+		spin_unlock_irqrestore(&lu->lock, flags);
+
+		reads = st.hit + st.miss;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"lun%d: active %d/%d hit %llu miss %llu hit_rate %llu%% activate %llu evict %llu inactivate %llu map_fail %llu\n",
+			lun, nr_active, lu->max_active, st.hit, st.miss,
+			reads ? div64_u64(st.hit * 100, reads) : 0,
+			st.activate, st.evict, st.inactivate, st.map_fail);
+	}
+
+	return len;
+}
+
+static ssize_t ufshpb_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufshpb_lu *lu;
+	unsigned long flags;
+	int lun;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		lu = ufshpb_get_lu(hba, lun);
+		if (!lu)
+			continue;
+		spin_lock_irqsave(&lu->lock, flags);
+		memset(&lu->stats, 0, sizeof(lu->stats));
+		spin_unlock_irqrestore(&lu->lock, flags);
+	}
+
+	return count;
+}
+
+static int ufshpb_lu_init(struct ufshpb *hpb, int lun, const u8 *desc)
+{
+	struct ufshpb_lu *lu;
+	u16 lu_max_active, pin_start, pin_cnt;
+	u64 budget;
+	int idx;
+
+	lu = kzalloc(sizeof(*lu), GFP_KERNEL);
+	if (!lu)
+		return -ENOMEM;
+
+	lu->hpb = hpb;
+	lu->lun = lun;
+	lu->blocks = get_unaligned_be64(
+			&desc[UNIT_DESC_PARAM_LOGICAL_BLK_COUNT]);
+	lu->rgns = DIV_ROUND_UP_ULL(lu->blocks, 1ULL << hpb->rgn_shift);
+	lu->total_srgns = DIV_ROUND_UP_ULL(lu->blocks,
+					   1ULL << hpb->srgn_shift);
+
+	lu_max_active = get_unaligned_be16(
+			&desc[UNIT_DESC_PARAM_HPB_LU_MAX_ACTIVE_RGNS]);
+	if (!lu_max_active || lu_max_active > hpb->max_active_rgns)
+		lu_max_active = hpb->max_active_rgns;
+	budget = div_u64((u64)max_map_kb * 1024, ufshpb_map_len(hpb));
+	lu->max_active = min_t(u64, budget,
+			       (u64)lu_max_active * hpb->srgns_per_rgn);
+
+	pin_start = get_unaligned_be16(
+			&desc[UNIT_DESC_PARAM_HPB_PIN_RGN_START_OFF]);
+	pin_cnt = get_unaligned_be16(&desc[UNIT_DESC_PARAM_HPB_NUM_PIN_RGNS]);
+	if (pin_start < lu->rgns) {
+		lu->pin_start = pin_start;
+		lu->pin_cnt = min_t(int, pin_cnt, lu->rgns - pin_start);
+		/* pinned maps come out of the same memory budget */
+		lu->pin_cnt = min(lu->pin_cnt,
+				  lu->max_active / hpb->srgns_per_rgn);
+		lu->max_active -= lu->pin_cnt * hpb->srgns_per_rgn;
+	}
+
+	lu->srgns = vzalloc(lu->total_srgns * sizeof(*lu->srgns));
+	if (!lu->srgns) {
+		kfree(lu);
+		return -ENOMEM;
+	}
+	for (idx = 0; idx < lu->total_srgns; idx++) {
+		INIT_LIST_HEAD(&lu->srgns[idx].lru);
+		INIT_LIST_HEAD(&lu->srgns[idx].act);
+		lu->srgns[idx].pinned =
+			idx / hpb->srgns_per_rgn >= lu->pin_start &&
+			idx / hpb->srgns_per_rgn < lu->pin_start + lu->pin_cnt;
+	}
+
+	spin_lock_init(&lu->lock);
+	INIT_LIST_HEAD(&lu->lru);
+	INIT_LIST_HEAD(&lu->act_list);
+	INIT_WORK(&lu->map_work, ufshpb_map_work);
+	hpb->lu[lun] = lu;
+
+	dev_info(hpb->hba->dev, "%s: lun %d: %d regions, %d pinned, caching up to %d sub-regions\n",
+		 __func__, lun, lu->rgns, lu->pin_cnt, lu->max_active);
+	return 0;
+}
+
+static void ufshpb_lu_free(struct ufshpb_lu *lu)
+{
+	int idx;
+
+	cancel_work_sync(&lu->map_work);
+	for (idx = 0; idx < lu->total_srgns; idx++) {
+		kfree(lu->srgns[idx].map);
+		kfree(lu->srgns[idx].dirty);
+	}
+	vfree(lu->srgns);
+	kfree(lu);
+}
+
+static int ufshpb_read_geometry(struct ufs_hba *hba, struct ufshpb *hpb)
+{
+	u8 buf[4];
+	u8 rgn_exp, srgn_exp;
+	int ret;
+
+	ret = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_GEOMETRY, 0,
+				     GEOMETRY_DESC_PARAM_HPB_REGION_SIZE,
+				     buf, sizeof(buf));
+	if (ret)
+		return ret;
+
+	rgn_exp = buf[0];
+	srgn_exp = buf[2];
+	hpb->max_active_rgns = get_unaligned_be16(&buf[3]);
+	/* sizes are reported as 512B << n, we need whole 4KB blocks */
+	if (!buf[1] || !hpb->max_active_rgns || srgn_exp < 3 ||
+	    srgn_exp > rgn_exp || rgn_exp > 31)
+		return -EINVAL;
+
+	hpb->rgn_shift = rgn_exp - 3;
+	hpb->srgn_shift = srgn_exp - 3;
+	hpb->srgns_per_rgn = 1 << (hpb->rgn_shift - hpb->srgn_shift);
+	hpb->entries_per_srgn = 1 << hpb->srgn_shift;
+	if (ufshpb_map_len(hpb) > KMALLOC_MAX_SIZE)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * ufshpb_probe - discover HPB support and set up the HPB logical units
+ * @hba: per adapter instance
+ *
+ * Called once, after the device finished initialization and before the
+ * logical units are scanned. Failures leave HPB disabled.
+ */
+void ufshpb_probe(struct ufs_hba *hba)
+{
+	struct ufshpb *hpb;
+	u8 *desc;
+	u8 buf[3];
+	int lun, ret;
+
+	ret = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_DEVICE, 0,
+				     DEVICE_DESC_PARAM_UFS_FEAT, buf, 1);
+	if (ret || !(buf[0] & UFS_DEV_HPB_SUPPORT))
+		return;
+
+	ret = ufshcd_read_desc_param(hba, QUERY_DESC_IDN_DEVICE, 0,
+				     DEVICE_DESC_PARAM_HPB_VER, buf, 3);
+	if (ret)
+		return;
+	if (get_unaligned_be16(buf) != UFSHPB_VER) {
+		dev_info(hba->dev, "%s: HPB version 0x%x is not supported\n",
+			 __func__, get_unaligned_be16(buf));
+		return;
+	}
+	if (buf[2] != 1) {
+		dev_info(hba->dev, "%s: host control mode is not supported\n",
+			 __func__);
+		return;
+	}
+
+	hpb = kzalloc(sizeof(*hpb), GFP_KERNEL);
+	desc = kzalloc(QUERY_DESC_UNIT_MAX_SIZE, GFP_KERNEL);
+	if (!hpb || !desc)
+		goto out_free;
+
+	hpb->hba = hba;
+	hpb->version = UFSHPB_VER;
+	ret = ufshpb_read_geometry(hba, hpb);
+	if (ret) {
+		dev_err(hba->dev, "%s: bad HPB geometry, err %d\n",
+			__func__, ret);
+		goto out_free;
+	}
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		if (ufshcd_read_desc_param(hba, QUERY_DESC_IDN_UNIT, lun, 0,
+					   desc, QUERY_DESC_UNIT_MAX_SIZE))
+			continue;
+		if (desc[UNIT_DESC_PARAM_LU_ENABLE] != UFS_LU_HPB_ENABLE ||
+		    desc[UNIT_DESC_PARAM_LOGICAL_BLK_SIZE] != UFSHPB_BLK_SHIFT)
+			continue;
+		if (ufshpb_lu_init(hpb, lun, desc))
+			dev_err(hba->dev, "%s: lun %d: no memory for HPB\n",
+				__func__, lun);
+	}
+	kfree(desc);
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++)
+		if (hpb->lu[lun])
+			break;
+	if (lun == UFS_UPIU_MAX_GENERAL_LUN) {
+		kfree(hpb);
+		return;
+	}
+
+	hpb->stats_attr.show = ufshpb_stats_show;
+	hpb->stats_attr.store = ufshpb_stats_store;
+	sysfs_attr_init(&hpb->stats_attr.attr);
+	hpb->stats_attr.attr.name = "hpb_stats";
+	hpb->stats_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &hpb->stats_attr))
+		dev_err(hba->dev, "Failed to create sysfs for hpb_stats\n");
+
+	hba->hpb = hpb;
+	return;
+
+out_free:
+	kfree(desc);
+	kfree(hpb);
+}
+
+void ufshpb_remove(struct ufs_hba *hba)
+{
+	struct ufshpb *hpb = hba->hpb;
+	int lun;
+
+	if (!hpb)
+		return;
+
+	device_remove_file(hba->dev, &hpb->stats_attr);
+	hba->hpb = NULL;
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++)
+		if (hpb->lu[lun])
+			ufshpb_lu_free(hpb->lu[lun]);
+	kfree(hpb);
+}
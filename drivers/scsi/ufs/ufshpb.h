@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016, Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * UFS Host Performance Booster (HPB): caches the device's logical to
+ * physical map of hot regions in host memory so that 4KB random reads can
+ * carry the physical address to the device in an HPB READ command.
+ */
+
+#ifndef _UFSHPB_H
+#define _UFSHPB_H
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <scsi/scsi_device.h>
+#include "ufshcd.h"
+
+#define UFSHPB_VER			0x0100
+
+/* SCSI opcodes defined by the HPB extension */
+#define UFSHPB_READ			0xF8
+#define UFSHPB_READ_BUFFER		0xF9
+#define UFSHPB_READ_BUFFER_ID		0x01
+#define UFSHPB_READ_CDB_LEN		16
+
+/* HPB entries are one per 4KB logical block, 8 bytes each */
+#define UFSHPB_ENTRY_SIZE		8
+#define UFSHPB_BLK_SHIFT		12
+
+/* Device information bit in the response UPIU header */
+#define UFSHPB_UPDATE_ALERT		UPIU_HEADER_DWORD(0, 1, 0, 0)
+
+/* Layout of the HPB sense data returned in the response UPIU */
+#define UFSHPB_RSP_DESC_TYPE		0x80
+#define UFSHPB_RSP_ADDITIONAL_LEN	0x10
+#define UFSHPB_RSP_MAX_ACTIVE		2
+#define UFSHPB_RSP_MAX_INACTIVE		2
+
+enum ufshpb_rsp_op {
+	UFSHPB_RSP_NONE			= 0,
+	UFSHPB_RSP_REQ_REGION_UPDATE	= 1,
+	UFSHPB_RSP_RESET		= 2,
+};
+
+enum ufshpb_srgn_state {
+	HPB_SRGN_INACTIVE,
+	HPB_SRGN_LOADING,
+	HPB_SRGN_ACTIVE,
+};
+
+/**
+ * struct ufshpb_srgn - host copy of one sub-region's L2P map
+ * @map: raw HPB entries as returned by HPB READ BUFFER
+ * @dirty: one bit per entry, set once the host wrote to that block
+ * @state: one of enum ufshpb_srgn_state
+ * @pinned: sub-region belongs to a pinned region and is never evicted
+ * @lru: position in the LRU list while active and unpinned
+ * @act: position in the pending load list
+ */
+struct ufshpb_srgn {
+	u8 *map;
+	unsigned long *dirty;
+	u8 state;
+	bool pinned;
+	struct list_head lru;
+	struct list_head act;
+};
+
+struct ufshpb_stats {
+	u64 hit;
+	u64 miss;
+	u64 activate;
+	u64 evict;
+	u64 inactivate;
+	u64 map_fail;
+};
+
+/**
+ * struct ufshpb_lu - per logical unit HPB state
+ * @lock: protects sub-region states, lists and stats
+ * @srgns: all sub-regions of the LU, indexed by rgn * srgns_per_rgn + srgn
+ * @lru: active, unpinned sub-regions, least recently used at the tail
+ * @act_list: sub-regions waiting for their map to be loaded
+ * @map_work: loads the maps of the sub-regions on @act_list
+ * @max_active: number of sub-regions we are willing to cache
+ */
+struct ufshpb_lu {
+	struct ufshpb *hpb;
+	struct scsi_device *sdev;
+	int lun;
+	u64 blocks;
+	int rgns;
+	int total_srgns;
+	int pin_start;
+	int pin_cnt;
+	int max_active;
+	int nr_active;
+
+	spinlock_t lock;
+	struct ufshpb_srgn *srgns;
+	struct list_head lru;
+	struct list_head act_list;
+	struct work_struct map_work;
+	struct ufshpb_stats stats;
+};
+
+/**
+ * struct ufshpb - HPB state of a UFS device
+ * @rgn_shift: log2 of the region size in 4KB blocks
+ * @srgn_shift: log2 of the sub-region size in 4KB blocks
+ * @srgns_per_rgn: number of sub-regions in a region
+ * @stats_attr: sysfs node reporting (and resetting) the per-device stats
+ */
+struct ufshpb {
+	struct ufs_hba *hba;
+	u16 version;
+	int rgn_shift;
+	int srgn_shift;
+	int srgns_per_rgn;
+	int entries_per_srgn;
+	u16 max_active_rgns;
+	struct ufshpb_lu *lu[UFS_UPIU_MAX_GENERAL_LUN];
+	struct device_attribute stats_attr;
+};
+
+#ifdef CONFIG_SCSI_UFS_HPB
+void ufshpb_probe(struct ufs_hba *hba);
+void ufshpb_reset(struct ufs_hba *hba);
+void ufshpb_remove(struct ufs_hba *hba);
+void ufshpb_slave_configure(struct ufs_hba *hba, struct scsi_device *sdev);
+void ufshpb_slave_destroy(struct ufs_hba *hba, struct scsi_device *sdev);
+void ufshpb_prep(struct ufs_hba *hba, struct ufshcd_lrb *lrbp);
+void ufshpb_rsp_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp);
+#else
+static inline void ufshpb_probe(struct ufs_hba *hba) {}
+static inline void ufshpb_reset(struct ufs_hba *hba) {}
+static inline void ufshpb_remove(struct ufs_hba *hba) {}
+static inline void ufshpb_slave_configure(struct ufs_hba *hba,
+					  struct scsi_device *sdev) {}
+static inline void ufshpb_slave_destroy(struct ufs_hba *hba,
+					struct scsi_device *sdev) {}
+static inline void ufshpb_prep(struct ufs_hba *hba,
+			       struct ufshcd_lrb *lrbp) {}
+static inline void ufshpb_rsp_upiu(struct ufs_hba *hba,
+				   struct ufshcd_lrb *lrbp) {}
+#endif
+
+#endif /* _UFSHPB_H */
@@ -26,13 +26,57 @@
 #include <linux/types.h>
 #include <linux/mutex.h>
 #include <linux/mm.h>
+#include <linux/bio.h>
+#include <linux/genhd.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
 #include <soc/qcom/boot_stats.h>
 
 #define MAX_STRING_LEN 256
 #define BOOT_MARKER_MAX_LEN 40
+#define BOOT_EVENT_MAX 512
+#define BOOT_EVENT_NAME_LEN 48
+#define BOOT_IO_MAX_DEVS 16
+#define BOOT_IO_WINDOW_US (120 * USEC_PER_SEC)
 static struct dentry *dent_bkpi, *dent_bkpi_status, *dent_mpm_timer;
+static struct dentry *dent_timeline;
 static struct boot_marker boot_marker_list;
 
+/* Events shorter than this are not worth a slot, except deferrals and I/O */
+static unsigned int event_min_us = 1000;
+module_param(event_min_us, uint, 0644);
+
+struct boot_event {
+	u64 start_us;
+	u32 dur_us;
+	s32 ret;
+	u8 type;
+	bool valid;
+	char name[BOOT_EVENT_NAME_LEN];
+};
+
+static struct boot_event boot_events[BOOT_EVENT_MAX];
+static atomic_t boot_event_cnt = ATOMIC_INIT(0);
+static bool boot_events_on = true;
+bool boot_events_io = true;
+EXPORT_SYMBOL(boot_events_io);
+
+static dev_t boot_io_devs[BOOT_IO_MAX_DEVS];
+static int boot_io_ndevs;
+static DEFINE_SPINLOCK(boot_io_lock);
+
+/* sclk time minus kernel time, in us, to put both on the marker scale */
+static s64 boot_event_offset_us;
+
+static const char * const boot_event_names[] = {
+	[BOOT_EV_INITCALL]	= "initcall",
+	[BOOT_EV_PROBE]		= "probe",
+	[BOOT_EV_DEFER]		= "defer",
+	[BOOT_EV_FIRMWARE]	= "firmware",
+	[BOOT_EV_FIRST_IO]	= "first_io",
+};
+
 struct boot_marker {
 	char marker_name[BOOT_MARKER_MAX_LEN];
 	unsigned long long int timer_value;
@@ -87,6 +131,87 @@ void place_marker(const char *name)
 }
 EXPORT_SYMBOL(place_marker);
 
+void boot_event_record(enum boot_event_type type, ktime_t start, int ret,
+		const char *fmt, ...)
+{
+	struct boot_event *ev;
+	ktime_t now;
+	u64 dur;
+	va_list args;
+	int i;
+
+	if (!READ_ONCE(boot_events_on))
+		return;
+
+	now = ktime_get();
+	dur = ktime_us_delta(now, start);
+	if (dur < event_min_us && type != BOOT_EV_DEFER &&
+	    type != BOOT_EV_FIRST_IO)
+		return;
+
+	i = atomic_inc_return(&boot_event_cnt) - 1;
+	if (i >= BOOT_EVENT_MAX) {
+		WRITE_ONCE(boot_events_on, false);
+		WRITE_ONCE(boot_events_io, false);
+		return;
+	}
+
+	ev = &boot_events[i];
+	ev->start_us = ktime_to_us(start);
+	ev->dur_us = min_t(u64, dur, U32_MAX);
+	ev->ret = ret;
+	ev->type = type;
+	va_start(args, fmt);
+	vsnprintf(ev->name, sizeof(ev->name), fmt, args);
+	va_end(args);
+	/* Publish the slot only once it is filled in */
+	smp_wmb();
+	ev->valid = true;
+}
+EXPORT_SYMBOL(boot_event_record);
+
+void __boot_event_bio(struct bio *bio)
+{
+	struct gendisk *disk;
+	dev_t devt;
+	int i, n;
+
+	if (!bio->bi_bdev || !bio->bi_bdev->bd_disk)
+		return;
+
+	if (ktime_to_us(ktime_get()) > BOOT_IO_WINDOW_US) {
+		WRITE_ONCE(boot_events_io, false);
+		return;
+	}
+
+	disk = bio->bi_bdev->bd_disk;
+	devt = disk_devt(disk);
+
+	/* Lockless check first, the common case is a device already seen */
+	n = READ_ONCE(boot_io_ndevs);
+	for (i = 0; i < n; i++)
+		if (boot_io_devs[i] == devt)
+			return;
+
+	spin_lock(&boot_io_lock);
+	for (i = 0; i < boot_io_ndevs; i++)
+		if (boot_io_devs[i] == devt)
+			break;
+	if (i < boot_io_ndevs || boot_io_ndevs == BOOT_IO_MAX_DEVS) {
+		spin_unlock(&boot_io_lock);
+		return;
+	}
+	boot_io_devs[boot_io_ndevs] = devt;
+	smp_wmb();
+	WRITE_ONCE(boot_io_ndevs, boot_io_ndevs + 1);
+	spin_unlock(&boot_io_lock);
+
+	boot_event_record(BOOT_EV_FIRST_IO, ktime_get(), 0, "%s %s",
+			  disk->disk_name, bio_data_dir(bio) == WRITE ?
+			  "write" : "read");
+}
+EXPORT_SYMBOL(__boot_event_bio);
+
 static ssize_t bootkpi_reader(struct file *fp, char __user *user_buffer,
 			size_t count, loff_t *position)
 {
@@ -143,6 +268,140 @@ static const struct file_operations fops_bkpi = {
 	.write = bootkpi_writer,
 };
 
+struct timeline_ent {
+	s64 t_us;
+	u32 dur_us;
+	s32 ret;
+	const char *type;
+	const char *name;
+};
+
+struct timeline_buf {
+	char *data;
+	size_t len;
+};
+
+static int timeline_cmp(const void *a, const void *b)
+{
+	const struct timeline_ent *x = a, *y = b;
+
+	if (x->t_us == y->t_us)
+		return 0;
+	return x->t_us < y->t_us ? -1 : 1;
+}
+
+static inline s64 sclk_to_us(unsigned long long ticks)
+{
+	return div_u64(ticks * USEC_PER_SEC, TIMER_KHZ);
+}
+
+/*
+ * Merge the markers and the recorded events into one listing, sorted by
+ * start time on the sclk time base used by kpi_values.
+ */
+static int timeline_open(struct inode *inode, struct file *file)
+{
+	struct timeline_buf *tb;
+	struct timeline_ent *ents;
+	struct boot_marker *marker;
+	struct boot_event *ev;
+	size_t size, len = 0;
+	int i, n = 0, nev, nmark = 0;
+
+	tb = kzalloc(sizeof(*tb), GFP_KERNEL);
+	if (!tb)
+		return -ENOMEM;
+
+	mutex_lock(&boot_marker_list.lock);
+	list_for_each_entry(marker, &boot_marker_list.list, list)
+		nmark++;
+	nev = min(atomic_read(&boot_event_cnt), BOOT_EVENT_MAX);
+
+	ents = vmalloc((nmark + nev) * sizeof(*ents) + 1);
+	size = (nmark + nev + 1) * 128;
+	tb->data = vmalloc(size);
+	if (!ents || !tb->data) {
+		mutex_unlock(&boot_marker_list.lock);
+		vfree(ents);
+		vfree(tb->data);
+		kfree(tb);
+		return -ENOMEM;
+	}
+
+	list_for_each_entry(marker, &boot_marker_list.list, list) {
+		ents[n].t_us = sclk_to_us(marker->timer_value);
+		ents[n].dur_us = 0;
+		ents[n].ret = 0;
+		ents[n].type = "marker";
+		ents[n].name = marker->marker_name;
+		n++;
+	}
+	for (i = 0; i < nev; i++) {
+		ev = &boot_events[i];
+		if (!READ_ONCE(ev->valid))
+			continue;
+		smp_rmb();
+		ents[n].t_us = ev->start_us + boot_event_offset_us;
+		ents[n].dur_us = ev->dur_us;
+		ents[n].ret = ev->ret;
+		ents[n].type = boot_event_names[ev->type];
+		ents[n].name = ev->name;
+		n++;
+	}
+
+	sort(ents, n, sizeof(*ents), timeline_cmp, NULL);
+
+	len += scnprintf(tb->data + len, size - len,
+			 "%14s %-8s %10s %6s name\n",
+			 "time_us", "type", "dur_us", "ret");
+	for (i = 0; i < n; i++)
+		len += scnprintf(tb->data + len, size - len,
+				 "%14lld %-8s %10u %6d %s\n",
+				 ents[i].t_us, ents[i].type, ents[i].dur_us,
+				 ents[i].ret, ents[i].name);
+	mutex_unlock(&boot_marker_list.lock);
+
+	vfree(ents);
+	tb->len = len;
+	file->private_data = tb;
+	return 0;
+}
+
+static ssize_t timeline_read(struct file *fp, char __user *user_buffer,
+			size_t count, loff_t *position)
+{
+	struct timeline_buf *tb = fp->private_data;
+
+	return simple_read_from_buffer(user_buffer, count, position,
+				       tb->data, tb->len);
+}
+
+/* Any write stops recording, e.g. once userspace reports boot complete */
+static ssize_t timeline_write(struct file *fp, const char __user *user_buffer,
+			size_t count, loff_t *position)
+{
+	WRITE_ONCE(boot_events_on, false);
+	WRITE_ONCE(boot_events_io, false);
+	return count;
+}
+
+static int timeline_release(struct inode *inode, struct file *file)
+{
+	struct timeline_buf *tb = file->private_data;
+
+	vfree(tb->data);
+	kfree(tb);
+	return 0;
+}
+
+static const struct file_operations fops_timeline = {
+	.owner   = THIS_MODULE,
+	.open    = timeline_open,
+	.read    = timeline_read,
+	.write   = timeline_write,
+	.release = timeline_release,
+};
+
 static ssize_t mpm_timer_read(struct file *fp, char __user *user_buffer,
 			size_t count, loff_t *position)
 {
@@ -211,6 +470,14 @@ static int __init init_bootkpi(void)
 		return -ENODEV;
 	}
 
+	dent_timeline = debugfs_create_file("timeline",
+		S_IRUGO | S_IWUSR, dent_bkpi, NULL, &fops_timeline);
+	if (IS_ERR_OR_NULL(dent_timeline))
+		pr_err("boot_marker: Could not create 'timeline' debugfs file\n");
+
+	boot_event_offset_us = sclk_to_us(msm_timer_get_sclk_ticks()) -
+			       ktime_to_us(ktime_get());
+
 	INIT_LIST_HEAD(&boot_marker_list.list);
 	mutex_init(&boot_marker_list.lock);
 	set_bootloader_stats();
@@ -13,6 +13,7 @@
 #include <linux/err.h>
 #include <linux/fs.h>
 #include <linux/gfp.h>
+#include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/ipc_logging.h>
@@ -149,6 +150,7 @@ struct mailbox_config_info {
  *				correct irq.
  * @irq_line:			The incoming interrupt line.
  * @tx_irq_count:		Number of interrupts triggered.
+ * @tx_pkt_count:		Number of writes to @tx_fifo.
  * @rx_irq_count:		Number of interrupts received.
  * @tx_ch_desc:			Reference to the channel description structure
  *				for tx in SMEM for this edge.
@@ -169,6 +171,12 @@ struct mailbox_config_info {
  * @tx_blocked_signal_sent:	Flag to indicate the flush signal has already
  *				been sent, and a response is pending from the
  *				remote side.  Protected by @write_lock.
+ * @tx_irq_timer:		Sends a coalesced tx interrupt at the end of
+ *				the coalescing window.
+ * @tx_irq_pending:		Data was written without signalling the remote
+ *				side yet.  Protected by @write_lock.
+ * @tx_irq_armed:		@tx_irq_timer is queued or running.  Protected
+ *				by @write_lock.
  * @kwork:			Work to be executed when an irq is received.
  * @kworker:			Handle to the entity processing of
 				deferred commands.
@@ -199,6 +207,7 @@ struct edge_info {
 	uint32_t out_irq_mask;
 	uint32_t irq_line;
 	uint32_t tx_irq_count;
+	uint32_t tx_pkt_count;
 	uint32_t rx_irq_count;
 	struct channel_desc *tx_ch_desc;
 	struct channel_desc *rx_ch_desc;
@@ -212,6 +221,9 @@ struct edge_info {
 	wait_queue_head_t tx_blocked_queue;
 	bool tx_resume_needed;
 	bool tx_blocked_signal_sent;
+	struct hrtimer tx_irq_timer;
+	bool tx_irq_pending;
+	bool tx_irq_armed;
 	struct kthread_work kwork;
 	struct kthread_worker kworker;
 	struct task_struct *task;
@@ -251,6 +263,7 @@ static uint32_t negotiate_features_v1(struct glink_transport_if *if_ptr,
 				      const struct glink_core_version *version,
 				      uint32_t features);
 static void register_debugfs_info(struct edge_info *einfo);
+static uint32_t fifo_write_avail(struct edge_info *einfo);
 
 static struct edge_info *edge_infos[NUM_SMEM_SUBSYSTEMS];
 static DEFINE_MUTEX(probe_lock);
@@ -258,6 +271,15 @@ static struct glink_core_version versions[] = {
 	{1, TRACER_PKT_FEATURE, negotiate_features_v1},
 };
 
+/*
+ * Window in microseconds over which tx interrupts to the remote side are
+ * coalesced, 0 signals every write.  The interrupt is sent early once the
+ * tx fifo is half full.  The RPM edge is never coalesced.
+ */
+static unsigned long tx_irq_coalesce_us;
+module_param(tx_irq_coalesce_us, ulong, 0644);
+MODULE_PARM_DESC(tx_irq_coalesce_us, "TX interrupt coalescing window in us");
+
 /**
  * send_irq() - send an irq to a remote entity as an event signal
  * @einfo:	Which remote entity that should receive the irq.
@@ -274,6 +296,74 @@ static void send_irq(struct edge_info *einfo)
 	einfo->tx_irq_count++;
 }
 
+/**
+ * tx_irq_flush() - send any coalesced tx interrupt now
+ * @einfo:	Which remote entity that should receive the irq.
+ *
+ * Must be called with the write_lock locked.
+ */
+static void tx_irq_flush(struct edge_info *einfo)
+{
+	if (einfo->tx_irq_armed &&
+	    hrtimer_try_to_cancel(&einfo->tx_irq_timer) == 1)
+		einfo->tx_irq_armed = false;
+	einfo->tx_irq_pending = false;
+	send_irq(einfo);
+}
+
+/**
+ * tx_irq_kick() - signal the remote side that data was written
+ * @einfo:	Which remote entity that should receive the irq.
+ *
+ * Defers the interrupt by up to tx_irq_coalesce_us so that a burst of writes
+ * from several channels costs the remote side a single interrupt.  Must be
+ * called with the write_lock locked.
+ */
+static void tx_irq_kick(struct edge_info *einfo)
+{
+	einfo->tx_pkt_count++;
+	if (!tx_irq_coalesce_us || einfo->remote_proc_id == SMEM_RPM ||
+	    fifo_write_avail(einfo) < einfo->tx_fifo_size / 2) {
+		tx_irq_flush(einfo);
+		return;
+	}
+
+	einfo->tx_irq_pending = true;
+	if (!einfo->tx_irq_armed) {
+		einfo->tx_irq_armed = true;
+		hrtimer_start(&einfo->tx_irq_timer,
+			      ns_to_ktime(tx_irq_coalesce_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+}
+
+static enum hrtimer_restart tx_irq_timer_fn(struct hrtimer *timer)
+{
+	struct edge_info *einfo = container_of(timer, struct edge_info,
+					       tx_irq_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&einfo->write_lock, flags);
+	einfo->tx_irq_armed = false;
+	if (einfo->tx_irq_pending) {
+		einfo->tx_irq_pending = false;
+		send_irq(einfo);
+	}
+	spin_unlock_irqrestore(&einfo->write_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * tx_irq_init() - initialize tx interrupt coalescing for an edge
+ * @einfo:	The edge to initialize.
+ */
+static void tx_irq_init(struct edge_info *einfo)
+{
+	hrtimer_init(&einfo->tx_irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	einfo->tx_irq_timer.function = tx_irq_timer_fn;
+}
+
 /**
  * read_from_fifo() - memcpy from fifo memory
  * @dest:	Destination address.
@@ -475,6 +565,38 @@ static int fifo_read(struct edge_info *einfo, void *_data, int len)
 	return orig_len - len;
 }
 
+/**
+ * fifo_skip() - discard data from an edge without copying it
+ * @einfo:	The concerned edge to read from.
+ * @len:	The ammount of data to discard in bytes.
+ *
+ * Used for alignment padding and for payloads that have nowhere to go, which
+ * would otherwise be copied out of the FIFO only to be thrown away.
+ *
+ * Return: The number of bytes discarded.
+ */
+static int fifo_skip(struct edge_info *einfo, int len)
+{
+	uint32_t read_index = einfo->rx_ch_desc->read_index;
+	uint32_t write_index = einfo->rx_ch_desc->write_index;
+	uint32_t fifo_size = einfo->rx_fifo_size;
+	uint32_t avail;
+
+	if (read_index >= fifo_size || write_index >= fifo_size)
+		return 0;
+
+	avail = fifo_read_avail(einfo);
+	if (len > avail)
+		len = avail;
+
+	read_index += len;
+	if (read_index >= fifo_size)
+		read_index -= fifo_size;
+	einfo->rx_ch_desc->read_index = read_index;
+
+	return len;
+}
+
 /**
  * fifo_write_body() - Copy transmit data into an edge
  * @einfo:		The concerned edge to copy into.
@@ -550,7 +672,7 @@ static int fifo_write(struct edge_info *einfo, const void *data, int len)
 	 */
 	wmb();
 	einfo->tx_ch_desc->write_index = write_index;
-	send_irq(einfo);
+	tx_irq_kick(einfo);
 
 	return orig_len - len;
 }
@@ -591,7 +713,7 @@ static int fifo_write_complex(struct edge_info *einfo,
 	 */
 	wmb();
 	einfo->tx_ch_desc->write_index = write_index;
-	send_irq(einfo);
+	tx_irq_kick(einfo);
 
 	return orig_len - len1 - len2 - len3;
 }
@@ -685,7 +807,6 @@ static void process_rx_data(struct edge_info *einfo, uint16_t cmd_id,
 	};
 	struct command cmd;
 	struct glink_core_rx_intent *intent;
-	char trash[FIFO_ALIGNMENT];
 	int alignment;
 	bool err = false;
 
@@ -733,19 +854,7 @@ static void process_rx_data(struct edge_info *einfo, uint16_t cmd_id,
 	}
 
 	if (err) {
-		alignment = ALIGN(cmd.frag_size, FIFO_ALIGNMENT);
-		alignment -= cmd.frag_size;
-		while (cmd.frag_size) {
-			if (cmd.frag_size > FIFO_ALIGNMENT) {
-				fifo_read(einfo, trash, FIFO_ALIGNMENT);
-				cmd.frag_size -= FIFO_ALIGNMENT;
-			} else {
-				fifo_read(einfo, trash, cmd.frag_size);
-				cmd.frag_size = 0;
-			}
-		}
-		if (alignment)
-			fifo_read(einfo, trash, alignment);
+		fifo_skip(einfo, ALIGN(cmd.frag_size, FIFO_ALIGNMENT));
 		return;
 	}
 	fifo_read(einfo, intent->data + intent->write_offset, cmd.frag_size);
@@ -755,7 +864,7 @@ static void process_rx_data(struct edge_info *einfo, uint16_t cmd_id,
 	alignment = ALIGN(cmd.frag_size, FIFO_ALIGNMENT);
 	alignment -= cmd.frag_size;
 	if (alignment)
-		fifo_read(einfo, trash, alignment);
+		fifo_skip(einfo, alignment);
 
 	if (unlikely((cmd_id == TRACER_PKT_CMD ||
 		      cmd_id == TRACER_PKT_CONT_CMD) && !cmd.size_remaining)) {
@@ -893,7 +1002,6 @@ static void __rx_worker(struct edge_info *einfo, bool atomic_ctx)
 	uint32_t name_len;
 	uint32_t len;
 	char *name;
-	char trash[FIFO_ALIGNMENT];
 	struct deferred_cmd *d_cmd;
 	void *cmd_data;
 
@@ -981,11 +1089,7 @@ static void __rx_worker(struct edge_info *einfo, bool atomic_ctx)
 				name = kmalloc(len, GFP_ATOMIC);
 				if (!name) {
 					pr_err("No memory available to rx ch open cmd name.  Discarding cmd.\n");
-					while (len) {
-						fifo_read(einfo, trash,
-								FIFO_ALIGNMENT);
-						len -= FIFO_ALIGNMENT;
-					}
+					fifo_skip(einfo, len);
 					break;
 				}
 				fifo_read(einfo, name, len);
@@ -1527,6 +1631,9 @@ static int ssr(struct glink_transport_if *if_ptr)
 	wake_up_all(&einfo->tx_blocked_queue);
 
 	synchronize_srcu(&einfo->use_ref);
+	hrtimer_cancel(&einfo->tx_irq_timer);
+	einfo->tx_irq_armed = false;
+	einfo->tx_irq_pending = false;
 
 	while (!list_empty(&einfo->deferred_cmds)) {
 		cmd = list_first_entry(&einfo->deferred_cmds,
@@ -2394,6 +2501,7 @@ static int glink_smem_native_probe(struct platform_device *pdev)
 	init_xprt_cfg(einfo, subsys_name);
 	init_xprt_if(einfo);
 	spin_lock_init(&einfo->write_lock);
+	tx_irq_init(einfo);
 	init_waitqueue_head(&einfo->tx_blocked_queue);
 	init_kthread_work(&einfo->kwork, rx_worker);
 	init_kthread_worker(&einfo->kworker);
@@ -2596,6 +2704,7 @@ static int glink_rpm_native_probe(struct platform_device *pdev)
 	init_xprt_cfg(einfo, subsys_name);
 	init_xprt_if(einfo);
 	spin_lock_init(&einfo->write_lock);
+	tx_irq_init(einfo);
 	init_waitqueue_head(&einfo->tx_blocked_queue);
 	init_kthread_work(&einfo->kwork, rx_worker);
 	init_kthread_worker(&einfo->kworker);
@@ -2885,6 +2994,7 @@ static int glink_mailbox_probe(struct platform_device *pdev)
 	einfo->xprt_cfg.name = "mailbox";
 	init_xprt_if(einfo);
 	spin_lock_init(&einfo->write_lock);
+	tx_irq_init(einfo);
 	init_waitqueue_head(&einfo->tx_blocked_queue);
 	init_kthread_work(&einfo->kwork, rx_worker);
 	init_kthread_worker(&einfo->kworker);
@@ -3050,9 +3160,9 @@ ID|EDGE      |TX READ   |TX WRITE  |TX SIZE   |RX READ   |RX WRITE  |RX SIZE
 01|mpss      |0x00000128|0x00000128|0x00000800|0x00000256|0x00000256|0x00001000
  *
  * Interrupt information:
- * EDGE      |TX INT    |RX INT
- * --------------------------------
- * mpss      |0x00000006|0x00000008
+ * EDGE      |TX INT    |RX INT    |TX PKT
+ * -------------------------------------------
+ * mpss      |0x00000006|0x00000008|0x0000000C
  */
 	seq_puts(s, "TX/RX fifo information:\n");
 	seq_printf(s, "%2s|%-10s|%-10s|%-10s|%-10s|%-10s|%-10s|%-10s\n",
@@ -3083,11 +3193,13 @@ ID|EDGE      |TX READ   |TX WRITE  |TX SIZE   |RX READ   |RX WRITE  |RX SIZE
 						einfo->rx_fifo_size);
 
 	seq_puts(s, "\nInterrupt information:\n");
-	seq_printf(s, "%-10s|%-10s|%-10s\n", "EDGE", "TX INT", "RX INT");
-	seq_puts(s, "--------------------------------\n");
-	seq_printf(s, "%-10s|0x%08X|0x%08X\n", einfo->xprt_cfg.edge,
+	seq_printf(s, "%-10s|%-10s|%-10s|%-10s\n", "EDGE", "TX INT", "RX INT",
+								"TX PKT");
+	seq_puts(s, "-------------------------------------------\n");
+	seq_printf(s, "%-10s|0x%08X|0x%08X|0x%08X\n", einfo->xprt_cfg.edge,
 						einfo->tx_irq_count,
-						einfo->rx_irq_count);
+						einfo->rx_irq_count,
+						einfo->tx_pkt_count);
 }
 
 /**
@@ -18,6 +18,11 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/notifier.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <asm/cacheflush.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
 #include <soc/qcom/msm_qmi_interface.h>
@@ -58,6 +63,54 @@ static struct memshare_driver *memsh_drv;
 static struct memshare_child *memsh_child;
 static struct mem_blocks memblock[MAX_CLIENTS];
 static uint32_t num_clients;
+
+/*
+ * On request clients are served from a per client pool block that is
+ * allocated right after probe and zeroed again in the background when
+ * the client releases it, so that neither a modem boot nor an SSR waits
+ * for CMA migration.
+ */
+enum memshare_pool_state {
+	MEMSHARE_POOL_EMPTY,
+	MEMSHARE_POOL_READY,
+	MEMSHARE_POOL_IN_USE,
+	MEMSHARE_POOL_DIRTY,
+};
+
+static const char * const memshare_pool_state_name[] = {
+	[MEMSHARE_POOL_EMPTY]	= "empty",
+	[MEMSHARE_POOL_READY]	= "ready",
+	[MEMSHARE_POOL_IN_USE]	= "in_use",
+	[MEMSHARE_POOL_DIRTY]	= "dirty",
+};
+
+struct memshare_pool {
+	/* Size of the pool block, 0 if the client is not pooled */
+	uint32_t size;
+	enum memshare_pool_state state;
+	phys_addr_t phy_addr;
+	void *virtual_addr;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t alloc_fail;
+	uint64_t zeroed;
+	s64 zero_us_max;
+};
+
+static struct memshare_pool pool[MAX_CLIENTS];
+static DEFINE_MUTEX(pool_lock);
+static void memshare_pool_refill(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pool_work, memshare_pool_refill);
+static struct dentry *memshare_debugfs;
+
+static bool pool_enable = true;
+module_param(pool_enable, bool, S_IRUGO);
+MODULE_PARM_DESC(pool_enable, "Pre-allocate memory for on request clients");
+
+static unsigned int pool_zero_delay_ms = 1000;
+module_param(pool_zero_delay_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(pool_zero_delay_ms,
+		 "Delay before a released pool block is zeroed again");
 static struct msg_desc mem_share_svc_alloc_req_desc = {
 	.max_msg_len = MEM_ALLOC_REQ_MAX_MSG_LEN_V01,
 	.msg_id = MEM_ALLOC_REQ_MSG_V01,
@@ -235,6 +288,145 @@ void fill_alloc_response(struct mem_alloc_generic_resp_msg_v01 *resp,
 
 }
 
+static int memshare_pool_zero(struct memshare_pool *p)
+{
+	unsigned long pfn = PFN_DOWN(p->phy_addr);
+	unsigned long i, nr = PAGE_ALIGN(p->size) >> PAGE_SHIFT;
+	void *va;
+
+	if (!pfn_valid(pfn) || !pfn_valid(pfn + nr - 1))
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		va = kmap_atomic(pfn_to_page(pfn + i));
+		memset(va, 0, PAGE_SIZE);
+		dmac_flush_range(va, va + PAGE_SIZE);
+		kunmap_atomic(va);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void memshare_pool_refill(struct work_struct *work)
+{
+	struct memshare_pool *p;
+	ktime_t start;
+	s64 elapsed;
+	int i;
+
+	mutex_lock(&pool_lock);
+	for (i = 0; i < num_clients; i++) {
+		p = &pool[i];
+		if (!p->size)
+			continue;
+
+		if (p->state == MEMSHARE_POOL_DIRTY) {
+			start = ktime_get();
+			if (!memshare_pool_zero(p)) {
+				elapsed = ktime_us_delta(ktime_get(), start);
+				p->zero_us_max = max(p->zero_us_max, elapsed);
+				p->zeroed++;
+				p->state = MEMSHARE_POOL_READY;
+				continue;
+			}
+			/* No struct page to zero through, start over */
+			dma_free_attrs(memsh_drv->dev, p->size,
+				       p->virtual_addr, p->phy_addr, &attrs);
+			p->state = MEMSHARE_POOL_EMPTY;
+		}
+
+		if (p->state == MEMSHARE_POOL_EMPTY) {
+			p->virtual_addr = dma_alloc_attrs(memsh_drv->dev,
+						p->size, &p->phy_addr,
+						GFP_KERNEL, &attrs);
+			if (p->virtual_addr) {
+				p->state = MEMSHARE_POOL_READY;
+			} else {
+				p->alloc_fail++;
+				pr_err("memshare: pool allocation of %u bytes failed for client id: %d\n",
+					p->size, memblock[i].client_id);
+			}
+		}
+	}
+	mutex_unlock(&pool_lock);
+}
+
+/* Hand the pool block of client @id to @pblk if it is ready and big enough */
+static int memshare_pool_get(int id, uint32_t size, struct mem_blocks *pblk)
+{
+	struct memshare_pool *p = &pool[id];
+	int ret = -ENOMEM;
+
+	mutex_lock(&pool_lock);
+	if (p->state == MEMSHARE_POOL_READY && size <= p->size) {
+		pblk->phy_addr = p->phy_addr;
+		pblk->virtual_addr = p->virtual_addr;
+		pblk->pooled = 1;
+		p->state = MEMSHARE_POOL_IN_USE;
+		p->hits++;
+		ret = 0;
+	} else if (p->size) {
+		p->misses++;
+	}
+	mutex_unlock(&pool_lock);
+
+	return ret;
+}
+
+/* Give the memory of client @id back to its pool or to the DMA allocator */
+static void memshare_release(int id)
+{
+	struct mem_blocks *blk = &memblock[id];
+
+	if (!blk->pooled) {
+		dma_free_attrs(memsh_drv->dev, blk->size, blk->virtual_addr,
+			       blk->phy_addr, &attrs);
+		return;
+	}
+
+	mutex_lock(&pool_lock);
+	pool[id].state = MEMSHARE_POOL_DIRTY;
+	mutex_unlock(&pool_lock);
+	blk->pooled = 0;
+	queue_delayed_work(system_unbound_wq, &pool_work,
+			   msecs_to_jiffies(pool_zero_delay_ms));
+}
+
+static int memshare_pool_show(struct seq_file *s, void *unused)
+{
+	struct memshare_pool *p;
+	int i;
+
+	seq_puts(s, "client size state hits misses alloc_fail zeroed zero_us_max\n");
+	mutex_lock(&pool_lock);
+	for (i = 0; i < num_clients; i++) {
+		p = &pool[i];
+		if (!p->size)
+			continue;
+		seq_printf(s, "%u %u %s %llu %llu %llu %llu %lld\n",
+			   memblock[i].client_id, p->size,
+			   memshare_pool_state_name[p->state], p->hits,
+			   p->misses, p->alloc_fail, p->zeroed,
+			   p->zero_us_max);
+	}
+	mutex_unlock(&pool_lock);
+
+	return 0;
+}
+
+static int memshare_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, memshare_pool_show, NULL);
+}
+
+static const struct file_operations memshare_pool_fops = {
+	.open		= memshare_pool_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void initialize_client(void)
 {
 	int i;
@@ -252,6 +444,7 @@ void initialize_client(void)
 		memblock[i].free_memory = 0;
 		memblock[i].hyp_mapping = 0;
 		memblock[i].file_created = 0;
+		memblock[i].pooled = 0;
 	}
 	dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &attrs);
 }
@@ -399,11 +592,7 @@ static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 					} else {
 						memblock[i].hyp_mapping = 0;
 					}
-					dma_free_attrs(memsh_drv->dev,
-						memblock[i].size,
-						memblock[i].virtual_addr,
-						memblock[i].phy_addr,
-						&attrs);
+					memshare_release(i);
 					free_client(i);
 				}
 			}
@@ -531,7 +720,9 @@ static int handle_alloc_generic_req(void *req_h, void *req, void *conn_h)
 			size = alloc_req->num_bytes + MEMSHARE_GUARD_BYTES;
 		else
 			size = alloc_req->num_bytes;
-		rc = memshare_alloc(memsh_drv->dev, size,
+		rc = memshare_pool_get(client_id, size, &memblock[client_id]);
+		if (rc)
+			rc = memshare_alloc(memsh_drv->dev, size,
 					&memblock[client_id]);
 		if (rc) {
 			pr_err("In %s,Unable to allocate memory for requested client\n",
@@ -637,10 +828,7 @@ static int handle_free_generic_req(void *req_h, void *req, void *conn_h)
 		pr_debug("memshare: %s: client_id:%d, size: %d",
 				__func__, client_id,
 				memblock[client_id].size);
-		dma_free_attrs(memsh_drv->dev, memblock[client_id].size,
-			memblock[client_id].virtual_addr,
-			memblock[client_id].phy_addr,
-			&attrs);
+		memshare_release(client_id);
 		free_client(client_id);
 	} else {
 		pr_err("In %s, Request came for a guaranteed client(client_id: %d) cannot free up the memory\n",
@@ -969,6 +1157,14 @@ static int memshare_child_probe(struct platform_device *pdev)
 	memblock[num_clients].size = size;
 	memblock[num_clients].client_id = client_id;
 
+	if (pool_enable && memblock[num_clients].client_request &&
+			!memblock[num_clients].guarantee && size > 0) {
+		pool[num_clients].size = size;
+		if (client_id == 1)
+			pool[num_clients].size += MEMSHARE_GUARD_BYTES;
+		queue_delayed_work(system_unbound_wq, &pool_work, 0);
+	}
+
   /*
    *	Memshare allocation for guaranteed clients
    */
@@ -1043,6 +1239,12 @@ static int memshare_probe(struct platform_device *pdev)
 	}
 
 	subsys_notif_register_notifier("modem", &nb);
+
+	memshare_debugfs = debugfs_create_dir("memshare", NULL);
+	if (!IS_ERR_OR_NULL(memshare_debugfs))
+		debugfs_create_file("pool", S_IRUGO, memshare_debugfs, NULL,
+				    &memshare_pool_fops);
+
 	pr_info("In %s, Memshare probe success\n", __func__);
 
 	return 0;
@@ -1053,6 +1255,8 @@ static int memshare_remove(struct platform_device *pdev)
 	if (!memsh_drv)
 		return 0;
 
+	debugfs_remove_recursive(memshare_debugfs);
+	cancel_delayed_work_sync(&pool_work);
 	qmi_svc_unregister(mem_share_svc_handle);
 	flush_workqueue(mem_share_svc_workqueue);
 	qmi_handle_destroy(mem_share_svc_handle);
@@ -56,6 +56,8 @@ struct mem_blocks {
 	uint8_t hyp_mapping;
 	/* Status flag which checks if ramdump file is created*/
 	int file_created;
+	/* Memory was handed out from the client's pool */
+	uint8_t pooled;
 
 };
 
@@ -15,6 +15,7 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/rtmutex.h>
+#include <linux/workqueue.h>
 #include <linux/clk.h>
 #include <linux/msm-bus.h>
 #include "msm_bus_core.h"
@@ -42,6 +43,20 @@ static LIST_HEAD(commit_list);
 
 DEFINE_RT_MUTEX(msm_bus_adhoc_lock);
 
+/*
+ * Commit coalescing. Path aggregates are always updated at vote time, but
+ * inside a msm_bus_scale_batch_begin()/end() section, or for votes that
+ * only lower bandwidth while coalesce_ms is set, the commit to the RPM is
+ * deferred so that the clients voting at a frame boundary share one.
+ */
+static unsigned int coalesce_ms;
+module_param(coalesce_ms, uint, 0644);
+
+static unsigned int batch_depth;
+static bool commit_pending;
+static void commit_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(commit_work, commit_work_fn);
+
 static bool chk_bl_list(struct list_head *black_list, unsigned int id)
 {
 	struct msm_bus_node_device_type *bus_node = NULL;
@@ -649,10 +664,12 @@ static int msm_bus_apply_rules(struct list_head *list, bool after_clk_commit)
 	return ret;
 }
 
-static void commit_data(void)
+static void __commit_data(void)
 {
 	bool rules_registered = msm_rule_are_rules_registered();
 
+	commit_pending = false;
+
 	if (rules_registered) {
 		msm_rules_update_path(&input_list, &apply_list);
 		msm_bus_apply_rules(&apply_list, false);
@@ -670,6 +687,34 @@ static void commit_data(void)
 	INIT_LIST_HEAD(&commit_list);
 }
 
+/* Returns true if the commit was deferred. */
+static bool commit_data(bool may_defer)
+{
+	if (batch_depth) {
+		commit_pending = true;
+		return true;
+	}
+
+	if (may_defer && coalesce_ms) {
+		commit_pending = true;
+		schedule_delayed_work(&commit_work,
+				      msecs_to_jiffies(coalesce_ms));
+		return true;
+	}
+
+	/* Also carries any deferred votes still on the commit list */
+	__commit_data();
+	return false;
+}
+
+static void commit_work_fn(struct work_struct *work)
+{
+	rt_mutex_lock(&msm_bus_adhoc_lock);
+	if (commit_pending && !batch_depth)
+		__commit_data();
+	rt_mutex_unlock(&msm_bus_adhoc_lock);
+}
+
 static void add_node_to_clist(struct msm_bus_node_device_type *node)
 {
 	struct msm_bus_node_device_type *node_parent =
@@ -899,7 +944,7 @@ static void unregister_client_adhoc(uint32_t cl)
 		remove_path(src_dev, dest, cur_clk, cur_bw, lnode,
 						pdata->active_only);
 	}
-	commit_data();
+	commit_data(false);
 	msm_bus_dbg_client_data(client->pdata, MSM_BUS_DBG_UNREGISTER, cl);
 	kfree(client->src_pnode);
 	kfree(client->src_devs);
@@ -1053,11 +1098,12 @@ exit_register_client:
 }
 
 static int update_client_paths(struct msm_bus_client *client, bool log_trns,
-							unsigned int idx)
+					unsigned int idx, bool *deferred)
 {
 	int lnode, src, dest, cur_idx;
 	uint64_t req_clk, req_bw, curr_clk, curr_bw, slp_clk, slp_bw;
 	int i, ret = 0;
+	bool lower = true;
 	struct msm_bus_scale_pdata *pdata;
 	struct device *src_dev;
 
@@ -1103,6 +1149,9 @@ static int update_client_paths(struct msm_bus_client *client, bool log_trns,
 			slp_bw = req_bw;
 		}
 
+		if (req_clk > curr_clk || req_bw > curr_bw)
+			lower = false;
+
 		ret = update_path(src_dev, dest, req_clk, req_bw, slp_clk,
 			slp_bw, curr_clk, curr_bw, lnode, pdata->active_only);
 
@@ -1115,7 +1164,7 @@ static int update_client_paths(struct msm_bus_client *client, bool log_trns,
 		if (log_trns)
 			getpath_debug(src, lnode, pdata->active_only);
 	}
-	commit_data();
+	*deferred = commit_data(lower);
 exit_update_client_paths:
 	return ret;
 }
@@ -1126,6 +1175,7 @@ static int update_context(uint32_t cl, bool active_only,
 	int ret = 0;
 	struct msm_bus_scale_pdata *pdata;
 	struct msm_bus_client *client;
+	bool deferred;
 
 	rt_mutex_lock(&msm_bus_adhoc_lock);
 	if (!cl) {
@@ -1162,7 +1212,7 @@ static int update_context(uint32_t cl, bool active_only,
 	pdata->active_only = active_only;
 
 	msm_bus_dbg_client_data(client->pdata, ctx_idx , cl);
-	ret = update_client_paths(client, false, ctx_idx);
+	ret = update_client_paths(client, false, ctx_idx, &deferred);
 	if (ret) {
 		pr_err("%s: Err updating path\n", __func__);
 		goto exit_update_context;
@@ -1182,6 +1232,8 @@ static int update_request_adhoc(uint32_t cl, unsigned int index)
 	struct msm_bus_client *client;
 	const char *test_cl = "Null";
 	bool log_transaction = false;
+	bool deferred = false;
+	ktime_t start = ktime_get();
 
 	rt_mutex_lock(&msm_bus_adhoc_lock);
 
@@ -1225,13 +1277,15 @@ static int update_request_adhoc(uint32_t cl, unsigned int index)
 	MSM_BUS_DBG("%s: cl: %u index: %d curr: %d num_paths: %d\n", __func__,
 		cl, index, client->curr, client->pdata->usecase->num_paths);
 	msm_bus_dbg_client_data(client->pdata, index , cl);
-	ret = update_client_paths(client, log_transaction, index);
+	ret = update_client_paths(client, log_transaction, index, &deferred);
 	if (ret) {
 		pr_err("%s: Err updating path\n", __func__);
 		goto exit_update_request;
 	}
 
 	trace_bus_update_request_end(pdata->name);
+	msm_bus_dbg_vote_latency(cl, NULL,
+				 ktime_us_delta(ktime_get(), start), deferred);
 
 exit_update_request:
 	rt_mutex_unlock(&msm_bus_adhoc_lock);
@@ -1252,7 +1306,9 @@ static int update_bw_adhoc(struct msm_bus_client_handle *cl, u64 ab, u64 ib)
 	int ret = 0;
 	char *test_cl = "test-client";
 	bool log_transaction = false;
+	bool deferred;
 	u64 slp_ib, slp_ab;
+	ktime_t start = ktime_get();
 
 	rt_mutex_lock(&msm_bus_adhoc_lock);
 
@@ -1289,7 +1345,7 @@ static int update_bw_adhoc(struct msm_bus_client_handle *cl, u64 ab, u64 ib)
 		goto exit_update_request;
 	}
 
-	commit_data();
+	deferred = commit_data(ib <= cl->cur_act_ib && ab <= cl->cur_act_ab);
 	cl->cur_act_ib = ib;
 	cl->cur_act_ab = ab;
 	cl->cur_slp_ib = slp_ib;
@@ -1298,6 +1354,8 @@ static int update_bw_adhoc(struct msm_bus_client_handle *cl, u64 ab, u64 ib)
 	if (log_transaction)
 		getpath_debug(cl->mas, cl->first_hop, cl->active_only);
 	trace_bus_update_request_end(cl->name);
+	msm_bus_dbg_vote_latency(0, cl, ktime_us_delta(ktime_get(), start),
+				 deferred);
 exit_update_request:
 	rt_mutex_unlock(&msm_bus_adhoc_lock);
 
@@ -1335,7 +1393,8 @@ static int update_bw_context(struct msm_bus_client_handle *cl, u64 act_ab,
 				__func__, ret, cl->active_only);
 		goto exit_change_context;
 	}
-	commit_data();
+	commit_data(act_ib <= cl->cur_act_ib && act_ab <= cl->cur_act_ab &&
+		    slp_ib <= cl->cur_slp_ib && slp_ab <= cl->cur_slp_ab);
 	cl->cur_act_ib = act_ib;
 	cl->cur_act_ab = act_ab;
 	cl->cur_slp_ib = slp_ib;
@@ -1359,7 +1418,7 @@ static void unregister_adhoc(struct msm_bus_client_handle *cl)
 
 	remove_path(cl->mas_dev, cl->slv, cl->cur_act_ib, cl->cur_act_ab,
 				cl->first_hop, cl->active_only);
-	commit_data();
+	commit_data(false);
 	msm_bus_dbg_remove_client(cl);
 	kfree(cl->name);
 	kfree(cl);
@@ -1426,6 +1485,27 @@ exit_register:
 	rt_mutex_unlock(&msm_bus_adhoc_lock);
 	return client;
 }
+static void batch_begin_adhoc(void)
+{
+	rt_mutex_lock(&msm_bus_adhoc_lock);
+	batch_depth++;
+	rt_mutex_unlock(&msm_bus_adhoc_lock);
+}
+
+static void batch_end_adhoc(void)
+{
+	rt_mutex_lock(&msm_bus_adhoc_lock);
+	if (WARN_ON(!batch_depth))
+		goto exit_batch_end;
+
+	if (!--batch_depth && commit_pending) {
+		cancel_delayed_work(&commit_work);
+		__commit_data();
+	}
+exit_batch_end:
+	rt_mutex_unlock(&msm_bus_adhoc_lock);
+}
+
 /**
  *  msm_bus_arb_setops_adhoc() : Setup the bus arbitration ops
  *  @ arb_ops: pointer to the arb ops.
@@ -1441,4 +1521,6 @@ void msm_bus_arb_setops_adhoc(struct msm_bus_arb_ops *arb_ops)
 	arb_ops->unregister = unregister_adhoc;
 	arb_ops->update_bw = update_bw_adhoc;
 	arb_ops->update_bw_context = update_bw_context;
+	arb_ops->batch_begin = batch_begin_adhoc;
+	arb_ops->batch_end = batch_end_adhoc;
 }
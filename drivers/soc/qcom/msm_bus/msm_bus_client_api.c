@@ -182,3 +182,27 @@ void msm_bus_scale_unregister(struct msm_bus_client_handle *cl)
 				__func__);
 }
 EXPORT_SYMBOL(msm_bus_scale_unregister);
+
+/**
+ * msm_bus_scale_batch_begin() - Start a batch of bandwidth votes
+ *
+ * Votes made by any client until the matching msm_bus_scale_batch_end()
+ * are aggregated right away but committed to the RPM together at the end.
+ * Batches nest.
+ */
+void msm_bus_scale_batch_begin(void)
+{
+	if (arb_ops.batch_begin)
+		arb_ops.batch_begin();
+}
+EXPORT_SYMBOL(msm_bus_scale_batch_begin);
+
+/**
+ * msm_bus_scale_batch_end() - Commit the votes of a batch
+ */
+void msm_bus_scale_batch_end(void)
+{
+	if (arb_ops.batch_end)
+		arb_ops.batch_end();
+}
+EXPORT_SYMBOL(msm_bus_scale_batch_end);
@@ -69,6 +69,8 @@ struct msm_bus_arb_ops {
 	void (*unregister)(struct msm_bus_client_handle *cl);
 	int (*update_bw_context)(struct msm_bus_client_handle *cl, u64 act_ab,
 				u64 act_ib, u64 slp_ib, u64 slp_ab);
+	void (*batch_begin)(void);
+	void (*batch_end)(void);
 };
 
 enum {
@@ -331,6 +333,9 @@ int msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata);
 int msm_bus_dbg_rec_transaction(const struct msm_bus_client_handle *pdata,
 						u64 ab, u64 ib);
 void msm_bus_dbg_remove_client(const struct msm_bus_client_handle *pdata);
+void msm_bus_dbg_vote_latency(uint32_t clid,
+		const struct msm_bus_client_handle *handle, u64 us,
+		bool deferred);
 
 #else
 static inline void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata,
@@ -359,6 +364,12 @@ msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata)
 {
 	return 0;
 }
+
+static inline void msm_bus_dbg_vote_latency(uint32_t clid,
+		const struct msm_bus_client_handle *handle, u64 us,
+		bool deferred)
+{
+}
 #endif
 
 #ifdef CONFIG_CORESIGHT
@@ -52,6 +52,10 @@ struct msm_bus_cldata {
 	int size;
 	struct dentry *file;
 	struct list_head list;
+	u64 votes;
+	u64 deferred;
+	u64 total_us;
+	u64 max_us;
 	char buffer[MAX_BUFF_SIZE];
 };
 
@@ -430,12 +434,94 @@ void msm_bus_dbg_remove_client(const struct msm_bus_client_handle *pdata)
 	rt_mutex_unlock(&msm_bus_dbg_cllist_lock);
 }
 
+/**
+ * msm_bus_dbg_vote_latency() - Account the time a client's vote took
+ * @clid: Client handle of a legacy client, 0 otherwise
+ * @handle: Client handle of a msm_bus_scale_register() client, or NULL
+ * @us: Time from the vote request to its commit, or to its deferral
+ * @deferred: The commit was left to a batch or to the coalescing window
+ */
+void msm_bus_dbg_vote_latency(uint32_t clid,
+		const struct msm_bus_client_handle *handle, u64 us,
+		bool deferred)
+{
+	struct msm_bus_cldata *cldata;
+
+	rt_mutex_lock(&msm_bus_dbg_cllist_lock);
+	list_for_each_entry(cldata, &cl_list, list) {
+		if ((clid && cldata->clid == clid && cldata->pdata) ||
+		    (handle && cldata->handle == handle)) {
+			cldata->votes++;
+			cldata->deferred += deferred;
+			cldata->total_us += us;
+			if (us > cldata->max_us)
+				cldata->max_us = us;
+			break;
+		}
+	}
+	rt_mutex_unlock(&msm_bus_dbg_cllist_lock);
+}
+
+static int msm_bus_dbg_vote_latency_show(struct seq_file *s, void *unused)
+{
+	struct msm_bus_cldata *cldata;
+	const char *name;
+
+	seq_puts(s, "client                    votes  deferred   avg_us   max_us\n");
+	rt_mutex_lock(&msm_bus_dbg_cllist_lock);
+	list_for_each_entry(cldata, &cl_list, list) {
+		if (!cldata->votes)
+			continue;
+		name = cldata->pdata ? cldata->pdata->name :
+			cldata->handle ? cldata->handle->name : NULL;
+		seq_printf(s, "%-20s %10llu %9llu %8llu %8llu\n",
+			   name ? name : "unknown", cldata->votes,
+			   cldata->deferred,
+			   div64_u64(cldata->total_us, cldata->votes),
+			   cldata->max_us);
+	}
+	rt_mutex_unlock(&msm_bus_dbg_cllist_lock);
+
+	return 0;
+}
+
+static int msm_bus_dbg_vote_latency_open(struct inode *inode,
+		struct file *file)
+{
+	return single_open(file, msm_bus_dbg_vote_latency_show, NULL);
+}
+
+static ssize_t msm_bus_dbg_vote_latency_write(struct file *file,
+	const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct msm_bus_cldata *cldata;
+
+	rt_mutex_lock(&msm_bus_dbg_cllist_lock);
+	list_for_each_entry(cldata, &cl_list, list) {
+		cldata->votes = 0;
+		cldata->deferred = 0;
+		cldata->total_us = 0;
+		cldata->max_us = 0;
+	}
+	rt_mutex_unlock(&msm_bus_dbg_cllist_lock);
+
+	return cnt;
+}
+
+static const struct file_operations msm_bus_dbg_vote_latency_fops = {
+	.open		= msm_bus_dbg_vote_latency_open,
+	.read		= seq_read,
+	.write		= msm_bus_dbg_vote_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int msm_bus_dbg_record_client(const struct msm_bus_scale_pdata *pdata,
 	int index, uint32_t clid, struct dentry *file)
 {
 	struct msm_bus_cldata *cldata;
 
-	cldata = kmalloc(sizeof(struct msm_bus_cldata), GFP_KERNEL);
+	cldata = kzalloc(sizeof(struct msm_bus_cldata), GFP_KERNEL);
 	if (!cldata) {
 		MSM_BUS_DBG("Failed to allocate memory for client data\n");
 		return -ENOMEM;
@@ -947,6 +1033,10 @@ static int __init msm_bus_debugfs_init(void)
 		clients, NULL, &msm_bus_dbg_dump_clients_fops) == NULL)
 		goto err;
 
+	if (debugfs_create_file("vote_latency", S_IRUGO | S_IWUSR,
+		clients, NULL, &msm_bus_dbg_vote_latency_fops) == NULL)
+		goto err;
+
 	mutex_lock(&msm_bus_dbg_fablist_lock);
 	list_for_each_entry(fablist, &fabdata_list, list) {
 		fablist->file = debugfs_create_file(fablist->name, S_IRUGO,
@@ -25,6 +25,14 @@
 #include <linux/module.h>
 #include <linux/input.h>
 #include <linux/kthread.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/miscdevice.h>
+#include <linux/msm-bus.h>
+#include <linux/msm-bus-board.h>
+#include <linux/pm_qos.h>
+#include <linux/uaccess.h>
+#include <linux/msm_perf_hint.h>
 
 static unsigned int use_input_evts_with_hi_slvt_detect;
 static struct mutex managed_cpus_lock;
@@ -106,6 +114,9 @@ struct delayed_work evaluate_hotplug_work;
 struct cpu_status {
 	unsigned int min;
 	unsigned int max;
+	/* aggregate of the active hint bundles */
+	unsigned int hint_min;
+	unsigned int hint_max;
 };
 static DEFINE_PER_CPU(struct cpu_status, cpu_stats);
 
@@ -1584,7 +1595,8 @@ static int perf_adjust_notify(struct notifier_block *nb, unsigned long val,
 	struct cpufreq_policy *policy = data;
 	unsigned int cpu = policy->cpu;
 	struct cpu_status *cpu_st = &per_cpu(cpu_stats, cpu);
-	unsigned int min = cpu_st->min, max = cpu_st->max;
+	unsigned int min = max(cpu_st->min, cpu_st->hint_min);
+	unsigned int max = min(cpu_st->max, cpu_st->hint_max);
 
 
 	if (val != CPUFREQ_ADJUST)
@@ -2772,6 +2784,248 @@ static int init_events_group(void)
 	return 0;
 }
 
+/*
+ * Hint bundles. A perf HAL submits all the limits of a boost (cluster
+ * frequency floors and ceilings, an idle latency constraint, a CPU to DDR
+ * bandwidth vote and sched boost) in one ioctl on /dev/msm_perf, instead of
+ * one sysfs write per knob. Each bundle is held until it is released, its
+ * duration expires or the file it was submitted on is closed. The limits
+ * of all active bundles are aggregated: highest floor, lowest ceiling,
+ * tightest latency and largest bandwidth vote.
+ */
+struct perf_hint {
+	struct list_head node;
+	int handle;
+	struct file *owner;
+	struct msm_perf_hint_req req;
+	struct delayed_work expire;
+};
+
+static LIST_HEAD(perf_hints);
+static DEFINE_MUTEX(perf_hint_lock);
+static DEFINE_IDR(perf_hint_idr);
+static struct pm_qos_request perf_hint_qos;
+static struct msm_bus_client_handle *perf_hint_bus;
+static bool perf_hint_boosted;
+
+static void perf_hint_apply(void)
+{
+	struct perf_hint *hint;
+	struct msm_perf_freq_hint *f;
+	struct cpufreq_policy policy;
+	struct cpu_status *st;
+	unsigned int old_min[NR_CPUS], old_max[NR_CPUS];
+	s32 latency = PM_QOS_DEFAULT_VALUE;
+	u64 ab = 0, ib = 0;
+	bool boost = false;
+	cpumask_t update;
+	int cpu, i, j;
+
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(cpu_stats, cpu);
+		old_min[cpu] = st->hint_min;
+		old_max[cpu] = st->hint_max;
+		st->hint_min = 0;
+		st->hint_max = UINT_MAX;
+	}
+
+	list_for_each_entry(hint, &perf_hints, node) {
+		for (i = 0; i < hint->req.nr_freq; i++) {
+			f = &hint->req.freq[i];
+			if (cpufreq_get_policy(&policy, f->cpu))
+				continue;
+			for_each_cpu(j, policy.related_cpus) {
+				st = &per_cpu(cpu_stats, j);
+				st->hint_min = max(st->hint_min, f->min_freq);
+				if (f->max_freq)
+					st->hint_max = min(st->hint_max,
+							   f->max_freq);
+			}
+		}
+		if (hint->req.idle_latency_us &&
+		    (latency == PM_QOS_DEFAULT_VALUE ||
+		     hint->req.idle_latency_us < (u32)latency))
+			latency = hint->req.idle_latency_us;
+		ab = max(ab, hint->req.bus_ab);
+		ib = max(ib, hint->req.bus_ib);
+		boost |= !!(hint->req.flags & MSM_PERF_HINT_SCHED_BOOST);
+	}
+
+	pm_qos_update_request(&perf_hint_qos, latency);
+
+	if ((ab || ib) && !perf_hint_bus)
+		perf_hint_bus = msm_bus_scale_register(MSM_BUS_MASTER_AMPSS_M0,
+				MSM_BUS_SLAVE_EBI_CH0, "msm_perf_hint", false);
+	if (!IS_ERR_OR_NULL(perf_hint_bus))
+		msm_bus_scale_update_bw(perf_hint_bus, ab, ib);
+
+	if (boost != perf_hint_boosted && !sched_set_boost(boost))
+		perf_hint_boosted = boost;
+
+	cpumask_clear(&update);
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(cpu_stats, cpu);
+		if (st->hint_min != old_min[cpu] ||
+		    st->hint_max != old_max[cpu])
+			cpumask_set_cpu(cpu, &update);
+	}
+
+	/* one policy update per cluster, as for cpu_min_freq */
+	get_online_cpus();
+	for_each_cpu(cpu, &update) {
+		if (cpufreq_get_policy(&policy, cpu))
+			continue;
+		if (cpu_online(cpu))
+			cpufreq_update_policy(cpu);
+		cpumask_andnot(&update, &update, policy.related_cpus);
+	}
+	put_online_cpus();
+}
+
+/* Called with perf_hint_lock held, the caller frees the hint */
+static void perf_hint_remove(struct perf_hint *hint)
+{
+	idr_remove(&perf_hint_idr, hint->handle);
+	list_del(&hint->node);
+	perf_hint_apply();
+}
+
+static void perf_hint_expire(struct work_struct *work)
+{
+	struct perf_hint *hint = container_of(to_delayed_work(work),
+					struct perf_hint, expire);
+
+	mutex_lock(&perf_hint_lock);
+	/* a concurrent release owns the hint once it is out of the idr */
+	if (idr_find(&perf_hint_idr, hint->handle) != hint) {
+		mutex_unlock(&perf_hint_lock);
+		return;
+	}
+	perf_hint_remove(hint);
+	mutex_unlock(&perf_hint_lock);
+	kfree(hint);
+}
+
+static int perf_hint_acquire(struct file *file, void __user *arg)
+{
+	struct perf_hint *hint;
+	int i, ret;
+
+	hint = kzalloc(sizeof(*hint), GFP_KERNEL);
+	if (!hint)
+		return -ENOMEM;
+	if (copy_from_user(&hint->req, arg, sizeof(hint->req))) {
+		ret = -EFAULT;
+		goto fail;
+	}
+	if (hint->req.nr_freq > MSM_PERF_HINT_MAX_FREQ) {
+		ret = -EINVAL;
+		goto fail;
+	}
+	for (i = 0; i < hint->req.nr_freq; i++) {
+		if (hint->req.freq[i].cpu >= nr_cpu_ids ||
+		    !cpu_possible(hint->req.freq[i].cpu)) {
+			ret = -EINVAL;
+			goto fail;
+		}
+	}
+	hint->owner = file;
+	INIT_DELAYED_WORK(&hint->expire, perf_hint_expire);
+
+	mutex_lock(&perf_hint_lock);
+	ret = idr_alloc(&perf_hint_idr, hint, 1, 0, GFP_KERNEL);
+	if (ret < 0) {
+		mutex_unlock(&perf_hint_lock);
+		goto fail;
+	}
+	hint->handle = hint->req.handle = ret;
+	list_add_tail(&hint->node, &perf_hints);
+	perf_hint_apply();
+	if (hint->req.duration_ms)
+		schedule_delayed_work(&hint->expire,
+			msecs_to_jiffies(hint->req.duration_ms));
+	mutex_unlock(&perf_hint_lock);
+
+	/* the hint is in effect, a failed copy only loses the handle */
+	if (copy_to_user(arg, &hint->req, sizeof(hint->req)))
+		return -EFAULT;
+	return 0;
+
+fail:
+	kfree(hint);
+	return ret;
+}
+
+static int perf_hint_release(struct file *file, int handle)
+{
+	struct perf_hint *hint;
+
+	mutex_lock(&perf_hint_lock);
+	hint = idr_find(&perf_hint_idr, handle);
+	if (!hint || hint->owner != file) {
+		mutex_unlock(&perf_hint_lock);
+		return -EINVAL;
+	}
+	perf_hint_remove(hint);
+	mutex_unlock(&perf_hint_lock);
+
+	cancel_delayed_work_sync(&hint->expire);
+	kfree(hint);
+	return 0;
+}
+
+static long msm_perf_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	int handle;
+
+	switch (cmd) {
+	case MSM_PERF_IOC_HINT_ACQUIRE:
+		return perf_hint_acquire(file, (void __user *)arg);
+	case MSM_PERF_IOC_HINT_RELEASE:
+		if (get_user(handle, (int __user *)arg))
+			return -EFAULT;
+		return perf_hint_release(file, handle);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int msm_perf_release(struct inode *inode, struct file *file)
+{
+	struct perf_hint *hint, *tmp;
+	LIST_HEAD(dropped);
+
+	mutex_lock(&perf_hint_lock);
+	list_for_each_entry_safe(hint, tmp, &perf_hints, node) {
+		if (hint->owner != file)
+			continue;
+		idr_remove(&perf_hint_idr, hint->handle);
+		list_move(&hint->node, &dropped);
+	}
+	perf_hint_apply();
+	mutex_unlock(&perf_hint_lock);
+
+	list_for_each_entry_safe(hint, tmp, &dropped, node) {
+		cancel_delayed_work_sync(&hint->expire);
+		kfree(hint);
+	}
+	return 0;
+}
+
+static const struct file_operations msm_perf_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= msm_perf_ioctl,
+	.compat_ioctl	= msm_perf_ioctl,
+	.release	= msm_perf_release,
+};
+
+static struct miscdevice msm_perf_miscdev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "msm_perf",
+	.fops	= &msm_perf_fops,
+};
+
 static int __init msm_performance_init(void)
 {
 	unsigned int cpu;
@@ -2783,11 +3037,18 @@ static int __init msm_performance_init(void)
 
 	for_each_present_cpu(cpu)
 		per_cpu(cpu_stats, cpu).max = UINT_MAX;
+	for_each_possible_cpu(cpu)
+		per_cpu(cpu_stats, cpu).hint_max = UINT_MAX;
 
 	register_cpu_notifier(&msm_performance_cpu_notifier);
 
 	init_events_group();
 
+	pm_qos_add_request(&perf_hint_qos, PM_QOS_CPU_DMA_LATENCY,
+			PM_QOS_DEFAULT_VALUE);
+	if (misc_register(&msm_perf_miscdev))
+		pr_err("msm_perf: Unable to register hint device\n");
+
 	return 0;
 }
 late_initcall(msm_performance_init);
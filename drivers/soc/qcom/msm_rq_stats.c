@@ -29,6 +29,8 @@
 #include <linux/tick.h>
 #include <asm/smp_plat.h>
 #include <linux/suspend.h>
+#include <linux/timer.h>
+#include <linux/vmalloc.h>
 
 #define MAX_LONG_SIZE 24
 #define DEFAULT_RQ_POLL_JIFFIES 1
@@ -47,10 +49,85 @@ struct cpu_load_data {
 	unsigned int policy_max;
 	cpumask_var_t related_cpus;
 	struct mutex cpu_load_mutex;
+	/* sampler state */
+	u64 prev_time_us[RQ_CLASS_NR];
+	struct rq_stats_record last;
 };
 
 static DEFINE_PER_CPU(struct cpu_load_data, cpuload);
 
+/*
+ * Sampler: every sample_ms, on a deferrable timer, record for each online
+ * CPU the time it spent in each class since its last sample, its frequency
+ * and iowait depth, together with the system wide run-queue depth, into a
+ * ring that cpu0/rq-stats/history returns in binary, oldest first.
+ */
+static unsigned int sample_ms;
+static struct timer_list sample_timer;
+static struct rq_stats_record *sample_ring;
+static unsigned int sample_wr_idx;
+static DEFINE_SPINLOCK(sample_lock);
+
+static u64 rq_stats_idle_us(int cpu, bool iowait)
+{
+	u64 t = -1ULL;
+
+	if (cpu_online(cpu))
+		t = iowait ? get_cpu_iowait_time_us(cpu, NULL) :
+			get_cpu_idle_time_us(cpu, NULL);
+	if (t == -1ULL)
+		t = cputime_to_usecs(kcpustat_cpu(cpu).cpustat[iowait ?
+					CPUTIME_IOWAIT : CPUTIME_IDLE]);
+	return t;
+}
+
+static void rq_stats_read_times(int cpu, u64 *t)
+{
+	u64 *cs = kcpustat_cpu(cpu).cpustat;
+
+	t[RQ_CLASS_USER] = cputime_to_usecs(cs[CPUTIME_USER] +
+					    cs[CPUTIME_NICE]);
+	t[RQ_CLASS_SYSTEM] = cputime_to_usecs(cs[CPUTIME_SYSTEM]);
+	t[RQ_CLASS_IRQ] = cputime_to_usecs(cs[CPUTIME_IRQ]);
+	t[RQ_CLASS_SOFTIRQ] = cputime_to_usecs(cs[CPUTIME_SOFTIRQ]);
+	t[RQ_CLASS_IOWAIT] = rq_stats_idle_us(cpu, true);
+	t[RQ_CLASS_IDLE] = rq_stats_idle_us(cpu, false);
+}
+
+static void rq_stats_sample(unsigned long data)
+{
+	struct cpu_load_data *pcpu;
+	struct rq_stats_record *rec;
+	u64 now = ktime_get_ns(), t[RQ_CLASS_NR];
+	unsigned long flags;
+	u32 nr = nr_running();
+	int cpu, i;
+
+	spin_lock_irqsave(&sample_lock, flags);
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuload, cpu);
+		rq_stats_read_times(cpu, t);
+
+		rec = &sample_ring[sample_wr_idx++ & (RQ_STATS_NR_RECORDS - 1)];
+		rec->ts_ns = now;
+		rec->cpu = cpu;
+		rec->cluster = cpumask_first(pcpu->related_cpus);
+		rec->freq = pcpu->cur_freq;
+		rec->nr_running = nr;
+		rec->nr_iowait = nr_iowait_cpu(cpu);
+		for (i = 0; i < RQ_CLASS_NR; i++) {
+			rec->time_us[i] = pcpu->prev_time_us[i] ?
+				t[i] - pcpu->prev_time_us[i] : 0;
+			pcpu->prev_time_us[i] = t[i];
+		}
+		pcpu->last = *rec;
+	}
+	spin_unlock_irqrestore(&sample_lock, flags);
+
+	if (sample_ms)
+		mod_timer(&sample_timer, jiffies + msecs_to_jiffies(sample_ms));
+}
+
 
 static int update_average_load(unsigned int freq, unsigned int cpu)
 {
@@ -302,7 +379,132 @@ static struct kobj_attribute cpu_normalized_load_attr =
 	__ATTR(cpu_normalized_load, S_IWUSR | S_IRUSR, show_cpu_normalized_load,
 			NULL);
 
+static ssize_t show_sample_ms(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, MAX_LONG_SIZE, "%u\n", sample_ms);
+}
+
+static ssize_t store_sample_ms(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val = 0;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+	if (val && !sample_ring)
+		return -ENOMEM;
+
+	sample_ms = val;
+	if (val)
+		mod_timer(&sample_timer, jiffies + msecs_to_jiffies(val));
+	else
+		del_timer_sync(&sample_timer);
+	return count;
+}
+
+static struct kobj_attribute sample_ms_attr =
+	__ATTR(sample_ms, S_IWUSR | S_IRUSR, show_sample_ms, store_sample_ms);
+
+/* Latest sample of each cluster, summed over its online CPUs */
+static ssize_t show_cluster_load(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	static const char * const names[RQ_CLASS_NR] = {
+		"user", "system", "irq", "softirq", "iowait", "idle"
+	};
+	struct rq_stats_record *rec;
+	cpumask_t done;
+	unsigned long flags;
+	u64 t[RQ_CLASS_NR], total;
+	u32 nr_iowait, freq;
+	int cpu, j, i, len = 0;
+
+	len += snprintf(buf + len, PAGE_SIZE - len, "%-8s %8s %7s",
+			"cluster", "freq", "iowait");
+	for (i = 0; i < RQ_CLASS_NR; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, " %7s%%",
+				names[i]);
+	len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	cpumask_clear(&done);
+	spin_lock_irqsave(&sample_lock, flags);
+	for_each_online_cpu(cpu) {
+		if (cpumask_test_cpu(cpu, &done))
+			continue;
+		memset(t, 0, sizeof(t));
+		nr_iowait = freq = 0;
+		for_each_cpu_and(j, per_cpu(cpuload, cpu).related_cpus,
+				 cpu_online_mask) {
+			rec = &per_cpu(cpuload, j).last;
+			for (i = 0; i < RQ_CLASS_NR; i++)
+				t[i] += rec->time_us[i];
+			nr_iowait += rec->nr_iowait;
+			freq = max(freq, rec->freq);
+			cpumask_set_cpu(j, &done);
+		}
+		cpumask_set_cpu(cpu, &done);
+		total = 0;
+		for (i = 0; i < RQ_CLASS_NR; i++)
+			total += t[i];
+		len += snprintf(buf + len, PAGE_SIZE - len, "cpu%-5d %8u %7u",
+				cpu, freq, nr_iowait);
+		for (i = 0; i < RQ_CLASS_NR; i++)
+			len += snprintf(buf + len, PAGE_SIZE - len, " %8llu",
+				total ? div64_u64(t[i] * 100, total) : 0);
+		len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	spin_unlock_irqrestore(&sample_lock, flags);
+
+	return len;
+}
+
+static struct kobj_attribute cluster_load_attr =
+	__ATTR(cluster_load, S_IRUSR, show_cluster_load, NULL);
+
+static ssize_t read_history(struct file *filp, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	unsigned long flags;
+	unsigned int n, first, idx;
+	size_t rec = sizeof(struct rq_stats_record), done = 0, chunk;
+
+	if (!sample_ring)
+		return 0;
+
+	spin_lock_irqsave(&sample_lock, flags);
+	n = min_t(unsigned int, sample_wr_idx, RQ_STATS_NR_RECORDS);
+	first = sample_wr_idx - n;
+	while (done < count) {
+		u64 pos = off + done;
+		u32 rem = do_div(pos, rec);
+
+		if (pos >= n)
+			break;
+		idx = (first + pos) & (RQ_STATS_NR_RECORDS - 1);
+		chunk = min_t(size_t, count - done, rec - rem);
+		memcpy(buf + done, (char *)&sample_ring[idx] + rem, chunk);
+		done += chunk;
+	}
+	spin_unlock_irqrestore(&sample_lock, flags);
+
+	return done;
+}
+
+static struct bin_attribute history_attr = {
+	.attr = { .name = "history", .mode = S_IRUSR },
+	.size = RQ_STATS_NR_RECORDS * sizeof(struct rq_stats_record),
+	.read = read_history,
+};
+
+static struct bin_attribute *rq_bin_attrs[] = {
+	&history_attr,
+	NULL,
+};
+
 static struct attribute *rq_attrs[] = {
+	&sample_ms_attr.attr,
+	&cluster_load_attr.attr,
 	&cpu_normalized_load_attr.attr,
 	&def_timer_ms_attr.attr,
 	&run_queue_avg_attr.attr,
@@ -313,6 +515,7 @@ static struct attribute *rq_attrs[] = {
 
 static struct attribute_group rq_attr_group = {
 	.attrs = rq_attrs,
+	.bin_attrs = rq_bin_attrs,
 };
 
 static int init_rq_attribs(void)
@@ -358,6 +561,11 @@ static int __init msm_rq_stats_init(void)
 	rq_info.rq_poll_last_jiffy = 0;
 	rq_info.def_timer_last_jiffy = 0;
 	rq_info.hotplug_disabled = 0;
+	sample_ring = vzalloc(RQ_STATS_NR_RECORDS * sizeof(*sample_ring));
+	if (!sample_ring)
+		pr_err("rq_stats: Unable to allocate sample history\n");
+	init_timer_deferrable(&sample_timer);
+	sample_timer.function = rq_stats_sample;
 	ret = init_rq_attribs();
 
 	rq_info.init = 1;
@@ -32,6 +32,8 @@
 #include <linux/of_address.h>
 #include <linux/io.h>
 #include <linux/dma-mapping.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 #include <soc/qcom/ramdump.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/secure_buffer.h>
@@ -69,6 +71,14 @@ static void __iomem *pil_minidump_base;
 static int proxy_timeout_ms = -1;
 module_param(proxy_timeout_ms, int, S_IRUGO | S_IWUSR);
 
+/**
+ * parallel_load - Load the segments of an image concurrently. Images whose
+ * blobs are verified one by one as they are loaded are always loaded in
+ * order.
+ */
+static bool parallel_load = true;
+module_param(parallel_load, bool, S_IRUGO | S_IWUSR);
+
 static bool disable_timeouts;
 static const char firmware_error_msg[] = "firmware_error\n";
 /**
@@ -129,6 +139,7 @@ struct pil_seg {
  * non-relocatable images
  * @region: region allocated for relocatable images
  * @unvoted_flag: flag to keep track if we have unvoted or not.
+ * @load_domain: async domain the segments of the image are loaded in
  *
  * This struct contains data for a pil_desc that should not be exposed outside
  * of this file. This structure points to the descriptor and the descriptor
@@ -153,6 +164,7 @@ struct pil_priv {
 	int id;
 	int unvoted_flag;
 	size_t region_size;
+	struct async_domain load_domain;
 };
 
 static int pil_do_minidump(struct pil_desc *desc, void *ramdump_dev)
@@ -863,6 +875,70 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 	return ret;
 }
 
+struct pil_seg_job {
+	struct pil_desc *desc;
+	struct pil_seg *seg;
+	int ret;
+};
+
+static void pil_load_seg_async(void *data, async_cookie_t cookie)
+{
+	struct pil_seg_job *job = data;
+
+	job->ret = pil_load_seg(job->desc, job->seg);
+}
+
+/*
+ * Load all the segments of the image. Each segment is a separate blob, so
+ * with parallel_load the reads and copies of the blobs are spread over the
+ * async workers and overlap instead of running back to back.
+ */
+static int pil_load_segs(struct pil_desc *desc, bool *parallel)
+{
+	struct pil_priv *priv = desc->priv;
+	struct pil_seg_job *jobs;
+	struct pil_seg *seg;
+	int i, n = 0, ret = 0;
+
+	*parallel = false;
+	list_for_each_entry(seg, &priv->segs, list)
+		n++;
+
+	jobs = NULL;
+	if (parallel_load && !desc->ops->verify_blob && n > 1)
+		jobs = kcalloc(n, sizeof(*jobs), GFP_KERNEL);
+
+	if (!jobs) {
+		list_for_each_entry(seg, &priv->segs, list) {
+			ret = pil_load_seg(desc, seg);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	i = 0;
+	list_for_each_entry(seg, &priv->segs, list) {
+		jobs[i].desc = desc;
+		jobs[i].seg = seg;
+		async_schedule_domain(pil_load_seg_async, &jobs[i],
+				      &priv->load_domain);
+		i++;
+	}
+	async_synchronize_full_domain(&priv->load_domain);
+
+	for (i = 0; i < n; i++) {
+		if (jobs[i].ret) {
+			ret = jobs[i].ret;
+			break;
+		}
+	}
+	kfree(jobs);
+	*parallel = true;
+
+	return ret;
+}
+
 static int pil_parse_devicetree(struct pil_desc *desc)
 {
 	struct device_node *ofnode = desc->dev->of_node;
@@ -916,11 +992,12 @@ int pil_boot(struct pil_desc *desc)
 	char fw_name[30];
 	const struct pil_mdt *mdt;
 	const struct elf32_hdr *ehdr;
-	struct pil_seg *seg;
 	const struct firmware *fw;
 	struct pil_priv *priv = desc->priv;
 	bool mem_protect = false;
 	bool hyp_assign = false;
+	bool parallel;
+	ktime_t t_start, t_mdt, t_init, t_load, t_auth;
 
 	if (desc->shutdown_fail)
 		pil_err(desc, "Subsystem shutdown failed previously!\n");
@@ -929,12 +1006,14 @@ int pil_boot(struct pil_desc *desc)
 	pil_release_mmap(desc);
 
 	down_read(&pil_pm_rwsem);
+	t_start = ktime_get();
 	snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->fw_name);
 	ret = request_firmware(&fw, fw_name, desc->dev);
 	if (ret) {
 		pil_err(desc, "Failed to locate %s(rc:%d)\n", fw_name, ret);
 		goto out;
 	}
+	t_mdt = ktime_get();
 
 	if (fw->size < sizeof(*ehdr)) {
 		pil_err(desc, "Not big enough to be an elf header\n");
@@ -1011,11 +1090,11 @@ int pil_boot(struct pil_desc *desc)
 	}
 
 	trace_pil_event("before_load_seg", desc);
-	list_for_each_entry(seg, &desc->priv->segs, list) {
-		ret = pil_load_seg(desc, seg);
-		if (ret)
-			goto err_deinit_image;
-	}
+	t_init = ktime_get();
+	ret = pil_load_segs(desc, &parallel);
+	if (ret)
+		goto err_deinit_image;
+	t_load = ktime_get();
 
 	if (desc->subsys_vmid > 0) {
 		trace_pil_event("before_reclaim_mem", desc);
@@ -1038,7 +1117,13 @@ int pil_boot(struct pil_desc *desc)
 		goto err_auth_and_reset;
 	}
 	trace_pil_event("reset_done", desc);
+	t_auth = ktime_get();
 	pil_info(desc, "Brought out of reset\n");
+	pil_info(desc, "Boot took %lld ms: mdt %lld, init %lld, load %lld (%s), auth %lld\n",
+		 ktime_ms_delta(t_auth, t_start), ktime_ms_delta(t_mdt, t_start),
+		 ktime_ms_delta(t_init, t_mdt), ktime_ms_delta(t_load, t_init),
+		 parallel ? "parallel" : "serial",
+		 ktime_ms_delta(t_auth, t_load));
 	desc->modem_ssr = false;
 err_auth_and_reset:
 	if (ret && desc->subsys_vmid > 0) {
@@ -1157,6 +1242,7 @@ int pil_desc_init(struct pil_desc *desc)
 		return -ENOMEM;
 	desc->priv = priv;
 	priv->desc = desc;
+	INIT_LIST_HEAD(&priv->load_domain.pending);
 
 	priv->id = ret = ida_simple_get(&pil_ida, 0, PIL_NUM_DESC, GFP_KERNEL);
 	if (priv->id < 0)
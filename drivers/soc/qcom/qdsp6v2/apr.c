@@ -351,6 +351,44 @@ int apr_load_adsp_image(void)
 	return rc;
 }
 
+/* Called with svc->w_lock held */
+static void apr_trace_cmd(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	struct apr_svc_trace *tr;
+
+	tr = &svc->trace[svc->trace_idx++ % APR_SVC_TRACE_DEPTH];
+	tr->opcode = hdr->opcode;
+	tr->token = hdr->token;
+	tr->ts = ktime_get();
+}
+
+/*
+ * Find the command a basic response belongs to and return how long it
+ * took in us, or -1 if the command is not among the last ones sent.
+ */
+static s64 apr_trace_rsp(struct apr_svc *svc, uint32_t opcode,
+			 uint32_t token)
+{
+	struct apr_svc_trace *tr;
+	unsigned long flags;
+	s64 lat_us = -1;
+	int i;
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	for (i = 0; i < APR_SVC_TRACE_DEPTH; i++) {
+		tr = &svc->trace[i];
+		if (tr->opcode == opcode && tr->token == token &&
+		    ktime_to_ns(tr->ts)) {
+			lat_us = ktime_us_delta(ktime_get(), tr->ts);
+			tr->ts = ktime_set(0, 0);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&svc->w_lock, flags);
+
+	return lat_us;
+}
+
 struct apr_client *apr_get_client(int dest_id, int client_id)
 {
 	return &client[dest_id][client_id];
@@ -409,6 +447,7 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		(hdr->src_domain << 8) | hdr->src_svc,
 		(hdr->dest_domain << 8) | hdr->dest_svc, hdr->opcode,
 		hdr->token);
+		apr_trace_cmd(svc, hdr);
 	}
 
 	rc = apr_tal_write(clnt->handle, buf,
@@ -716,10 +755,11 @@ void apr_cb_func(void *buf, int len, void *priv)
 			uint32_t *ptr = data.payload;
 
 			APR_PKT_INFO(
-			"Rx: src_addr[0x%X] dest_addr[0x%X] opcode[0x%X] token[0x%X] rc[0x%X]",
+			"Rx: src_addr[0x%X] dest_addr[0x%X] opcode[0x%X] token[0x%X] rc[0x%X] lat_us[%lld]",
 			(hdr->src_domain << 8) | hdr->src_svc,
 			(hdr->dest_domain << 8) | hdr->dest_svc,
-			hdr->opcode, hdr->token, ptr[1]);
+			hdr->opcode, hdr->token, ptr[1],
+			apr_trace_rsp(c_svc, ptr[0], hdr->token));
 		} else {
 			APR_PKT_INFO(
 			"Rx: src_addr[0x%X] dest_addr[0x%X] opcode[0x%X] token[0x%X]",
@@ -68,7 +68,8 @@ static struct apr_tx_buf *apr_alloc_buf(int len)
 		return ERR_PTR(-EINVAL);
 	}
 
-	return kzalloc(sizeof(struct apr_tx_buf), GFP_ATOMIC);
+	/* Most commands are small, only allocate what the packet needs */
+	return kmalloc(offsetof(struct apr_tx_buf, buf) + len, GFP_ATOMIC);
 }
 
 static void apr_free_buf(const void *ptr)
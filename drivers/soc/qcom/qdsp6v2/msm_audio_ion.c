@@ -27,6 +27,8 @@
 #include <linux/of_device.h>
 #include <linux/msm_audio_ion.h>
 #include <linux/export.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/qcom_iommu.h>
 #include <asm/dma-iommu.h>
 #include <soc/qcom/secure_buffer.h>
@@ -75,6 +77,42 @@ struct msm_audio_alloc_data {
 
 static struct msm_audio_ion_private msm_audio_ion_data = {0,};
 
+/*
+ * Buffers handed out by msm_audio_ion_alloc() are kept mapped after
+ * msm_audio_ion_free() and handed to the next allocation of the same
+ * page rounded size, so short lived streams skip the ION allocation,
+ * the SMMU mapping and the kernel mapping.
+ */
+struct msm_audio_pool_buf {
+	struct ion_client *client;
+	struct ion_handle *handle;
+	ion_phys_addr_t paddr;
+	size_t pa_len;
+	void *vaddr;
+	size_t size;
+	struct list_head list;
+};
+
+struct msm_audio_pool_stats {
+	u64 hits;
+	u64 misses;
+	u64 returns;
+	u64 drops;
+};
+
+static unsigned int msm_audio_pool_max = 8;
+module_param_named(pool_max, msm_audio_pool_max, uint, 0644);
+MODULE_PARM_DESC(pool_max, "Max free buffers kept mapped");
+static unsigned int msm_audio_pool_max_size = SZ_512K;
+module_param_named(pool_max_size, msm_audio_pool_max_size, uint, 0644);
+MODULE_PARM_DESC(pool_max_size, "Largest buffer size kept mapped");
+
+static LIST_HEAD(msm_audio_pool_free);
+static LIST_HEAD(msm_audio_pool_busy);
+static DEFINE_MUTEX(msm_audio_pool_mutex);
+static unsigned int msm_audio_pool_cnt;
+static struct msm_audio_pool_stats msm_audio_pool_stats;
+
 static int msm_audio_ion_get_phys(struct ion_client *client,
 				  struct ion_handle *handle,
 				  ion_phys_addr_t *addr, size_t *len);
@@ -101,6 +139,122 @@ static void msm_audio_ion_add_allocation(
 	mutex_unlock(&(msm_audio_ion_data->list_mutex));
 }
 
+/* Take a free pooled buffer of the size of bufsz, if there is one */
+static bool msm_audio_ion_pool_get(size_t bufsz, struct ion_client **client,
+				   struct ion_handle **handle,
+				   ion_phys_addr_t *paddr, size_t *pa_len,
+				   void **vaddr)
+{
+	struct msm_audio_pool_buf *pbuf;
+	size_t size = PAGE_ALIGN(bufsz);
+	bool found = false;
+
+	if (size > msm_audio_pool_max_size)
+		return false;
+
+	mutex_lock(&msm_audio_pool_mutex);
+	list_for_each_entry(pbuf, &msm_audio_pool_free, list) {
+		if (pbuf->size == size) {
+			list_move(&pbuf->list, &msm_audio_pool_busy);
+			msm_audio_pool_cnt--;
+			*client = pbuf->client;
+			*handle = pbuf->handle;
+			*paddr = pbuf->paddr;
+			*pa_len = pbuf->pa_len;
+			*vaddr = pbuf->vaddr;
+			found = true;
+			break;
+		}
+	}
+	if (found)
+		msm_audio_pool_stats.hits++;
+	else
+		msm_audio_pool_stats.misses++;
+	mutex_unlock(&msm_audio_pool_mutex);
+
+	return found;
+}
+
+/* Remember a new allocation so that its free can return it to the pool */
+static void msm_audio_ion_pool_track(size_t bufsz, struct ion_client *client,
+				     struct ion_handle *handle,
+				     ion_phys_addr_t paddr, size_t pa_len,
+				     void *vaddr)
+{
+	struct msm_audio_pool_buf *pbuf;
+	size_t size = PAGE_ALIGN(bufsz);
+
+	if (!msm_audio_pool_max || size > msm_audio_pool_max_size)
+		return;
+
+	pbuf = kzalloc(sizeof(*pbuf), GFP_KERNEL);
+	if (!pbuf)
+		return;
+
+	pbuf->client = client;
+	pbuf->handle = handle;
+	pbuf->paddr = paddr;
+	pbuf->pa_len = pa_len;
+	pbuf->vaddr = vaddr;
+	pbuf->size = size;
+
+	mutex_lock(&msm_audio_pool_mutex);
+	list_add(&pbuf->list, &msm_audio_pool_busy);
+	mutex_unlock(&msm_audio_pool_mutex);
+}
+
+/*
+ * Return a tracked buffer to the pool. Returns false if the buffer is not
+ * tracked or the pool is full, in which case the caller releases it.
+ */
+static bool msm_audio_ion_pool_put(struct ion_client *client,
+				   struct ion_handle *handle)
+{
+	struct msm_audio_pool_buf *pbuf;
+	bool pooled = false;
+
+	mutex_lock(&msm_audio_pool_mutex);
+	list_for_each_entry(pbuf, &msm_audio_pool_busy, list) {
+		if (pbuf->client != client || pbuf->handle != handle)
+			continue;
+
+		if (msm_audio_pool_cnt < msm_audio_pool_max) {
+			list_move(&pbuf->list, &msm_audio_pool_free);
+			msm_audio_pool_cnt++;
+			msm_audio_pool_stats.returns++;
+			pooled = true;
+		} else {
+			list_del(&pbuf->list);
+			kfree(pbuf);
+			msm_audio_pool_stats.drops++;
+		}
+		break;
+	}
+	mutex_unlock(&msm_audio_pool_mutex);
+
+	return pooled;
+}
+
+static int __msm_audio_ion_free(struct ion_client *client,
+				struct ion_handle *handle);
+
+/* Release all the free pooled buffers */
+static void msm_audio_ion_pool_drain(void)
+{
+	struct msm_audio_pool_buf *pbuf, *tmp;
+	LIST_HEAD(drain);
+
+	mutex_lock(&msm_audio_pool_mutex);
+	list_splice_init(&msm_audio_pool_free, &drain);
+	msm_audio_pool_cnt = 0;
+	mutex_unlock(&msm_audio_pool_mutex);
+
+	list_for_each_entry_safe(pbuf, tmp, &drain, list) {
+		__msm_audio_ion_free(pbuf->client, pbuf->handle);
+		kfree(pbuf);
+	}
+}
+
 int msm_audio_ion_alloc(const char *name, struct ion_client **client,
 			struct ion_handle **handle, size_t bufsz,
 			ion_phys_addr_t *paddr, size_t *pa_len, void **vaddr)
@@ -118,6 +272,15 @@ int msm_audio_ion_alloc(const char *name, struct ion_client **client,
 		pr_err("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
+
+	if (msm_audio_ion_pool_get(bufsz, client, handle, paddr, pa_len,
+				   vaddr)) {
+		pr_debug("%s: pooled buffer %pK, size=%zd\n", __func__,
+			*vaddr, bufsz);
+		memset((void *)*vaddr, 0, bufsz);
+		return 0;
+	}
+
 	*client = msm_audio_ion_client_create(name);
 	if (IS_ERR_OR_NULL((void *)(*client))) {
 		pr_err("%s: ION create client for AUDIO failed\n", __func__);
@@ -166,6 +329,8 @@ int msm_audio_ion_alloc(const char *name, struct ion_client **client,
 		memset((void *)*vaddr, 0, bufsz);
 	}
 
+	msm_audio_ion_pool_track(bufsz, *client, *handle, *paddr, *pa_len,
+				 *vaddr);
 	return rc;
 
 err_ion_handle:
@@ -372,12 +537,9 @@ err:
 	return rc;
 }
 
-int msm_audio_ion_free(struct ion_client *client, struct ion_handle *handle)
+static int __msm_audio_ion_free(struct ion_client *client,
+				struct ion_handle *handle)
 {
-	if (!client || !handle) {
-		pr_err("%s Invalid params\n", __func__);
-		return -EINVAL;
-	}
 	if (msm_audio_ion_data.smmu_enabled)
 		msm_audio_dma_buf_unmap(client, handle);
 
@@ -387,6 +549,19 @@ int msm_audio_ion_free(struct ion_client *client, struct ion_handle *handle)
 	msm_audio_ion_client_destroy(client);
 	return 0;
 }
+
+int msm_audio_ion_free(struct ion_client *client, struct ion_handle *handle)
+{
+	if (!client || !handle) {
+		pr_err("%s Invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (msm_audio_ion_pool_put(client, handle))
+		return 0;
+
+	return __msm_audio_ion_free(client, handle);
+}
 EXPORT_SYMBOL(msm_audio_ion_free);
 
 int msm_audio_ion_mmap(struct audio_buffer *ab,
@@ -444,8 +619,13 @@ int msm_audio_ion_mmap(struct audio_buffer *ab,
 				(unsigned int)vma->vm_start,
 				(unsigned int)vma->vm_end,
 				(unsigned long int)vma->vm_page_prot);
-			remap_pfn_range(vma, addr, page_to_pfn(page), len,
-					vma->vm_page_prot);
+			ret = remap_pfn_range(vma, addr, page_to_pfn(page),
+					      len, vma->vm_page_prot);
+			if (ret) {
+				pr_err("%s: remap failed at %lx: %d\n",
+					__func__, addr, ret);
+				return ret;
+			}
 			addr += len;
 			if (addr >= vma->vm_end)
 				return 0;
@@ -477,6 +657,9 @@ int msm_audio_ion_mmap(struct audio_buffer *ab,
 				__phys_to_pfn(phys_addr) + vma->vm_pgoff,
 				vma->vm_end - vma->vm_start,
 				vma->vm_page_prot);
+		if (ret)
+			pr_err("%s: remap failed: %d\n", __func__, ret);
+		return ret;
 	}
 	return 0;
 }
@@ -1005,6 +1188,8 @@ static int msm_audio_ion_remove(struct platform_device *pdev)
 	mapping = msm_audio_ion_data.mapping;
 	audio_cb_dev = msm_audio_ion_data.cb_dev;
 
+	msm_audio_ion_pool_drain();
+
 	if (audio_cb_dev && mapping) {
 		arm_iommu_detach_device(audio_cb_dev);
 		arm_iommu_release_mapping(mapping);
@@ -1025,8 +1210,62 @@ static struct platform_driver msm_audio_ion_driver = {
 	.remove = msm_audio_ion_remove,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *msm_audio_pool_dentry;
+
+static int msm_audio_ion_pool_show(struct seq_file *s, void *unused)
+{
+	struct msm_audio_pool_stats st;
+	struct msm_audio_pool_buf *pbuf;
+	unsigned int busy = 0;
+	size_t bytes = 0;
+
+	mutex_lock(&msm_audio_pool_mutex);
+	st = msm_audio_pool_stats;
+	list_for_each_entry(pbuf, &msm_audio_pool_free, list)
+		bytes += pbuf->size;
+	list_for_each_entry(pbuf, &msm_audio_pool_busy, list)
+		busy++;
+	seq_printf(s, "free: %u (%zu bytes)\nbusy: %u\n",
+		   msm_audio_pool_cnt, bytes, busy);
+	mutex_unlock(&msm_audio_pool_mutex);
+
+	seq_printf(s, "hits: %llu\nmisses: %llu\nreturns: %llu\ndrops: %llu\n",
+		   st.hits, st.misses, st.returns, st.drops);
+	return 0;
+}
+
+static int msm_audio_ion_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_audio_ion_pool_show, NULL);
+}
+
+/* Any write releases the free pooled buffers */
+static ssize_t msm_audio_ion_pool_write(struct file *file,
+					const char __user *ubuf,
+					size_t count, loff_t *ppos)
+{
+	msm_audio_ion_pool_drain();
+	return count;
+}
+
+static const struct file_operations msm_audio_ion_pool_fops = {
+	.open = msm_audio_ion_pool_open,
+	.read = seq_read,
+	.write = msm_audio_ion_pool_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int __init msm_audio_ion_init(void)
 {
+#ifdef CONFIG_DEBUG_FS
+	msm_audio_pool_dentry = debugfs_create_file("msm_audio_ion_pool",
+						    S_IRUGO | S_IWUSR, NULL,
+						    NULL,
+						    &msm_audio_ion_pool_fops);
+#endif
 	return platform_driver_register(&msm_audio_ion_driver);
 }
 module_init(msm_audio_ion_init);
@@ -1034,6 +1273,9 @@ module_init(msm_audio_ion_init);
 static void __exit msm_audio_ion_exit(void)
 {
 	platform_driver_unregister(&msm_audio_ion_driver);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(msm_audio_pool_dentry);
+#endif
 }
 module_exit(msm_audio_ion_exit);
 
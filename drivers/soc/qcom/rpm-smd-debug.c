@@ -20,6 +20,7 @@
 #include <linux/io.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/rpm-smd.h>
 
 #define MAX_MSG_BUFFER 350
@@ -127,6 +128,48 @@ static const struct file_operations rsc_ops = {
 	.write = rsc_ops_write,
 };
 
+static int ack_latency_show(struct seq_file *s, void *unused)
+{
+	u64 hist[MSM_RPM_ACK_HIST_BUCKETS];
+	int i, n;
+
+	n = msm_rpm_get_ack_latency_hist(hist, ARRAY_SIZE(hist), false);
+	for (i = 0; i < n; i++) {
+		if (i < n - 1)
+			seq_printf(s, "<%6uus: %llu\n",
+				1U << (MSM_RPM_ACK_HIST_MIN_SHIFT + i), hist[i]);
+		else
+			seq_printf(s, ">=%5uus: %llu\n",
+				1U << (MSM_RPM_ACK_HIST_MIN_SHIFT + i - 1),
+				hist[i]);
+	}
+
+	return 0;
+}
+
+static int ack_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ack_latency_show, NULL);
+}
+
+static ssize_t ack_latency_write(struct file *fp,
+		const char __user *user_buffer, size_t count, loff_t *position)
+{
+	u64 hist[MSM_RPM_ACK_HIST_BUCKETS];
+
+	msm_rpm_get_ack_latency_hist(hist, ARRAY_SIZE(hist), true);
+
+	return count;
+}
+
+static const struct file_operations ack_latency_ops = {
+	.open = ack_latency_open,
+	.read = seq_read,
+	.write = ack_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init rpm_smd_debugfs_init(void)
 {
 	rpm_debugfs_dir = debugfs_create_dir("rpm_send_msg", NULL);
@@ -137,6 +180,10 @@ static int __init rpm_smd_debugfs_init(void)
 								&rsc_ops))
 		return -ENOMEM;
 
+	if (!debugfs_create_file("ack_latency", S_IRUGO | S_IWUSR,
+				rpm_debugfs_dir, NULL, &ack_latency_ops))
+		return -ENOMEM;
+
 	return 0;
 }
 late_initcall(rpm_smd_debugfs_init);
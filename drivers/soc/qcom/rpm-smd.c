@@ -36,6 +36,7 @@
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/rbtree.h>
+#include <linux/ktime.h>
 #include <soc/qcom/rpm-notifier.h>
 #include <soc/qcom/rpm-smd.h>
 #include <soc/qcom/smd.h>
@@ -615,9 +616,13 @@ struct msm_rpm_wait_data {
 	int errno;
 	struct completion ack;
 	bool delete_on_ack;
+	ktime_t sent;
 };
 DEFINE_SPINLOCK(msm_rpm_list_lock);
 
+/* Request to ack latencies, protected by msm_rpm_list_lock */
+static u64 msm_rpm_ack_hist[MSM_RPM_ACK_HIST_BUCKETS];
+
 
 
 LIST_HEAD(msm_rpm_ack_list);
@@ -1094,6 +1099,7 @@ static int msm_rpm_add_wait_list(uint32_t msg_id, bool delete_on_ack)
 	data->msg_id = msg_id;
 	data->errno = INIT_ERROR;
 	data->delete_on_ack = delete_on_ack;
+	data->sent = ktime_get();
 	spin_lock_irqsave(&msm_rpm_list_lock, flags);
 	if (delete_on_ack)
 		list_add_tail(&data->list, &msm_rpm_wait_list);
@@ -1114,6 +1120,30 @@ static void msm_rpm_free_list_entry(struct msm_rpm_wait_data *elem)
 	kfree(elem);
 }
 
+static void msm_rpm_account_ack(struct msm_rpm_wait_data *elem)
+{
+	u64 us = ktime_us_delta(ktime_get(), elem->sent);
+	int i = min_t(int, fls64(us >> MSM_RPM_ACK_HIST_MIN_SHIFT),
+		      MSM_RPM_ACK_HIST_BUCKETS - 1);
+
+	msm_rpm_ack_hist[i]++;
+}
+
+int msm_rpm_get_ack_latency_hist(u64 *hist, int n, bool clear)
+{
+	unsigned long flags;
+
+	n = min(n, MSM_RPM_ACK_HIST_BUCKETS);
+	spin_lock_irqsave(&msm_rpm_list_lock, flags);
+	memcpy(hist, msm_rpm_ack_hist, n * sizeof(*hist));
+	if (clear)
+		memset(msm_rpm_ack_hist, 0, sizeof(msm_rpm_ack_hist));
+	spin_unlock_irqrestore(&msm_rpm_list_lock, flags);
+
+	return n;
+}
+EXPORT_SYMBOL(msm_rpm_get_ack_latency_hist);
+
 static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 {
 	struct list_head *ptr, *next;
@@ -1125,6 +1155,7 @@ static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 	list_for_each_safe(ptr, next, &msm_rpm_wait_list) {
 		elem = list_entry(ptr, struct msm_rpm_wait_data, list);
 		if (elem->msg_id == msg_id) {
+			msm_rpm_account_ack(elem);
 			elem->errno = errno;
 			elem->ack_recd = true;
 			complete(&elem->ack);
@@ -1520,10 +1551,11 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 	return ret;
 }
 
+static DEFINE_MUTEX(send_mtx);
+
 static int _msm_rpm_send_request(struct msm_rpm_request *handle, bool noack)
 {
 	int ret;
-	static DEFINE_MUTEX(send_mtx);
 
 	mutex_lock(&send_mtx);
 	ret = msm_rpm_send_data(handle, MSM_RPM_MSG_REQUEST_TYPE, false, noack);
@@ -1532,6 +1564,31 @@ static int _msm_rpm_send_request(struct msm_rpm_request *handle, bool noack)
 	return ret;
 }
 
+int msm_rpm_send_requests(struct msm_rpm_request **handles, int n,
+		uint32_t *msg_ids)
+{
+	int i, ret = 0;
+
+	/*
+	 * Queue every request before waiting on any of them, so the RPM
+	 * works through the batch while the acks come back in one go.
+	 */
+	mutex_lock(&send_mtx);
+	for (i = 0; i < n; i++) {
+		msg_ids[i] = msm_rpm_send_data(handles[i],
+				MSM_RPM_MSG_REQUEST_TYPE, false, false);
+		if (!msg_ids[i] || (int)msg_ids[i] < 0) {
+			pr_err("Failed to send request %d of %d\n", i, n);
+			msg_ids[i] = 0;
+			ret = -EIO;
+		}
+	}
+	mutex_unlock(&send_mtx);
+
+	return ret;
+}
+EXPORT_SYMBOL(msm_rpm_send_requests);
+
 int msm_rpm_send_request(struct msm_rpm_request *handle)
 {
 	return _msm_rpm_send_request(handle, false);
@@ -1584,6 +1641,22 @@ int msm_rpm_wait_for_ack(uint32_t msg_id)
 }
 EXPORT_SYMBOL(msm_rpm_wait_for_ack);
 
+int msm_rpm_wait_for_acks(const uint32_t *msg_ids, int n)
+{
+	int i, rc, ret = 0;
+
+	for (i = 0; i < n; i++) {
+		if (!msg_ids[i])
+			continue;
+		rc = msm_rpm_wait_for_ack(msg_ids[i]);
+		if (rc && !ret)
+			ret = rc;
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL(msm_rpm_wait_for_acks);
+
 static void msm_rpm_smd_read_data_noirq(uint32_t msg_id)
 {
 	uint32_t id = 0;
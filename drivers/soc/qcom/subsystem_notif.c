@@ -16,6 +16,11 @@
  * Use subsys_notif_register_notifier to register for notifications
  * and subsys_notif_queue_notification to send notifications.
  *
+ * Clients registered with subsys_notif_register_notifier_parallel that
+ * share a priority are called concurrently; everything else is called in
+ * priority order as before. The time spent in each client is measured and
+ * slow clients are logged.
+ *
  */
 
 #include <linux/notifier.h>
@@ -26,6 +31,8 @@
 #include <linux/stringify.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 #include <soc/qcom/subsystem_notif.h>
 
 
@@ -33,11 +40,40 @@ struct subsys_notif_info {
 	char name[50];
 	struct srcu_notifier_head subsys_notif_rcvr_list;
 	struct list_head list;
+	struct list_head parallel_list;
+};
+
+/* A client that asked to be called concurrently with its peers */
+struct subsys_notif_parallel {
+	struct notifier_block *nb;
+	struct list_head list;
+};
+
+/* One callback of a parallel tier, run from the async domain */
+struct subsys_notif_job {
+	struct notifier_block *nb;
+	unsigned long code;
+	void *data;
+	int ret;
+	s64 elapsed_us;
 };
 
 static LIST_HEAD(subsystem_list);
 static DEFINE_MUTEX(notif_lock);
 static DEFINE_MUTEX(notif_add_lock);
+static DEFINE_MUTEX(notif_parallel_lock);
+static ASYNC_DOMAIN_EXCLUSIVE(notif_async_domain);
+
+static bool parallel = true;
+module_param(parallel, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(parallel, "Call parallel safe clients concurrently");
+
+static unsigned int log_threshold_us = 10000;
+module_param(log_threshold_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(log_threshold_us,
+		 "Log clients taking longer than this to handle an event");
+
+#define SUBSYS_NOTIF_MAX_TIER	16
 
 #if defined(SUBSYS_RESTART_DEBUG)
 static void subsys_notif_reg_test_notifier(const char *);
@@ -85,6 +121,31 @@ void *subsys_notif_register_notifier(
 }
 EXPORT_SYMBOL(subsys_notif_register_notifier);
 
+void *subsys_notif_register_notifier_parallel(
+			const char *subsys_name, struct notifier_block *nb)
+{
+	struct subsys_notif_parallel *p;
+	struct subsys_notif_info *subsys;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return ERR_PTR(-ENOMEM);
+
+	subsys = subsys_notif_register_notifier(subsys_name, nb);
+	if (IS_ERR(subsys)) {
+		kfree(p);
+		return subsys;
+	}
+
+	p->nb = nb;
+	mutex_lock(&notif_parallel_lock);
+	list_add_tail(&p->list, &subsys->parallel_list);
+	mutex_unlock(&notif_parallel_lock);
+
+	return subsys;
+}
+EXPORT_SYMBOL(subsys_notif_register_notifier_parallel);
+
 int subsys_notif_unregister_notifier(void *subsys_handle,
 				struct notifier_block *nb)
 {
@@ -92,12 +153,22 @@ int subsys_notif_unregister_notifier(void *subsys_handle,
 	struct subsys_notif_info *subsys =
 			(struct subsys_notif_info *)subsys_handle;
 
+	struct subsys_notif_parallel *p, *tmp;
+
 	if (!subsys)
 		return -EINVAL;
 
 	ret = srcu_notifier_chain_unregister(
 		&subsys->subsys_notif_rcvr_list, nb);
 
+	mutex_lock(&notif_parallel_lock);
+	list_for_each_entry_safe(p, tmp, &subsys->parallel_list, list)
+		if (p->nb == nb) {
+			list_del(&p->list);
+			kfree(p);
+		}
+	mutex_unlock(&notif_parallel_lock);
+
 	return ret;
 }
 EXPORT_SYMBOL(subsys_notif_unregister_notifier);
@@ -130,6 +201,7 @@ void *subsys_notif_add_subsys(const char *subsys_name)
 	srcu_init_notifier_head(&subsys->subsys_notif_rcvr_list);
 
 	INIT_LIST_HEAD(&subsys->list);
+	INIT_LIST_HEAD(&subsys->parallel_list);
 
 	mutex_lock(&notif_lock);
 	list_add_tail(&subsys->list, &subsystem_list);
@@ -146,6 +218,150 @@ done:
 }
 EXPORT_SYMBOL(subsys_notif_add_subsys);
 
+static bool subsys_notif_is_parallel(struct subsys_notif_info *subsys,
+				     struct notifier_block *nb)
+{
+	struct subsys_notif_parallel *p;
+	bool found = false;
+
+	mutex_lock(&notif_parallel_lock);
+	list_for_each_entry(p, &subsys->parallel_list, list)
+		if (p->nb == nb) {
+			found = true;
+			break;
+		}
+	mutex_unlock(&notif_parallel_lock);
+
+	return found;
+}
+
+static void subsys_notif_log(struct subsys_notif_info *subsys,
+			     struct notifier_block *nb, unsigned long code,
+			     s64 elapsed_us)
+{
+	if (elapsed_us >= log_threshold_us)
+		pr_info("%s: %pf took %lld us for event %lu\n", subsys->name,
+			nb->notifier_call, elapsed_us, code);
+}
+
+static void subsys_notif_job_fn(void *data, async_cookie_t cookie)
+{
+	struct subsys_notif_job *job = data;
+	ktime_t start = ktime_get();
+
+	job->ret = job->nb->notifier_call(job->nb, job->code, job->data);
+	job->elapsed_us = ktime_us_delta(ktime_get(), start);
+}
+
+/*
+ * Call the @n parallel safe clients in @tier concurrently and wait for all
+ * of them. Returns the merged notifier return value.
+ */
+static int subsys_notif_call_tier(struct subsys_notif_info *subsys,
+				  struct notifier_block **tier, int n,
+				  unsigned long code, void *data)
+{
+	struct subsys_notif_job *jobs;
+	ktime_t start;
+	int i, ret = NOTIFY_DONE;
+
+	jobs = n > 1 ? kcalloc(n, sizeof(*jobs), GFP_KERNEL) : NULL;
+	if (!jobs) {
+		for (i = 0; i < n; i++) {
+			start = ktime_get();
+			ret |= tier[i]->notifier_call(tier[i], code, data);
+			subsys_notif_log(subsys, tier[i], code,
+					 ktime_us_delta(ktime_get(), start));
+		}
+		return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		jobs[i].nb = tier[i];
+		jobs[i].code = code;
+		jobs[i].data = data;
+		async_schedule_domain(subsys_notif_job_fn, &jobs[i],
+				      &notif_async_domain);
+	}
+	async_synchronize_full_domain(&notif_async_domain);
+
+	for (i = 0; i < n; i++) {
+		ret |= jobs[i].ret;
+		subsys_notif_log(subsys, jobs[i].nb, code, jobs[i].elapsed_us);
+	}
+	kfree(jobs);
+
+	return ret;
+}
+
+/*
+ * Equivalent of srcu_notifier_call_chain, except that runs of parallel
+ * safe clients with equal priority are handed to subsys_notif_call_tier.
+ * A serial client, or a change of priority, closes the current tier.
+ */
+static int subsys_notif_call_chain(struct subsys_notif_info *subsys,
+				   unsigned long code, void *data)
+{
+	struct srcu_notifier_head *nh = &subsys->subsys_notif_rcvr_list;
+	struct notifier_block *tier[SUBSYS_NOTIF_MAX_TIER];
+	struct notifier_block *nb, *next;
+	int ret = NOTIFY_DONE;
+	int n = 0, clients = 0, concurrent = 0;
+	ktime_t start, total;
+	int idx;
+
+	total = ktime_get();
+	idx = srcu_read_lock(&nh->srcu);
+	nb = srcu_dereference(nh->head, &nh->srcu);
+	while (nb) {
+		next = srcu_dereference(nb->next, &nh->srcu);
+		clients++;
+
+		if (parallel && subsys_notif_is_parallel(subsys, nb)) {
+			if (n && (tier[0]->priority != nb->priority ||
+				  n == SUBSYS_NOTIF_MAX_TIER)) {
+				ret = subsys_notif_call_tier(subsys, tier, n,
+							     code, data);
+				concurrent += n > 1 ? n : 0;
+				n = 0;
+				if (ret & NOTIFY_STOP_MASK)
+					break;
+			}
+			tier[n++] = nb;
+			nb = next;
+			continue;
+		}
+
+		if (n) {
+			ret = subsys_notif_call_tier(subsys, tier, n, code,
+						     data);
+			concurrent += n > 1 ? n : 0;
+			n = 0;
+			if (ret & NOTIFY_STOP_MASK)
+				break;
+		}
+
+		start = ktime_get();
+		ret = nb->notifier_call(nb, code, data);
+		subsys_notif_log(subsys, nb, code,
+				 ktime_us_delta(ktime_get(), start));
+		if (ret & NOTIFY_STOP_MASK)
+			break;
+		nb = next;
+	}
+	if (n) {
+		ret = subsys_notif_call_tier(subsys, tier, n, code, data);
+		concurrent += n > 1 ? n : 0;
+	}
+	srcu_read_unlock(&nh->srcu, idx);
+
+	pr_info("%s: event %lu: %d clients (%d concurrent) in %lld us\n",
+		subsys->name, code, clients, concurrent,
+		ktime_us_delta(ktime_get(), total));
+
+	return ret;
+}
+
 int subsys_notif_queue_notification(void *subsys_handle,
 					enum subsys_notif_type notif_type,
 					void *data)
@@ -160,9 +376,7 @@ int subsys_notif_queue_notification(void *subsys_handle,
 	if (notif_type < 0 || notif_type >= SUBSYS_NOTIF_TYPE_COUNT)
 		return -EINVAL;
 
-		ret = srcu_notifier_call_chain(
-			&subsys->subsys_notif_rcvr_list, notif_type,
-			data);
+	ret = subsys_notif_call_chain(subsys, notif_type, data);
 	return ret;
 }
 EXPORT_SYMBOL(subsys_notif_queue_notification);
@@ -945,6 +945,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	struct subsys_tracking *track;
 	unsigned count;
 	unsigned long flags;
+	ktime_t start, shutdown, ramdump, powerup;
 	int ret;
 
 	/*
@@ -992,11 +993,13 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 
 	pr_debug("[%s:%d]: Starting restart sequence for %s\n",
 			current->comm, current->pid, desc->name);
+	start = ktime_get();
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_SHUTDOWN, NULL);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_shutdown);
 	if (ret)
 		goto err;
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_SHUTDOWN, NULL);
+	shutdown = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_RAMDUMP_NOTIFICATION,
 									NULL);
@@ -1009,15 +1012,22 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	for_each_subsys_device(list, count, NULL, subsystem_ramdump);
 
 	for_each_subsys_device(list, count, NULL, subsystem_free_memory);
+	ramdump = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_POWERUP, NULL);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_powerup);
 	if (ret)
 		goto err;
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_POWERUP, NULL);
+	powerup = ktime_get();
 
 	pr_info("[%s:%d]: Restart sequence for %s completed.\n",
 			current->comm, current->pid, desc->name);
+	pr_info("%s: SSR took %lld ms: shutdown %lld ms, ramdump %lld ms, powerup %lld ms\n",
+		desc->name, ktime_ms_delta(powerup, start),
+		ktime_ms_delta(shutdown, start),
+		ktime_ms_delta(ramdump, shutdown),
+		ktime_ms_delta(powerup, ramdump));
 
 err:
 	/* Reset subsys count */
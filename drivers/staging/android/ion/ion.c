@@ -68,6 +68,19 @@ struct ion_device {
 	struct dentry *debug_root;
 	struct dentry *heaps_debug_root;
 	struct dentry *clients_debug_root;
+	atomic_t map_cache_hits;
+	atomic_t map_cache_misses;
+};
+
+/**
+ * struct ion_dma_buf_attachment - exporter data of a dma_buf attachment
+ * @table:		copy of the buffer's sg_table kept for this attachment
+ *			across map/unmap cycles, freed on detach
+ * @mapped:		@table is currently handed out by ion_map_dma_buf
+ */
+struct ion_dma_buf_attachment {
+	struct sg_table *table;
+	bool mapped;
 };
 
 /**
@@ -1164,10 +1177,22 @@ err0:
 	return ERR_PTR(ret);
 }
 
-static struct sg_table *ion_dupe_sg_table(struct sg_table *orig_table)
+static void ion_copy_sg_table(struct sg_table *table,
+			      struct sg_table *orig_table)
 {
-	int ret, i;
+	int i;
 	struct scatterlist *sg, *sg_orig;
+
+	sg_orig = orig_table->sgl;
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		memcpy(sg, sg_orig, sizeof(*sg));
+		sg_orig = sg_next(sg_orig);
+	}
+}
+
+static struct sg_table *ion_dupe_sg_table(struct sg_table *orig_table)
+{
+	int ret;
 	struct sg_table *table;
 
 	table = kzalloc(sizeof(struct sg_table), GFP_KERNEL);
@@ -1180,14 +1205,36 @@ static struct sg_table *ion_dupe_sg_table(struct sg_table *orig_table)
 		return NULL;
 	}
 
-	sg_orig = orig_table->sgl;
-	for_each_sg(table->sgl, sg, table->nents, i) {
-		memcpy(sg, sg_orig, sizeof(*sg));
-		sg_orig = sg_next(sg_orig);
-	}
+	ion_copy_sg_table(table, orig_table);
 	return table;
 }
 
+static int ion_dma_buf_attach(struct dma_buf *dmabuf, struct device *dev,
+			      struct dma_buf_attachment *attachment)
+{
+	struct ion_dma_buf_attachment *a;
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a)
+		return -ENOMEM;
+
+	attachment->priv = a;
+	return 0;
+}
+
+static void ion_dma_buf_detach(struct dma_buf *dmabuf,
+			       struct dma_buf_attachment *attachment)
+{
+	struct ion_dma_buf_attachment *a = attachment->priv;
+
+	WARN_ON(a->mapped);
+	if (a->table) {
+		sg_free_table(a->table);
+		kfree(a->table);
+	}
+	kfree(a);
+}
+
 static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 				       struct device *dev,
 				       enum dma_data_direction direction);
@@ -1197,9 +1244,29 @@ static struct sg_table *ion_map_dma_buf(struct dma_buf_attachment *attachment,
 {
 	struct dma_buf *dmabuf = attachment->dmabuf;
 	struct ion_buffer *buffer = dmabuf->priv;
-	struct sg_table *table;
+	struct ion_dma_buf_attachment *a = attachment->priv;
+	struct sg_table *table = NULL;
 
-	table = ion_dupe_sg_table(buffer->sg_table);
+	/*
+	 * Reuse the table from the previous mapping of this attachment.
+	 * The entries are copied again since dma_map_sg may have rewritten
+	 * them, but the table itself is not reallocated.
+	 */
+	mutex_lock(&buffer->lock);
+	if (a->table && !a->mapped) {
+		table = a->table;
+		ion_copy_sg_table(table, buffer->sg_table);
+		a->mapped = true;
+		atomic_inc(&buffer->dev->map_cache_hits);
+	} else {
+		table = ion_dupe_sg_table(buffer->sg_table);
+		if (table && !a->table) {
+			a->table = table;
+			a->mapped = true;
+		}
+		atomic_inc(&buffer->dev->map_cache_misses);
+	}
+	mutex_unlock(&buffer->lock);
 	if (!table)
 		return NULL;
 
@@ -1211,8 +1278,20 @@ static void ion_unmap_dma_buf(struct dma_buf_attachment *attachment,
 			      struct sg_table *table,
 			      enum dma_data_direction direction)
 {
-	sg_free_table(table);
-	kfree(table);
+	struct ion_buffer *buffer = attachment->dmabuf->priv;
+	struct ion_dma_buf_attachment *a = attachment->priv;
+
+	mutex_lock(&buffer->lock);
+	if (table == a->table) {
+		a->mapped = false;
+		table = NULL;
+	}
+	mutex_unlock(&buffer->lock);
+
+	if (table) {
+		sg_free_table(table);
+		kfree(table);
+	}
 }
 
 void ion_pages_sync_for_device(struct device *dev, struct page *page,
@@ -1416,6 +1495,8 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 }
 
 static struct dma_buf_ops dma_buf_ops = {
+	.attach = ion_dma_buf_attach,
+	.detach = ion_dma_buf_detach,
 	.map_dma_buf = ion_map_dma_buf,
 	.unmap_dma_buf = ion_unmap_dma_buf,
 	.mmap = ion_mmap,
@@ -1969,9 +2050,16 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 	seq_printf(s, "%16s %16zu\n", "total orphaned",
 		   total_orphaned_size);
 	seq_printf(s, "%16s %16zu\n", "total ", total_size);
-	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE) {
 		seq_printf(s, "%16s %16zu\n", "deferred free",
 				heap->free_list_size);
+		seq_printf(s, "%16s %16u\n", "deferred count",
+				heap->free_list_count);
+		seq_printf(s, "%16s %16zu\n", "deferred peak",
+				heap->free_list_peak);
+		seq_printf(s, "%16s %16lu\n", "deferred freed",
+				heap->free_list_freed);
+	}
 	seq_puts(s, "----------------------------------------------------\n");
 
 	if (heap->debug_show)
@@ -2065,6 +2153,9 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 
 	spin_lock_init(&heap->free_lock);
 	heap->free_list_size = 0;
+	heap->free_list_count = 0;
+	heap->free_list_peak = 0;
+	heap->free_list_freed = 0;
 
 	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
 		ion_heap_init_deferred_free(heap);
@@ -2175,6 +2266,10 @@ struct ion_device *ion_device_create(long (*custom_ioctl)
 						idev->debug_root);
 	if (!idev->clients_debug_root)
 		pr_err("ion: failed to create debugfs clients directory.\n");
+	debugfs_create_atomic_t("map_cache_hits", 0444, idev->debug_root,
+				&idev->map_cache_hits);
+	debugfs_create_atomic_t("map_cache_misses", 0444, idev->debug_root,
+				&idev->map_cache_misses);
 
 debugfs_done:
 
@@ -169,6 +169,9 @@ void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
 	spin_lock(&heap->free_lock);
 	list_add(&buffer->list, &heap->free_list);
 	heap->free_list_size += buffer->size;
+	heap->free_list_count++;
+	if (heap->free_list_size > heap->free_list_peak)
+		heap->free_list_peak = heap->free_list_size;
 	spin_unlock(&heap->free_lock);
 	wake_up(&heap->waitqueue);
 }
@@ -204,6 +207,8 @@ static size_t _ion_heap_freelist_drain(struct ion_heap *heap, size_t size,
 					  list);
 		list_del(&buffer->list);
 		heap->free_list_size -= buffer->size;
+		heap->free_list_count--;
+		heap->free_list_freed++;
 		if (skip_pools)
 			buffer->private_flags |= ION_PRIV_FLAG_SHRINKER_FREE;
 		total_drained += buffer->size;
@@ -245,6 +250,8 @@ static int ion_heap_deferred_free(void *data)
 					  list);
 		list_del(&buffer->list);
 		heap->free_list_size -= buffer->size;
+		heap->free_list_count--;
+		heap->free_list_freed++;
 		spin_unlock(&heap->free_lock);
 		ion_buffer_destroy(buffer);
 	}
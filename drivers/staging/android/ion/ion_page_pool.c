@@ -14,6 +14,7 @@
  *
  */
 
+#include <linux/cpu.h>
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
@@ -23,8 +24,11 @@
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "ion_priv.h"
 
+static struct workqueue_struct *ion_page_pool_wq;
+
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page;
@@ -54,9 +58,17 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void ion_page_pool_account(struct ion_page_pool *pool,
+				  struct page *page, int sign)
+{
+	mod_zone_page_state(page_zone(page), NR_INDIRECTLY_RECLAIMABLE_BYTES,
+			    sign * (1 << (PAGE_SHIFT + pool->order)));
+}
+
+/* Moves a page onto the shared lists, pool->mutex must be held */
+static void ion_page_pool_list_add(struct ion_page_pool *pool,
+				   struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -64,14 +76,10 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
-
-	mod_zone_page_state(page_zone(page), NR_INDIRECTLY_RECLAIMABLE_BYTES,
-			    (1 << (PAGE_SHIFT + pool->order)));
-	mutex_unlock(&pool->mutex);
-	return 0;
 }
 
-static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
+static struct page *ion_page_pool_list_remove(struct ion_page_pool *pool,
+					      bool high)
 {
 	struct page *page;
 
@@ -86,11 +94,180 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	}
 
 	list_del(&page->lru);
-	mod_zone_page_state(page_zone(page), NR_INDIRECTLY_RECLAIMABLE_BYTES,
-			    -(1 << (PAGE_SHIFT + pool->order)));
 	return page;
 }
 
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	ion_page_pool_list_add(pool, page);
+	ion_page_pool_account(pool, page, 1);
+	mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
+{
+	struct page *page;
+
+	page = ion_page_pool_list_remove(pool, high);
+	ion_page_pool_account(pool, page, -1);
+	return page;
+}
+
+/*
+ * The per-cpu caches only hold lowmem pages and are only touched by their
+ * own cpu with preemption disabled. Pages move between a cache and the
+ * shared lists pool->pcp_batch at a time, so pool->mutex is taken once per
+ * batch rather than once per page.
+ */
+static bool ion_page_pool_pcp_put(struct ion_page_pool *pool,
+				  struct page *page)
+{
+	struct ion_page_pool_pcp *pcp;
+	struct page *batch[ION_POOL_PCP_MAX / 2];
+	int i, nr = 0;
+
+	if (!pool->pcp || PageHighMem(page))
+		return false;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	if (pcp->count == pool->pcp_high) {
+		nr = pool->pcp_batch;
+		pcp->count -= nr;
+		memcpy(batch, &pcp->pages[pcp->count], nr * sizeof(*batch));
+	}
+	pcp->pages[pcp->count++] = page;
+	put_cpu_ptr(pool->pcp);
+	ion_page_pool_account(pool, page, 1);
+
+	if (nr) {
+		mutex_lock(&pool->mutex);
+		for (i = 0; i < nr; i++)
+			ion_page_pool_list_add(pool, batch[i]);
+		mutex_unlock(&pool->mutex);
+	}
+	return true;
+}
+
+static struct page *ion_page_pool_pcp_get(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	struct page *batch[ION_POOL_PCP_MAX / 2];
+	struct page *page = NULL;
+	int i, room, nr = 0;
+
+	if (!pool->pcp)
+		return NULL;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	if (pcp->count)
+		page = pcp->pages[--pcp->count];
+	put_cpu_ptr(pool->pcp);
+	if (page)
+		goto out;
+
+	if (!mutex_trylock(&pool->mutex))
+		return NULL;
+	while (nr < pool->pcp_batch && pool->low_count)
+		batch[nr++] = ion_page_pool_list_remove(pool, false);
+	mutex_unlock(&pool->mutex);
+	if (!nr)
+		return NULL;
+
+	page = batch[--nr];
+	if (!nr)
+		goto out;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	room = min(nr, pool->pcp_high - pcp->count);
+	memcpy(&pcp->pages[pcp->count], batch, room * sizeof(*batch));
+	pcp->count += room;
+	put_cpu_ptr(pool->pcp);
+
+	if (room < nr) {
+		mutex_lock(&pool->mutex);
+		for (i = room; i < nr; i++)
+			ion_page_pool_list_add(pool, batch[i]);
+		mutex_unlock(&pool->mutex);
+	}
+out:
+	ion_page_pool_account(pool, page, -1);
+	return page;
+}
+
+/*
+ * Empties one cpu's cache into the shared lists. Must run on that cpu, or
+ * with the cpu offline.
+ */
+static void ion_page_pool_pcp_flush(struct ion_page_pool *pool,
+				    struct ion_page_pool_pcp *pcp)
+{
+	struct page *batch[ION_POOL_PCP_MAX];
+	int i, nr;
+
+	preempt_disable();
+	nr = pcp->count;
+	memcpy(batch, pcp->pages, nr * sizeof(*batch));
+	pcp->count = 0;
+	preempt_enable();
+
+	if (!nr)
+		return;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		ion_page_pool_list_add(pool, batch[i]);
+	mutex_unlock(&pool->mutex);
+}
+
+static void ion_page_pool_pcp_drain_work(struct work_struct *work)
+{
+	struct ion_page_pool_pcp *pcp = container_of(work,
+						     struct ion_page_pool_pcp,
+						     drain_work);
+
+	ion_page_pool_pcp_flush(pcp->pool, pcp);
+}
+
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	int cpu;
+
+	if (!pool->pcp || !ion_page_pool_wq)
+		return;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		if (pcp->count)
+			queue_work_on(cpu, ion_page_pool_wq, &pcp->drain_work);
+	}
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		if (cpu_online(cpu))
+			flush_work(&pcp->drain_work);
+		else
+			ion_page_pool_pcp_flush(pool, pcp);
+	}
+	put_online_cpus();
+}
+
+/* Since no lock is held, results are approximate. */
+int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->pcp)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(pool->pcp, cpu)->count);
+
+	return count;
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 {
 	struct page *page = NULL;
@@ -99,7 +276,8 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 
 	*from_pool = true;
 
-	if (mutex_trylock(&pool->mutex)) {
+	page = ion_page_pool_pcp_get(pool);
+	if (!page && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
@@ -122,7 +300,8 @@ void *ion_page_pool_alloc_pool_only(struct ion_page_pool *pool)
 
 	BUG_ON(!pool);
 
-	if (mutex_trylock(&pool->mutex)) {
+	page = ion_page_pool_pcp_get(pool);
+	if (!page && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
@@ -137,6 +316,9 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
 	int ret;
 
+	if (ion_page_pool_pcp_put(pool, page))
+		return;
+
 	ret = ion_page_pool_add(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
@@ -149,7 +331,7 @@ void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
 
 int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + ion_page_pool_pcp_count(pool);
 
 	if (high)
 		count += pool->high_count;
@@ -157,6 +339,30 @@ int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 	return count << pool->order;
 }
 
+/*
+ * Allocates one item with the given gfp_mask, zeroes it and cleans it from
+ * the cache before adding it to the pool, the same state ion_system_heap_free
+ * leaves pages in when it returns them to an uncached pool.
+ */
+int ion_page_pool_refill(struct ion_page_pool *pool, gfp_t gfp_mask)
+{
+	struct page *page;
+
+	page = alloc_pages(gfp_mask & ~__GFP_ZERO, pool->order);
+	if (!page)
+		return -ENOMEM;
+
+	if (msm_ion_heap_high_order_page_zero(pool->dev, page, pool->order)) {
+		__free_pages(page, pool->order);
+		return -ENOMEM;
+	}
+
+	ion_page_pool_alloc_set_cache_policy(pool, page);
+	ion_page_pool_add(pool, page);
+	pool->nr_refilled++;
+	return 0;
+}
+
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 				int nr_to_scan)
 {
@@ -171,6 +377,9 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	if ((pool->low_count << pool->order) < nr_to_scan)
+		ion_page_pool_pcp_drain(pool);
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
@@ -191,6 +400,31 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	return freed;
 }
 
+static int ion_page_pool_pcp_init(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	int cpu;
+
+	pool->pcp_high = min(ION_POOL_PCP_MAX,
+			     (ION_POOL_PCP_BYTES >> PAGE_SHIFT) >> pool->order);
+	pool->pcp_batch = pool->pcp_high / 2;
+	pool->pcp = NULL;
+	if (!pool->pcp_batch)
+		return 0;
+
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (!pool->pcp)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		pcp->count = 0;
+		pcp->pool = pool;
+		INIT_WORK(&pcp->drain_work, ion_page_pool_pcp_drain_work);
+	}
+	return 0;
+}
+
 struct ion_page_pool *ion_page_pool_create(struct device *dev, gfp_t gfp_mask,
 					   unsigned int order)
 {
@@ -205,19 +439,31 @@ struct ion_page_pool *ion_page_pool_create(struct device *dev, gfp_t gfp_mask,
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
+	pool->low_mark = 0;
+	pool->high_mark = 0;
+	pool->nr_refilled = 0;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
+	if (ion_page_pool_pcp_init(pool)) {
+		kfree(pool);
+		return NULL;
+	}
 
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	ion_page_pool_pcp_drain(pool);
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
 static int __init ion_page_pool_init(void)
 {
+	ion_page_pool_wq = alloc_workqueue("ion_page_pool", WQ_MEM_RECLAIM, 0);
+	if (!ion_page_pool_wq)
+		return -ENOMEM;
 	return 0;
 }
 device_initcall(ion_page_pool_init);
@@ -23,13 +23,16 @@
 #include <linux/kref.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/rbtree.h>
 #include <linux/seq_file.h>
 
 #include "msm_ion_priv.h"
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/sizes.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #ifdef CONFIG_ION_POOL_CACHE_POLICY
 #include <asm/cacheflush.h>
 #endif
@@ -172,6 +175,9 @@ struct ion_heap_ops {
  * @priv:		private heap data
  * @free_list:		free list head if deferred free is used
  * @free_list_size	size of the deferred free list in bytes
+ * @free_list_count	number of buffers on the deferred free list
+ * @free_list_peak	largest size the deferred free list has reached
+ * @free_list_freed	number of buffers freed from the deferred free list
  * @lock:		protects the free list
  * @waitqueue:		queue to wait on from deferred free thread
  * @task:		task struct of deferred free thread
@@ -195,6 +201,9 @@ struct ion_heap {
 	void *priv;
 	struct list_head free_list;
 	size_t free_list_size;
+	unsigned int free_list_count;
+	size_t free_list_peak;
+	unsigned long free_list_freed;
 	spinlock_t free_lock;
 	wait_queue_head_t waitqueue;
 	struct task_struct *task;
@@ -411,6 +420,28 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * many systems
  */
 
+/*
+ * Each per-cpu cache holds at most ION_POOL_PCP_BYTES of memory and at most
+ * ION_POOL_PCP_MAX items, whichever is less.
+ */
+#define ION_POOL_PCP_MAX	64
+#define ION_POOL_PCP_BYTES	SZ_256K
+
+/**
+ * struct ion_page_pool_pcp - per-cpu front cache of a page pool
+ * @count:		number of items in @pages
+ * @pages:		cached items, only accessed by the owning cpu with
+ *			preemption disabled
+ * @drain_work:		flushes @pages back to the pool lists on shrink
+ * @pool:		the pool this cache belongs to
+ */
+struct ion_page_pool_pcp {
+	int count;
+	struct page *pages[ION_POOL_PCP_MAX];
+	struct work_struct drain_work;
+	struct ion_page_pool *pool;
+};
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
@@ -422,6 +453,14 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @low_mark:		number of items below which the pool gets refilled
+ * @high_mark:		number of items the pool gets refilled up to
+ * @nr_refilled:	number of items added by ion_page_pool_refill
+ * @pcp:		per-cpu caches of lowmem items in front of the lists,
+ *			NULL for orders too large to cache
+ * @pcp_high:		capacity of each per-cpu cache
+ * @pcp_batch:		number of items moved between a per-cpu cache and
+ *			the lists at a time
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -438,6 +477,12 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	int low_mark;
+	int high_mark;
+	unsigned long nr_refilled;
+	struct ion_page_pool_pcp __percpu *pcp;
+	int pcp_high;
+	int pcp_batch;
 };
 
 struct ion_page_pool *ion_page_pool_create(struct device *dev, gfp_t gfp_mask,
@@ -448,6 +493,8 @@ void *ion_page_pool_alloc_pool_only(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 void ion_page_pool_free_immediate(struct ion_page_pool *, struct page *);
 int ion_page_pool_total(struct ion_page_pool *pool, bool high);
+int ion_page_pool_pcp_count(struct ion_page_pool *pool);
+int ion_page_pool_refill(struct ion_page_pool *pool, gfp_t gfp_mask);
 size_t ion_system_heap_secure_page_pool_total(struct ion_heap *heap, int vmid);
 
 #ifdef CONFIG_ION_POOL_CACHE_POLICY
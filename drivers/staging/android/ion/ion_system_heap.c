@@ -18,13 +18,16 @@
 #include <asm/page.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
 #include <linux/msm_ion.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/vmpressure.h>
 #include "ion.h"
 #include "ion_priv.h"
 #include <linux/dma-mapping.h>
@@ -69,6 +72,15 @@ struct ion_system_heap {
 	struct ion_page_pool **secure_pools[VMID_LAST];
 	/* Prevents unnecessary page splitting */
 	struct mutex split_page_mutex;
+#ifdef CONFIG_ION_POOL_AUTO_REFILL
+	struct task_struct *refill_task;
+	wait_queue_head_t refill_wait;
+	atomic_t refill_pending;
+	struct notifier_block vmpr_nb;
+	unsigned long refill_backoff_until;
+	unsigned long nr_refill_failed;
+	unsigned long nr_refill_backoff;
+#endif
 };
 
 struct page_info {
@@ -78,6 +90,194 @@ struct page_info {
 	struct list_head list;
 };
 
+#ifdef CONFIG_ION_POOL_AUTO_REFILL
+/*
+ * The refill thread stops for ION_POOL_REFILL_BACKOFF jiffies whenever
+ * vmpressure reports a level of at least ION_POOL_REFILL_MAX_PRESSURE, so
+ * it does not compete with reclaim for the memory it is trying to free.
+ */
+#define ION_POOL_REFILL_MAX_PRESSURE	60
+#define ION_POOL_REFILL_BACKOFF		(2 * HZ)
+
+/* Background refills may reclaim, unlike high_order_gfp_flags */
+static gfp_t refill_gfp_flags = (GFP_HIGHUSER | __GFP_NOWARN |
+				 __GFP_NORETRY);
+
+static bool ion_system_heap_refill_backoff(struct ion_system_heap *sys_heap)
+{
+	return time_before(jiffies, READ_ONCE(sys_heap->refill_backoff_until));
+}
+
+static int ion_system_heap_pool_items(struct ion_page_pool *pool)
+{
+	return ion_page_pool_total(pool, true) >> pool->order;
+}
+
+static bool ion_system_heap_pool_low(struct ion_page_pool *pool)
+{
+	return ion_system_heap_pool_items(pool) < pool->low_mark;
+}
+
+/*
+ * Only the uncached pools are refilled; cached buffers are rare and
+ * order-0 allocations rarely stall. Since no lock is held, the check is
+ * approximate.
+ */
+static void ion_system_heap_refill_kick(struct ion_system_heap *sys_heap)
+{
+	int i;
+
+	if (!sys_heap->refill_task || ion_system_heap_refill_backoff(sys_heap))
+		return;
+
+	for (i = 0; i < num_orders; i++) {
+		if (ion_system_heap_pool_low(sys_heap->uncached_pools[i])) {
+			if (!atomic_xchg(&sys_heap->refill_pending, 1))
+				wake_up(&sys_heap->refill_wait);
+			return;
+		}
+	}
+}
+
+static void ion_system_heap_refill_pools(struct ion_system_heap *sys_heap)
+{
+	struct ion_page_pool *pool;
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		pool = sys_heap->uncached_pools[i];
+
+		while (ion_system_heap_pool_items(pool) < pool->high_mark) {
+			if (kthread_should_stop())
+				return;
+			if (ion_system_heap_refill_backoff(sys_heap)) {
+				sys_heap->nr_refill_backoff++;
+				return;
+			}
+			if (ion_page_pool_refill(pool, refill_gfp_flags)) {
+				sys_heap->nr_refill_failed++;
+				break;
+			}
+			cond_resched();
+		}
+	}
+}
+
+static int ion_system_heap_refill_thread(void *data)
+{
+	struct ion_system_heap *sys_heap = data;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(sys_heap->refill_wait,
+				     atomic_read(&sys_heap->refill_pending) ||
+				     kthread_should_stop());
+		atomic_set(&sys_heap->refill_pending, 0);
+		ion_system_heap_refill_pools(sys_heap);
+	}
+
+	return 0;
+}
+
+static int ion_system_heap_vmpressure_notifier(struct notifier_block *nb,
+					       unsigned long action, void *data)
+{
+	struct ion_system_heap *sys_heap = container_of(nb,
+							struct ion_system_heap,
+							vmpr_nb);
+
+	if (action >= ION_POOL_REFILL_MAX_PRESSURE)
+		WRITE_ONCE(sys_heap->refill_backoff_until,
+			   jiffies + ION_POOL_REFILL_BACKOFF);
+
+	return 0;
+}
+
+static void ion_system_heap_set_marks(struct ion_system_heap *sys_heap)
+{
+	unsigned long fill = CONFIG_ION_POOL_FILL_MARK * SZ_1M;
+	struct ion_page_pool *pool;
+	int i, nr_high_orders = 0;
+
+	for (i = 0; i < num_orders; i++)
+		if (orders[i])
+			nr_high_orders++;
+	if (!nr_high_orders)
+		return;
+
+	for (i = 0; i < num_orders; i++) {
+		if (!orders[i])
+			continue;
+		pool = sys_heap->uncached_pools[i];
+		pool->high_mark = fill / nr_high_orders /
+				  order_to_size(orders[i]);
+		pool->low_mark = pool->high_mark *
+				 CONFIG_ION_POOL_LOW_MARK_PERCENT / 100;
+	}
+}
+
+static void ion_system_heap_refill_init(struct ion_system_heap *sys_heap)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	ion_system_heap_set_marks(sys_heap);
+	init_waitqueue_head(&sys_heap->refill_wait);
+	atomic_set(&sys_heap->refill_pending, 1);
+	sys_heap->refill_backoff_until = jiffies;
+
+	sys_heap->vmpr_nb.notifier_call = ion_system_heap_vmpressure_notifier;
+	vmpressure_notifier_register(&sys_heap->vmpr_nb);
+
+	sys_heap->refill_task = kthread_run(ion_system_heap_refill_thread,
+					    sys_heap, "ion_pool_refill");
+	if (IS_ERR(sys_heap->refill_task)) {
+		pr_err("%s: creating thread for pool refill failed\n",
+		       __func__);
+		sys_heap->refill_task = NULL;
+		vmpressure_notifier_unregister(&sys_heap->vmpr_nb);
+		return;
+	}
+	sched_setscheduler(sys_heap->refill_task, SCHED_IDLE, &param);
+}
+
+static void ion_system_heap_refill_destroy(struct ion_system_heap *sys_heap)
+{
+	if (!sys_heap->refill_task)
+		return;
+
+	kthread_stop(sys_heap->refill_task);
+	vmpressure_notifier_unregister(&sys_heap->vmpr_nb);
+}
+
+static void ion_system_heap_refill_debug_show(struct ion_system_heap *sys_heap,
+					      struct seq_file *s)
+{
+	struct ion_page_pool *pool;
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		pool = sys_heap->uncached_pools[i];
+		if (!pool->high_mark)
+			continue;
+		seq_printf(s,
+			"order %u uncached pool: low mark %d high mark %d refilled %lu\n",
+			pool->order, pool->low_mark, pool->high_mark,
+			pool->nr_refilled);
+	}
+	seq_printf(s, "pool refill failures = %lu back-offs = %lu\n",
+		   sys_heap->nr_refill_failed, sys_heap->nr_refill_backoff);
+}
+#else
+static inline void ion_system_heap_refill_kick(
+		struct ion_system_heap *sys_heap) { }
+static inline void ion_system_heap_refill_init(
+		struct ion_system_heap *sys_heap) { }
+static inline void ion_system_heap_refill_destroy(
+		struct ion_system_heap *sys_heap) { }
+static inline void ion_system_heap_refill_debug_show(
+		struct ion_system_heap *sys_heap, struct seq_file *s) { }
+#endif
+
 /*
  * Used by ion_system_secure_heap only
  * Since no lock is held, results are approximate.
@@ -482,6 +682,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (nents_sync)
 		sg_free_table(&table_sync);
 	msm_ion_heap_free_pages_mem(&data);
+	ion_system_heap_refill_kick(sys_heap);
 	return 0;
 
 err_free_sg2:
@@ -681,10 +882,12 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 	unsigned long cached_total = 0;
 	unsigned long secure_total = 0;
 	struct ion_page_pool *pool;
+	int pcp_count;
 	int i, j;
 
 	for (i = 0; i < num_orders; i++) {
 		pool = sys_heap->uncached_pools[i];
+		pcp_count = ion_page_pool_pcp_count(pool);
 		if (use_seq) {
 			seq_printf(s,
 				"%d order %u highmem pages in uncached pool = %lu total\n",
@@ -696,16 +899,24 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				pool->low_count, pool->order,
 				(1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			if (pool->pcp)
+				seq_printf(s,
+					"%d order %u pages in uncached per-cpu caches = %lu total\n",
+					pcp_count, pool->order,
+					(1 << pool->order) * PAGE_SIZE *
+						pcp_count);
 		}
 
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->high_count;
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->low_count;
+		uncached_total += (1 << pool->order) * PAGE_SIZE * pcp_count;
 	}
 
 	for (i = 0; i < num_orders; i++) {
 		pool = sys_heap->cached_pools[i];
+		pcp_count = ion_page_pool_pcp_count(pool);
 		if (use_seq) {
 			seq_printf(s,
 				"%d order %u highmem pages in cached pool = %lu total\n",
@@ -716,12 +927,19 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				pool->low_count, pool->order,
 				(1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			if (pool->pcp)
+				seq_printf(s,
+					"%d order %u pages in cached per-cpu caches = %lu total\n",
+					pcp_count, pool->order,
+					(1 << pool->order) * PAGE_SIZE *
+						pcp_count);
 		}
 
 		cached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->high_count;
 		cached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->low_count;
+		cached_total += (1 << pool->order) * PAGE_SIZE * pcp_count;
 	}
 
 	for (i = 0; i < num_orders; i++) {
@@ -747,6 +965,8 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 					 pool->high_count;
 			secure_total += (1 << pool->order) * PAGE_SIZE *
 					 pool->low_count;
+			secure_total += (1 << pool->order) * PAGE_SIZE *
+					 ion_page_pool_pcp_count(pool);
 		}
 	}
 
@@ -757,6 +977,7 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "pool total (uncached + cached + secure) = %lu\n",
 			   uncached_total + cached_total + secure_total);
 		seq_puts(s, "--------------------------------------------\n");
+		ion_system_heap_refill_debug_show(sys_heap, s);
 	} else {
 		pr_info("-------------------------------------------------\n");
 		pr_info("uncached pool = %lu cached pool = %lu secure pool = %lu\n",
@@ -848,6 +1069,7 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 		goto err_create_cached_pools;
 
 	mutex_init(&heap->split_page_mutex);
+	ion_system_heap_refill_init(heap);
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
 	return &heap->heap;
@@ -877,6 +1099,8 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							heap);
 	int i, j;
 
+	ion_system_heap_refill_destroy(sys_heap);
+
 	for (i = 0; i < VMID_LAST; i++) {
 		if (!is_secure_vmid_valid(i))
 			continue;
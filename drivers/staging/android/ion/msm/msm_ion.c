@@ -868,9 +868,32 @@ long msm_ion_custom_ioctl(struct ion_client *client,
 
 #define MAX_VMAP_RETRIES 10
 
+/*
+ * Lowmem pages are already mapped, so clear them through the linear map
+ * instead of paying for a vmap and the TLB flush of its vunmap.
+ */
+static bool msm_ion_heap_pages_zero_lowmem(struct page **pages, int num_pages)
+{
+	int i;
+
+	if (IS_ENABLED(CONFIG_HIGHMEM)) {
+		for (i = 0; i < num_pages; i++)
+			if (PageHighMem(pages[i]))
+				return false;
+	}
+
+	for (i = 0; i < num_pages; i++) {
+		clear_page(page_address(pages[i]));
+		if (!(i & 255))
+			cond_resched();
+	}
+	return true;
+}
+
 /**
- * An optimized page-zero'ing function. vmaps arrays of pages in large
- * chunks to minimize the number of memsets and vmaps/vunmaps.
+ * An optimized page-zero'ing function. Clears lowmem pages through the
+ * linear map, otherwise vmaps arrays of pages in large chunks to minimize
+ * the number of memsets and vmaps/vunmaps.
  *
  * Note that the `pages' array should be composed of all 4K pages.
  *
@@ -883,6 +906,9 @@ int msm_ion_heap_pages_zero(struct page **pages, int num_pages)
 	int i, j, npages_to_vmap;
 	void *ptr = NULL;
 
+	if (msm_ion_heap_pages_zero_lowmem(pages, num_pages))
+		return 0;
+
 	/*
 	 * As an optimization, we manually zero out all of the pages
 	 * in one fell swoop here. To safeguard against insufficient
@@ -53,6 +53,9 @@
 #include <linux/proc_fs.h>
 #include <linux/slab.h>
 #include <linux/poll.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/almk.h>
@@ -109,11 +112,234 @@ struct lmk_event {
 	short oom_score_adj;
 	short min_score_adj;
 	unsigned long long start_time;
+	unsigned long reaped_pages;
+	unsigned long kill_to_free_us;
 	struct list_head list;
 };
 
+#ifdef CONFIG_ANDROID_LMK_MEMSTALL
+/*
+ * Memory stall time is the time during which at least one task was in
+ * direct reclaim. Its 10s and 60s running averages are kept as percentages
+ * of wall time in FIXED_1 units and are updated every LMK_MEMSTALL_PERIOD.
+ */
+#define LMK_MEMSTALL_PERIOD	(2 * HZ)
+#define LMK_MEMSTALL_PERIOD_NS	(2 * NSEC_PER_SEC)
+#define LMK_MEMSTALL_EXP_10S	1677	/* 1/exp(2s/10s) as fixed-point */
+#define LMK_MEMSTALL_EXP_60S	1981	/* 1/exp(2s/60s) */
+#define LMK_MEMSTALL_MAX_MISSED	30
+
+static DEFINE_SPINLOCK(memstall_lock);
+static unsigned int memstall_nr;
+static u64 memstall_start;
+static u64 memstall_total;
+static u64 memstall_window_start;
+static u64 memstall_window_total;
+static bool memstall_window_fired;
+static atomic_t memstall_event = ATOMIC_INIT(0);
+
+static unsigned long memstall_avg10;
+static unsigned long memstall_avg60;
+static u64 memstall_avg_time;
+static u64 memstall_avg_total;
+static struct delayed_work memstall_avg_work;
+
+/*
+ * When tasks stall for memstall_trigger_us within one window of
+ * memstall_trigger_window_ms, the event file reports POLLPRI once.
+ */
+static unsigned int memstall_trigger_us;
+module_param_named(memstall_trigger_us, memstall_trigger_us, uint,
+		   S_IRUGO | S_IWUSR);
+static unsigned int memstall_trigger_window_ms = 1000;
+module_param_named(memstall_trigger_window_ms, memstall_trigger_window_ms,
+		   uint, S_IRUGO | S_IWUSR);
+
+/*
+ * Adaptive lmk only acts on vmpressure while the 10s stall average is at
+ * least this percentage.
+ */
+static unsigned int adaptive_lmk_memstall_min;
+module_param_named(adaptive_lmk_memstall_min, adaptive_lmk_memstall_min,
+		   uint, S_IRUGO | S_IWUSR);
+
+static u64 memstall_total_locked(u64 now)
+{
+	u64 total = memstall_total;
+
+	if (memstall_nr)
+		total += now - memstall_start;
+	return total;
+}
+
+/* Returns true if the stall trigger fires, memstall_lock must be held */
+static bool memstall_check_trigger_locked(u64 now)
+{
+	u64 window = (u64)READ_ONCE(memstall_trigger_window_ms) *
+		     NSEC_PER_MSEC;
+	u64 threshold = (u64)READ_ONCE(memstall_trigger_us) * NSEC_PER_USEC;
+
+	if (!threshold)
+		return false;
+
+	if (now - memstall_window_start >= window) {
+		memstall_window_start = now;
+		memstall_window_total = memstall_total_locked(now);
+		memstall_window_fired = false;
+		return false;
+	}
+
+	if (memstall_window_fired ||
+	    memstall_total_locked(now) - memstall_window_total < threshold)
+		return false;
+
+	memstall_window_fired = true;
+	return true;
+}
+
+void lmk_memstall_enter(void)
+{
+	u64 now = ktime_get_ns();
+
+	spin_lock(&memstall_lock);
+	if (!memstall_nr++)
+		memstall_start = now;
+	spin_unlock(&memstall_lock);
+}
+
+void lmk_memstall_leave(void)
+{
+	u64 now = ktime_get_ns();
+	bool fire;
+
+	spin_lock(&memstall_lock);
+	if (memstall_nr && !--memstall_nr)
+		memstall_total += now - memstall_start;
+	fire = memstall_check_trigger_locked(now);
+	spin_unlock(&memstall_lock);
+
+	if (fire) {
+		atomic_set(&memstall_event, 1);
+		wake_up_interruptible(&event_wait);
+	}
+}
+
+static unsigned long memstall_calc_avg(unsigned long avg, unsigned long exp,
+				       unsigned long pct)
+{
+	return (avg * exp + pct * (FIXED_1 - exp)) >> FSHIFT;
+}
+
+static void memstall_avg_update(struct work_struct *work)
+{
+	u64 now = ktime_get_ns();
+	u64 total, period, missed;
+	unsigned long pct;
+	bool fire;
+
+	spin_lock(&memstall_lock);
+	total = memstall_total_locked(now);
+	fire = memstall_check_trigger_locked(now);
+	spin_unlock(&memstall_lock);
+
+	if (fire) {
+		atomic_set(&memstall_event, 1);
+		wake_up_interruptible(&event_wait);
+	}
+
+	/* The work is deferrable, so account for the periods it slept */
+	period = now - memstall_avg_time;
+	if (period) {
+		pct = div64_u64((total - memstall_avg_total) * 100 * FIXED_1,
+				period);
+		pct = min(pct, 100UL * FIXED_1);
+		missed = div64_u64(period, LMK_MEMSTALL_PERIOD_NS);
+		missed = clamp_t(u64, missed, 1, LMK_MEMSTALL_MAX_MISSED);
+		while (missed--) {
+			memstall_avg10 = memstall_calc_avg(memstall_avg10,
+						LMK_MEMSTALL_EXP_10S, pct);
+			memstall_avg60 = memstall_calc_avg(memstall_avg60,
+						LMK_MEMSTALL_EXP_60S, pct);
+		}
+	}
+	memstall_avg_time = now;
+	memstall_avg_total = total;
+
+	schedule_delayed_work(&memstall_avg_work, LMK_MEMSTALL_PERIOD);
+}
+
+static unsigned int lmk_memstall_poll(void)
+{
+	return atomic_xchg(&memstall_event, 0) ? POLLPRI : 0;
+}
+
+static bool lmk_memstall_allows_adaptive(void)
+{
+	return (READ_ONCE(memstall_avg10) >> FSHIFT) >=
+		adaptive_lmk_memstall_min;
+}
+
+#define MEMSTALL_INT(x)		((x) >> FSHIFT)
+#define MEMSTALL_FRAC(x)	((((x) & (FIXED_1 - 1)) * 100) >> FSHIFT)
+
+static int lmk_memstall_show(struct seq_file *s, void *unused)
+{
+	unsigned long avg10 = READ_ONCE(memstall_avg10);
+	unsigned long avg60 = READ_ONCE(memstall_avg60);
+	u64 total;
+
+	spin_lock(&memstall_lock);
+	total = memstall_total_locked(ktime_get_ns());
+	spin_unlock(&memstall_lock);
+
+	seq_printf(s, "some avg10=%lu.%02lu avg60=%lu.%02lu total=%llu\n",
+		   MEMSTALL_INT(avg10), MEMSTALL_FRAC(avg10),
+		   MEMSTALL_INT(avg60), MEMSTALL_FRAC(avg60),
+		   div_u64(total, NSEC_PER_USEC));
+	return 0;
+}
+
+static int lmk_memstall_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lmk_memstall_show, NULL);
+}
+
+static const struct file_operations memstall_file_ops = {
+	.open = lmk_memstall_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void lmk_memstall_init(void)
+{
+	memstall_avg_time = ktime_get_ns();
+	INIT_DEFERRABLE_WORK(&memstall_avg_work, memstall_avg_update);
+	schedule_delayed_work(&memstall_avg_work, LMK_MEMSTALL_PERIOD);
+
+	if (!proc_create("lowmemorykiller_memstall", S_IRUGO, NULL,
+			 &memstall_file_ops))
+		pr_err("error creating memstall file\n");
+}
+#else
+static inline unsigned int lmk_memstall_poll(void)
+{
+	return 0;
+}
+
+static inline bool lmk_memstall_allows_adaptive(void)
+{
+	return true;
+}
+
+static inline void lmk_memstall_init(void)
+{
+}
+#endif
+
 void handle_lmk_event(struct task_struct *selected, int selected_tasksize,
-		      short min_score_adj)
+		      short min_score_adj, unsigned long reaped_pages,
+		      unsigned long kill_to_free_us)
 {
 	int head;
 	int tail;
@@ -148,6 +374,8 @@ void handle_lmk_event(struct task_struct *selected, int selected_tasksize,
 	event->start_time = nsec_to_clock_t(selected->real_start_time);
 	event->rss_in_pages = selected_tasksize;
 	event->min_score_adj = min_score_adj;
+	event->reaped_pages = reaped_pages;
+	event->kill_to_free_us = kill_to_free_us;
 
 	event_buffer.head = (head + 1) & (MAX_BUFFERED_EVENTS - 1);
 
@@ -175,11 +403,12 @@ static int lmk_event_show(struct seq_file *s, void *unused)
 
 	event = &events[tail];
 
-	seq_printf(s, "%lu %lu %lu %lu %lu %lu %hd %hd %llu\n%s\n",
+	seq_printf(s, "%lu %lu %lu %lu %lu %lu %hd %hd %llu %lu %lu\n%s\n",
 		(unsigned long) event->pid, (unsigned long) event->uid,
 		(unsigned long) event->group_leader_pid, event->min_flt,
 		event->maj_flt, event->rss_in_pages, event->oom_score_adj,
-		event->min_score_adj, event->start_time, event->taskname);
+		event->min_score_adj, event->start_time, event->reaped_pages,
+		event->kill_to_free_us, event->taskname);
 
 	event_buffer.tail = (tail + 1) & (MAX_BUFFERED_EVENTS - 1);
 
@@ -196,6 +425,7 @@ static unsigned int lmk_event_poll(struct file *file, poll_table *wait)
 	if (event_buffer.head != event_buffer.tail)
 		ret = POLLIN;
 	spin_unlock(&lmk_event_lock);
+	ret |= lmk_memstall_poll();
 	return ret;
 }
 
@@ -291,6 +521,9 @@ static int lmk_vmpressure_notifier(struct notifier_block *nb,
 	if (!enable_adaptive_lmk)
 		return 0;
 
+	if (pressure >= 90 && !lmk_memstall_allows_adaptive())
+		pressure = 0;
+
 	if (pressure >= 95) {
 		other_file = global_page_state(NR_FILE_PAGES) + zcache_pages() -
 			global_page_state(NR_SHMEM) -
@@ -376,6 +609,212 @@ static int test_task_state(struct task_struct *p, int state)
 
 static DEFINE_MUTEX(scan_mutex);
 
+struct lowmem_selection {
+	struct task_struct *task;
+	int tasksize;
+	short oom_score_adj;
+};
+
+/*
+ * Checks whether tsk is a better victim than the current selection.
+ * Returns -EBUSY if tsk is a previous victim that is still dying.
+ */
+static int lowmem_consider(struct task_struct *tsk, short min_score_adj,
+			   struct lowmem_selection *sel)
+{
+	struct task_struct *p;
+	short oom_score_adj;
+	int tasksize;
+
+	if (tsk->flags & PF_KTHREAD)
+		return 0;
+
+	/* if task no longer has any memory ignore it */
+	if (test_task_flag(tsk, TIF_MM_RELEASED))
+		return 0;
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		if (test_task_flag(tsk, TIF_MEMDIE))
+			return -EBUSY;
+	}
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return 0;
+
+	oom_score_adj = p->signal->oom_score_adj;
+	if (oom_score_adj < min_score_adj) {
+		task_unlock(p);
+		return 0;
+	}
+	tasksize = get_mm_rss(p->mm);
+	task_unlock(p);
+	if (tasksize <= 0)
+		return 0;
+	if (sel->task) {
+		if (oom_score_adj < sel->oom_score_adj)
+			return 0;
+		if (oom_score_adj == sel->oom_score_adj &&
+		    tasksize <= sel->tasksize)
+			return 0;
+	}
+	sel->task = p;
+	sel->tasksize = tasksize;
+	sel->oom_score_adj = oom_score_adj;
+	lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
+		     p->comm, p->pid, oom_score_adj, tasksize);
+	return 0;
+}
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+/*
+ * Processes are indexed by their oom_score_adj when it is written through
+ * /proc, one bucket per non-negative value. A process leaves the index when
+ * its group leader exits; lmk_adj_node.pprev is then set to LIST_POISON2 so
+ * that a racing update does not put it back.
+ *
+ * Readers walk the buckets under rcu_read_lock only. A signal_struct is
+ * freed no earlier than a grace period after its leader is released, which
+ * is after the leader left the index. A node that moves to another bucket
+ * while being walked can make the walker skip or visit a few processes, so
+ * lowmem_consider() always rechecks the real oom_score_adj.
+ */
+#define LMK_ADJ_BUCKETS		(OOM_SCORE_ADJ_MAX + 1)
+
+static struct hlist_head lmk_adj_buckets[LMK_ADJ_BUCKETS];
+static DECLARE_BITMAP(lmk_adj_bitmap, LMK_ADJ_BUCKETS);
+static DEFINE_SPINLOCK(lmk_adj_lock);
+static bool lmk_adj_index_ready;
+
+static void lmk_adj_index_del_locked(struct signal_struct *sig)
+{
+	short bucket = sig->lmk_adj_bucket;
+
+	hlist_del_init_rcu(&sig->lmk_adj_node);
+	if (hlist_empty(&lmk_adj_buckets[bucket]))
+		clear_bit(bucket, lmk_adj_bitmap);
+}
+
+void lowmem_adj_index_update(struct task_struct *task)
+{
+	struct signal_struct *sig = task->signal;
+	short adj = sig->oom_score_adj;
+	unsigned long flags;
+
+	if (!lmk_adj_index_ready)
+		return;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	if (sig->lmk_adj_node.pprev == LIST_POISON2)
+		goto out;
+	if (!hlist_unhashed(&sig->lmk_adj_node)) {
+		if (sig->lmk_adj_bucket == adj)
+			goto out;
+		lmk_adj_index_del_locked(sig);
+	}
+	if (adj < 0)
+		goto out;
+
+	sig->lmk_adj_task = task->group_leader;
+	sig->lmk_adj_bucket = adj;
+	hlist_add_head_rcu(&sig->lmk_adj_node, &lmk_adj_buckets[adj]);
+	set_bit(adj, lmk_adj_bitmap);
+out:
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+}
+
+static int lmk_adj_index_task_exit(struct notifier_block *nb,
+				   unsigned long action, void *data)
+{
+	struct task_struct *task = data;
+	struct signal_struct *sig = task->signal;
+	unsigned long flags;
+
+	if (task != task->group_leader)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&lmk_adj_lock, flags);
+	if (!hlist_unhashed(&sig->lmk_adj_node) &&
+	    sig->lmk_adj_node.pprev != LIST_POISON2)
+		lmk_adj_index_del_locked(sig);
+	sig->lmk_adj_node.pprev = LIST_POISON2;
+	spin_unlock_irqrestore(&lmk_adj_lock, flags);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block lmk_adj_index_exit_nb = {
+	.notifier_call = lmk_adj_index_task_exit,
+};
+
+static void lmk_adj_index_init(void)
+{
+	if (profile_event_register(PROFILE_TASK_EXIT, &lmk_adj_index_exit_nb))
+		pr_err("oom_score_adj index disabled, no task exit events\n");
+	else
+		lmk_adj_index_ready = true;
+}
+
+/* Must be called under rcu_read_lock */
+static int lowmem_select_indexed(short min_score_adj,
+				 struct lowmem_selection *sel)
+{
+	unsigned long size = LMK_ADJ_BUCKETS;
+	unsigned long adj;
+	struct signal_struct *sig;
+	int ret;
+
+	if (!lmk_adj_index_ready || min_score_adj < 0)
+		return 0;
+
+	while (!sel->task) {
+		adj = find_last_bit(lmk_adj_bitmap, size);
+		if (adj == size || adj < min_score_adj)
+			break;
+
+		hlist_for_each_entry_rcu(sig, &lmk_adj_buckets[adj],
+					 lmk_adj_node) {
+			ret = lowmem_consider(READ_ONCE(sig->lmk_adj_task),
+					      min_score_adj, sel);
+			if (ret)
+				return ret;
+		}
+		size = adj;
+	}
+
+	return 0;
+}
+#else
+static inline void lmk_adj_index_init(void)
+{
+}
+
+static inline int lowmem_select_indexed(short min_score_adj,
+					struct lowmem_selection *sel)
+{
+	return 0;
+}
+#endif
+
+/* Must be called under rcu_read_lock */
+static int lowmem_select(short min_score_adj, struct lowmem_selection *sel)
+{
+	struct task_struct *tsk;
+	int ret;
+
+	ret = lowmem_select_indexed(min_score_adj, sel);
+	if (ret || sel->task)
+		return ret;
+
+	for_each_process(tsk) {
+		ret = lowmem_consider(tsk, min_score_adj, sel);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -545,12 +984,192 @@ void tune_lmk_param(int *other_free, int *other_file, struct shrink_control *sc)
 	}
 }
 
+#ifdef CONFIG_ANDROID_LMK_REAPER
+/*
+ * Victims are handed to the reaper thread, which unmaps their private
+ * memory without waiting for them to be scheduled and exit. The lmk event
+ * of a reaped victim is logged once reaping is done, so that it carries
+ * the number of pages reaped and the time from the kill until then.
+ */
+#define LMK_REAP_QUEUE		8
+#define LMK_REAP_RETRIES	10
+
+struct lmk_reap_req {
+	struct task_struct *task;
+	int tasksize;
+	short min_score_adj;
+	ktime_t kill_time;
+};
+
+static struct lmk_reap_req lmk_reap_queue[LMK_REAP_QUEUE];
+static unsigned int lmk_reap_head;
+static unsigned int lmk_reap_tail;
+static DEFINE_SPINLOCK(lmk_reap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lmk_reap_wait);
+static struct task_struct *lmk_reaper_task;
+
+static bool lmk_reap_pending(void)
+{
+	return READ_ONCE(lmk_reap_head) != READ_ONCE(lmk_reap_tail);
+}
+
+/* Takes over the reference to task on success */
+static bool lmk_reap_queue_add(struct task_struct *task, int tasksize,
+			       short min_score_adj)
+{
+	struct lmk_reap_req *req;
+	bool queued = false;
+
+	if (!lmk_reaper_task)
+		return false;
+
+	spin_lock(&lmk_reap_lock);
+	if (CIRC_SPACE(lmk_reap_head, lmk_reap_tail, LMK_REAP_QUEUE) >= 1) {
+		req = &lmk_reap_queue[lmk_reap_head];
+		req->task = task;
+		req->tasksize = tasksize;
+		req->min_score_adj = min_score_adj;
+		req->kill_time = ktime_get();
+		lmk_reap_head = (lmk_reap_head + 1) & (LMK_REAP_QUEUE - 1);
+		queued = true;
+	}
+	spin_unlock(&lmk_reap_lock);
+
+	if (queued)
+		wake_up(&lmk_reap_wait);
+	return queued;
+}
+
+static bool lmk_reap_queue_pop(struct lmk_reap_req *req)
+{
+	bool popped = false;
+
+	spin_lock(&lmk_reap_lock);
+	if (lmk_reap_head != lmk_reap_tail) {
+		*req = lmk_reap_queue[lmk_reap_tail];
+		lmk_reap_tail = (lmk_reap_tail + 1) & (LMK_REAP_QUEUE - 1);
+		popped = true;
+	}
+	spin_unlock(&lmk_reap_lock);
+
+	return popped;
+}
+
+/*
+ * Memory shared with a process that is not being killed must be left
+ * alone, as must the memory of a task that is dumping core.
+ */
+static bool lmk_mm_reapable(struct task_struct *task, struct mm_struct *mm)
+{
+	struct task_struct *p;
+	bool ret = true;
+
+	if (task->signal->flags & SIGNAL_GROUP_COREDUMP)
+		return false;
+
+	/* our own reference plus one per thread of the victim */
+	if (atomic_read(&mm->mm_users) <= get_nr_threads(task) + 1)
+		return true;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (same_thread_group(p, task) || (p->flags & PF_KTHREAD))
+			continue;
+		if (READ_ONCE(p->mm) == mm && !fatal_signal_pending(p)) {
+			ret = false;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static unsigned long lmk_reap_task(struct task_struct *task)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	unsigned long rss, reaped = 0;
+	int attempts = 0;
+
+	mm = get_task_mm(task);
+	if (!mm)
+		return 0;
+
+	if (!lmk_mm_reapable(task, mm))
+		goto out;
+
+	while (!down_read_trylock(&mm->mmap_sem)) {
+		if (++attempts > LMK_REAP_RETRIES)
+			goto out;
+		msleep_interruptible(20);
+	}
+
+	rss = get_mm_rss(mm);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_LOCKED | VM_HUGETLB | VM_PFNMAP))
+			continue;
+		if (vma_is_anonymous(vma) || !(vma->vm_flags & VM_SHARED))
+			zap_page_range(vma, vma->vm_start,
+				       vma->vm_end - vma->vm_start, NULL);
+	}
+	reaped = rss - min(rss, (unsigned long)get_mm_rss(mm));
+	up_read(&mm->mmap_sem);
+out:
+	mmput(mm);
+	return reaped;
+}
+
+static int lmk_reaper(void *unused)
+{
+	struct lmk_reap_req req;
+	unsigned long reaped;
+	s64 latency;
+
+	set_freezable();
+	while (true) {
+		wait_event_freezable(lmk_reap_wait, lmk_reap_pending());
+
+		while (lmk_reap_queue_pop(&req)) {
+			reaped = lmk_reap_task(req.task);
+			latency = ktime_us_delta(ktime_get(), req.kill_time);
+			lowmem_print(2, "reaped '%s' (%d) %lukB in %lldus\n",
+				     req.task->comm, req.task->pid,
+				     reaped * (PAGE_SIZE / 1024), latency);
+			handle_lmk_event(req.task, req.tasksize,
+					 req.min_score_adj, reaped, latency);
+			put_task_struct(req.task);
+		}
+	}
+
+	return 0;
+}
+
+static void lmk_reaper_init(void)
+{
+	lmk_reaper_task = kthread_run(lmk_reaper, NULL, "lmk_reaper");
+	if (IS_ERR(lmk_reaper_task)) {
+		pr_err("failed to start the reaper thread\n");
+		lmk_reaper_task = NULL;
+	}
+}
+#else
+static inline bool lmk_reap_queue_add(struct task_struct *task, int tasksize,
+				      short min_score_adj)
+{
+	return false;
+}
+
+static inline void lmk_reaper_init(void)
+{
+}
+#endif
+
 static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 {
-	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
+	struct lowmem_selection sel;
 	unsigned long rem = 0;
-	int tasksize;
 	int i;
 	int ret = 0;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
@@ -603,54 +1222,19 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		return 0;
 	}
 
-	selected_oom_score_adj = min_score_adj;
+	sel.task = NULL;
+	sel.tasksize = 0;
+	sel.oom_score_adj = min_score_adj;
 
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		/* if task no longer has any memory ignore it */
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
-
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				rcu_read_unlock();
-				mutex_unlock(&scan_mutex);
-				return 0;
-			}
-		}
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
+	if (lowmem_select(min_score_adj, &sel)) {
+		rcu_read_unlock();
+		mutex_unlock(&scan_mutex);
+		return 0;
 	}
+	selected = sel.task;
+	selected_tasksize = sel.tasksize;
+	selected_oom_score_adj = sel.oom_score_adj;
 	if (selected) {
 		long cache_size, cache_limit, free;
 
@@ -728,8 +1312,10 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		     sc->nr_to_scan, sc->gfp_mask, rem);
 	mutex_unlock(&scan_mutex);
 
-	if (selected) {
-		handle_lmk_event(selected, selected_tasksize, min_score_adj);
+	if (selected &&
+	    !lmk_reap_queue_add(selected, selected_tasksize, min_score_adj)) {
+		handle_lmk_event(selected, selected_tasksize, min_score_adj,
+				 0, 0);
 		put_task_struct(selected);
 	}
 	return rem;
@@ -747,6 +1333,9 @@ static int __init lowmem_init(void)
 	register_shrinker(&lowmem_shrinker);
 	vmpressure_notifier_register(&lmk_vmpr_nb);
 	lmk_event_init();
+	lmk_adj_index_init();
+	lmk_reaper_init();
+	lmk_memstall_init();
 	return 0;
 }
 device_initcall(lowmem_init);
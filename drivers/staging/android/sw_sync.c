@@ -109,6 +109,7 @@ static struct sync_timeline_ops sw_sync_timeline_ops = {
 	.fill_driver_data = sw_sync_fill_driver_data,
 	.timeline_value_str = sw_sync_timeline_value_str,
 	.pt_value_str = sw_sync_pt_value_str,
+	.ordered = true,
 };
 
 struct sw_sync_timeline *sw_sync_timeline_create(const char *name)
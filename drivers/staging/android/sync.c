@@ -116,6 +116,8 @@ void sync_timeline_signal(struct sync_timeline *obj)
 				 active_list) {
 		if (fence_is_signaled_locked(&pt->base))
 			list_del_init(&pt->active_list);
+		else if (obj->ops->ordered)
+			break;
 	}
 
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
@@ -462,11 +464,24 @@ static bool android_fence_enable_signaling(struct fence *fence)
 {
 	struct sync_pt *pt = container_of(fence, struct sync_pt, base);
 	struct sync_timeline *parent = sync_pt_parent(pt);
+	struct sync_pt *pos;
 
 	if (android_fence_signaled(fence))
 		return false;
 
-	list_add_tail(&pt->active_list, &parent->active_list_head);
+	/*
+	 * Points are mostly created, and waited on, in order, so the
+	 * right spot for an ordered timeline is almost always the tail.
+	 */
+	if (parent->ops->ordered) {
+		list_for_each_entry_reverse(pos, &parent->active_list_head,
+					    active_list)
+			if (parent->ops->compare(pos, pt) <= 0)
+				break;
+		list_add(&pt->active_list, &pos->active_list);
+	} else {
+		list_add_tail(&pt->active_list, &parent->active_list_head);
+	}
 	return true;
 }
 
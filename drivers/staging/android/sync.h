@@ -75,6 +75,13 @@ struct sync_timeline_ops {
 
 	/* optional */
 	void (*pt_value_str)(struct sync_pt *pt, char *str, int size);
+
+	/*
+	 * optional: points always signal in @compare order, which lets the
+	 * active list be kept sorted and walked only up to the first
+	 * point still pending
+	 */
+	bool ordered;
 };
 
 /**
@@ -754,6 +754,7 @@ void cds_mq_deinit(p_cds_mq_type pMq);
 void cds_mq_put(p_cds_mq_type pMq, p_cds_msg_wrapper pMsgWrapper);
 void cds_mq_put_front(p_cds_mq_type mq, p_cds_msg_wrapper msg_wrapper);
 p_cds_msg_wrapper cds_mq_get(p_cds_mq_type pMq);
+int cds_mq_get_batch(p_cds_mq_type pMq, struct list_head *batch, int max);
 bool cds_is_mq_empty(p_cds_mq_type pMq);
 p_cds_sched_context get_cds_sched_ctxt(void);
 QDF_STATUS cds_sched_init_mqs(p_cds_sched_context pSchedContext);
@@ -170,6 +170,37 @@ inline p_cds_msg_wrapper cds_mq_get(p_cds_mq_type pMq)
 
 } /* cds_mq_get() */
 
+/**
+ * cds_mq_get_batch() - take several messages off a message queue at once
+ * @pMq: Pointer to the message queue
+ * @batch: list the message wrappers are appended to, in queue order
+ * @max: max number of messages to take
+ *
+ * Return: number of message wrappers moved to @batch
+ */
+int cds_mq_get_batch(p_cds_mq_type pMq, struct list_head *batch, int max)
+{
+	struct list_head *listptr;
+	unsigned long flags;
+	int count = 0;
+
+	if (pMq == NULL || batch == NULL) {
+		QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
+			  "%s: NULL pointer passed", __func__);
+		return 0;
+	}
+
+	spin_lock_irqsave(&pMq->mqLock, flags);
+	while (count < max && !list_empty(&pMq->mqList)) {
+		listptr = pMq->mqList.next;
+		list_move_tail(listptr, batch);
+		count++;
+	}
+	spin_unlock_irqrestore(&pMq->mqLock, flags);
+
+	return count;
+}
+
 /**
  * cds_is_mq_empty() - check if the message queue is empty
  * @pMq: Pointer to the message queue
@@ -692,6 +692,110 @@ static inline void cds_mc_thread_watchdog_timeout(unsigned long arg)
 }
 #endif
 
+/*
+ * Max messages taken from one MC queue before the next queue gets its turn.
+ * Queues are still served in SYS, WMA, PE, SME order, but a flood on one of
+ * them (e.g. beacons and probe responses to PE on a congested channel) can
+ * no longer starve the ones behind it, such as the SME roaming commands.
+ */
+#define CDS_MC_BATCH 8
+
+/**
+ * cds_mc_dispatch() - hand one message to the layer owning its queue
+ * @pSchedContext: the global CDS Sched Context
+ * @mq: queue the message was taken from
+ * @msg: the message
+ * @wd_timer: MC thread watchdog, armed around the handler
+ *
+ * Return: QDF_STATUS_SUCCESS if the message was processed
+ */
+static QDF_STATUS cds_mc_dispatch(p_cds_sched_context pSchedContext,
+				  p_cds_mq_type mq, cds_msg_t *msg,
+				  qdf_timer_t *wd_timer)
+{
+	QDF_STATUS vStatus = QDF_STATUS_E_FAILURE;
+	void *pMacContext = NULL;
+
+	if (mq == &pSchedContext->peMcMq || mq == &pSchedContext->smeMcMq) {
+		pMacContext = cds_get_context(mq == &pSchedContext->peMcMq ?
+					      QDF_MODULE_ID_PE :
+					      QDF_MODULE_ID_SME);
+		if (NULL == pMacContext) {
+			QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_INFO,
+				  "MAC Context not ready yet");
+			return QDF_STATUS_SUCCESS;
+		}
+	}
+
+	qdf_timer_start(wd_timer, MC_THRD_WD_TIMEOUT);
+	if (mq == &pSchedContext->sysMcMq) {
+		vStatus = sys_mc_process_msg(pSchedContext->pVContext, msg);
+	} else if (mq == &pSchedContext->wmaMcMq) {
+		vStatus = wma_mc_process_msg(pSchedContext->pVContext, msg);
+	} else if (mq == &pSchedContext->peMcMq) {
+		if (eSIR_SUCCESS == pe_process_messages(pMacContext,
+							(tSirMsgQ *)msg))
+			vStatus = QDF_STATUS_SUCCESS;
+	} else {
+		vStatus = sme_process_msg((tHalHandle)pMacContext, msg);
+	}
+	qdf_timer_stop(wd_timer);
+
+	return vStatus;
+}
+
+/**
+ * cds_mc_service_mqs() - run one batch from each MC message queue
+ * @pSchedContext: the global CDS Sched Context
+ * @wd_timer: MC thread watchdog
+ * @wd_msg: message the watchdog reports on if it fires
+ *
+ * Each queue is emptied of up to CDS_MC_BATCH messages under a single
+ * lock, so a busy queue costs one lock round trip per batch instead of
+ * two per message.
+ *
+ * Return: number of messages serviced, 0 if all queues were empty
+ */
+static int cds_mc_service_mqs(p_cds_sched_context pSchedContext,
+			      qdf_timer_t *wd_timer, cds_msg_t **wd_msg)
+{
+	p_cds_mq_type mqs[] = {
+		&pSchedContext->sysMcMq,
+		&pSchedContext->wmaMcMq,
+		&pSchedContext->peMcMq,
+		&pSchedContext->smeMcMq,
+	};
+	static const char * const names[] = { "SYS", "WMA", "PE", "SME" };
+	p_cds_msg_wrapper pMsgWrapper, tmp;
+	LIST_HEAD(batch);
+	int i, count = 0;
+
+	for (i = 0; i < ARRAY_SIZE(mqs); i++) {
+		if (!cds_mq_get_batch(mqs[i], &batch, CDS_MC_BATCH))
+			continue;
+
+		list_for_each_entry_safe(pMsgWrapper, tmp, &batch, msgNode) {
+			list_del(&pMsgWrapper->msgNode);
+			*wd_msg = pMsgWrapper->pVosMsg;
+
+			if (!QDF_IS_STATUS_SUCCESS(cds_mc_dispatch(
+					pSchedContext, mqs[i],
+					pMsgWrapper->pVosMsg, wd_timer)))
+				QDF_TRACE(QDF_MODULE_ID_QDF,
+					  QDF_TRACE_LEVEL_ERROR,
+					  "%s: Issue Processing %s message",
+					  __func__, names[i]);
+
+			/* return message to the Core */
+			cds_core_return_msg(pSchedContext->pVContext,
+					    pMsgWrapper);
+			count++;
+		}
+	}
+
+	return count;
+}
+
 /**
  * cds_mc_thread() - cds main controller thread execution handler
  * @Arg: Pointer to the global CDS Sched Context
@@ -701,10 +805,6 @@ static inline void cds_mc_thread_watchdog_timeout(unsigned long arg)
 static int cds_mc_thread(void *Arg)
 {
 	p_cds_sched_context pSchedContext = (p_cds_sched_context) Arg;
-	p_cds_msg_wrapper pMsgWrapper = NULL;
-	tpAniSirGlobal pMacContext = NULL;
-	tSirRetStatus macStatus = eSIR_SUCCESS;
-	QDF_STATUS vStatus = QDF_STATUS_SUCCESS;
 	int retWaitStatus = 0;
 	bool shutdown = false;
 	hdd_context_t *pHddCtx = NULL;
@@ -785,159 +885,10 @@ static int cds_mc_thread(void *Arg)
 				}
 				break;
 			}
-			/* Check the SYS queue first */
-			if (!cds_is_mq_empty(&pSchedContext->sysMcMq)) {
-				/* Service the SYS message queue */
-				pMsgWrapper =
-					cds_mq_get(&pSchedContext->sysMcMq);
-				if (pMsgWrapper == NULL) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: pMsgWrapper is NULL",
-						  __func__);
-					QDF_ASSERT(0);
-					break;
-				}
-
-				qdf_timer_start(&wd_timer, MC_THRD_WD_TIMEOUT);
-				wd_msg = pMsgWrapper->pVosMsg;
-				vStatus =
-					sys_mc_process_msg(pSchedContext->pVContext,
-							   pMsgWrapper->pVosMsg);
-				qdf_timer_stop(&wd_timer);
-
-				if (!QDF_IS_STATUS_SUCCESS(vStatus)) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: Issue Processing SYS message",
-						  __func__);
-				}
-				/* return message to the Core */
-				cds_core_return_msg(pSchedContext->pVContext,
-						    pMsgWrapper);
-				continue;
-			}
-			/* Check the WMA queue */
-			if (!cds_is_mq_empty(&pSchedContext->wmaMcMq)) {
-				/* Service the WMA message queue */
-				pMsgWrapper =
-					cds_mq_get(&pSchedContext->wmaMcMq);
-				if (pMsgWrapper == NULL) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: pMsgWrapper is NULL",
-						  __func__);
-					QDF_ASSERT(0);
-					break;
-				}
-
-				qdf_timer_start(&wd_timer, MC_THRD_WD_TIMEOUT);
-				wd_msg = pMsgWrapper->pVosMsg;
-				vStatus =
-					wma_mc_process_msg(pSchedContext->pVContext,
-							 pMsgWrapper->pVosMsg);
-				qdf_timer_stop(&wd_timer);
-
-				if (!QDF_IS_STATUS_SUCCESS(vStatus)) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: Issue Processing WMA message",
-						  __func__);
-				}
-				/* return message to the Core */
-				cds_core_return_msg(pSchedContext->pVContext,
-						    pMsgWrapper);
+			/* Service every queue in priority order, a batch each */
+			if (cds_mc_service_mqs(pSchedContext, &wd_timer,
+					       &wd_msg))
 				continue;
-			}
-			/* Check the PE queue */
-			if (!cds_is_mq_empty(&pSchedContext->peMcMq)) {
-				/* Service the PE message queue */
-				pMsgWrapper =
-					cds_mq_get(&pSchedContext->peMcMq);
-				if (NULL == pMsgWrapper) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: pMsgWrapper is NULL",
-						  __func__);
-					QDF_ASSERT(0);
-					break;
-				}
-				/* Need some optimization */
-				pMacContext =
-					cds_get_context(QDF_MODULE_ID_PE);
-				if (NULL == pMacContext) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_INFO,
-						  "MAC Context not ready yet");
-					cds_core_return_msg
-						(pSchedContext->pVContext,
-						pMsgWrapper);
-					continue;
-				}
-
-				qdf_timer_start(&wd_timer, MC_THRD_WD_TIMEOUT);
-				wd_msg = pMsgWrapper->pVosMsg;
-				macStatus =
-					pe_process_messages(pMacContext,
-							    (tSirMsgQ *)
-							    pMsgWrapper->pVosMsg);
-				qdf_timer_stop(&wd_timer);
-
-				if (eSIR_SUCCESS != macStatus) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: Issue Processing PE message",
-						  __func__);
-				}
-				/* return message to the Core */
-				cds_core_return_msg(pSchedContext->pVContext,
-						    pMsgWrapper);
-				continue;
-			}
-			/** Check the SME queue **/
-			if (!cds_is_mq_empty(&pSchedContext->smeMcMq)) {
-				/* Service the SME message queue */
-				pMsgWrapper =
-					cds_mq_get(&pSchedContext->smeMcMq);
-				if (NULL == pMsgWrapper) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_ERROR,
-						  "%s: pMsgWrapper is NULL",
-						  __func__);
-					QDF_ASSERT(0);
-					break;
-				}
-				/* Need some optimization */
-				pMacContext =
-					cds_get_context(QDF_MODULE_ID_SME);
-				if (NULL == pMacContext) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_INFO,
-						  "MAC Context not ready yet");
-					cds_core_return_msg
-						(pSchedContext->pVContext,
-						pMsgWrapper);
-					continue;
-				}
-
-				qdf_timer_start(&wd_timer, MC_THRD_WD_TIMEOUT);
-				wd_msg = pMsgWrapper->pVosMsg;
-				vStatus =
-					sme_process_msg((tHalHandle)pMacContext,
-							pMsgWrapper->pVosMsg);
-				qdf_timer_stop(&wd_timer);
-
-				if (!QDF_IS_STATUS_SUCCESS(vStatus)) {
-					QDF_TRACE(QDF_MODULE_ID_QDF,
-						  QDF_TRACE_LEVEL_INFO,
-						  "%s: Issue Processing SME message",
-						  __func__);
-				}
-				/* return message to the Core */
-				cds_core_return_msg(pSchedContext->pVContext,
-						    pMsgWrapper);
-				continue;
-			}
 			/* Check for any Suspend Indication */
 			if (test_bit
 				    (MC_SUSPEND_EVENT,
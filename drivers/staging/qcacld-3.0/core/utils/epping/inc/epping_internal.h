@@ -34,6 +34,7 @@
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
 #include <linux/kthread.h>
+#include <linux/mutex.h>
 #include <linux/semaphore.h>
 #if defined(WLAN_OPEN_SOURCE) && defined(CONFIG_HAS_WAKELOCK)
 #include <linux/wakelock.h>
@@ -64,6 +65,59 @@
 struct epping_cookie {
 	HTC_PACKET HtcPkt;      /* HTC packet wrapper */
 	struct epping_cookie *next;
+	uint64_t bench_ts;      /* send time of a benchmark packet, else 0 */
+};
+
+/* benchmark latency histograms, log2 buckets of usecs */
+#define EPPING_BENCH_LAT_BUCKETS 16
+
+enum epping_bench_mode {
+	EPPING_BENCH_ECHO,      /* host tx, target echoes, round trip time */
+	EPPING_BENCH_TX,        /* host tx only */
+	EPPING_BENCH_RX,        /* target generated rx only */
+	EPPING_BENCH_DUPLEX,    /* host tx and target generated rx */
+	EPPING_BENCH_MODES
+};
+
+/**
+ * struct epping_bench - host-target data path benchmark
+ * @ctrl_lock: serializes start/stop/reset
+ * @lock: protects the counters updated from the completion and rx paths
+ * @thread: packet generator, or NULL when not running
+ * @running: rx and tx completions are being accounted
+ * @mode: one of enum epping_bench_mode
+ * @pkt_len: length of generated packets, header included
+ * @burst: packets sent back to back before pausing
+ * @gap_us: pause between bursts, 0 only yields
+ * @streams: bitmap of the streams (access classes) to send on
+ * @duration_ms: run time, 0 until stopped
+ * @cpu_ns: cpu system/irq/softirq time of all cpus at start, then delta
+ */
+struct epping_bench {
+	struct mutex ctrl_lock;
+	qdf_spinlock_t lock;
+	struct task_struct *thread;
+	bool running;
+	uint32_t mode;
+	uint32_t pkt_len;
+	uint32_t burst;
+	uint32_t gap_us;
+	uint32_t streams;
+	uint32_t duration_ms;
+	uint32_t seq;
+	uint64_t start_ns;
+	uint64_t stop_ns;
+	uint64_t cpu_ns;
+	uint64_t tx_pkts;
+	uint64_t tx_bytes;
+	uint64_t tx_busy;
+	uint64_t tx_acks;
+	uint64_t tx_errs;
+	uint64_t rx_pkts;
+	uint64_t rx_bytes;
+	uint32_t ack_hist[EPPING_BENCH_LAT_BUCKETS];
+	uint32_t rtt_hist[EPPING_BENCH_LAT_BUCKETS];
+	struct dentry *dir;
 };
 
 typedef enum {
@@ -117,6 +171,7 @@ typedef struct epping_context {
 	int cookie_count;
 	struct epping_cookie *s_cookie_mem[MAX_COOKIE_SLOTS_NUM];
 	qdf_spinlock_t cookie_lock;
+	struct epping_bench bench;
 } epping_context_t;
 
 typedef enum {
@@ -155,11 +210,18 @@ void epping_log_packet(epping_adapter_t *pAdapter,
 void epping_log_stats(epping_adapter_t *pAdapter, const char *str);
 void epping_set_kperf_flag(epping_adapter_t *pAdapter,
 			   HTC_ENDPOINT_ID eid, A_UINT8 kperf_flag);
+void epping_bench_init(epping_context_t *pEpping_ctx);
+void epping_bench_deinit(epping_context_t *pEpping_ctx);
+void epping_bench_tx_done(epping_context_t *pEpping_ctx, uint64_t ts,
+			  bool success);
+bool epping_bench_rx(epping_context_t *pEpping_ctx, qdf_nbuf_t skb);
 
 /* epping_tx signatures */
 void epping_tx_timer_expire(epping_adapter_t *pAdapter);
 void epping_tx_complete(void *ctx, HTC_PACKET *htc_pkt);
 int epping_tx_send(qdf_nbuf_t skb, epping_adapter_t *pAdapter);
+int epping_tx_bench_send(epping_adapter_t *pAdapter, qdf_nbuf_t skb,
+			 HTC_ENDPOINT_ID eid);
 
 #ifdef HIF_SDIO
 enum htc_send_full_action epping_tx_queue_full(void *Context,
@@ -40,6 +40,9 @@
 #include <linux/semaphore.h>
 #include <linux/delay.h>
 #include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/kernel_stat.h>
+#include <linux/seq_file.h>
 #include "epping_main.h"
 #include "epping_internal.h"
 
@@ -116,6 +119,7 @@ struct epping_cookie *epping_alloc_cookie(epping_context_t *pEpping_ctx)
 	if (cookie != NULL) {
 		pEpping_ctx->cookie_list = cookie->next;
 		pEpping_ctx->cookie_count--;
+		cookie->bench_ts = 0;
 	}
 	qdf_spin_unlock_bh(&pEpping_ctx->cookie_lock);
 	return cookie;
@@ -201,3 +205,487 @@ void epping_set_kperf_flag(epping_adapter_t *pAdapter,
 	pAdapter->pEpping_ctx->kperf_num_rx_recv[eid] = 0;
 	pAdapter->pEpping_ctx->kperf_num_tx_acks[eid] = 0;
 }
+
+/* tags benchmark packets, echoed back by the target */
+#define EPPING_BENCH_CONTEXT    0x42454e43
+#define EPPING_BENCH_HEADROOM   64
+#define EPPING_BENCH_MAX_LEN    1536
+#define EPPING_BENCH_CTRL_RETRY 100
+
+static const char * const epping_bench_mode_name[EPPING_BENCH_MODES] = {
+	[EPPING_BENCH_ECHO]     = "echo",
+	[EPPING_BENCH_TX]       = "tx",
+	[EPPING_BENCH_RX]       = "rx",
+	[EPPING_BENCH_DUPLEX]   = "duplex",
+};
+
+static int epping_bench_bucket(uint64_t ns)
+{
+	return min(fls64(div_u64(ns, NSEC_PER_USEC)),
+		   EPPING_BENCH_LAT_BUCKETS - 1);
+}
+
+/* system, irq and softirq time of all cpus, where the data path runs */
+static uint64_t epping_bench_cpu_ns(void)
+{
+	uint64_t ns = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+		ns += cputime_to_nsecs(cpustat[CPUTIME_SYSTEM]) +
+		      cputime_to_nsecs(cpustat[CPUTIME_IRQ]) +
+		      cputime_to_nsecs(cpustat[CPUTIME_SOFTIRQ]);
+	}
+
+	return ns;
+}
+
+static qdf_nbuf_t epping_bench_alloc(struct epping_bench *bench,
+				     uint8_t stream, uint16_t cmd,
+				     uint32_t len)
+{
+	EPPING_HEADER *hdr;
+	qdf_nbuf_t skb;
+	uint64_t ts;
+
+	skb = qdf_nbuf_alloc(NULL, len + EPPING_BENCH_HEADROOM,
+			     EPPING_BENCH_HEADROOM, 4, false);
+	if (!skb)
+		return NULL;
+
+	hdr = (EPPING_HEADER *)qdf_nbuf_put_tail(skb, len);
+	qdf_mem_zero(hdr, len);
+	qdf_mem_set(hdr->_HCIRsvd, sizeof(hdr->_HCIRsvd), EPPING_RSVD_FILL);
+	qdf_mem_set(hdr->_rsvd, sizeof(hdr->_rsvd), EPPING_RSVD_FILL);
+	SET_EPPING_PACKET_MAGIC(hdr);
+	hdr->StreamNo_h = stream;
+	hdr->StreamEcho_h = stream;
+	hdr->Cmd_h = cmd;
+	hdr->HostContext_h = EPPING_BENCH_CONTEXT;
+	hdr->SeqNo = bench->seq++;
+	hdr->DataLength = len - sizeof(*hdr);
+	ts = ktime_get_ns();
+	qdf_mem_copy(hdr->TimeStamp, &ts, sizeof(ts));
+
+	return skb;
+}
+
+/* start or stop the target generated stream of the rx and duplex modes */
+static int epping_bench_cont_rx(epping_context_t *pEpping_ctx, bool start)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	EPPING_CONT_RX_PARAMS *params;
+	EPPING_HEADER *hdr;
+	qdf_nbuf_t skb;
+	int i, ret = -EBUSY;
+
+	skb = epping_bench_alloc(bench, 0, start ? EPPING_CMD_CONT_RX_START :
+				 EPPING_CMD_CONT_RX_STOP, sizeof(*hdr));
+	if (!skb)
+		return -ENOMEM;
+
+	hdr = (EPPING_HEADER *)qdf_nbuf_data(skb);
+	hdr->CmdFlags_h = CMD_FLAGS_NO_DROP;
+	params = (EPPING_CONT_RX_PARAMS *)hdr->CmdBuffer_h;
+	params->BurstCnt = bench->burst;
+	params->PacketLength = bench->pkt_len;
+	params->Flags = EPPING_CONT_RX_NO_DATA_FILL;
+
+	for (i = 0; i < EPPING_BENCH_CTRL_RETRY; i++) {
+		ret = epping_tx_bench_send(pEpping_ctx->epping_adapter, skb,
+					   pEpping_ctx->EppingEndpoint[0]);
+		if (ret != -EBUSY)
+			break;
+		msleep(1);
+	}
+	if (ret) {
+		EPPING_LOG(QDF_TRACE_LEVEL_ERROR,
+			   "%s: failed to %s continuous rx, ret = %d",
+			   __func__, start ? "start" : "stop", ret);
+		qdf_nbuf_free(skb);
+	}
+
+	return ret;
+}
+
+static int epping_bench_thread(void *arg)
+{
+	epping_context_t *pEpping_ctx = arg;
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	epping_adapter_t *pAdapter = pEpping_ctx->epping_adapter;
+	uint16_t cmd = bench->mode == EPPING_BENCH_ECHO ?
+		       EPPING_CMD_ECHO_PACKET : EPPING_CMD_NO_ECHO;
+	bool do_tx = bench->mode != EPPING_BENCH_RX;
+	bool do_rx = bench->mode == EPPING_BENCH_RX ||
+		     bench->mode == EPPING_BENCH_DUPLEX;
+	uint64_t end = bench->duration_ms ? bench->start_ns +
+		       (uint64_t)bench->duration_ms * NSEC_PER_MSEC : 0;
+	uint8_t stream = 0;
+	uint32_t i, len, streams;
+	qdf_nbuf_t skb;
+	int ret;
+
+	if (do_rx)
+		epping_bench_cont_rx(pEpping_ctx, true);
+
+	while (!kthread_should_stop()) {
+		if (end && ktime_get_ns() >= end)
+			break;
+		if (!do_tx) {
+			msleep_interruptible(10);
+			continue;
+		}
+
+		len = clamp_t(uint32_t, bench->pkt_len, sizeof(EPPING_HEADER),
+			      EPPING_BENCH_MAX_LEN);
+		streams = bench->streams & 0x3 ? bench->streams & 0x3 : 0x1;
+		for (i = 0; i < bench->burst; i++) {
+			do {
+				stream = (stream + 1) % 2;
+			} while (!(streams & BIT(stream)));
+
+			skb = epping_bench_alloc(bench, stream, cmd, len);
+			if (!skb) {
+				bench->tx_errs++;
+				break;
+			}
+			ret = epping_tx_bench_send(pAdapter, skb,
+				pEpping_ctx->EppingEndpoint[stream]);
+			if (ret) {
+				qdf_nbuf_free(skb);
+				if (ret == -EBUSY)
+					bench->tx_busy++;
+				else
+					bench->tx_errs++;
+				break;
+			}
+			bench->tx_pkts++;
+			bench->tx_bytes += len;
+		}
+
+		if (bench->gap_us)
+			usleep_range(bench->gap_us,
+				     bench->gap_us + bench->gap_us / 8 + 1);
+		else if (i < bench->burst)
+			/* out of tx resource, let completions catch up */
+			usleep_range(20, 50);
+		else
+			cond_resched();
+	}
+
+	if (do_rx)
+		epping_bench_cont_rx(pEpping_ctx, false);
+
+	qdf_spin_lock_bh(&bench->lock);
+	bench->running = false;
+	bench->stop_ns = ktime_get_ns();
+	bench->cpu_ns = epping_bench_cpu_ns() - bench->cpu_ns;
+	qdf_spin_unlock_bh(&bench->lock);
+
+	/* wait for epping_bench_stop() to reap us */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return 0;
+}
+
+void epping_bench_tx_done(epping_context_t *pEpping_ctx, uint64_t ts,
+			  bool success)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+
+	qdf_spin_lock_bh(&bench->lock);
+	if (bench->running) {
+		if (success)
+			bench->tx_acks++;
+		else
+			bench->tx_errs++;
+		bench->ack_hist[epping_bench_bucket(ktime_get_ns() - ts)]++;
+	}
+	qdf_spin_unlock_bh(&bench->lock);
+}
+
+/**
+ * epping_bench_rx() - account a received packet while a benchmark runs
+ * @pEpping_ctx: epping context
+ * @skb: received packet, starting with its EPPING_HEADER
+ *
+ * Benchmark traffic is dropped here rather than handed to the network
+ * stack, so that only the HIF/CE/HTC receive path is measured.
+ *
+ * Return: true if @skb was consumed
+ */
+bool epping_bench_rx(epping_context_t *pEpping_ctx, qdf_nbuf_t skb)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	EPPING_HEADER *hdr = (EPPING_HEADER *)qdf_nbuf_data(skb);
+	uint64_t ts;
+
+	if (!bench->running || qdf_nbuf_len(skb) < sizeof(*hdr) ||
+	    !IS_EPPING_PACKET(hdr))
+		return false;
+
+	qdf_spin_lock_bh(&bench->lock);
+	bench->rx_pkts++;
+	bench->rx_bytes += qdf_nbuf_len(skb);
+	if (hdr->HostContext_h == EPPING_BENCH_CONTEXT &&
+	    hdr->Cmd_h == EPPING_CMD_ECHO_PACKET) {
+		qdf_mem_copy(&ts, hdr->TimeStamp, sizeof(ts));
+		bench->rtt_hist[epping_bench_bucket(ktime_get_ns() - ts)]++;
+	}
+	qdf_spin_unlock_bh(&bench->lock);
+
+	qdf_nbuf_free(skb);
+
+	return true;
+}
+
+static void epping_bench_reset(struct epping_bench *bench)
+{
+	qdf_spin_lock_bh(&bench->lock);
+	bench->start_ns = bench->stop_ns = bench->cpu_ns = 0;
+	bench->tx_pkts = bench->tx_bytes = bench->tx_busy = 0;
+	bench->tx_acks = bench->tx_errs = 0;
+	bench->rx_pkts = bench->rx_bytes = 0;
+	qdf_mem_zero(bench->ack_hist, sizeof(bench->ack_hist));
+	qdf_mem_zero(bench->rtt_hist, sizeof(bench->rtt_hist));
+	qdf_spin_unlock_bh(&bench->lock);
+}
+
+static void epping_bench_stop(epping_context_t *pEpping_ctx)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+
+	if (bench->thread) {
+		kthread_stop(bench->thread);
+		bench->thread = NULL;
+	}
+}
+
+static int epping_bench_start(epping_context_t *pEpping_ctx, uint32_t mode)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	struct task_struct *thread;
+
+	if (!pEpping_ctx->epping_adapter)
+		return -ENODEV;
+	if (!(bench->streams & 0x3) || !bench->burst)
+		return -EINVAL;
+
+	epping_bench_stop(pEpping_ctx);
+	epping_bench_reset(bench);
+
+	bench->mode = mode;
+	bench->start_ns = ktime_get_ns();
+	bench->cpu_ns = epping_bench_cpu_ns();
+	bench->running = true;
+	thread = kthread_run(epping_bench_thread, pEpping_ctx, "epping_bench");
+	if (IS_ERR(thread)) {
+		bench->running = false;
+		return PTR_ERR(thread);
+	}
+	bench->thread = thread;
+
+	return 0;
+}
+
+#ifdef WLAN_DEBUGFS
+static uint32_t epping_bench_percentile(const uint32_t *hist, int pct)
+{
+	uint64_t count = 0, want, seen = 0;
+	int i;
+
+	for (i = 0; i < EPPING_BENCH_LAT_BUCKETS; i++)
+		count += hist[i];
+	if (!count)
+		return 0;
+
+	want = div_u64(count * pct + 99, 100);
+	for (i = 0; i < EPPING_BENCH_LAT_BUCKETS - 1; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			break;
+	}
+
+	return 1U << i;
+}
+
+static void epping_bench_show_hist(struct seq_file *s, const char *name,
+				   const uint32_t *hist)
+{
+	int i;
+
+	seq_printf(s, "%s p50 <%uus p99 <%uus:", name,
+		   epping_bench_percentile(hist, 50),
+		   epping_bench_percentile(hist, 99));
+	for (i = 0; i < EPPING_BENCH_LAT_BUCKETS; i++)
+		seq_printf(s, " %u", hist[i]);
+	seq_puts(s, "\n");
+}
+
+static int epping_bench_show(struct seq_file *s, void *data)
+{
+	epping_context_t *pEpping_ctx = s->private;
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	uint64_t elapsed, cpu_ns, pkts;
+
+	mutex_lock(&bench->ctrl_lock);
+	if (bench->running) {
+		elapsed = ktime_get_ns() - bench->start_ns;
+		cpu_ns = epping_bench_cpu_ns() - bench->cpu_ns;
+	} else {
+		elapsed = bench->stop_ns - bench->start_ns;
+		cpu_ns = bench->cpu_ns;
+	}
+	elapsed = max_t(uint64_t, div_u64(elapsed, NSEC_PER_USEC), 1);
+	pkts = max_t(uint64_t, bench->tx_pkts + bench->rx_pkts, 1);
+
+	seq_printf(s, "mode %s, %s, %llu ms\n",
+		   epping_bench_mode_name[bench->mode],
+		   bench->running ? "running" : "stopped",
+		   div_u64(elapsed, USEC_PER_MSEC));
+	seq_printf(s, "pkt_len %u burst %u gap_us %u streams 0x%x\n",
+		   bench->pkt_len, bench->burst, bench->gap_us,
+		   bench->streams);
+	seq_printf(s, "tx %llu pkts %llu bytes %llu Mbps, acks %llu busy %llu errs %llu\n",
+		   bench->tx_pkts, bench->tx_bytes,
+		   div64_u64(bench->tx_bytes * 8, elapsed), bench->tx_acks,
+		   bench->tx_busy, bench->tx_errs);
+	seq_printf(s, "rx %llu pkts %llu bytes %llu Mbps\n",
+		   bench->rx_pkts, bench->rx_bytes,
+		   div64_u64(bench->rx_bytes * 8, elapsed));
+	seq_printf(s, "cpu %llu ns/pkt\n", div64_u64(cpu_ns, pkts));
+	seq_puts(s, "# latency buckets: <1us, doubling, last is the rest\n");
+	epping_bench_show_hist(s, "tx_ack", bench->ack_hist);
+	epping_bench_show_hist(s, "rtt", bench->rtt_hist);
+	mutex_unlock(&bench->ctrl_lock);
+
+	return 0;
+}
+
+static ssize_t epping_bench_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	epping_context_t *pEpping_ctx =
+		((struct seq_file *)file->private_data)->private;
+	struct epping_bench *bench = &pEpping_ctx->bench;
+	char buf[32], *cmd;
+	int ret = -EINVAL;
+	int mode;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	cmd = strim(buf);
+
+	mutex_lock(&bench->ctrl_lock);
+	if (!strcmp(cmd, "stop")) {
+		epping_bench_stop(pEpping_ctx);
+		ret = 0;
+	} else if (!strcmp(cmd, "reset")) {
+		if (!bench->thread) {
+			epping_bench_reset(bench);
+			ret = 0;
+		} else {
+			ret = -EBUSY;
+		}
+	} else {
+		for (mode = 0; mode < EPPING_BENCH_MODES; mode++)
+			if (!strcmp(cmd, epping_bench_mode_name[mode]))
+				break;
+		if (mode < EPPING_BENCH_MODES)
+			ret = epping_bench_start(pEpping_ctx, mode);
+	}
+	mutex_unlock(&bench->ctrl_lock);
+
+	return ret ? ret : count;
+}
+
+static int epping_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, epping_bench_show, inode->i_private);
+}
+
+static const struct file_operations epping_bench_fops = {
+	.open = epping_bench_open,
+	.read = seq_read,
+	.write = epping_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+	.owner = THIS_MODULE,
+};
+
+static void epping_bench_debugfs_init(epping_context_t *pEpping_ctx)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+
+	bench->dir = debugfs_create_dir("epping", NULL);
+	if (!bench->dir) {
+		EPPING_LOG(QDF_TRACE_LEVEL_ERROR,
+			   "%s: failed to create debugfs", __func__);
+		return;
+	}
+
+	debugfs_create_file("bench", 0600, bench->dir, pEpping_ctx,
+			    &epping_bench_fops);
+	debugfs_create_u32("pkt_len", 0600, bench->dir, &bench->pkt_len);
+	debugfs_create_u32("burst", 0600, bench->dir, &bench->burst);
+	debugfs_create_u32("gap_us", 0600, bench->dir, &bench->gap_us);
+	debugfs_create_x32("streams", 0600, bench->dir, &bench->streams);
+	debugfs_create_u32("duration_ms", 0600, bench->dir,
+			   &bench->duration_ms);
+}
+
+static void epping_bench_debugfs_remove(epping_context_t *pEpping_ctx)
+{
+	debugfs_remove_recursive(pEpping_ctx->bench.dir);
+	pEpping_ctx->bench.dir = NULL;
+}
+#else
+static void epping_bench_debugfs_init(epping_context_t *pEpping_ctx)
+{
+}
+
+static void epping_bench_debugfs_remove(epping_context_t *pEpping_ctx)
+{
+}
+#endif /* WLAN_DEBUGFS */
+
+void epping_bench_init(epping_context_t *pEpping_ctx)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+
+	mutex_init(&bench->ctrl_lock);
+	qdf_spinlock_create(&bench->lock);
+	bench->thread = NULL;
+	bench->running = false;
+	bench->mode = EPPING_BENCH_ECHO;
+	bench->pkt_len = 1500;
+	bench->burst = 32;
+	bench->gap_us = 0;
+	bench->streams = 0x1;
+	bench->duration_ms = 10000;
+	epping_bench_reset(bench);
+
+	epping_bench_debugfs_init(pEpping_ctx);
+}
+
+void epping_bench_deinit(epping_context_t *pEpping_ctx)
+{
+	struct epping_bench *bench = &pEpping_ctx->bench;
+
+	epping_bench_debugfs_remove(pEpping_ctx);
+
+	mutex_lock(&bench->ctrl_lock);
+	epping_bench_stop(pEpping_ctx);
+	mutex_unlock(&bench->ctrl_lock);
+	qdf_spinlock_destroy(&bench->lock);
+}
@@ -113,6 +113,7 @@ void epping_disable(void)
 	}
 
 	if (pEpping_ctx->epping_adapter) {
+		epping_bench_deinit(pEpping_ctx);
 		epping_destroy_adapter(pEpping_ctx->epping_adapter);
 		pEpping_ctx->epping_adapter = NULL;
 	}
@@ -336,6 +337,7 @@ int epping_enable(struct device *parent_dev)
 		epping_cookie_cleanup(pEpping_ctx);
 		goto error_end;
 	}
+	epping_bench_init(pEpping_ctx);
 
 	EPPING_LOG(QDF_TRACE_LEVEL_INFO_HIGH, "%s: Exit", __func__);
 	return ret;
@@ -127,6 +127,8 @@ void epping_rx(void *ctx, HTC_PACKET *pPacket)
 		if (EPPING_ALIGNMENT_PAD > 0) {
 			A_NETBUF_PULL(pktSkb, EPPING_ALIGNMENT_PAD);
 		}
+		if (epping_bench_rx(pEpping_ctx, pktSkb))
+			return;
 		if (enb_rx_dump)
 			epping_hex_dump((void *)qdf_nbuf_data(pktSkb),
 					pktSkb->len, __func__);
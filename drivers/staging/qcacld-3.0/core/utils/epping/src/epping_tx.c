@@ -159,6 +159,45 @@ static int epping_tx_send_int(qdf_nbuf_t skb, epping_adapter_t *pAdapter)
 	return 0;
 }
 
+/**
+ * epping_tx_bench_send() - send a benchmark packet
+ * @pAdapter: epping adapter
+ * @skb: packet starting with its EPPING_HEADER
+ * @eid: HTC endpoint to send on
+ *
+ * Unlike epping_tx_send() there is no nodrop queueing and running out of
+ * cookies is not logged, the caller frees @skb on failure and retries.
+ *
+ * Return: 0 on success, -EBUSY without tx resource, -EIO if HTC failed
+ */
+int epping_tx_bench_send(epping_adapter_t *pAdapter, qdf_nbuf_t skb,
+			 HTC_ENDPOINT_ID eid)
+{
+	struct epping_cookie *cookie;
+	int skb_len = qdf_nbuf_len(skb);
+
+	cookie = epping_alloc_cookie(pAdapter->pEpping_ctx);
+	if (cookie == NULL)
+		return -EBUSY;
+
+	if (EPPING_ALIGNMENT_PAD > 0)
+		A_NETBUF_PUSH(skb, EPPING_ALIGNMENT_PAD);
+	cookie->bench_ts = ktime_get_ns();
+	SET_HTC_PACKET_INFO_TX(&cookie->HtcPkt,
+			       cookie, qdf_nbuf_data(skb), qdf_nbuf_len(skb),
+			       eid, 0);
+	SET_HTC_PACKET_NET_BUF_CONTEXT(&cookie->HtcPkt, skb);
+	if (htc_send_pkt(pAdapter->pEpping_ctx->HTCHandle, &cookie->HtcPkt) !=
+	    QDF_STATUS_SUCCESS) {
+		epping_free_cookie(pAdapter->pEpping_ctx, cookie);
+		return -EIO;
+	}
+	pAdapter->stats.tx_bytes += skb_len;
+	++pAdapter->stats.tx_packets;
+
+	return 0;
+}
+
 void epping_tx_timer_expire(epping_adapter_t *pAdapter)
 {
 	qdf_nbuf_t nodrop_skb;
@@ -375,6 +414,9 @@ void epping_tx_complete(void *ctx, HTC_PACKET *htc_pkt)
 		flushing = false;
 	}
 
+	if (cookie->bench_ts)
+		epping_bench_tx_done(pEpping_ctx, cookie->bench_ts,
+				     QDF_IS_STATUS_SUCCESS(status));
 	epping_free_cookie(pAdapter->pEpping_ctx, cookie);
 	qdf_spin_unlock_bh(&pAdapter->data_lock);
 
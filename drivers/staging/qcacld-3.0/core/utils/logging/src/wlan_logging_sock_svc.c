@@ -84,6 +84,9 @@ static uint8_t grx_count;
 #endif
 #define MAX_LOGMSG_LENGTH 2048
 #define MAX_SKBMSG_LENGTH 4096
+/* Upper bound of a batch of coalesced log buffers sent in one message */
+#define MAX_LOGBATCH_LENGTH 16384
+#define LOG_PACE_MIN_MS 10
 #define MAX_PKTSTATS_LENGTH 2048
 #define MAX_PKTSTATS_BUFF   16
 
@@ -99,6 +102,8 @@ struct log_msg {
 	unsigned int index;
 	/* indicates the current filled log length in logbuf */
 	unsigned int filled_length;
+	/* jiffies at which the buffer was queued to the filled list */
+	unsigned long queued;
 	/*
 	 * Buf to hold the log msg
 	 * tAniHdr + log
@@ -169,9 +174,41 @@ struct wlan_logging {
 	unsigned int pkt_stat_drop_cnt;
 	spinlock_t pkt_stats_lock;
 	unsigned int pkt_stats_msg_idx;
+	/* delay between deliveries while the consumer is not keeping up */
+	unsigned int pace_ms;
+	/* delivery stats */
+	unsigned int send_fail_count;
+	unsigned int batch_count;
+	unsigned int batched_buf_count;
+	unsigned int lat_max_ms;
+	unsigned int lat_last_ms;
 };
 
 static struct wlan_logging gwlan_logging;
+
+/*
+ * Filled log buffers of the same radio are coalesced into a single
+ * ANI_NL_MSG_LOG_TYPE message of up to log_batch_len bytes; setting it
+ * to MAX_LOGMSG_LENGTH sends one buffer per message as before. When a
+ * send fails the thread backs off for up to log_pace_max_ms between
+ * deliveries, so the backlog is flushed in fewer, larger messages.
+ */
+static unsigned int log_batch_len = 8192;
+module_param(log_batch_len, uint, 0644);
+MODULE_PARM_DESC(log_batch_len, "Max bytes of host logs sent per message");
+
+static unsigned int log_pace_max_ms = 100;
+module_param(log_pace_max_ms, uint, 0644);
+MODULE_PARM_DESC(log_pace_max_ms, "Max delivery back off when userspace lags");
+
+module_param_named(log_drop_count, gwlan_logging.drop_count, uint, 0444);
+module_param_named(log_send_fail_count, gwlan_logging.send_fail_count,
+		   uint, 0444);
+module_param_named(log_batch_count, gwlan_logging.batch_count, uint, 0444);
+module_param_named(log_batched_buf_count, gwlan_logging.batched_buf_count,
+		   uint, 0444);
+module_param_named(log_lat_max_ms, gwlan_logging.lat_max_ms, uint, 0444);
+module_param_named(log_lat_last_ms, gwlan_logging.lat_last_ms, uint, 0444);
 static struct log_msg gplog_msg[MAX_LOGMSG_COUNT];
 static struct pkt_stats_msg *gpkt_stats_buffers;
 
@@ -238,6 +275,7 @@ static int wlan_queue_logmsg_for_app(void)
 		ANI_NL_MSG_LOG_TYPE;
 	*(unsigned short *)(gwlan_logging.pcur_node->logbuf + 2) =
 		gwlan_logging.pcur_node->filled_length;
+	gwlan_logging.pcur_node->queued = jiffies;
 	list_add_tail(&gwlan_logging.pcur_node->node,
 		      &gwlan_logging.filled_list);
 
@@ -616,28 +654,89 @@ err:
 
 }
 
+/**
+ * wlan_logging_dequeue_batch() - move a batch of filled buffers to a list
+ * @batch: list receiving the buffers, oldest first
+ * @max_len: max number of log bytes in the batch
+ *
+ * Takes the oldest filled buffer and as many of the following ones of the
+ * same radio as fit in @max_len. Need to call this with spin_lock acquired.
+ *
+ * Return: number of log bytes in the batch
+ */
+static unsigned int wlan_logging_dequeue_batch(struct list_head *batch,
+					       unsigned int max_len)
+{
+	struct log_msg *plog_msg, *first;
+	unsigned int len = 0;
+
+	first = list_first_entry(&gwlan_logging.filled_list,
+				 struct log_msg, node);
+	while (!list_empty(&gwlan_logging.filled_list)) {
+		plog_msg = list_first_entry(&gwlan_logging.filled_list,
+					    struct log_msg, node);
+		if (plog_msg != first &&
+		    (plog_msg->radio != first->radio ||
+		     len + plog_msg->filled_length > max_len))
+			break;
+		len += plog_msg->filled_length;
+		list_move_tail(&plog_msg->node, batch);
+	}
+
+	return len;
+}
+
+/**
+ * wlan_logging_update_pace() - adapt the delivery pace to the consumer
+ * @ret: result of the last send
+ *
+ * Back off exponentially while sends fail, and decay back to delivering
+ * as soon as buffers fill once they go through again.
+ */
+static void wlan_logging_update_pace(int ret)
+{
+	unsigned int pace = gwlan_logging.pace_ms;
+
+	if (ret < 0 && ret != -ESRCH) {
+		gwlan_logging.send_fail_count++;
+		pace = max_t(unsigned int, pace * 2, LOG_PACE_MIN_MS);
+		pace = min(pace, log_pace_max_ms);
+	} else {
+		pace /= 2;
+		if (pace < LOG_PACE_MIN_MS)
+			pace = 0;
+	}
+	gwlan_logging.pace_ms = pace;
+}
+
 static int send_filled_buffers_to_user(void)
 {
 	int ret = -1;
-	struct log_msg *plog_msg;
+	struct log_msg *plog_msg, *tmp;
 	int payload_len;
 	int tot_msg_len;
+	unsigned int max_len, log_len, lat_ms;
+	char *ptr;
 	tAniNlHdr *wnl;
 	struct sk_buff *skb = NULL;
 	struct nlmsghdr *nlh;
 	static int nlmsg_seq;
 	unsigned long flags;
 	static int rate_limit;
+	LIST_HEAD(batch);
+
+	max_len = clamp_t(unsigned int, log_batch_len, MAX_LOGMSG_LENGTH,
+			  MAX_LOGBATCH_LENGTH);
 
 	while (!list_empty(&gwlan_logging.filled_list)
 	       && !gwlan_logging.exit) {
 
-		skb = dev_alloc_skb(MAX_LOGMSG_LENGTH);
+		skb = dev_alloc_skb(max_len);
 		if (skb == NULL) {
 			if (!rate_limit) {
 				pr_err
 					("%s: dev_alloc_skb() failed for msg size[%d] drop count = %u\n",
-					__func__, MAX_LOGMSG_LENGTH,
+					__func__, max_len,
 					gwlan_logging.drop_count);
 			}
 			rate_limit = 1;
@@ -647,22 +746,28 @@ static int send_filled_buffers_to_user(void)
 		rate_limit = 0;
 
 		spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-
-		plog_msg = (struct log_msg *)
-			   (gwlan_logging.filled_list.next);
-		list_del_init(gwlan_logging.filled_list.next);
+		if (list_empty(&gwlan_logging.filled_list)) {
+			spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
+			dev_kfree_skb(skb);
+			break;
+		}
+		/* room left in the skb once the headers are accounted */
+		log_len = wlan_logging_dequeue_batch(&batch, max_len -
+				NLMSG_SPACE(sizeof(wnl->radio) +
+					    sizeof(tAniHdr)));
 		spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
+
+		plog_msg = list_first_entry(&batch, struct log_msg, node);
 		/* 4 extra bytes for the radio idx */
-		payload_len = plog_msg->filled_length +
-			      sizeof(wnl->radio) + sizeof(tAniHdr);
+		payload_len = log_len + sizeof(wnl->radio) + sizeof(tAniHdr);
 
 		tot_msg_len = NLMSG_SPACE(payload_len);
 		nlh = nlmsg_put(skb, 0, nlmsg_seq++,
 				ANI_NL_MSG_LOG, payload_len, NLM_F_REQUEST);
 		if (NULL == nlh) {
 			spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-			list_add_tail(&plog_msg->node,
-				      &gwlan_logging.free_list);
+			list_splice_tail_init(&batch,
+					      &gwlan_logging.free_list);
 			spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
 			pr_err("%s: drop_count = %u\n", __func__,
 			       ++gwlan_logging.drop_count);
@@ -674,21 +779,38 @@ static int send_filled_buffers_to_user(void)
 			continue;
 		}
 
+		lat_ms = jiffies_to_msecs(jiffies - plog_msg->queued);
+		gwlan_logging.lat_last_ms = lat_ms;
+		if (lat_ms > gwlan_logging.lat_max_ms)
+			gwlan_logging.lat_max_ms = lat_ms;
+
 		wnl = (tAniNlHdr *) nlh;
 		wnl->radio = plog_msg->radio;
-		memcpy(&wnl->wmsg, plog_msg->logbuf,
-		       plog_msg->filled_length + sizeof(tAniHdr));
+		ptr = (char *)&wnl->wmsg;
+		memcpy(ptr, plog_msg->logbuf, sizeof(tAniHdr));
+		*(unsigned short *)(ptr + 2) = log_len;
+		ptr += sizeof(tAniHdr);
+		list_for_each_entry(tmp, &batch, node) {
+			memcpy(ptr, &tmp->logbuf[sizeof(tAniHdr)],
+			       tmp->filled_length);
+			ptr += tmp->filled_length;
+			gwlan_logging.batched_buf_count++;
+		}
+		gwlan_logging.batch_count++;
 
 		spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-		list_add_tail(&plog_msg->node, &gwlan_logging.free_list);
+		list_splice_tail_init(&batch, &gwlan_logging.free_list);
 		spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
 
 		ret = nl_srv_bcast_host_logs(skb);
+		wlan_logging_update_pace(ret);
 		/* print every 64th drop count */
 		if (ret < 0 && (!(gwlan_logging.drop_count % 0x40))) {
 			pr_err("%s: Send Failed %d drop_count = %u\n",
 			       __func__, ret, ++gwlan_logging.drop_count);
 		}
+		if (gwlan_logging.pace_ms)
+			break;
 	}
 
 	return ret;
@@ -796,6 +918,13 @@ static int wlan_logging_thread(void *Arg)
 			ret = send_filled_buffers_to_user();
 			if (-ENOMEM == ret)
 				msleep(200);
+			else if (gwlan_logging.pace_ms)
+				msleep(gwlan_logging.pace_ms);
+			/* buffers that filled while we were backing off */
+			if (gwlan_logging.pace_ms &&
+			    !list_empty(&gwlan_logging.filled_list))
+				set_bit(HOST_LOG_DRIVER_MSG,
+					&gwlan_logging.eventFlag);
 			if (WLAN_LOG_INDICATOR_HOST_ONLY ==
 			   cds_get_log_indicator()) {
 				send_flush_completion_to_user(
@@ -936,6 +1065,7 @@ int wlan_logging_sock_init_svc(void)
 	wake_up_process(gwlan_logging.thread);
 	gwlan_logging.is_active = true;
 	gwlan_logging.is_flush_complete = false;
+	gwlan_logging.pace_ms = 0;
 
 	return 0;
 
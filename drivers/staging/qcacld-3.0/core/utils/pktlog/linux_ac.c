@@ -30,6 +30,7 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <linux/proc_fs.h>
 #include <pktlog_ac_i.h>
 #include <pktlog_ac_fmt.h>
@@ -77,11 +78,13 @@ static int pktlog_open(struct inode *i, struct file *f);
 static int pktlog_release(struct inode *i, struct file *f);
 static ssize_t pktlog_read(struct file *file, char *buf, size_t nbytes,
 			   loff_t *ppos);
+static int pktlog_mmap(struct file *file, struct vm_area_struct *vma);
 
 static struct file_operations pktlog_fops = {
 	open:  pktlog_open,
 	release:pktlog_release,
 	read : pktlog_read,
+	mmap : pktlog_mmap,
 };
 
 /*
@@ -1057,6 +1060,93 @@ pktlog_read(struct file *file, char *buf, size_t nbytes, loff_t *ppos)
 	return ret;
 }
 
+/*
+ * The log buffer pages are handed to user space one by one on fault, so
+ * that a mapping survives a buffer resize: the pages it already faulted in
+ * stay referenced, anything past them gets SIGBUS.
+ */
+static int pktlog_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct ath_pktlog_info *pl_info = vma->vm_private_data;
+	unsigned long offset = vmf->pgoff << PAGE_SHIFT;
+	struct page *page;
+
+	spin_lock_bh(&pl_info->log_lock);
+	if (!pl_info->buf ||
+	    offset >= sizeof(*pl_info->buf) + pl_info->buf_size) {
+		spin_unlock_bh(&pl_info->log_lock);
+		return VM_FAULT_SIGBUS;
+	}
+
+	page = vmalloc_to_page((char *)pl_info->buf + offset);
+	get_page(page);
+	spin_unlock_bh(&pl_info->log_lock);
+
+	vmf->page = page;
+	return 0;
+}
+
+static const struct vm_operations_struct pktlog_vmops = {
+	.fault = pktlog_fault,
+};
+
+/**
+ * __pktlog_mmap() - map the packet log buffer read-only
+ * @file: pktlog proc file
+ * @vma: user mapping, must start at offset 0
+ *
+ * The mapping exposes struct ath_pktlog_buf as is: the buffer header,
+ * the read and write offsets and the ring of ath_pktlog_hdr records.
+ * While the file is open logging is paused, same as for read(), so the
+ * whole ring can be parsed in place without copies.
+ *
+ * Return: 0 on success, negative errno otherwise
+ */
+static int __pktlog_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ath_pktlog_info *pl_info;
+	unsigned long size;
+
+	if (cds_is_module_state_transitioning()) {
+		pr_info("%s: module transition in progress", __func__);
+		return -EAGAIN;
+	}
+
+	pl_info = (struct ath_pktlog_info *)
+					PDE_DATA(file->f_path.dentry->d_inode);
+	if (!pl_info)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	spin_lock_bh(&pl_info->log_lock);
+	size = pl_info->buf ? PAGE_ALIGN(sizeof(*pl_info->buf) +
+					 pl_info->buf_size) : 0;
+	spin_unlock_bh(&pl_info->log_lock);
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > size)
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_ops = &pktlog_vmops;
+	vma->vm_private_data = pl_info;
+
+	return 0;
+}
+
+static int pktlog_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret;
+
+	cds_ssr_protect(__func__);
+	ret = __pktlog_mmap(file, vma);
+	cds_ssr_unprotect(__func__);
+
+	return ret;
+}
+
 int pktlogmod_init(void *context)
 {
 	int ret;
@@ -77,6 +77,23 @@ enum lmh_hw_trips {
 	LIMITS_TRIP_MAX,
 };
 
+/**
+ * struct lmh_dcvs_stats - time spent below the maximum frequency
+ * @last: time the current limit took effect
+ * @throttled_us: total time with the limit below the maximum frequency
+ * @lost_khz_us: integral of (max_freq - limit) over time
+ * @events: number of times the cluster entered a throttled state
+ * @min_limit: lowest limit seen
+ */
+struct lmh_dcvs_stats {
+	spinlock_t lock;
+	ktime_t last;
+	u64 throttled_us;
+	u64 lost_khz_us;
+	u32 events;
+	u32 min_limit;
+};
+
 struct msm_lmh_dcvs_hw {
 	char sensor_name[THERMAL_NAME_LENGTH];
 	uint32_t affinity;
@@ -92,10 +109,47 @@ struct msm_lmh_dcvs_hw {
 	uint32_t hw_freq_limit;
 	struct list_head list;
 	DECLARE_BITMAP(is_irq_enabled, 1);
+	struct lmh_dcvs_stats stats;
 };
 
 LIST_HEAD(lmh_dcvs_hw_list);
 
+/* Charge the time since the last update to the limit that was in effect */
+static void lmh_dcvs_stats_account(struct msm_lmh_dcvs_hw *hw, ktime_t now)
+{
+	struct lmh_dcvs_stats *st = &hw->stats;
+	u64 delta = ktime_us_delta(now, st->last);
+
+	if (hw->hw_freq_limit && hw->hw_freq_limit < hw->max_freq) {
+		st->throttled_us += delta;
+		st->lost_khz_us += delta * (hw->max_freq - hw->hw_freq_limit);
+	}
+	st->last = now;
+}
+
+static void lmh_dcvs_stats_update(struct msm_lmh_dcvs_hw *hw, uint32_t limit)
+{
+	struct lmh_dcvs_stats *st = &hw->stats;
+	bool was_throttled, throttled;
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	lmh_dcvs_stats_account(hw, ktime_get());
+	was_throttled = hw->hw_freq_limit < hw->max_freq;
+	throttled = limit < hw->max_freq;
+	if (throttled && !was_throttled)
+		st->events++;
+	if (limit < st->min_limit)
+		st->min_limit = limit;
+	hw->hw_freq_limit = limit;
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	if (throttled != was_throttled)
+		trace_lmh_dcvs_throttle(cpumask_first(&hw->core_map), limit,
+			hw->max_freq, st->throttled_us,
+			div_u64(st->lost_khz_us, 1000000));
+}
+
 static void msm_lmh_dcvs_get_max_freq(uint32_t cpu, uint32_t *max_freq)
 {
 	unsigned long freq_ceil = UINT_MAX;
@@ -151,7 +205,7 @@ static uint32_t msm_lmh_mitigation_notify(struct msm_lmh_dcvs_hw *hw)
 	trace_lmh_dcvs_freq(cpumask_first(&hw->core_map), max_limit);
 
 notify_exit:
-	hw->hw_freq_limit = max_limit;
+	lmh_dcvs_stats_update(hw, max_limit);
 	return max_limit;
 }
 
@@ -369,6 +423,18 @@ static int lmh_get_cur_limit(int cpu, unsigned long *freq)
 	return 0;
 }
 
+int msm_lmh_dcvs_get_hw_limit(int cpu, uint32_t *freq)
+{
+	struct msm_lmh_dcvs_hw *hw = get_dcvsh_hw_from_cpu(cpu);
+
+	if (!hw || !hw->hw_freq_limit)
+		return -EINVAL;
+	*freq = hw->hw_freq_limit;
+
+	return 0;
+}
+EXPORT_SYMBOL(msm_lmh_dcvs_get_hw_limit);
+
 static struct cpu_cooling_ops cd_ops = {
 	.get_cur_state = lmh_get_cur_limit,
 	.ceil_limit = lmh_set_max_limit,
@@ -411,6 +477,53 @@ static struct notifier_block __refdata lmh_dcvs_cpu_notifier = {
 	.notifier_call = lmh_dcvs_cpu_callback,
 };
 
+static ssize_t throttle_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct msm_lmh_dcvs_hw *hw = dev_get_drvdata(dev);
+	struct lmh_dcvs_stats *st = &hw->stats;
+	unsigned long flags;
+	u64 throttled_us, lost_khz_us;
+	u32 events, min_limit, limit;
+
+	spin_lock_irqsave(&st->lock, flags);
+	lmh_dcvs_stats_account(hw, ktime_get());
+	throttled_us = st->throttled_us;
+	lost_khz_us = st->lost_khz_us;
+	events = st->events;
+	min_limit = st->min_limit;
+	limit = hw->hw_freq_limit;
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	return snprintf(buf, PAGE_SIZE,
+		"cpus: %*pbl\nmax_freq_khz: %u\ncur_limit_khz: %u\n"
+		"min_limit_khz: %u\nthrottle_events: %u\n"
+		"throttled_ms: %llu\nfreq_loss_mhz_ms: %llu\n",
+		cpumask_pr_args(&hw->core_map), hw->max_freq, limit,
+		min_limit, events, div_u64(throttled_us, USEC_PER_MSEC),
+		div_u64(lost_khz_us, 1000000));
+}
+
+/* Any write clears the counters */
+static ssize_t throttle_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct msm_lmh_dcvs_hw *hw = dev_get_drvdata(dev);
+	struct lmh_dcvs_stats *st = &hw->stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->last = ktime_get();
+	st->throttled_us = 0;
+	st->lost_khz_us = 0;
+	st->events = 0;
+	st->min_limit = hw->hw_freq_limit;
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(throttle_stats);
+
 static int msm_lmh_dcvs_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -517,6 +630,9 @@ static int msm_lmh_dcvs_probe(struct platform_device *pdev)
 	}
 
 	hw->hw_freq_limit = hw->max_freq = max_freq;
+	spin_lock_init(&hw->stats.lock);
+	hw->stats.last = ktime_get();
+	hw->stats.min_limit = max_freq;
 
 	switch (affinity) {
 	case 0:
@@ -566,6 +682,11 @@ static int msm_lmh_dcvs_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&hw->list);
 	list_add(&hw->list, &lmh_dcvs_hw_list);
 
+	platform_set_drvdata(pdev, hw);
+	if (device_create_file(&pdev->dev, &dev_attr_throttle_stats))
+		pr_err("Error creating throttle_stats for %s\n",
+			hw->sensor_name);
+
 	/* Better register explicitly for 1st CPU of each HW */
 	lmh_dcvs_cpu_callback(&lmh_dcvs_cpu_notifier, CPU_ONLINE,
 			(void *)(long)cpumask_first(&hw->core_map));
@@ -87,6 +87,12 @@
 #define MSM_THERMAL_THRESH_UPDATE "update"
 #define DEVM_NAME_MAX 30
 #define HOTPLUG_RETRY_INTERVAL_MS 100
+#define BUDGET_MAX_CLUSTERS 4
+#define BUDGET_MAX_ACTORS (BUDGET_MAX_CLUSTERS + MSM_BUDGET_NR_EXT)
+#define BUDGET_DEFAULT_WEIGHT 256
+#define BUDGET_DEFAULT_POLL_MS 100
+#define BUDGET_DEFAULT_HORIZON_MS 2000
+#define BUDGET_DEFAULT_SWITCH_ON_DEGC 10
 #define UIO_VERSION "1.0"
 
 #define CXIP_LM_BASE_ADDRESS      0x1FE5000
@@ -267,6 +273,7 @@ struct cpu_info {
 	uint32_t shutdown_max_freq;
 	uint32_t suspend_max_freq;
 	uint32_t vdd_max_freq;
+	uint32_t budget_max_freq;
 	uint32_t user_min_freq;
 	uint32_t limited_max_freq;
 	uint32_t limited_min_freq;
@@ -389,6 +396,66 @@ static struct msm_thermal_debugfs_entry *msm_therm_debugfs;
 static struct devmgr_devices *devices;
 static struct msm_thermal_debugfs_thresh_config *mit_config;
 
+/**
+ * struct budget_actor - one consumer of the power budget
+ * @weight: share of the budget relative to the other actors
+ * @req_mw: power the actor would draw without a limit
+ * @grant_mw: power the actor is allowed to draw
+ * @cluster: CPU cluster of the actor, NULL for the GPU and modem
+ * @power_mw: per core power at each cluster frequency index
+ * @throttled_ms: time spent with the grant below the request
+ */
+struct budget_actor {
+	const char *name;
+	uint32_t weight;
+	uint32_t max_mw;
+	uint32_t req_mw;
+	uint32_t grant_mw;
+	struct cluster_info *cluster;
+	uint32_t dyn_coeff;
+	uint32_t *power_mw;
+	int nr_freqs;
+	bool throttled;
+	u64 throttled_ms;
+};
+
+/*
+ * Power budget controller. Rather than stepping frequency caps once a
+ * threshold is crossed, it predicts the temperature @horizon_ms ahead from
+ * the recent slope, turns the predicted error into a total power budget
+ * with a PI loop around the sustainable power and splits the budget
+ * between the actors according to their weight and request.
+ */
+static struct power_budget {
+	struct budget_actor actors[BUDGET_MAX_ACTORS];
+	int nr_clusters;
+	uint32_t dyn_coeff[BUDGET_MAX_CLUSTERS];
+	bool probed;
+	bool enabled;
+	bool active;
+	uint32_t sensor_id;
+	int32_t target_degC;
+	uint32_t sustainable_mw;
+	uint32_t switch_on_degc;
+	uint32_t k_po;
+	uint32_t k_pu;
+	uint32_t k_i;
+	uint32_t horizon_ms;
+	uint32_t poll_ms;
+	int32_t temp_mC;
+	int32_t pred_mC;
+	int32_t slope;
+	s64 integral;
+	uint32_t budget_mw;
+	u64 active_ms;
+	ktime_t last;
+	struct delayed_work work;
+	struct mutex lock;
+	struct kobject *kobj;
+} budget = {
+	.lock = __MUTEX_INITIALIZER(budget.lock),
+};
+
 struct vdd_rstr_enable {
 	struct kobj_attribute ko_attr;
 	uint32_t enabled;
@@ -3863,6 +3930,9 @@ static __ref int do_freq_mitigation(void *data)
 			max_freq_req = min(max_freq_req,
 					cpus[cpu].suspend_max_freq);
 
+			max_freq_req = min(max_freq_req,
+					cpus[cpu].budget_max_freq);
+
 			if (devices && devices->cpufreq_dev[cpu]) {
 				cpu_dev = devices->cpufreq_dev[cpu];
 				mutex_lock(&cpu_dev->clnt_lock);
@@ -4018,6 +4088,340 @@ init_freq_thread:
 	}
 }
 
+static struct budget_actor *budget_ext_actor(
+		enum msm_thermal_budget_actor actor)
+{
+	return &budget.actors[BUDGET_MAX_CLUSTERS + actor];
+}
+
+#define for_each_budget_actor(_b, _i) \
+	for (_i = 0; _i < BUDGET_MAX_ACTORS; _i++) \
+		if ((_b = &budget.actors[_i]) && \
+			(_i < budget.nr_clusters || \
+			(_i >= BUDGET_MAX_CLUSTERS && _b->max_mw)))
+
+/* Build the per core power table of each cluster from its voltage plan */
+static int budget_init_clusters(void)
+{
+	struct cluster_info *cluster_ptr;
+	struct budget_actor *act;
+	uint32_t *volt = NULL;
+	int i, j, ret = 0;
+
+	if (budget.nr_clusters)
+		return 0;
+	if (!core_ptr)
+		return -ENODEV;
+	if (!freq_table_get)
+		check_freq_table();
+
+	for (i = 0; i < min_t(int, core_ptr->entity_count,
+			BUDGET_MAX_CLUSTERS); i++) {
+		cluster_ptr = &core_ptr->child_entity_ptr[i];
+		if (!cluster_ptr->freq_table) {
+			ret = -EAGAIN;
+			goto fail;
+		}
+		act = &budget.actors[i];
+		act->nr_freqs = cluster_ptr->freq_idx_high + 1;
+		act->power_mw = kcalloc(act->nr_freqs, sizeof(*act->power_mw),
+				GFP_KERNEL);
+		volt = kcalloc(act->nr_freqs, sizeof(*volt), GFP_KERNEL);
+		if (!act->power_mw || !volt) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+		ret = msm_thermal_get_cluster_voltage_plan(
+				cluster_ptr->cluster_id, volt);
+		if (ret)
+			goto fail;
+
+		/* P = C * f * V^2, C in uW/MHz/V^2, f in MHz and V in mV */
+		for (j = 0; j < act->nr_freqs; j++)
+			act->power_mw[j] = div_u64((u64)budget.dyn_coeff[i] *
+				(cluster_ptr->freq_table[j].frequency / 1000) *
+				volt[j] * volt[j], 1000000000);
+		kfree(volt);
+		volt = NULL;
+
+		act->name = kasprintf(GFP_KERNEL, "cluster%d",
+				cluster_ptr->cluster_id);
+		act->cluster = cluster_ptr;
+		act->max_mw = act->power_mw[act->nr_freqs - 1] *
+			cpumask_weight(&cluster_ptr->cluster_cores);
+		act->grant_mw = act->max_mw;
+	}
+	budget.nr_clusters = i;
+	return 0;
+
+fail:
+	kfree(volt);
+	for (j = 0; j <= i && j < BUDGET_MAX_CLUSTERS; j++) {
+		kfree(budget.actors[j].power_mw);
+		budget.actors[j].power_mw = NULL;
+		kfree(budget.actors[j].name);
+		budget.actors[j].name = NULL;
+	}
+	return ret;
+}
+
+static int budget_freq_idx(struct budget_actor *act, uint32_t freq)
+{
+	int i;
+
+	for (i = act->nr_freqs - 1; i > 0; i--)
+		if (act->cluster->freq_table[i].frequency <= freq)
+			break;
+	return i;
+}
+
+/*
+ * A cluster asks for the power of its online cores at their current
+ * frequency. If LMH already holds the cluster below that, the hardware
+ * limit is what it can actually use and the rest goes to the others.
+ */
+static void budget_cluster_request(struct budget_actor *act)
+{
+	cpumask_t online;
+	uint32_t freq, hw_freq;
+	int cpu, nr;
+
+	cpumask_and(&online, &act->cluster->cluster_cores, cpu_online_mask);
+	nr = cpumask_weight(&online);
+	if (!nr) {
+		act->req_mw = 0;
+		return;
+	}
+	cpu = cpumask_first(&online);
+	freq = cpufreq_quick_get(cpu);
+	if (!msm_lmh_dcvs_get_hw_limit(cpu, &hw_freq))
+		freq = min(freq, hw_freq);
+	act->req_mw = act->power_mw[budget_freq_idx(act, freq)] * nr;
+}
+
+/* Split budget_mw by weighted request and hand out what the capped leave */
+static void budget_divvy(void)
+{
+	struct budget_actor *act;
+	u64 total_req = 0, headroom = 0, extra = 0;
+	int i;
+
+	for_each_budget_actor(act, i)
+		total_req += (u64)act->weight * act->req_mw;
+
+	for_each_budget_actor(act, i) {
+		if (total_req)
+			act->grant_mw = div64_u64((u64)budget.budget_mw *
+				act->weight * act->req_mw, total_req);
+		else
+			act->grant_mw = 0;
+		if (act->grant_mw > act->max_mw) {
+			extra += act->grant_mw - act->max_mw;
+			act->grant_mw = act->max_mw;
+		}
+		headroom += act->max_mw - act->grant_mw;
+	}
+	if (!extra || !headroom)
+		return;
+
+	for_each_budget_actor(act, i)
+		act->grant_mw += div64_u64(min(extra, headroom) *
+			(act->max_mw - act->grant_mw), headroom);
+}
+
+static bool budget_apply_cluster(struct budget_actor *act, bool release)
+{
+	uint32_t cap = UINT_MAX, per_core;
+	bool changed = false;
+	int cpu, nr, idx;
+
+	if (!release) {
+		nr = 0;
+		for_each_cpu(cpu, &act->cluster->cluster_cores)
+			if (cpu_online(cpu))
+				nr++;
+		per_core = act->grant_mw / max(nr, 1);
+		for (idx = act->nr_freqs - 1; idx > 0; idx--)
+			if (act->power_mw[idx] <= per_core)
+				break;
+		if (idx < act->nr_freqs - 1)
+			cap = act->cluster->freq_table[idx].frequency;
+	}
+	act->throttled = cap != UINT_MAX;
+
+	for_each_cpu(cpu, &act->cluster->cluster_cores) {
+		if (cpus[cpu].budget_max_freq == cap)
+			continue;
+		cpus[cpu].budget_max_freq = cap;
+		changed = true;
+	}
+	return changed;
+}
+
+static void budget_release(void)
+{
+	struct budget_actor *act;
+	bool notify = false;
+	int i;
+
+	for_each_budget_actor(act, i) {
+		act->grant_mw = act->max_mw;
+		act->throttled = false;
+		if (act->cluster)
+			notify |= budget_apply_cluster(act, true);
+	}
+	budget.active = false;
+	budget.integral = 0;
+	budget.budget_mw = UINT_MAX;
+	if (notify && freq_mitigation_task)
+		complete(&freq_mitigation_complete);
+}
+
+static void budget_update(void)
+{
+	struct budget_actor *act;
+	int32_t err, on_mC, temp = 0;
+	s64 inst, p, integ, total;
+	u64 max_total = 0;
+	uint32_t dt_ms;
+	ktime_t now;
+	bool notify = false;
+	int i;
+
+	if (budget_init_clusters())
+		return;
+	if (therm_get_temp(budget.sensor_id, THERM_TSENS_ID, &temp))
+		return;
+
+	now = ktime_get();
+	dt_ms = budget.last.tv64 ? ktime_ms_delta(now, budget.last) : 0;
+	budget.last = now;
+
+	/* Slope in mC per second, smoothed over a few samples */
+	if (dt_ms) {
+		inst = div_s64((s64)(temp * 1000 - budget.temp_mC) * 1000,
+				dt_ms);
+		budget.slope = (3 * (s64)budget.slope + inst) / 4;
+	}
+	budget.temp_mC = temp * 1000;
+	budget.pred_mC = budget.temp_mC + div_s64((s64)budget.slope *
+			budget.horizon_ms, 1000);
+
+	for_each_budget_actor(act, i) {
+		if (act->throttled)
+			act->throttled_ms += dt_ms;
+		max_total += act->max_mw;
+	}
+
+	on_mC = (budget.target_degC - (int32_t)budget.switch_on_degc) * 1000;
+	if (budget.pred_mC < on_mC) {
+		if (budget.active)
+			budget_release();
+		return;
+	}
+	if (budget.active)
+		budget.active_ms += dt_ms;
+	budget.active = true;
+
+	err = budget.target_degC * 1000 - budget.pred_mC;
+	p = div_s64((s64)err * (err > 0 ? budget.k_po : budget.k_pu), 1000);
+
+	/* Integrate only close to the target, to avoid winding up */
+	if (abs(err) < (int32_t)budget.switch_on_degc * 1000)
+		budget.integral += div_s64((s64)err * dt_ms, 1000);
+	integ = div_s64(budget.integral * budget.k_i, 1000);
+	if (abs(integ) > budget.sustainable_mw) {
+		integ = integ > 0 ? budget.sustainable_mw :
+			-(s64)budget.sustainable_mw;
+		if (budget.k_i)
+			budget.integral = div_s64(integ * 1000, budget.k_i);
+	}
+
+	total = (s64)budget.sustainable_mw + p + integ;
+	budget.budget_mw = clamp_t(s64, total, 0, max_total);
+
+	for_each_budget_actor(act, i)
+		if (act->cluster)
+			budget_cluster_request(act);
+	budget_divvy();
+
+	get_online_cpus();
+	for_each_budget_actor(act, i) {
+		if (act->cluster)
+			notify |= budget_apply_cluster(act, false);
+		else
+			act->throttled = act->grant_mw < act->req_mw;
+	}
+	put_online_cpus();
+	if (notify && freq_mitigation_task)
+		complete(&freq_mitigation_complete);
+}
+
+static void budget_work_fn(struct work_struct *work)
+{
+	mutex_lock(&budget.lock);
+	if (budget.enabled)
+		budget_update();
+	mutex_unlock(&budget.lock);
+	if (budget.enabled)
+		schedule_delayed_work(&budget.work,
+			msecs_to_jiffies(max_t(uint32_t, budget.poll_ms, 10)));
+}
+
+static void budget_enable(bool enable)
+{
+	mutex_lock(&budget.lock);
+	if (budget.enabled == enable) {
+		mutex_unlock(&budget.lock);
+		return;
+	}
+	budget.enabled = enable;
+	budget.last = ktime_set(0, 0);
+	budget.slope = 0;
+	if (!enable)
+		budget_release();
+	mutex_unlock(&budget.lock);
+
+	if (enable)
+		schedule_delayed_work(&budget.work, 0);
+	else
+		cancel_delayed_work_sync(&budget.work);
+}
+
+int msm_thermal_budget_request(enum msm_thermal_budget_actor actor,
+		uint32_t power_mw)
+{
+	struct budget_actor *act;
+
+	if (actor >= MSM_BUDGET_NR_EXT)
+		return -EINVAL;
+	act = budget_ext_actor(actor);
+	if (!act->max_mw)
+		return -ENODEV;
+
+	mutex_lock(&budget.lock);
+	act->req_mw = min(power_mw, act->max_mw);
+	mutex_unlock(&budget.lock);
+	return 0;
+}
+EXPORT_SYMBOL(msm_thermal_budget_request);
+
+uint32_t msm_thermal_budget_get(enum msm_thermal_budget_actor actor)
+{
+	struct budget_actor *act;
+	uint32_t grant;
+
+	if (actor >= MSM_BUDGET_NR_EXT)
+		return UINT_MAX;
+	act = budget_ext_actor(actor);
+
+	mutex_lock(&budget.lock);
+	grant = (budget.active && act->max_mw) ? act->grant_mw : UINT_MAX;
+	mutex_unlock(&budget.lock);
+	return grant;
+}
+EXPORT_SYMBOL(msm_thermal_budget_get);
+
 int msm_thermal_get_freq_plan_size(uint32_t cluster, unsigned int *table_len)
 {
 	uint32_t i = 0;
@@ -5094,6 +5498,133 @@ static __refdata struct attribute *cc_attrs[] = {
 static __refdata struct attribute_group cc_attr_group = {
 	.attrs = cc_attrs,
 };
+static ssize_t budget_enabled_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", budget.enabled);
+}
+
+static ssize_t budget_enabled_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	uint32_t val;
+	int ret;
+
+	if (!budget.probed)
+		return -ENODEV;
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+	budget_enable(!!val);
+	return count;
+}
+
+#define BUDGET_TUNABLE(_name, _type, _fmt, _conv) \
+static ssize_t budget_##_name##_show(struct kobject *kobj, \
+		struct kobj_attribute *attr, char *buf) \
+{ \
+	return snprintf(buf, PAGE_SIZE, _fmt "\n", budget._name); \
+} \
+static ssize_t budget_##_name##_store(struct kobject *kobj, \
+		struct kobj_attribute *attr, const char *buf, size_t count) \
+{ \
+	_type val; \
+	int ret; \
+	ret = _conv(buf, 10, &val); \
+	if (ret) \
+		return ret; \
+	mutex_lock(&budget.lock); \
+	budget._name = val; \
+	mutex_unlock(&budget.lock); \
+	return count; \
+} \
+static struct kobj_attribute budget_##_name##_attr = \
+__ATTR(_name, 0644, budget_##_name##_show, budget_##_name##_store)
+
+BUDGET_TUNABLE(target_degC, int, "%d", kstrtoint);
+BUDGET_TUNABLE(sustainable_mw, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(switch_on_degc, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(k_po, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(k_pu, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(k_i, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(horizon_ms, unsigned int, "%u", kstrtouint);
+BUDGET_TUNABLE(poll_ms, unsigned int, "%u", kstrtouint);
+
+static ssize_t budget_status_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct budget_actor *act;
+	int i, len;
+
+	mutex_lock(&budget.lock);
+	len = snprintf(buf, PAGE_SIZE,
+		"temp_mC:%d pred_mC:%d slope_mC_s:%d budget_mw:%d active_ms:%llu\n",
+		budget.temp_mC, budget.pred_mC, budget.slope,
+		budget.active ? (int)budget.budget_mw : -1,
+		budget.active_ms);
+	len += snprintf(buf + len, PAGE_SIZE - len,
+		"%-10s %6s %8s %8s %8s %12s\n", "actor", "weight",
+		"req_mw", "grant_mw", "max_mw", "throttled_ms");
+	for_each_budget_actor(act, i)
+		len += snprintf(buf + len, PAGE_SIZE - len,
+			"%-10s %6u %8u %8u %8u %12llu\n", act->name,
+			act->weight, act->req_mw, act->grant_mw,
+			act->max_mw, act->throttled_ms);
+	mutex_unlock(&budget.lock);
+
+	return len;
+}
+
+static struct kobj_attribute budget_enabled_attr =
+__ATTR(enabled, 0644, budget_enabled_show, budget_enabled_store);
+static struct kobj_attribute budget_status_attr =
+__ATTR(status, 0444, budget_status_show, NULL);
+
+static struct attribute *budget_attrs[] = {
+	&budget_enabled_attr.attr,
+	&budget_target_degC_attr.attr,
+	&budget_sustainable_mw_attr.attr,
+	&budget_switch_on_degc_attr.attr,
+	&budget_k_po_attr.attr,
+	&budget_k_pu_attr.attr,
+	&budget_k_i_attr.attr,
+	&budget_horizon_ms_attr.attr,
+	&budget_poll_ms_attr.attr,
+	&budget_status_attr.attr,
+	NULL,
+};
+
+static struct attribute_group budget_attr_group = {
+	.attrs = budget_attrs,
+};
+
+static __init int msm_thermal_add_budget_nodes(void)
+{
+	struct kobject *module_kobj = NULL;
+	int ret = 0;
+
+	module_kobj = kset_find_obj(module_kset, KBUILD_MODNAME);
+	if (!module_kobj) {
+		pr_err("cannot find kobject\n");
+		return -ENOENT;
+	}
+
+	budget.kobj = kobject_create_and_add("power_budget", module_kobj);
+	if (!budget.kobj) {
+		pr_err("cannot create power budget kobj\n");
+		return -ENOMEM;
+	}
+
+	ret = sysfs_create_group(budget.kobj, &budget_attr_group);
+	if (ret) {
+		pr_err("cannot create sysfs group. err:%d\n", ret);
+		kobject_del(budget.kobj);
+		budget.kobj = NULL;
+	}
+
+	return ret;
+}
+
 static __init int msm_thermal_add_cc_nodes(void)
 {
 	struct kobject *module_kobj = NULL;
@@ -5362,6 +5893,7 @@ static void msm_thermal_init_cpu_mit(enum cpu_mit_type cpu_mit)
 			cpus[cpu].shutdown_max_freq = UINT_MAX;
 			cpus[cpu].suspend_max_freq = UINT_MAX;
 			cpus[cpu].vdd_max_freq = UINT_MAX;
+			cpus[cpu].budget_max_freq = UINT_MAX;
 			cpus[cpu].user_min_freq = 0;
 			cpus[cpu].limited_max_freq = UINT_MAX;
 			cpus[cpu].limited_min_freq = 0;
@@ -7039,6 +7571,85 @@ PROBE_FREQ_EXIT:
 	return ret;
 }
 
+static int probe_power_budget(struct device_node *node,
+		struct msm_thermal_data *data,
+		struct platform_device *pdev)
+{
+	char *key = NULL;
+	uint32_t weights[BUDGET_MAX_ACTORS];
+	struct budget_actor *act;
+	int ret = 0, cnt, i;
+
+	key = "qcom,budget-sensor-id";
+	ret = of_property_read_u32(node, key, &data->budget_sensor_id);
+	if (ret)
+		goto PROBE_BUDGET_EXIT;
+
+	key = "qcom,budget-temp";
+	ret = of_property_read_u32(node, key, &data->budget_temp_degC);
+	if (ret)
+		goto PROBE_BUDGET_EXIT;
+
+	key = "qcom,budget-sustainable-power";
+	ret = of_property_read_u32(node, key, &data->budget_sustainable_mw);
+	if (ret)
+		goto PROBE_BUDGET_EXIT;
+
+	key = "qcom,budget-dyn-coeff";
+	cnt = of_property_count_u32_elems(node, key);
+	if (cnt <= 0 || cnt > BUDGET_MAX_CLUSTERS) {
+		ret = -EINVAL;
+		goto PROBE_BUDGET_EXIT;
+	}
+	ret = of_property_read_u32_array(node, key, budget.dyn_coeff, cnt);
+	if (ret)
+		goto PROBE_BUDGET_EXIT;
+
+	for (i = 0; i < BUDGET_MAX_ACTORS; i++)
+		weights[i] = BUDGET_DEFAULT_WEIGHT;
+	/* optional, one weight per cluster followed by the gpu and modem */
+	key = "qcom,budget-weights";
+	cnt = of_property_count_u32_elems(node, key);
+	if (cnt > 0)
+		of_property_read_u32_array(node, key, weights,
+			min_t(int, cnt, BUDGET_MAX_ACTORS));
+	for (i = 0; i < BUDGET_MAX_CLUSTERS; i++)
+		budget.actors[i].weight = weights[i];
+
+	act = budget_ext_actor(MSM_BUDGET_GPU);
+	act->name = "gpu";
+	act->weight = weights[BUDGET_MAX_CLUSTERS + MSM_BUDGET_GPU];
+	of_property_read_u32(node, "qcom,budget-gpu-max-power",
+		&act->max_mw);
+	act->req_mw = act->grant_mw = act->max_mw;
+
+	act = budget_ext_actor(MSM_BUDGET_MODEM);
+	act->name = "modem";
+	act->weight = weights[BUDGET_MAX_CLUSTERS + MSM_BUDGET_MODEM];
+	of_property_read_u32(node, "qcom,budget-modem-max-power",
+		&act->max_mw);
+	act->req_mw = act->grant_mw = act->max_mw;
+
+	budget.sensor_id = data->budget_sensor_id;
+	budget.target_degC = data->budget_temp_degC;
+	budget.sustainable_mw = data->budget_sustainable_mw;
+	budget.switch_on_degc = BUDGET_DEFAULT_SWITCH_ON_DEGC;
+	budget.k_po = budget.sustainable_mw / budget.switch_on_degc;
+	budget.k_pu = 2 * budget.k_po;
+	budget.k_i = budget.k_po / 10;
+	budget.horizon_ms = BUDGET_DEFAULT_HORIZON_MS;
+	budget.poll_ms = BUDGET_DEFAULT_POLL_MS;
+	budget.budget_mw = UINT_MAX;
+	budget.probed = true;
+
+PROBE_BUDGET_EXIT:
+	if (ret)
+		dev_dbg(&pdev->dev,
+		"%s:Failed reading node=%s, key=%s. err=%d. KTM continues\n",
+			__func__, node->full_name, key, ret);
+	return ret;
+}
+
 static void thermal_boot_config_read(struct seq_file *m, void *data)
 {
 
@@ -7450,6 +8061,7 @@ static int msm_thermal_dev_probe(struct platform_device *pdev)
 	probe_gfx_phase_ctrl(node, &data, pdev);
 	probe_therm_reset(node, &data, pdev);
 	probe_cxip_lm(node, &data, pdev);
+	probe_power_budget(node, &data, pdev);
 	update_cpu_topology(&pdev->dev);
 	ret = fetch_cpu_mitigaiton_info(&data, pdev);
 	if (ret) {
@@ -7607,6 +8219,10 @@ int __init msm_thermal_late_init(void)
 	create_thermal_debugfs();
 	msm_thermal_add_bucket_info_nodes();
 	uio_init(msm_thermal_info.pdev);
+	INIT_DEFERRABLE_WORK(&budget.work, budget_work_fn);
+	msm_thermal_add_budget_nodes();
+	if (budget.probed)
+		budget_enable(true);
 
 	return 0;
 }
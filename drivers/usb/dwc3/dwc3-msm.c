@@ -1283,6 +1283,28 @@ static void gsi_set_clear_dbell(struct usb_ep *ep,
 		GSI_GENERAL_CFG_REG, BLOCK_GSI_WR_GO_MASK, block_db);
 }
 
+/*
+* Returns the number of buffer TRBs of a GSI IN EP that are filled by GSI
+* and not yet sent to the host, a snapshot of the DL backlog.
+*
+* @usb_ep - pointer to usb_ep instance.
+*/
+static int gsi_get_busy_trbs(struct usb_ep *ep)
+{
+	struct dwc3_ep *dep = to_dwc3_ep(ep);
+	int i, busy = 0;
+
+	if (!dep->trb_pool || !dep->direction)
+		return 0;
+
+	/* n + 1 ZLP TRBs are followed by n buffer TRBs and the LINK TRB */
+	for (i = dep->num_trbs / 2; i < dep->num_trbs - 1; i++)
+		if (ACCESS_ONCE(dep->trb_pool[i].ctrl) & DWC3_TRB_CTRL_HWO)
+			busy++;
+
+	return busy;
+}
+
 /*
 * Performs necessary checks before stopping GSI channels
 *
@@ -1413,6 +1435,9 @@ static int dwc3_msm_gsi_ep_op(struct usb_ep *ep,
 		dev_dbg(mdwc->dev, "EP_OP_DISABLE\n");
 		ret = ep->ops->disable(ep);
 		break;
+	case GSI_EP_OP_GET_BUSY_TRBS:
+		ret = gsi_get_busy_trbs(ep);
+		break;
 	default:
 		dev_err(mdwc->dev, "%s: Invalid opcode GSI EP\n", __func__);
 	}
@@ -24,6 +24,7 @@
 #include <linux/hid.h>
 #include <linux/module.h>
 #include <linux/uio.h>
+#include <linux/scatterlist.h>
 #include <linux/ipc_logging.h>
 #include <asm/unaligned.h>
 
@@ -46,6 +47,14 @@
 
 #define NUM_PAGES	10 /* # of pages for ipc logging */
 
+/*
+ * AIO transfers on controllers that can do scatter-gather are done straight
+ * from the pinned user pages instead of through a bounce buffer.
+ */
+static bool aio_zero_copy = true;
+module_param(aio_zero_copy, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(aio_zero_copy, "DMA AIO requests from pinned user pages");
+
 static void *ffs_ipc_log;
 #define ffs_log(fmt, ...) do { \
 	if (ffs_ipc_log)	\
@@ -192,6 +201,11 @@ struct ffs_io_data {
 	const void *to_free;
 	char *buf;
 
+	/* user pages the request is DMAed from, for zero copy AIO */
+	struct page **pages;
+	int n_pages;
+	struct sg_table sgt;
+
 	struct mm_struct *mm;
 	struct work_struct work;
 
@@ -760,6 +774,56 @@ static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 	}
 }
 
+/*
+ * Pin the user buffer of an AIO request and describe it with a scatterlist
+ * so that the request can be DMAed without a bounce copy. Returns false if
+ * the buffer cannot be used as is, the caller then falls back to copying.
+ */
+static bool ffs_io_data_pin(struct ffs_io_data *io_data, size_t data_len)
+{
+	size_t offset;
+	ssize_t len;
+	int i;
+
+	if (!iter_is_iovec(&io_data->data) ||
+	    iov_iter_count(&io_data->data) != data_len)
+		return false;
+
+	len = iov_iter_get_pages_alloc(&io_data->data, &io_data->pages,
+				       data_len, &offset);
+	if (len <= 0) {
+		io_data->pages = NULL;
+		return false;
+	}
+	io_data->n_pages = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+
+	if (len == data_len &&
+	    !sg_alloc_table_from_pages(&io_data->sgt, io_data->pages,
+				       io_data->n_pages, offset, len,
+				       GFP_KERNEL))
+		return true;
+
+	for (i = 0; i < io_data->n_pages; i++)
+		put_page(io_data->pages[i]);
+	kvfree(io_data->pages);
+	io_data->pages = NULL;
+	return false;
+}
+
+static void ffs_io_data_unpin(struct ffs_io_data *io_data)
+{
+	int i;
+
+	sg_free_table(&io_data->sgt);
+	for (i = 0; i < io_data->n_pages; i++) {
+		if (io_data->read)
+			set_page_dirty_lock(io_data->pages[i]);
+		put_page(io_data->pages[i]);
+	}
+	kvfree(io_data->pages);
+	io_data->pages = NULL;
+}
+
 static void ffs_user_copy_worker(struct work_struct *work)
 {
 	struct ffs_io_data *io_data = container_of(work, struct ffs_io_data,
@@ -771,7 +835,9 @@ static void ffs_user_copy_worker(struct work_struct *work)
 
 	ffs_log("enter: ret %d", ret);
 
-	if (io_data->read && ret > 0) {
+	if (io_data->pages) {
+		ffs_io_data_unpin(io_data);
+	} else if (io_data->read && ret > 0) {
 		mm_segment_t oldfs = get_fs();
 
 		set_fs(USER_DS);
@@ -906,6 +972,10 @@ retry:
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
+		if (io_data->aio && aio_zero_copy && gadget->sg_supported &&
+		    ffs_io_data_pin(io_data, data_len))
+			goto pinned;
+
 		data = (data_len > epfile->alloc_len || io_data->aio)
 			? kmalloc(data_len, GFP_KERNEL)
 			: epfile->alloc_buffer;
@@ -920,6 +990,7 @@ retry:
 		}
 	}
 
+pinned:
 	/* We will be using request */
 	ret = ffs_mutex_lock(&epfile->mutex, file->f_flags & O_NONBLOCK);
 	if (unlikely(ret))
@@ -963,7 +1034,13 @@ retry:
 			if (unlikely(!req))
 				goto error_lock;
 
-			req->buf      = data;
+			if (io_data->pages) {
+				req->buf     = NULL;
+				req->sg      = io_data->sgt.sgl;
+				req->num_sgs = io_data->sgt.nents;
+			} else {
+				req->buf     = data;
+			}
 			req->length   = data_len;
 
 			io_data->buf = data;
@@ -1105,6 +1182,8 @@ error_lock:
 	spin_unlock_irq(&epfile->ffs->eps_lock);
 	mutex_unlock(&epfile->mutex);
 error:
+	if (io_data->pages)
+		ffs_io_data_unpin(io_data);
 	if (data_len > epfile->alloc_len || io_data->aio)
 		kfree(data);
 
@@ -34,6 +34,11 @@ module_param(num_out_bufs, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(num_out_bufs,
 		"Number of OUT buffers");
 
+static unsigned int gsi_adapt_ms;
+module_param(gsi_adapt_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(gsi_adapt_ms,
+		"DL aggregation adaptation period in ms, 0 to disable");
+
 static bool qti_packet_debug;
 module_param(qti_packet_debug, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(qti_packet_debug, "Print QTI Packet's Raw Data");
@@ -442,6 +447,63 @@ static int ipa_connect_channels(struct gsi_data_port *d_port)
 	return ret;
 }
 
+/*
+ * The DL data path never reaches the CPU, so the backlog of filled IN TRBs
+ * is the load signal. A mostly empty ring means interactive traffic that
+ * only pays for aggregation with latency; a ring that keeps filling up is
+ * bulk traffic that needs it to reach line rate.
+ */
+static void gsi_adapt_work_handler(struct work_struct *w)
+{
+	struct gsi_data_port *d_port = container_of(to_delayed_work(w),
+					struct gsi_data_port, adapt_w);
+	u32 num_bufs = d_port->in_request.num_bufs;
+	bool aggr;
+	int busy;
+
+	if (d_port->sm_state != STATE_CONNECTED)
+		goto resched;
+
+	busy = usb_gsi_ep_op(d_port->in_ep, NULL, GSI_EP_OP_GET_BUSY_TRBS);
+	/* moving average with a 1/4 weight, in 1/16 of a TRB */
+	d_port->dl_busy_avg = d_port->dl_busy_avg - d_port->dl_busy_avg / 4 +
+				busy * 4;
+	d_port->adapt_samples++;
+
+	/* on above a quarter of the ring busy, off below a sixteenth */
+	if (d_port->dl_aggr)
+		aggr = d_port->dl_busy_avg >= num_bufs;
+	else
+		aggr = d_port->dl_busy_avg >= num_bufs * 4;
+
+	if (aggr != d_port->dl_aggr && !rndis_ipa_set_dl_aggr(aggr)) {
+		d_port->dl_aggr = aggr;
+		d_port->adapt_switches++;
+		log_event_dbg("%s: DL aggregation %s, busy avg %u/16",
+				__func__, aggr ? "on" : "off",
+				d_port->dl_busy_avg);
+	}
+
+resched:
+	if (gsi_adapt_ms)
+		schedule_delayed_work(&d_port->adapt_w,
+				msecs_to_jiffies(gsi_adapt_ms));
+}
+
+static void gsi_adapt_start(struct gsi_data_port *d_port)
+{
+	struct f_gsi *gsi = d_port_to_gsi(d_port);
+
+	/* only RNDIS lets the DL aggregation change under a live link */
+	if (gsi->prot_id != IPA_USB_RNDIS || !gsi_adapt_ms)
+		return;
+
+	d_port->dl_aggr = true;
+	d_port->dl_busy_avg = 0;
+	schedule_delayed_work(&d_port->adapt_w,
+			msecs_to_jiffies(gsi_adapt_ms));
+}
+
 static void ipa_data_path_enable(struct gsi_data_port *d_port)
 {
 	struct f_gsi *gsi = d_port_to_gsi(d_port);
@@ -486,6 +548,8 @@ static void ipa_data_path_enable(struct gsi_data_port *d_port)
 		usb_gsi_ep_op(gsi->d_port.out_ep, &gsi->d_port.out_request,
 			GSI_EP_OP_UPDATEXFER);
 	}
+
+	gsi_adapt_start(d_port);
 }
 
 static void ipa_disconnect_handler(struct gsi_data_port *d_port)
@@ -516,6 +580,8 @@ static void ipa_disconnect_work_handler(struct gsi_data_port *d_port)
 	int ret;
 	struct f_gsi *gsi = d_port_to_gsi(d_port);
 
+	cancel_delayed_work_sync(&d_port->adapt_w);
+
 	log_event_dbg("%s: Calling xdci_disconnect", __func__);
 
 	ret = ipa_usb_xdci_disconnect(gsi->d_port.out_channel_handle,
@@ -2909,6 +2975,7 @@ int gsi_bind_config(struct f_gsi *gsi)
 	gsi->function.resume = gsi_resume;
 
 	INIT_WORK(&gsi->d_port.usb_ipa_w, ipa_work_handler);
+	INIT_DELAYED_WORK(&gsi->d_port.adapt_w, gsi_adapt_work_handler);
 
 	return status;
 }
@@ -3095,6 +3162,18 @@ static ssize_t gsi_info_show(struct config_item *item, char *page)
 		len += scnprintf(buf + len, PAGE_SIZE - len,
 		"%25s %10u\n", "Eventq tail: ",
 				gsi->d_port.evt_q.tail);
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+		"%25s %10u\n", "DL aggr: ",
+				gsi->d_port.dl_aggr);
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+		"%25s %10u\n", "DL busy trbs avg x16: ",
+				gsi->d_port.dl_busy_avg);
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+		"%25s %10u\n", "Adapt samples: ",
+				gsi->d_port.adapt_samples);
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+		"%25s %10u\n", "Adapt switches: ",
+				gsi->d_port.adapt_switches);
 	}
 
 	if (len > PAGE_SIZE)
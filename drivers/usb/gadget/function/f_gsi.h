@@ -25,6 +25,7 @@
 #include <linux/etherdevice.h>
 #include <linux/debugfs.h>
 #include <linux/ipa_usb.h>
+#include <linux/rndis_ipa.h>
 #include <linux/usb/msm_hsusb.h>
 
 #define GSI_RMNET_CTRL_NAME "rmnet_ctrl"
@@ -219,6 +220,13 @@ struct gsi_data_port {
 	struct event_queue evt_q;
 	wait_queue_head_t wait_for_ipa_ready;
 
+	/* DL aggregation adaptation, see gsi_adapt_ms */
+	struct delayed_work adapt_w;
+	bool dl_aggr;
+	u32 dl_busy_avg;
+	u32 adapt_samples;
+	u32 adapt_switches;
+
 	/* Track these for debugfs */
 	struct ipa_usb_xdci_chan_params ipa_in_channel_params;
 	struct ipa_usb_xdci_chan_params ipa_out_channel_params;
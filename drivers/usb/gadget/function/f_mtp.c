@@ -61,7 +61,8 @@
 
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
-#define RX_REQ_MAX 2
+#define RX_REQ_MAX 8
+#define MTP_RX_REQS 4
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -89,6 +90,10 @@ module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
 
+/* rx requests kept queued by receive_file_work, between 2 and RX_REQ_MAX */
+unsigned int mtp_rx_reqs = MTP_RX_REQS;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+
 static const char mtp_shortname[] = DRIVER_NAME "_usb";
 
 struct mtp_dev {
@@ -114,7 +119,9 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	unsigned int rx_reqs;
 	int rx_done;
+	atomic_t rx_completed;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -137,6 +144,11 @@ struct mtp_dev {
 	} perf[MAX_ITERATION];
 	unsigned dbg_read_index;
 	unsigned dbg_write_index;
+	/* size and duration of the last file sent and received */
+	struct {
+		u64 bytes;
+		u64 usecs;
+	} send_tput, recv_tput;
 	bool is_ptp;
 	struct mutex  read_mutex;
 };
@@ -497,6 +509,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
+	atomic_inc(&dev->rx_completed);
 	if (req->status != 0 && dev->state != STATE_OFFLINE)
 		dev->state = STATE_ERROR;
 
@@ -580,8 +593,9 @@ retry_tx_alloc:
 	if (mtp_rx_req_len % 1024)
 		mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
 
+	dev->rx_reqs = clamp_t(unsigned int, mtp_rx_reqs, 2, RX_REQ_MAX);
 retry_rx_alloc:
-	for (i = 0; i < RX_REQ_MAX; i++) {
+	for (i = 0; i < dev->rx_reqs; i++) {
 		req = mtp_request_new(dev->ep_out, mtp_rx_req_len);
 		if (!req) {
 			if (mtp_rx_req_len <= MTP_BULK_BUFFER_SIZE)
@@ -815,7 +829,8 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
-	ktime_t start_time;
+	ktime_t start_time, xfer_start;
+	int64_t total;
 
 	/* read our parameters */
 	smp_rmb();
@@ -843,6 +858,8 @@ static void send_file_work(struct work_struct *data)
 	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
 		sendZLP = 1;
 
+	total = count;
+	xfer_start = ktime_get();
 	while (count > 0 || sendZLP) {
 		/* so we exit after sending ZLP */
 		if (count == 0)
@@ -918,25 +935,72 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+	dev->send_tput.bytes = total - count;
+	dev->send_tput.usecs = ktime_us_delta(ktime_get(), xfer_start);
+
 	DBG(cdev, "send_file_work returning %d state:%d\n", r, dev->state);
 	/* write the result */
 	dev->xfer_result = r;
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/* queue the next rx request of receive_file_work */
+static int mtp_rx_queue(struct mtp_dev *dev, unsigned int *head)
+{
+	struct usb_request *req;
+	int ret;
+
+	mutex_lock(&dev->read_mutex);
+	if (dev->state == STATE_OFFLINE) {
+		mutex_unlock(&dev->read_mutex);
+		return -EIO;
+	}
+	req = dev->rx_req[*head];
+	/* some h/w expects size to be aligned to ep's MTU */
+	req->length = mtp_rx_req_len;
+	dev->rx_done = 0;
+	mutex_unlock(&dev->read_mutex);
+
+	ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
+	if (ret < 0) {
+		if (dev->state != STATE_OFFLINE)
+			dev->state = STATE_ERROR;
+		return -EIO;
+	}
+	*head = (*head + 1) % dev->rx_reqs;
+	return 0;
+}
+
+/* dequeue the rx requests still in flight, oldest first */
+static void mtp_rx_dequeue(struct mtp_dev *dev, unsigned int tail,
+			   unsigned int inflight)
+{
+	while (inflight--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[tail]);
+		tail = (tail + 1) % dev->rx_reqs;
+	}
+}
+
+/*
+ * Read from USB and write to a local file. Up to rx_reqs reads are kept
+ * queued so the controller keeps filling buffers while vfs_write() drains
+ * the oldest one. Reads are never queued past the end of the file, where
+ * they would swallow the next MTP container.
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue, total = 0;
+	unsigned int head = 0, tail = 0, inflight = 0, max_inflight;
+	unsigned int completed;
+	int ret;
 	int r = 0;
-	ktime_t start_time;
+	ktime_t start_time, xfer_start;
 
 	/* read our parameters */
 	smp_rmb();
@@ -954,109 +1018,119 @@ static void receive_file_work(struct work_struct *data)
 		DBG(cdev, "%s- count(%lld) not multiple of mtu(%d)\n", __func__,
 						count, dev->ep_out->maxpacket);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			mutex_lock(&dev->read_mutex);
-			if (dev->state == STATE_OFFLINE) {
-				r = -EIO;
-				mutex_unlock(&dev->read_mutex);
-				break;
-			}
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			/* some h/w expects size to be aligned to ep's MTU */
-			read_req->length = mtp_rx_req_len;
+	/*
+	 * With an unknown length only a short packet marks the end, so do
+	 * not read ahead of the buffer being written out.
+	 */
+	max_inflight = (count == 0xFFFFFFFF) ? 1 : dev->rx_reqs;
+	to_queue = count;
+	completed = atomic_read(&dev->rx_completed);
+	xfer_start = ktime_get();
+
+	while (count > 0) {
+		while (to_queue > 0 && inflight < max_inflight) {
+			r = mtp_rx_queue(dev, &head);
+			if (r)
+				goto out;
+			inflight++;
+			if (count != 0xFFFFFFFF)
+				to_queue -= mtp_rx_req_len;
+		}
 
-			dev->rx_done = 0;
-			mutex_unlock(&dev->read_mutex);
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
-			if (ret < 0) {
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[tail];
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) != completed ||
+			dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED
+				|| dev->state == STATE_OFFLINE) {
+			if (dev->state == STATE_OFFLINE)
 				r = -EIO;
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
-				break;
-			}
+			else
+				r = -ECANCELED;
+			goto out;
+		}
+		if (atomic_read(&dev->rx_completed) == completed) {
+			r = ret ? ret : -EIO;
+			goto out;
+		}
+		completed++;
+		tail = (tail + 1) % dev->rx_reqs;
+		inflight--;
+		if (req->status) {
+			r = req->status;
+			goto out;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %pK %d\n", write_req, write_req->actual);
-			start_time = ktime_get();
-			mutex_lock(&dev->read_mutex);
-			if (dev->state == STATE_OFFLINE) {
-				r = -EIO;
-				mutex_unlock(&dev->read_mutex);
-				break;
-			}
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				mutex_unlock(&dev->read_mutex);
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
-				break;
-			}
+		mutex_lock(&dev->read_mutex);
+		if (dev->state == STATE_OFFLINE) {
+			r = -EIO;
 			mutex_unlock(&dev->read_mutex);
-			dev->perf[dev->dbg_write_index].vfs_wtime =
-				ktime_to_us(ktime_sub(ktime_get(), start_time));
-			dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
-			dev->dbg_write_index =
-				(dev->dbg_write_index + 1) % MAX_ITERATION;
-			write_req = NULL;
+			goto out;
 		}
-
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED
-					|| dev->state == STATE_OFFLINE) {
-				if (dev->state == STATE_OFFLINE)
-					r = -EIO;
-				else
-					r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			if (read_req->status) {
-				r = read_req->status;
-				break;
-			}
-
-			mutex_lock(&dev->read_mutex);
-			if (dev->state == STATE_OFFLINE) {
-				r = -EIO;
-				mutex_unlock(&dev->read_mutex);
-				break;
-			}
-			/* Check if we aligned the size due to MTU constraint */
-			if (count < read_req->length)
-				read_req->actual = (read_req->actual > count ?
-						count : read_req->actual);
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		/* Check if we aligned the size due to MTU constraint */
+		if (count < req->length)
+			req->actual = (req->actual > count ?
+					count : req->actual);
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			to_queue = 0;
+		}
+		mutex_unlock(&dev->read_mutex);
+
+		/* keep the controller busy while this buffer is written */
+		while (to_queue > 0 && inflight + 1 < max_inflight) {
+			r = mtp_rx_queue(dev, &head);
+			if (r)
+				goto out;
+			inflight++;
 			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+				to_queue -= mtp_rx_req_len;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %pK %d\n", req, req->actual);
+		start_time = ktime_get();
+		mutex_lock(&dev->read_mutex);
+		if (dev->state == STATE_OFFLINE) {
+			r = -EIO;
+			mutex_unlock(&dev->read_mutex);
+			goto out;
+		}
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
 			mutex_unlock(&dev->read_mutex);
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+			goto out;
 		}
+		mutex_unlock(&dev->read_mutex);
+		total += ret;
+		dev->perf[dev->dbg_write_index].vfs_wtime =
+			ktime_to_us(ktime_sub(ktime_get(), start_time));
+		dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
+		dev->dbg_write_index =
+			(dev->dbg_write_index + 1) % MAX_ITERATION;
 	}
 
+out:
+	/* reads left over by an error, a cancel or an early short packet */
+	if (inflight)
+		mtp_rx_dequeue(dev, tail, inflight);
+	dev->recv_tput.bytes = total;
+	dev->recv_tput.usecs = ktime_us_delta(ktime_get(), xfer_start);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1522,7 +1596,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	mutex_lock(&dev->read_mutex);
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < dev->rx_reqs; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
@@ -1622,7 +1696,7 @@ static int debug_mtp_read_stats(struct seq_file *s, void *unused)
 	}
 
 	seq_printf(s, "vfs_write(time in usec) min:%d\t max:%d\t avg:%d\n",
-						min, max, sum / iteration);
+				min, max, iteration ? sum / iteration : 0);
 	min = max = sum = iteration = 0;
 	seq_puts(s, "\n=======================\n");
 	seq_puts(s, "MTP Read Stats:\n");
@@ -1644,7 +1718,19 @@ static int debug_mtp_read_stats(struct seq_file *s, void *unused)
 	}
 
 	seq_printf(s, "vfs_read(time in usec) min:%d\t max:%d\t avg:%d\n",
-						min, max, sum / iteration);
+				min, max, iteration ? sum / iteration : 0);
+
+	seq_puts(s, "\n=======================\n");
+	seq_puts(s, "MTP Throughput (last file):\n");
+	seq_puts(s, "\n=======================\n");
+	seq_printf(s, "receive: bytes:%llu\t time:%llu\t KB/s:%llu\n",
+		   dev->recv_tput.bytes, dev->recv_tput.usecs,
+		   dev->recv_tput.usecs ? div64_u64(dev->recv_tput.bytes *
+				1000000ULL, dev->recv_tput.usecs * 1024) : 0);
+	seq_printf(s, "send: bytes:%llu\t time:%llu\t KB/s:%llu\n",
+		   dev->send_tput.bytes, dev->send_tput.usecs,
+		   dev->send_tput.usecs ? div64_u64(dev->send_tput.bytes *
+				1000000ULL, dev->send_tput.usecs * 1024) : 0);
 	spin_unlock_irqrestore(&dev->lock, flags);
 	return 0;
 }
@@ -1668,6 +1754,8 @@ static ssize_t debug_mtp_reset_stats(struct file *file, const char __user *buf,
 
 	spin_lock_irqsave(&dev->lock, flags);
 	memset(&dev->perf[0], 0, MAX_ITERATION * sizeof(dev->perf[0]));
+	memset(&dev->send_tput, 0, sizeof(dev->send_tput));
+	memset(&dev->recv_tput, 0, sizeof(dev->recv_tput));
 	dev->dbg_read_index = 0;
 	dev->dbg_write_index = 0;
 	spin_unlock_irqrestore(&dev->lock, flags);
@@ -1728,6 +1816,7 @@ static int __mtp_setup(struct mtp_instance *fi_mtp)
 	init_waitqueue_head(&dev->intr_wq);
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
+	atomic_set(&dev->rx_completed, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
 
@@ -53,8 +53,6 @@
  * blocks and still have efficient handling. */
 #define GETHER_MAX_ETH_FRAME_LEN 15412
 
-static struct workqueue_struct	*uether_wq;
-
 struct eth_dev {
 	/* lock is held while accessing port_usb
 	 */
@@ -86,7 +84,7 @@ struct eth_dev {
 						struct sk_buff_head *list);
 
 	struct work_struct	work;
-	struct work_struct	rx_work;
+	struct napi_struct	rx_napi;
 
 	unsigned long		todo;
 #define	WORK_RX_MEMORY		0
@@ -350,7 +348,7 @@ clean:
 	spin_unlock(&dev->req_lock);
 
 	if (queue)
-		queue_work(uether_wq, &dev->rx_work);
+		napi_schedule(&dev->rx_napi);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -442,19 +440,20 @@ static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 }
 
-static void process_rx_w(struct work_struct *work)
+/*
+ * Frames queued by rx_complete() are handed to GRO here, up to budget per
+ * poll, and the rx requests they came in are resubmitted in the same pass.
+ * Refills that fail for lack of memory are retried from eth_work().
+ */
+static int eth_rx_poll(struct napi_struct *napi, int budget)
 {
-	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, rx_napi);
 	struct sk_buff	*skb;
-	int		status = 0;
+	int		work_done = 0;
 
-	if (!dev->port_usb)
-		return;
-
-	while ((skb = skb_dequeue(&dev->rx_frames))) {
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
+	while (work_done < budget &&
+	       (skb = skb_dequeue(&dev->rx_frames))) {
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
 			dev->net->stats.rx_errors++;
 			dev->net->stats.rx_length_errors++;
 			DBG(dev, "rx length %d\n", skb->len);
@@ -465,11 +464,21 @@ static void process_rx_w(struct work_struct *work)
 		dev->net->stats.rx_packets++;
 		dev->net->stats.rx_bytes += skb->len;
 
-		status = netif_rx_ni(skb);
+		napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	if (dev->port_usb && netif_running(dev->net))
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work_done < budget) {
+		napi_complete_done(napi, work_done);
+		/* catch frames queued after the dequeue loop gave up */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
 	}
 
-	if (netif_running(dev->net))
-		rx_fill(dev, GFP_KERNEL);
+	return work_done;
 }
 
 static void eth_work(struct work_struct *work)
@@ -801,6 +810,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->rx_napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -820,6 +830,7 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->rx_napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -937,7 +948,6 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	spin_lock_init(&dev->lock);
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
-	INIT_WORK(&dev->rx_work, process_rx_w);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
@@ -945,6 +955,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 
 	/* network device setup */
 	dev->net = net;
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	dev->qmult = qmult;
 	snprintf(net->name, sizeof(net->name), "%s%%d", netname);
 
@@ -1000,7 +1011,6 @@ struct net_device *gether_setup_name_default(const char *netname)
 	spin_lock_init(&dev->lock);
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
-	INIT_WORK(&dev->rx_work, process_rx_w);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
@@ -1008,6 +1018,7 @@ struct net_device *gether_setup_name_default(const char *netname)
 
 	/* network device setup */
 	dev->net = net;
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	dev->qmult = QMULT_DEFAULT;
 	snprintf(net->name, sizeof(net->name), "%s%%d", netname);
 
@@ -1370,23 +1381,6 @@ void gether_disconnect(struct gether *link)
 }
 EXPORT_SYMBOL_GPL(gether_disconnect);
 
-static int __init gether_init(void)
-{
-	uether_wq  = create_singlethread_workqueue("uether");
-	if (!uether_wq) {
-		pr_err("%s: Unable to create workqueue: uether\n", __func__);
-		return -ENOMEM;
-	}
-	return 0;
-}
-module_init(gether_init);
-
-static void __exit gether_exit(void)
-{
-	destroy_workqueue(uether_wq);
-
-}
-module_exit(gether_exit);
 MODULE_AUTHOR("David Brownell");
 MODULE_DESCRIPTION("ethernet over USB driver");
 MODULE_LICENSE("GPL v2");
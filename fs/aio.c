@@ -41,6 +41,8 @@
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
 #include <linux/nospec.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -48,8 +50,20 @@
 #include "internal.h"
 
 #define AIO_RING_MAGIC			0xa10a10a1
-#define AIO_RING_COMPAT_FEATURES	1
+/*
+ * Bit 1 of the compat features tells userspace that IOCB_FLAG_FIXED_FILE
+ * and IOCB_FLAG_FIXED_BUF are understood.
+ */
+#define AIO_RING_COMPAT_FIXED		2
+#define AIO_RING_COMPAT_FEATURES	(1 | AIO_RING_COMPAT_FIXED)
 #define AIO_RING_INCOMPAT_FEATURES	0
+
+/*
+ * The ring is mapped at the context id, so userspace may reap completed
+ * events without io_getevents(): read io_events[head] while head != tail
+ * and store the new head. The slots are given back to io_submit() once
+ * it runs out of them.
+ */
 struct aio_ring {
 	unsigned	id;	/* kernel internal index number */
 	unsigned	nr;	/* number of io_events */
@@ -83,6 +97,27 @@ struct ctx_rq_wait {
 	atomic_t count;
 };
 
+#define AIO_MAX_FIXED_FILES	1024
+#define AIO_MAX_FIXED_BUFS	64
+
+struct aio_fixed_files {
+	unsigned		nr;
+	struct file		*files[];
+};
+
+/* A user buffer pinned at registration time, see aio_register_buffers() */
+struct aio_fixed_buf {
+	unsigned long		addr;
+	size_t			len;
+	unsigned		nr_bvecs;
+	struct bio_vec		*bvecs;
+};
+
+struct aio_fixed_bufs {
+	unsigned		nr;
+	struct aio_fixed_buf	bufs[];
+};
+
 struct kioctx {
 	struct percpu_ref	users;
 	atomic_t		dead;
@@ -156,6 +191,13 @@ struct kioctx {
 	struct file		*aio_ring_file;
 
 	unsigned		id;
+
+	/*
+	 * Set at most once by IOCB_CMD_REGISTER_*, released by free_ioctx()
+	 * once no request can reference them.
+	 */
+	struct aio_fixed_files	*fixed_files;
+	struct aio_fixed_bufs	*fixed_bufs;
 };
 
 /*
@@ -183,6 +225,8 @@ struct aio_kiocb {
 	struct list_head	ki_list;	/* the aio core uses this
 						 * for cancellation */
 
+	bool			ki_fixed_file;	/* ki_filp is owned by ctx */
+
 	/*
 	 * If the aio_resfd field of the userspace iocb is not zero,
 	 * this is the underlying eventfd context to deliver events to.
@@ -586,12 +630,39 @@ static int kiocb_cancel(struct aio_kiocb *kiocb)
  * aio_free_ring(), so the double bouncing through kioctx->free_rcu and
  * ->free_work.
  */
+static void aio_free_fixed_files(struct aio_fixed_files *files)
+{
+	unsigned i;
+
+	if (!files)
+		return;
+	for (i = 0; i < files->nr; i++)
+		fput(files->files[i]);
+	kfree(files);
+}
+
+static void aio_free_fixed_bufs(struct aio_fixed_bufs *bufs)
+{
+	unsigned i, j;
+
+	if (!bufs)
+		return;
+	for (i = 0; i < bufs->nr; i++) {
+		for (j = 0; j < bufs->bufs[i].nr_bvecs; j++)
+			put_page(bufs->bufs[i].bvecs[j].bv_page);
+		vfree(bufs->bufs[i].bvecs);
+	}
+	kfree(bufs);
+}
+
 static void free_ioctx(struct work_struct *work)
 {
 	struct kioctx *ctx = container_of(work, struct kioctx, free_work);
 
 	pr_debug("freeing %p\n", ctx);
 
+	aio_free_fixed_files(ctx->fixed_files);
+	aio_free_fixed_bufs(ctx->fixed_bufs);
 	aio_free_ring(ctx);
 	free_percpu(ctx->cpu);
 	percpu_ref_exit(&ctx->reqs);
@@ -1045,7 +1116,7 @@ out_put:
 
 static void kiocb_free(struct aio_kiocb *req)
 {
-	if (req->common.ki_filp)
+	if (req->common.ki_filp && !req->ki_fixed_file)
 		fput(req->common.ki_filp);
 	if (req->ki_eventfd != NULL)
 		eventfd_ctx_put(req->ki_eventfd);
@@ -1423,12 +1494,188 @@ static int aio_setup_vectored_rw(int rw, char __user *buf, size_t len,
 				len, UIO_FASTIOV, iovec, iter);
 }
 
+/*
+ * Take a reference on each of the "nr" descriptors at "ufds" for the
+ * lifetime of the context, so that IOCB_FLAG_FIXED_FILE iocbs need no fget().
+ */
+static long aio_register_files(struct kioctx *ctx, s32 __user *ufds,
+			       size_t nr)
+{
+	struct aio_fixed_files *files;
+	s32 fd;
+	long ret;
+
+	if (!nr || nr > AIO_MAX_FIXED_FILES)
+		return -EINVAL;
+	if (READ_ONCE(ctx->fixed_files))
+		return -EBUSY;
+
+	files = kzalloc(sizeof(*files) + nr * sizeof(files->files[0]),
+			GFP_KERNEL);
+	if (!files)
+		return -ENOMEM;
+
+	for (; files->nr < nr; files->nr++) {
+		ret = -EFAULT;
+		if (get_user(fd, ufds + files->nr))
+			goto err;
+		ret = -EBADF;
+		files->files[files->nr] = fget(fd);
+		if (!files->files[files->nr])
+			goto err;
+	}
+
+	/* Pairs with smp_load_acquire() in io_submit_one() */
+	ret = -EBUSY;
+	if (cmpxchg_release(&ctx->fixed_files, NULL, files) != NULL)
+		goto err;
+	return 0;
+err:
+	aio_free_fixed_files(files);
+	return ret;
+}
+
+static int aio_pin_buffer(struct aio_fixed_buf *fbuf, struct iovec *iov)
+{
+	unsigned long addr = (unsigned long)iov->iov_base;
+	unsigned long off = addr & ~PAGE_MASK;
+	size_t left = iov->iov_len;
+	struct page **pages;
+	int i, nr, pinned;
+
+	if (!left || left > SZ_1G || addr + left < addr)
+		return -EINVAL;
+
+	nr = DIV_ROUND_UP(off + left, PAGE_SIZE);
+	pages = vmalloc(nr * sizeof(*pages));
+	fbuf->bvecs = vmalloc(nr * sizeof(*fbuf->bvecs));
+	if (!pages || !fbuf->bvecs) {
+		vfree(pages);
+		vfree(fbuf->bvecs);
+		fbuf->bvecs = NULL;
+		return -ENOMEM;
+	}
+
+	pinned = get_user_pages_fast(addr & PAGE_MASK, nr, 1, pages);
+	if (pinned != nr) {
+		for (i = 0; i < pinned; i++)
+			put_page(pages[i]);
+		vfree(pages);
+		vfree(fbuf->bvecs);
+		fbuf->bvecs = NULL;
+		return pinned < 0 ? pinned : -EFAULT;
+	}
+
+	for (i = 0; i < nr; i++) {
+		fbuf->bvecs[i].bv_page = pages[i];
+		fbuf->bvecs[i].bv_offset = off;
+		fbuf->bvecs[i].bv_len = min_t(size_t, PAGE_SIZE - off, left);
+		left -= fbuf->bvecs[i].bv_len;
+		off = 0;
+	}
+	vfree(pages);
+
+	fbuf->addr = addr;
+	fbuf->len = iov->iov_len;
+	fbuf->nr_bvecs = nr;
+	return 0;
+}
+
+/*
+ * Pin the "nr" buffers described by the iovecs at "uiov" for the lifetime
+ * of the context. IOCB_FLAG_FIXED_BUF iocbs then run on the pinned pages
+ * instead of going through get_user_pages() for every I/O. The pinned
+ * memory counts against RLIMIT_MEMLOCK unless CAP_IPC_LOCK.
+ */
+static long aio_register_buffers(struct kioctx *ctx, struct iovec __user *uiov,
+				 size_t nr, bool compat)
+{
+	struct aio_fixed_bufs *bufs;
+	struct iovec iov;
+	unsigned long pages = 0;
+	long ret;
+
+	if (!nr || nr > AIO_MAX_FIXED_BUFS)
+		return -EINVAL;
+	if (READ_ONCE(ctx->fixed_bufs))
+		return -EBUSY;
+
+	bufs = kzalloc(sizeof(*bufs) + nr * sizeof(bufs->bufs[0]),
+		       GFP_KERNEL);
+	if (!bufs)
+		return -ENOMEM;
+
+	for (; bufs->nr < nr; bufs->nr++) {
+		ret = -EFAULT;
+#ifdef CONFIG_COMPAT
+		if (compat) {
+			struct compat_iovec __user *ciov = (void __user *)uiov;
+			struct compat_iovec civ;
+
+			if (copy_from_user(&civ, ciov + bufs->nr, sizeof(civ)))
+				goto err;
+			iov.iov_base = compat_ptr(civ.iov_base);
+			iov.iov_len = civ.iov_len;
+		} else
+#endif
+		if (copy_from_user(&iov, uiov + bufs->nr, sizeof(iov)))
+			goto err;
+
+		ret = aio_pin_buffer(&bufs->bufs[bufs->nr], &iov);
+		if (ret)
+			goto err;
+
+		pages += bufs->bufs[bufs->nr].nr_bvecs;
+		ret = -ENOMEM;
+		if (!capable(CAP_IPC_LOCK) &&
+		    pages > (rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT)) {
+			bufs->nr++;
+			goto err;
+		}
+	}
+
+	ret = -EBUSY;
+	if (cmpxchg_release(&ctx->fixed_bufs, NULL, bufs) != NULL)
+		goto err;
+	return 0;
+err:
+	aio_free_fixed_bufs(bufs);
+	return ret;
+}
+
+/* Point "iter" at [buf, buf + len) of the registered buffer holding it */
+static int aio_setup_fixed_rw(struct kioctx *ctx, int rw, char __user *buf,
+			      size_t len, struct iov_iter *iter)
+{
+	struct aio_fixed_bufs *bufs = smp_load_acquire(&ctx->fixed_bufs);
+	unsigned long addr = (unsigned long)buf;
+	struct aio_fixed_buf *fbuf;
+	unsigned i;
+
+	if (!bufs)
+		return -EINVAL;
+
+	for (i = 0; i < bufs->nr; i++) {
+		fbuf = &bufs->bufs[i];
+		if (addr >= fbuf->addr && len <= fbuf->len &&
+		    addr - fbuf->addr <= fbuf->len - len) {
+			iov_iter_bvec(iter, ITER_BVEC | rw, fbuf->bvecs,
+				      fbuf->nr_bvecs, fbuf->len);
+			iov_iter_advance(iter, addr - fbuf->addr);
+			iov_iter_truncate(iter, len);
+			return 0;
+		}
+	}
+	return -EFAULT;
+}
+
 /*
  * aio_run_iocb:
  *	Performs the initial checks and io submission.
  */
 static ssize_t aio_run_iocb(struct kiocb *req, unsigned opcode,
-			    char __user *buf, size_t len, bool compat)
+			    char __user *buf, size_t len, bool compat,
+			    bool fixed_buf)
 {
 	struct file *file = req->ki_filp;
 	ssize_t ret;
@@ -1459,7 +1706,16 @@ rw_common:
 		if (!iter_op)
 			return -EINVAL;
 
-		if (opcode == IOCB_CMD_PREADV || opcode == IOCB_CMD_PWRITEV)
+		if (fixed_buf) {
+			ret = -EINVAL;
+			if (opcode == IOCB_CMD_PREAD ||
+			    opcode == IOCB_CMD_PWRITE)
+				ret = aio_setup_fixed_rw(container_of(req,
+						struct aio_kiocb, common)->ki_ctx,
+						rw, buf, len, &iter);
+			iovec = NULL;
+		} else if (opcode == IOCB_CMD_PREADV ||
+			   opcode == IOCB_CMD_PWRITEV)
 			ret = aio_setup_vectored_rw(rw, buf, len,
 						&iovec, compat, &iter);
 		else {
@@ -1548,10 +1804,45 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	if (unlikely(!req))
 		return -EAGAIN;
 
-	req->common.ki_filp = fget(iocb->aio_fildes);
-	if (unlikely(!req->common.ki_filp)) {
-		ret = -EBADF;
-		goto out_put_req;
+	/* Registration completes at once, and needs no file */
+	if (unlikely(iocb->aio_lio_opcode == IOCB_CMD_REGISTER_FILES ||
+		     iocb->aio_lio_opcode == IOCB_CMD_REGISTER_BUFFERS)) {
+		ret = put_user(KIOCB_KEY, &user_iocb->aio_key);
+		if (unlikely(ret))
+			goto out_put_req;
+		req->common.ki_complete = aio_complete;
+		req->ki_user_iocb = user_iocb;
+		req->ki_user_data = iocb->aio_data;
+		if (iocb->aio_lio_opcode == IOCB_CMD_REGISTER_FILES)
+			ret = aio_register_files(ctx,
+				(s32 __user *)(unsigned long)iocb->aio_buf,
+				iocb->aio_nbytes);
+		else
+			ret = aio_register_buffers(ctx,
+				(struct iovec __user *)(unsigned long)iocb->aio_buf,
+				iocb->aio_nbytes, compat);
+		aio_complete(&req->common, ret, 0);
+		return 0;
+	}
+
+	if (iocb->aio_flags & IOCB_FLAG_FIXED_FILE) {
+		struct aio_fixed_files *files;
+
+		/* Pairs with cmpxchg_release() in aio_register_files() */
+		files = smp_load_acquire(&ctx->fixed_files);
+		if (unlikely(!files || iocb->aio_fildes >= files->nr)) {
+			ret = -EBADF;
+			goto out_put_req;
+		}
+		req->common.ki_filp = files->files[array_index_nospec(
+					iocb->aio_fildes, files->nr)];
+		req->ki_fixed_file = true;
+	} else {
+		req->common.ki_filp = fget(iocb->aio_fildes);
+		if (unlikely(!req->common.ki_filp)) {
+			ret = -EBADF;
+			goto out_put_req;
+		}
 	}
 	req->common.ki_pos = iocb->aio_offset;
 	req->common.ki_complete = aio_complete;
@@ -1586,7 +1877,7 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	ret = aio_run_iocb(&req->common, iocb->aio_lio_opcode,
 			   (char __user *)(unsigned long)iocb->aio_buf,
 			   iocb->aio_nbytes,
-			   compat);
+			   compat, iocb->aio_flags & IOCB_FLAG_FIXED_BUF);
 	if (ret)
 		goto out_put_req;
 
@@ -1598,6 +1889,9 @@ out_put_req:
 	return ret;
 }
 
+/* iocb pointers copied from userspace at a time by do_io_submit() */
+#define AIO_SUBMIT_BATCH	16
+
 long do_io_submit(aio_context_t ctx_id, long nr,
 		  struct iocb __user *__user *iocbpp, bool compat)
 {
@@ -1605,6 +1899,7 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 	long ret = 0;
 	int i = 0;
 	struct blk_plug plug;
+	struct iocb __user *batch[AIO_SUBMIT_BATCH];
 
 	if (unlikely(nr < 0))
 		return -EINVAL;
@@ -1631,10 +1926,14 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 		struct iocb __user *user_iocb;
 		struct iocb tmp;
 
-		if (unlikely(__get_user(user_iocb, iocbpp + i))) {
+		if (!(i % AIO_SUBMIT_BATCH) &&
+		    unlikely(__copy_from_user(batch, iocbpp + i,
+				min_t(long, nr - i, AIO_SUBMIT_BATCH) *
+				sizeof(*iocbpp)))) {
 			ret = -EFAULT;
 			break;
 		}
+		user_iocb = batch[i % AIO_SUBMIT_BATCH];
 
 		if (unlikely(copy_from_user(&tmp, user_iocb, sizeof(tmp)))) {
 			ret = -EFAULT;
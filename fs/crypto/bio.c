@@ -23,17 +23,53 @@
 #include <linux/module.h>
 #include <linux/bio.h>
 #include <linux/namei.h>
+#include <crypto/skcipher.h>
 #include "fscrypt_private.h"
 
+/*
+ * The pages of a read bio almost always belong to a single inode, so one
+ * request is allocated for the whole bio rather than one per page.
+ */
+static int fscrypt_decrypt_bio_page(struct page *page,
+				    struct skcipher_request **req,
+				    const struct inode **req_inode,
+				    struct crypto_wait *wait)
+{
+	const struct inode *inode = page->mapping->host;
+
+	if (fscrypt_using_hardware_encryption(inode) ||
+	    (inode->i_sb->s_cop->flags & FS_CFLG_OWN_PAGES))
+		return fscrypt_decrypt_page(inode, page, PAGE_SIZE, 0,
+					    page->index);
+
+	if (*req_inode != inode) {
+		skcipher_request_free(*req);
+		*req_inode = NULL;
+		*req = skcipher_request_alloc(inode->i_crypt_info->ci_ctfm,
+					      GFP_NOFS);
+		if (!*req)
+			return -ENOMEM;
+		*req_inode = inode;
+	}
+
+	BUG_ON(!PageLocked(page));
+	return fscrypt_do_page_crypto_req(inode, FS_DECRYPT, page->index,
+					  page, page, PAGE_SIZE, 0, *req,
+					  wait);
+}
+
 static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
 {
+	struct skcipher_request *req = NULL;
+	const struct inode *req_inode = NULL;
+	DECLARE_CRYPTO_WAIT(wait);
 	struct bio_vec *bv;
 	int i;
 
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
-		int ret = fscrypt_decrypt_page(page->mapping->host, page,
-				PAGE_SIZE, 0, page->index);
+		int ret = fscrypt_decrypt_bio_page(page, &req, &req_inode,
+						   &wait);
 
 		if (ret) {
 			WARN_ON_ONCE(1);
@@ -44,6 +80,7 @@ static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
 		if (done)
 			unlock_page(page);
 	}
+	skcipher_request_free(req);
 }
 
 void fscrypt_decrypt_bio(struct bio *bio)
@@ -92,6 +129,43 @@ void fscrypt_pullback_bio_page(struct page **page, bool restore)
 }
 EXPORT_SYMBOL(fscrypt_pullback_bio_page);
 
+/*
+ * Inline-encrypted files: write the zero page as is and tag the bio with the
+ * inode, so the per-file-key driver can find the key even though the page
+ * has no mapping.
+ */
+static int fscrypt_zeroout_range_inline(const struct inode *inode,
+					sector_t pblk, unsigned int len)
+{
+	struct bio *bio;
+	int ret, err = 0;
+
+	while (len--) {
+		bio = bio_alloc(GFP_NOFS, 1);
+		if (!bio)
+			return -ENOMEM;
+		bio->bi_bdev = inode->i_sb->s_bdev;
+		bio->bi_iter.bi_sector =
+			pblk << (inode->i_sb->s_blocksize_bits - 9);
+		bio->bi_dio_inode = (struct inode *)inode;
+		bio_set_op_attrs(bio, REQ_OP_WRITE, 0);
+		ret = bio_add_page(bio, ZERO_PAGE(0),
+					inode->i_sb->s_blocksize, 0);
+		if (ret != inode->i_sb->s_blocksize) {
+			/* should never happen! */
+			WARN_ON(1);
+			bio_put(bio);
+			return -EIO;
+		}
+		err = submit_bio_wait(0, bio);
+		bio_put(bio);
+		if (err)
+			return err;
+		pblk++;
+	}
+	return 0;
+}
+
 int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 				sector_t pblk, unsigned int len)
 {
@@ -102,6 +176,9 @@ int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 
 	BUG_ON(inode->i_sb->s_blocksize != PAGE_SIZE);
 
+	if (fscrypt_using_hardware_encryption(inode))
+		return fscrypt_zeroout_range_inline(inode, pblk, len);
+
 	ctx = fscrypt_get_ctx(inode, GFP_NOFS);
 	if (IS_ERR(ctx))
 		return PTR_ERR(ctx);
@@ -133,20 +133,24 @@ struct fscrypt_ctx *fscrypt_get_ctx(const struct inode *inode, gfp_t gfp_flags)
 }
 EXPORT_SYMBOL(fscrypt_get_ctx);
 
-int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
-			   u64 lblk_num, struct page *src_page,
-			   struct page *dest_page, unsigned int len,
-			   unsigned int offs, gfp_t gfp_flags)
+/*
+ * En/decrypt one page with a request the caller allocated for the tfm of
+ * @inode, so that a caller working through many pages, such as
+ * __fscrypt_decrypt_bio(), can reuse it for all of them.
+ */
+int fscrypt_do_page_crypto_req(const struct inode *inode,
+			       fscrypt_direction_t rw, u64 lblk_num,
+			       struct page *src_page, struct page *dest_page,
+			       unsigned int len, unsigned int offs,
+			       struct skcipher_request *req,
+			       struct crypto_wait *wait)
 {
 	struct {
 		__le64 index;
 		u8 padding[FS_IV_SIZE - sizeof(__le64)];
 	} iv;
-	struct skcipher_request *req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
 	struct scatterlist dst, src;
 	struct fscrypt_info *ci = inode->i_crypt_info;
-	struct crypto_skcipher *tfm = ci->ci_ctfm;
 	int res = 0;
 
 	BUG_ON(len == 0);
@@ -161,13 +165,9 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 					  (u8 *)&iv);
 	}
 
-	req = skcipher_request_alloc(tfm, gfp_flags);
-	if (!req)
-		return -ENOMEM;
-
 	skcipher_request_set_callback(
 		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-		crypto_req_done, &wait);
+		crypto_req_done, wait);
 
 	sg_init_table(&dst, 1);
 	sg_set_page(&dst, dest_page, len, offs);
@@ -175,10 +175,9 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 	sg_set_page(&src, src_page, len, offs);
 	skcipher_request_set_crypt(req, &src, &dst, len, &iv);
 	if (rw == FS_DECRYPT)
-		res = crypto_wait_req(crypto_skcipher_decrypt(req), &wait);
+		res = crypto_wait_req(crypto_skcipher_decrypt(req), wait);
 	else
-		res = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
-	skcipher_request_free(req);
+		res = crypto_wait_req(crypto_skcipher_encrypt(req), wait);
 	if (res) {
 		fscrypt_err(inode->i_sb,
 			    "%scryption failed for inode %lu, block %llu: %d",
@@ -189,6 +188,25 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 	return 0;
 }
 
+int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
+			   u64 lblk_num, struct page *src_page,
+			   struct page *dest_page, unsigned int len,
+			   unsigned int offs, gfp_t gfp_flags)
+{
+	struct skcipher_request *req;
+	DECLARE_CRYPTO_WAIT(wait);
+	int res;
+
+	req = skcipher_request_alloc(inode->i_crypt_info->ci_ctfm, gfp_flags);
+	if (!req)
+		return -ENOMEM;
+
+	res = fscrypt_do_page_crypto_req(inode, rw, lblk_num, src_page,
+					 dest_page, len, offs, req, &wait);
+	skcipher_request_free(req);
+	return res;
+}
+
 struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 				       gfp_t gfp_flags)
 {
@@ -227,6 +245,10 @@ struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
  * fscrypt_operations. Here, the input-page is returned with its content
  * encrypted.
  *
+ * If the inode's contents are encrypted by the inline crypto engine (see
+ * fscrypt_using_hardware_encryption()), @page is returned untouched and no
+ * encryption context is attached to it.
+ *
  * Return: A page with the encrypted content on success. Else, an
  * error value or NULL.
  */
@@ -243,6 +265,9 @@ struct page *fscrypt_encrypt_page(const struct inode *inode,
 
 	BUG_ON(len % FS_CRYPTO_BLOCK_SIZE != 0);
 
+	if (fscrypt_using_hardware_encryption(inode))
+		return page;
+
 	if (inode->i_sb->s_cop->flags & FS_CFLG_OWN_PAGES) {
 		/* with inplace-encryption we just encrypt the page */
 		err = fscrypt_do_page_crypto(inode, FS_ENCRYPT, lblk_num, page,
@@ -305,6 +330,10 @@ int fscrypt_decrypt_page(const struct inode *inode, struct page *page,
 	if (!(inode->i_sb->s_cop->flags & FS_CFLG_OWN_PAGES))
 		BUG_ON(!PageLocked(page));
 
+	/* the storage controller already returned plaintext */
+	if (fscrypt_using_hardware_encryption(inode))
+		return 0;
+
 	return fscrypt_do_page_crypto(inode, FS_DECRYPT, lblk_num, page, page,
 				      len, offs, GFP_NOFS);
 }
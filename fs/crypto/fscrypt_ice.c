@@ -0,0 +1,131 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Inline crypto engine (ICE) support for fscrypt.
+ *
+ * Regular files on a filesystem that advertises FS_CFLG_INLINE_CRYPT and use
+ * AES-256-XTS for their contents keep the derived per-file key in their
+ * fscrypt_info instead of a software transform.  The per-file-key driver
+ * (security/pfe) picks the key up from the inode backing each bio and
+ * programs it into the storage controller's key slots, so data goes to disk
+ * straight from the page cache: no bounce pages on write and no decryption
+ * work on read.  The data unit number is derived from the LBA by the storage
+ * driver.
+ */
+
+#include <crypto/algapi.h>
+#include "fscrypt_private.h"
+#include "fscrypt_ice.h"
+
+bool fscrypt_inode_uses_ice(const struct inode *inode,
+			    const struct fscrypt_info *ci)
+{
+	if (!S_ISREG(inode->i_mode))
+		return false;
+
+	if (!(inode->i_sb->s_cop->flags & FS_CFLG_INLINE_CRYPT))
+		return false;
+
+	return ci->ci_data_mode == FS_ENCRYPTION_MODE_AES_256_XTS;
+}
+
+int fscrypt_set_ice_key(struct fscrypt_info *ci, const u8 *raw_key,
+			unsigned int keysize)
+{
+	if (keysize != FS_AES_256_XTS_KEY_SIZE)
+		return -EINVAL;
+
+	memcpy(ci->ci_raw_key, raw_key, keysize);
+	ci->ci_hw_enc = true;
+	return 0;
+}
+
+/**
+ * fscrypt_using_hardware_encryption() - check for inline encryption
+ * @inode: The inode to check
+ *
+ * Return: true if the contents of @inode are encrypted by the storage
+ * controller, in which case the filesystem must submit the page cache pages
+ * themselves and must not queue software decryption on read completion.
+ */
+bool fscrypt_using_hardware_encryption(const struct inode *inode)
+{
+	struct fscrypt_info *ci = ACCESS_ONCE(inode->i_crypt_info);
+
+	return S_ISREG(inode->i_mode) && ci && ci->ci_hw_enc;
+}
+EXPORT_SYMBOL(fscrypt_using_hardware_encryption);
+
+bool fscrypt_should_be_processed_by_ice(const struct inode *inode)
+{
+	if (!IS_ENCRYPTED(inode))
+		return false;
+
+	return fscrypt_using_hardware_encryption(inode);
+}
+
+bool fscrypt_is_aes_xts_cipher(const struct inode *inode)
+{
+	struct fscrypt_info *ci = ACCESS_ONCE(inode->i_crypt_info);
+
+	if (!ci)
+		return false;
+
+	return ci->ci_data_mode == FS_ENCRYPTION_MODE_AES_256_XTS;
+}
+
+char *fscrypt_get_ice_encryption_key(const struct inode *inode)
+{
+	struct fscrypt_info *ci = ACCESS_ONCE(inode->i_crypt_info);
+
+	if (!ci || !ci->ci_hw_enc)
+		return NULL;
+
+	return ci->ci_raw_key;
+}
+
+char *fscrypt_get_ice_encryption_salt(const struct inode *inode)
+{
+	struct fscrypt_info *ci = ACCESS_ONCE(inode->i_crypt_info);
+
+	if (!ci || !ci->ci_hw_enc)
+		return NULL;
+
+	return ci->ci_raw_key + FS_ICE_KEY_SIZE;
+}
+
+size_t fscrypt_get_ice_encryption_key_size(const struct inode *inode)
+{
+	return fscrypt_should_be_processed_by_ice(inode) ? FS_ICE_KEY_SIZE : 0;
+}
+
+size_t fscrypt_get_ice_encryption_salt_size(const struct inode *inode)
+{
+	return fscrypt_should_be_processed_by_ice(inode) ? FS_ICE_SALT_SIZE : 0;
+}
+
+bool fscrypt_is_ice_encryption_info_equal(const struct inode *inode1,
+					  const struct inode *inode2)
+{
+	char *key1, *key2;
+
+	if (inode1 == inode2)
+		return true;
+
+	key1 = fscrypt_get_ice_encryption_key(inode1);
+	key2 = fscrypt_get_ice_encryption_key(inode2);
+	if (!key1 || !key2)
+		return false;
+
+	return !crypto_memneq(key1, key2, FS_AES_256_XTS_KEY_SIZE);
+}
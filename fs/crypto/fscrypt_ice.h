@@ -0,0 +1,77 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _FSCRYPT_ICE_H
+#define _FSCRYPT_ICE_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_FS_ENCRYPTION_ICE
+
+/* ICE takes a 256 bit key and a 256 bit tweak key (salt) for AES-XTS */
+#define FS_AES_256_XTS_KEY_SIZE		64
+#define FS_ICE_KEY_SIZE			32
+#define FS_ICE_SALT_SIZE		32
+
+bool fscrypt_should_be_processed_by_ice(const struct inode *inode);
+bool fscrypt_is_aes_xts_cipher(const struct inode *inode);
+char *fscrypt_get_ice_encryption_key(const struct inode *inode);
+char *fscrypt_get_ice_encryption_salt(const struct inode *inode);
+size_t fscrypt_get_ice_encryption_key_size(const struct inode *inode);
+size_t fscrypt_get_ice_encryption_salt_size(const struct inode *inode);
+bool fscrypt_is_ice_encryption_info_equal(const struct inode *inode1,
+					  const struct inode *inode2);
+
+#else
+
+static inline bool fscrypt_should_be_processed_by_ice(const struct inode *inode)
+{
+	return false;
+}
+
+static inline bool fscrypt_is_aes_xts_cipher(const struct inode *inode)
+{
+	return false;
+}
+
+static inline char *fscrypt_get_ice_encryption_key(const struct inode *inode)
+{
+	return NULL;
+}
+
+static inline char *fscrypt_get_ice_encryption_salt(const struct inode *inode)
+{
+	return NULL;
+}
+
+static inline size_t
+fscrypt_get_ice_encryption_key_size(const struct inode *inode)
+{
+	return 0;
+}
+
+static inline size_t
+fscrypt_get_ice_encryption_salt_size(const struct inode *inode)
+{
+	return 0;
+}
+
+static inline bool
+fscrypt_is_ice_encryption_info_equal(const struct inode *inode1,
+				     const struct inode *inode2)
+{
+	return false;
+}
+
+#endif /* CONFIG_FS_ENCRYPTION_ICE */
+
+#endif /* _FSCRYPT_ICE_H */
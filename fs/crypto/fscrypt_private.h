@@ -61,6 +61,11 @@ struct fscrypt_info {
 	struct crypto_skcipher *ci_ctfm;
 	struct crypto_cipher *ci_essiv_tfm;
 	u8 ci_master_key[FS_KEY_DESCRIPTOR_SIZE];
+#ifdef CONFIG_FS_ENCRYPTION_ICE
+	/* contents are encrypted inline by the storage controller */
+	bool ci_hw_enc;
+	u8 ci_raw_key[FS_MAX_KEY_SIZE];
+#endif
 };
 
 typedef enum {
@@ -99,6 +104,13 @@ static inline bool fscrypt_valid_enc_modes(u32 contents_mode,
 /* crypto.c */
 extern struct kmem_cache *fscrypt_info_cachep;
 extern int fscrypt_initialize(unsigned int cop_flags);
+extern int fscrypt_do_page_crypto_req(const struct inode *inode,
+				      fscrypt_direction_t rw, u64 lblk_num,
+				      struct page *src_page,
+				      struct page *dest_page,
+				      unsigned int len, unsigned int offs,
+				      struct skcipher_request *req,
+				      struct crypto_wait *wait);
 extern int fscrypt_do_page_crypto(const struct inode *inode,
 				  fscrypt_direction_t rw, u64 lblk_num,
 				  struct page *src_page,
@@ -127,4 +139,35 @@ extern bool fscrypt_fname_encrypted_size(const struct inode *inode,
 /* keyinfo.c */
 extern void __exit fscrypt_essiv_cleanup(void);
 
+/* fscrypt_ice.c */
+#ifdef CONFIG_FS_ENCRYPTION_ICE
+extern bool fscrypt_inode_uses_ice(const struct inode *inode,
+				   const struct fscrypt_info *ci);
+extern int fscrypt_set_ice_key(struct fscrypt_info *ci, const u8 *raw_key,
+			       unsigned int keysize);
+
+static inline void fscrypt_clear_ice_key(struct fscrypt_info *ci)
+{
+	if (ci->ci_hw_enc)
+		memzero_explicit(ci->ci_raw_key, sizeof(ci->ci_raw_key));
+	ci->ci_hw_enc = false;
+}
+#else
+static inline bool fscrypt_inode_uses_ice(const struct inode *inode,
+					  const struct fscrypt_info *ci)
+{
+	return false;
+}
+
+static inline int fscrypt_set_ice_key(struct fscrypt_info *ci,
+				      const u8 *raw_key, unsigned int keysize)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void fscrypt_clear_ice_key(struct fscrypt_info *ci)
+{
+}
+#endif
+
 #endif /* _FSCRYPT_PRIVATE_H */
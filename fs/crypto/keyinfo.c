@@ -204,6 +204,7 @@ static void put_crypt_info(struct fscrypt_info *ci)
 
 	crypto_free_skcipher(ci->ci_ctfm);
 	crypto_free_cipher(ci->ci_essiv_tfm);
+	fscrypt_clear_ice_key(ci);
 	kmem_cache_free(fscrypt_info_cachep, ci);
 }
 
@@ -320,6 +321,7 @@ int fscrypt_get_encryption_info(struct inode *inode)
 	crypt_info->ci_filename_mode = ctx.filenames_encryption_mode;
 	crypt_info->ci_ctfm = NULL;
 	crypt_info->ci_essiv_tfm = NULL;
+	fscrypt_clear_ice_key(crypt_info);
 	memcpy(crypt_info->ci_master_key, ctx.master_key_descriptor,
 				sizeof(crypt_info->ci_master_key));
 
@@ -342,6 +344,17 @@ int fscrypt_get_encryption_info(struct inode *inode)
 	if (res)
 		goto out;
 
+	/*
+	 * Contents handled by the inline crypto engine never go through a
+	 * software transform, so don't allocate one.
+	 */
+	if (fscrypt_inode_uses_ice(inode, crypt_info)) {
+		res = fscrypt_set_ice_key(crypt_info, raw_key, mode->keysize);
+		if (res)
+			goto out;
+		goto install;
+	}
+
 	ctfm = crypto_alloc_skcipher(mode->cipher_str, 0, 0);
 	if (IS_ERR(ctfm)) {
 		res = PTR_ERR(ctfm);
@@ -379,6 +392,7 @@ int fscrypt_get_encryption_info(struct inode *inode)
 			goto out;
 		}
 	}
+install:
 	if (cmpxchg(&inode->i_crypt_info, NULL, crypt_info) == NULL)
 		crypt_info = NULL;
 out:
@@ -39,6 +39,7 @@
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
 #include <linux/kasan.h>
+#include <linux/moduleparam.h>
 
 #include "internal.h"
 #include "mount.h"
@@ -118,6 +119,18 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * A superblock may keep as many unused negative dentries as fit in
+ * 1/negative_dentry_ratio of memory; past that, dput() reclaims the
+ * oldest ones. 0 lifts the limit.
+ */
+static unsigned int negative_dentry_ratio = 64;
+core_param(negative_dentry_ratio, negative_dentry_ratio, uint, 0644);
+
+/* Negative dentries looked at per reclaim pass from dput() */
+#define NEGATIVE_DENTRY_BATCH	32
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -151,11 +164,21 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -305,7 +328,11 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 
 	dentry->d_inode = inode;
 	flags = READ_ONCE(dentry->d_flags);
-	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
+	if (unlikely(flags & DCACHE_NEGATIVE_LRU)) {
+		this_cpu_dec(nr_dentry_negative);
+		atomic_long_dec(&dentry->d_sb->s_nr_negative_dentry);
+	}
+	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU | DCACHE_NEGATIVE_LRU);
 	flags |= type_flags;
 	WRITE_ONCE(dentry->d_flags, flags);
 }
@@ -411,15 +438,38 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * The per-cpu "nr_dentry_unused" counters are updated with
  * the DCACHE_LRU_LIST bit.
  *
+ * The DCACHE_NEGATIVE_LRU bit is set on dentries that were negative
+ * when they went on the LRU, and counted in "nr_dentry_negative" and
+ * sb->s_nr_negative_dentry until they leave it or become positive.
+ *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
  */
 #define D_FLAG_VERIFY(dentry,x) WARN_ON_ONCE(((dentry)->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) != (x))
+static inline void d_lru_negative_add(struct dentry *dentry)
+{
+	if (d_is_negative(dentry)) {
+		dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+		this_cpu_inc(nr_dentry_negative);
+		atomic_long_inc(&dentry->d_sb->s_nr_negative_dentry);
+	}
+}
+
+static inline void d_lru_negative_del(struct dentry *dentry)
+{
+	if (dentry->d_flags & DCACHE_NEGATIVE_LRU) {
+		dentry->d_flags &= ~DCACHE_NEGATIVE_LRU;
+		this_cpu_dec(nr_dentry_negative);
+		atomic_long_dec(&dentry->d_sb->s_nr_negative_dentry);
+	}
+}
+
 static void d_lru_add(struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	d_lru_negative_add(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -428,6 +478,7 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	d_lru_negative_del(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -437,6 +488,7 @@ static void d_shrink_del(struct dentry *dentry)
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	this_cpu_dec(nr_dentry_unused);
+	d_lru_negative_del(dentry);
 }
 
 static void d_shrink_add(struct dentry *dentry, struct list_head *list)
@@ -458,6 +510,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	d_lru_negative_del(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -752,6 +805,18 @@ static inline bool fast_dput(struct dentry *dentry)
 }
 
 
+static void prune_negative_dentries(struct super_block *sb);
+
+/* Does @sb hold more unused negative dentries than it is allowed? */
+static inline bool d_negative_over_limit(struct super_block *sb)
+{
+	unsigned int ratio = READ_ONCE(negative_dentry_ratio);
+
+	return ratio && atomic_long_read(&sb->s_nr_negative_dentry) >
+		(long)((totalram_pages() << PAGE_SHIFT) / ratio /
+		       sizeof(struct dentry));
+}
+
 /* 
  * This is dput
  *
@@ -812,6 +877,14 @@ repeat:
 	dentry_lru_add(dentry);
 
 	dentry->d_lockref.count--;
+	if (unlikely(dentry->d_flags & DCACHE_NEGATIVE_LRU) &&
+	    d_negative_over_limit(dentry->d_sb)) {
+		struct super_block *sb = dentry->d_sb;
+
+		spin_unlock(&dentry->d_lock);
+		prune_negative_dentries(sb);
+		return;
+	}
 	spin_unlock(&dentry->d_lock);
 	return;
 
@@ -1125,6 +1198,56 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+static enum lru_status dentry_negative_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	/*
+	 * Positive dentries are left for the shrinker, referenced negative
+	 * ones get another pass, as in dentry_lru_isolate().
+	 */
+	if (!d_is_negative(dentry) || (dentry->d_flags & DCACHE_REFERENCED)) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Called by dput() when @sb went over its negative dentry limit: free the
+ * oldest unused negative dentries from the head of its LRU. One caller at
+ * a time does this, the others need not wait for it.
+ */
+static void prune_negative_dentries(struct super_block *sb)
+{
+	static atomic_t pruning = ATOMIC_INIT(0);
+	LIST_HEAD(dispose);
+
+	if (atomic_xchg(&pruning, 1))
+		return;
+
+	list_lru_walk(&sb->s_dentry_lru, dentry_negative_isolate, &dispose,
+		      NEGATIVE_DENTRY_BATCH);
+	shrink_dentry_list(&dispose);
+	atomic_set(&pruning, 0);
+}
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -43,6 +43,9 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/moduleparam.h>
 
 /*
  * LOCKING:
@@ -93,7 +96,12 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+
+#define EPOLLINOUT_BITS (POLLIN | POLLOUT)
+
+#define EPOLLEXCLUSIVE_OK_BITS (EPOLLINOUT_BITS | POLLERR | POLLHUP | \
+				EPOLLWAKEUP | EPOLLET | EPOLLEXCLUSIVE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -199,6 +207,15 @@ struct eventpoll {
 	/* List of ready file descriptors */
 	struct list_head rdllist;
 
+	/*
+	 * EPOLL_PERCPU only: per-CPU stacks of ready items, chained through
+	 * epi->next and spliced into rdllist under ->lock by ep_pcpu_merge().
+	 */
+	struct epitem * __percpu *pcpu_rdl;
+
+	/* EPOLL_PERCPU only: a waiter has been woken and not yet run */
+	int wake_pending;
+
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root rbr;
 
@@ -264,6 +281,23 @@ static DEFINE_MUTEX(epmutex);
 
 static u64 loop_check_gen = 0;
 
+/* Create every epoll instance as if EPOLL_PERCPU had been passed */
+static bool epoll_percpu;
+core_param(epoll_percpu, epoll_percpu, bool, 0644);
+
+struct ep_stats {
+	unsigned long callbacks;
+	unsigned long contended;
+	unsigned long pcpu_queued;
+	unsigned long wakeups;
+	unsigned long wakeups_coalesced;
+	unsigned long merged;
+};
+
+static DEFINE_PER_CPU(struct ep_stats, ep_stats);
+
+#define ep_stat_inc(field)	this_cpu_inc(ep_stats.field)
+
 /* Used to check for epoll file descriptor inclusion loops */
 static struct nested_calls poll_loop_ncalls;
 
@@ -375,7 +409,16 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	int cpu;
+
+	if (!list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR)
+		return 1;
+	if (ep->pcpu_rdl) {
+		for_each_possible_cpu(cpu)
+			if (READ_ONCE(*per_cpu_ptr(ep->pcpu_rdl, cpu)))
+				return 1;
+	}
+	return 0;
 }
 
 /**
@@ -580,6 +623,31 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+/*
+ * Move the items queued on the per-CPU lists of an EPOLL_PERCPU instance
+ * to ep->rdllist. Must be called with "mtx" and "ep->lock" held.
+ */
+static void ep_pcpu_merge(struct eventpoll *ep)
+{
+	struct epitem *epi, *nepi;
+	int cpu;
+
+	if (!ep->pcpu_rdl)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		nepi = xchg(per_cpu_ptr(ep->pcpu_rdl, cpu), NULL);
+		for (; (epi = nepi) != NULL;
+		     nepi = epi->next, WRITE_ONCE(epi->next, EP_UNACTIVE_PTR)) {
+			if (!ep_is_linked(&epi->rdllink)) {
+				list_add_tail(&epi->rdllink, &ep->rdllist);
+				ep_pm_stay_awake(epi);
+			}
+			ep_stat_inc(merged);
+		}
+	}
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -620,6 +688,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_pcpu_merge(ep);
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -716,6 +785,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	rb_erase(&epi->rbn, &ep->rbr);
 
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_pcpu_merge(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -784,6 +854,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	free_percpu(ep->pcpu_rdl);
 	kfree(ep);
 }
 
@@ -936,7 +1007,7 @@ void eventpoll_release_file(struct file *file)
 	mutex_unlock(&epmutex);
 }
 
-static int ep_alloc(struct eventpoll **pep)
+static int ep_alloc(struct eventpoll **pep, int flags)
 {
 	int error;
 	struct user_struct *user;
@@ -957,10 +1028,18 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
 
+	if ((flags & EPOLL_PERCPU) || epoll_percpu) {
+		ep->pcpu_rdl = alloc_percpu(struct epitem *);
+		if (unlikely(!ep->pcpu_rdl))
+			goto free_ep;
+	}
+
 	*pep = ep;
 
 	return 0;
 
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -995,6 +1074,80 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+#define ep_lock_callback(ep, flags)					\
+	do {								\
+		if (!spin_trylock_irqsave(&(ep)->lock, flags)) {	\
+			ep_stat_inc(contended);				\
+			spin_lock_irqsave(&(ep)->lock, flags);		\
+		}							\
+	} while (0)
+
+/*
+ * Would an event matching "key" be reported for an EPOLLEXCLUSIVE item? If
+ * not, the wakeup is passed on to the next exclusive waiter of the file.
+ */
+static inline int ep_exclusive_match(struct epitem *epi, void *key)
+{
+	switch ((unsigned long)key & EPOLLINOUT_BITS) {
+	case POLLIN:
+		return !!(epi->event.events & POLLIN);
+	case POLLOUT:
+		return !!(epi->event.events & POLLOUT);
+	default:
+		return 1;
+	}
+}
+
+/*
+ * ep_poll_callback() for EPOLL_PERCPU instances. The item is pushed on the
+ * list of the local CPU without taking ep->lock, and of the events that
+ * arrive while a waiter is being woken only the first one takes the lock:
+ * the waiter will find the others when it merges the lists.
+ */
+static int ep_poll_callback_pcpu(struct eventpoll *ep, struct epitem *epi,
+				 void *key)
+{
+	struct epitem **head, *first;
+	unsigned long flags;
+
+	if (!(epi->event.events & ~EP_PRIVATE_BITS))
+		return 0;
+	if (key && !((unsigned long) key & epi->event.events))
+		return 0;
+
+	/* An item already on some CPU list is picked up by the next merge */
+	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) == EP_UNACTIVE_PTR) {
+		head = this_cpu_ptr(ep->pcpu_rdl);
+		do {
+			first = READ_ONCE(*head);
+			epi->next = first;
+		} while (cmpxchg(head, first, epi) != first);
+		/* Activate ep->ws, epi->ws may get deactivated at any time */
+		if (ep_has_wakeup_source(epi))
+			__pm_stay_awake(ep->ws);
+		ep_stat_inc(pcpu_queued);
+	}
+
+	/* Pairs with set_current_state() in ep_poll() */
+	smp_mb();
+	if (waitqueue_active(&ep->wq)) {
+		if (!xchg(&ep->wake_pending, 1)) {
+			ep_lock_callback(ep, flags);
+			if (waitqueue_active(&ep->wq))
+				wake_up_locked(&ep->wq);
+			spin_unlock_irqrestore(&ep->lock, flags);
+			ep_stat_inc(wakeups);
+		} else {
+			ep_stat_inc(wakeups_coalesced);
+		}
+	}
+	if (waitqueue_active(&ep->poll_wait))
+		ep_poll_safewake(&ep->poll_wait);
+
+	return (epi->event.events & EPOLLEXCLUSIVE) && key ?
+		ep_exclusive_match(epi, key) : 1;
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * mechanism. It is called by the stored file descriptors when they
@@ -1006,8 +1159,16 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
+	int ewake = 0;
 
-	spin_lock_irqsave(&ep->lock, flags);
+	ep_stat_inc(callbacks);
+
+	if (ep->pcpu_rdl) {
+		ewake = ep_poll_callback_pcpu(ep, epi, key);
+		goto out_pollfree;
+	}
+
+	ep_lock_callback(ep, flags);
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
@@ -1059,11 +1220,16 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
 		wake_up_locked(&ep->wq);
+		ep_stat_inc(wakeups);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
+	ewake = (epi->event.events & EPOLLEXCLUSIVE) && key ?
+		ep_exclusive_match(epi, key) : 1;
+
 out_unlock:
 	spin_unlock_irqrestore(&ep->lock, flags);
 
@@ -1071,6 +1237,7 @@ out_unlock:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
+out_pollfree:
 
 	if ((unsigned long)key & POLLFREE) {
 		/*
@@ -1088,7 +1255,7 @@ out_unlock:
 		smp_store_release(&ep_pwq_from_wait(wait)->whead, NULL);
 	}
 
-	return 1;
+	return ewake;
 }
 
 /*
@@ -1105,7 +1272,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1391,6 +1561,7 @@ error_remove_epi:
 	 * And ep_insert() is called with "mtx" held.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_pcpu_merge(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -1641,8 +1812,11 @@ fetch_events:
 			/*
 			 * We don't want to sleep if the ep_poll_callback() sends us
 			 * a wakeup in between. That's why we set the task state
-			 * to TASK_INTERRUPTIBLE before doing the checks.
+			 * to TASK_INTERRUPTIBLE before doing the checks. Clearing
+			 * wake_pending first lets the next EPOLL_PERCPU event
+			 * wake us again.
 			 */
+			WRITE_ONCE(ep->wake_pending, 0);
 			set_current_state(TASK_INTERRUPTIBLE);
 			if (ep_events_available(ep) || timed_out)
 				break;
@@ -1660,6 +1834,8 @@ fetch_events:
 		}
 
 		__remove_wait_queue(&ep->wq, &wait);
+		/* A wakeup coalesced onto us must reach the other waiters */
+		WRITE_ONCE(ep->wake_pending, 0);
 		__set_current_state(TASK_RUNNING);
 	}
 check_events:
@@ -1781,12 +1957,12 @@ SYSCALL_DEFINE1(epoll_create1, int, flags)
 	/* Check the EPOLL_* constant for consistency.  */
 	BUILD_BUG_ON(EPOLL_CLOEXEC != O_CLOEXEC);
 
-	if (flags & ~EPOLL_CLOEXEC)
+	if (flags & ~(EPOLL_CLOEXEC | EPOLL_PERCPU))
 		return -EINVAL;
 	/*
 	 * Create the internal data structure ("struct eventpoll").
 	 */
-	error = ep_alloc(&ep);
+	error = ep_alloc(&ep, flags);
 	if (error < 0)
 		return error;
 	/*
@@ -1872,6 +2048,19 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (f.file == tf.file || !is_file_epoll(f.file))
 		goto error_tgt_fput;
 
+	/*
+	 * epoll adds to the wakeup queue at EPOLL_CTL_ADD time only,
+	 * so EPOLLEXCLUSIVE is not allowed for a EPOLL_CTL_MOD operation.
+	 * Also, we do not currently support nested exclusive wakeups.
+	 */
+	if (ep_op_has_event(op) && (epds.events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			goto error_tgt_fput;
+		if (op == EPOLL_CTL_ADD && (is_file_epoll(tf.file) ||
+				(epds.events & ~EPOLLEXCLUSIVE_OK_BITS)))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * At this point it is safe to assume that the "private_data" contains
 	 * our own data structure.
@@ -1942,8 +2131,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds.events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, &epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
@@ -2144,3 +2335,60 @@ static int __init eventpoll_init(void)
 	return 0;
 }
 fs_initcall(eventpoll_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int ep_stats_show(struct seq_file *m, void *v)
+{
+	struct ep_stats sum = { 0 }, *st;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(&ep_stats, cpu);
+		sum.callbacks += st->callbacks;
+		sum.contended += st->contended;
+		sum.pcpu_queued += st->pcpu_queued;
+		sum.wakeups += st->wakeups;
+		sum.wakeups_coalesced += st->wakeups_coalesced;
+		sum.merged += st->merged;
+	}
+
+	seq_printf(m, "callbacks:         %lu\n", sum.callbacks);
+	seq_printf(m, "lock_contended:    %lu\n", sum.contended);
+	seq_printf(m, "pcpu_queued:       %lu\n", sum.pcpu_queued);
+	seq_printf(m, "pcpu_merged:       %lu\n", sum.merged);
+	seq_printf(m, "wakeups:           %lu\n", sum.wakeups);
+	seq_printf(m, "wakeups_coalesced: %lu\n", sum.wakeups_coalesced);
+	return 0;
+}
+
+static int ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ep_stats_show, NULL);
+}
+
+static ssize_t ep_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&ep_stats, cpu), 0, sizeof(struct ep_stats));
+	return count;
+}
+
+static const struct file_operations ep_stats_fops = {
+	.open		= ep_stats_open,
+	.read		= seq_read,
+	.write		= ep_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ep_stats_init(void)
+{
+	debugfs_create_file("eventpoll_stats", 0644, NULL, NULL,
+			    &ep_stats_fops);
+	return 0;
+}
+late_initcall(ep_stats_init);
+#endif
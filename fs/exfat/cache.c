@@ -13,11 +13,28 @@
 #include <linux/slab.h>
 #include <asm/unaligned.h>
 #include <linux/buffer_head.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "exfat_raw.h"
 #include "exfat_fs.h"
 
-#define EXFAT_MAX_CACHE		16
+#define EXFAT_MAX_CACHE		64
+
+/* cluster chain lookups, over all mounts */
+enum {
+	EXFAT_CACHE_HIT,	/* the cluster was inside a cached extent */
+	EXFAT_CACHE_NEAR,	/* walked on from a cached extent */
+	EXFAT_CACHE_MISS,	/* walked from the first cluster */
+	EXFAT_CACHE_FAT_READ,	/* FAT entries read by those walks */
+	EXFAT_CACHE_NR_STATS,
+};
+
+static const char * const exfat_cache_stat_names[EXFAT_CACHE_NR_STATS] = {
+	"hit", "near", "miss", "fat_entries",
+};
+
+static atomic_long_t exfat_cache_stats[EXFAT_CACHE_NR_STATS];
 
 struct exfat_cache {
 	struct list_head cache_list;
@@ -35,6 +52,43 @@ struct exfat_cache_id {
 
 static struct kmem_cache *exfat_cachep;
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *exfat_cache_dentry;
+
+static int exfat_cache_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	for (i = 0; i < EXFAT_CACHE_NR_STATS; i++)
+		seq_printf(m, "%s %ld\n", exfat_cache_stat_names[i],
+			   atomic_long_read(&exfat_cache_stats[i]));
+	return 0;
+}
+
+static int exfat_cache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, exfat_cache_stats_show, NULL);
+}
+
+static ssize_t exfat_cache_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int i;
+
+	for (i = 0; i < EXFAT_CACHE_NR_STATS; i++)
+		atomic_long_set(&exfat_cache_stats[i], 0);
+	return count;
+}
+
+static const struct file_operations exfat_cache_stats_fops = {
+	.open		= exfat_cache_stats_open,
+	.read		= seq_read,
+	.write		= exfat_cache_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static void exfat_cache_init_once(void *c)
 {
 	struct exfat_cache *cache = (struct exfat_cache *)c;
@@ -50,6 +104,10 @@ int exfat_cache_init(void)
 				exfat_cache_init_once);
 	if (!exfat_cachep)
 		return -ENOMEM;
+#ifdef CONFIG_DEBUG_FS
+	exfat_cache_dentry = debugfs_create_file("exfat_cache_stats", 0644,
+				NULL, NULL, &exfat_cache_stats_fops);
+#endif
 	return 0;
 }
 
@@ -57,6 +115,9 @@ void exfat_cache_shutdown(void)
 {
 	if (!exfat_cachep)
 		return;
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(exfat_cache_dentry);
+#endif
 	kmem_cache_destroy(exfat_cachep);
 }
 
@@ -243,6 +304,8 @@ int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 	struct exfat_inode_info *ei = EXFAT_I(inode);
 	struct exfat_cache_id cid;
 	unsigned int content;
+	sector_t ra_start = 0, ra_end = 0, sec;
+	int stat;
 
 	if (ei->start_clu == EXFAT_FREE_CLUSTER) {
 		exfat_fs_error(sb,
@@ -263,8 +326,10 @@ int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 
 	cache_init(&cid, EXFAT_EOF_CLUSTER, EXFAT_EOF_CLUSTER);
 
+	stat = EXFAT_CACHE_NEAR;
 	if (exfat_cache_lookup(inode, cluster, &cid, fclus, dclus) ==
 			EXFAT_EOF_CLUSTER) {
+		stat = EXFAT_CACHE_MISS;
 		/*
 		 * dummy, always not contiguous
 		 * This is reinitialized by cache_init(), later.
@@ -275,8 +340,13 @@ int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 			cid.nr_contig != 0);
 	}
 
-	if (*fclus == cluster)
+	if (*fclus == cluster) {
+		atomic_long_inc(&exfat_cache_stats[EXFAT_CACHE_HIT]);
 		return 0;
+	}
+	atomic_long_inc(&exfat_cache_stats[stat]);
+	atomic_long_add(cluster - *fclus,
+			&exfat_cache_stats[EXFAT_CACHE_FAT_READ]);
 
 	while (*fclus < cluster) {
 		/* prevent the infinite loop of cluster chain */
@@ -287,6 +357,18 @@ int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 			return -EIO;
 		}
 
+		/*
+		 * Chains are mostly allocated forward, so the entries still
+		 * to be walked tend to follow this one in the FAT.
+		 */
+		sec = FAT_ENT_OFFSET_SECTOR(sb, *dclus);
+		if ((sec < ra_start || sec >= ra_end) &&
+		    cluster - *fclus > 1 && is_valid_cluster(sbi, *dclus)) {
+			ra_start = sec;
+			ra_end = exfat_ent_readahead(sb, *dclus,
+						     cluster - *fclus);
+		}
+
 		if (exfat_ent_get(sb, *dclus, &content))
 			return -EIO;
 
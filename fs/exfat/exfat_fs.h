@@ -119,6 +119,9 @@ enum {
 #define FAT_ENT_OFFSET_BYTE_IN_SECTOR(sb, loc)	\
 	((loc << FAT_ENT_SIZE_BITS) & (sb->s_blocksize - 1))
 
+/* max FAT readahead when walking a cluster chain */
+#define EXFAT_FAT_RA_BYTES	(128 * 1024)
+
 /*
  * helpers for bitmap.
  */
@@ -421,6 +424,8 @@ int exfat_ent_get(struct super_block *sb, unsigned int loc,
 		unsigned int *content);
 int exfat_ent_set(struct super_block *sb, unsigned int loc,
 		unsigned int content);
+sector_t exfat_ent_readahead(struct super_block *sb, unsigned int loc,
+		unsigned int nr_ents);
 int exfat_count_ext_entries(struct super_block *sb, struct exfat_chain *p_dir,
 		int entry, struct exfat_dentry *p_entry);
 int exfat_chain_cont_cluster(struct super_block *sb, unsigned int chain,
@@ -63,6 +63,34 @@ static int __exfat_ent_get(struct super_block *sb, unsigned int loc,
 	return 0;
 }
 
+/*
+ * Start reading the FAT sectors holding the nr_ents entries from loc on,
+ * so that walking a long chain does not wait on one sector at a time.
+ * Returns the first sector past the window.
+ */
+sector_t exfat_ent_readahead(struct super_block *sb, unsigned int loc,
+		unsigned int nr_ents)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	sector_t sec = FAT_ENT_OFFSET_SECTOR(sb, loc);
+	sector_t end = sbi->FAT1_start_sector + sbi->num_FAT_sectors;
+	unsigned int nr_sec;
+	struct blk_plug plug;
+
+	nr_ents = min_t(unsigned int, nr_ents,
+			EXFAT_FAT_RA_BYTES >> FAT_ENT_SIZE_BITS);
+	nr_sec = ((nr_ents << FAT_ENT_SIZE_BITS) >> sb->s_blocksize_bits) + 1;
+	if (end > sec + nr_sec)
+		end = sec + nr_sec;
+
+	blk_start_plug(&plug);
+	for (; sec < end; sec++)
+		sb_breadahead(sb, sec);
+	blk_finish_plug(&plug);
+
+	return end;
+}
+
 int exfat_ent_set(struct super_block *sb, unsigned int loc,
 		unsigned int content)
 {
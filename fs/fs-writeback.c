@@ -28,6 +28,12 @@
 #include <linux/tracepoint.h>
 #include <linux/device.h>
 #include <linux/memcontrol.h>
+#include <linux/blk-cgroup.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "internal.h"
 
 /*
@@ -88,6 +94,68 @@ static inline struct inode *wb_inode(struct list_head *head)
 	return list_entry(head, struct inode, i_io_list);
 }
 
+/*
+ * Inodes dirtied by foreground tasks are queued for IO ahead of those
+ * dirtied only by background ones (blkio.background cgroups and the idle
+ * I/O priority class), so that the data an interactive task is about to
+ * fsync or wait on does not queue behind a bulk background writer.
+ */
+static bool writeback_fg_first = true;
+core_param(writeback_fg_first, writeback_fg_first, bool, 0644);
+
+enum {
+	WB_CLASS_FG,
+	WB_CLASS_BG,
+	WB_NR_CLASSES,
+};
+
+/* dirty to clean latency buckets: <1ms, doubling, the last is the rest */
+#define WB_LAT_NR_BUCKETS	16
+
+struct wb_class_stats {
+	u64 inodes;
+	u64 pages;
+	u64 sum_ms;
+	u32 max_ms;
+	u32 hist[WB_LAT_NR_BUCKETS];
+};
+
+static DEFINE_SPINLOCK(wb_class_lock);
+static struct wb_class_stats wb_class_stats[WB_NR_CLASSES];
+
+static bool writeback_task_background(struct task_struct *tsk)
+{
+	struct io_context *ioc = tsk->io_context;
+
+	if (ioc && IOPRIO_PRIO_CLASS(ioc->ioprio) == IOPRIO_CLASS_IDLE)
+		return true;
+	return blkcg_task_background(tsk);
+}
+
+/*
+ * Account @pages written from an inode of @class.  If the writeout left it
+ * @clean, also account the time since it was dirtied, @dirtied_when.
+ */
+static void wb_class_account(int class, long pages, bool clean,
+			     unsigned long dirtied_when)
+{
+	struct wb_class_stats *st = &wb_class_stats[class];
+	u32 ms = 0;
+
+	if (clean)
+		ms = jiffies_to_msecs(jiffies - dirtied_when);
+
+	spin_lock(&wb_class_lock);
+	st->pages += pages;
+	if (clean) {
+		st->inodes++;
+		st->sum_ms += ms;
+		st->max_ms = max(st->max_ms, ms);
+		st->hist[min(fls(ms), WB_LAT_NR_BUCKETS - 1)]++;
+	}
+	spin_unlock(&wb_class_lock);
+}
+
 /*
  * Include the creation of the trace points after defining the
  * wb_writeback_work structure and inline functions so that the definition
@@ -1126,6 +1194,8 @@ static int move_expired_inodes(struct list_head *delaying_queue,
 	struct inode *inode;
 	int do_sb_sort = 0;
 	int moved = 0;
+	int nr_fg = 0;
+	int i;
 
 	while (!list_empty(delaying_queue)) {
 		inode = wb_inode(delaying_queue->prev);
@@ -1137,6 +1207,8 @@ static int move_expired_inodes(struct list_head *delaying_queue,
 		if (flags & EXPIRE_DIRTY_ATIME)
 			inode->i_state |= I_DIRTY_TIME_EXPIRED;
 		inode->i_state |= I_SYNC_QUEUED;
+		if (inode->i_state & I_DIRTY_FG)
+			nr_fg++;
 		spin_unlock(&inode->i_lock);
 		if (sb_is_blkdev_sb(inode->i_sb))
 			continue;
@@ -1148,7 +1220,7 @@ static int move_expired_inodes(struct list_head *delaying_queue,
 	/* just one sb in list, splice to dispatch_queue and we're done */
 	if (!do_sb_sort) {
 		list_splice(&tmp, dispatch_queue);
-		goto out;
+		goto fg_first;
 	}
 
 	/* Move inodes from one superblock together */
@@ -1160,7 +1232,23 @@ static int move_expired_inodes(struct list_head *delaying_queue,
 				list_move(&inode->i_io_list, dispatch_queue);
 		}
 	}
-out:
+
+fg_first:
+	/*
+	 * The @moved inodes are now at the head of @dispatch_queue, which is
+	 * consumed from the tail.  Move the foreground dirtied ones, in
+	 * order, to the tail to have them written first.
+	 */
+	if (nr_fg && nr_fg < moved && writeback_fg_first) {
+		pos = dispatch_queue->next;
+		for (i = 0; i < moved; i++) {
+			node = pos->next;
+			if (wb_inode(pos)->i_state & I_DIRTY_FG)
+				list_move_tail(pos, &tmp);
+			pos = node;
+		}
+		list_splice_tail(&tmp, dispatch_queue);
+	}
 	return moved;
 }
 
@@ -1333,7 +1421,10 @@ __writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 {
 	struct address_space *mapping = inode->i_mapping;
 	long nr_to_write = wbc->nr_to_write;
+	unsigned long dirtied_when;
 	unsigned dirty;
+	bool clean;
+	int class;
 	int ret;
 
 	WARN_ON(!(inode->i_state & I_SYNC));
@@ -1392,8 +1483,17 @@ __writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 	if (mapping_tagged(mapping, PAGECACHE_TAG_DIRTY))
 		inode->i_state |= I_DIRTY_PAGES;
 
+	class = inode->i_state & I_DIRTY_FG ? WB_CLASS_FG : WB_CLASS_BG;
+	clean = dirty && !(inode->i_state & I_DIRTY);
+	if (!(inode->i_state & I_DIRTY))
+		inode->i_state &= ~I_DIRTY_FG;
+	dirtied_when = inode->dirtied_when;
+
 	spin_unlock(&inode->i_lock);
 
+	wb_class_account(class, nr_to_write - wbc->nr_to_write, clean,
+			 dirtied_when);
+
 	if (dirty & I_DIRTY_TIME)
 		mark_inode_dirty_sync(inode);
 	/* Don't write the inode if only I_DIRTY_PAGES was set */
@@ -2036,6 +2136,67 @@ static int __init start_dirtytime_writeback(void)
 }
 __initcall(start_dirtytime_writeback);
 
+#ifdef CONFIG_DEBUG_FS
+static const char * const wb_class_name[WB_NR_CLASSES] = {
+	[WB_CLASS_FG]	= "fg",
+	[WB_CLASS_BG]	= "bg",
+};
+
+static int wb_class_stats_show(struct seq_file *m, void *v)
+{
+	struct wb_class_stats st[WB_NR_CLASSES];
+	int class, i;
+
+	spin_lock(&wb_class_lock);
+	memcpy(st, wb_class_stats, sizeof(st));
+	spin_unlock(&wb_class_lock);
+
+	seq_puts(m, "# latency buckets: <1ms, doubling, last is the rest\n");
+	seq_puts(m, "# class     inodes        pages   avg_ms   max_ms buckets\n");
+	for (class = 0; class < WB_NR_CLASSES; class++) {
+		seq_printf(m, "%-5s %12llu %12llu %8llu %8u", wb_class_name[class],
+			   st[class].inodes, st[class].pages,
+			   st[class].inodes ?
+			   div64_u64(st[class].sum_ms, st[class].inodes) : 0,
+			   st[class].max_ms);
+		for (i = 0; i < WB_LAT_NR_BUCKETS; i++)
+			seq_printf(m, " %u", st[class].hist[i]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static int wb_class_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wb_class_stats_show, NULL);
+}
+
+static ssize_t wb_class_stats_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	spin_lock(&wb_class_lock);
+	memset(wb_class_stats, 0, sizeof(wb_class_stats));
+	spin_unlock(&wb_class_lock);
+	return count;
+}
+
+static const struct file_operations wb_class_stats_fops = {
+	.open		= wb_class_stats_open,
+	.read		= seq_read,
+	.write		= wb_class_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wb_class_stats_init(void)
+{
+	debugfs_create_file("writeback_class_stats", 0644, NULL, NULL,
+			    &wb_class_stats_fops);
+	return 0;
+}
+late_initcall(wb_class_stats_init);
+#endif
+
 int dirtytime_interval_handler(struct ctl_table *table, int write,
 			       void __user *buffer, size_t *lenp, loff_t *ppos)
 {
@@ -2076,6 +2237,7 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 #define I_DIRTY_INODE (I_DIRTY_SYNC | I_DIRTY_DATASYNC)
 	struct super_block *sb = inode->i_sb;
 	int dirtytime;
+	bool fg;
 
 	trace_writeback_mark_inode_dirty(inode, flags);
 
@@ -2094,6 +2256,7 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 	if (flags & I_DIRTY_INODE)
 		flags &= ~I_DIRTY_TIME;
 	dirtytime = flags & I_DIRTY_TIME;
+	fg = !dirtytime && !writeback_task_background(current);
 
 	/*
 	 * Paired with smp_mb() in __writeback_single_inode() for the
@@ -2101,11 +2264,14 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 	 */
 	smp_mb();
 
-	if (((inode->i_state & flags) == flags) ||
-	    (dirtytime && (inode->i_state & I_DIRTY_INODE)))
+	if ((((inode->i_state & flags) == flags) ||
+	     (dirtytime && (inode->i_state & I_DIRTY_INODE))) &&
+	    (!fg || (inode->i_state & I_DIRTY_FG)))
 		return;
 
 	spin_lock(&inode->i_lock);
+	if (fg)
+		inode->i_state |= I_DIRTY_FG;
 	if (dirtytime && (inode->i_state & I_DIRTY_INODE))
 		goto out_unlock_inode;
 	if ((inode->i_state & flags) != flags) {
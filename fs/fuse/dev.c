@@ -22,6 +22,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/freezer.h>
+#include <linux/vmalloc.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -335,15 +336,71 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 	return nbytes;
 }
 
+/*
+ * Per-CPU queues tag their ids with the top bit and the queue index, so
+ * ids never collide across queues and the default queue is unaffected.
+ */
+#define FUSE_MQ_UNIQUE_BIT	(1ULL << 63)
+#define FUSE_MQ_INDEX_SHIFT	16
+
 static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 {
-	return ++fiq->reqctr;
+	if (!fiq->index)
+		return ++fiq->reqctr;
+
+	return FUSE_MQ_UNIQUE_BIT | (++fiq->reqctr << FUSE_MQ_INDEX_SHIFT) |
+		fiq->index;
+}
+
+/*
+ * Pick the input queue for a new request: the submitting CPU's queue if a
+ * device is reading it, the default queue otherwise.  Returns with the
+ * queue's waitq.lock held.
+ */
+static struct fuse_iqueue *fuse_lock_iqueue(struct fuse_conn *fc)
+{
+	struct fuse_iqueue **mq = lockless_dereference(fc->mq);
+	struct fuse_iqueue *fiq;
+
+	if (mq) {
+		fiq = lockless_dereference(mq[raw_smp_processor_id()]);
+		if (fiq) {
+			spin_lock(&fiq->waitq.lock);
+			if (fiq->nr_readers)
+				return fiq;
+			spin_unlock(&fiq->waitq.lock);
+		}
+	}
+
+	fiq = &fc->iq;
+	spin_lock(&fiq->waitq.lock);
+	return fiq;
+}
+
+/*
+ * Lock the input queue @req was put on.  Pending requests move to the
+ * default queue when the last reader of a per-CPU queue goes away, so
+ * recheck after taking the lock.
+ */
+static struct fuse_iqueue *fuse_lock_req_iqueue(struct fuse_conn *fc,
+						struct fuse_req *req)
+{
+	struct fuse_iqueue *fiq;
+
+	for (;;) {
+		fiq = READ_ONCE(req->fiq) ?: &fc->iq;
+		spin_lock(&fiq->waitq.lock);
+		if (fiq == (req->fiq ?: &fc->iq))
+			return fiq;
+		spin_unlock(&fiq->waitq.lock);
+	}
 }
 
 static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	req->fiq = fiq;
 	list_add_tail(&req->list, &fiq->pending);
 	wake_up_locked(&fiq->waitq);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
@@ -374,12 +431,12 @@ static void flush_bg_queue(struct fuse_conn *fc)
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
 		struct fuse_req *req;
-		struct fuse_iqueue *fiq = &fc->iq;
+		struct fuse_iqueue *fiq;
 
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->waitq.lock);
+		fiq = fuse_lock_iqueue(fc);
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request(fiq, req);
 		spin_unlock(&fiq->waitq.lock);
@@ -396,12 +453,12 @@ static void flush_bg_queue(struct fuse_conn *fc)
  */
 static void request_end(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	if (test_and_set_bit(FR_FINISHED, &req->flags))
 		goto put_request;
 
-	spin_lock(&fiq->waitq.lock);
+	fiq = fuse_lock_req_iqueue(fc, req);
 	list_del_init(&req->intr_entry);
 	spin_unlock(&fiq->waitq.lock);
 	WARN_ON(test_bit(FR_PENDING, &req->flags));
@@ -440,9 +497,10 @@ put_request:
 	fuse_put_request(fc, req);
 }
 
-static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
+static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
-	spin_lock(&fiq->waitq.lock);
+	struct fuse_iqueue *fiq = fuse_lock_req_iqueue(fc, req);
+
 	if (test_bit(FR_FINISHED, &req->flags)) {
 		spin_unlock(&fiq->waitq.lock);
 		return;
@@ -457,7 +515,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 	int err;
 
 	if (!fc->no_interrupt) {
@@ -471,7 +529,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		/* matches barrier in fuse_dev_do_read() */
 		smp_mb__after_atomic();
 		if (test_bit(FR_SENT, &req->flags))
-			queue_interrupt(fiq, req);
+			queue_interrupt(fc, req);
 	}
 
 	if (!test_bit(FR_FORCE, &req->flags)) {
@@ -486,7 +544,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->waitq.lock);
+		fiq = fuse_lock_req_iqueue(fc, req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
@@ -509,10 +567,10 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 
 static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->waitq.lock);
+	fiq = fuse_lock_iqueue(fc);
 	if (!fiq->connected) {
 		spin_unlock(&fiq->waitq.lock);
 		req->out.h.error = -ENOTCONN;
@@ -1289,7 +1347,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq = fud->fiq;
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -1380,7 +1438,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	/* matches barrier in request_wait_answer() */
 	smp_mb__after_atomic();
 	if (test_bit(FR_INTERRUPTED, &req->flags))
-		queue_interrupt(fiq, req);
+		queue_interrupt(fc, req);
 	fuse_put_request(fc, req);
 
 	return reqsize;
@@ -1602,6 +1660,108 @@ err:
 	return err;
 }
 
+/* Upper bound on the size of a FUSE_NOTIFY_INVAL_BATCH message */
+#define FUSE_NOTIFY_INVAL_BATCH_MAX	(256 * 1024)
+
+static int fuse_inval_batch_one(struct fuse_conn *fc,
+				struct fuse_notify_inval_rec *rec)
+{
+	struct qstr name;
+
+	if (rec->code == FUSE_NOTIFY_INVAL_INODE)
+		return fuse_reverse_inval_inode(fc->sb, rec->nodeid,
+						rec->off, rec->len);
+
+	name.name = (char *)(rec + 1);
+	name.len = rec->namelen;
+	name.hash = full_name_hash(name.name, name.len);
+
+	return fuse_reverse_inval_entry(fc->sb, rec->nodeid, 0, &name);
+}
+
+/*
+ * Process a whole array of inode and entry invalidations with a single
+ * write and a single acquisition of fc->killsb.  The message is copied
+ * in first, so the copy state is finished before any invalidation runs.
+ */
+static int fuse_notify_inval_batch(struct fuse_conn *fc, unsigned int size,
+				   struct fuse_copy_state *cs)
+{
+	struct fuse_notify_inval_batch_out *outarg;
+	struct fuse_notify_inval_rec *rec;
+	unsigned int i, pos, reclen;
+	void *buf = NULL;
+	int err, ret = 0;
+
+	err = -EINVAL;
+	if (size < sizeof(*outarg) || size > FUSE_NOTIFY_INVAL_BATCH_MAX)
+		goto err;
+
+	err = -ENOMEM;
+	buf = kmalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (!buf)
+		buf = vmalloc(size);
+	if (!buf)
+		goto err;
+
+	err = fuse_copy_one(cs, buf, size);
+	if (err)
+		goto err;
+	fuse_copy_finish(cs);
+
+	/* Validate every record before acting on any of them */
+	outarg = buf;
+	pos = sizeof(*outarg);
+	for (i = 0; i < outarg->count; i++) {
+		err = -EINVAL;
+		if (size - pos < sizeof(*rec))
+			goto out;
+		rec = buf + pos;
+		if (rec->code == FUSE_NOTIFY_INVAL_ENTRY) {
+			err = -ENAMETOOLONG;
+			if (rec->namelen > FUSE_NAME_MAX)
+				goto out;
+		} else if (rec->code != FUSE_NOTIFY_INVAL_INODE ||
+			   rec->namelen) {
+			goto out;
+		}
+		reclen = FUSE_INVAL_REC_SIZE(rec);
+		err = -EINVAL;
+		if (size - pos < reclen)
+			goto out;
+		if (rec->code == FUSE_NOTIFY_INVAL_ENTRY)
+			((char *)(rec + 1))[rec->namelen] = 0;
+		pos += reclen;
+	}
+	err = -EINVAL;
+	if (pos != size)
+		goto out;
+
+	down_read(&fc->killsb);
+	err = -ENOENT;
+	if (fc->sb) {
+		err = 0;
+		pos = sizeof(*outarg);
+		for (i = 0; i < outarg->count; i++) {
+			rec = buf + pos;
+			ret = fuse_inval_batch_one(fc, rec);
+			/* Objects that are not cached need no invalidation */
+			if (ret && ret != -ENOENT && !err)
+				err = ret;
+			pos += FUSE_INVAL_REC_SIZE(rec);
+		}
+	}
+	up_read(&fc->killsb);
+ out:
+	kvfree(buf);
+	return err;
+
+ err:
+	kvfree(buf);
+	fuse_copy_finish(cs);
+	return err;
+}
+
 static int fuse_notify_delete(struct fuse_conn *fc, unsigned int size,
 			      struct fuse_copy_state *cs)
 {
@@ -1878,6 +2038,9 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 	case FUSE_NOTIFY_DELETE:
 		return fuse_notify_delete(fc, size, cs);
 
+	case FUSE_NOTIFY_INVAL_BATCH:
+		return fuse_notify_inval_batch(fc, size, cs);
+
 	default:
 		fuse_copy_finish(cs);
 		return -EINVAL;
@@ -1982,7 +2145,7 @@ static ssize_t fuse_dev_do_write(struct fuse_dev *fud,
 		if (oh.error == -ENOSYS)
 			fc->no_interrupt = 1;
 		else if (oh.error == -EAGAIN)
-			queue_interrupt(&fc->iq, req);
+			queue_interrupt(fc, req);
 		fuse_put_request(fc, req);
 
 		fuse_copy_finish(cs);
@@ -2140,7 +2303,7 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 	if (!fud)
 		return POLLERR;
 
-	fiq = &fud->fc->iq;
+	fiq = fud->fiq;
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->waitq.lock);
@@ -2203,12 +2366,27 @@ static void end_polls(struct fuse_conn *fc)
  * is OK, the request will in that case be removed from the list before we touch
  * it.
  */
-void fuse_abort_conn(struct fuse_conn *fc)
+static void fuse_abort_iqueue(struct fuse_iqueue *fiq, struct list_head *to_end)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&fiq->waitq.lock);
+	fiq->connected = 0;
+	list_for_each_entry(req, &fiq->pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&fiq->pending, to_end);
+	while (forget_pending(fiq))
+		kfree(dequeue_forget(fiq, 1, NULL));
+	wake_up_all_locked(&fiq->waitq);
+	spin_unlock(&fiq->waitq.lock);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+}
 
+void fuse_abort_conn(struct fuse_conn *fc)
+{
 	spin_lock(&fc->lock);
 	if (fc->connected) {
+		struct fuse_iqueue *fiq;
 		struct fuse_dev *fud;
 		struct fuse_req *req, *next;
 		LIST_HEAD(to_end1);
@@ -2239,16 +2417,13 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		fc->max_background = UINT_MAX;
 		flush_bg_queue(fc);
 
-		spin_lock(&fiq->waitq.lock);
-		fiq->connected = 0;
-		list_splice_init(&fiq->pending, &to_end2);
-		list_for_each_entry(req, &to_end2, list)
-			clear_bit(FR_PENDING, &req->flags);
-		while (forget_pending(fiq))
-			kfree(dequeue_forget(fiq, 1, NULL));
-		wake_up_all_locked(&fiq->waitq);
-		spin_unlock(&fiq->waitq.lock);
-		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+		/*
+		 * Per-CPU queues go first: once they are disconnected no
+		 * request can be handed over to the default queue anymore.
+		 */
+		list_for_each_entry(fiq, &fc->mq_list, mq_entry)
+			fuse_abort_iqueue(fiq, &to_end2);
+		fuse_abort_iqueue(&fc->iq, &to_end2);
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
@@ -2272,6 +2447,34 @@ void fuse_wait_aborted(struct fuse_conn *fc)
 	wait_event(fc->blocked_waitq, atomic_read(&fc->num_waiting) == 0);
 }
 
+/*
+ * Stop reading a per-CPU queue.  When its last reader goes away, requests
+ * still pending there would never be read, so hand them over to the
+ * default queue.
+ */
+static void fuse_dev_unbind(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue *fiq = fud->fiq;
+	struct fuse_req *req;
+
+	if (fiq == &fc->iq)
+		return;
+
+	spin_lock(&fiq->waitq.lock);
+	if (!--fiq->nr_readers && !list_empty(&fiq->pending)) {
+		spin_lock_nested(&fc->iq.waitq.lock, SINGLE_DEPTH_NESTING);
+		list_for_each_entry(req, &fiq->pending, list)
+			req->fiq = &fc->iq;
+		list_splice_tail_init(&fiq->pending, &fc->iq.pending);
+		wake_up_all_locked(&fc->iq.waitq);
+		spin_unlock(&fc->iq.waitq.lock);
+		kill_fasync(&fc->iq.fasync, SIGIO, POLL_IN);
+	}
+	spin_unlock(&fiq->waitq.lock);
+	fud->fiq = &fc->iq;
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2281,6 +2484,8 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		struct fuse_pqueue *fpq = &fud->pq;
 		LIST_HEAD(to_end);
 
+		fuse_dev_unbind(fud);
+
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
 		list_splice_init(&fpq->processing, &to_end);
@@ -2307,7 +2512,7 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fud->fc->iq.fasync);
+	return fasync_helper(fd, file, on, &fud->fiq->fasync);
 }
 
 static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
@@ -2327,6 +2532,69 @@ static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
 	return 0;
 }
 
+/*
+ * Make @fud read requests submitted on @cpu from a queue of its own.  A
+ * device already bound to a CPU may be bound to further CPUs, which then
+ * share its queue (e.g. one queue per cluster).
+ */
+static int fuse_device_bind_cpu(struct fuse_dev *fud, unsigned int cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue **mq, *fiq, *new_fiq;
+	int err = 0;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	mq = kcalloc(nr_cpu_ids, sizeof(*mq), GFP_KERNEL);
+	new_fiq = kmalloc(sizeof(*new_fiq), GFP_KERNEL);
+	if (!mq || !new_fiq) {
+		err = -ENOMEM;
+		goto out;
+	}
+	fuse_iqueue_init(new_fiq);
+	new_fiq->index = cpu + 1;
+
+	spin_lock(&fc->lock);
+	err = -ENOTCONN;
+	if (!fc->connected)
+		goto out_unlock;
+
+	if (!fc->mq) {
+		smp_store_release(&fc->mq, mq);
+		mq = NULL;
+	}
+
+	err = 0;
+	fiq = fc->mq[cpu];
+	if (fud->fiq != &fc->iq) {
+		if (!fiq)
+			smp_store_release(&fc->mq[cpu], fud->fiq);
+		else if (fiq != fud->fiq)
+			err = -EBUSY;
+		goto out_unlock;
+	}
+
+	if (!fiq) {
+		fiq = new_fiq;
+		new_fiq = NULL;
+		list_add_tail(&fiq->mq_entry, &fc->mq_list);
+		smp_store_release(&fc->mq[cpu], fiq);
+	}
+
+	spin_lock(&fiq->waitq.lock);
+	fiq->nr_readers++;
+	spin_unlock(&fiq->waitq.lock);
+	fud->fiq = fiq;
+
+ out_unlock:
+	spin_unlock(&fc->lock);
+ out:
+	kfree(new_fiq);
+	kfree(mq);
+	return err;
+}
+
 static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			   unsigned long arg)
 {
@@ -2359,6 +2627,17 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_BIND_CPU) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		u32 cpu;
+
+		err = -EINVAL;
+		if (!fud)
+			return err;
+
+		err = -EFAULT;
+		if (!get_user(cpu, (__u32 __user *) arg))
+			err = fuse_device_bind_cpu(fud, cpu);
 	}
 	return err;
 }
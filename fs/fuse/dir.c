@@ -89,8 +89,8 @@ static u64 time_to_jiffies(unsigned long sec, unsigned long nsec)
 static void fuse_change_entry_timeout(struct dentry *entry,
 				      struct fuse_entry_out *o)
 {
-	fuse_dentry_settime(entry,
-		time_to_jiffies(o->entry_valid, o->entry_valid_nsec));
+	fuse_dentry_settime(entry, fuse_passthrough_timeout(d_inode(entry),
+		time_to_jiffies(o->entry_valid, o->entry_valid_nsec)));
 }
 
 static u64 attr_timeout(struct fuse_attr_out *o)
@@ -505,6 +505,8 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 		goto out_err;
 	}
 	kfree(forget);
+	if (ff->passthrough_filp)
+		set_bit(FUSE_I_PASSTHROUGH, &get_fuse_inode(inode)->state);
 	d_instantiate(entry, inode);
 	fuse_change_entry_timeout(entry, &outentry);
 	fuse_invalidate_attr(dir);
@@ -120,6 +120,8 @@ enum {
 	FUSE_I_INIT_RDPLUS,
 	/** An operation changing file size is in progress  */
 	FUSE_I_SIZE_UNSTABLE,
+	/** Opened with a passthrough file, attributes follow the lower inode */
+	FUSE_I_PASSTHROUGH,
 };
 
 struct fuse_conn;
@@ -397,6 +399,9 @@ struct fuse_req {
 
 	/** fuse passthrough file  */
 	struct file *passthrough_filp;
+
+	/** Input queue the request was put on */
+	struct fuse_iqueue *fiq;
 };
 
 struct fuse_iqueue {
@@ -424,6 +429,15 @@ struct fuse_iqueue {
 
 	/** O_ASYNC requests */
 	struct fasync_struct *fasync;
+
+	/** Queue number, zero for the connection's default queue */
+	unsigned index;
+
+	/** Number of devices reading this queue (per-CPU queues only) */
+	unsigned nr_readers;
+
+	/** Entry on fc->mq_list (per-CPU queues only) */
+	struct list_head mq_entry;
 };
 
 struct fuse_pqueue {
@@ -450,6 +464,9 @@ struct fuse_dev {
 	/** Processing queue */
 	struct fuse_pqueue pq;
 
+	/** Input queue this device reads from */
+	struct fuse_iqueue *fiq;
+
 	/** list entry on fc->devices */
 	struct list_head entry;
 };
@@ -491,6 +508,12 @@ struct fuse_conn {
 	/** Input queue */
 	struct fuse_iqueue iq;
 
+	/** Per-CPU input queues, indexed by CPU, NULL until a device binds */
+	struct fuse_iqueue **mq;
+
+	/** List of allocated per-CPU input queues */
+	struct list_head mq_list;
+
 	/** The next unique kernel file handle */
 	u64 khctr;
 
@@ -786,6 +809,11 @@ void fuse_init_symlink(struct inode *inode);
 void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 			    u64 attr_valid, u64 attr_version);
 
+/**
+ * Extend a dentry or attribute timeout for passthrough-backed inodes
+ */
+u64 fuse_passthrough_timeout(struct inode *inode, u64 timeout);
+
 void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 				   u64 attr_valid);
 
@@ -880,6 +908,12 @@ struct fuse_conn *fuse_conn_get(struct fuse_conn *fc);
  */
 void fuse_conn_init(struct fuse_conn *fc);
 
+/**
+ * Initialize and free input queues
+ */
+void fuse_iqueue_init(struct fuse_iqueue *fiq);
+void fuse_iqueue_free_mq(struct fuse_conn *fc);
+
 /**
  * Release reference to fuse_conn
  */
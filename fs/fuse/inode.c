@@ -47,6 +47,12 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
+static unsigned passthrough_cache_timeout = 30;
+module_param(passthrough_cache_timeout, uint, 0644);
+MODULE_PARM_DESC(passthrough_cache_timeout,
+ "Minimum attribute and dentry cache timeout in seconds for inodes "
+ "opened with passthrough, 0 to always use the daemon's timeouts");
+
 #define FUSE_SUPER_MAGIC 0x65735546
 
 #define FUSE_DEFAULT_BLKSIZE 512
@@ -154,6 +160,24 @@ static ino_t fuse_squash_ino(u64 ino64)
 	return ino;
 }
 
+/*
+ * Reads and writes on passthrough files update size and times from the
+ * lower inode, so their cached attributes only go stale when the daemon
+ * changes them, and it can tell us with a (batched) invalidation.
+ */
+u64 fuse_passthrough_timeout(struct inode *inode, u64 timeout)
+{
+	u64 min_timeout;
+
+	if (!inode || !passthrough_cache_timeout ||
+	    !test_bit(FUSE_I_PASSTHROUGH, &get_fuse_inode(inode)->state))
+		return timeout;
+
+	min_timeout = get_jiffies_64() +
+		(u64)passthrough_cache_timeout * HZ;
+	return max(timeout, min_timeout);
+}
+
 void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 				   u64 attr_valid)
 {
@@ -161,7 +185,7 @@ void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 	struct fuse_inode *fi = get_fuse_inode(inode);
 
 	fi->attr_version = ++fc->attr_version;
-	fi->i_time = attr_valid;
+	fi->i_time = fuse_passthrough_timeout(inode, attr_valid);
 
 	inode->i_ino     = fuse_squash_ino(attr->ino);
 	inode->i_mode    = (inode->i_mode & S_IFMT) | (attr->mode & 07777);
@@ -570,16 +594,27 @@ static int fuse_show_options(struct seq_file *m, struct dentry *root)
 	return 0;
 }
 
-static void fuse_iqueue_init(struct fuse_iqueue *fiq)
+void fuse_iqueue_init(struct fuse_iqueue *fiq)
 {
 	memset(fiq, 0, sizeof(struct fuse_iqueue));
 	init_waitqueue_head(&fiq->waitq);
 	INIT_LIST_HEAD(&fiq->pending);
 	INIT_LIST_HEAD(&fiq->interrupts);
+	INIT_LIST_HEAD(&fiq->mq_entry);
 	fiq->forget_list_tail = &fiq->forget_list_head;
 	fiq->connected = 1;
 }
 
+void fuse_iqueue_free_mq(struct fuse_conn *fc)
+{
+	struct fuse_iqueue *fiq, *next;
+
+	list_for_each_entry_safe(fiq, next, &fc->mq_list, mq_entry)
+		kfree(fiq);
+	kfree(fc->mq);
+	fc->mq = NULL;
+}
+
 static void fuse_pqueue_init(struct fuse_pqueue *fpq)
 {
 	memset(fpq, 0, sizeof(struct fuse_pqueue));
@@ -602,6 +637,7 @@ void fuse_conn_init(struct fuse_conn *fc)
 	INIT_LIST_HEAD(&fc->bg_queue);
 	INIT_LIST_HEAD(&fc->entry);
 	INIT_LIST_HEAD(&fc->devices);
+	INIT_LIST_HEAD(&fc->mq_list);
 	atomic_set(&fc->num_waiting, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
@@ -620,6 +656,7 @@ void fuse_conn_put(struct fuse_conn *fc)
 	if (atomic_dec_and_test(&fc->count)) {
 		if (fc->destroy_req)
 			fuse_request_free(fc->destroy_req);
+		fuse_iqueue_free_mq(fc);
 		fc->release(fc);
 	}
 }
@@ -1010,6 +1047,7 @@ struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
 	fud = kzalloc(sizeof(struct fuse_dev), GFP_KERNEL);
 	if (fud) {
 		fud->fc = fuse_conn_get(fc);
+		fud->fiq = &fc->iq;
 		fuse_pqueue_init(&fud->pq);
 
 		spin_lock(&fc->lock);
@@ -16,6 +16,7 @@
 
 #include <linux/aio.h>
 #include <linux/fs_stack.h>
+#include <linux/splice.h>
 
 void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
 {
@@ -121,6 +122,98 @@ ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	return fuse_passthrough_read_write_iter(iocb, from, 1);
 }
 
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	ssize_t ret_val;
+	struct fuse_file *ff = in->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+
+	/* lock passthrough file to prevent it from being released */
+	get_file(passthrough_filp);
+
+	if (passthrough_filp->f_op->splice_read)
+		ret_val = passthrough_filp->f_op->splice_read(passthrough_filp,
+						ppos, pipe, len, flags);
+	else
+		ret_val = default_file_splice_read(passthrough_filp, ppos,
+						   pipe, len, flags);
+	if (ret_val >= 0)
+		fsstack_copy_attr_atime(file_inode(in),
+					file_inode(passthrough_filp));
+
+	/* unlock passthrough file */
+	fput(passthrough_filp);
+
+	return ret_val;
+}
+
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	ssize_t ret_val;
+	struct fuse_file *ff = out->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	struct inode *fuse_inode = file_inode(out);
+	struct inode *passthrough_inode = file_inode(passthrough_filp);
+
+	/* lock passthrough file to prevent it from being released */
+	get_file(passthrough_filp);
+
+	file_start_write(passthrough_filp);
+	if (passthrough_filp->f_op->splice_write)
+		ret_val = passthrough_filp->f_op->splice_write(pipe,
+				passthrough_filp, ppos, len, flags);
+	else
+		ret_val = iter_file_splice_write(pipe, passthrough_filp, ppos,
+						 len, flags);
+	file_end_write(passthrough_filp);
+
+	if (ret_val > 0) {
+		spin_lock(&ff->fc->lock);
+		fsstack_copy_inode_size(fuse_inode, passthrough_inode);
+		spin_unlock(&ff->fc->lock);
+		fsstack_copy_attr_times(fuse_inode, passthrough_inode);
+	}
+
+	/* unlock passthrough file */
+	fput(passthrough_filp);
+
+	return ret_val;
+}
+
+/*
+ * Map the lower file directly: the vma then references the passthrough
+ * file, so page faults are served from the lower address space and stay
+ * coherent with passthrough reads and writes.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret_val;
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+
+	if (!passthrough_filp->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma->vm_file = get_file(passthrough_filp);
+	ret_val = passthrough_filp->f_op->mmap(passthrough_filp, vma);
+	/* mmap_region() drops the reference it took on the fuse file */
+	if (ret_val)
+		fput(passthrough_filp);
+	else
+		fput(file);
+
+	file_accessed(file);
+
+	return ret_val;
+}
+
 void fuse_passthrough_release(struct fuse_file *ff)
 {
 	if (!(ff->passthrough_filp))
@@ -99,6 +99,8 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 	struct file *new_file;
 	loff_t old_pos = 0;
 	loff_t new_pos = 0;
+	loff_t data_pos = -1;
+	bool skip_hole = false;
 	int error = 0;
 
 	if (len == 0)
@@ -114,7 +116,10 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 		goto out_fput;
 	}
 
-	/* FIXME: copy up sparse files efficiently */
+	/* Holes are only skipped if the lower fs can tell where they are */
+	if ((old_file->f_mode & FMODE_LSEEK) && old_file->f_op->llseek)
+		skip_hole = true;
+
 	while (len) {
 		size_t this_len = OVL_COPY_UP_CHUNK_SIZE;
 		long bytes;
@@ -127,6 +132,26 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 			break;
 		}
 
+		/*
+		 * Copying the zeroes of a hole costs both time and space on
+		 * the upper fs. Once past the last data found, ask the lower
+		 * fs for the next data and jump over the hole in between.
+		 * The upper file is extended to the full size afterwards.
+		 */
+		if (skip_hole && data_pos < old_pos) {
+			data_pos = vfs_llseek(old_file, old_pos, SEEK_DATA);
+			if (data_pos > old_pos) {
+				len -= min_t(loff_t, len, data_pos - old_pos);
+				old_pos = new_pos = data_pos;
+				continue;
+			} else if (data_pos == -ENXIO) {
+				/* a hole up to the end */
+				break;
+			} else if (data_pos < 0) {
+				skip_hole = false;
+			}
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
@@ -193,6 +218,20 @@ static int ovl_set_timestamps(struct dentry *upperdentry, struct kstat *stat)
 	return notify_change(upperdentry, &attr, NULL);
 }
 
+/* the size of a copy that skipped a trailing hole */
+static int ovl_set_size(struct dentry *upperdentry, struct kstat *stat)
+{
+	struct iattr attr = {
+		.ia_valid = ATTR_SIZE,
+		.ia_size = stat->size,
+	};
+
+	if (i_size_read(upperdentry->d_inode) == stat->size)
+		return 0;
+
+	return notify_change(upperdentry, &attr, NULL);
+}
+
 int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 {
 	int err = 0;
@@ -263,7 +302,10 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 		goto out_cleanup;
 
 	mutex_lock(&newdentry->d_inode->i_mutex);
-	err = ovl_set_attr(newdentry, stat);
+	if (S_ISREG(stat->mode))
+		err = ovl_set_size(newdentry, stat);
+	if (!err)
+		err = ovl_set_attr(newdentry, stat);
 	mutex_unlock(&newdentry->d_inode->i_mutex);
 	if (err)
 		goto out_cleanup;
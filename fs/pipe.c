@@ -59,6 +59,17 @@ unsigned int pipe_min_size = PAGE_SIZE;
 unsigned long pipe_user_pages_hard;
 unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/*
+ * Let splice double the size of a pipe it finds full PIPE_AUTOSIZE_FULLS
+ * times within PIPE_AUTOSIZE_WINDOW, that is of a pipe streaming a few
+ * MB/s, up to pipe_max_size.
+ */
+static bool pipe_autosize_enabled = true;
+core_param(pipe_autosize, pipe_autosize_enabled, bool, 0644);
+
+#define PIPE_AUTOSIZE_FULLS	4
+#define PIPE_AUTOSIZE_WINDOW	(HZ / 10)
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -1064,6 +1075,32 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	return nr_pages * PAGE_SIZE;
 }
 
+/*
+ * Called with the pipe locked by a splice producer that found it full.
+ * Returns true if the pipe was grown and has room again.
+ */
+bool pipe_autosize(struct pipe_inode_info *pipe)
+{
+	unsigned long nr_pages = pipe->buffers * 2;
+
+	if (!pipe_autosize_enabled || pipe->sized)
+		return false;
+
+	if (time_after(jiffies, pipe->full_stamp + PIPE_AUTOSIZE_WINDOW)) {
+		pipe->full_stamp = jiffies;
+		pipe->full_count = 0;
+	}
+	if (++pipe->full_count < PIPE_AUTOSIZE_FULLS)
+		return false;
+	pipe->full_count = 0;
+
+	if ((nr_pages << PAGE_SHIFT) > pipe_max_size ||
+	    too_many_pipe_buffers_soft(pipe->user))
+		return false;
+
+	return pipe_set_size(pipe, nr_pages) > 0;
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages. Returns 0 on error.
@@ -1146,6 +1183,8 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto out;
 		}
 		ret = pipe_set_size(pipe, nr_pages);
+		if (ret > 0)
+			pipe->sized = true;
 		break;
 		}
 	case F_GETPIPE_SZ:
@@ -315,4 +315,7 @@ extern unsigned long task_vsize(struct mm_struct *);
 extern unsigned long task_statm(struct mm_struct *,
 				unsigned long *, unsigned long *,
 				unsigned long *, unsigned long *);
+extern int proc_pid_smaps_rollup_cached(struct seq_file *,
+					struct pid_namespace *, struct pid *,
+					struct task_struct *);
 extern void task_mem(struct seq_file *, struct mm_struct *);
@@ -743,6 +743,15 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 	if (!rollup_mode) {
 		show_map_vma(m, vma, is_pid);
 	} else if (last_vma) {
+		struct mm_struct *mm = vma->vm_mm;
+
+		WRITE_ONCE(mm->smaps_rss_kb, mss->resident >> 10);
+		WRITE_ONCE(mm->smaps_pss_kb,
+			   (unsigned long)(mss->pss >> (10 + PSS_SHIFT)));
+		WRITE_ONCE(mm->smaps_swap_pss_kb,
+			   (unsigned long)(mss->swap_pss >> (10 + PSS_SHIFT)));
+		WRITE_ONCE(mm->smaps_walk_jiffies, jiffies);
+
 		show_vma_header_prefix(
 			m, mss->first_vma_start, vma->vm_end, 0, 0, 0, 0);
 		seq_pad(m, ' ');
@@ -853,6 +862,62 @@ static int pid_smaps_rollup_open(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/*
+ * Cheap variant of smaps_rollup for periodic collectors: RSS, anonymous
+ * and swap come from the counters the fault and unmap paths keep in the
+ * mm, and PSS, which depends on the other mappers of each page, is the
+ * one of the last precise walk scaled by how RSS has changed since.
+ * Neither mmap_sem nor the page tables are touched.
+ */
+int proc_pid_smaps_rollup_cached(struct seq_file *m, struct pid_namespace *ns,
+				 struct pid *pid, struct task_struct *task)
+{
+	unsigned long anon, file, swap, rss, locked;
+	unsigned long rss_kb, walk_rss, pss, swap_pss, walked;
+	struct mm_struct *mm;
+
+	mm = mm_access(task, PTRACE_MODE_READ_FSCREDS);
+	if (IS_ERR_OR_NULL(mm))
+		return mm ? PTR_ERR(mm) : 0;
+
+	anon = get_mm_counter(mm, MM_ANONPAGES);
+	file = get_mm_counter(mm, MM_FILEPAGES);
+	swap = get_mm_counter(mm, MM_SWAPENTS);
+	locked = READ_ONCE(mm->locked_vm);
+	walk_rss = READ_ONCE(mm->smaps_rss_kb);
+	pss = READ_ONCE(mm->smaps_pss_kb);
+	swap_pss = READ_ONCE(mm->smaps_swap_pss_kb);
+	walked = READ_ONCE(mm->smaps_walk_jiffies);
+	mmput(mm);
+
+	rss = anon + file;
+	rss_kb = rss << (PAGE_SHIFT - 10);
+	if (walk_rss) {
+		pss = min_t(u64, div64_u64((u64)pss * rss_kb, walk_rss), rss_kb);
+		swap_pss = min(swap_pss, swap << (PAGE_SHIFT - 10));
+	} else {
+		/* never walked, assume nothing is shared */
+		pss = rss_kb;
+		swap_pss = swap << (PAGE_SHIFT - 10);
+	}
+
+	seq_printf(m,
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "Swap:           %8lu kB\n"
+		   "SwapPss:        %8lu kB\n"
+		   "Locked:         %8lu kB\n"
+		   "PssAge:         %8u ms\n",
+		   rss_kb, pss,
+		   anon << (PAGE_SHIFT - 10),
+		   swap << (PAGE_SHIFT - 10),
+		   swap_pss,
+		   locked << (PAGE_SHIFT - 10),
+		   walk_rss ? jiffies_to_msecs(jiffies - walked) : 0);
+	return 0;
+}
+
 static int tid_smaps_open(struct inode *inode, struct file *file)
 {
 	return do_maps_open(inode, file, &proc_tid_smaps_op);
@@ -77,6 +77,11 @@ module_param(dump_oops, int, 0600);
 MODULE_PARM_DESC(dump_oops,
 		"set to 1 to dump oopses, 0 to only dump panics (default 1)");
 
+static bool ramoops_ftrace_per_cpu;
+module_param_named(ftrace_per_cpu, ramoops_ftrace_per_cpu, bool, 0400);
+MODULE_PARM_DESC(ftrace_per_cpu,
+		"split the ftrace log into lockless per-CPU zones (default 0)");
+
 static int ramoops_ecc;
 module_param_named(ecc, ramoops_ecc, int, 0600);
 MODULE_PARM_DESC(ramoops_ecc,
@@ -87,7 +92,7 @@ MODULE_PARM_DESC(ramoops_ecc,
 struct ramoops_context {
 	struct persistent_ram_zone **przs;
 	struct persistent_ram_zone *cprz;
-	struct persistent_ram_zone *fprz;
+	struct persistent_ram_zone **fprzs;
 	struct persistent_ram_zone *mprz;
 	phys_addr_t phys_addr;
 	unsigned long size;
@@ -97,8 +102,10 @@ struct ramoops_context {
 	size_t ftrace_size;
 	size_t pmsg_size;
 	int dump_oops;
+	u32 flags;
 	struct persistent_ram_ecc_info ecc_info;
 	unsigned int max_dump_cnt;
+	unsigned int max_ftrace_cnt;
 	unsigned int dump_write_cnt;
 	/* _read_cnt need clear on ramoops_pstore_open */
 	unsigned int dump_read_cnt;
@@ -219,9 +226,10 @@ static ssize_t ramoops_pstore_read(u64 *id, enum pstore_type_id *type,
 	if (!prz_ok(prz))
 		prz = ramoops_get_next_prz(&cxt->cprz, &cxt->console_read_cnt,
 					   1, id, type, PSTORE_TYPE_CONSOLE, 0);
-	if (!prz_ok(prz))
-		prz = ramoops_get_next_prz(&cxt->fprz, &cxt->ftrace_read_cnt,
-					   1, id, type, PSTORE_TYPE_FTRACE, 0);
+	while (cxt->ftrace_read_cnt < cxt->max_ftrace_cnt && !prz_ok(prz))
+		prz = ramoops_get_next_prz(cxt->fprzs, &cxt->ftrace_read_cnt,
+					   cxt->max_ftrace_cnt, id, type,
+					   PSTORE_TYPE_FTRACE, 0);
 	if (!prz_ok(prz))
 		prz = ramoops_get_next_prz(&cxt->mprz, &cxt->pmsg_read_cnt,
 					   1, id, type, PSTORE_TYPE_PMSG, 0);
@@ -283,9 +291,14 @@ static int notrace ramoops_pstore_write_buf(enum pstore_type_id type,
 		persistent_ram_write(cxt->cprz, buf, size);
 		return 0;
 	} else if (type == PSTORE_TYPE_FTRACE) {
-		if (!cxt->fprz)
+		int zonenum = 0;
+
+		if (!cxt->fprzs)
 			return -ENOMEM;
-		persistent_ram_write(cxt->fprz, buf, size);
+		/* the tracer calls us with interrupts off */
+		if (cxt->flags & RAMOOPS_FLAG_FTRACE_PER_CPU)
+			zonenum = smp_processor_id();
+		persistent_ram_write(cxt->fprzs[zonenum], buf, size);
 		return 0;
 	} else if (type == PSTORE_TYPE_PMSG) {
 		if (!cxt->mprz)
@@ -376,7 +389,9 @@ static int ramoops_pstore_erase(enum pstore_type_id type, u64 id, int count,
 		prz = cxt->cprz;
 		break;
 	case PSTORE_TYPE_FTRACE:
-		prz = cxt->fprz;
+		if (id >= cxt->max_ftrace_cnt)
+			return -EINVAL;
+		prz = cxt->fprzs[id];
 		break;
 	case PSTORE_TYPE_PMSG:
 		prz = cxt->mprz;
@@ -470,7 +485,8 @@ fail_mem:
 
 static int ramoops_init_prz(struct device *dev, struct ramoops_context *cxt,
 			    struct persistent_ram_zone **prz,
-			    phys_addr_t *paddr, size_t sz, u32 sig)
+			    phys_addr_t *paddr, size_t sz, u32 sig,
+			    u32 flags)
 {
 	if (!sz)
 		return 0;
@@ -483,7 +499,7 @@ static int ramoops_init_prz(struct device *dev, struct ramoops_context *cxt,
 	}
 
 	*prz = persistent_ram_new(*paddr, sz, sig, &cxt->ecc_info,
-				  cxt->memtype, 0);
+				  cxt->memtype, flags);
 	if (IS_ERR(*prz)) {
 		int err = PTR_ERR(*prz);
 
@@ -499,6 +515,71 @@ static int ramoops_init_prz(struct device *dev, struct ramoops_context *cxt,
 	return 0;
 }
 
+static void ramoops_free_ftrace_przs(struct ramoops_context *cxt)
+{
+	int i;
+
+	if (!cxt->fprzs)
+		return;
+
+	for (i = 0; i < cxt->max_ftrace_cnt; i++)
+		persistent_ram_free(cxt->fprzs[i]);
+
+	kfree(cxt->fprzs);
+	cxt->fprzs = NULL;
+	cxt->max_ftrace_cnt = 0;
+}
+
+/*
+ * A single ftrace zone is shared by all CPUs and locked. In per-CPU mode
+ * every possible CPU gets an equal, lockless share of the area instead:
+ * records are only ever written by the CPU they belong to, with
+ * interrupts disabled.
+ */
+static int ramoops_init_ftrace_przs(struct device *dev,
+				    struct ramoops_context *cxt,
+				    phys_addr_t *paddr)
+{
+	size_t zone_sz = cxt->ftrace_size;
+	unsigned int cnt = 1;
+	u32 flags = 0;
+	int err;
+	int i;
+
+	if (!cxt->ftrace_size)
+		return 0;
+
+	if (cxt->flags & RAMOOPS_FLAG_FTRACE_PER_CPU) {
+		cnt = nr_cpu_ids;
+		zone_sz = cxt->ftrace_size / cnt;
+		flags = PRZ_FLAG_NO_LOCK;
+		if (zone_sz < MIN_MEM_SIZE) {
+			dev_err(dev, "ftrace size 0x%zx too small for %u CPUs\n",
+				cxt->ftrace_size, cnt);
+			return -ENOMEM;
+		}
+	}
+
+	cxt->fprzs = kcalloc(cnt, sizeof(*cxt->fprzs), GFP_KERNEL);
+	if (!cxt->fprzs)
+		return -ENOMEM;
+	cxt->max_ftrace_cnt = cnt;
+
+	for (i = 0; i < cnt; i++) {
+		err = ramoops_init_prz(dev, cxt, &cxt->fprzs[i], paddr,
+				       zone_sz, LINUX_VERSION_CODE, flags);
+		if (err) {
+			ramoops_free_ftrace_przs(cxt);
+			return err;
+		}
+	}
+
+	/* keep the other zones where they were */
+	*paddr += cxt->ftrace_size - zone_sz * cnt;
+
+	return 0;
+}
+
 void notrace ramoops_console_write_buf(const char *buf, size_t size)
 {
 	struct ramoops_context *cxt = &oops_cxt;
@@ -559,6 +640,8 @@ static int ramoops_parse_dt(struct platform_device *pdev,
 	pdata->mem_address = res.start;
 	pdata->mem_type = of_property_read_bool(of_node, "unbuffered");
 	pdata->dump_oops = !of_property_read_bool(of_node, "no-dump-oops");
+	if (of_property_read_bool(of_node, "ftrace-per-cpu"))
+		pdata->flags |= RAMOOPS_FLAG_FTRACE_PER_CPU;
 
 	ret = ramoops_parse_dt_size(pdev, "record-size", &pdata->record_size);
 	if (ret < 0)
@@ -641,6 +724,7 @@ static int ramoops_probe(struct platform_device *pdev)
 	cxt->ftrace_size = pdata->ftrace_size;
 	cxt->pmsg_size = pdata->pmsg_size;
 	cxt->dump_oops = pdata->dump_oops;
+	cxt->flags = pdata->flags;
 	cxt->ecc_info = pdata->ecc_info;
 
 	paddr = cxt->phys_addr;
@@ -652,16 +736,16 @@ static int ramoops_probe(struct platform_device *pdev)
 		goto fail_out;
 
 	err = ramoops_init_prz(dev, cxt, &cxt->cprz, &paddr,
-			       cxt->console_size, 0);
+			       cxt->console_size, 0, 0);
 	if (err)
 		goto fail_init_cprz;
 
-	err = ramoops_init_prz(dev, cxt, &cxt->fprz, &paddr, cxt->ftrace_size,
-			       LINUX_VERSION_CODE);
+	err = ramoops_init_ftrace_przs(dev, cxt, &paddr);
 	if (err)
 		goto fail_init_fprz;
 
-	err = ramoops_init_prz(dev, cxt, &cxt->mprz, &paddr, cxt->pmsg_size, 0);
+	err = ramoops_init_prz(dev, cxt, &cxt->mprz, &paddr, cxt->pmsg_size,
+			       0, 0);
 	if (err)
 		goto fail_init_mprz;
 
@@ -700,6 +784,7 @@ static int ramoops_probe(struct platform_device *pdev)
 	ramoops_console_size = pdata->console_size;
 	ramoops_pmsg_size = pdata->pmsg_size;
 	ramoops_ftrace_size = pdata->ftrace_size;
+	ramoops_ftrace_per_cpu = !!(pdata->flags & RAMOOPS_FLAG_FTRACE_PER_CPU);
 
 	pr_info("attached 0x%lx@0x%llx, ecc: %d/%d\n",
 		cxt->size, (unsigned long long)cxt->phys_addr,
@@ -713,7 +798,7 @@ fail_clear:
 	cxt->pstore.bufsize = 0;
 	kfree(cxt->mprz);
 fail_init_mprz:
-	kfree(cxt->fprz);
+	ramoops_free_ftrace_przs(cxt);
 fail_init_fprz:
 	kfree(cxt->cprz);
 fail_init_cprz:
@@ -732,7 +817,7 @@ static int ramoops_remove(struct platform_device *pdev)
 	cxt->pstore.bufsize = 0;
 
 	persistent_ram_free(cxt->mprz);
-	persistent_ram_free(cxt->fprz);
+	ramoops_free_ftrace_przs(cxt);
 	persistent_ram_free(cxt->cprz);
 	ramoops_free_przs(cxt);
 
@@ -774,6 +859,8 @@ static void ramoops_register_dummy(void)
 	dummy_data->ftrace_size = ramoops_ftrace_size;
 	dummy_data->pmsg_size = ramoops_pmsg_size;
 	dummy_data->dump_oops = dump_oops;
+	if (ramoops_ftrace_per_cpu)
+		dummy_data->flags |= RAMOOPS_FLAG_FTRACE_PER_CPU;
 	/*
 	 * For backwards compatibility ramoops.ecc=1 means 16 bytes ECC
 	 * (using 1 byte for ECC isn't much of use anyway).
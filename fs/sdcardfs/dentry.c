@@ -115,6 +115,9 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 		iput(inode);
 	}
 
+	if (err)
+		fixup_perms_if_stale(parent_dentry, dentry);
+
 out:
 	dput(parent_dentry);
 	dput(lower_cur_parent_dentry);
@@ -149,17 +152,7 @@ static int sdcardfs_hash_ci(const struct dentry *dentry,
 	 *       Refer to vfat_hashi()
 	 * struct nls_table *t = MSDOS_SB(dentry->d_sb)->nls_io;
 	 */
-	const unsigned char *name;
-	unsigned int len;
-	unsigned long hash;
-
-	name = qstr->name;
-	len = qstr->len;
-
-	hash = init_name_hash();
-	while (len--)
-		hash = partial_name_hash(tolower(*name++), hash);
-	qstr->hash = end_name_hash(hash);
+	qstr->hash = str_case_hash(qstr->name, qstr->len);
 
 	return 0;
 }
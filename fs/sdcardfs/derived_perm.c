@@ -19,7 +19,24 @@
  */
 
 #include "sdcardfs.h"
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
 
+/*
+ * Package list changes do not rewrite permissions in place.  They bump
+ * sdcardfs_perm_gen, and package directories derived under an older
+ * generation are fixed up when they are next revalidated, or by the
+ * background walk below, whichever comes first.
+ */
+static atomic_t sdcardfs_perm_gen = ATOMIC_INIT(0);
+
+static unsigned int fixup_delay_ms = 1000;
+module_param(fixup_delay_ms, uint, 0644);
+MODULE_PARM_DESC(fixup_delay_ms,
+		 "Delay before fixing up permissions of cached package directories after a package list change, in ms (0 = only on revalidate)");
+
+static void sdcardfs_fixup_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sdcardfs_fixup_work, sdcardfs_fixup_workfn);
 /* copy derived state from parent inode */
 static void inherit_derived_state(struct inode *parent, struct inode *child)
 {
@@ -75,6 +92,8 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	 * of using the inode permissions.
 	 */
 
+	/* Sample the generation first, so a racing change leaves us stale */
+	info->data->perm_gen = atomic_read(&sdcardfs_perm_gen);
 	inherit_derived_state(d_inode(parent), d_inode(dentry));
 
 	/* Files don't get special labels */
@@ -130,8 +149,10 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	case PERM_ANDROID_DATA:
 	case PERM_ANDROID_MEDIA:
 		info->data->perm = PERM_ANDROID_PACKAGE;
-		appid = get_appid(name->name);
-		if (appid != 0 && !is_excluded(name->name, parent_data->userid))
+		/* name->hash is already case-folded, see sdcardfs_hash_ci() */
+		appid = get_appid_qstr(name);
+		if (appid != 0 &&
+		    !is_excluded_qstr(name, parent_data->userid))
 			info->data->d_uid =
 				multiuser_get_uid(parent_data->userid, appid);
 		break;
@@ -304,12 +325,17 @@ static void __fixup_perms_recursive(struct dentry *dentry, struct limit_search *
 	info = SDCARDFS_I(d_inode(dentry));
 
 	if (needs_fixup(info->data->perm)) {
+		unsigned int gen = atomic_read(&sdcardfs_perm_gen);
+
 		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
 			spin_lock_nested(&child->d_lock, depth + 1);
 			if (!(limit->flags & BY_NAME) || qstr_case_eq(&child->d_name, &limit->name)) {
-				if (d_inode(child)) {
+				if (d_inode(child) &&
+				    SDCARDFS_I(d_inode(child))->data->perm_gen != gen) {
 					get_derived_permission(dentry, child);
 					fixup_tmp_permissions(d_inode(child));
+				}
+				if (limit->flags & BY_NAME) {
 					spin_unlock(&child->d_lock);
 					break;
 				}
@@ -329,6 +355,58 @@ void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit)
 	__fixup_perms_recursive(dentry, limit, 0);
 }
 
+/* Re-derive a package directory if the package list changed since */
+void fixup_perms_if_stale(struct dentry *parent, struct dentry *dentry)
+{
+	struct inode *inode = d_inode(dentry);
+	struct inode *parent_inode = d_inode(parent);
+
+	if (!inode || !parent_inode ||
+	    !needs_fixup(SDCARDFS_I(parent_inode)->data->perm))
+		return;
+
+	if (SDCARDFS_I(inode)->data->perm_gen ==
+	    atomic_read(&sdcardfs_perm_gen))
+		return;
+
+	get_derived_permission(parent, dentry);
+	fixup_tmp_permissions(inode);
+}
+
+static void sdcardfs_fixup_workfn(struct work_struct *work)
+{
+	struct sdcardfs_sb_info *sbinfo;
+	struct limit_search limit = {
+		.flags = 0,
+	};
+
+	mutex_lock(&sdcardfs_super_list_lock);
+	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
+		if (sbinfo_has_sdcard_magic(sbinfo))
+			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
+	}
+	mutex_unlock(&sdcardfs_super_list_lock);
+}
+
+/*
+ * Called by the package list on every update.  Bursts of updates (e.g.
+ * at boot or during an install) coalesce into one background walk.
+ */
+void sdcardfs_perms_changed(void)
+{
+	unsigned int delay = READ_ONCE(fixup_delay_ms);
+
+	atomic_inc(&sdcardfs_perm_gen);
+	if (delay)
+		mod_delayed_work(system_unbound_wq, &sdcardfs_fixup_work,
+				 msecs_to_jiffies(delay));
+}
+
+void sdcardfs_perms_fixup_cancel(void)
+{
+	cancel_delayed_work_sync(&sdcardfs_fixup_work);
+}
+
 /* main function for updating derived permission */
 inline void update_derived_permission_lock(struct dentry *dentry)
 {
@@ -31,9 +31,14 @@
 
 #include <linux/configfs.h>
 
+/*
+ * Lookups only ever hold rcu_read_lock().  Updates are serialized by
+ * sdcardfs_super_list_lock and free removed entries after a grace period
+ * with call_rcu(), so neither side waits for the other.
+ */
 struct hashtable_entry {
 	struct hlist_node hlist;
-	struct hlist_node dlist; /* for deletion cleanup */
+	struct rcu_head rcu;
 	struct qstr key;
 	atomic_t value;
 };
@@ -45,20 +50,11 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
-static unsigned int full_name_case_hash(const unsigned char *name, unsigned int len)
-{
-	unsigned long hash = init_name_hash();
-
-	while (len--)
-		hash = partial_name_hash(tolower(*name++), hash);
-	return end_name_hash(hash);
-}
-
 static inline void qstr_init(struct qstr *q, const char *name)
 {
 	q->name = name;
 	q->len = strlen(q->name);
-	q->hash = full_name_case_hash(q->name, q->len);
+	q->hash = str_case_hash(q->name, q->len);
 }
 
 static inline int qstr_copy(const struct qstr *src, struct qstr *dest)
@@ -95,6 +91,12 @@ appid_t get_appid(const char *key)
 	return __get_appid(&q);
 }
 
+/* @key->hash must hold str_case_hash(), as d_name does for our dentries */
+appid_t get_appid_qstr(const struct qstr *key)
+{
+	return __get_appid(key);
+}
+
 static appid_t __get_ext_gid(const struct qstr *key)
 {
 	struct hashtable_entry *hash_cur;
@@ -145,6 +147,12 @@ appid_t is_excluded(const char *key, userid_t user)
 	return __is_excluded(&q, user);
 }
 
+/* @key->hash must hold str_case_hash(), as d_name does for our dentries */
+appid_t is_excluded_qstr(const struct qstr *key, userid_t user)
+{
+	return __is_excluded(key, user);
+}
+
 /* Kernel has already enforced everything we returned through
  * derive_permissions_locked(), so this is used to lock down access
  * even further, such as enforcing that apps hold sdcard_rw.
@@ -181,7 +189,6 @@ static struct hashtable_entry *alloc_hashtable_entry(const struct qstr *key,
 			GFP_KERNEL);
 	if (!ret)
 		return NULL;
-	INIT_HLIST_NODE(&ret->dlist);
 	INIT_HLIST_NODE(&ret->hlist);
 
 	if (!qstr_copy(key, &ret->key)) {
@@ -249,46 +256,6 @@ static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t v
 	return 0;
 }
 
-static void fixup_all_perms_name(const struct qstr *key)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME,
-		.name = QSTR_INIT(key->name, key->len),
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME | BY_USERID,
-		.name = QSTR_INIT(key->name, key->len),
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_userid(userid_t userid)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_USERID,
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
 static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 {
 	int err;
@@ -296,7 +263,7 @@ static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name(key);
+		sdcardfs_perms_changed();
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -320,48 +287,53 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name_userid(key, value);
+		sdcardfs_perms_changed();
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
 }
 
-static void free_hashtable_entry(struct hashtable_entry *entry)
+static void free_hashtable_entry_rcu(struct rcu_head *head)
 {
+	struct hashtable_entry *entry =
+		container_of(head, struct hashtable_entry, rcu);
+
 	kfree(entry->key.name);
 	kmem_cache_free(hashtable_entry_cachep, entry);
 }
 
+/* Unhash an entry; it is freed once current lookups are done with it */
+static void remove_hashtable_entry_locked(struct hashtable_entry *entry)
+{
+	hash_del_rcu(&entry->hlist);
+	call_rcu(&entry->rcu, free_hashtable_entry_rcu);
+}
+
 static void remove_packagelist_entry_locked(const struct qstr *key)
 {
 	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
+	unsigned int hash = key->hash;
 
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
-		}
+	hash_for_each_possible_safe(package_to_userid, hash_cur, h_t, hlist,
+				    hash) {
+		if (qstr_case_eq(key, &hash_cur->key))
+			remove_hashtable_entry_locked(hash_cur);
 	}
-	hash_for_each_possible_rcu(package_to_appid, hash_cur, hlist, hash) {
+	hash_for_each_possible_safe(package_to_appid, hash_cur, h_t, hlist,
+				    hash) {
 		if (qstr_case_eq(key, &hash_cur->key)) {
-			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
+			remove_hashtable_entry_locked(hash_cur);
 			break;
 		}
 	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
-		free_hashtable_entry(hash_cur);
 }
 
 static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_packagelist_entry_locked(key);
-	fixup_all_perms_name(key);
+	sdcardfs_perms_changed();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -372,9 +344,7 @@ static void remove_ext_gid_entry_locked(const struct qstr *key, gid_t group)
 
 	hash_for_each_possible_rcu(ext_to_groupid, hash_cur, hlist, hash) {
 		if (qstr_case_eq(key, &hash_cur->key) && atomic_read(&hash_cur->value) == group) {
-			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
+			remove_hashtable_entry_locked(hash_cur);
 			break;
 		}
 	}
@@ -391,18 +361,11 @@ static void remove_userid_all_entry_locked(userid_t userid)
 {
 	struct hashtable_entry *hash_cur;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
 	int i;
 
-	hash_for_each_rcu(package_to_userid, i, hash_cur, hlist) {
-		if (atomic_read(&hash_cur->value) == userid) {
-			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
-		}
-	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist) {
-		free_hashtable_entry(hash_cur);
+	hash_for_each_safe(package_to_userid, i, h_t, hash_cur, hlist) {
+		if (atomic_read(&hash_cur->value) == userid)
+			remove_hashtable_entry_locked(hash_cur);
 	}
 }
 
@@ -410,7 +373,7 @@ static void remove_userid_all_entry(userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_all_entry_locked(userid);
-	fixup_all_perms_userid(userid);
+	sdcardfs_perms_changed();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -422,9 +385,7 @@ static void remove_userid_exclude_entry_locked(const struct qstr *key, userid_t
 	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
 		if (qstr_case_eq(key, &hash_cur->key) &&
 				atomic_read(&hash_cur->value) == userid) {
-			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
+			remove_hashtable_entry_locked(hash_cur);
 			break;
 		}
 	}
@@ -434,7 +395,7 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_exclude_entry_locked(key, userid);
-	fixup_all_perms_name_userid(key, userid);
+	sdcardfs_perms_changed();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -442,22 +403,16 @@ static void packagelist_destroy(void)
 {
 	struct hashtable_entry *hash_cur;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
 	int i;
 
 	mutex_lock(&sdcardfs_super_list_lock);
-	hash_for_each_rcu(package_to_appid, i, hash_cur, hlist) {
-		hash_del_rcu(&hash_cur->hlist);
-		hlist_add_head(&hash_cur->dlist, &free_list);
-	}
-	hash_for_each_rcu(package_to_userid, i, hash_cur, hlist) {
-		hash_del_rcu(&hash_cur->hlist);
-		hlist_add_head(&hash_cur->dlist, &free_list);
-	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
-		free_hashtable_entry(hash_cur);
+	hash_for_each_safe(package_to_appid, i, h_t, hash_cur, hlist)
+		remove_hashtable_entry_locked(hash_cur);
+	hash_for_each_safe(package_to_userid, i, h_t, hash_cur, hlist)
+		remove_hashtable_entry_locked(hash_cur);
 	mutex_unlock(&sdcardfs_super_list_lock);
+	/* wait for the frees queued above before the cache goes away */
+	rcu_barrier();
 	pr_info("sdcardfs: destroyed packagelist pkgld\n");
 }
 
@@ -876,6 +831,7 @@ int packagelist_init(void)
 void packagelist_exit(void)
 {
 	configfs_sdcardfs_exit();
+	sdcardfs_perms_fixup_cancel();
 	packagelist_destroy();
 	kmem_cache_destroy(hashtable_entry_cachep);
 }
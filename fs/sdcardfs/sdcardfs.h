@@ -44,6 +44,7 @@
 #include <linux/types.h>
 #include <linux/security.h>
 #include <linux/string.h>
+#include <linux/ctype.h>
 #include <linux/list.h>
 #include "multiuser.h"
 
@@ -167,6 +168,9 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+
+	/* sdcardfs_perm_gen when the permissions were last derived */
+	unsigned int perm_gen;
 };
 
 /* sdcardfs inode data in memory */
@@ -488,8 +492,10 @@ extern struct list_head sdcardfs_super_list;
 
 /* for packagelist.c */
 extern appid_t get_appid(const char *app_name);
+extern appid_t get_appid_qstr(const struct qstr *app_name);
 extern appid_t get_ext_gid(const char *app_name);
 extern appid_t is_excluded(const char *app_name, userid_t userid);
+extern appid_t is_excluded_qstr(const struct qstr *app_name, userid_t userid);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int packagelist_init(void);
 extern void packagelist_exit(void);
@@ -508,6 +514,9 @@ extern void setup_derived_state(struct inode *inode, perm_t perm,
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, const struct qstr *name);
 extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
+extern void fixup_perms_if_stale(struct dentry *parent, struct dentry *dentry);
+extern void sdcardfs_perms_changed(void);
+extern void sdcardfs_perms_fixup_cancel(void);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
@@ -649,6 +658,21 @@ static inline bool qstr_case_eq(const struct qstr *q1, const struct qstr *q2)
 	return q1->len == q2->len && str_n_case_eq(q1->name, q2->name, q2->len);
 }
 
+/*
+ * Case-folded name hash.  This is our d_hash, so the d_name.hash of every
+ * sdcardfs dentry already holds it and the packagelist can be searched
+ * with d_name directly.
+ */
+static inline unsigned int str_case_hash(const unsigned char *name,
+					 unsigned int len)
+{
+	unsigned long hash = init_name_hash();
+
+	while (len--)
+		hash = partial_name_hash(tolower(*name++), hash);
+	return end_name_hash(hash);
+}
+
 #define QSTR_LITERAL(string) QSTR_INIT(string, sizeof(string)-1)
 
 #endif	/* not _SDCARDFS_H_ */
@@ -1126,24 +1126,16 @@ static long do_splice_to(struct file *in, loff_t *ppos,
  *    that process.
  *
  */
-ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
-			       splice_direct_actor *actor)
+static ssize_t __splice_direct_to_actor(struct file *in,
+					struct splice_desc *sd,
+					splice_direct_actor *actor)
 {
 	struct pipe_inode_info *pipe;
 	long ret, bytes;
-	umode_t i_mode;
+	bool sock_in = S_ISSOCK(file_inode(in)->i_mode);
 	size_t len;
 	int i, flags, more;
 
-	/*
-	 * We require the input being a regular file, as we don't want to
-	 * randomly drop data for eg socket -> socket splicing. Use the
-	 * piped splicing for that!
-	 */
-	i_mode = file_inode(in)->i_mode;
-	if (unlikely(!S_ISREG(i_mode) && !S_ISBLK(i_mode)))
-		return -EINVAL;
-
 	/*
 	 * neither in nor out is a pipe, setup an internal pipe attached to
 	 * 'out' and transfer the wanted data from 'in' to 'out' through that
@@ -1186,6 +1178,9 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 		if (unlikely(ret <= 0))
 			goto out_release;
 
+		if (pipe->nrbufs == pipe->buffers)
+			pipe_autosize(pipe);
+
 		read_len = ret;
 		sd->total_len = read_len;
 
@@ -1217,6 +1212,10 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 			sd->pos = prev_pos + ret;
 			goto out_release;
 		}
+
+		/* Return what the socket had rather than wait for more */
+		if (sock_in)
+			flags |= SPLICE_F_NONBLOCK;
 	}
 
 done:
@@ -1243,6 +1242,23 @@ out_release:
 
 	goto done;
 }
+
+ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
+			       splice_direct_actor *actor)
+{
+	umode_t i_mode;
+
+	/*
+	 * We require the input being a regular file, as we don't want to
+	 * randomly drop data for eg socket -> socket splicing. Use the
+	 * piped splicing for that!
+	 */
+	i_mode = file_inode(in)->i_mode;
+	if (unlikely(!S_ISREG(i_mode) && !S_ISBLK(i_mode)))
+		return -EINVAL;
+
+	return __splice_direct_to_actor(in, sd, actor);
+}
 EXPORT_SYMBOL(splice_direct_to_actor);
 
 static int direct_splice_actor(struct pipe_inode_info *pipe,
@@ -1310,6 +1326,8 @@ static int wait_for_space(struct pipe_inode_info *pipe, unsigned flags)
 		}
 		if (pipe->nrbufs != pipe->buffers)
 			return 0;
+		if (pipe_autosize(pipe))
+			return 0;
 		if (flags & SPLICE_F_NONBLOCK)
 			return -EAGAIN;
 		if (signal_pending(current))
@@ -1324,6 +1342,85 @@ static int splice_pipe_to_pipe(struct pipe_inode_info *ipipe,
 			       struct pipe_inode_info *opipe,
 			       size_t len, unsigned int flags);
 
+static int splice_get_pos(struct file *file, loff_t __user *off,
+			  fmode_t mode, loff_t *pos)
+{
+	if (!off) {
+		*pos = file->f_pos;
+		return 0;
+	}
+	if (!(file->f_mode & mode))
+		return -EINVAL;
+	if (copy_from_user(pos, off, sizeof(loff_t)))
+		return -EFAULT;
+	return 0;
+}
+
+/*
+ * Neither end is a pipe: splice between a socket and a regular file
+ * through the per-task pipe, like sendfile() does, which spares the caller
+ * its own pipe and a system call per chunk. Data taken from a socket is
+ * lost if the file cannot take it, as with any failed recv-and-write.
+ */
+static long splice_sock_file(struct file *in, loff_t __user *off_in,
+			     struct file *out, loff_t __user *off_out,
+			     size_t len, unsigned int flags)
+{
+	umode_t i_mode = file_inode(in)->i_mode;
+	umode_t o_mode = file_inode(out)->i_mode;
+	struct splice_desc sd = {
+		.len		= len,
+		.total_len	= len,
+		.flags		= flags,
+		.u.file		= out,
+	};
+	loff_t ipos, opos;
+	long ret;
+
+	if (!(S_ISSOCK(i_mode) && S_ISREG(o_mode)) &&
+	    !(S_ISREG(i_mode) && S_ISSOCK(o_mode)))
+		return -EINVAL;
+	if ((S_ISSOCK(i_mode) && off_in) || (S_ISSOCK(o_mode) && off_out))
+		return -ESPIPE;
+	if (unlikely(!(in->f_mode & FMODE_READ) ||
+		     !(out->f_mode & FMODE_WRITE)))
+		return -EBADF;
+	if (unlikely(out->f_flags & O_APPEND))
+		return -EINVAL;
+
+	ret = splice_get_pos(in, off_in, FMODE_PREAD, &ipos);
+	if (!ret)
+		ret = splice_get_pos(out, off_out, FMODE_PWRITE, &opos);
+	if (ret)
+		return ret;
+
+	ret = rw_verify_area(WRITE, out, &opos, len);
+	if (unlikely(ret < 0))
+		return ret;
+
+	sd.pos = ipos;
+	sd.opos = &opos;
+	file_start_write(out);
+	ret = __splice_direct_to_actor(in, &sd, direct_splice_actor);
+	file_end_write(out);
+	if (ret <= 0)
+		return ret;
+
+	if (S_ISREG(i_mode)) {
+		if (!off_in)
+			in->f_pos = sd.pos;
+		else if (copy_to_user(off_in, &sd.pos, sizeof(loff_t)))
+			ret = -EFAULT;
+	} else {
+		if (!off_out)
+			out->f_pos = opos;
+		else if (copy_to_user(off_out, &opos, sizeof(loff_t)))
+			ret = -EFAULT;
+	}
+
+	return ret;
+}
+
 /*
  * Determine where to splice to/from.
  */
@@ -1417,7 +1514,7 @@ static long do_splice(struct file *in, loff_t __user *off_in,
 		return ret;
 	}
 
-	return -EINVAL;
+	return splice_sock_file(in, off_in, out, off_out, len, flags);
 }
 
 static int get_iovec_page_array(struct iov_iter *from,
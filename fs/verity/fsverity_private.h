@@ -18,6 +18,7 @@
 #include <linux/fsverity.h>
 
 struct ahash_request;
+struct crypto_shash;
 
 /*
  * Implementation limit: maximum depth of the Merkle tree.  For now 8 is plenty;
@@ -31,9 +32,18 @@ struct ahash_request;
  */
 #define FS_VERITY_MAX_DIGEST_SIZE	SHA512_DIGEST_SIZE
 
+/* Maximum number of data pages hashed together by the multi-buffer path */
+#define FS_VERITY_MAX_MB_PAGES		4
+
 /* A hash algorithm supported by fs-verity */
 struct fsverity_hash_alg {
 	struct crypto_ahash *tfm; /* hash tfm, allocated on demand */
+	/*
+	 * Same implementation as 'tfm' through the shash API, if it can hash
+	 * several data pages at once; else NULL
+	 */
+	struct crypto_shash *mb_tfm;
+	unsigned int mb_max_pages;
 	const char *name;	  /* crypto API name, e.g. sha256 */
 	unsigned int digest_size; /* digest size in bytes, e.g. 32 for SHA-256 */
 	unsigned int block_size;  /* block size in bytes, e.g. 64 for SHA-256 */
@@ -121,6 +131,10 @@ const u8 *fsverity_prepare_hash_state(const struct fsverity_hash_alg *alg,
 int fsverity_hash_page(const struct merkle_tree_params *params,
 		       const struct inode *inode,
 		       struct ahash_request *req, struct page *page, u8 *out);
+int fsverity_hash_pages_mb(const struct merkle_tree_params *params,
+			   const struct inode *inode,
+			   struct page *pages[], unsigned int num_pages,
+			   u8 * const outs[]);
 int fsverity_hash_buffer(const struct fsverity_hash_alg *alg,
 			 const void *data, size_t size, u8 *out);
 void __init fsverity_check_hash_algs(void);
@@ -8,6 +8,7 @@
 #include "fsverity_private.h"
 
 #include <crypto/hash.h>
+#include <linux/highmem.h>
 #include <linux/scatterlist.h>
 
 /* The hash algorithms supported by fs-verity */
@@ -24,6 +25,27 @@ struct fsverity_hash_alg fsverity_hash_algs[] = {
 	},
 };
 
+/*
+ * If the implementation backing @tfm can also interleave several messages
+ * through the shash API, return an shash handle on it.  Using the very same
+ * implementation keeps the exported hash state (the salted initial state)
+ * interchangeable between the two handles.
+ */
+static struct crypto_shash *fsverity_alloc_mb_tfm(struct crypto_ahash *tfm)
+{
+	struct crypto_shash *mb_tfm;
+
+	mb_tfm = crypto_alloc_shash(crypto_ahash_driver_name(tfm), 0, 0);
+	if (IS_ERR(mb_tfm))
+		return NULL;
+
+	if (crypto_shash_mb_max_msgs(mb_tfm) < 2) {
+		crypto_free_shash(mb_tfm);
+		return NULL;
+	}
+	return mb_tfm;
+}
+
 /**
  * fsverity_get_hash_alg() - validate and prepare a hash algorithm
  * @inode: optional inode for logging purposes
@@ -41,6 +63,7 @@ const struct fsverity_hash_alg *fsverity_get_hash_alg(const struct inode *inode,
 {
 	struct fsverity_hash_alg *alg;
 	struct crypto_ahash *tfm;
+	struct crypto_shash *mb_tfm;
 	int err;
 
 	if (num >= ARRAY_SIZE(fsverity_hash_algs) ||
@@ -78,12 +101,26 @@ const struct fsverity_hash_alg *fsverity_get_hash_alg(const struct inode *inode,
 	if (WARN_ON(alg->block_size != crypto_ahash_blocksize(tfm)))
 		goto err_free_tfm;
 
-	pr_info("%s using implementation \"%s\"\n",
-		alg->name, crypto_ahash_driver_name(tfm));
+	mb_tfm = fsverity_alloc_mb_tfm(tfm);
+
+	pr_info("%s using implementation \"%s\"%s\n",
+		alg->name, crypto_ahash_driver_name(tfm),
+		mb_tfm ? " (multi-buffer)" : "");
 
 	/* pairs with READ_ONCE() above */
-	if (cmpxchg(&alg->tfm, NULL, tfm) != NULL)
+	if (cmpxchg(&alg->tfm, NULL, tfm) != NULL) {
+		if (mb_tfm)
+			crypto_free_shash(mb_tfm);
 		crypto_free_ahash(tfm);
+		return alg;
+	}
+
+	if (mb_tfm) {
+		alg->mb_max_pages = min(crypto_shash_mb_max_msgs(mb_tfm),
+					(unsigned int)FS_VERITY_MAX_MB_PAGES);
+		/* pairs with smp_load_acquire() in fsverity_verify_bio() */
+		smp_store_release(&alg->mb_tfm, mb_tfm);
+	}
 
 	return alg;
 
@@ -217,6 +254,59 @@ int fsverity_hash_page(const struct merkle_tree_params *params,
 	return err;
 }
 
+/**
+ * fsverity_hash_pages_mb() - hash several data pages at once
+ * @params: the Merkle tree's parameters
+ * @inode: inode for which the hashing is being done
+ * @pages: the pages to hash
+ * @num_pages: number of pages, at most the hash alg's mb_max_pages
+ * @outs: output digest for each page, size 'params->digest_size' bytes
+ *
+ * Like fsverity_hash_page(), but for several pages through the hash alg's
+ * multi-buffer shash handle, which must be set.
+ *
+ * Return: 0 on success, -errno on failure
+ */
+int fsverity_hash_pages_mb(const struct merkle_tree_params *params,
+			   const struct inode *inode,
+			   struct page *pages[], unsigned int num_pages,
+			   u8 * const outs[])
+{
+	struct crypto_shash *tfm = params->hash_alg->mb_tfm;
+	SHASH_DESC_ON_STACK(desc, tfm);
+	const u8 *data[FS_VERITY_MAX_MB_PAGES];
+	unsigned int i;
+	int err;
+
+	if (WARN_ON(params->block_size != PAGE_SIZE ||
+		    num_pages > FS_VERITY_MAX_MB_PAGES))
+		return -EINVAL;
+
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	if (params->hashstate)
+		err = crypto_shash_import(desc, params->hashstate);
+	else
+		err = crypto_shash_init(desc);
+	if (err) {
+		fsverity_err(inode, "Error %d initializing hash state", err);
+		return err;
+	}
+
+	for (i = 0; i < num_pages; i++)
+		data[i] = kmap_atomic(pages[i]);
+
+	err = crypto_shash_finup_mb(desc, data, PAGE_SIZE, outs, num_pages);
+
+	while (i--)
+		kunmap_atomic((void *)data[i]);
+
+	if (err)
+		fsverity_err(inode, "Error %d computing page hashes", err);
+	return err;
+}
+
 /**
  * fsverity_hash_buffer() - hash some data
  * @alg: the hash algorithm to use
@@ -9,10 +9,76 @@
 
 #include <crypto/hash.h>
 #include <linux/bio.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
 #include <linux/ratelimit.h>
+#include <linux/seq_file.h>
 
 static struct workqueue_struct *fsverity_read_workqueue;
 
+/* Verification counters, reported in <debugfs>/fsverity/stats */
+struct fsverity_stats {
+	unsigned long data_pages;	/* data pages verified */
+	unsigned long hpage_reads;	/* ->read_merkle_tree_page() calls */
+	unsigned long hpage_reuses;	/* hash page lookups served per-bio */
+	unsigned long hpage_checked;	/* lookups ending at a Checked page */
+	unsigned long hpage_hashed;	/* hash pages hashed and verified */
+};
+
+static DEFINE_PER_CPU(struct fsverity_stats, fsverity_stats);
+
+#define fsverity_count(field)	this_cpu_inc(fsverity_stats.field)
+
+/*
+ * Hash pages looked up while verifying one bio, one per tree level.
+ * Consecutive data pages share their hash pages (with SHA-256 and 4K blocks, a
+ * leaf hash page covers 128 data pages), so keeping a reference to the last
+ * hash page seen at each level lets the walk skip ->read_merkle_tree_page().
+ */
+struct fsverity_hpage_cache {
+	pgoff_t hindex[FS_VERITY_MAX_LEVELS];
+	struct page *hpage[FS_VERITY_MAX_LEVELS];
+};
+
+static void release_hpage_cache(struct fsverity_hpage_cache *cache)
+{
+	int level;
+
+	for (level = 0; level < FS_VERITY_MAX_LEVELS; level++) {
+		if (cache->hpage[level])
+			put_page(cache->hpage[level]);
+	}
+}
+
+/*
+ * Get a reference to the hash page @hindex at @level, from @cache if it's
+ * there.  The caller owns the returned reference either way.
+ */
+static struct page *get_hash_page(struct inode *inode,
+				  struct fsverity_hpage_cache *cache,
+				  int level, pgoff_t hindex)
+{
+	struct page *hpage;
+
+	if (cache && cache->hpage[level] && cache->hindex[level] == hindex) {
+		fsverity_count(hpage_reuses);
+		get_page(cache->hpage[level]);
+		return cache->hpage[level];
+	}
+
+	fsverity_count(hpage_reads);
+	hpage = inode->i_sb->s_vop->read_merkle_tree_page(inode, hindex);
+	if (IS_ERR(hpage) || !cache)
+		return hpage;
+
+	if (cache->hpage[level])
+		put_page(cache->hpage[level]);
+	get_page(hpage);
+	cache->hpage[level] = hpage;
+	cache->hindex[level] = hindex;
+	return hpage;
+}
+
 /**
  * hash_at_level() - compute the location of the block's hash at the given level
  *
@@ -67,7 +133,8 @@ static inline int cmp_hashes(const struct fsverity_info *vi,
 }
 
 /*
- * Verify a single data page against the file's Merkle tree.
+ * Find the expected hash of data page @index, verifying the hash pages on the
+ * way from the leaf level to the first already-verified one.
  *
  * In principle, we need to verify the entire path to the root node.  However,
  * for efficiency the filesystem may cache the hash pages.  Therefore we need
@@ -81,24 +148,22 @@ static inline int cmp_hashes(const struct fsverity_info *vi,
  * Note that multiple processes may race to verify a hash page and mark it
  * Checked, but it doesn't matter; the result will be the same either way.
  *
- * Return: true if the page is valid, else false.
+ * @cache, if not NULL, carries hash page references from one call to the next
+ * while verifying a run of data pages.
+ *
+ * Return: 0 with the expected hash in @want_hash, else -errno.
  */
-static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
-			struct ahash_request *req, struct page *data_page)
+static int verify_hash_path(struct inode *inode, const struct fsverity_info *vi,
+			    struct ahash_request *req, pgoff_t index,
+			    struct fsverity_hpage_cache *cache, u8 *want_hash)
 {
 	const struct merkle_tree_params *params = &vi->tree_params;
 	const unsigned int hsize = params->digest_size;
-	const pgoff_t index = data_page->index;
 	int level;
-	u8 _want_hash[FS_VERITY_MAX_DIGEST_SIZE];
-	const u8 *want_hash;
 	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
 	struct page *hpages[FS_VERITY_MAX_LEVELS];
 	unsigned int hoffsets[FS_VERITY_MAX_LEVELS];
-	int err;
-
-	if (WARN_ON_ONCE(!PageLocked(data_page) || PageUptodate(data_page)))
-		return false;
+	int err = 0;
 
 	pr_debug_ratelimited("Verifying data page %lu...\n", index);
 
@@ -117,8 +182,7 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		pr_debug_ratelimited("Level %d: hindex=%lu, hoffset=%u\n",
 				     level, hindex, hoffset);
 
-		hpage = inode->i_sb->s_vop->read_merkle_tree_page(inode,
-								  hindex);
+		hpage = get_hash_page(inode, cache, level, hindex);
 		if (IS_ERR(hpage)) {
 			err = PTR_ERR(hpage);
 			fsverity_err(inode,
@@ -128,8 +192,8 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		}
 
 		if (PageChecked(hpage)) {
-			extract_hash(hpage, hoffset, hsize, _want_hash);
-			want_hash = _want_hash;
+			fsverity_count(hpage_checked);
+			extract_hash(hpage, hoffset, hsize, want_hash);
 			put_page(hpage);
 			pr_debug_ratelimited("Hash page already checked, want %s:%*phN\n",
 					     params->hash_alg->name,
@@ -141,7 +205,7 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		hoffsets[level] = hoffset;
 	}
 
-	want_hash = vi->root_hash;
+	memcpy(want_hash, vi->root_hash, hsize);
 	pr_debug("Want root hash: %s:%*phN\n",
 		 params->hash_alg->name, hsize, want_hash);
 descend:
@@ -157,23 +221,47 @@ descend:
 		if (err)
 			goto out;
 		SetPageChecked(hpage);
-		extract_hash(hpage, hoffset, hsize, _want_hash);
-		want_hash = _want_hash;
+		fsverity_count(hpage_hashed);
+		extract_hash(hpage, hoffset, hsize, want_hash);
 		put_page(hpage);
 		pr_debug("Verified hash page at level %d, now want %s:%*phN\n",
 			 level - 1, params->hash_alg->name, hsize, want_hash);
 	}
-
-	/* Finally, verify the data page */
-	err = fsverity_hash_page(params, inode, req, data_page, real_hash);
-	if (err)
-		goto out;
-	err = cmp_hashes(vi, want_hash, real_hash, index, -1);
 out:
 	for (; level > 0; level--)
 		put_page(hpages[level - 1]);
 
-	return err == 0;
+	return err;
+}
+
+/*
+ * Verify a single data page against the file's Merkle tree.
+ *
+ * Return: true if the page is valid, else false.
+ */
+static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
+			struct ahash_request *req, struct page *data_page,
+			struct fsverity_hpage_cache *cache)
+{
+	const struct merkle_tree_params *params = &vi->tree_params;
+	u8 want_hash[FS_VERITY_MAX_DIGEST_SIZE];
+	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
+	int err;
+
+	if (WARN_ON_ONCE(!PageLocked(data_page) || PageUptodate(data_page)))
+		return false;
+
+	err = verify_hash_path(inode, vi, req, data_page->index, cache,
+			       want_hash);
+	if (err)
+		return false;
+
+	err = fsverity_hash_page(params, inode, req, data_page, real_hash);
+	if (err)
+		return false;
+	fsverity_count(data_pages);
+
+	return cmp_hashes(vi, want_hash, real_hash, data_page->index, -1) == 0;
 }
 
 /**
@@ -196,7 +284,7 @@ bool fsverity_verify_page(struct page *page)
 	if (unlikely(!req))
 		return false;
 
-	valid = verify_page(inode, vi, req, page);
+	valid = verify_page(inode, vi, req, page, NULL);
 
 	ahash_request_free(req);
 
@@ -205,6 +293,77 @@ bool fsverity_verify_page(struct page *page)
 EXPORT_SYMBOL_GPL(fsverity_verify_page);
 
 #ifdef CONFIG_BLOCK
+/* Hash the collected data pages together and check them against their hashes */
+static void verify_pending_pages(const struct inode *inode,
+				 const struct fsverity_info *vi,
+				 struct page *pages[], u8 * const want_hashes[],
+				 unsigned int num_pages)
+{
+	u8 real_hashes[FS_VERITY_MAX_MB_PAGES][FS_VERITY_MAX_DIGEST_SIZE];
+	u8 *outs[FS_VERITY_MAX_MB_PAGES];
+	unsigned int i;
+
+	for (i = 0; i < num_pages; i++)
+		outs[i] = real_hashes[i];
+
+	if (fsverity_hash_pages_mb(&vi->tree_params, inode, pages, num_pages,
+				   outs)) {
+		for (i = 0; i < num_pages; i++)
+			SetPageError(pages[i]);
+		return;
+	}
+
+	for (i = 0; i < num_pages; i++) {
+		fsverity_count(data_pages);
+		if (cmp_hashes(vi, want_hashes[i], outs[i], pages[i]->index, -1))
+			SetPageError(pages[i]);
+	}
+}
+
+/*
+ * Multi-buffer variant of the per-page loop in fsverity_verify_bio(): resolve
+ * the expected hash of each data page first, then hash the data pages in
+ * groups of up to mb_max_pages.
+ */
+static void verify_bio_mb(struct inode *inode, const struct fsverity_info *vi,
+			  struct ahash_request *req, struct bio *bio,
+			  struct fsverity_hpage_cache *cache)
+{
+	const unsigned int max_pages = vi->tree_params.hash_alg->mb_max_pages;
+	u8 want_hashes[FS_VERITY_MAX_MB_PAGES][FS_VERITY_MAX_DIGEST_SIZE];
+	u8 *wants[FS_VERITY_MAX_MB_PAGES];
+	struct page *pages[FS_VERITY_MAX_MB_PAGES];
+	unsigned int n = 0;
+	struct bio_vec *bv;
+	int i;
+
+	for (i = 0; i < FS_VERITY_MAX_MB_PAGES; i++)
+		wants[i] = want_hashes[i];
+
+	bio_for_each_segment_all(bv, bio, i) {
+		struct page *page = bv->bv_page;
+
+		if (PageError(page))
+			continue;
+
+		if (WARN_ON_ONCE(!PageLocked(page) || PageUptodate(page)) ||
+		    verify_hash_path(inode, vi, req, page->index, cache,
+				     wants[n])) {
+			SetPageError(page);
+			continue;
+		}
+
+		pages[n++] = page;
+		if (n == max_pages) {
+			verify_pending_pages(inode, vi, pages, wants, n);
+			n = 0;
+		}
+	}
+
+	if (n)
+		verify_pending_pages(inode, vi, pages, wants, n);
+}
+
 /**
  * fsverity_verify_bio() - verify a 'read' bio that has just completed
  * @bio: the bio to verify
@@ -219,11 +378,16 @@ EXPORT_SYMBOL_GPL(fsverity_verify_page);
  * populate the page cache without issuing bios (e.g. non block-based
  * filesystems) must instead call fsverity_verify_page() directly on each page.
  * All filesystems must also call fsverity_verify_page() on holes.
+ *
+ * When the hash implementation can interleave several messages, the data pages
+ * are hashed in small groups instead of one at a time.
  */
 void fsverity_verify_bio(struct bio *bio)
 {
 	struct inode *inode = bio->bi_io_vec->bv_page->mapping->host;
 	const struct fsverity_info *vi = inode->i_verity_info;
+	struct fsverity_hpage_cache cache = {};
+	struct crypto_shash *mb_tfm;
 	struct ahash_request *req;
 	struct bio_vec *bv;
 	int i;
@@ -235,13 +399,22 @@ void fsverity_verify_bio(struct bio *bio)
 		return;
 	}
 
+	/* pairs with smp_store_release() in fsverity_get_hash_alg() */
+	mb_tfm = smp_load_acquire(&vi->tree_params.hash_alg->mb_tfm);
+	if (mb_tfm) {
+		verify_bio_mb(inode, vi, req, bio, &cache);
+		goto out;
+	}
+
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
 
-		if (!PageError(page) && !verify_page(inode, vi, req, page))
+		if (!PageError(page) &&
+		    !verify_page(inode, vi, req, page, &cache))
 			SetPageError(page);
 	}
-
+out:
+	release_hpage_cache(&cache);
 	ahash_request_free(req);
 }
 EXPORT_SYMBOL_GPL(fsverity_verify_bio);
@@ -259,6 +432,52 @@ void fsverity_enqueue_verify_work(struct work_struct *work)
 }
 EXPORT_SYMBOL_GPL(fsverity_enqueue_verify_work);
 
+static int fsverity_stats_show(struct seq_file *m, void *v)
+{
+	struct fsverity_stats sum = {};
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct fsverity_stats *st = per_cpu_ptr(&fsverity_stats,
+							      cpu);
+
+		sum.data_pages += st->data_pages;
+		sum.hpage_reads += st->hpage_reads;
+		sum.hpage_reuses += st->hpage_reuses;
+		sum.hpage_checked += st->hpage_checked;
+		sum.hpage_hashed += st->hpage_hashed;
+	}
+
+	seq_printf(m, "data_pages_verified: %lu\n", sum.data_pages);
+	seq_printf(m, "hash_page_reads: %lu\n", sum.hpage_reads);
+	seq_printf(m, "hash_page_reuses: %lu\n", sum.hpage_reuses);
+	seq_printf(m, "hash_page_checked_hits: %lu\n", sum.hpage_checked);
+	seq_printf(m, "hash_pages_verified: %lu\n", sum.hpage_hashed);
+	return 0;
+}
+
+static int fsverity_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fsverity_stats_show, NULL);
+}
+
+static const struct file_operations fsverity_stats_fops = {
+	.open		= fsverity_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init fsverity_init_stats(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("fsverity", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("stats", 0444, dir, NULL, &fsverity_stats_fops);
+}
+
 int __init fsverity_init_workqueue(void)
 {
 	/*
@@ -274,6 +493,7 @@ int __init fsverity_init_workqueue(void)
 						  num_online_cpus());
 	if (!fsverity_read_workqueue)
 		return -ENOMEM;
+	fsverity_init_stats();
 	return 0;
 }
 
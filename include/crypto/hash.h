@@ -161,6 +161,11 @@ struct shash_desc {
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
  * @setkey: see struct ahash_alg
+ * @finup_mb: Finish hashing @num_msgs messages of @len bytes each, all
+ *	      continuing from the state in @desc, interleaving them so the
+ *	      hash unit is kept busy.  @desc is left in an undefined state.
+ *	      Optional; only called with 2 <= @num_msgs <= @mb_max_msgs.
+ * @mb_max_msgs: Maximum number of messages @finup_mb can process at once.
  * @digestsize: see struct ahash_alg
  * @statesize: see struct ahash_alg
  * @descsize: Size of the operational state for the message digest. This state
@@ -181,8 +186,12 @@ struct shash_alg {
 	int (*import)(struct shash_desc *desc, const void *in);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	/* These fields must match hash_alg_common. */
 	unsigned int digestsize
@@ -904,4 +913,60 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain multi-buffer message limit
+ * @tfm: cipher handle
+ *
+ * Return: the number of equal-length messages that the implementation can
+ *	   hash at once with crypto_shash_finup_mb(); 1 if it can't interleave
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	struct shash_alg *alg = crypto_shash_alg(tfm);
+
+	return alg->finup_mb ? max(alg->mb_max_msgs, 1U) : 1;
+}
+
+/**
+ * crypto_shash_finup_mb() - finish hashing several messages at once
+ * @desc: operational state, already loaded with any common prefix (salt)
+ * @data: the remaining data of each message
+ * @len: length of each entry of @data, in bytes
+ * @outs: output buffer for each message digest
+ * @num_msgs: number of messages
+ *
+ * Equivalent to calling crypto_shash_finup() on a copy of @desc for each
+ * message, but implementations with a multi-buffer code path interleave the
+ * messages.  Falls back to the sequential computation when @num_msgs exceeds
+ * crypto_shash_mb_max_msgs().  @desc is left in an undefined state.
+ *
+ * Return: 0 if the message digests were computed; < 0 if an error occurred
+ */
+static inline int crypto_shash_finup_mb(struct shash_desc *desc,
+					const u8 * const data[],
+					unsigned int len, u8 * const outs[],
+					unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	unsigned int i;
+	int err;
+
+	if (num_msgs > 1 && num_msgs <= crypto_shash_mb_max_msgs(tfm))
+		return crypto_shash_alg(tfm)->finup_mb(desc, data, len, outs,
+						       num_msgs);
+
+	for (i = 0; i + 1 < num_msgs; i++) {
+		SHASH_DESC_ON_STACK(desc2, tfm);
+
+		desc2->tfm = tfm;
+		desc2->flags = desc->flags;
+		memcpy(shash_desc_ctx(desc2), shash_desc_ctx(desc),
+		       crypto_shash_descsize(tfm));
+		err = crypto_shash_finup(desc2, data[i], len, outs[i]);
+		if (err)
+			return err;
+	}
+	return crypto_shash_finup(desc, data[i], len, outs[i]);
+}
+
 #endif	/* _CRYPTO_HASH_H */
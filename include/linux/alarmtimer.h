@@ -31,6 +31,7 @@ enum alarmtimer_restart {
  * @type:	Alarm type (BOOTTIME/REALTIME)
  * @enabled:	Flag that represents if the alarm is set to fire or not
  * @data:	Internal data value.
+ * @window:	How late the alarm may fire so that it lines up with others.
  */
 struct alarm {
 	struct timerqueue_node	node;
@@ -39,8 +40,18 @@ struct alarm {
 	enum alarmtimer_type	type;
 	int			state;
 	void			*data;
+	ktime_t			window;
 };
 
+/*
+ * Allow the alarm to fire up to @window after its expiry, so that it can
+ * share a wakeup with nearby alarms. Takes effect on the next start.
+ */
+static inline void alarm_set_window(struct alarm *alarm, ktime_t window)
+{
+	alarm->window = window;
+}
+
 void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 		enum alarmtimer_restart (*function)(struct alarm *, ktime_t));
 void alarm_start(struct alarm *alarm, ktime_t start);
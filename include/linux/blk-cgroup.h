@@ -54,6 +54,9 @@ struct blkcg {
 #ifdef CONFIG_CGROUP_WRITEBACK
 	struct list_head		cgwb_list;
 #endif
+
+	/* blkio.background: the cgroup's I/O yields to foreground work */
+	unsigned int			background;
 };
 
 /*
@@ -228,6 +231,22 @@ static inline struct blkcg *task_blkcg(struct task_struct *tsk)
 	return css_to_blkcg(task_css(tsk, io_cgrp_id));
 }
 
+/**
+ * blkcg_task_background - test whether a task issues background I/O
+ * @tsk: task of interest
+ *
+ * True if @tsk is in a blkio cgroup with blkio.background set.
+ */
+static inline bool blkcg_task_background(struct task_struct *tsk)
+{
+	bool background;
+
+	rcu_read_lock();
+	background = ACCESS_ONCE(task_blkcg(tsk)->background);
+	rcu_read_unlock();
+	return background;
+}
+
 static inline struct blkcg *bio_blkcg(struct bio *bio)
 {
 	if (bio && bio->bi_css)
@@ -752,6 +771,7 @@ static inline void blkcg_deactivate_policy(struct request_queue *q,
 					   const struct blkcg_policy *pol) { }
 
 static inline struct blkcg *bio_blkcg(struct bio *bio) { return NULL; }
+static inline bool blkcg_task_background(struct task_struct *tsk) { return false; }
 
 static inline struct blkg_policy_data *blkg_to_pd(struct blkcg_gq *blkg,
 						  struct blkcg_policy *pol) { return NULL; }
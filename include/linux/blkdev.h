@@ -35,6 +35,7 @@ struct sg_io_hdr;
 struct bsg_job;
 struct blkcg_gq;
 struct blk_flush_queue;
+struct blk_latency;
 struct pr_ops;
 
 #define BLKDEV_MIN_RQ	4
@@ -44,7 +45,7 @@ struct pr_ops;
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
  */
-#define BLKCG_MAX_POLS		2
+#define BLKCG_MAX_POLS		3
 
 struct request;
 typedef void (rq_end_io_fn)(struct request *, int);
@@ -174,6 +175,7 @@ struct request {
 #endif
 
 	unsigned short ioprio;
+	unsigned short write_hint;	/* enum rw_hint of the bios */
 
 	void *special;		/* opaque pointer available for LLD use */
 
@@ -208,6 +210,10 @@ struct request {
 
 	ktime_t			lat_hist_io_start;
 	int			lat_hist_enabled;
+#ifdef CONFIG_BLK_DEV_LATENCY_STATS
+	u64			lat_start_ns;	/* 0 if not sampled */
+	unsigned int		lat_bytes;	/* completed so far */
+#endif
 };
 
 static inline bool blk_rq_is_passthrough(struct request *rq)
@@ -470,6 +476,10 @@ struct request_queue {
 #ifdef CONFIG_BLK_DEV_THROTTLING
 	/* Throttle data */
 	struct throtl_data *td;
+#endif
+#ifdef CONFIG_BLK_DEV_LATENCY_STATS
+	struct blk_latency	*latency;
+	unsigned int		lat_hist_enabled;
 #endif
 	struct rcu_head		rcu_head;
 	wait_queue_head_t	mq_freeze_wq;
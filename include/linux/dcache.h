@@ -61,7 +61,8 @@ struct dentry_stat_t {
 	long nr_unused;
 	long age_limit;          /* age in seconds */
 	long want_pages;         /* pages requested by system */
-	long dummy[2];
+	long nr_negative;        /* unused negative dentries */
+	long dummy;
 };
 extern struct dentry_stat_t dentry_stat;
 
@@ -231,6 +232,7 @@ struct dentry_operations {
 #define DCACHE_OP_SELECT_INODE		0x02000000 /* Unioned entry: dcache op selects inode */
 #define DCACHE_ENCRYPTED_WITH_KEY	0x04000000 /* dir is encrypted with a valid key */
 #define DCACHE_OP_REAL			0x08000000
+#define DCACHE_NEGATIVE_LRU		0x10000000 /* Counted in sb->s_nr_negative_dentry */
 
 extern seqlock_t rename_lock;
 
@@ -28,6 +28,20 @@
 #define DELAYACCT_PF_SWAPIN	0x00000001	/* I am doing a swapin */
 #define DELAYACCT_PF_BLKIO	0x00000002	/* I am waiting on IO */
 
+/*
+ * The low memory killer counts the time tasks spend in direct reclaim
+ * through the same hooks that account it per task.
+ */
+#ifdef CONFIG_ANDROID_LMK_MEMSTALL
+extern void lmk_memstall_enter(void);
+extern void lmk_memstall_leave(void);
+#else
+static inline void lmk_memstall_enter(void)
+{}
+static inline void lmk_memstall_leave(void)
+{}
+#endif
+
 #ifdef CONFIG_TASK_DELAY_ACCT
 
 extern int delayacct_on;	/* Delay accounting turned on/off */
@@ -111,6 +125,7 @@ static inline __u64 delayacct_blkio_ticks(struct task_struct *tsk)
 
 static inline void delayacct_freepages_start(void)
 {
+	lmk_memstall_enter();
 	if (current->delays)
 		__delayacct_freepages_start();
 }
@@ -119,6 +134,7 @@ static inline void delayacct_freepages_end(void)
 {
 	if (current->delays)
 		__delayacct_freepages_end();
+	lmk_memstall_leave();
 }
 
 #else
@@ -144,9 +160,9 @@ static inline __u64 delayacct_blkio_ticks(struct task_struct *tsk)
 static inline int delayacct_is_task_waiting_on_io(struct task_struct *p)
 { return 0; }
 static inline void delayacct_freepages_start(void)
-{}
+{ lmk_memstall_enter(); }
 static inline void delayacct_freepages_end(void)
-{}
+{ lmk_memstall_leave(); }
 
 #endif /* CONFIG_TASK_DELAY_ACCT */
 
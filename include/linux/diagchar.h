@@ -28,6 +28,36 @@
 
 #define USB_MODE			1
 #define MEMORY_DEVICE_MODE		2
+
+/*
+ * Memory device ring, mapped from offset 0 of the diag device once
+ * configured with DIAG_IOCTL_MD_RING_CONFIG. The header takes the first
+ * page and the data area of @size bytes follows it. The kernel advances
+ * @head and the consumer advances @tail, both free running byte counts
+ * taken modulo @size. Each record is a struct diag_md_ring_rec followed
+ * by @len bytes of data, padded to DIAG_MD_RING_ALIGN. The data of a
+ * record may wrap around the end of the data area.
+ */
+#define DIAG_MD_RING_VERSION		1
+#define DIAG_MD_RING_ALIGN		8
+
+struct diag_md_ring_hdr {
+	uint32_t version;
+	uint32_t data_offset;
+	uint32_t size;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t reserved;
+	uint64_t records;
+	uint64_t bytes;
+	uint64_t dropped_records;
+	uint64_t dropped_bytes;
+};
+
+struct diag_md_ring_rec {
+	int32_t remote_token;
+	int32_t len;
+};
 #define NO_LOGGING_MODE			3
 #define UART_MODE			4
 #define SOCKET_MODE			5
@@ -67,6 +97,7 @@
 #define DIAG_IOCTL_REGISTER_CALLBACK	37
 #define DIAG_IOCTL_HDLC_TOGGLE	38
 #define DIAG_IOCTL_QUERY_PD_LOGGING	39
+#define DIAG_IOCTL_MD_RING_CONFIG	40
 
 /* PC Tools IDs */
 #define APQ8060_TOOLS_ID	4062
@@ -15,9 +15,31 @@
 
 #include <linux/iommu.h>
 #include <linux/io-pgtable-fast.h>
+#include <linux/workqueue.h>
 
 struct dma_iommu_mapping;
 
+/**
+ * struct dma_fast_smmu_stats - TLB maintenance done by a fast mapping
+ * @deferred: unmaps whose IOVA release was queued for a batched flush
+ * @batch_flushes: flushes done because the queue was full
+ * @timeout_flushes: flushes done by the queue timeout
+ * @alloc_flushes: flushes done because the allocator ran out of space
+ * @stale_flushes: TLB invalidations done on re-allocating a stale IOVA
+ */
+struct dma_fast_smmu_stats {
+	u64 deferred;
+	u64 batch_flushes;
+	u64 timeout_flushes;
+	u64 alloc_flushes;
+	u64 stale_flushes;
+};
+
+struct dma_fast_smmu_deferred {
+	dma_addr_t	iova;
+	size_t		size;
+};
+
 struct dma_fast_smmu_mapping {
 	struct device		*dev;
 	struct iommu_domain	*domain;
@@ -38,6 +60,13 @@ struct dma_fast_smmu_mapping {
 	struct notifier_block notifier;
 
 	int		is_smmu_pt_coherent;
+
+	/* unmapped IOVAs held back until the next TLB invalidate-all */
+	struct dma_fast_smmu_deferred *deferred;
+	unsigned int	nr_deferred;
+	unsigned int	max_deferred;
+	struct delayed_work flush_work;
+	struct dma_fast_smmu_stats stats;
 };
 
 #ifdef CONFIG_IOMMU_IO_PGTABLE_FAST
@@ -45,6 +74,8 @@ int fast_smmu_attach_device(struct device *dev,
 			    struct dma_iommu_mapping *mapping);
 void fast_smmu_detach_device(struct device *dev,
 			     struct dma_iommu_mapping *mapping);
+void fast_smmu_get_stats(struct dma_fast_smmu_mapping *mapping,
+			 struct dma_fast_smmu_stats *stats);
 #else
 static inline int fast_smmu_attach_device(struct device *dev,
 					  struct dma_iommu_mapping *mapping)
@@ -56,6 +87,12 @@ static inline void fast_smmu_detach_device(struct device *dev,
 					   struct dma_iommu_mapping *mapping)
 {
 }
+
+static inline void fast_smmu_get_stats(struct dma_fast_smmu_mapping *mapping,
+				       struct dma_fast_smmu_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
 #endif
 
 #endif /* __LINUX_DMA_MAPPING_FAST_H */
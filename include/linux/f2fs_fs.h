@@ -23,6 +23,7 @@
 
 #define NULL_ADDR		((block_t)0)	/* used as block_t addresses */
 #define NEW_ADDR		((block_t)-1)	/* used as block_t addresses */
+#define COMPRESS_ADDR		((block_t)-2)	/* used as compressed data flag */
 
 #define F2FS_BYTES_TO_BLK(bytes)	((bytes) >> F2FS_BLKSIZE_BITS)
 #define F2FS_BLK_TO_BYTES(blk)		((blk) << F2FS_BLKSIZE_BITS)
@@ -264,6 +265,10 @@ struct f2fs_inode {
 			__le32 i_inode_checksum;/* inode meta checksum */
 			__le64 i_crtime;	/* creation time */
 			__le32 i_crtime_nsec;	/* creation time in nano scale */
+			__le64 i_compr_blocks;	/* # of compressed blocks */
+			__u8 i_compress_algorithm;	/* compress algorithm */
+			__u8 i_log_cluster_size;	/* log of cluster size */
+			__le16 i_compress_flag;		/* compress flag */
 			__le32 i_extra_end[0];	/* for attribute size calculation */
 		} __packed;
 		__le32 i_addr[DEF_ADDRS_PER_INODE];	/* Pointers to data blocks */
@@ -272,6 +277,33 @@ struct f2fs_inode {
 						double_indirect(1) node id */
 } __packed;
 
+/*
+ * For compressed files: the data of a file is split in clusters of
+ * 1 << i_log_cluster_size blocks. A compressed cluster starts with a
+ * COMPRESS_ADDR marker in place of its first block address, followed by
+ * the addresses of the blocks holding the compressed data and NEW_ADDR
+ * for the blocks it saved.
+ */
+#define F2FS_MIN_LOG_CLUSTER_SIZE	2	/* 16KB clusters */
+#define F2FS_MAX_LOG_CLUSTER_SIZE	8	/* 1MB clusters */
+
+enum f2fs_compress_algorithm {
+	F2FS_COMPRESS_LZO,
+	F2FS_COMPRESS_LZ4,
+	F2FS_COMPRESS_ZSTD,
+	F2FS_COMPRESS_MAX,
+};
+
+/* header at the start of the first block of a compressed cluster */
+struct f2fs_compress_data {
+	__le32 clen;			/* compressed data size */
+	__le32 chksum;			/* crc32 of the compressed data */
+	__le32 reserved[4];		/* reserved */
+	__u8 cdata[];			/* compressed data */
+} __packed;
+
+#define F2FS_COMPRESS_HEADER_SIZE	(sizeof(struct f2fs_compress_data))
+
 struct direct_node {
 	__le32 addr[DEF_ADDRS_PER_BLOCK];	/* array of data block address */
 } __packed;
@@ -1465,6 +1465,9 @@ struct super_block {
 	 */
 	struct list_lru		s_dentry_lru ____cacheline_aligned_in_smp;
 	struct list_lru		s_inode_lru ____cacheline_aligned_in_smp;
+
+	/* Negative dentries on s_dentry_lru, bounded by dput() */
+	atomic_long_t		s_nr_negative_dentry;
 	struct rcu_head		rcu;
 	struct work_struct	destroy_work;
 
@@ -1961,6 +1964,10 @@ struct super_operations {
  *			Used to detect that mark_inode_dirty() should not move
  * 			inode between dirty lists.
  *
+ * I_DIRTY_FG		Inode was dirtied by a foreground task since it was
+ *			last clean.  The flusher writes such inodes ahead of
+ *			those dirtied only by background tasks.
+ *
  * Q: What is the difference between I_WILL_FREE and I_FREEING?
  */
 #define I_DIRTY_SYNC		(1 << 0)
@@ -1980,6 +1987,7 @@ struct super_operations {
 #define I_DIRTY_TIME		(1 << 11)
 #define I_DIRTY_TIME_EXPIRED	(1 << 12)
 #define I_WB_SWITCH		(1 << 13)
+#define I_DIRTY_FG		(1 << 14)
 #define I_SYNC_QUEUED		(1 << 17)
 
 #define I_DIRTY (I_DIRTY_SYNC | I_DIRTY_DATASYNC | I_DIRTY_PAGES)
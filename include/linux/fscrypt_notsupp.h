@@ -67,6 +67,11 @@ static inline void fscrypt_restore_control_page(struct page *page)
 	return;
 }
 
+static inline bool fscrypt_using_hardware_encryption(const struct inode *inode)
+{
+	return false;
+}
+
 /* policy.c */
 static inline int fscrypt_ioctl_set_policy(struct file *filp,
 					   const void __user *arg)
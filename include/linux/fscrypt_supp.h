@@ -17,6 +17,8 @@
  * fscrypt superblock flags
  */
 #define FS_CFLG_OWN_PAGES (1U << 1)
+/* regular file contents may be encrypted by an inline crypto engine */
+#define FS_CFLG_INLINE_CRYPT (1U << 2)
 
 /*
  * crypto operations for filesystems
@@ -74,6 +76,16 @@ static inline struct page *fscrypt_control_page(struct page *page)
 
 extern void fscrypt_restore_control_page(struct page *);
 
+/* fscrypt_ice.c */
+#ifdef CONFIG_FS_ENCRYPTION_ICE
+extern bool fscrypt_using_hardware_encryption(const struct inode *);
+#else
+static inline bool fscrypt_using_hardware_encryption(const struct inode *inode)
+{
+	return false;
+}
+#endif
+
 /* policy.c */
 extern int fscrypt_ioctl_set_policy(struct file *, const void __user *);
 extern int fscrypt_ioctl_get_policy(struct file *, void __user *);
@@ -36,6 +36,7 @@
 #include <linux/slab.h>
 #include <linux/wakelock.h>
 #include <linux/power_supply.h>
+#include <linux/pm_qos.h>
 #include <linux/input/mt.h>
 #include <linux/uaccess.h>
 #include <linux/proc_fs.h>
@@ -142,6 +143,9 @@ struct ft5x46_data {
 	int keys;
 	int dbclick_count;
 
+	ktime_t irq_ts;
+	struct pm_qos_request pm_qos_req;
+
 #ifdef CONFIG_FB
 	struct notifier_block fb_notif;
 #endif
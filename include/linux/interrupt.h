@@ -379,6 +379,17 @@ extern int irq_get_irqchip_state(unsigned int irq, enum irqchip_irq_state which,
 extern int irq_set_irqchip_state(unsigned int irq, enum irqchip_irq_state which,
 				 bool state);
 
+#ifdef CONFIG_IRQ_TIMINGS
+extern u64 irq_timings_next_event(u64 now, const struct cpumask *mask,
+				  unsigned int *irqp);
+#else
+static inline u64 irq_timings_next_event(u64 now, const struct cpumask *mask,
+					 unsigned int *irqp)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_IRQ_FORCED_THREADING
 extern bool force_irqthreads;
 #else
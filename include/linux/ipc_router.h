@@ -86,6 +86,7 @@ enum ipc_rtr_af_event_type {
  * msm_ipc_port - Definition of IPC Router port
  * @list: List(local/control ports) in which this port is present.
  * @ref: Reference count for this port.
+ * @rcu: Defers freeing of the port past lockless local port lookups.
  * @this_port: Contains port's node_id and port_id information.
  * @port_name: Contains service & instance info if the port hosts a service.
  * @type: Type of the port - Client, Service, Control or Security Config.
@@ -112,6 +113,7 @@ enum ipc_rtr_af_event_type {
 struct msm_ipc_port {
 	struct list_head list;
 	struct kref ref;
+	struct rcu_head rcu;
 
 	struct msm_ipc_port_addr this_port;
 	struct msm_ipc_port_name port_name;
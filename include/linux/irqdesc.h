@@ -85,6 +85,16 @@ struct irq_desc {
 	int			parent_irq;
 	struct module		*owner;
 	const char		*name;
+#ifdef CONFIG_IRQ_TIMINGS
+	u64			timing_last;	/* local_clock() of the last arrival */
+	u32			timing_period;	/* average interval, ns */
+	u32			timing_conf;	/* intervals close to the average */
+#endif
+#ifdef CONFIG_IRQ_BALANCE
+	u64			balance_ns;	/* time spent in the handlers */
+	u64			balance_ns_last;
+	unsigned int		balance_count_last;
+#endif
 } ____cacheline_internodealigned_in_smp;
 
 #ifdef CONFIG_SPARSE_IRQ
@@ -456,6 +456,17 @@ struct mm_struct {
 	 */
 	struct mm_rss_stat rss_stat;
 
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	/*
+	 * Totals in kB of the last precise smaps_rollup walk, from which
+	 * smaps_rollup_cached estimates PSS without walking page tables.
+	 */
+	unsigned long smaps_rss_kb;
+	unsigned long smaps_pss_kb;
+	unsigned long smaps_swap_pss_kb;
+	unsigned long smaps_walk_jiffies;
+#endif
+
 	struct linux_binfmt *binfmt;
 
 	cpumask_var_t cpu_vm_mask_var;
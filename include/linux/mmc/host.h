@@ -99,6 +99,8 @@ struct mmc_cmdq_host_ops {
 	int (*enable)(struct mmc_host *host);
 	void (*disable)(struct mmc_host *host, bool soft);
 	int (*request)(struct mmc_host *host, struct mmc_request *mrq);
+	/* ring the doorbell for requests issued with DEFER_DB */
+	void (*commit)(struct mmc_host *host);
 	void (*post_req)(struct mmc_host *host, int tag, int err);
 	int (*halt)(struct mmc_host *host, bool halt);
 	void (*reset)(struct mmc_host *host, bool soft);
@@ -207,6 +209,7 @@ struct mmc_cmdq_req {
 #define REL_WR		(1 << 4)
 #define DAT_TAG	(1 << 5)
 #define FORCED_PRG	(1 << 6)
+#define DEFER_DB	(1 << 7)
 	unsigned int		cmdq_req_flags;
 
 	unsigned int		resp_idx;
@@ -585,6 +588,9 @@ struct mmc_host {
 	bool perf_enable;
 #endif
 	struct mmc_trace_buffer trace_buf;
+#ifdef CONFIG_MMC_IO_STATS
+	struct mmc_io_stats io_stats;
+#endif
 	enum dev_state dev_status;
 	bool			wakeup_on_idle;
 	struct mmc_cmdq_context_info	cmdq_ctx;
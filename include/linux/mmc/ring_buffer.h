@@ -17,6 +17,8 @@
 
 #include <linux/mmc/card.h>
 #include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 #include "core.h"
 
@@ -52,4 +54,63 @@ static inline void mmc_dump_trace_buffer(struct mmc_host *mmc,
 #define MMC_TRACE(mmc, fmt, ...) \
 		mmc_trace_write(mmc, fmt, ##__VA_ARGS__)
 
+/*
+ * Binary request latency records and histograms. Unlike the text trace
+ * above these are meant to stay enabled in production.
+ */
+enum mmc_io_op {
+	MMC_IO_READ,
+	MMC_IO_WRITE,
+	MMC_IO_DISCARD,
+	MMC_IO_NR_OPS,
+};
+
+/* size classes: <= 4K, <= 64K, <= 512K and larger */
+#define MMC_IO_NR_SIZES		4
+/* bucket i holds latencies below (32us << i), the last one the rest */
+#define MMC_IO_LAT_MIN_SHIFT	5
+#define MMC_IO_NR_BUCKETS	16
+#define MMC_IO_NR_RECORDS	1024
+
+/* one completed request, as read from debugfs io_records */
+struct mmc_io_record {
+	u64	start_ns;
+	u32	lat_us;
+	u32	addr;
+	u32	bytes;
+	u8	op;
+	u8	error;
+	u16	reserved;
+} __packed;
+
+struct mmc_io_stats {
+	spinlock_t lock;
+	u32 hist[MMC_IO_NR_OPS][MMC_IO_NR_SIZES][MMC_IO_NR_BUCKETS];
+	u64 sum_us[MMC_IO_NR_OPS];
+	u32 max_us[MMC_IO_NR_OPS];
+	unsigned int wr_idx;
+	struct mmc_io_record *records;
+};
+
+struct mmc_request;
+#ifdef CONFIG_MMC_IO_STATS
+void mmc_io_stats_init(struct mmc_host *mmc);
+void mmc_io_stats_free(struct mmc_host *mmc);
+void mmc_io_stats_reset(struct mmc_host *mmc);
+void mmc_io_stats_account(struct mmc_host *mmc, enum mmc_io_op op,
+		unsigned int bytes, u32 addr, ktime_t start, int error);
+void mmc_io_stats_req_done(struct mmc_host *mmc, struct mmc_request *mrq);
+void mmc_io_stats_show(struct mmc_host *mmc, struct seq_file *s);
+void *mmc_io_stats_snapshot(struct mmc_host *mmc, size_t *len);
+#else
+static inline void mmc_io_stats_init(struct mmc_host *mmc) {}
+static inline void mmc_io_stats_free(struct mmc_host *mmc) {}
+static inline void mmc_io_stats_reset(struct mmc_host *mmc) {}
+static inline void mmc_io_stats_account(struct mmc_host *mmc,
+		enum mmc_io_op op, unsigned int bytes, u32 addr,
+		ktime_t start, int error) {}
+static inline void mmc_io_stats_req_done(struct mmc_host *mmc,
+		struct mmc_request *mrq) {}
+#endif
+
 #endif /* __MMC_RING_BUFFER__ */
@@ -102,6 +102,8 @@ void msm_bus_scale_unregister(struct msm_bus_client_handle *cl);
 int msm_bus_scale_update_bw(struct msm_bus_client_handle *cl, u64 ab, u64 ib);
 int msm_bus_scale_update_bw_context(struct msm_bus_client_handle *cl,
 		u64 act_ab, u64 act_ib, u64 slp_ib, u64 slp_ab);
+void msm_bus_scale_batch_begin(void);
+void msm_bus_scale_batch_end(void);
 /* AXI Port configuration APIs */
 int msm_bus_axi_porthalt(int master_port);
 int msm_bus_axi_portunhalt(int master_port);
@@ -169,6 +171,14 @@ msm_bus_scale_update_bw_context(struct msm_bus_client_handle *cl, u64 act_ab,
 	return 0;
 }
 
+static inline void msm_bus_scale_batch_begin(void)
+{
+}
+
+static inline void msm_bus_scale_batch_end(void)
+{
+}
+
 #endif
 
 #if defined(CONFIG_OF) && defined(CONFIG_QCOM_BUS_SCALING)
@@ -77,6 +77,16 @@ struct msm_thermal_data {
 	int32_t vdd_mx_temp_hyst_degC;
 	int32_t vdd_mx_sensor_id;
 	int32_t therm_reset_temp_degC;
+	uint32_t budget_sensor_id;
+	int32_t budget_temp_degC;
+	uint32_t budget_sustainable_mw;
+};
+
+/* Budget actors outside the CPU clusters, which are handled internally */
+enum msm_thermal_budget_actor {
+	MSM_BUDGET_GPU,
+	MSM_BUDGET_MODEM,
+	MSM_BUDGET_NR_EXT,
 };
 
 enum sensor_id_type {
@@ -258,13 +268,38 @@ extern void devmgr_unregister_mitigation_client(
 					struct device_clnt_data *clnt);
 #ifdef CONFIG_QCOM_THERMAL_LIMITS_DCVS
 extern int msm_lmh_dcvsh_sw_notify(int cpu);
+extern int msm_lmh_dcvs_get_hw_limit(int cpu, uint32_t *freq);
 #else
 static inline int msm_lmh_dcvsh_sw_notify(int cpu)
 {
 	return -ENODEV;
 }
+static inline int msm_lmh_dcvs_get_hw_limit(int cpu, uint32_t *freq)
+{
+	return -ENODEV;
+}
 #endif
 
+/**
+ * msm_thermal_budget_request - Report the power an actor wants to draw
+ *
+ * @actor: GPU or modem.
+ * @power_mw: Power in mW the actor would use without a limit.
+ *
+ * Returns 0 on success, or -ENODEV if the actor has no budget.
+ */
+extern int msm_thermal_budget_request(enum msm_thermal_budget_actor actor,
+				uint32_t power_mw);
+/**
+ * msm_thermal_budget_get - Power an actor is allowed to draw
+ *
+ * @actor: GPU or modem.
+ *
+ * Returns the granted power in mW, or UINT_MAX while the power budget
+ * controller is not limiting.
+ */
+extern uint32_t msm_thermal_budget_get(enum msm_thermal_budget_actor actor);
+
 #else
 static inline int msm_thermal_init(struct msm_thermal_data *pdata)
 {
@@ -279,6 +314,16 @@ static inline int msm_thermal_set_frequency(uint32_t cpu, uint32_t freq,
 {
 	return -ENOSYS;
 }
+static inline int msm_thermal_budget_request(
+	enum msm_thermal_budget_actor actor, uint32_t power_mw)
+{
+	return -ENOSYS;
+}
+static inline uint32_t msm_thermal_budget_get(
+	enum msm_thermal_budget_actor actor)
+{
+	return UINT_MAX;
+}
 static inline int msm_thermal_set_cluster_freq(uint32_t cluster, uint32_t freq,
 	bool is_max)
 {
@@ -15,6 +15,7 @@
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/x_tables.h>
+#include <linux/percpu.h>
 #include <linux/stringify.h>
 #include <linux/vmalloc.h>
 #include <net/netlink.h>
@@ -103,9 +104,21 @@ struct ip_set_ext {
 	char *comment;
 };
 
+/* Element counters are per CPU, so that matching packets on several CPUs
+ * do not bounce a shared cache line, and are summed up when read.
+ */
+struct ip_set_counter_pcpu {
+	u64 bytes;
+	u64 packets;
+};
+
+struct ip_set_counter_rcu {
+	struct rcu_head rcu;
+	struct ip_set_counter_pcpu __percpu *pcpu;
+};
+
 struct ip_set_counter {
-	atomic64_t bytes;
-	atomic64_t packets;
+	struct ip_set_counter_rcu __rcu *c;
 };
 
 struct ip_set_comment_rcu {
@@ -262,6 +275,9 @@ ip_set_ext_destroy(struct ip_set *set, void *data)
 	/* Check that the extension is enabled for the set and
 	 * call it's destroy function for its extension part in data.
 	 */
+	if (SET_WITH_COUNTER(set))
+		ip_set_extensions[IPSET_EXT_ID_COUNTER].destroy(
+			ext_counter(data, set));
 	if (SET_WITH_COMMENT(set))
 		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(
 			ext_comment(data, set));
@@ -290,28 +306,55 @@ ip_set_put_flags(struct sk_buff *skb, struct ip_set *set)
 	return nla_put_net32(skb, IPSET_ATTR_CADT_FLAGS, htonl(cadt_flags));
 }
 
+/* Counters are accessed under rcu_read_lock(_bh) or the set spinlock */
+static inline struct ip_set_counter_rcu *
+ip_set_counter_deref(const struct ip_set_counter *counter)
+{
+	return rcu_dereference_raw(counter->c);
+}
+
 static inline void
 ip_set_add_bytes(u64 bytes, struct ip_set_counter *counter)
 {
-	atomic64_add((long long)bytes, &(counter)->bytes);
+	struct ip_set_counter_rcu *c = ip_set_counter_deref(counter);
+
+	if (likely(c))
+		this_cpu_add(c->pcpu->bytes, bytes);
 }
 
 static inline void
 ip_set_add_packets(u64 packets, struct ip_set_counter *counter)
 {
-	atomic64_add((long long)packets, &(counter)->packets);
+	struct ip_set_counter_rcu *c = ip_set_counter_deref(counter);
+
+	if (likely(c))
+		this_cpu_add(c->pcpu->packets, packets);
 }
 
 static inline u64
 ip_set_get_bytes(const struct ip_set_counter *counter)
 {
-	return (u64)atomic64_read(&(counter)->bytes);
+	struct ip_set_counter_rcu *c = ip_set_counter_deref(counter);
+	u64 bytes = 0;
+	int cpu;
+
+	if (c)
+		for_each_possible_cpu(cpu)
+			bytes += per_cpu_ptr(c->pcpu, cpu)->bytes;
+	return bytes;
 }
 
 static inline u64
 ip_set_get_packets(const struct ip_set_counter *counter)
 {
-	return (u64)atomic64_read(&(counter)->packets);
+	struct ip_set_counter_rcu *c = ip_set_counter_deref(counter);
+	u64 packets = 0;
+	int cpu;
+
+	if (c)
+		for_each_possible_cpu(cpu)
+			packets += per_cpu_ptr(c->pcpu, cpu)->packets;
+	return packets;
 }
 
 static inline void
@@ -375,15 +418,9 @@ ip_set_put_counter(struct sk_buff *skb, struct ip_set_counter *counter)
 			     cpu_to_be64(ip_set_get_packets(counter)));
 }
 
-static inline void
-ip_set_init_counter(struct ip_set_counter *counter,
-		    const struct ip_set_ext *ext)
-{
-	if (ext->bytes != ULLONG_MAX)
-		atomic64_set(&(counter)->bytes, (long long)(ext->bytes));
-	if (ext->packets != ULLONG_MAX)
-		atomic64_set(&(counter)->packets, (long long)(ext->packets));
-}
+extern void ip_set_init_counter(struct ip_set_counter *counter,
+				const struct ip_set_ext *ext);
+extern void ip_set_counter_free(struct ip_set_counter *counter);
 
 /* Netlink CB args */
 enum {
@@ -116,6 +116,14 @@ static inline bool task_will_free_mem(struct task_struct *task)
 extern void dump_tasks(struct mem_cgroup *memcg,
 		const nodemask_t *nodemask);
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+extern void lowmem_adj_index_update(struct task_struct *task);
+#else
+static inline void lowmem_adj_index_update(struct task_struct *task)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
@@ -43,6 +43,9 @@ struct pipe_buffer {
  *	@fasync_writers: writer side fasync
  *	@bufs: the circular array of pipe buffers
  *	@user: the user who created this pipe
+ *	@full_stamp: start of the current pipe_autosize() window
+ *	@full_count: times splice found the pipe full in that window
+ *	@sized: the size was set by F_SETPIPE_SZ and is left alone
  **/
 struct pipe_inode_info {
 	struct mutex mutex;
@@ -59,6 +62,9 @@ struct pipe_inode_info {
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
 	struct user_struct *user;
+	unsigned long full_stamp;
+	unsigned int full_count;
+	bool sized;
 };
 
 /*
@@ -159,6 +165,7 @@ extern const struct pipe_buf_operations nosteal_pipe_buf_ops;
 
 /* for F_SETPIPE_SZ and F_GETPIPE_SZ */
 long pipe_fcntl(struct file *, unsigned int, unsigned long arg);
+bool pipe_autosize(struct pipe_inode_info *pipe);
 struct pipe_inode_info *get_pipe_info(struct file *file);
 
 int create_pipe_files(struct file **, int);
@@ -31,6 +31,12 @@
  */
 #define PRZ_FLAG_NO_LOCK	BIT(0)
 
+/*
+ * Split the ftrace area into one zone per possible CPU, so that the
+ * function tracer can write its records without taking any lock.
+ */
+#define RAMOOPS_FLAG_FTRACE_PER_CPU	BIT(0)
+
 struct persistent_ram_buffer;
 struct rs_control;
 
@@ -97,6 +103,7 @@ struct ramoops_platform_data {
 	unsigned long	ftrace_size;
 	unsigned long	pmsg_size;
 	int		dump_oops;
+	u32		flags;
 	struct persistent_ram_ecc_info ecc_info;
 };
 
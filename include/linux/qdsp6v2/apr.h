@@ -14,6 +14,7 @@
 #define __APR_H_
 
 #include <linux/mutex.h>
+#include <linux/ktime.h>
 #include <soc/qcom/subsystem_notif.h>
 
 enum apr_subsys_state {
@@ -126,6 +127,15 @@ struct apr_client_data {
 
 typedef int32_t (*apr_fn)(struct apr_client_data *data, void *priv);
 
+/* Commands remembered per service to time their basic responses */
+#define APR_SVC_TRACE_DEPTH 8
+
+struct apr_svc_trace {
+	uint32_t opcode;
+	uint32_t token;
+	ktime_t ts;
+};
+
 struct apr_svc {
 	uint16_t id;
 	uint16_t dest_id;
@@ -142,6 +152,8 @@ struct apr_svc {
 	struct mutex m_lock;
 	spinlock_t w_lock;
 	uint8_t pkt_owner;
+	uint8_t trace_idx;
+	struct apr_svc_trace trace[APR_SVC_TRACE_DEPTH];
 #ifdef CONFIG_MSM_QDSP6_APRV2_VM
 	uint16_t vm_dest_svc;
 	uint32_t vm_handle;
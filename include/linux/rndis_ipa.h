@@ -71,6 +71,8 @@ int rndis_ipa_pipe_disconnect_notify(void *private);
 
 void rndis_ipa_cleanup(void *private);
 
+int rndis_ipa_set_dl_aggr(bool enable);
+
 #else /* CONFIG_RNDIS_IPA*/
 
 static inline int rndis_ipa_init(struct ipa_usb_init_params *params)
@@ -97,6 +99,11 @@ static inline void rndis_ipa_cleanup(void *private)
 {
 
 }
+
+static inline int rndis_ipa_set_dl_aggr(bool enable)
+{
+	return -ENODEV;
+}
 #endif /* CONFIG_RNDIS_IPA */
 
 #endif /* _RNDIS_IPA_H_ */
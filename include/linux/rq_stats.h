@@ -26,6 +26,34 @@ struct rq_data {
 	int init;
 };
 
+/* CPU time classes of a sample, in the order of struct rq_stats_record */
+enum rq_stats_class {
+	RQ_CLASS_USER,
+	RQ_CLASS_SYSTEM,
+	RQ_CLASS_IRQ,
+	RQ_CLASS_SOFTIRQ,
+	RQ_CLASS_IOWAIT,
+	RQ_CLASS_IDLE,
+	RQ_CLASS_NR,
+};
+
+#define RQ_STATS_NR_RECORDS	4096
+
+/*
+ * One sample of one CPU, as read from cpu0/rq-stats/history. @cluster is
+ * the first CPU of the cluster and @nr_running is system wide. The times
+ * are in us spent in each class since the previous sample of that CPU.
+ */
+struct rq_stats_record {
+	u64 ts_ns;
+	u16 cpu;
+	u16 cluster;
+	u32 freq;
+	u32 nr_running;
+	u32 nr_iowait;
+	u32 time_us[RQ_CLASS_NR];
+};
+
 extern spinlock_t rq_lock;
 extern struct rq_data rq_info;
 extern struct workqueue_struct *rq_wq;
@@ -28,6 +28,8 @@ struct rw_semaphore {
 	long count;
 	struct list_head wait_list;
 	raw_spinlock_t wait_lock;
+	/* set when a starving waiter must be the next one to get the lock */
+	unsigned int handoff;
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	struct optimistic_spin_queue osq; /* spinner MCS lock */
 	/*
@@ -36,6 +38,7 @@ struct rw_semaphore {
 	 */
 	struct task_struct *owner;
 #endif
+	const char *name;	/* lock class for the contention stats */
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
 #endif
@@ -71,11 +74,18 @@ static inline int rwsem_is_locked(struct rw_semaphore *sem)
 #define __RWSEM_OPT_INIT(lockname)
 #endif
 
+#ifdef CONFIG_RWSEM_GENERIC_SPINLOCK
+#define __RWSEM_NAME_INIT(lockname)
+#else
+#define __RWSEM_NAME_INIT(lockname) , .name = #lockname
+#endif
+
 #define __RWSEM_INITIALIZER(name)				\
 	{ .count = RWSEM_UNLOCKED_VALUE,			\
 	  .wait_list = LIST_HEAD_INIT((name).wait_list),	\
 	  .wait_lock = __RAW_SPIN_LOCK_UNLOCKED(name.wait_lock)	\
 	  __RWSEM_OPT_INIT(name)				\
+	  __RWSEM_NAME_INIT(name)				\
 	  __RWSEM_DEP_MAP_INIT(name) }
 
 #define DECLARE_RWSEM(name) \
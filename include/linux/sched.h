@@ -880,6 +880,12 @@ struct signal_struct {
 	short oom_score_adj;		/* OOM kill score adjustment */
 	short oom_score_adj_min;	/* OOM kill score adjustment min value.
 					 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	/* lowmemorykiller victim index, see lowmem_adj_index_update() */
+	struct hlist_node lmk_adj_node;
+	struct task_struct *lmk_adj_task;
+	short lmk_adj_bucket;
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -1962,6 +1968,12 @@ struct task_struct {
 	unsigned long ptrace_message;
 	siginfo_t *last_siginfo; /* For ptrace use.  */
 	struct task_io_accounting ioac;
+#ifdef CONFIG_UID_SYS_STATS
+	/* part of ioac already charged to the UID, valid if owner is us */
+	struct task_io_accounting uid_ioac;
+	struct task_struct *uid_ioac_owner;
+	unsigned long uid_ioac_next;	/* jiffies of the next charge */
+#endif
 #if defined(CONFIG_TASK_XACCT)
 	u64 acct_rss_mem1;	/* accumulated rss usage */
 	u64 acct_vm_mem1;	/* accumulated virtual memory usage */
@@ -3657,15 +3669,31 @@ extern struct task_group root_task_group;
 extern int task_can_switch_user(struct user_struct *up,
 					struct task_struct *tsk);
 
+#ifdef CONFIG_UID_SYS_STATS
+extern void uid_sys_stats_charge_io(struct task_struct *tsk);
+
+static inline void uid_io_account(struct task_struct *tsk)
+{
+	if (unlikely(time_after_eq(jiffies, tsk->uid_ioac_next)))
+		uid_sys_stats_charge_io(tsk);
+}
+#else
+static inline void uid_io_account(struct task_struct *tsk)
+{
+}
+#endif
+
 #ifdef CONFIG_TASK_XACCT
 static inline void add_rchar(struct task_struct *tsk, ssize_t amt)
 {
 	tsk->ioac.rchar += amt;
+	uid_io_account(tsk);
 }
 
 static inline void add_wchar(struct task_struct *tsk, ssize_t amt)
 {
 	tsk->ioac.wchar += amt;
+	uid_io_account(tsk);
 }
 
 static inline void inc_syscr(struct task_struct *tsk)
@@ -3681,6 +3709,7 @@ static inline void inc_syscw(struct task_struct *tsk)
 static inline void inc_syscfs(struct task_struct *tsk)
 {
 	tsk->ioac.syscfs++;
+	uid_io_account(tsk);
 }
 #else
 static inline void add_rchar(struct task_struct *tsk, ssize_t amt)
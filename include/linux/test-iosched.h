@@ -31,6 +31,7 @@
 #define TEST_BIO_SIZE		PAGE_SIZE	/* use one page bios */
 
 struct test_iosched;
+struct test_bench;
 
 typedef int (prepare_test_fn) (struct test_iosched *);
 typedef int (run_test_fn) (struct test_iosched *);
@@ -90,6 +91,7 @@ struct test_debug {
 	struct dentry *debug_test_result;
 	struct dentry *start_sector;
 	struct dentry *sector_range;
+	struct dentry *debug_bench_root;
 };
 
 /**
@@ -121,6 +123,8 @@ struct test_request {
 	int is_err_expected;
 	int wr_rd_data_pattern;
 	int req_id;
+	ktime_t issue_time;
+	ktime_t complete_time;
 };
 
 /**
@@ -240,6 +244,7 @@ struct test_iosched {
 	bool ignore_round;
 	bool notified_urgent;
 	void *blk_dev_test_data;
+	struct test_bench *bench;
 };
 
 extern int test_iosched_start_test(struct test_iosched *,
@@ -55,6 +55,7 @@ struct scsi_pointer {
 
 /* for scmd->flags */
 #define SCMD_TAGGED		(1 << 0)
+#define SCMD_LAST		(1 << 1)
 
 struct scsi_cmnd {
 	struct scsi_device *device;
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * UFS host power state notifications, for users that want to batch
+ * background work (e.g. filesystem GC) into windows where the link is
+ * already up instead of waking it up on their own schedule.
+ */
+
+#ifndef _SCSI_UFS_POWER_H
+#define _SCSI_UFS_POWER_H
+
+#include <linux/notifier.h>
+
+/*
+ * Events of the notifier chain, the data argument is the struct Scsi_Host
+ * of the UFS host. Callbacks run in atomic context.
+ */
+enum ufshcd_power_event {
+	UFSHCD_POWER_AWAKE,	/* clocks ungated and link out of hibern8 */
+	UFSHCD_POWER_IDLE,	/* clocks gated after the idle timeout */
+};
+
+#if IS_ENABLED(CONFIG_SCSI_UFSHCD)
+int ufshcd_register_power_notifier(struct notifier_block *nb);
+int ufshcd_unregister_power_notifier(struct notifier_block *nb);
+#else
+static inline int ufshcd_register_power_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+static inline int ufshcd_unregister_power_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* _SCSI_UFS_POWER_H */
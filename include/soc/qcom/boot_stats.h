@@ -10,6 +10,9 @@
  * GNU General Public License for more details.
  */
 
+#ifndef __SOC_QCOM_BOOT_STATS_H
+#define __SOC_QCOM_BOOT_STATS_H
+
 #ifdef CONFIG_MSM_BOOT_STATS
 
 #define TIMER_KHZ 32768
@@ -44,11 +47,48 @@ static inline unsigned long long int msm_timer_get_sclk_ticks(void)
 static inline phys_addr_t msm_timer_get_pa(void) { return 0; }
 #endif
 
+#include <linux/ktime.h>
+
+enum boot_event_type {
+	BOOT_EV_INITCALL,
+	BOOT_EV_PROBE,
+	BOOT_EV_DEFER,
+	BOOT_EV_FIRMWARE,
+	BOOT_EV_FIRST_IO,
+};
+
+struct bio;
+
 #ifdef CONFIG_MSM_BOOT_TIME_MARKER
 
 static inline int boot_marker_enabled(void) { return 1; }
 void place_marker(const char *name);
+
+/*
+ * Boot event timeline: initcalls, probes and firmware loads slower than
+ * bootkpi's event_min_us, every deferred probe and the first I/O to each
+ * block device are recorded against the boot markers.
+ */
+extern bool boot_events_io;
+static inline ktime_t boot_event_start(void) { return ktime_get(); }
+__printf(4, 5)
+void boot_event_record(enum boot_event_type type, ktime_t start, int ret,
+		const char *fmt, ...);
+void __boot_event_bio(struct bio *bio);
+static inline void boot_event_bio(struct bio *bio)
+{
+	if (unlikely(boot_events_io))
+		__boot_event_bio(bio);
+}
 #else
 static inline void place_marker(char *name) { };
 static inline int boot_marker_enabled(void) { return 0; }
+
+static inline ktime_t boot_event_start(void) { return ktime_set(0, 0); }
+static inline __printf(4, 5)
+void boot_event_record(enum boot_event_type type, ktime_t start, int ret,
+		const char *fmt, ...) { }
+static inline void boot_event_bio(struct bio *bio) { }
 #endif
+
+#endif /* __SOC_QCOM_BOOT_STATS_H */
@@ -31,6 +31,10 @@ struct msm_rpm_kvp {
 	uint32_t length;
 	uint8_t *data;
 };
+
+#define MSM_RPM_ACK_HIST_BUCKETS	10
+#define MSM_RPM_ACK_HIST_MIN_SHIFT	5
+
 #ifdef CONFIG_MSM_RPM_SMD
 /**
  * msm_rpm_request() - Creates a parent element to identify the
@@ -163,6 +167,45 @@ int msm_rpm_wait_for_ack(uint32_t msg_id);
  */
 int msm_rpm_wait_for_ack_noirq(uint32_t msg_id);
 
+/**
+ * msm_rpm_send_requests() - Send several RPM requests back to back without
+ * waiting for any of the acknowledgments in between.
+ *
+ * @handles: the requests to send
+ * @n: number of requests
+ * @msg_ids: filled with the message id of each request, 0 if it failed
+ *
+ * returns 0 if all the requests were sent, -EIO otherwise. Pass msg_ids to
+ * msm_rpm_wait_for_acks() to wait for the whole batch, or drop them to not
+ * wait at all.
+ */
+int msm_rpm_send_requests(struct msm_rpm_request **handles, int n,
+		uint32_t *msg_ids);
+
+/**
+ * msm_rpm_wait_for_acks() - A blocking call that waits for acknowledgment of
+ * a batch of messages from RPM.
+ *
+ * @msg_ids: the message ids filled in by msm_rpm_send_requests
+ * @n: number of message ids
+ *
+ * returns 0 on success or the first errno
+ */
+int msm_rpm_wait_for_acks(const uint32_t *msg_ids, int n);
+
+/**
+ * msm_rpm_get_ack_latency_hist() - Copy the histogram of request to ack
+ * latencies. Bucket i counts latencies below 2^(i + 5) us, the last bucket
+ * counts the rest.
+ *
+ * @hist: buffer for up to MSM_RPM_ACK_HIST_BUCKETS counts
+ * @n: size of hist
+ * @clear: reset the histogram after copying it
+ *
+ * returns the number of buckets copied
+ */
+int msm_rpm_get_ack_latency_hist(u64 *hist, int n, bool clear);
+
 /**
  * msm_rpm_send_message() -Wrapper function for clients to send data given an
  * array of key value pairs.
@@ -301,6 +344,22 @@ static inline int msm_rpm_wait_for_ack_noirq(uint32_t msg_id)
 	return 0;
 }
 
+static inline int msm_rpm_send_requests(struct msm_rpm_request **handles,
+		int n, uint32_t *msg_ids)
+{
+	return 0;
+}
+
+static inline int msm_rpm_wait_for_acks(const uint32_t *msg_ids, int n)
+{
+	return 0;
+}
+
+static inline int msm_rpm_get_ack_latency_hist(u64 *hist, int n, bool clear)
+{
+	return 0;
+}
+
 static inline int __init msm_rpm_driver_init(void)
 {
 	return 0;
@@ -48,6 +48,15 @@ void *subsys_notif_register_notifier(
 int subsys_notif_unregister_notifier(void *subsys_handle,
 				struct notifier_block *nb);
 
+/* Same as subsys_notif_register_notifier, but tells the notifier that the
+ * callback does not depend on any other client of the same priority and may
+ * run concurrently with them. Clients of a higher nb->priority always finish
+ * before lower priority clients are called, so dependencies are expressed by
+ * priority.
+ */
+void *subsys_notif_register_notifier_parallel(
+			const char *subsys_name, struct notifier_block *nb);
+
 /* Use the subsys_notif_init_subsys API to initialize the notifier chains form
  * a particular subsystem. This API will return a handle that can be used to
  * queue notifications using the subsys_notif_queue_notification API by passing
@@ -71,6 +80,12 @@ static inline int subsys_notif_unregister_notifier(void *subsys_handle,
 	return 0;
 }
 
+static inline void *subsys_notif_register_notifier_parallel(
+			const char *subsys_name, struct notifier_block *nb)
+{
+	return NULL;
+}
+
 static inline void *subsys_notif_add_subsys(const char *subsys_name)
 {
 	return NULL;
@@ -9,6 +9,24 @@
 #define show_dev(dev)		MAJOR(dev), MINOR(dev)
 #define show_dev_ino(entry)	show_dev(entry->dev), (unsigned long)entry->ino
 
+#ifndef __F2FS_COST_PHASES
+#define __F2FS_COST_PHASES
+/* phases timed by the f2fs_gc_cost and f2fs_cp_cost events */
+enum f2fs_gc_phase {
+	GC_PHASE_SELECT,	/* victim selection */
+	GC_PHASE_MIGRATE,	/* moving the valid blocks of the victim */
+	GC_PHASE_CP,		/* checkpoint issued by foreground GC */
+};
+
+enum f2fs_cp_phase {
+	CP_PHASE_BLOCK_OPS,	/* flushing dirty dentries, inodes and nodes */
+	CP_PHASE_FLUSH_NAT,	/* NAT journal and dirty NAT blocks */
+	CP_PHASE_FLUSH_SIT,	/* SIT journal and dirty SIT blocks */
+	CP_PHASE_COMMIT,	/* writing and flushing the checkpoint pack */
+	CP_PHASE_STALL,		/* whole window with filesystem ops blocked */
+};
+#endif
+
 TRACE_DEFINE_ENUM(NODE);
 TRACE_DEFINE_ENUM(DATA);
 TRACE_DEFINE_ENUM(META);
@@ -48,6 +66,14 @@ TRACE_DEFINE_ENUM(CP_TRIMMED);
 TRACE_DEFINE_ENUM(CP_PAUSE);
 TRACE_DEFINE_ENUM(CP_RESIZE);
 TRACE_DEFINE_ENUM(EX_READ);
+TRACE_DEFINE_ENUM(GC_PHASE_SELECT);
+TRACE_DEFINE_ENUM(GC_PHASE_MIGRATE);
+TRACE_DEFINE_ENUM(GC_PHASE_CP);
+TRACE_DEFINE_ENUM(CP_PHASE_BLOCK_OPS);
+TRACE_DEFINE_ENUM(CP_PHASE_FLUSH_NAT);
+TRACE_DEFINE_ENUM(CP_PHASE_FLUSH_SIT);
+TRACE_DEFINE_ENUM(CP_PHASE_COMMIT);
+TRACE_DEFINE_ENUM(CP_PHASE_STALL);
 TRACE_DEFINE_ENUM(EX_BLOCK_AGE);
 
 #define show_block_type(type)						\
@@ -135,6 +161,20 @@ TRACE_DEFINE_ENUM(EX_BLOCK_AGE);
 		{ CP_PAUSE | CP_TRIMMED,	"Pause,Trimmed" },	\
 		{ CP_RESIZE,	"Resize" })
 
+#define show_gc_phase(phase)						\
+	__print_symbolic(phase,						\
+		{ GC_PHASE_SELECT,	"select" },			\
+		{ GC_PHASE_MIGRATE,	"migrate" },			\
+		{ GC_PHASE_CP,		"checkpoint" })
+
+#define show_cp_phase(phase)						\
+	__print_symbolic(phase,						\
+		{ CP_PHASE_BLOCK_OPS,	"block_ops" },			\
+		{ CP_PHASE_FLUSH_NAT,	"flush_nat" },			\
+		{ CP_PHASE_FLUSH_SIT,	"flush_sit" },			\
+		{ CP_PHASE_COMMIT,	"commit" },			\
+		{ CP_PHASE_STALL,	"stall" })
+
 #define show_fsync_cpreason(type)					\
 	__print_symbolic(type,						\
 		{ CP_NO_NEEDED,		"no needed" },			\
@@ -794,6 +834,45 @@ TRACE_EVENT(f2fs_get_victim,
 		__entry->free)
 );
 
+TRACE_EVENT(f2fs_gc_cost,
+
+	TP_PROTO(struct super_block *sb, int gc_type, int seg_type,
+			int phase, unsigned int segno, unsigned int blocks,
+			u64 delta_ns),
+
+	TP_ARGS(sb, gc_type, seg_type, phase, segno, blocks, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(dev_t,		dev)
+		__field(int,		gc_type)
+		__field(int,		seg_type)
+		__field(int,		phase)
+		__field(unsigned int,	segno)
+		__field(unsigned int,	blocks)
+		__field(u64,		delta_ns)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= sb->s_dev;
+		__entry->gc_type	= gc_type;
+		__entry->seg_type	= seg_type;
+		__entry->phase		= phase;
+		__entry->segno		= segno;
+		__entry->blocks		= blocks;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("dev = (%d,%d), %s, type = %s, phase = %s, segno = %u, "
+		"blocks = %u, time = %llu ns",
+		show_dev(__entry->dev),
+		show_gc_type(__entry->gc_type),
+		show_data_type(__entry->seg_type),
+		show_gc_phase(__entry->phase),
+		__entry->segno,
+		__entry->blocks,
+		__entry->delta_ns)
+);
+
 TRACE_EVENT(f2fs_lookup_start,
 
 	TP_PROTO(struct inode *dir, struct dentry *dentry, unsigned int flags),
@@ -1426,6 +1505,38 @@ TRACE_EVENT(f2fs_write_checkpoint,
 		__entry->msg)
 );
 
+TRACE_EVENT(f2fs_cp_cost,
+
+	TP_PROTO(struct super_block *sb, int reason, int phase,
+			unsigned int pages, u64 delta_ns),
+
+	TP_ARGS(sb, reason, phase, pages, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(dev_t,		dev)
+		__field(int,		reason)
+		__field(int,		phase)
+		__field(unsigned int,	pages)
+		__field(u64,		delta_ns)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= sb->s_dev;
+		__entry->reason		= reason;
+		__entry->phase		= phase;
+		__entry->pages		= pages;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("dev = (%d,%d), checkpoint for %s, phase = %s, "
+		"pages = %u, time = %llu ns",
+		show_dev(__entry->dev),
+		show_cpreason(__entry->reason),
+		show_cp_phase(__entry->phase),
+		__entry->pages,
+		__entry->delta_ns)
+);
+
 DECLARE_EVENT_CLASS(f2fs_discard,
 
 	TP_PROTO(struct block_device *dev, block_t blkstart, block_t blklen),
@@ -99,6 +99,42 @@ TRACE_EVENT(irq_handler_exit,
 		  __entry->irq, __entry->ret ? "handled" : "unhandled")
 );
 
+/**
+ * irq_balance_move - called when the IRQ balancer moves an interrupt
+ * @irq: irq number
+ * @from: CPU the interrupt was targeting
+ * @to: CPU the interrupt now targets
+ * @rate: interrupts per second over the last sampling period
+ * @load: per mille of the period spent in the handlers
+ */
+TRACE_EVENT(irq_balance_move,
+
+	TP_PROTO(int irq, int from, int to, unsigned int rate,
+		 unsigned int load),
+
+	TP_ARGS(irq, from, to, rate, load),
+
+	TP_STRUCT__entry(
+		__field(	int,		irq	)
+		__field(	int,		from	)
+		__field(	int,		to	)
+		__field(	unsigned int,	rate	)
+		__field(	unsigned int,	load	)
+	),
+
+	TP_fast_assign(
+		__entry->irq	= irq;
+		__entry->from	= from;
+		__entry->to	= to;
+		__entry->rate	= rate;
+		__entry->load	= load;
+	),
+
+	TP_printk("irq=%d from=%d to=%d rate=%u load=%u",
+		  __entry->irq, __entry->from, __entry->to,
+		  __entry->rate, __entry->load)
+);
+
 DECLARE_EVENT_CLASS(softirq,
 
 	TP_PROTO(unsigned int vec_nr),
@@ -0,0 +1,51 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rtmutex
+
+#if !defined(_TRACE_RTMUTEX_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_RTMUTEX_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Emitted when a task got an rt_mutex after blocking on an owner of lower
+ * priority, i.e. after a priority inversion was resolved by boosting.
+ * The prios are kernel prios, lower is more important.
+ */
+TRACE_EVENT(rt_mutex_inversion,
+
+	TP_PROTO(struct rt_mutex *lock, pid_t owner_pid,
+		 const char *owner_comm, int owner_prio, u64 delta_ns),
+
+	TP_ARGS(lock, owner_pid, owner_comm, owner_prio, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(void *, lock)
+		__field(pid_t, pid)
+		__field(int, prio)
+		__array(char, owner_comm, TASK_COMM_LEN)
+		__field(pid_t, owner_pid)
+		__field(int, owner_prio)
+		__field(u64, delta_ns)
+	),
+
+	TP_fast_assign(
+		__entry->lock = lock;
+		__entry->pid = current->pid;
+		__entry->prio = current->prio;
+		memcpy(__entry->owner_comm, owner_comm, TASK_COMM_LEN);
+		__entry->owner_pid = owner_pid;
+		__entry->owner_prio = owner_prio;
+		__entry->delta_ns = delta_ns;
+	),
+
+	TP_printk("lock=%p pid=%d prio=%d owner=%s/%d owner_prio=%d delta_ns=%llu",
+		  __entry->lock, __entry->pid, __entry->prio,
+		  __entry->owner_comm, __entry->owner_pid, __entry->owner_prio,
+		  (unsigned long long)__entry->delta_ns)
+);
+
+#endif /* _TRACE_RTMUTEX_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -222,6 +222,55 @@ TRACE_EVENT(cluster_pred_select,
 		__entry->latency, __entry->pred, __entry->pred_us)
 );
 
+TRACE_EVENT(cluster_irq_pred,
+
+	TP_PROTO(const char *name, unsigned int irq, u32 sleep_us, u32 irq_us),
+
+	TP_ARGS(name, irq, sleep_us, irq_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(unsigned int, irq)
+		__field(u32, sleep_us)
+		__field(u32, irq_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->irq = irq;
+		__entry->sleep_us = sleep_us;
+		__entry->irq_us = irq_us;
+	),
+
+	TP_printk("name:%s irq:%u sleep_time:%u irq_us:%u",
+		__entry->name, __entry->irq, __entry->sleep_us,
+		__entry->irq_us)
+);
+
+TRACE_EVENT(cluster_irq_pred_exit,
+
+	TP_PROTO(const char *name, unsigned int irq, int idx, s64 err_us),
+
+	TP_ARGS(name, irq, idx, err_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(unsigned int, irq)
+		__field(int, idx)
+		__field(s64, err_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->irq = irq;
+		__entry->idx = idx;
+		__entry->err_us = err_us;
+	),
+
+	TP_printk("name:%s irq:%u idx:%d err_us:%lld",
+		__entry->name, __entry->irq, __entry->idx, __entry->err_us)
+);
+
 TRACE_EVENT(cluster_pred_hist,
 
 	TP_PROTO(const char *name, int idx, u32 resi,
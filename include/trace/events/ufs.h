@@ -92,6 +92,36 @@ TRACE_EVENT(ufshcd_clk_scaling,
 		__entry->prev_state, __entry->curr_state)
 );
 
+TRACE_EVENT(ufshcd_io_predict,
+
+	TP_PROTO(const char *dev_name, const char *decision, u32 burst_len,
+		u32 burst_avg, u32 gap_avg_us, unsigned long val),
+
+	TP_ARGS(dev_name, decision, burst_len, burst_avg, gap_avg_us, val),
+
+	TP_STRUCT__entry(
+		__string(dev_name, dev_name)
+		__string(decision, decision)
+		__field(u32, burst_len)
+		__field(u32, burst_avg)
+		__field(u32, gap_avg_us)
+		__field(unsigned long, val)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev_name, dev_name);
+		__assign_str(decision, decision);
+		__entry->burst_len = burst_len;
+		__entry->burst_avg = burst_avg;
+		__entry->gap_avg_us = gap_avg_us;
+		__entry->val = val;
+	),
+
+	TP_printk("%s: %s: burst %u (avg %u) gap avg %u us, val %lu",
+		__get_str(dev_name), __get_str(decision), __entry->burst_len,
+		__entry->burst_avg, __entry->gap_avg_us, __entry->val)
+);
+
 DECLARE_EVENT_CLASS(ufshcd_profiling_template,
 	TP_PROTO(const char *dev_name, const char *profile_info, s64 time_us,
 		 int err),
@@ -20,6 +20,7 @@
 		{I_SYNC,		"I_SYNC"},		\
 		{I_DIRTY_TIME,		"I_DIRTY_TIME"},	\
 		{I_DIRTY_TIME_EXPIRED,	"I_DIRTY_TIME_EXPIRED"}, \
+		{I_DIRTY_FG,		"I_DIRTY_FG"},		\
 		{I_REFERENCED,		"I_REFERENCED"}		\
 	)
 
@@ -144,6 +144,36 @@ DEFINE_EVENT(msm_lmh_dcvs_print, lmh_dcvs_freq,
 	TP_ARGS(cpu, max_freq)
 );
 
+TRACE_EVENT(lmh_dcvs_throttle,
+
+	TP_PROTO(int cpu, unsigned int limit, unsigned int max_freq,
+		u64 throttled_us, u64 lost_mhz_ms),
+
+	TP_ARGS(cpu, limit, max_freq, throttled_us, lost_mhz_ms),
+
+	TP_STRUCT__entry(
+		__field(int, cpu)
+		__field(unsigned int, limit)
+		__field(unsigned int, max_freq)
+		__field(u64, throttled_us)
+		__field(u64, lost_mhz_ms)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->limit = limit;
+		__entry->max_freq = max_freq;
+		__entry->throttled_us = throttled_us;
+		__entry->lost_mhz_ms = lost_mhz_ms;
+	),
+
+	TP_printk(
+		"cpu:%d limit:%u max:%u throttled_us:%llu lost_mhz_ms:%llu",
+		__entry->cpu, __entry->limit, __entry->max_freq,
+		__entry->throttled_us, __entry->lost_mhz_ms
+	)
+);
+
 #elif defined(TRACE_MSM_THERMAL)
 
 DECLARE_EVENT_CLASS(msm_thermal_post_core_ctl,
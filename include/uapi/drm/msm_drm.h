@@ -273,7 +273,25 @@ struct drm_msm_gem_submit_bo {
 #define MSM_SUBMIT_RING_MASK 0x000F0000
 #define MSM_SUBMIT_RING_SHIFT 16
 
-#define MSM_SUBMIT_FLAGS (MSM_SUBMIT_RING_MASK)
+/*
+ * BO_CACHE - the submitqueue keeps the buffer table of this submit pinned.
+ *      When the next BO_CACHE submit on the queue passes the same handles
+ *      and flags, the per buffer lookup and pinning is skipped, and if all
+ *      presumed addresses are still correct the relocs are not processed.
+ */
+#define MSM_SUBMIT_BO_CACHE  0x00100000
+
+#define MSM_SUBMIT_FLAGS (MSM_SUBMIT_RING_MASK | MSM_SUBMIT_BO_CACHE)
+
+/* Time spent in each phase of a submit, in nanoseconds */
+struct drm_msm_gem_submit_timings {
+	__u64 lookup_ns;      /* out, buffer table lookup */
+	__u64 validate_ns;    /* out, buffer locking */
+	__u64 cmds_ns;        /* out, cmd validation and relocs */
+	__u64 submit_ns;      /* out, ringbuffer submission */
+	__u32 cached;         /* out, 1 if the cached buffer table was used */
+	__u32 relocs_skipped; /* out, 1 if reloc processing was skipped */
+};
 
 /* Each cmdstream submit consists of a table of buffers involved, and
  * one or more cmdstream buffers.  This allows for conditional execution
@@ -288,6 +306,7 @@ struct drm_msm_gem_submit {
 	__u64 cmds;    /* in, ptr to array of submit_cmd's */
 	__s32 fence_fd;       /* gap for the fence_fd which is upstream */
 	__u32 queueid;         /* in, submitqueue id */
+	__u64 timings;  /* in, optional ptr to drm_msm_gem_submit_timings */
 };
 
 /*
@@ -422,6 +441,28 @@ struct drm_msm_gem_sync {
 	__u64 __user ops;
 };
 
+/*
+ * madvise provides a way to tell the kernel in case a buffers contents
+ * can be discarded under memory pressure, which is useful for userspace
+ * bo cache where we want to optimistically hold on to buffer allocate
+ * and potential mmap, but allow the pages to be discarded under memory
+ * pressure.
+ *
+ * Typical usage would involve madvise(DONTNEED) when buffer enters BO
+ * cache, and madvise(WILLNEED) if trying to recycle buffer from BO cache.
+ * In the WILLNEED case, 'retained' indicates to userspace whether the
+ * backing pages still exist.
+ */
+#define MSM_MADV_WILLNEED 0       /* backing pages are needed, status returned in 'retained' */
+#define MSM_MADV_DONTNEED 1       /* backing pages not needed */
+#define __MSM_MADV_PURGED 2       /* internal state */
+
+struct drm_msm_gem_madvise {
+	__u32 handle;         /* in, GEM handle */
+	__u32 madv;           /* in, MSM_MADV_x */
+	__u32 retained;       /* out, whether backing store still exists */
+};
+
 /*
  * Draw queues allow the user to set specific submission parameter. Command
  * submissions will specify a specific submit queue id to use. id '0' is
@@ -462,7 +503,7 @@ struct drm_msm_submitqueue_query {
 #define DRM_MSM_GEM_CPU_FINI           0x05
 #define DRM_MSM_GEM_SUBMIT             0x06
 #define DRM_MSM_WAIT_FENCE             0x07
-/* Gap for upstream DRM_MSM_GEM_MADVISE */
+#define DRM_MSM_GEM_MADVISE            0x08
 #define DRM_MSM_GEM_SVM_NEW            0x09
 #define DRM_MSM_SUBMITQUEUE_NEW        0x0A
 #define DRM_MSM_SUBMITQUEUE_CLOSE      0x0B
@@ -492,6 +533,7 @@ struct drm_msm_submitqueue_query {
 #define DRM_IOCTL_MSM_GEM_CPU_FINI     DRM_IOW (DRM_COMMAND_BASE + DRM_MSM_GEM_CPU_FINI, struct drm_msm_gem_cpu_fini)
 #define DRM_IOCTL_MSM_GEM_SUBMIT       DRM_IOWR(DRM_COMMAND_BASE + DRM_MSM_GEM_SUBMIT, struct drm_msm_gem_submit)
 #define DRM_IOCTL_MSM_WAIT_FENCE       DRM_IOW (DRM_COMMAND_BASE + DRM_MSM_WAIT_FENCE, struct drm_msm_wait_fence)
+#define DRM_IOCTL_MSM_GEM_MADVISE      DRM_IOWR(DRM_COMMAND_BASE + DRM_MSM_GEM_MADVISE, struct drm_msm_gem_madvise)
 #define DRM_IOCTL_SDE_WB_CONFIG \
 	DRM_IOW((DRM_COMMAND_BASE + DRM_SDE_WB_CONFIG), struct sde_drm_wb_cfg)
 #define DRM_IOCTL_MSM_REGISTER_EVENT   DRM_IOW((DRM_COMMAND_BASE + \
@@ -44,6 +44,14 @@ enum {
 	IOCB_CMD_NOOP = 6,
 	IOCB_CMD_PREADV = 7,
 	IOCB_CMD_PWRITEV = 8,
+
+	/*
+	 * Register, once per context, the files ("aio_buf" points to an
+	 * array of "aio_nbytes" __s32 descriptors) or the buffers (an array
+	 * of "aio_nbytes" struct iovec) used by IOCB_FLAG_FIXED_* iocbs.
+	 */
+	IOCB_CMD_REGISTER_FILES = 9,
+	IOCB_CMD_REGISTER_BUFFERS = 10,
 };
 
 /*
@@ -51,8 +59,14 @@ enum {
  *
  * IOCB_FLAG_RESFD - Set if the "aio_resfd" member of the "struct iocb"
  *                   is valid.
+ * IOCB_FLAG_FIXED_FILE - Set if "aio_fildes" is an index in the files
+ *                        registered with IOCB_CMD_REGISTER_FILES.
+ * IOCB_FLAG_FIXED_BUF - Set if "aio_buf" lies within one of the buffers
+ *                       registered with IOCB_CMD_REGISTER_BUFFERS.
  */
 #define IOCB_FLAG_RESFD		(1 << 0)
+#define IOCB_FLAG_FIXED_FILE	(1 << 1)
+#define IOCB_FLAG_FIXED_BUF	(1 << 2)
 
 /* read() from /dev/aio returns these structures. */
 struct io_event {
@@ -374,6 +374,7 @@ enum fuse_notify_code {
 	FUSE_NOTIFY_STORE = 4,
 	FUSE_NOTIFY_RETRIEVE = 5,
 	FUSE_NOTIFY_DELETE = 6,
+	FUSE_NOTIFY_INVAL_BATCH = 7,
 	FUSE_NOTIFY_CODE_MAX,
 };
 
@@ -734,6 +735,32 @@ struct fuse_notify_delete_out {
 	uint32_t	padding;
 };
 
+/*
+ * FUSE_NOTIFY_INVAL_BATCH: a fuse_notify_inval_batch_out header followed
+ * by 'count' records.  Each record is a fuse_notify_inval_rec with 'code'
+ * set to FUSE_NOTIFY_INVAL_INODE or FUSE_NOTIFY_INVAL_ENTRY.  Entry
+ * records are followed by the name and a terminating NUL.  Every record
+ * is padded to a multiple of 8 bytes, see FUSE_INVAL_REC_SIZE().
+ */
+struct fuse_notify_inval_batch_out {
+	uint32_t	count;
+	uint32_t	padding;
+};
+
+struct fuse_notify_inval_rec {
+	uint32_t	code;
+	uint32_t	namelen;
+	uint64_t	nodeid;		/* inode, or parent for entries */
+	int64_t		off;
+	int64_t		len;
+};
+
+#define FUSE_INVAL_REC_ALIGN(x) \
+	(((x) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+#define FUSE_INVAL_REC_SIZE(r) \
+	FUSE_INVAL_REC_ALIGN(sizeof(struct fuse_notify_inval_rec) + \
+		((r)->code == FUSE_NOTIFY_INVAL_ENTRY ? (r)->namelen + 1 : 0))
+
 struct fuse_notify_store_out {
 	uint64_t	nodeid;
 	uint64_t	offset;
@@ -761,5 +788,6 @@ struct fuse_notify_retrieve_in {
 
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+#define FUSE_DEV_IOC_BIND_CPU	_IOR(229, 1, uint32_t)
 
 #endif /* _LINUX_FUSE_H */
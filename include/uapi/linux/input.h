@@ -222,6 +222,36 @@ struct input_mask {
 
 #define EVIOCSCLOCKID		_IOW('E', 0xa0, int)			/* Set clockid to be used for timestamps */
 
+/**
+ * EVIOCGRINGSIZE - Retrieve the length to mmap() for the event ring
+ *
+ * Instead of read(), a client can mmap() that many bytes of its evdev file
+ * descriptor at offset 0 and consume events straight from the kernel's
+ * queue. The mapping starts with a struct input_event_ring and the events
+ * follow at @offset. Once mapped, read() fails with EINVAL and events only
+ * arrive through the ring; poll() and SIGIO work as before.
+ *
+ * @head and @tail count events and wrap freely, event n lives at index
+ * (n & (@bufsize - 1)). The kernel moves @head past complete packets only,
+ * userspace moves @tail past the events it consumed and must not write
+ * any other field. When the ring is full new events are discarded, the
+ * packet being queued is dropped, @dropped is incremented and an
+ * EV_SYN/SYN_DROPPED is queued as soon as there is room again.
+ *
+ * Only native 64-bit time layouts are supported, compat tasks get EINVAL
+ * from mmap().
+ */
+#define EVIOCGRINGSIZE		_IOR('E', 0xa1, int)			/* Get size of the mmap() event ring */
+
+struct input_event_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 bufsize;
+	__u32 offset;
+	__u32 dropped;
+	__u32 reserved[3];
+};
+
 /*
  * IDs.
  */
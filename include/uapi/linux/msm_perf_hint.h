@@ -0,0 +1,56 @@
+#ifndef _UAPI_MSM_PERF_HINT_H_
+#define _UAPI_MSM_PERF_HINT_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define MSM_PERF_HINT_MAX_FREQ		8
+
+/* Enable scheduler boost while the hint is held */
+#define MSM_PERF_HINT_SCHED_BOOST	0x1
+
+/*
+ * struct msm_perf_freq_hint: frequency limits for the cluster of @cpu
+ * @cpu - any cpu of the cluster
+ * @min_freq - floor in kHz, 0 for none
+ * @max_freq - ceiling in kHz, 0 for none
+ */
+struct msm_perf_freq_hint {
+	__u32	cpu;
+	__u32	min_freq;
+	__u32	max_freq;
+};
+
+/*
+ * struct msm_perf_hint_req: a bundle of hints applied at once
+ * @duration_ms - release the hint after this long, 0 to hold it until
+ *		  released or the file is closed
+ * @flags - MSM_PERF_HINT_* flags
+ * @idle_latency_us - keep out of idle states with a longer exit latency,
+ *		      0 for no constraint
+ * @nr_freq - number of valid entries in @freq
+ * @freq - per cluster frequency limits
+ * @bus_ab - average CPU to DDR bandwidth vote in bytes/s
+ * @bus_ib - instantaneous CPU to DDR bandwidth vote in bytes/s
+ * @handle - returned by MSM_PERF_IOC_HINT_ACQUIRE
+ */
+struct msm_perf_hint_req {
+	__u32	duration_ms;
+	__u32	flags;
+	__u32	idle_latency_us;
+	__u32	nr_freq;
+	struct msm_perf_freq_hint freq[MSM_PERF_HINT_MAX_FREQ];
+	__u64	bus_ab;
+	__u64	bus_ib;
+	__s32	handle;
+	__u32	reserved;
+};
+
+#define MSM_PERF_IOC_MAGIC	0x9A
+
+#define MSM_PERF_IOC_HINT_ACQUIRE \
+	_IOWR(MSM_PERF_IOC_MAGIC, 1, struct msm_perf_hint_req)
+#define MSM_PERF_IOC_HINT_RELEASE \
+	_IOW(MSM_PERF_IOC_MAGIC, 2, __s32)
+
+#endif /* _UAPI_MSM_PERF_HINT_H_ */
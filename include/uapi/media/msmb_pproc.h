@@ -16,6 +16,7 @@
 #define MSM_CPP_MAX_FRAME_LENGTH 4096
 #define MSM_CPP_MAX_FW_NAME_LEN 32
 #define MAX_FREQ_TBL 10
+#define MSM_CPP_MAX_BATCH_FRAMES 8
 #define MSM_OUTPUT_BUF_CNT 8
 
 enum msm_cpp_frame_type {
@@ -240,6 +241,14 @@ struct msm_cpp_clock_settings_t {
 #define VIDIOC_MSM_CPP_DELETE_STREAM_BUFF\
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 20, struct msm_camera_v4l2_ioctl_t)
 
+/*
+ * ioctl_ptr points to an array of MSM_CPP_MAX_BATCH_FRAMES or fewer
+ * struct msm_cpp_frame_info_t pointers, len is the size of that array.
+ * trans_code returns the number of frames queued.
+ */
+#define VIDIOC_MSM_CPP_CFG_BATCH \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 21, struct msm_camera_v4l2_ioctl_t)
+
 
 #define V4L2_EVENT_CPP_FRAME_DONE  (V4L2_EVENT_PRIVATE_START + 0)
 #define V4L2_EVENT_VPE_FRAME_DONE  (V4L2_EVENT_PRIVATE_START + 1)
@@ -1,7 +1,7 @@
 #ifndef UAPI_UFS_H_
 #define UAPI_UFS_H_
 
-#define MAX_QUERY_IDN	0x12
+#define MAX_QUERY_IDN	0x20
 
 /* Flag idn for Query Requests*/
 enum flag_idn {
@@ -14,6 +14,9 @@ enum flag_idn {
 	QUERY_FLAG_IDN_RESERVED2		= 0x07,
 	QUERY_FLAG_IDN_FPHYRESOURCEREMOVAL      = 0x08,
 	QUERY_FLAG_IDN_BUSY_RTC			= 0x09,
+	QUERY_FLAG_IDN_WB_EN			= 0x0E,
+	QUERY_FLAG_IDN_WB_BUFF_FLUSH_EN		= 0x0F,
+	QUERY_FLAG_IDN_WB_BUFF_FLUSH_DURING_HIBERN8	= 0x10,
 };
 
 /* Attribute idn for Query requests */
@@ -36,6 +39,10 @@ enum attr_idn {
 	QUERY_ATTR_IDN_SECONDS_PASSED		= 0x0F,
 	QUERY_ATTR_IDN_CNTX_CONF		= 0x10,
 	QUERY_ATTR_IDN_CORR_PRG_BLK_NUM		= 0x11,
+	QUERY_ATTR_IDN_WB_FLUSH_STATUS		= 0x1C,
+	QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE	= 0x1D,
+	QUERY_ATTR_IDN_WB_BUFF_LIFE_TIME_EST	= 0x1E,
+	QUERY_ATTR_IDN_CURR_WB_BUFF_SIZE	= 0x1F,
 };
 
 #define QUERY_ATTR_IDN_BOOT_LU_EN_MAX	0x02
@@ -787,16 +787,19 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
+	ktime_t start;
 	int ret;
 	char msgbuf[64];
 
 	if (initcall_blacklisted(fn))
 		return -EPERM;
 
+	start = boot_event_start();
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
 	else
 		ret = fn();
+	boot_event_record(BOOT_EV_INITCALL, start, ret, "%pf", fn);
 
 	msgbuf[0] = 0;
 
@@ -32,6 +32,7 @@ struct bpf_htab {
 	atomic_t count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
 	u32 elem_size;	/* size of each element in bytes */
+	u32 __percpu *lru_hand;	/* per-cpu eviction position of LRU maps */
 };
 
 enum extra_elem_state {
@@ -57,6 +58,7 @@ struct htab_elem {
 		enum extra_elem_state state;
 	};
 	u32 hash;
+	u8 ref;		/* LRU maps: used since the last eviction sweep */
 	char key[0] __aligned(8);
 };
 
@@ -154,8 +156,9 @@ static int alloc_extra_elems(struct bpf_htab *htab)
 static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 {
 	bool percpu = attr->map_type == BPF_MAP_TYPE_PERCPU_HASH;
+	bool lru = attr->map_type == BPF_MAP_TYPE_LRU_HASH;
 	struct bpf_htab *htab;
-	int err, i;
+	int err, i, cpu;
 	u64 cost;
 
 	BUILD_BUG_ON(offsetof(struct htab_elem, htab) !=
@@ -167,6 +170,10 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		/* reserved bits should not be used */
 		return ERR_PTR(-EINVAL);
 
+	if (lru && (attr->map_flags & BPF_F_NO_PREALLOC))
+		/* LRU maps evict from the preallocated elements */
+		return ERR_PTR(-EINVAL);
+
 	htab = kzalloc(sizeof(*htab), GFP_USER);
 	if (!htab)
 		return ERR_PTR(-ENOMEM);
@@ -252,6 +259,16 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		raw_spin_lock_init(&htab->buckets[i].lock);
 	}
 
+	if (lru) {
+		htab->lru_hand = alloc_percpu(u32);
+		if (!htab->lru_hand)
+			goto free_buckets;
+		/* spread the cpus over the table */
+		for_each_possible_cpu(cpu)
+			*per_cpu_ptr(htab->lru_hand, cpu) =
+				div_u64((u64)cpu * htab->n_buckets, nr_cpu_ids);
+	}
+
 	if (!percpu) {
 		err = alloc_extra_elems(htab);
 		if (err)
@@ -269,6 +286,7 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 free_extra_elems:
 	free_percpu(htab->extra_elems);
 free_buckets:
+	free_percpu(htab->lru_hand);
 	bpf_map_area_free(htab->buckets);
 free_htab:
 	kfree(htab);
@@ -494,6 +512,7 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 		l_new->state = HTAB_NOT_AN_EXTRA_ELEM;
 	}
 
+	l_new->ref = 0;
 	memcpy(l_new->key, key, key_size);
 	if (percpu) {
 		/* round up value_size to 8 bytes */
@@ -547,6 +566,52 @@ static int check_flags(struct bpf_htab *htab, struct htab_elem *l_old,
 	return 0;
 }
 
+/*
+ * LRU maps: when no element is left, take one back from the table. Each
+ * cpu sweeps the buckets from its own position like a clock hand, giving
+ * elements used since the last sweep a second chance. Buckets other than
+ * the one already @locked by the caller are only trylocked, so that two
+ * cpus evicting from each other's buckets can't deadlock.
+ */
+static struct htab_elem *htab_lru_evict(struct bpf_htab *htab,
+					struct bucket *locked,
+					struct htab_elem *keep)
+{
+	u32 *hand = this_cpu_ptr(htab->lru_hand);
+	struct hlist_nulls_node *n;
+	struct htab_elem *l, *victim;
+	unsigned long flags;
+	struct bucket *b;
+	u32 scanned;
+
+	for (scanned = 0; scanned < 2 * htab->n_buckets; scanned++) {
+		b = &htab->buckets[(*hand)++ & (htab->n_buckets - 1)];
+		if (b != locked && !raw_spin_trylock_irqsave(&b->lock, flags))
+			continue;
+
+		victim = NULL;
+		hlist_nulls_for_each_entry(l, n, &b->head, hash_node) {
+			if (l == keep || l->state == HTAB_EXTRA_ELEM_USED)
+				continue;
+			if (l->ref) {
+				l->ref = 0;
+				continue;
+			}
+			victim = l;
+			break;
+		}
+		if (victim)
+			hlist_nulls_del_rcu(&victim->hash_node);
+
+		if (b != locked)
+			raw_spin_unlock_irqrestore(&b->lock, flags);
+		if (victim)
+			return victim;
+	}
+
+	return NULL;
+}
+
 /* Called from syscall or from eBPF program */
 static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 				u64 map_flags)
@@ -583,6 +648,15 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 
 	l_new = alloc_htab_elem(htab, key, value, key_size, hash, false, false,
 				!!l_old);
+	if (l_new == ERR_PTR(-E2BIG) && htab->lru_hand) {
+		struct htab_elem *victim = htab_lru_evict(htab, b, l_old);
+
+		if (victim) {
+			pcpu_freelist_push(&htab->freelist, &victim->fnode);
+			l_new = alloc_htab_elem(htab, key, value, key_size,
+						hash, false, false, !!l_old);
+		}
+	}
 	if (IS_ERR(l_new)) {
 		/* all pre-allocated elements are in use or memory exhausted */
 		ret = PTR_ERR(l_new);
@@ -747,6 +821,7 @@ static void htab_map_free(struct bpf_map *map)
 		pcpu_freelist_destroy(&htab->freelist);
 	}
 	free_percpu(htab->extra_elems);
+	free_percpu(htab->lru_hand);
 	bpf_map_area_free(htab->buckets);
 	kfree(htab);
 }
@@ -765,6 +840,34 @@ static struct bpf_map_type_list htab_type __read_mostly = {
 	.type = BPF_MAP_TYPE_HASH,
 };
 
+/* Called from syscall or from eBPF program, marks the element as used */
+static void *htab_lru_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct htab_elem *l = __htab_map_lookup_elem(map, key);
+
+	if (l) {
+		if (!l->ref)
+			l->ref = 1;
+		return l->key + round_up(map->key_size, 8);
+	}
+
+	return NULL;
+}
+
+static const struct bpf_map_ops htab_lru_ops = {
+	.map_alloc = htab_map_alloc,
+	.map_free = htab_map_free,
+	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_elem = htab_lru_map_lookup_elem,
+	.map_update_elem = htab_map_update_elem,
+	.map_delete_elem = htab_map_delete_elem,
+};
+
+static struct bpf_map_type_list htab_lru_type __read_mostly = {
+	.ops = &htab_lru_ops,
+	.type = BPF_MAP_TYPE_LRU_HASH,
+};
+
 /* Called from eBPF program */
 static void *htab_percpu_map_lookup_elem(struct bpf_map *map, void *key)
 {
@@ -835,6 +938,7 @@ static int __init register_htab_map(void)
 {
 	bpf_register_map_type(&htab_type);
 	bpf_register_map_type(&htab_percpu_type);
+	bpf_register_map_type(&htab_lru_type);
 	return 0;
 }
 late_initcall(register_htab_map);
@@ -346,13 +346,45 @@ int __weak bpf_stackmap_copy(struct bpf_map *map, void *key, void *value)
 /* last field in 'union bpf_attr' used by this command */
 #define BPF_MAP_LOOKUP_ELEM_LAST_FIELD value
 
+/* size of the value as seen by user space */
+static u32 bpf_map_value_size(struct bpf_map *map)
+{
+	if (map->map_type == BPF_MAP_TYPE_PERCPU_HASH ||
+	    map->map_type == BPF_MAP_TYPE_PERCPU_ARRAY)
+		return round_up(map->value_size, 8) * num_possible_cpus();
+	return map->value_size;
+}
+
+static int bpf_map_copy_value(struct bpf_map *map, void *key, void *value)
+{
+	void *ptr;
+	int err;
+
+	if (map->map_type == BPF_MAP_TYPE_PERCPU_HASH) {
+		err = bpf_percpu_hash_copy(map, key, value);
+	} else if (map->map_type == BPF_MAP_TYPE_PERCPU_ARRAY) {
+		err = bpf_percpu_array_copy(map, key, value);
+	} else if (map->map_type == BPF_MAP_TYPE_STACK_TRACE) {
+		err = bpf_stackmap_copy(map, key, value);
+	} else {
+		rcu_read_lock();
+		ptr = map->ops->map_lookup_elem(map, key);
+		if (ptr)
+			memcpy(value, ptr, map->value_size);
+		rcu_read_unlock();
+		err = ptr ? 0 : -ENOENT;
+	}
+
+	return err;
+}
+
 static int map_lookup_elem(union bpf_attr *attr)
 {
 	void __user *ukey = u64_to_ptr(attr->key);
 	void __user *uvalue = u64_to_ptr(attr->value);
 	int ufd = attr->map_fd;
 	struct bpf_map *map;
-	void *key, *value, *ptr;
+	void *key, *value;
 	u32 value_size;
 	struct fd f;
 	int err;
@@ -379,32 +411,14 @@ static int map_lookup_elem(union bpf_attr *attr)
 	if (copy_from_user(key, ukey, map->key_size) != 0)
 		goto free_key;
 
-	if (map->map_type == BPF_MAP_TYPE_PERCPU_HASH ||
-	    map->map_type == BPF_MAP_TYPE_PERCPU_ARRAY)
-		value_size = round_up(map->value_size, 8) * num_possible_cpus();
-	else
-		value_size = map->value_size;
+	value_size = bpf_map_value_size(map);
 
 	err = -ENOMEM;
 	value = kmalloc(value_size, GFP_USER | __GFP_NOWARN);
 	if (!value)
 		goto free_key;
 
-	if (map->map_type == BPF_MAP_TYPE_PERCPU_HASH) {
-		err = bpf_percpu_hash_copy(map, key, value);
-	} else if (map->map_type == BPF_MAP_TYPE_PERCPU_ARRAY) {
-		err = bpf_percpu_array_copy(map, key, value);
-	} else if (map->map_type == BPF_MAP_TYPE_STACK_TRACE) {
-		err = bpf_stackmap_copy(map, key, value);
-	} else {
-		rcu_read_lock();
-		ptr = map->ops->map_lookup_elem(map, key);
-		if (ptr)
-			memcpy(value, ptr, value_size);
-		rcu_read_unlock();
-		err = ptr ? 0 : -ENOENT;
-	}
-
+	err = bpf_map_copy_value(map, key, value);
 	if (err)
 		goto free_value;
 
@@ -619,6 +633,181 @@ err_put:
 	return err;
 }
 
+#define BPF_MAP_BATCH_LAST_FIELD batch
+
+static int map_delete_one(struct bpf_map *map, void *key)
+{
+	int err;
+
+	preempt_disable();
+	__this_cpu_inc(bpf_prog_active);
+	rcu_read_lock();
+	err = map->ops->map_delete_elem(map, key);
+	rcu_read_unlock();
+	__this_cpu_dec(bpf_prog_active);
+	preempt_enable();
+
+	return err;
+}
+
+/*
+ * Walk the map with map_get_next_key() and copy up to batch.count keys and
+ * values out in one call, deleting them as well if @do_delete. The last key
+ * is stored to batch.out_batch so that the next call can continue from it
+ * through batch.in_batch. -ENOENT means the end of the map was reached,
+ * batch.count always tells how many elements were copied.
+ */
+static int map_lookup_batch(union bpf_attr *attr,
+			    union bpf_attr __user *uattr, bool do_delete)
+{
+	void __user *uin = u64_to_ptr(attr->batch.in_batch);
+	void __user *uout = u64_to_ptr(attr->batch.out_batch);
+	void __user *ukeys = u64_to_ptr(attr->batch.keys);
+	void __user *uvalues = u64_to_ptr(attr->batch.values);
+	u32 max_count = attr->batch.count;
+	void *buf, *prev_key, *key, *value;
+	struct bpf_map *map;
+	u32 value_size, cp;
+	struct fd f;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_BATCH) || attr->batch.elem_flags ||
+	    attr->batch.flags)
+		return -EINVAL;
+
+	f = fdget(attr->batch.map_fd);
+	map = __bpf_map_get(f);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	if (!(f.file->f_mode & FMODE_CAN_READ) ||
+	    (do_delete && !(f.file->f_mode & FMODE_CAN_WRITE))) {
+		err = -EPERM;
+		goto err_put;
+	}
+
+	value_size = bpf_map_value_size(map);
+
+	err = -ENOMEM;
+	buf = kmalloc(2 * map->key_size + value_size, GFP_USER | __GFP_NOWARN);
+	if (!buf)
+		goto err_put;
+	prev_key = buf;
+	key = buf + map->key_size;
+	value = key + map->key_size;
+
+	if (uin) {
+		err = -EFAULT;
+		if (copy_from_user(prev_key, uin, map->key_size) != 0)
+			goto free_buf;
+	} else {
+		prev_key = NULL;
+	}
+
+	err = 0;
+	for (cp = 0; cp < max_count;) {
+		rcu_read_lock();
+		err = map->ops->map_get_next_key(map, prev_key, key);
+		rcu_read_unlock();
+		if (err)
+			break;
+
+		err = bpf_map_copy_value(map, key, value);
+		if (err == -ENOENT)
+			goto next_key;	/* deleted under us */
+		if (err)
+			break;
+
+		err = -EFAULT;
+		if (copy_to_user(ukeys + cp * map->key_size, key,
+				 map->key_size) ||
+		    copy_to_user(uvalues + cp * value_size, value, value_size))
+			break;
+
+		if (do_delete) {
+			err = map_delete_one(map, key);
+			if (err)
+				break;
+		}
+		cp++;
+next_key:
+		/* the new key becomes the one to continue from */
+		prev_key = buf;
+		memcpy(prev_key, key, map->key_size);
+		err = 0;
+
+		if (fatal_signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+		cond_resched();
+	}
+
+	if (prev_key && uout &&
+	    copy_to_user(uout, prev_key, map->key_size))
+		err = -EFAULT;
+	if (put_user(cp, &uattr->batch.count))
+		err = -EFAULT;
+
+free_buf:
+	kfree(buf);
+err_put:
+	fdput(f);
+	return err;
+}
+
+/* delete the batch.count keys found at batch.keys */
+static int map_delete_batch(union bpf_attr *attr,
+			    union bpf_attr __user *uattr)
+{
+	void __user *ukeys = u64_to_ptr(attr->batch.keys);
+	struct bpf_map *map;
+	struct fd f;
+	void *key;
+	u32 cp;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_BATCH) || attr->batch.elem_flags ||
+	    attr->batch.flags)
+		return -EINVAL;
+
+	f = fdget(attr->batch.map_fd);
+	map = __bpf_map_get(f);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	if (!(f.file->f_mode & FMODE_CAN_WRITE)) {
+		err = -EPERM;
+		goto err_put;
+	}
+
+	err = -ENOMEM;
+	key = kmalloc(map->key_size, GFP_USER);
+	if (!key)
+		goto err_put;
+
+	err = 0;
+	for (cp = 0; cp < attr->batch.count; cp++) {
+		err = -EFAULT;
+		if (copy_from_user(key, ukeys + cp * map->key_size,
+				   map->key_size))
+			break;
+
+		err = map_delete_one(map, key);
+		if (err)
+			break;
+		cond_resched();
+	}
+
+	if (put_user(cp, &uattr->batch.count))
+		err = -EFAULT;
+
+	kfree(key);
+err_put:
+	fdput(f);
+	return err;
+}
+
 static LIST_HEAD(bpf_prog_types);
 
 static int find_prog_type(enum bpf_prog_type type, struct bpf_prog *prog)
@@ -1083,6 +1272,15 @@ SYSCALL_DEFINE3(bpf, int, cmd, union bpf_attr __user *, uattr, unsigned int, siz
 	case BPF_MAP_GET_NEXT_KEY:
 		err = map_get_next_key(&attr);
 		break;
+	case BPF_MAP_LOOKUP_BATCH:
+		err = map_lookup_batch(&attr, uattr, false);
+		break;
+	case BPF_MAP_LOOKUP_AND_DELETE_BATCH:
+		err = map_lookup_batch(&attr, uattr, true);
+		break;
+	case BPF_MAP_DELETE_BATCH:
+		err = map_delete_batch(&attr, uattr);
+		break;
 	case BPF_PROG_LOAD:
 		err = bpf_prog_load(&attr);
 		break;
@@ -201,13 +201,22 @@ void cgroup_migrate_add_src(struct css_set *src_cset, struct cgroup *dst_cgrp,
 int cgroup_migrate_prepare_dst(struct cgroup_mgctx *mgctx);
 int cgroup_migrate(struct task_struct *leader, bool threadgroup,
 		   struct cgroup_mgctx *mgctx);
+int cgroup_migrate_many(struct task_struct **leaders, int nr_leaders,
+			bool threadgroup, struct cgroup_mgctx *mgctx);
 
 int cgroup_attach_task(struct cgroup *dst_cgrp, struct task_struct *leader,
 		       bool threadgroup);
+int cgroup_attach_tasks(struct cgroup *dst_cgrp, struct task_struct **leaders,
+			int nr_leaders, bool threadgroup);
 struct task_struct *cgroup_procs_write_start(char *buf, bool threadgroup)
 	__acquires(&cgroup_threadgroup_rwsem);
 void cgroup_procs_write_finish(struct task_struct *task)
 	__releases(&cgroup_threadgroup_rwsem);
+void cgroup_procs_write_lock(void)
+	__acquires(&cgroup_threadgroup_rwsem);
+void cgroup_procs_write_unlock(void)
+	__releases(&cgroup_threadgroup_rwsem);
+struct task_struct *cgroup_procs_write_task(pid_t pid, bool threadgroup);
 
 void cgroup_lock_and_drain_offline(struct cgroup *cgrp);
 
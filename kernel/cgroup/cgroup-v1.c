@@ -502,23 +502,11 @@ static int cgroup_pidlist_show(struct seq_file *s, void *v)
 	return 0;
 }
 
-static ssize_t __cgroup1_procs_write(struct kernfs_open_file *of,
-				     char *buf, size_t nbytes, loff_t off,
-				     bool threadgroup)
+static int cgroup1_procs_write_permission(struct kernfs_open_file *of,
+					  struct task_struct *task)
 {
-	struct cgroup *cgrp;
-	struct task_struct *task;
 	const struct cred *cred, *tcred;
-	ssize_t ret;
-
-	cgrp = cgroup_kn_lock_live(of->kn, false);
-	if (!cgrp)
-		return -ENODEV;
-
-	task = cgroup_procs_write_start(buf, threadgroup);
-	ret = PTR_ERR_OR_ZERO(task);
-	if (ret)
-		goto out_unlock;
+	int ret = 0;
 
 	/*
 	 * Even if we're attaching all tasks in the thread group, we only need
@@ -533,15 +521,72 @@ static ssize_t __cgroup1_procs_write(struct kernfs_open_file *of,
 	    !ns_capable(tcred->user_ns, CAP_SYS_NICE))
 		ret = -EACCES;
 	put_cred(tcred);
-	if (ret)
-		goto out_finish;
+	return ret;
+}
+
+/*
+ * A write may list several whitespace separated pids, which are then
+ * migrated together with cgroup_threadgroup_rwsem taken once and
+ * a single ->attach() per controller.  Nothing is migrated if any of
+ * them fails.
+ */
+static ssize_t __cgroup1_procs_write(struct kernfs_open_file *of,
+				     char *buf, size_t nbytes, loff_t off,
+				     bool threadgroup)
+{
+	struct task_struct **tasks;
+	struct cgroup *cgrp;
+	int nr = 0, max = 0, i;
+	char *p, *tok;
+	ssize_t ret = 0;
+	pid_t pid;
+
+	for (p = strim(buf); *p; ) {
+		max++;
+		p = skip_spaces(p);
+		while (*p && !isspace(*p))
+			p++;
+	}
+	if (!max)
+		return -EINVAL;
 
-	ret = cgroup_attach_task(cgrp, task, threadgroup);
+	tasks = kcalloc(max, sizeof(*tasks), GFP_KERNEL);
+	if (!tasks)
+		return -ENOMEM;
 
-out_finish:
-	cgroup_procs_write_finish(task);
-out_unlock:
+	cgrp = cgroup_kn_lock_live(of->kn, false);
+	if (!cgrp) {
+		ret = -ENODEV;
+		goto out_free;
+	}
+
+	cgroup_procs_write_lock();
+	p = strim(buf);
+	while ((tok = strsep(&p, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (kstrtoint(tok, 0, &pid) || pid < 0) {
+			ret = -EINVAL;
+			break;
+		}
+		tasks[nr] = cgroup_procs_write_task(pid, threadgroup);
+		ret = PTR_ERR_OR_ZERO(tasks[nr]);
+		if (ret)
+			break;
+		ret = cgroup1_procs_write_permission(of, tasks[nr++]);
+		if (ret)
+			break;
+	}
+
+	if (!ret)
+		ret = cgroup_attach_tasks(cgrp, tasks, nr, threadgroup);
+
+	for (i = 0; i < nr; i++)
+		put_task_struct(tasks[i]);
+	cgroup_procs_write_unlock();
 	cgroup_kn_unlock(of->kn);
+out_free:
+	kfree(tasks);
 
 	return ret ?: nbytes;
 }
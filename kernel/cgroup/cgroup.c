@@ -2612,8 +2612,16 @@ int cgroup_migrate_prepare_dst(struct cgroup_mgctx *mgctx)
  */
 int cgroup_migrate(struct task_struct *leader, bool threadgroup,
 		   struct cgroup_mgctx *mgctx)
+{
+	return cgroup_migrate_many(&leader, 1, threadgroup, mgctx);
+}
+
+/* cgroup_migrate() for several processes or tasks at once */
+int cgroup_migrate_many(struct task_struct **leaders, int nr_leaders,
+			bool threadgroup, struct cgroup_mgctx *mgctx)
 {
 	struct task_struct *task;
+	int i;
 
 	/*
 	 * Prevent freeing of tasks while we take a snapshot. Tasks that are
@@ -2622,12 +2630,14 @@ int cgroup_migrate(struct task_struct *leader, bool threadgroup,
 	 */
 	spin_lock_irq(&css_set_lock);
 	rcu_read_lock();
-	task = leader;
-	do {
-		cgroup_migrate_add_task(task, mgctx);
-		if (!threadgroup)
-			break;
-	} while_each_thread(leader, task);
+	for (i = 0; i < nr_leaders; i++) {
+		task = leaders[i];
+		do {
+			cgroup_migrate_add_task(task, mgctx);
+			if (!threadgroup)
+				break;
+		} while_each_thread(leaders[i], task);
+	}
 	rcu_read_unlock();
 	spin_unlock_irq(&css_set_lock);
 
@@ -2644,10 +2654,29 @@ int cgroup_migrate(struct task_struct *leader, bool threadgroup,
  */
 int cgroup_attach_task(struct cgroup *dst_cgrp, struct task_struct *leader,
 		       bool threadgroup)
+{
+	return cgroup_attach_tasks(dst_cgrp, &leader, 1, threadgroup);
+}
+
+/**
+ * cgroup_attach_tasks - attach several tasks or threadgroups to a cgroup
+ * @dst_cgrp: the cgroup to attach to
+ * @leaders: the tasks or the leaders of the threadgroups to be attached
+ * @nr_leaders: number of entries in @leaders
+ * @threadgroup: attach the whole threadgroups?
+ *
+ * Like cgroup_attach_task(), but all of them are migrated in a single
+ * migration, so the controllers' ->can_attach() and ->attach() callbacks
+ * run once for the whole batch.  Either all of them are attached or none.
+ *
+ * Call holding cgroup_mutex and cgroup_threadgroup_rwsem.
+ */
+int cgroup_attach_tasks(struct cgroup *dst_cgrp, struct task_struct **leaders,
+			int nr_leaders, bool threadgroup)
 {
 	DEFINE_CGROUP_MGCTX(mgctx);
 	struct task_struct *task;
-	int ret;
+	int i, ret;
 
 	ret = cgroup_migrate_vet_dst(dst_cgrp);
 	if (ret)
@@ -2656,24 +2685,30 @@ int cgroup_attach_task(struct cgroup *dst_cgrp, struct task_struct *leader,
 	/* look up all src csets */
 	spin_lock_irq(&css_set_lock);
 	rcu_read_lock();
-	task = leader;
-	do {
-		cgroup_migrate_add_src(task_css_set(task), dst_cgrp, &mgctx);
-		if (!threadgroup)
-			break;
-	} while_each_thread(leader, task);
+	for (i = 0; i < nr_leaders; i++) {
+		task = leaders[i];
+		do {
+			cgroup_migrate_add_src(task_css_set(task), dst_cgrp,
+					       &mgctx);
+			if (!threadgroup)
+				break;
+		} while_each_thread(leaders[i], task);
+	}
 	rcu_read_unlock();
 	spin_unlock_irq(&css_set_lock);
 
 	/* prepare dst csets and commit */
 	ret = cgroup_migrate_prepare_dst(&mgctx);
 	if (!ret)
-		ret = cgroup_migrate(leader, threadgroup, &mgctx);
+		ret = cgroup_migrate_many(leaders, nr_leaders, threadgroup,
+					  &mgctx);
 
 	cgroup_migrate_finish(&mgctx);
 
 	if (!ret)
-		trace_cgroup_attach_task(dst_cgrp, leader, threadgroup);
+		for (i = 0; i < nr_leaders; i++)
+			trace_cgroup_attach_task(dst_cgrp, leaders[i],
+						 threadgroup);
 
 	return ret;
 }
@@ -2687,14 +2722,33 @@ struct task_struct *cgroup_procs_write_start(char *buf, bool threadgroup)
 	if (kstrtoint(strstrip(buf), 0, &pid) || pid < 0)
 		return ERR_PTR(-EINVAL);
 
+	cgroup_procs_write_lock();
+	tsk = cgroup_procs_write_task(pid, threadgroup);
+	if (IS_ERR(tsk))
+		percpu_up_write(&cgroup_threadgroup_rwsem);
+	return tsk;
+}
+
+void cgroup_procs_write_lock(void)
+	__acquires(&cgroup_threadgroup_rwsem)
+{
 	percpu_down_write(&cgroup_threadgroup_rwsem);
+}
+
+/*
+ * Look up @pid, or current if it is 0, for migration, returning it with a
+ * reference held.  Call holding cgroup_threadgroup_rwsem.
+ */
+struct task_struct *cgroup_procs_write_task(pid_t pid, bool threadgroup)
+{
+	struct task_struct *tsk;
 
 	rcu_read_lock();
 	if (pid) {
 		tsk = find_task_by_vpid(pid);
 		if (!tsk) {
 			tsk = ERR_PTR(-ESRCH);
-			goto out_unlock_threadgroup;
+			goto out_unlock_rcu;
 		}
 	} else {
 		tsk = current;
@@ -2711,14 +2765,10 @@ struct task_struct *cgroup_procs_write_start(char *buf, bool threadgroup)
 	 */
 	if (tsk->no_cgroup_migration || (tsk->flags & PF_NO_SETAFFINITY)) {
 		tsk = ERR_PTR(-EINVAL);
-		goto out_unlock_threadgroup;
+		goto out_unlock_rcu;
 	}
 
 	get_task_struct(tsk);
-	goto out_unlock_rcu;
-
-out_unlock_threadgroup:
-	percpu_up_write(&cgroup_threadgroup_rwsem);
 out_unlock_rcu:
 	rcu_read_unlock();
 	return tsk;
@@ -2727,12 +2777,18 @@ out_unlock_rcu:
 void cgroup_procs_write_finish(struct task_struct *task)
 	__releases(&cgroup_threadgroup_rwsem)
 {
-	struct cgroup_subsys *ss;
-	int ssid;
-
 	/* release reference from cgroup_procs_write_start() */
 	put_task_struct(task);
 
+	cgroup_procs_write_unlock();
+}
+
+void cgroup_procs_write_unlock(void)
+	__releases(&cgroup_threadgroup_rwsem)
+{
+	struct cgroup_subsys *ss;
+	int ssid;
+
 	percpu_up_write(&cgroup_threadgroup_rwsem);
 	for_each_subsys(ss, ssid)
 		if (ss->post_attach)
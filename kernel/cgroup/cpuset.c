@@ -1555,6 +1555,7 @@ static void cpuset_attach(struct cgroup_taskset *tset)
 	struct cgroup_subsys_state *css;
 	struct cpuset *cs;
 	struct cpuset *oldcs = cpuset_attach_old_cs;
+	bool rebind = false;
 
 	cgroup_taskset_first(tset, &css);
 	cs = css_cs(css);
@@ -1577,15 +1578,23 @@ static void cpuset_attach(struct cgroup_taskset *tset)
 		 */
 		WARN_ON_ONCE(update_cpus_allowed(cs, task, cpus_attach));
 
+		/* an mm whose owner keeps its nodes needs no rebinding */
+		if (thread_group_leader(task) &&
+		    !nodes_equal(task->mems_allowed, cpuset_attach_nodemask_to))
+			rebind = true;
 		cpuset_change_task_nodemask(task, &cpuset_attach_nodemask_to);
 		cpuset_update_task_spread_flag(cs, task);
 	}
 
 	/*
 	 * Change mm for all threadgroup leaders. This is expensive and may
-	 * sleep and should be moved outside migration path proper.
+	 * sleep and should be moved outside migration path proper.  It takes
+	 * each mmap_sem for writing, so skip it when no leader changes nodes,
+	 * as when moving between cpusets that only differ in their CPUs.
 	 */
 	cpuset_attach_nodemask_to = cs->effective_mems;
+	if (!rebind && !is_memory_migrate(cs))
+		goto out;
 	cgroup_taskset_for_each_leader(leader, css, tset) {
 		struct mm_struct *mm = get_task_mm(leader);
 
@@ -1608,6 +1617,7 @@ static void cpuset_attach(struct cgroup_taskset *tset)
 		}
 	}
 
+out:
 	cs->old_mems_allowed = cpuset_attach_nodemask_to;
 
 	cs->attach_in_progress--;
@@ -28,6 +28,8 @@ struct ring_buffer {
 
 	long				watermark;	/* wakeup watermark  */
 	long				aux_watermark;
+	unsigned long			next_wakeup;	/* jiffies, see perf_wakeup_interval_ms */
+	int				wakeup_deferred;
 	/* poll crap */
 	spinlock_t			event_lock;
 	struct list_head		event_list;
@@ -15,17 +15,46 @@
 #include <linux/circ_buf.h>
 #include <linux/poll.h>
 #include <linux/nospec.h>
+#include <linux/moduleparam.h>
 
 #include "internal.h"
 
+/*
+ * Wake up the readers of a buffer at most once per interval. A wakeup due
+ * within the interval is only flagged, and is delivered by the first write
+ * to the buffer after the interval expired. Readers of a buffer that stops
+ * filling up should therefore poll with a timeout.
+ */
+static unsigned int perf_wakeup_interval_ms;
+core_param(perf_wakeup_interval_ms, perf_wakeup_interval_ms, uint, 0644);
+
 static void perf_output_wakeup(struct perf_output_handle *handle)
 {
-	atomic_set(&handle->rb->poll, POLLIN);
+	struct ring_buffer *rb = handle->rb;
+	unsigned int interval = READ_ONCE(perf_wakeup_interval_ms);
+
+	atomic_set(&rb->poll, POLLIN);
+
+	if (interval) {
+		if (time_before(jiffies, READ_ONCE(rb->next_wakeup))) {
+			WRITE_ONCE(rb->wakeup_deferred, 1);
+			return;
+		}
+		WRITE_ONCE(rb->next_wakeup,
+			   jiffies + msecs_to_jiffies(interval));
+		WRITE_ONCE(rb->wakeup_deferred, 0);
+	}
 
 	handle->event->pending_wakeup = 1;
 	irq_work_queue(&handle->event->pending);
 }
 
+static bool perf_output_wakeup_due(struct ring_buffer *rb)
+{
+	return READ_ONCE(rb->wakeup_deferred) &&
+	       !time_before(jiffies, READ_ONCE(rb->next_wakeup));
+}
+
 /*
  * We need to ensure a later event_id doesn't publish a head when a former
  * event isn't done writing. However since we need to deal with NMIs we
@@ -121,7 +150,8 @@ again:
 		goto again;
 	}
 
-	if (handle->wakeup != local_read(&rb->wakeup))
+	if (handle->wakeup != local_read(&rb->wakeup) ||
+	    perf_output_wakeup_due(rb))
 		perf_output_wakeup(handle);
 
 out:
@@ -655,6 +685,31 @@ static void *perf_mmap_alloc_page(int cpu)
 	return page_address(page);
 }
 
+/* Largest chunk of physically contiguous data pages we try to get. */
+#define PERF_DATA_MAX_ORDER	4
+
+/*
+ * Allocate up to 1 << *order contiguous data pages, falling back to lower
+ * orders if memory is fragmented. The chunk is split so that every page
+ * can still be mapped and freed on its own.
+ */
+static struct page *perf_mmap_alloc_pages(int cpu, int *order)
+{
+	struct page *page;
+	int node;
+
+	node = (cpu == -1) ? cpu : cpu_to_node(cpu);
+	for (; *order > 0; (*order)--) {
+		page = alloc_pages_node(node, PERF_AUX_GFP, *order);
+		if (page) {
+			split_page(page, *order);
+			return page;
+		}
+	}
+
+	return alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+}
+
 struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 {
 	struct ring_buffer *rb;
@@ -675,10 +730,16 @@ struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	if (!rb->user_page)
 		goto fail_user_page;
 
-	for (i = 0; i < nr_pages; i++) {
-		rb->data_pages[i] = perf_mmap_alloc_page(cpu);
-		if (!rb->data_pages[i])
+	for (i = 0; i < nr_pages; ) {
+		struct page *page;
+		int j, order;
+
+		order = min(PERF_DATA_MAX_ORDER, ilog2(nr_pages - i));
+		page = perf_mmap_alloc_pages(cpu, &order);
+		if (!page)
 			goto fail_data_pages;
+		for (j = 0; j < (1 << order); j++)
+			rb->data_pages[i++] = page_address(page + j);
 	}
 
 	rb->nr_pages = nr_pages;
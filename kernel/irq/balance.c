@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Load driven interrupt balancing: every irq_balance_ms the rate and the
+ * handler time of each interrupt are sampled, and the busy ones are moved
+ * to the least loaded CPU of the lowest capacity, so that I/O interrupts
+ * stay off the CPUs running foreground work.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <trace/events/irq.h>
+
+#include "internals.h"
+
+/* sampling period, 0 stops the balancer */
+static unsigned int irq_balance_ms = 1000;
+core_param(irq_balance_ms, irq_balance_ms, uint, 0644);
+
+/* interrupts below this rate per second are never moved */
+static unsigned int irq_balance_min_rate = 500;
+core_param(irq_balance_min_rate, irq_balance_min_rate, uint, 0644);
+
+/*
+ * An interrupt already on a little CPU is only moved once that CPU is
+ * this many times as loaded as the best one, to avoid ping-ponging.
+ */
+#define IRQ_BALANCE_IMBALANCE	2
+
+static void irq_balance_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_work_fn);
+
+static struct cpumask irq_balance_cpus;
+static u64 irq_balance_busy_last[NR_CPUS];
+static u64 irq_balance_load[NR_CPUS];
+static u64 irq_balance_last;
+
+/* the CPUs of the lowest capacity, all of them on symmetric systems */
+static void irq_balance_init_cpus(void)
+{
+#ifdef arch_scale_cpu_capacity
+	unsigned long min_cap = ULONG_MAX;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		min_cap = min(min_cap, arch_scale_cpu_capacity(NULL, cpu));
+	for_each_possible_cpu(cpu)
+		if (arch_scale_cpu_capacity(NULL, cpu) == min_cap)
+			cpumask_set_cpu(cpu, &irq_balance_cpus);
+#else
+	cpumask_copy(&irq_balance_cpus, cpu_possible_mask);
+#endif
+}
+
+static u64 irq_balance_cpu_busy(int cpu)
+{
+	u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+	return cputime_to_nsecs(cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+				cpustat[CPUTIME_SYSTEM] +
+				cpustat[CPUTIME_IRQ] +
+				cpustat[CPUTIME_SOFTIRQ]);
+}
+
+static bool irq_balance_eligible(struct irq_desc *desc)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+
+	return desc->action && irqd_can_balance(d) && !irqd_is_per_cpu(d) &&
+		!irqd_affinity_is_managed(d) && !desc->affinity_hint &&
+		d->chip && d->chip->irq_set_affinity;
+}
+
+/* the least loaded online little CPU */
+static int irq_balance_best_cpu(void)
+{
+	int cpu, best = -1;
+
+	for_each_cpu_and(cpu, &irq_balance_cpus, cpu_online_mask)
+		if (best < 0 || irq_balance_load[cpu] < irq_balance_load[best])
+			best = cpu;
+	return best;
+}
+
+static void irq_balance_one(unsigned int irq, struct irq_desc *desc,
+			    u64 period)
+{
+	unsigned int count = kstat_irqs(irq);
+	unsigned int delta = count - desc->balance_count_last;
+	u64 ns = READ_ONCE(desc->balance_ns);
+	u64 load = ns - desc->balance_ns_last;
+	unsigned int rate;
+	int cur, best;
+
+	desc->balance_count_last = count;
+	desc->balance_ns_last = ns;
+
+	rate = div64_u64((u64)delta * NSEC_PER_SEC, period);
+	if (rate < irq_balance_min_rate)
+		return;
+
+	cur = cpumask_first_and(irq_data_get_affinity_mask(&desc->irq_data),
+				cpu_online_mask);
+	best = irq_balance_best_cpu();
+	if (best < 0 || best == cur)
+		return;
+
+	if (cur < nr_cpu_ids && cpumask_test_cpu(cur, &irq_balance_cpus) &&
+	    irq_balance_load[cur] <=
+	    irq_balance_load[best] * IRQ_BALANCE_IMBALANCE)
+		return;
+
+	if (irq_set_affinity(irq, cpumask_of(best)))
+		return;
+
+	trace_irq_balance_move(irq, cur < nr_cpu_ids ? cur : -1, best, rate,
+			       (unsigned int)div64_u64(load * 1000, period));
+
+	/* the handler time moves along with the interrupt */
+	irq_balance_load[best] += load;
+	if (cur < nr_cpu_ids)
+		irq_balance_load[cur] -= min(load, irq_balance_load[cur]);
+}
+
+static void irq_balance_work_fn(struct work_struct *work)
+{
+	u64 now = local_clock();
+	u64 period = now - irq_balance_last;
+	struct irq_desc *desc;
+	unsigned int irq;
+	u64 busy;
+	int cpu;
+
+	irq_balance_last = now;
+
+	for_each_possible_cpu(cpu) {
+		busy = irq_balance_cpu_busy(cpu);
+		irq_balance_load[cpu] = busy - irq_balance_busy_last[cpu];
+		irq_balance_busy_last[cpu] = busy;
+	}
+
+	irq_lock_sparse();
+	for_each_irq_desc(irq, desc)
+		if (irq_balance_eligible(desc))
+			irq_balance_one(irq, desc, period);
+	irq_unlock_sparse();
+
+	if (READ_ONCE(irq_balance_ms))
+		queue_delayed_work(system_power_efficient_wq, &irq_balance_work,
+				   msecs_to_jiffies(irq_balance_ms));
+}
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_init_cpus();
+	irq_balance_last = local_clock();
+	if (irq_balance_ms)
+		queue_delayed_work(system_power_efficient_wq, &irq_balance_work,
+				   msecs_to_jiffies(irq_balance_ms));
+	return 0;
+}
+late_initcall(irq_balance_init);
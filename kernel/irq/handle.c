@@ -138,6 +138,9 @@ irqreturn_t handle_irq_event_percpu(struct irq_desc *desc)
 	irqreturn_t retval = IRQ_NONE;
 	unsigned int flags = 0, irq = desc->irq_data.irq;
 	struct irqaction *action = desc->action;
+	u64 start = irq_balance_start();
+
+	irq_timings_record(desc);
 
 	/* action might have become NULL since we dropped the lock */
 	while (action) {
@@ -177,6 +180,7 @@ irqreturn_t handle_irq_event_percpu(struct irq_desc *desc)
 		action = action->next;
 	}
 
+	irq_balance_account(desc, start);
 	add_interrupt_randomness(irq, flags);
 
 	if (!noirqdebug)
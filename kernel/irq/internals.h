@@ -217,3 +217,24 @@ irq_pm_install_action(struct irq_desc *desc, struct irqaction *action) { }
 static inline void
 irq_pm_remove_action(struct irq_desc *desc, struct irqaction *action) { }
 #endif
+
+#ifdef CONFIG_IRQ_TIMINGS
+void irq_timings_record(struct irq_desc *desc);
+#else
+static inline void irq_timings_record(struct irq_desc *desc) { }
+#endif
+
+#ifdef CONFIG_IRQ_BALANCE
+static inline u64 irq_balance_start(void)
+{
+	return local_clock();
+}
+
+static inline void irq_balance_account(struct irq_desc *desc, u64 start)
+{
+	desc->balance_ns += local_clock() - start;
+}
+#else
+static inline u64 irq_balance_start(void) { return 0; }
+static inline void irq_balance_account(struct irq_desc *desc, u64 start) { }
+#endif
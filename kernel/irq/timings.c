@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Arrival history of device interrupts, so that idle governors can see
+ * a periodic interrupt (audio, touch, modem) coming before the next
+ * timer does.
+ */
+
+#include <linux/bitmap.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/sched.h>
+
+#include "internals.h"
+
+/*
+ * An interrupt is periodic once IRQ_TIMINGS_MIN_CONF of its recent
+ * intervals fell within 1/8 of the average one. Intervals above
+ * IRQ_TIMINGS_MAX_PERIOD_NS restart the history.
+ */
+#define IRQ_TIMINGS_MIN_CONF		4
+#define IRQ_TIMINGS_MAX_CONF		16
+#define IRQ_TIMINGS_MAX_PERIOD_NS	NSEC_PER_SEC
+
+static DECLARE_BITMAP(irq_timings_periodic, IRQ_BITMAP_BITS);
+
+void irq_timings_record(struct irq_desc *desc)
+{
+	unsigned int irq = irq_desc_get_irq(desc);
+	u64 now = local_clock();
+	u64 delta = now - desc->timing_last;
+	u32 period = desc->timing_period;
+	u32 conf = desc->timing_conf;
+
+	desc->timing_last = now;
+
+	if (delta > IRQ_TIMINGS_MAX_PERIOD_NS) {
+		period = 0;
+		conf = 0;
+	} else {
+		if (period && abs((s64)delta - period) <= (period >> 3)) {
+			if (conf < IRQ_TIMINGS_MAX_CONF)
+				conf++;
+		} else {
+			conf >>= 1;
+		}
+		period = period ? period - (period >> 2) + (delta >> 2) :
+				  delta;
+	}
+
+	desc->timing_period = period;
+	desc->timing_conf = conf;
+
+	if (conf >= IRQ_TIMINGS_MIN_CONF) {
+		if (!test_bit(irq, irq_timings_periodic))
+			set_bit(irq, irq_timings_periodic);
+	} else if (test_bit(irq, irq_timings_periodic)) {
+		clear_bit(irq, irq_timings_periodic);
+	}
+}
+
+/**
+ * irq_timings_next_event - predict the next periodic device interrupt
+ * @now: current local_clock() time
+ * @mask: only consider interrupts targeting one of these CPUs, or NULL
+ * @irqp: returns the interrupt expected first
+ *
+ * Returns the local_clock() time the first periodic interrupt is
+ * expected at, or 0 if none is. An interrupt late by more than one
+ * period is assumed to have stopped.
+ */
+u64 irq_timings_next_event(u64 now, const struct cpumask *mask,
+			   unsigned int *irqp)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+	u64 next = 0, t, last;
+	u32 period;
+
+	for_each_set_bit(irq, irq_timings_periodic, IRQ_BITMAP_BITS) {
+		desc = irq_to_desc(irq);
+		if (!desc)
+			continue;
+		if (mask && !cpumask_intersects(mask,
+				irq_data_get_affinity_mask(&desc->irq_data)))
+			continue;
+
+		last = READ_ONCE(desc->timing_last);
+		period = READ_ONCE(desc->timing_period);
+		t = last + period;
+		if (t < now) {
+			if (now - t > period)
+				continue;
+			t = now;
+		}
+
+		if (!next || t < next) {
+			next = t;
+			*irqp = irq;
+		}
+	}
+
+	return next;
+}
+EXPORT_SYMBOL(irq_timings_next_event);
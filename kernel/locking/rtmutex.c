@@ -19,6 +19,9 @@
 
 #include "rtmutex_common.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/rtmutex.h>
+
 /*
  * lock->owner state tracking:
  *
@@ -1238,7 +1241,12 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		  enum rtmutex_chainwalk chwalk)
 {
 	struct rt_mutex_waiter waiter;
+	struct task_struct *owner;
+	char owner_comm[TASK_COMM_LEN];
+	pid_t owner_pid = 0;
+	int owner_prio = 0;
 	unsigned long flags;
+	u64 start = 0;
 	int ret = 0;
 
 	rt_mutex_init_waiter(&waiter);
@@ -1265,6 +1273,16 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	if (unlikely(timeout))
 		hrtimer_start_expires(&timeout->timer, HRTIMER_MODE_ABS);
 
+	/* remember who inverted our priority, for the trace event */
+	owner = rt_mutex_owner(lock);
+	if (trace_rt_mutex_inversion_enabled() && owner &&
+	    owner->prio > current->prio) {
+		owner_pid = task_pid_nr(owner);
+		owner_prio = owner->prio;
+		memcpy(owner_comm, owner->comm, TASK_COMM_LEN);
+		start = local_clock();
+	}
+
 	ret = task_blocks_on_rt_mutex(lock, &waiter, current, chwalk);
 
 	if (likely(!ret))
@@ -1290,6 +1308,10 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	if (unlikely(timeout))
 		hrtimer_cancel(&timeout->timer);
 
+	if (start && !ret)
+		trace_rt_mutex_inversion(lock, owner_pid, owner_comm,
+					 owner_prio, local_clock() - start);
+
 	debug_rt_mutex_free_waiter(&waiter);
 
 	return ret;
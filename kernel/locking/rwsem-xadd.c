@@ -15,6 +15,10 @@
 #include <linux/export.h>
 #include <linux/sched/rt.h>
 #include <linux/osq_lock.h>
+#include <linux/hash.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "rwsem.h"
 
@@ -83,6 +87,8 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->count = RWSEM_UNLOCKED_VALUE;
 	raw_spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+	sem->handoff = 0;
+	sem->name = name;
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
 	osq_lock_init(&sem->osq);
@@ -100,8 +106,88 @@ struct rwsem_waiter {
 	struct list_head list;
 	struct task_struct *task;
 	enum rwsem_waiter_type type;
+	unsigned long timeout;
 };
 
+/*
+ * A writer that has been first in the queue for this long sets the handoff
+ * bit, after which neither spinners nor other waiters may steal the lock.
+ */
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
+/* how long a reader may spin on a running writer, 0 disables it */
+static unsigned int rwsem_reader_spin_ns = 10 * NSEC_PER_USEC;
+core_param(rwsem_reader_spin_ns, rwsem_reader_spin_ns, uint, 0644);
+
+/*
+ * Contention stats per lock class, the class being the name the rwsem was
+ * initialized with. Only the slow paths touch them.
+ */
+#define RWSEM_STAT_BITS		7
+#define RWSEM_STAT_PROBES	8
+
+struct rwsem_class_stats {
+	const char *name;
+	atomic_long_t contended[2];	/* indexed by rwsem_waiter_type */
+	atomic_long_t spun[2];
+	atomic_long_t wait_ns[2];
+	unsigned long max_wait_ns[2];
+	atomic_long_t handoffs;
+};
+
+static struct rwsem_class_stats rwsem_stats[1 << RWSEM_STAT_BITS];
+
+static struct rwsem_class_stats *rwsem_class_stats(struct rw_semaphore *sem)
+{
+	const char *name = sem->name ? : "(unnamed)";
+	unsigned long h = hash_ptr((void *)name, RWSEM_STAT_BITS);
+	struct rwsem_class_stats *st;
+	const char *old;
+	int i;
+
+	for (i = 0; i < RWSEM_STAT_PROBES; i++) {
+		st = &rwsem_stats[(h + i) & ((1 << RWSEM_STAT_BITS) - 1)];
+		old = READ_ONCE(st->name);
+		if (!old)
+			old = cmpxchg(&st->name, NULL, name) ? : name;
+		if (old == name)
+			return st;
+	}
+	return NULL;
+}
+
+static void rwsem_stat_spun(struct rw_semaphore *sem,
+			    enum rwsem_waiter_type type)
+{
+	struct rwsem_class_stats *st = rwsem_class_stats(sem);
+
+	if (st)
+		atomic_long_inc(&st->spun[type]);
+}
+
+static void rwsem_stat_wait(struct rw_semaphore *sem,
+			    enum rwsem_waiter_type type, u64 start)
+{
+	struct rwsem_class_stats *st = rwsem_class_stats(sem);
+	unsigned long ns = local_clock() - start;
+
+	if (!st)
+		return;
+	atomic_long_inc(&st->contended[type]);
+	atomic_long_add(ns, &st->wait_ns[type]);
+	/* racy, but good enough for a maximum */
+	if (ns > READ_ONCE(st->max_wait_ns[type]))
+		WRITE_ONCE(st->max_wait_ns[type], ns);
+}
+
+static void rwsem_stat_handoff(struct rw_semaphore *sem)
+{
+	struct rwsem_class_stats *st = rwsem_class_stats(sem);
+
+	if (st)
+		atomic_long_inc(&st->handoffs);
+}
+
 enum rwsem_wake_type {
 	RWSEM_WAKE_ANY,		/* Wake whatever's at head of wait list */
 	RWSEM_WAKE_READERS,	/* Wake readers only */
@@ -207,6 +293,80 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 	return sem;
 }
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+static inline bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	bool ret;
+
+	/* never jump the queue or get in the way of a handoff */
+	if (!rwsem_reader_spin_ns || need_resched() ||
+	    READ_ONCE(sem->handoff) ||
+	    READ_ONCE(sem->wait_list.next) != &sem->wait_list)
+		return false;
+
+	rcu_read_lock();
+	owner = READ_ONCE(sem->owner);
+	ret = owner && owner->on_cpu;
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Spin for at most rwsem_reader_spin_ns while the lock is write owned by a
+ * running task and nobody is queued, taking the read lock once it is free.
+ * The caller must not hold a read bias in the count.
+ */
+static bool rwsem_reader_spin(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	bool taken = false;
+	u64 deadline;
+	long count;
+
+	preempt_disable();
+	deadline = local_clock() + rwsem_reader_spin_ns;
+	while (true) {
+		count = READ_ONCE(sem->count);
+		if (count >= 0) {
+			if (cmpxchg_acquire(&sem->count, count,
+					    count + RWSEM_ACTIVE_READ_BIAS) == count) {
+				taken = true;
+				break;
+			}
+			continue;
+		}
+
+		if (need_resched() || READ_ONCE(sem->handoff) ||
+		    READ_ONCE(sem->wait_list.next) != &sem->wait_list ||
+		    local_clock() > deadline)
+			break;
+
+		rcu_read_lock();
+		owner = READ_ONCE(sem->owner);
+		if (owner && !owner->on_cpu) {
+			rcu_read_unlock();
+			break;
+		}
+		rcu_read_unlock();
+
+		cpu_relax_lowlatency();
+	}
+	preempt_enable();
+	return taken;
+}
+#else
+static inline bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline bool rwsem_reader_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+#endif
+
 /*
  * Wait for the read lock to be granted
  */
@@ -216,6 +376,24 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
 	struct task_struct *tsk = current;
+	u64 start = local_clock();
+	bool first;
+
+	if (rwsem_reader_can_spin(sem)) {
+		/*
+		 * Drop the bias of the fast path so the writer doesn't wait
+		 * for us, waking the queue as up_read() would if it was the
+		 * last active one.
+		 */
+		count = rwsem_atomic_update(-RWSEM_ACTIVE_READ_BIAS, sem);
+		if (count < 0 && !(count & RWSEM_ACTIVE_MASK))
+			rwsem_wake(sem);
+		if (rwsem_reader_spin(sem)) {
+			rwsem_stat_spun(sem, RWSEM_WAITING_FOR_READ);
+			return sem;
+		}
+		adjustment = 0;
+	}
 
 	/* set up my own style of waitqueue */
 	waiter.task = tsk;
@@ -223,7 +401,8 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	get_task_struct(tsk);
 
 	raw_spin_lock_irq(&sem->wait_lock);
-	if (list_empty(&sem->wait_list))
+	first = list_empty(&sem->wait_list);
+	if (first)
 		adjustment += RWSEM_WAITING_BIAS;
 	list_add_tail(&waiter.list, &sem->wait_list);
 
@@ -236,8 +415,7 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	 * wake our own waiter to join the existing active readers !
 	 */
 	if (count == RWSEM_WAITING_BIAS ||
-	    (count > RWSEM_WAITING_BIAS &&
-	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
+	    (count > RWSEM_WAITING_BIAS && first))
 		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
 
 	raw_spin_unlock_irq(&sem->wait_lock);
@@ -251,12 +429,27 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	}
 
 	__set_task_state(tsk, TASK_RUNNING);
+	rwsem_stat_wait(sem, RWSEM_WAITING_FOR_READ, start);
 	return sem;
 }
 EXPORT_SYMBOL(rwsem_down_read_failed);
 
-static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
+static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem,
+					struct rwsem_waiter *waiter)
 {
+	/*
+	 * The lock is handed off to the first waiter. If it is free, make
+	 * sure that waiter knows, as up_*() may have skipped the wakeup in
+	 * favour of a spinner that then queued behind it.
+	 */
+	if (sem->handoff &&
+	    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+			     list) != waiter) {
+		if (count == RWSEM_WAITING_BIAS)
+			__rwsem_do_wake(sem, RWSEM_WAKE_ANY);
+		return false;
+	}
+
 	/*
 	 * Try acquiring the write lock. Check count first in order
 	 * to reduce unnecessary expensive cmpxchg() operations.
@@ -266,6 +459,7 @@ static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 		    RWSEM_ACTIVE_WRITE_BIAS) == RWSEM_WAITING_BIAS) {
 		if (!list_is_singular(&sem->wait_list))
 			rwsem_atomic_update(RWSEM_WAITING_BIAS, sem);
+		sem->handoff = 0;
 		rwsem_set_owner(sem);
 		return true;
 	}
@@ -285,6 +479,10 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
+		/* reserved for the first waiter */
+		if (READ_ONCE(sem->handoff))
+			return false;
+
 		old = cmpxchg_acquire(&sem->count, count,
 				      count + RWSEM_ACTIVE_WRITE_BIAS);
 		if (old == count) {
@@ -301,7 +499,7 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	struct task_struct *owner;
 	bool ret = true;
 
-	if (need_resched())
+	if (need_resched() || READ_ONCE(sem->handoff))
 		return false;
 
 	rcu_read_lock();
@@ -387,6 +585,10 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 			break;
 		}
 
+		/* a starving waiter gets the lock next, go queue */
+		if (READ_ONCE(sem->handoff))
+			break;
+
 		/*
 		 * When there's no owner, we might have preempted between the
 		 * owner acquiring the lock and setting the owner field. If
@@ -439,13 +641,16 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	long count;
 	bool waiting = true; /* any queued threads before us */
 	struct rwsem_waiter waiter;
+	u64 start = local_clock();
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = rwsem_atomic_update(-RWSEM_ACTIVE_WRITE_BIAS, sem);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		rwsem_stat_spun(sem, RWSEM_WAITING_FOR_WRITE);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -461,6 +666,7 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 		waiting = false;
 
 	list_add_tail(&waiter.list, &sem->wait_list);
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	/* we're now waiting on the lock, but no longer actively locking */
 	if (waiting) {
@@ -480,8 +686,19 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	/* wait until we successfully acquire the lock */
 	set_current_state(TASK_UNINTERRUPTIBLE);
 	while (true) {
-		if (rwsem_try_write_lock(count, sem))
+		if (rwsem_try_write_lock(count, sem, &waiter))
 			break;
+
+		/*
+		 * Stop the lock from being stolen once we have waited at the
+		 * head of the queue for too long.
+		 */
+		if (!sem->handoff && time_after(jiffies, waiter.timeout) &&
+		    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+				     list) == &waiter) {
+			WRITE_ONCE(sem->handoff, 1);
+			rwsem_stat_handoff(sem);
+		}
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -497,6 +714,7 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
 
+	rwsem_stat_wait(sem, RWSEM_WAITING_FOR_WRITE, start);
 	return sem;
 }
 EXPORT_SYMBOL(rwsem_down_write_failed);
@@ -601,3 +819,72 @@ struct rw_semaphore *rwsem_downgrade_wake(struct rw_semaphore *sem)
 	return sem;
 }
 EXPORT_SYMBOL(rwsem_downgrade_wake);
+
+#ifdef CONFIG_DEBUG_FS
+static int rwsem_stats_show(struct seq_file *s, void *unused)
+{
+	struct rwsem_class_stats *st;
+	const char *name;
+	int i, t;
+
+	seq_puts(s, "# class type contended spun wait_ns max_wait_ns handoffs\n");
+	for (i = 0; i < ARRAY_SIZE(rwsem_stats); i++) {
+		st = &rwsem_stats[i];
+		name = READ_ONCE(st->name);
+		if (!name)
+			continue;
+		for (t = RWSEM_WAITING_FOR_WRITE; t <= RWSEM_WAITING_FOR_READ;
+		     t++)
+			seq_printf(s, "%s %s %lu %lu %lu %lu %lu\n", name,
+				   t == RWSEM_WAITING_FOR_WRITE ? "write" : "read",
+				   atomic_long_read(&st->contended[t]),
+				   atomic_long_read(&st->spun[t]),
+				   atomic_long_read(&st->wait_ns[t]),
+				   READ_ONCE(st->max_wait_ns[t]),
+				   t == RWSEM_WAITING_FOR_WRITE ?
+				   atomic_long_read(&st->handoffs) : 0);
+	}
+	return 0;
+}
+
+static int rwsem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rwsem_stats_show, NULL);
+}
+
+/* any write clears the counters, the classes stay */
+static ssize_t rwsem_stats_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct rwsem_class_stats *st;
+	int i, t;
+
+	for (i = 0; i < ARRAY_SIZE(rwsem_stats); i++) {
+		st = &rwsem_stats[i];
+		for (t = 0; t < 2; t++) {
+			atomic_long_set(&st->contended[t], 0);
+			atomic_long_set(&st->spun[t], 0);
+			atomic_long_set(&st->wait_ns[t], 0);
+			WRITE_ONCE(st->max_wait_ns[t], 0);
+		}
+		atomic_long_set(&st->handoffs, 0);
+	}
+	return count;
+}
+
+static const struct file_operations rwsem_stats_fops = {
+	.open		= rwsem_stats_open,
+	.read		= seq_read,
+	.write		= rwsem_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init rwsem_stats_init(void)
+{
+	debugfs_create_file("rwsem_stats", 0644, NULL, NULL,
+			    &rwsem_stats_fops);
+	return 0;
+}
+late_initcall(rwsem_stats_init);
+#endif
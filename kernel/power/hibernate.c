@@ -36,6 +36,7 @@
 
 
 static int nocompress;
+static int compress_lz4;
 static int noresume;
 static int nohibernate;
 static int resume_wait;
@@ -697,6 +698,8 @@ int hibernate(void)
 			flags |= SF_NOCOMPRESS_MODE;
 		else
 		        flags |= SF_CRC32_MODE;
+		if (compress_lz4)
+			flags |= SF_LZ4_MODE;
 
 		pr_debug("PM: writing image.\n");
 		error = swsusp_write(flags);
@@ -1115,6 +1118,8 @@ static int __init hibernate_setup(char *str)
 		noresume = 1;
 	else if (!strncmp(str, "nocompress", 10))
 		nocompress = 1;
+	else if (!strncmp(str, "lz4", 3))
+		compress_lz4 = 1;
 	else if (!strncmp(str, "no", 2)) {
 		noresume = 1;
 		nohibernate = 1;
@@ -20,23 +20,106 @@
 #include <trace/events/power.h>
 #include <linux/wakeup_reason.h>
 #include <linux/cpuset.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /*
  * Timeout for stopping processes
  */
 unsigned int __read_mostly freeze_timeout_msecs = 20 * MSEC_PER_SEC;
 
+/*
+ * Tasks still freezing after a full scan of the task list. As long as they
+ * all fit, the following rounds only look at them, and a last full scan
+ * confirms that nothing new showed up before we report success.
+ */
+#define FREEZE_PENDING_MAX	64
+
+static struct task_struct *freeze_pending[FREEZE_PENDING_MAX];
+static unsigned int nr_freeze_pending;
+
+/* per freezing pass statistics, [0] for kernel threads, [1] for user space */
+struct freeze_stats {
+	unsigned int attempts;
+	unsigned int aborts;
+	unsigned int failures;
+	unsigned int rounds;
+	unsigned int full_scans;
+	u64 total_us;
+	u32 max_us;
+	u32 last_us;
+	unsigned int last_rounds;
+};
+
+static struct freeze_stats freeze_stats[2];
+
+static unsigned int freeze_scan_all(void)
+{
+	struct task_struct *g, *p;
+	unsigned int todo = 0;
+
+	nr_freeze_pending = 0;
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p == current || !freeze_task(p))
+			continue;
+
+		if (freezer_should_skip(p))
+			continue;
+
+		if (todo++ < FREEZE_PENDING_MAX) {
+			get_task_struct(p);
+			freeze_pending[nr_freeze_pending++] = p;
+		}
+	}
+	read_unlock(&tasklist_lock);
+
+	/* too many to track, drop them and scan everything next round */
+	if (todo > FREEZE_PENDING_MAX) {
+		while (nr_freeze_pending)
+			put_task_struct(freeze_pending[--nr_freeze_pending]);
+	}
+
+	return todo;
+}
+
+static unsigned int freeze_scan_pending(void)
+{
+	unsigned int i, todo = 0;
+	struct task_struct *p;
+
+	for (i = 0; i < nr_freeze_pending; i++) {
+		p = freeze_pending[i];
+		if (freeze_task(p) && !freezer_should_skip(p)) {
+			freeze_pending[todo++] = p;
+			continue;
+		}
+		put_task_struct(p);
+	}
+	nr_freeze_pending = todo;
+
+	return todo;
+}
+
+static void freeze_drop_pending(void)
+{
+	while (nr_freeze_pending)
+		put_task_struct(freeze_pending[--nr_freeze_pending]);
+}
+
 static int try_to_freeze_tasks(bool user_only)
 {
+	struct freeze_stats *st = &freeze_stats[user_only];
 	struct task_struct *g, *p;
 	unsigned long end_time;
 	unsigned int todo;
 	bool wq_busy = false;
 	struct timeval start, end;
-	u64 elapsed_msecs64;
+	u64 elapsed_usecs64;
 	unsigned int elapsed_msecs;
+	unsigned int rounds = 0;
 	bool wakeup = false;
-	int sleep_usecs = USEC_PER_MSEC;
+	int sleep_usecs = 100;
 
 	do_gettimeofday(&start);
 
@@ -46,16 +129,14 @@ static int try_to_freeze_tasks(bool user_only)
 		freeze_workqueues_begin();
 
 	while (true) {
+		rounds++;
 		todo = 0;
-		read_lock(&tasklist_lock);
-		for_each_process_thread(g, p) {
-			if (p == current || !freeze_task(p))
-				continue;
-
-			if (!freezer_should_skip(p))
-				todo++;
+		if (nr_freeze_pending)
+			todo = freeze_scan_pending();
+		if (!todo) {
+			st->full_scans++;
+			todo = freeze_scan_all();
 		}
-		read_unlock(&tasklist_lock);
 
 		if (!user_only) {
 			wq_busy = freeze_workqueues_busy();
@@ -72,18 +153,29 @@ static int try_to_freeze_tasks(bool user_only)
 
 		/*
 		 * We need to retry, but first give the freezing tasks some
-		 * time to enter the refrigerator.  Start with an initial
-		 * 1 ms sleep followed by exponential backoff until 8 ms.
+		 * time to enter the refrigerator.  Most tasks get there within
+		 * a few hundred microseconds, so start with a 100 us sleep
+		 * followed by exponential backoff until 8 ms.
 		 */
 		usleep_range(sleep_usecs / 2, sleep_usecs);
 		if (sleep_usecs < 8 * USEC_PER_MSEC)
 			sleep_usecs *= 2;
 	}
+	freeze_drop_pending();
 
 	do_gettimeofday(&end);
-	elapsed_msecs64 = timeval_to_ns(&end) - timeval_to_ns(&start);
-	do_div(elapsed_msecs64, NSEC_PER_MSEC);
-	elapsed_msecs = elapsed_msecs64;
+	elapsed_usecs64 = timeval_to_ns(&end) - timeval_to_ns(&start);
+	do_div(elapsed_usecs64, NSEC_PER_USEC);
+	elapsed_msecs = div_u64(elapsed_usecs64, USEC_PER_MSEC);
+
+	st->attempts++;
+	st->aborts += wakeup;
+	st->failures += !wakeup && todo;
+	st->rounds += rounds;
+	st->total_us += elapsed_usecs64;
+	st->last_us = min_t(u64, elapsed_usecs64, U32_MAX);
+	st->max_us = max(st->max_us, st->last_us);
+	st->last_rounds = rounds;
 
 	if (wakeup) {
 		pr_cont("\n");
@@ -221,6 +313,61 @@ void thaw_processes(void)
 	trace_suspend_resume(TPS("thaw_processes"), 0, false);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int freeze_stats_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[] = { "kernel", "user" };
+	struct freeze_stats *st;
+	int i;
+
+	seq_puts(s, "# pass   attempts aborts failures rounds full_scans"
+		    " avg_us max_us last_us last_rounds\n");
+	lock_system_sleep();
+	for (i = 0; i < ARRAY_SIZE(freeze_stats); i++) {
+		st = &freeze_stats[i];
+		seq_printf(s, "%-8s %8u %6u %8u %6u %10u %6llu %6u %7u %11u\n",
+			   names[i], st->attempts, st->aborts, st->failures,
+			   st->rounds, st->full_scans,
+			   st->attempts ? div_u64(st->total_us, st->attempts) : 0,
+			   st->max_us, st->last_us, st->last_rounds);
+	}
+	unlock_system_sleep();
+
+	return 0;
+}
+
+static int freeze_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, freeze_stats_show, NULL);
+}
+
+static ssize_t freeze_stats_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	lock_system_sleep();
+	memset(freeze_stats, 0, sizeof(freeze_stats));
+	unlock_system_sleep();
+
+	return count;
+}
+
+static const struct file_operations freeze_stats_fops = {
+	.open		= freeze_stats_open,
+	.read		= seq_read,
+	.write		= freeze_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init freeze_stats_debugfs_init(void)
+{
+	debugfs_create_file("freeze_stats", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &freeze_stats_fops);
+	return 0;
+}
+late_initcall(freeze_stats_debugfs_init);
+#endif
+
 void thaw_kernel_threads(void)
 {
 	struct task_struct *g, *p;
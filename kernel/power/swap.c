@@ -25,6 +25,7 @@
 #include <linux/pm.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/vmalloc.h>
 #include <linux/cpumask.h>
 #include <linux/atomic.h>
@@ -513,13 +514,20 @@ static int swap_writer_finish(struct swap_map_handle *handle,
 #define LZO_UNC_PAGES	32
 #define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
 
-/* Number of pages/bytes we need for compressed data (worst case). */
+/*
+ * Number of pages/bytes we need for compressed data (worst case). The LZO
+ * bound is also larger than the LZ4 one.
+ */
 #define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
 			             LZO_HEADER, PAGE_SIZE)
 #define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
 
+/* Compression workspace, large enough for both compressors. */
+#define LZO_WRK_SIZE	(LZ4_MEM_COMPRESS > LZO1X_1_MEM_COMPRESS ? \
+			 LZ4_MEM_COMPRESS : LZO1X_1_MEM_COMPRESS)
+
 /* Maximum number of threads for compression/decompression. */
-#define LZO_THREADS	3
+#define LZO_THREADS	8
 
 /* Minimum/maximum number of pages for read buffering. */
 #define LZO_MIN_RD_PAGES	1024
@@ -627,9 +635,10 @@ struct cmp_data {
 	wait_queue_head_t done;                   /* compression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
+	bool lz4;                                 /* LZ4 instead of LZO */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
 	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
-	unsigned char wrk[LZO1X_1_MEM_COMPRESS];  /* compression workspace */
+	unsigned char wrk[LZO_WRK_SIZE];          /* compression workspace */
 };
 
 /**
@@ -651,9 +660,14 @@ static int lzo_compress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
-		                          d->cmp + LZO_HEADER, &d->cmp_len,
-		                          d->wrk);
+		if (d->lz4)
+			d->ret = lz4_compress(d->unc, d->unc_len,
+					      d->cmp + LZO_HEADER, &d->cmp_len,
+					      d->wrk);
+		else
+			d->ret = lzo1x_1_compress(d->unc, d->unc_len,
+						  d->cmp + LZO_HEADER,
+						  &d->cmp_len, d->wrk);
 		atomic_set_release(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -661,14 +675,15 @@ static int lzo_compress_threadfn(void *data)
 }
 
 /**
- * save_image_lzo - Save the suspend image data compressed with LZO.
+ * save_image_lzo - Save the suspend image data compressed with LZO or LZ4.
  * @handle: Swap map handle to use for saving the image.
  * @snapshot: Image to read data from.
  * @nr_to_write: Number of pages to save.
+ * @lz4: Compress with LZ4 instead of LZO.
  */
 static int save_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_write)
+                          unsigned int nr_to_write, bool lz4)
 {
 	unsigned int m;
 	int ret = 0;
@@ -722,6 +737,7 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	for (thr = 0; thr < nr_threads; thr++) {
 		init_waitqueue_head(&data[thr].go);
 		init_waitqueue_head(&data[thr].done);
+		data[thr].lz4 = lz4;
 
 		data[thr].thr = kthread_run(lzo_compress_threadfn,
 		                            &data[thr],
@@ -763,9 +779,9 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	handle->reqd_free_pages = reqd_free_pages();
 
 	printk(KERN_INFO
-		"PM: Using %u thread(s) for compression.\n"
+		"PM: Using %u thread(s) for %s compression.\n"
 		"PM: Compressing and saving image data (%u pages)...\n",
-		nr_threads, nr_to_write);
+		nr_threads, lz4 ? "LZ4" : "LZO", nr_to_write);
 	m = nr_to_write / 10;
 	if (!m)
 		m = 1;
@@ -940,7 +956,8 @@ int swsusp_write(unsigned int flags)
 	if (!error) {
 		error = (flags & SF_NOCOMPRESS_MODE) ?
 			save_image(&handle, &snapshot, pages - 1) :
-			save_image_lzo(&handle, &snapshot, pages - 1);
+			save_image_lzo(&handle, &snapshot, pages - 1,
+				       flags & SF_LZ4_MODE);
 	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
@@ -1119,6 +1136,7 @@ struct dec_data {
 	wait_queue_head_t done;                   /* decompression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
+	bool lz4;                                 /* LZ4 instead of LZO */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
 	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
 };
@@ -1143,8 +1161,14 @@ static int lzo_decompress_threadfn(void *data)
 		atomic_set(&d->ready, 0);
 
 		d->unc_len = LZO_UNC_SIZE;
-		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
-		                               d->unc, &d->unc_len);
+		if (d->lz4)
+			d->ret = lz4_decompress_unknownoutputsize(
+					d->cmp + LZO_HEADER, d->cmp_len,
+					d->unc, &d->unc_len);
+		else
+			d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER,
+						       d->cmp_len, d->unc,
+						       &d->unc_len);
 		if (clean_pages_on_decompress)
 			flush_icache_range((unsigned long)d->unc,
 					   (unsigned long)d->unc + d->unc_len);
@@ -1160,10 +1184,11 @@ static int lzo_decompress_threadfn(void *data)
  * @handle: Swap map handle to use for loading data.
  * @snapshot: Image to copy uncompressed data into.
  * @nr_to_read: Number of pages to load.
+ * @lz4: The image was compressed with LZ4 instead of LZO.
  */
 static int load_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_read)
+                          unsigned int nr_to_read, bool lz4)
 {
 	unsigned int m;
 	int ret = 0;
@@ -1222,6 +1247,7 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	for (thr = 0; thr < nr_threads; thr++) {
 		init_waitqueue_head(&data[thr].go);
 		init_waitqueue_head(&data[thr].done);
+		data[thr].lz4 = lz4;
 
 		data[thr].thr = kthread_run(lzo_decompress_threadfn,
 		                            &data[thr],
@@ -1510,7 +1536,8 @@ int swsusp_read(unsigned int *flags_p)
 	if (!error) {
 		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
 			load_image(&handle, &snapshot, header->pages - 1) :
-			load_image_lzo(&handle, &snapshot, header->pages - 1);
+			load_image_lzo(&handle, &snapshot, header->pages - 1,
+				       *flags_p & SF_LZ4_MODE);
 	}
 	swap_reader_finish(&handle);
 end:
@@ -27,6 +27,8 @@
 #include <linux/notifier.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define MAX_WAKEUP_REASON_IRQS 32
 static bool suspend_abort;
@@ -48,6 +50,34 @@ static ktime_t curr_monotime; /* monotonic time after last suspend */
 static ktime_t last_stime; /* monotonic boottime offset before last suspend */
 static ktime_t curr_stime; /* monotonic boottime offset after last suspend */
 
+/*
+ * Awake time accounting: the time from a resume to the next suspend is
+ * charged to the irq that caused the resume, together with the wakeup
+ * source whose release finally let the system suspend again.
+ */
+#define WAKEUP_STATS_NR		64
+#define WAKEUP_STATS_NAME_LEN	32
+#define WAKEUP_STATS_HIST	12
+#define WAKEUP_STATS_MIN_SHIFT	4	/* first bucket is < 16ms */
+
+struct wakeup_stat {
+	int irq;
+	char irq_name[WAKEUP_STATS_NAME_LEN];
+	char ws_name[WAKEUP_STATS_NAME_LEN];
+	u32 count;
+	u64 total_ms;
+	u32 max_ms;
+	u32 hist[WAKEUP_STATS_HIST];
+};
+
+static struct wakeup_stat wakeup_stats[WAKEUP_STATS_NR];
+static unsigned int wakeup_stats_overflow;
+static DEFINE_SPINLOCK(wakeup_stats_lock);
+
+/* leaf irq of the last resume, -1 once charged */
+static int wake_irq = -1;
+static char wake_irq_name[WAKEUP_STATS_NAME_LEN];
+
 static void init_wakeup_irq_node(struct wakeup_irq_node *p, int irq)
 {
 	p->irq = irq;
@@ -542,6 +572,88 @@ void clear_wakeup_reasons(void)
 	spin_unlock_irqrestore(&resume_reason_lock, flags);
 }
 
+static bool find_wake_irq(struct wakeup_irq_node *n, void *unused)
+{
+	if (n->child)
+		return true;
+
+	wake_irq = n->irq;
+	if (n->desc && n->desc->action && n->desc->action->name)
+		strlcpy(wake_irq_name, n->desc->action->name,
+			sizeof(wake_irq_name));
+	else
+		strlcpy(wake_irq_name, "unknown", sizeof(wake_irq_name));
+	return false;
+}
+
+/* Remember what woke us up so that the awake time can be charged to it. */
+static void wakeup_stats_resume(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&resume_reason_lock, flags);
+	wake_irq = 0;
+	strlcpy(wake_irq_name, "unknown", sizeof(wake_irq_name));
+	if (suspend_abort) {
+		wake_irq = -2;
+		strlcpy(wake_irq_name, "abort", sizeof(wake_irq_name));
+	} else {
+		walk_irq_node_tree(base_irq_nodes, find_wake_irq, NULL);
+	}
+	spin_unlock_irqrestore(&resume_reason_lock, flags);
+}
+
+static struct wakeup_stat *wakeup_stat_get(int irq, const char *ws_name)
+{
+	struct wakeup_stat *st;
+	int i;
+
+	for (i = 0; i < WAKEUP_STATS_NR; i++) {
+		st = &wakeup_stats[i];
+		if (!st->count)
+			break;
+		if (st->irq == irq && !strcmp(st->ws_name, ws_name))
+			return st;
+	}
+	if (i == WAKEUP_STATS_NR)
+		return NULL;
+
+	st->irq = irq;
+	strlcpy(st->irq_name, wake_irq_name, sizeof(st->irq_name));
+	strlcpy(st->ws_name, ws_name, sizeof(st->ws_name));
+	return st;
+}
+
+/* Charge the time since the last resume, called right before suspending. */
+static void wakeup_stats_suspend(ktime_t now)
+{
+	char ws_name[WAKEUP_STATS_NAME_LEN];
+	struct wakeup_stat *st;
+	unsigned long flags;
+	u32 ms;
+
+	if (wake_irq == -1)
+		return;
+
+	pm_get_last_relaxed_wakeup_source(ws_name, sizeof(ws_name));
+	ms = min_t(s64, ktime_ms_delta(now, curr_monotime), U32_MAX);
+
+	spin_lock_irqsave(&wakeup_stats_lock, flags);
+	st = wakeup_stat_get(wake_irq, ws_name);
+	if (st) {
+		st->count++;
+		st->total_ms += ms;
+		st->max_ms = max(st->max_ms, ms);
+		st->hist[min(fls(ms >> WAKEUP_STATS_MIN_SHIFT),
+			     WAKEUP_STATS_HIST - 1)]++;
+	} else {
+		wakeup_stats_overflow++;
+	}
+	spin_unlock_irqrestore(&wakeup_stats_lock, flags);
+
+	wake_irq = -1;
+}
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
@@ -556,6 +668,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		last_monotime = ktime_get();
 		/* monotonic time since boot including the time spent in suspend */
 		last_stime = ktime_get_boottime();
+		wakeup_stats_suspend(last_monotime);
 		clear_wakeup_reasons();
 		break;
 	case PM_POST_SUSPEND:
@@ -572,6 +685,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 #else
 		print_wakeup_sources();
 #endif
+		wakeup_stats_resume();
 		break;
 	default:
 		break;
@@ -626,3 +740,64 @@ fail:
 }
 
 late_initcall(wakeup_reason_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int wakeup_stats_show(struct seq_file *s, void *unused)
+{
+	struct wakeup_stat *st;
+	int i, j;
+
+	seq_printf(s, "# awake time buckets: <%ums, doubling, last is the rest\n",
+		   1U << WAKEUP_STATS_MIN_SHIFT);
+	seq_puts(s, "# irq name wakeup_source count total_ms max_ms buckets\n");
+	spin_lock_irq(&wakeup_stats_lock);
+	for (i = 0; i < WAKEUP_STATS_NR; i++) {
+		st = &wakeup_stats[i];
+		if (!st->count)
+			break;
+		seq_printf(s, "%d %s %s %u %llu %u", st->irq, st->irq_name,
+			   st->ws_name, st->count, st->total_ms, st->max_ms);
+		for (j = 0; j < WAKEUP_STATS_HIST; j++)
+			seq_printf(s, " %u", st->hist[j]);
+		seq_puts(s, "\n");
+	}
+	if (wakeup_stats_overflow)
+		seq_printf(s, "# %u wakeups not accounted, table full\n",
+			   wakeup_stats_overflow);
+	spin_unlock_irq(&wakeup_stats_lock);
+
+	return 0;
+}
+
+static int wakeup_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_stats_show, NULL);
+}
+
+static ssize_t wakeup_stats_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	spin_lock_irq(&wakeup_stats_lock);
+	memset(wakeup_stats, 0, sizeof(wakeup_stats));
+	wakeup_stats_overflow = 0;
+	spin_unlock_irq(&wakeup_stats_lock);
+
+	return count;
+}
+
+static const struct file_operations wakeup_stats_fops = {
+	.open		= wakeup_stats_open,
+	.read		= seq_read,
+	.write		= wakeup_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wakeup_stats_debugfs_init(void)
+{
+	debugfs_create_file("wakeup_reason_stats", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &wakeup_stats_fops);
+	return 0;
+}
+late_initcall(wakeup_stats_debugfs_init);
+#endif
@@ -46,6 +46,7 @@
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -1548,6 +1549,61 @@ static int console_trylock_for_printk(void)
 	return 1;
 }
 
+/*
+ * Hand console output over to a kthread instead of flushing the consoles
+ * from whatever context called printk(). Oopses, early boot and shutdown
+ * still print directly so that nothing is lost when the kthread can't run.
+ */
+static bool __read_mostly printk_offload = true;
+module_param_named(offload, printk_offload, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(offload, "flush the consoles from a kthread");
+
+static struct task_struct *printk_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+static bool printk_kthread_pending;
+
+static bool printk_offload_console(void)
+{
+	if (!READ_ONCE(printk_offload) || !printk_kthread ||
+	    oops_in_progress || system_state != SYSTEM_RUNNING)
+		return false;
+
+	WRITE_ONCE(printk_kthread_pending, true);
+	wake_up(&printk_kthread_wait);
+	return true;
+}
+
+static int printk_kthread_func(void *unused)
+{
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(printk_kthread_wait,
+					 READ_ONCE(printk_kthread_pending) ||
+					 kthread_should_stop());
+		WRITE_ONCE(printk_kthread_pending, false);
+
+		/* console_unlock() flushes everything logged so far */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: unable to start the console kthread\n");
+		return PTR_ERR(thread);
+	}
+	printk_kthread = thread;
+
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 int printk_delay_msec __read_mostly;
 
 static inline void printk_delay(void)
@@ -1824,7 +1880,7 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && !printk_offload_console()) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
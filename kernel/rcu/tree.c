@@ -2026,6 +2026,9 @@ static void rcu_gp_cleanup(struct rcu_state *rsp)
 	gp_duration = jiffies - rsp->gp_start;
 	if (gp_duration > rsp->gp_max)
 		rsp->gp_max = gp_duration;
+	rsp->gp_total += gp_duration;
+	rsp->gp_hist[min_t(int, fls(jiffies_to_msecs(gp_duration)),
+			   RCU_GP_HIST_BUCKETS - 1)]++;
 
 	/*
 	 * We know the grace period is complete, but to everyone else
@@ -3114,6 +3117,8 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func,
 			init_default_callback_list(rdp);
 	}
 	WRITE_ONCE(rdp->qlen, rdp->qlen + 1);
+	if (rdp->qlen > rdp->qlen_max)
+		rdp->qlen_max = rdp->qlen;
 	if (lazy)
 		rdp->qlen_lazy++;
 	else
@@ -3417,6 +3422,7 @@ static void rcu_exp_gp_seq_end(struct rcu_state *rsp)
 {
 	rcu_seq_end(&rsp->expedited_sequence);
 	smp_mb(); /* Ensure that consecutive grace periods serialize. */
+	rsp->expedited_last_end = local_clock();
 }
 static unsigned long rcu_exp_gp_seq_snap(struct rcu_state *rsp)
 {
@@ -3687,6 +3693,30 @@ static struct rcu_node *exp_funnel_lock(struct rcu_state *rsp, unsigned long s)
 	return rnp1;
 }
 
+/*
+ * Expedited grace periods that follow each other closely are a burst of
+ * callers, each of which IPIs every online CPU.  When the previous one
+ * ended less than rcu_exp_batch_window_us ago, the funnel winner waits
+ * rcu_exp_batch_us before starting, so that the callers arriving in the
+ * meantime snapshot this grace period rather than the next one.
+ */
+static uint rcu_exp_batch_us = 50;
+module_param(rcu_exp_batch_us, uint, 0644);
+static uint rcu_exp_batch_window_us = 1000;
+module_param(rcu_exp_batch_window_us, uint, 0644);
+
+static void rcu_exp_batch_wait(struct rcu_state *rsp)
+{
+	uint delay = READ_ONCE(rcu_exp_batch_us);
+
+	if (!delay || !rcu_scheduler_fully_active ||
+	    local_clock() - rsp->expedited_last_end >
+	    (u64)READ_ONCE(rcu_exp_batch_window_us) * NSEC_PER_USEC)
+		return;
+	atomic_long_inc(&rsp->expedited_batched);
+	usleep_range(delay, delay * 2);
+}
+
 /* Invoked on each online non-idle CPU for expedited quiescent state. */
 static void sync_sched_exp_handler(void *data)
 {
@@ -3882,6 +3912,7 @@ void synchronize_sched_expedited(void)
 	if (rnp == NULL)
 		return;  /* Someone else did our work for us. */
 
+	rcu_exp_batch_wait(rsp);
 	rcu_exp_gp_seq_start(rsp);
 	sync_rcu_exp_select_cpus(rsp, sync_sched_exp_handler);
 	synchronize_sched_expedited_wait(rsp);
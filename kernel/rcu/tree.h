@@ -348,6 +348,7 @@ struct rcu_data {
 	long		qlen;		/* # of queued callbacks, incl lazy */
 	long		qlen_last_fqs_check;
 					/* qlen at last check for QS forcing */
+	long		qlen_max;	/* longest callback backlog seen */
 	unsigned long	n_cbs_invoked;	/* count of RCU cbs invoked. */
 	unsigned long	n_nocbs_invoked; /* count of no-CBs RCU cbs invoked. */
 	unsigned long   n_cbs_orphaned; /* RCU cbs orphaned by dying CPU */
@@ -455,6 +456,9 @@ do {									\
  * CPUs and by CONFIG_RCU_FANOUT.  Small systems will have a "hierarchy"
  * consisting of a single rcu_node.
  */
+/* Number of power-of-two millisecond buckets of the GP duration histogram. */
+#define RCU_GP_HIST_BUCKETS	10
+
 struct rcu_state {
 	struct rcu_node node[NUM_RCU_NODES];	/* Hierarchy. */
 	struct rcu_node *level[RCU_NUM_LVLS + 1];
@@ -503,6 +507,8 @@ struct rcu_state {
 	atomic_long_t expedited_workdone2;	/* # done by others #2. */
 	atomic_long_t expedited_workdone3;	/* # done by others #3. */
 	atomic_long_t expedited_normal;		/* # fallbacks to normal. */
+	atomic_long_t expedited_batched;	/* # delayed to batch callers. */
+	u64 expedited_last_end;			/* local_clock() at last end. */
 	atomic_t expedited_need_qs;		/* # CPUs left to check in. */
 	wait_queue_head_t expedited_wq;		/* Wait for check-ins. */
 	int ncpus_snap;				/* # CPUs seen last time. */
@@ -527,6 +533,10 @@ struct rcu_state {
 						/*  GP start. */
 	unsigned long gp_max;			/* Maximum GP duration in */
 						/*  jiffies. */
+	unsigned long gp_total;			/* Sum of GP durations in */
+						/*  jiffies. */
+	unsigned long gp_hist[RCU_GP_HIST_BUCKETS];
+						/* GP durations, log2 of ms. */
 	const char *name;			/* Name of structure. */
 	char abbr;				/* Abbreviated name. */
 	struct list_head flavors;		/* List of RCU flavors. */
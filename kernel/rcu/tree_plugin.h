@@ -59,6 +59,8 @@ DEFINE_PER_CPU(char, rcu_cpu_has_work);
 static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
 static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
+static struct cpumask rcu_nocb_affinity;    /* CPUs to run rcuo kthreads on. */
+static bool have_rcu_nocb_affinity;	    /* Was rcu_nocb_affinity= given? */
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
 /*
@@ -752,6 +754,7 @@ void synchronize_rcu_expedited(void)
 	if (rnp_unlock == NULL)
 		return;  /* Someone else did our work for us. */
 
+	rcu_exp_batch_wait(rsp);
 	rcu_exp_gp_seq_start(rsp);
 
 	/* Initialize the rcu_node tree in preparation for the wait. */
@@ -1816,6 +1819,43 @@ static int __init parse_rcu_nocb_poll(char *arg)
 }
 early_param("rcu_nocb_poll", parse_rcu_nocb_poll);
 
+/* Parse the boot-time CPU list the rcuo kthreads are confined to. */
+static int __init rcu_nocb_affinity_setup(char *str)
+{
+	have_rcu_nocb_affinity = !cpulist_parse(str, &rcu_nocb_affinity);
+	return 1;
+}
+__setup("rcu_nocb_affinity=", rcu_nocb_affinity_setup);
+
+/*
+ * Unless told otherwise, run the rcuo kthreads on the CPUs of the lowest
+ * capacity, so that callback floods don't wake the big cores of an
+ * asymmetric system.  On symmetric systems this is every CPU.
+ */
+static const struct cpumask *rcu_nocb_kthread_mask(void)
+{
+#ifdef arch_scale_cpu_capacity
+	unsigned long cap, min_cap = ULONG_MAX;
+	int cpu;
+
+	if (!have_rcu_nocb_affinity) {
+		for_each_possible_cpu(cpu)
+			min_cap = min(min_cap,
+				      arch_scale_cpu_capacity(NULL, cpu));
+		cpumask_clear(&rcu_nocb_affinity);
+		for_each_possible_cpu(cpu) {
+			cap = arch_scale_cpu_capacity(NULL, cpu);
+			if (cap == min_cap)
+				cpumask_set_cpu(cpu, &rcu_nocb_affinity);
+		}
+	}
+#else
+	if (!have_rcu_nocb_affinity)
+		return cpu_possible_mask;
+#endif
+	return &rcu_nocb_affinity;
+}
+
 /*
  * Wake up any no-CBs CPUs' kthreads that were waiting on the just-ended
  * grace period.
@@ -1940,6 +1980,9 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 	old_rhpp = xchg(&rdp->nocb_tail, rhtp);
 	WRITE_ONCE(*old_rhpp, rhp);
 	atomic_long_add(rhcount_lazy, &rdp->nocb_q_count_lazy);
+	len = atomic_long_read(&rdp->nocb_q_count);
+	if (len > READ_ONCE(rdp->qlen_max))
+		WRITE_ONCE(rdp->qlen_max, len);
 	smp_mb__after_atomic(); /* Store *old_rhpp before _wake test. */
 
 	/* If we are not being polled and there is a kthread, awaken it ... */
@@ -2413,6 +2456,9 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 			"rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
+
+	/* Fails harmlessly if none of those CPUs is online yet. */
+	set_cpus_allowed_ptr(t, rcu_nocb_kthread_mask());
 }
 
 /*
@@ -352,6 +352,53 @@ static const struct file_operations rcugp_fops = {
 	.release = single_release,
 };
 
+/*
+ * Grace-period duration statistics and the per-CPU callback backlog,
+ * both current and the longest seen since boot.
+ */
+static int show_rcugpstats(struct seq_file *m, void *v)
+{
+	struct rcu_state *rsp = (struct rcu_state *)m->private;
+	unsigned long completed = READ_ONCE(rsp->completed);
+	struct rcu_data *rdp;
+	long ql, qll;
+	int cpu, i;
+
+	seq_printf(m, "gps=%lu total_ms=%u max_ms=%u exp_batched=%lu\n",
+		   completed, jiffies_to_msecs(READ_ONCE(rsp->gp_total)),
+		   jiffies_to_msecs(READ_ONCE(rsp->gp_max)),
+		   atomic_long_read(&rsp->expedited_batched));
+	seq_puts(m, "ms:");
+	for (i = 0; i < RCU_GP_HIST_BUCKETS; i++)
+		seq_printf(m, " <%u:%lu", 1U << i, READ_ONCE(rsp->gp_hist[i]));
+	seq_puts(m, "\n");
+
+	for_each_possible_cpu(cpu) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (!rdp->beenonline)
+			continue;
+		rcu_nocb_q_lengths(rdp, &ql, &qll);
+		seq_printf(m, "%3d%c qlen=%ld qlen_max=%ld\n", rdp->cpu,
+			   cpu_is_offline(rdp->cpu) ? '!' : ' ',
+			   READ_ONCE(rdp->qlen) + ql,
+			   READ_ONCE(rdp->qlen_max));
+	}
+	return 0;
+}
+
+static int rcugpstats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcugpstats, inode->i_private);
+}
+
+static const struct file_operations rcugpstats_fops = {
+	.owner = THIS_MODULE,
+	.open = rcugpstats_open,
+	.read = seq_read,
+	.llseek = no_llseek,
+	.release = single_release,
+};
+
 static void print_one_rcu_pending(struct seq_file *m, struct rcu_data *rdp)
 {
 	if (!rdp->beenonline)
@@ -476,6 +523,11 @@ static int __init rcutree_trace_init(void)
 				rspdir, rsp, &rcuhier_fops);
 		if (!retval)
 			goto free_out;
+
+		retval = debugfs_create_file("rcugpstats", 0444,
+				rspdir, rsp, &rcugpstats_fops);
+		if (!retval)
+			goto free_out;
 	}
 
 	retval = debugfs_create_file("rcutorture", 0444, rcudir,
@@ -26,6 +26,8 @@
 #include <linux/workqueue.h>
 #include <linux/freezer.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #ifdef CONFIG_MSM_PM
 #include "lpm-levels.h"
@@ -58,6 +60,46 @@ static struct rtc_timer		rtctimer;
 static struct rtc_device	*rtcdev;
 static DEFINE_SPINLOCK(rtcdev_lock);
 
+/*
+ * Wakeup accounting: each RTC wakeup is charged to the callback of the
+ * alarm that set the wakeup time, or to NULL for clock_nanosleep().
+ */
+#define ALARM_WAKEUP_STATS_NR	16
+
+struct alarm_wakeup_stat {
+	void *fn;
+	unsigned int count;
+};
+
+static struct alarm_wakeup_stat alarm_wakeup_stats[ALARM_WAKEUP_STATS_NR];
+static unsigned int alarm_wakeup_other;
+static unsigned int alarm_rtc_programmed;
+static unsigned int alarm_rtc_reused;
+static DEFINE_SPINLOCK(alarm_stats_lock);
+
+/* callback behind the programmed rtc wakeup, valid while rtc_armed */
+static void *alarm_wake_fn;
+static bool alarm_rtc_armed;
+
+static void alarmtimer_account_wakeup(void *fn)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&alarm_stats_lock, flags);
+	for (i = 0; i < ALARM_WAKEUP_STATS_NR; i++) {
+		if (alarm_wakeup_stats[i].fn == fn ||
+		    !alarm_wakeup_stats[i].count) {
+			alarm_wakeup_stats[i].fn = fn;
+			alarm_wakeup_stats[i].count++;
+			break;
+		}
+	}
+	if (i == ALARM_WAKEUP_STATS_NR)
+		alarm_wakeup_other++;
+	spin_unlock_irqrestore(&alarm_stats_lock, flags);
+}
+
 static void alarmtimer_triggered_func(void *p)
 {
 	struct rtc_device *rtc = rtcdev;
@@ -219,7 +261,8 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 
 	spin_lock_irqsave(&base->lock, flags);
 	if (restart != ALARMTIMER_NORESTART) {
-		hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+		hrtimer_set_expires_range(&alarm->timer, alarm->node.expires,
+					  alarm->window);
 		alarmtimer_enqueue(base, alarm);
 		ret = HRTIMER_RESTART;
 	}
@@ -247,14 +290,87 @@ EXPORT_SYMBOL_GPL(alarm_expires_remaining);
  * set an rtc timer to fire that far into the future, which
  * will wake us from suspend.
  */
+/*
+ * Find how soon we have to wake up to serve the alarms, starting from the
+ * freezer delta in @min. An alarm may fire as late as its expiry plus its
+ * window, so the wakeup is the earliest such deadline; every alarm that
+ * expires before it is then served by the same wakeup.
+ */
+static ktime_t alarmtimer_next_wakeup(ktime_t min)
+{
+	unsigned long flags;
+	int i;
+
+	alarm_wake_fn = NULL;
+	for (i = 0; i < ALARM_NUMTYPE; i++) {
+		struct alarm_base *base = &alarm_bases[i];
+		struct timerqueue_node *next;
+		struct alarm *alarm;
+		ktime_t now, delta;
+
+		spin_lock_irqsave(&base->lock, flags);
+		now = base->gettime();
+		for (next = timerqueue_getnext(&base->timerqueue); next;
+		     next = timerqueue_iterate_next(next)) {
+			delta = ktime_sub(next->expires, now);
+			/* the queue is sorted, nothing later can be sooner */
+			if (min.tv64 && delta.tv64 >= min.tv64)
+				break;
+			alarm = container_of(next, struct alarm, node);
+			delta = ktime_add(delta, alarm->window);
+			if (!min.tv64 || delta.tv64 < min.tv64) {
+				min = delta;
+				alarm_wake_fn = alarm->function;
+			}
+		}
+		spin_unlock_irqrestore(&base->lock, flags);
+	}
+
+	return min;
+}
+
+/*
+ * Program the rtc to fire @min from now. The rtc has a one second
+ * resolution, so an alarm left armed from the previous suspend that is
+ * that close already does the job and is not reprogrammed.
+ */
+static int alarmtimer_program_rtc(struct rtc_device *rtc, ktime_t min)
+{
+	struct rtc_time tm;
+	ktime_t now;
+	int ret;
+
+	rtc_read_time(rtc, &tm);
+	now = rtc_tm_to_ktime(tm);
+	now = ktime_add(now, min);
+
+	if (rtctimer.enabled &&
+	    abs(ktime_to_ns(ktime_sub(now, rtctimer.node.expires))) <
+	    NSEC_PER_SEC) {
+		alarm_rtc_reused++;
+		alarm_rtc_armed = true;
+		return 0;
+	}
+
+	/* Set alarm, if in the past reject suspend briefly to handle */
+	rtc_timer_cancel(rtc, &rtctimer);
+	ret = rtc_timer_start(rtc, &rtctimer, now, ktime_set(0, 0));
+	if (ret < 0) {
+		__pm_wakeup_event(ws, MSEC_PER_SEC);
+		return ret;
+	}
+	alarm_rtc_programmed++;
+	alarm_rtc_armed = true;
+
+	return 0;
+}
+
 #if defined(CONFIG_RTC_DRV_QPNP) && defined(CONFIG_MSM_PM)
 static int alarmtimer_suspend(struct device *dev)
 {
-	struct rtc_time tm;
-	ktime_t min, now;
+	ktime_t min;
 	unsigned long flags;
 	struct rtc_device *rtc;
-	int i;
 	int ret = 0;
 
 	spin_lock_irqsave(&freezer_delta_lock, flags);
@@ -267,23 +383,12 @@ static int alarmtimer_suspend(struct device *dev)
 	if (!rtc)
 		return 0;
 
-	/* Find the soonest timer to expire*/
-	for (i = 0; i < ALARM_NUMTYPE; i++) {
-		struct alarm_base *base = &alarm_bases[i];
-		struct timerqueue_node *next;
-		ktime_t delta;
-
-		spin_lock_irqsave(&base->lock, flags);
-		next = timerqueue_getnext(&base->timerqueue);
-		spin_unlock_irqrestore(&base->lock, flags);
-		if (!next)
-			continue;
-		delta = ktime_sub(next->expires, base->gettime());
-		if (!min.tv64 || (delta.tv64 < min.tv64))
-			min = delta;
-	}
-	if (min.tv64 == 0)
+	/* Find the soonest wakeup the alarms need */
+	min = alarmtimer_next_wakeup(min);
+	if (min.tv64 == 0) {
+		rtc_timer_cancel(rtc, &rtctimer);
 		return 0;
+	}
 
 	if (ktime_to_ns(min) < 2 * NSEC_PER_SEC) {
 		__pm_wakeup_event(ws, 2 * MSEC_PER_SEC);
@@ -291,32 +396,23 @@ static int alarmtimer_suspend(struct device *dev)
 	}
 
 	/* Setup a timer to fire that far in the future */
-	rtc_timer_cancel(rtc, &rtctimer);
-	rtc_read_time(rtc, &tm);
-	now = rtc_tm_to_ktime(tm);
-	now = ktime_add(now, min);
 	if (poweron_alarm) {
 		uint64_t msec = 0;
 
+		rtc_timer_cancel(rtc, &rtctimer);
 		msec = ktime_to_ms(min);
 		lpm_suspend_wake_time(msec);
 	} else {
-		/* Set alarm, if in the past reject suspend briefly to handle */
-		ret = rtc_timer_start(rtc, &rtctimer, now, ktime_set(0, 0));
-		if (ret < 0)
-			__pm_wakeup_event(ws, MSEC_PER_SEC);
+		ret = alarmtimer_program_rtc(rtc, min);
 	}
 	return ret;
 }
 #else
 static int alarmtimer_suspend(struct device *dev)
 {
-	struct rtc_time tm;
-	ktime_t min, now;
+	ktime_t min;
 	unsigned long flags;
 	struct rtc_device *rtc;
-	int i;
-	int ret;
 
 	spin_lock_irqsave(&freezer_delta_lock, flags);
 	min = freezer_delta;
@@ -328,23 +424,12 @@ static int alarmtimer_suspend(struct device *dev)
 	if (!rtc)
 		return 0;
 
-	/* Find the soonest timer to expire*/
-	for (i = 0; i < ALARM_NUMTYPE; i++) {
-		struct alarm_base *base = &alarm_bases[i];
-		struct timerqueue_node *next;
-		ktime_t delta;
-
-		spin_lock_irqsave(&base->lock, flags);
-		next = timerqueue_getnext(&base->timerqueue);
-		spin_unlock_irqrestore(&base->lock, flags);
-		if (!next)
-			continue;
-		delta = ktime_sub(next->expires, base->gettime());
-		if (!min.tv64 || (delta.tv64 < min.tv64))
-			min = delta;
-	}
-	if (min.tv64 == 0)
+	/* Find the soonest wakeup the alarms need */
+	min = alarmtimer_next_wakeup(min);
+	if (min.tv64 == 0) {
+		rtc_timer_cancel(rtc, &rtctimer);
 		return 0;
+	}
 
 	if (ktime_to_ns(min) < 2 * NSEC_PER_SEC) {
 		__pm_wakeup_event(ws, 2 * MSEC_PER_SEC);
@@ -352,18 +437,14 @@ static int alarmtimer_suspend(struct device *dev)
 	}
 
 	/* Setup an rtc timer to fire that far in the future */
-	rtc_timer_cancel(rtc, &rtctimer);
-	rtc_read_time(rtc, &tm);
-	now = rtc_tm_to_ktime(tm);
-	now = ktime_add(now, min);
-
-	/* Set alarm, if in the past reject suspend briefly to handle */
-	ret = rtc_timer_start(rtc, &rtctimer, now, ktime_set(0, 0));
-	if (ret < 0)
-		__pm_wakeup_event(ws, MSEC_PER_SEC);
-	return ret;
+	return alarmtimer_program_rtc(rtc, min);
 }
 #endif
+/*
+ * The rtc alarm is left armed over resume, the next suspend reuses it if
+ * the wakeup time did not change. A fired rtc timer is disabled by the rtc
+ * core, which tells us that it was the source of this wakeup.
+ */
 static int alarmtimer_resume(struct device *dev)
 {
 	struct rtc_device *rtc;
@@ -372,7 +453,10 @@ static int alarmtimer_resume(struct device *dev)
 	/* If we have no rtcdev, just return */
 	if (!rtc)
 		return 0;
-	rtc_timer_cancel(rtc, &rtctimer);
+
+	if (alarm_rtc_armed && !rtctimer.enabled)
+		alarmtimer_account_wakeup(alarm_wake_fn);
+	alarm_rtc_armed = false;
 
 	return 0;
 }
@@ -420,6 +504,7 @@ void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 	alarm->function = function;
 	alarm->type = type;
 	alarm->state = ALARMTIMER_STATE_INACTIVE;
+	alarm->window = ktime_set(0, 0);
 }
 EXPORT_SYMBOL_GPL(alarm_init);
 
@@ -436,7 +521,8 @@ void alarm_start(struct alarm *alarm, ktime_t start)
 	spin_lock_irqsave(&base->lock, flags);
 	alarm->node.expires = start;
 	alarmtimer_enqueue(base, alarm);
-	hrtimer_start(&alarm->timer, alarm->node.expires, HRTIMER_MODE_ABS);
+	hrtimer_start_range_ns(&alarm->timer, alarm->node.expires,
+			       ktime_to_ns(alarm->window), HRTIMER_MODE_ABS);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(alarm_start);
@@ -461,7 +547,8 @@ void alarm_restart(struct alarm *alarm)
 	unsigned long flags;
 
 	spin_lock_irqsave(&base->lock, flags);
-	hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+	hrtimer_set_expires_range(&alarm->timer, alarm->node.expires,
+				  alarm->window);
 	hrtimer_restart(&alarm->timer);
 	alarmtimer_enqueue(base, alarm);
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -991,3 +1078,50 @@ out_if:
 	return error;
 }
 device_initcall(alarmtimer_init);
+
+#if defined(CONFIG_RTC_CLASS) && defined(CONFIG_DEBUG_FS)
+static int alarm_wakeups_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	spin_lock_irq(&alarm_stats_lock);
+	seq_printf(s, "rtc_programmed %u\nrtc_reused %u\n",
+		   alarm_rtc_programmed, alarm_rtc_reused);
+	seq_puts(s, "# wakeups source\n");
+	for (i = 0; i < ALARM_WAKEUP_STATS_NR; i++) {
+		if (!alarm_wakeup_stats[i].count)
+			break;
+		if (alarm_wakeup_stats[i].fn)
+			seq_printf(s, "%u %pf\n", alarm_wakeup_stats[i].count,
+				   alarm_wakeup_stats[i].fn);
+		else
+			seq_printf(s, "%u nanosleep\n",
+				   alarm_wakeup_stats[i].count);
+	}
+	if (alarm_wakeup_other)
+		seq_printf(s, "%u other\n", alarm_wakeup_other);
+	spin_unlock_irq(&alarm_stats_lock);
+
+	return 0;
+}
+
+static int alarm_wakeups_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alarm_wakeups_show, NULL);
+}
+
+static const struct file_operations alarm_wakeups_fops = {
+	.open		= alarm_wakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init alarm_wakeups_debugfs_init(void)
+{
+	debugfs_create_file("alarm_wakeups", S_IRUGO, NULL, NULL,
+			    &alarm_wakeups_fops);
+	return 0;
+}
+late_initcall(alarm_wakeups_debugfs_init);
+#endif
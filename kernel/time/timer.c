@@ -43,6 +43,9 @@
 #include <linux/slab.h>
 #include <linux/compat.h>
 #include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/moduleparam.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -99,6 +102,22 @@ static inline void __run_timers(struct tvec_base *base);
 
 static DEFINE_PER_CPU(struct tvec_base, tvec_bases);
 
+/*
+ * Timers without an explicit slack may expire up to delay >> shift jiffies
+ * late so that they line up with other timers. The default of 8 allows
+ * 0.4%; lowering it, e.g. to 3 for 12.5%, coalesces far more wakeups.
+ */
+static unsigned int timer_slack_shift = 8;
+core_param(timer_slack_shift, timer_slack_shift, uint, 0644);
+
+/* per cpu timer coalescing counters, see timer_coalesce_stats in debugfs */
+struct timer_coalesce_stats {
+	unsigned long slack_moved;	/* expiry moved by apply_slack() */
+	unsigned long expired;		/* timers run */
+	unsigned long batched;		/* run in the same jiffy as another */
+};
+static DEFINE_PER_CPU(struct timer_coalesce_stats, timer_coalesce_stats);
+
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
 unsigned int sysctl_timer_migration = 1;
 
@@ -885,6 +904,7 @@ static inline
 unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 {
 	unsigned long expires_limit, mask;
+	unsigned int shift;
 	int bit;
 
 	if (timer->slack >= 0) {
@@ -892,10 +912,11 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	} else {
 		long delta = expires - jiffies;
 
-		if (delta < 256)
+		shift = READ_ONCE(timer_slack_shift);
+		if (delta <= 0 || !(delta >> shift))
 			return expires;
 
-		expires_limit = expires + delta / 256;
+		expires_limit = expires + (delta >> shift);
 	}
 	mask = expires ^ expires_limit;
 	if (mask == 0)
@@ -907,6 +928,9 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 
 	expires_limit = expires_limit & ~(mask);
 
+	if (expires_limit != expires)
+		this_cpu_inc(timer_coalesce_stats.slack_moved);
+
 	return expires_limit;
 }
 
@@ -1231,6 +1255,7 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 static inline void __run_timers(struct tvec_base *base)
 {
 	struct timer_list *timer;
+	unsigned int nr_run;
 
 	spin_lock_irq(&base->lock);
 
@@ -1256,11 +1281,16 @@ static inline void __run_timers(struct tvec_base *base)
 			cascade(base, &base->tv5, INDEX(3));
 		++base->timer_jiffies;
 		hlist_move_list(base->tv1.vec + index, head);
+		nr_run = 0;
 		while (!hlist_empty(head)) {
 			void (*fn)(unsigned long);
 			unsigned long data;
 			bool irqsafe;
 
+			if (nr_run++)
+				this_cpu_inc(timer_coalesce_stats.batched);
+			this_cpu_inc(timer_coalesce_stats.expired);
+
 			timer = hlist_entry(head->first, struct timer_list, entry);
 			fn = timer->function;
 			data = timer->data;
@@ -1793,3 +1823,54 @@ void __sched usleep_range(unsigned long min, unsigned long max)
 	}
 }
 EXPORT_SYMBOL(usleep_range);
+
+#ifdef CONFIG_DEBUG_FS
+static int timer_coalesce_show(struct seq_file *s, void *unused)
+{
+	struct timer_coalesce_stats *st;
+	int cpu;
+
+	seq_puts(s, "# cpu slack_moved expired batched\n");
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(&timer_coalesce_stats, cpu);
+		seq_printf(s, "%d %lu %lu %lu\n", cpu, st->slack_moved,
+			   st->expired, st->batched);
+	}
+
+	return 0;
+}
+
+static int timer_coalesce_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, timer_coalesce_show, NULL);
+}
+
+static ssize_t timer_coalesce_write(struct file *file,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&timer_coalesce_stats, cpu), 0,
+		       sizeof(struct timer_coalesce_stats));
+
+	return count;
+}
+
+static const struct file_operations timer_coalesce_fops = {
+	.open		= timer_coalesce_open,
+	.read		= seq_read,
+	.write		= timer_coalesce_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init timer_coalesce_debugfs_init(void)
+{
+	debugfs_create_file("timer_coalesce_stats", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &timer_coalesce_fops);
+	return 0;
+}
+late_initcall(timer_coalesce_debugfs_init);
+#endif
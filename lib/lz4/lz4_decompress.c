@@ -182,6 +182,10 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 	BYTE * const oend = op + maxoutputsize;
 	BYTE *cpy;
 
+	/* room needed to take the short sequence path below blindly */
+	const BYTE *const shortiend = iend - (RUN_MASK - 1) - 2;
+	BYTE *const shortoend = oend - (RUN_MASK - 1) - (ML_MASK - 1 + MINMATCH);
+
 	/* Main Loop */
 	while (ip < iend) {
 
@@ -191,6 +195,38 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 		/* get runlength */
 		token = *ip++;
 		length = (token >> ML_BITS);
+
+		/*
+		 * Most sequences are at most 14 literals followed by a match
+		 * of at most 18 bytes. When both buffers have room for that,
+		 * copy 16 bytes of literals and 18 bytes of match in fixed
+		 * size steps instead of running the length checks and byte
+		 * loops. Only matches at an offset of at least 8 can be
+		 * copied this way, anything else continues on the slow path
+		 * with the offset already decoded.
+		 */
+		if (length != RUN_MASK &&
+		    likely((ip < shortiend) & (op <= shortoend))) {
+			PUT8(ip, op);
+			PUT8(ip + 8, op + 8);
+			op += length;
+			ip += length;
+
+			length = token & ML_MASK;
+			LZ4_READ_LITTLEENDIAN_16(ref, op, ip);
+			ip += 2;
+			if (length != ML_MASK && op - ref >= 8 &&
+			    ref >= (BYTE * const) dest) {
+				PUT8(ref, op);
+				PUT8(ref + 8, op + 8);
+				op[16] = ref[16];
+				op[17] = ref[17];
+				op += length + MINMATCH;
+				continue;
+			}
+			goto _copy_match;
+		}
+
 		if (length == RUN_MASK) {
 			int s = 255;
 			while ((ip < iend) && (s == 255)) {
@@ -225,6 +261,7 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 		/* get offset */
 		LZ4_READ_LITTLEENDIAN_16(ref, cpy, ip);
 		ip += 2;
+_copy_match:
 		if (ref < (BYTE * const) dest)
 			goto _output_error;
 			/*
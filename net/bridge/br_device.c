@@ -104,9 +104,17 @@ static int br_dev_init(struct net_device *dev)
 	if (!br->stats)
 		return -ENOMEM;
 
+	br->fwd_cache = alloc_percpu(struct br_fwd_cache);
+	if (!br->fwd_cache) {
+		free_percpu(br->stats);
+		return -ENOMEM;
+	}
+
 	err = br_vlan_init(br);
-	if (err)
+	if (err) {
+		free_percpu(br->fwd_cache);
 		free_percpu(br->stats);
+	}
 	br_set_lockdep_class(dev);
 
 	return err;
@@ -362,6 +370,7 @@ static void br_dev_free(struct net_device *dev)
 {
 	struct net_bridge *br = netdev_priv(dev);
 
+	free_percpu(br->fwd_cache);
 	free_percpu(br->stats);
 	free_netdev(dev);
 }
@@ -154,6 +154,8 @@ static void fdb_delete(struct net_bridge *br, struct net_bridge_fdb_entry *f)
 		fdb_del_external_learn(f);
 
 	hlist_del_rcu(&f->hlist);
+	/* drop it from the forwarding caches before it can be freed */
+	WRITE_ONCE(br->fdb_gen, br->fdb_gen + 1);
 	fdb_notify(br, f, RTM_DELNEIGH);
 	call_rcu(&f->rcu, fdb_rcu_free);
 }
@@ -390,6 +392,48 @@ struct net_bridge_fdb_entry *__br_fdb_get(struct net_bridge *br,
 	return NULL;
 }
 
+/*
+ * Like __br_fdb_get(), but try this CPU's last forwarding destination
+ * first. Entries are freed an RCU grace period after fdb_delete() bumped
+ * br->fdb_gen, so a cached entry with the current generation is still
+ * live. Local entries are not cached.
+ */
+struct net_bridge_fdb_entry *br_fdb_get_cached(struct net_bridge *br,
+					       const unsigned char *addr,
+					       __u16 vid)
+{
+	struct br_fwd_cache *c = this_cpu_ptr(br->fwd_cache);
+	unsigned int gen = READ_ONCE(br->fdb_gen);
+	struct net_bridge_fdb_entry *fdb = c->fdb;
+
+	if (likely(fdb && c->gen == gen && fdb->vlan_id == vid &&
+		   ether_addr_equal(fdb->addr.addr, addr) &&
+		   !has_expired(br, fdb))) {
+		c->hits++;
+		return fdb;
+	}
+
+	c->misses++;
+	fdb = __br_fdb_get(br, addr, vid);
+	c->fdb = (fdb && !fdb->is_local) ? fdb : NULL;
+	c->gen = gen;
+	return fdb;
+}
+
+void br_fwd_cache_stats(struct net_bridge *br, unsigned long *hits,
+			unsigned long *misses)
+{
+	int cpu;
+
+	*hits = *misses = 0;
+	for_each_possible_cpu(cpu) {
+		const struct br_fwd_cache *c = per_cpu_ptr(br->fwd_cache, cpu);
+
+		*hits += c->hits;
+		*misses += c->misses;
+	}
+}
+
 #if IS_ENABLED(CONFIG_ATM_LANE)
 /* Interface used by ATM LANE hook to test
  * if an addr is on some other bridge port */
@@ -591,7 +635,9 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 				fdb->dst = source;
 				fdb_modified = true;
 			}
-			fdb->updated = jiffies;
+			/* avoid dirtying the entry's cache line every frame */
+			if (fdb->updated != jiffies)
+				fdb->updated = jiffies;
 			if (unlikely(added_by_user))
 				fdb->added_by_user = 1;
 			if (unlikely(fdb_modified))
@@ -185,7 +185,7 @@ int br_handle_frame_finish(struct net *net, struct sock *sk, struct sk_buff *skb
 
 		unicast = false;
 		br->dev->stats.multicast++;
-	} else if ((dst = __br_fdb_get(br, dest, vid)) &&
+	} else if ((dst = br_fdb_get_cached(br, dest, vid)) &&
 			dst->is_local) {
 		skb2 = skb;
 		/* Do not forward the packet since it's local. */
@@ -194,7 +194,8 @@ int br_handle_frame_finish(struct net *net, struct sock *sk, struct sk_buff *skb
 
 	if (skb) {
 		if (dst) {
-			dst->used = jiffies;
+			if (dst->used != jiffies)
+				dst->used = jiffies;
 			br_forward(dst->dst, skb, skb2);
 		} else
 			br_flood_forward(br, skb, skb2, unicast);
@@ -249,6 +249,18 @@ static inline struct net_bridge_port *br_port_get_rtnl(const struct net_device *
 		rtnl_dereference(dev->rx_handler_data) : NULL;
 }
 
+/*
+ * Per CPU memory of the last unicast destination forwarded to, so that a
+ * stream of frames to one station skips the hash walk. @gen is the value
+ * of br->fdb_gen when @fdb was looked up.
+ */
+struct br_fwd_cache {
+	struct net_bridge_fdb_entry	*fdb;
+	unsigned int			gen;
+	unsigned long			hits;
+	unsigned long			misses;
+};
+
 struct net_bridge
 {
 	spinlock_t			lock;
@@ -258,6 +270,9 @@ struct net_bridge
 	struct pcpu_sw_netstats		__percpu *stats;
 	spinlock_t			hash_lock;
 	struct hlist_head		hash[BR_HASH_SIZE];
+	/* bumped under hash_lock whenever an fdb entry is deleted */
+	unsigned int			fdb_gen;
+	struct br_fwd_cache		__percpu *fwd_cache;
 #if IS_ENABLED(CONFIG_BRIDGE_NETFILTER)
 	union {
 		struct rtable		fake_rtable;
@@ -460,6 +475,11 @@ void br_fdb_delete_by_port(struct net_bridge *br,
 			   const struct net_bridge_port *p, u16 vid, int do_all);
 struct net_bridge_fdb_entry *__br_fdb_get(struct net_bridge *br,
 					  const unsigned char *addr, __u16 vid);
+struct net_bridge_fdb_entry *br_fdb_get_cached(struct net_bridge *br,
+					       const unsigned char *addr,
+					       __u16 vid);
+void br_fwd_cache_stats(struct net_bridge *br, unsigned long *hits,
+			unsigned long *misses);
 int br_fdb_test_addr(struct net_device *dev, unsigned char *addr);
 int br_fdb_fillbuf(struct net_bridge *br, void *buf, unsigned long count,
 		   unsigned long off);
@@ -260,6 +260,26 @@ static ssize_t hello_timer_show(struct device *d,
 }
 static DEVICE_ATTR_RO(hello_timer);
 
+static ssize_t fwd_cache_hits_show(struct device *d,
+				   struct device_attribute *attr, char *buf)
+{
+	unsigned long hits, misses;
+
+	br_fwd_cache_stats(to_bridge(d), &hits, &misses);
+	return sprintf(buf, "%lu\n", hits);
+}
+static DEVICE_ATTR_RO(fwd_cache_hits);
+
+static ssize_t fwd_cache_misses_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	unsigned long hits, misses;
+
+	br_fwd_cache_stats(to_bridge(d), &hits, &misses);
+	return sprintf(buf, "%lu\n", misses);
+}
+static DEVICE_ATTR_RO(fwd_cache_misses);
+
 static ssize_t tcn_timer_show(struct device *d, struct device_attribute *attr,
 			      char *buf)
 {
@@ -770,6 +790,8 @@ static struct attribute *bridge_attrs[] = {
 	&dev_attr_gc_timer.attr,
 	&dev_attr_group_addr.attr,
 	&dev_attr_flush.attr,
+	&dev_attr_fwd_cache_hits.attr,
+	&dev_attr_fwd_cache_misses.attr,
 #ifdef CONFIG_BRIDGE_IGMP_SNOOPING
 	&dev_attr_multicast_router.attr,
 	&dev_attr_multicast_snooping.attr,
@@ -31,6 +31,7 @@
 #include <linux/ipc_router.h>
 #include <linux/ipc_router_xprt.h>
 #include <linux/kref.h>
+#include <linux/rculist.h>
 #include <soc/qcom/subsystem_notif.h>
 #include <soc/qcom/subsystem_restart.h>
 
@@ -71,6 +72,9 @@ if (msm_ipc_router_debug_mask & RTR_DBG) \
 static LIST_HEAD(control_ports);
 static DECLARE_RWSEM(control_ports_lock_lha5);
 
+/* Local ports and routing table entries are looked up under RCU on the
+ * data path. The rwsems serialize the writers only.
+ */
 #define LP_HASH_SIZE 32
 static struct list_head local_ports[LP_HASH_SIZE];
 static DECLARE_RWSEM(local_ports_lock_lhc2);
@@ -156,6 +160,7 @@ struct msm_ipc_router_xprt_info {
 struct msm_ipc_routing_table_entry {
 	struct list_head list;
 	struct kref ref;
+	struct rcu_head rcu;
 	uint32_t node_id;
 	uint32_t neighbor_node_id;
 	struct list_head remote_port_list[RP_HASH_SIZE];
@@ -440,14 +445,14 @@ static void ipc_router_log_msg(void *log_ctx, uint32_t xchng_type,
 	}
 }
 
-/* Must be called with routing_table_lock_lha3 locked. */
+/* Must be called with routing_table_lock_lha3 locked or under RCU. */
 static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t node_id)
 {
 	uint32_t key = (node_id % RT_HASH_SIZE);
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	list_for_each_entry(rt_entry, &routing_table[key], list) {
+	list_for_each_entry_rcu(rt_entry, &routing_table[key], list) {
 		if (rt_entry->node_id == node_id)
 			return rt_entry;
 	}
@@ -491,7 +496,7 @@ static struct msm_ipc_routing_table_entry *create_routing_table_entry(
 		rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 
 	key = (node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	list_add_tail_rcu(&rt_entry->list, &routing_table[key]);
 out_create_rtentry1:
 	kref_get(&rt_entry->ref);
 out_create_rtentry2:
@@ -513,11 +518,11 @@ static struct msm_ipc_routing_table_entry *ipc_router_get_rtentry_ref(
 {
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	down_read(&routing_table_lock_lha3);
+	rcu_read_lock();
 	rt_entry = lookup_routing_table(node_id);
-	if (rt_entry)
-		kref_get(&rt_entry->ref);
-	up_read(&routing_table_lock_lha3);
+	if (rt_entry && !kref_get_unless_zero(&rt_entry->ref))
+		rt_entry = NULL;
+	rcu_read_unlock();
 	return rt_entry;
 }
 
@@ -536,9 +541,10 @@ void ipc_router_release_rtentry(struct kref *ref)
 	/*
 	 * All references to a routing entry will be put only under SSR.
 	 * As part of SSR, all the internals of the routing table entry
-	 * are cleaned. So just free the routing table entry.
+	 * are cleaned. So just free the routing table entry once the
+	 * lockless lookups are done with it.
 	 */
-	kfree(rt_entry);
+	kfree_rcu(rt_entry, rcu);
 }
 
 struct rr_packet *rr_read(struct msm_ipc_router_xprt_info *xprt_info)
@@ -1308,7 +1314,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	down_write(&local_ports_lock_lhc2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	up_write(&local_ports_lock_lhc2);
 }
 
@@ -1385,15 +1391,16 @@ static struct msm_ipc_port *ipc_router_get_port_ref(uint32_t port_id)
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	down_read(&local_ports_lock_lhc2);
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
+	rcu_read_lock();
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
-			kref_get(&port_ptr->ref);
-			up_read(&local_ports_lock_lhc2);
+			if (!kref_get_unless_zero(&port_ptr->ref))
+				break;
+			rcu_read_unlock();
 			return port_ptr;
 		}
 	}
-	up_read(&local_ports_lock_lhc2);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -1418,7 +1425,7 @@ void ipc_router_release_port(struct kref *ref)
 	wakeup_source_unregister(port_ptr->port_rx_ws);
 	if (port_ptr->endpoint)
 		sock_put(ipc_port_sk(port_ptr->endpoint));
-	kfree(port_ptr);
+	kfree_rcu(port_ptr, rcu);
 }
 
 /**
@@ -2281,7 +2288,7 @@ static void msm_ipc_cleanup_routing_table(
 			cleanup_rmt_ports(xprt_info, rt_entry);
 			rt_entry->xprt_info = NULL;
 			up_write(&rt_entry->lock_lha4);
-			list_del(&rt_entry->list);
+			list_del_rcu(&rt_entry->list);
 			kref_put(&rt_entry->ref, ipc_router_release_rtentry);
 		}
 	}
@@ -3522,7 +3529,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 
 		mutex_lock(&port_ptr->port_lock_lhc3);
@@ -3557,7 +3564,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 		signal_irsc_completion();
 	}
@@ -3612,8 +3619,10 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	down_write(&local_ports_lock_lhc2);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	up_write(&local_ports_lock_lhc2);
+	/* Let lockless lookups walk off the entry before it is relinked. */
+	synchronize_rcu();
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -4103,7 +4112,9 @@ static int msm_ipc_router_add_xprt(struct msm_ipc_router_xprt *xprt)
 	if (xprt->get_ws_info)
 		xprt_info->dynamic_ws = xprt->get_ws_info(xprt);
 
-	xprt_info->workqueue = create_singlethread_workqueue(xprt->name);
+	/* Ordered, so packets of one XPRT are still handled in sequence */
+	xprt_info->workqueue = alloc_ordered_workqueue("%s",
+				WQ_MEM_RECLAIM | WQ_HIGHPRI, xprt->name);
 	if (!xprt_info->workqueue) {
 		kfree(xprt_info);
 		return -ENOMEM;
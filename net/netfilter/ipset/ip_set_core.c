@@ -324,15 +324,77 @@ ip_set_get_ipaddr6(struct nlattr *nla, union nf_inet_addr *ipaddr)
 }
 EXPORT_SYMBOL_GPL(ip_set_get_ipaddr6);
 
+/* Called from the add paths, protected by the set spinlock. A new element
+ * gets zeroed counters, given values are set on the local CPU.
+ */
+void
+ip_set_init_counter(struct ip_set_counter *counter,
+		    const struct ip_set_ext *ext)
+{
+	struct ip_set_counter_rcu *c = rcu_dereference_protected(counter->c, 1);
+	struct ip_set_counter_pcpu *local;
+	int cpu;
+
+	if (!c) {
+		c = kmalloc(sizeof(*c), GFP_ATOMIC);
+		if (unlikely(!c))
+			return;
+		c->pcpu = alloc_percpu_gfp(struct ip_set_counter_pcpu,
+					   GFP_ATOMIC);
+		if (unlikely(!c->pcpu)) {
+			kfree(c);
+			return;
+		}
+		rcu_assign_pointer(counter->c, c);
+	}
+
+	local = per_cpu_ptr(c->pcpu, smp_processor_id());
+	if (ext->bytes != ULLONG_MAX) {
+		for_each_possible_cpu(cpu)
+			per_cpu_ptr(c->pcpu, cpu)->bytes = 0;
+		local->bytes = ext->bytes;
+	}
+	if (ext->packets != ULLONG_MAX) {
+		for_each_possible_cpu(cpu)
+			per_cpu_ptr(c->pcpu, cpu)->packets = 0;
+		local->packets = ext->packets;
+	}
+}
+EXPORT_SYMBOL_GPL(ip_set_init_counter);
+
+static void
+ip_set_counter_free_rcu(struct rcu_head *head)
+{
+	struct ip_set_counter_rcu *c =
+		container_of(head, struct ip_set_counter_rcu, rcu);
+
+	free_percpu(c->pcpu);
+	kfree(c);
+}
+
+/* Same calling context as ip_set_comment_free() */
+void
+ip_set_counter_free(struct ip_set_counter *counter)
+{
+	struct ip_set_counter_rcu *c = rcu_dereference_protected(counter->c, 1);
+
+	if (unlikely(!c))
+		return;
+	RCU_INIT_POINTER(counter->c, NULL);
+	call_rcu(&c->rcu, ip_set_counter_free_rcu);
+}
+EXPORT_SYMBOL_GPL(ip_set_counter_free);
+
 typedef void (*destroyer)(void *);
 /* ipset data extension types, in size order */
 
 const struct ip_set_ext_type ip_set_extensions[] = {
 	[IPSET_EXT_ID_COUNTER] = {
-		.type	= IPSET_EXT_COUNTER,
-		.flag	= IPSET_FLAG_WITH_COUNTERS,
-		.len	= sizeof(struct ip_set_counter),
-		.align	= __alignof__(struct ip_set_counter),
+		.type	 = IPSET_EXT_COUNTER | IPSET_EXT_DESTROY,
+		.flag	 = IPSET_FLAG_WITH_COUNTERS,
+		.len	 = sizeof(struct ip_set_counter),
+		.align	 = __alignof__(struct ip_set_counter),
+		.destroy = (destroyer) ip_set_counter_free,
 	},
 	[IPSET_EXT_ID_TIMEOUT] = {
 		.type	= IPSET_EXT_TIMEOUT,
@@ -2088,6 +2150,8 @@ ip_set_fini(void)
 	unregister_pernet_subsys(&ip_set_net_ops);
 	nf_unregister_sockopt(&so_set);
 	nfnetlink_subsys_unregister(&ip_set_netlink_subsys);
+	/* Wait for the counters freed by ip_set_counter_free() */
+	rcu_barrier();
 	pr_debug("these are the famous last words\n");
 }
 
@@ -67,6 +67,13 @@ unsigned int upper_byte_limit __read_mostly = 10500;
 module_param(upper_byte_limit, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(upper_byte_limit, "Upper byte limit");
 
+unsigned int gro_flush_per_aggregate __read_mostly = 1;
+module_param(gro_flush_per_aggregate, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(gro_flush_per_aggregate, "Flush GRO once per MAP aggregate");
+
+/* Set while the packets of one aggregate are being delivered */
+static DEFINE_PER_CPU(bool, rmnet_in_deaggregation);
+
 #define RMNET_DATA_IP_VERSION_4 0x40
 #define RMNET_DATA_IP_VERSION_6 0x60
 
@@ -357,7 +364,9 @@ static rx_handler_result_t __rmnet_deliver_skb(struct sk_buff *skb,
 					skb_size = skb->len;
 					gro_res = napi_gro_receive(napi, skb);
 					trace_rmnet_gro_downlink(gro_res);
-					rmnet_optional_gro_flush(
+					if (!__this_cpu_read(
+						rmnet_in_deaggregation))
+						rmnet_optional_gro_flush(
 								napi, ep,
 								skb_size);
 				} else {
@@ -490,7 +499,7 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	/* Subtract MAP header */
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	pskb_trim(skb, len);
 	__rmnet_data_set_skb_proto(skb);
 	return __rmnet_deliver_skb(skb, ep);
 }
@@ -512,15 +521,28 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 static rx_handler_result_t rmnet_map_ingress_handler(struct sk_buff *skb,
 					   struct rmnet_phys_ep_config *config)
 {
+	struct napi_struct *napi;
 	struct sk_buff *skbn;
 	int rc, co = 0;
 
 	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_DEAGGREGATION) {
 		trace_rmnet_start_deaggregation(skb);
+		/*
+		 * Let GRO coalesce across the whole aggregate and flush once
+		 * at its end rather than on the per-packet time heuristic.
+		 */
+		if (gro_flush_per_aggregate)
+			__this_cpu_write(rmnet_in_deaggregation, true);
 		while ((skbn = rmnet_map_deaggregate(skb, config)) != 0) {
 			_rmnet_map_ingress_handler(skbn, config);
 			co++;
 		}
+		if (__this_cpu_read(rmnet_in_deaggregation)) {
+			__this_cpu_write(rmnet_in_deaggregation, false);
+			napi = get_current_napi_context();
+			if (napi)
+				napi_gro_flush(napi, false);
+		}
 		trace_rmnet_end_deaggregation(skb, co);
 		LOGD("De-aggregated %d packets", co);
 		rmnet_stats_deagg_pkts(co);
@@ -53,6 +53,12 @@ unsigned long int agg_count[RMNET_STATS_AGG_MAX];
 module_param_array(agg_count, ulong, 0, S_IRUGO);
 MODULE_PARM_DESC(agg_count, "SKBs Aggregated");
 
+/* Packets per aggregate: 1, 2, 3-4, 5-8, 9-16, 17-32, 33 and up */
+#define RMNET_STATS_AGG_HIST_MAX 7
+unsigned long int agg_size_hist[RMNET_STATS_AGG_HIST_MAX];
+module_param_array(agg_size_hist, ulong, 0, S_IRUGO);
+MODULE_PARM_DESC(agg_size_hist, "Histogram of packets per UL aggregate");
+
 static DEFINE_SPINLOCK(rmnet_checksum_dl_stats);
 unsigned long int checksum_dl_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
 module_param_array(checksum_dl_stats, ulong, 0, S_IRUGO);
@@ -109,9 +115,14 @@ void rmnet_stats_agg_pkts(int aggcount)
 {
 	unsigned long flags;
 
+	int bucket = aggcount > 1 ? ilog2(aggcount - 1) + 1 : 0;
+
+	bucket = min(bucket, RMNET_STATS_AGG_HIST_MAX - 1);
+
 	spin_lock_irqsave(&rmnet_agg_count, flags);
 	agg_count[RMNET_STATS_AGG_BUFF]++;
 	agg_count[RMNET_STATS_AGG_PKT] += aggcount;
+	agg_size_hist[bucket]++;
 	spin_unlock_irqrestore(&rmnet_agg_count, flags);
 }
 
@@ -50,6 +50,8 @@ enum rmnet_queue_xmit_e {
 	RMNET_STATS_QUEUE_XMIT_AGG_TIMEOUT,
 	RMNET_STATS_QUEUE_XMIT_AGG_CPY_EXP_FAIL,
 	RMNET_STATS_QUEUE_XMIT_AGG_SKIP,
+	RMNET_STATS_QUEUE_XMIT_AGG_PENDING_BYTES,
+	RMNET_STATS_QUEUE_XMIT_AGG_TX_IDLE,
 	RMNET_STATS_QUEUE_XMIT_MAX
 };
 
@@ -50,6 +50,22 @@ long agg_bypass_time __read_mostly = 10000000L;
 module_param(agg_bypass_time, long, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(agg_bypass_time, "Skip agg when apart spaced more than this");
 
+unsigned int agg_flush_mode __read_mostly;
+module_param(agg_flush_mode, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(agg_flush_mode, "UL agg flush: 0-timer, 1-pending bytes and TX queue feedback");
+
+unsigned int agg_flush_bytes __read_mostly = 8192;
+module_param(agg_flush_bytes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(agg_flush_bytes, "Pending bytes that flush the agg buf in flush mode 1");
+
+unsigned int deagg_zero_copy __read_mostly = 1;
+module_param(deagg_zero_copy, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(deagg_zero_copy, "Deaggregate into page fragments of the aggregate");
+
+unsigned int deagg_csum __read_mostly = 1;
+module_param(deagg_csum, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(deagg_csum, "Checksum packets while copying them out without a trailer");
+
 
 struct agg_work {
 	struct delayed_work work;
@@ -58,6 +74,8 @@ struct agg_work {
 
 #define RMNET_MAP_DEAGGR_SPACING  64
 #define RMNET_MAP_DEAGGR_HEADROOM (RMNET_MAP_DEAGGR_SPACING/2)
+/* Covers the MAP header and the largest IPv4 and TCP headers */
+#define RMNET_MAP_DEAGGR_COPYBREAK 128
 /******************************************************************************/
 
 /**
@@ -123,6 +141,8 @@ done:
  * @config:     Physical endpoint configuration of the ingress device
  *
  * A whole new buffer is allocated for each portion of an aggregated frame.
+ * If the aggregate sits in a page fragment, only the headers are copied and
+ * the payload is attached as a fragment of the same page instead.
  * Caller should keep calling deaggregate() on the source skb until 0 is
  * returned, indicating that there are no more packets to deaggregate. Caller
  * is responsible for freeing the original skb.
@@ -131,6 +151,60 @@ done:
  *     - Pointer to new skb
  *     - 0 (null) if no more aggregated packets
  */
+static struct sk_buff *rmnet_map_deaggregate_frag(struct sk_buff *skb,
+						  uint32_t packet_len)
+{
+	struct page *page = virt_to_head_page(skb->data);
+	unsigned int hlen = RMNET_MAP_DEAGGR_COPYBREAK;
+	unsigned int offset;
+	struct sk_buff *skbn;
+
+	skbn = alloc_skb(hlen + RMNET_MAP_DEAGGR_SPACING, GFP_ATOMIC);
+	if (!skbn)
+		return 0;
+
+	skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
+	memcpy(skb_put(skbn, hlen), skb->data, hlen);
+
+	offset = skb->data + hlen - (unsigned char *)page_address(page);
+	get_page(page);
+	skb_add_rx_frag(skbn, 0, page, offset, packet_len - hlen,
+			packet_len - hlen);
+	return skbn;
+}
+
+/*
+ * Copy one MAP frame out of the aggregate. Without a checksum trailer the
+ * stack would otherwise checksum the whole payload again, so the IP packet
+ * is checksummed as it is copied and handed up as CHECKSUM_COMPLETE.
+ */
+static void rmnet_map_deaggregate_copy(struct sk_buff *skbn,
+				       struct sk_buff *skb,
+				       uint32_t packet_len,
+				       struct rmnet_phys_ep_config *config)
+{
+	struct rmnet_map_header_s *maph = (struct rmnet_map_header_s *)skb->data;
+	unsigned int hlen = sizeof(struct rmnet_map_header_s);
+	unsigned char *dst = skb_put(skbn, packet_len);
+	int ip_len;
+
+	ip_len = ntohs(maph->pkt_len) - maph->pad_len - config->tail_spacing;
+
+	if (!deagg_csum || maph->cd_bit || ip_len <= 0 ||
+	    (config->ingress_data_format & (RMNET_INGRESS_FORMAT_MAP_CKSUMV3 |
+					    RMNET_INGRESS_FORMAT_MAP_CKSUMV4))) {
+		memcpy(dst, skb->data, packet_len);
+		return;
+	}
+
+	memcpy(dst, skb->data, hlen);
+	skbn->csum = csum_partial_copy_nocheck(skb->data + hlen, dst + hlen,
+					       ip_len, 0);
+	skbn->ip_summed = CHECKSUM_COMPLETE;
+	memcpy(dst + hlen + ip_len, skb->data + hlen + ip_len,
+	       packet_len - hlen - ip_len);
+}
+
 struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 				      struct rmnet_phys_ep_config *config)
 {
@@ -153,14 +227,22 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 		return 0;
 	}
 
-	skbn = alloc_skb(packet_len + RMNET_MAP_DEAGGR_SPACING, GFP_ATOMIC);
+	if (deagg_zero_copy && skb->head_frag && !skb_is_nonlinear(skb) &&
+	    !maph->cd_bit && packet_len > RMNET_MAP_DEAGGR_COPYBREAK) {
+		skbn = rmnet_map_deaggregate_frag(skb, packet_len);
+	} else {
+		skbn = alloc_skb(packet_len + RMNET_MAP_DEAGGR_SPACING,
+				 GFP_ATOMIC);
+		if (!skbn)
+			return 0;
+
+		skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
+		rmnet_map_deaggregate_copy(skbn, skb, packet_len, config);
+	}
 	if (!skbn)
 		return 0;
 
 	skbn->dev = skb->dev;
-	skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
-	skb_put(skbn, packet_len);
-	memcpy(skbn->data, skb->data, packet_len);
 	skb_pull(skb, packet_len);
 
 
@@ -233,6 +315,53 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
  * protocol is used to separate the packets in the buffer. This funcion consumes
  * the argument SKB and should not be further processed by any other function.
  */
+/**
+ * rmnet_map_agg_tx_idle() - Check whether the device has nothing in flight
+ * @skb:        Aggregation buffer, queued on the physical device
+ *
+ * Uses the byte queue limits of the TX queue: once everything queued to the
+ * hardware has completed, holding the buffer back only adds latency. Devices
+ * that do not report to BQL are never considered idle.
+ */
+static bool rmnet_map_agg_tx_idle(struct sk_buff *skb)
+{
+#ifdef CONFIG_BQL
+	struct netdev_queue *txq;
+
+	txq = netdev_get_tx_queue(skb->dev, skb_get_queue_mapping(skb));
+	if (netif_xmit_stopped(txq))
+		return false;
+
+	return txq->dql.num_queued &&
+	       txq->dql.num_queued == txq->dql.num_completed;
+#else
+	return false;
+#endif
+}
+
+/**
+ * rmnet_map_agg_flush_reason() - Decide whether to send the buffer now
+ * @config:     Physical endpoint configuration with a pending buffer
+ *
+ * Return:
+ *      - RMNET_STATS_QUEUE_XMIT_* reason to flush with
+ *      - 0 to keep aggregating
+ */
+static unsigned int rmnet_map_agg_flush_reason(
+	struct rmnet_phys_ep_config *config)
+{
+	if (!agg_flush_mode)
+		return 0;
+
+	if (config->agg_skb->len >= agg_flush_bytes)
+		return RMNET_STATS_QUEUE_XMIT_AGG_PENDING_BYTES;
+
+	if (rmnet_map_agg_tx_idle(config->agg_skb))
+		return RMNET_STATS_QUEUE_XMIT_AGG_TX_IDLE;
+
+	return 0;
+}
+
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_config *config) {
 	uint8_t *dest_buff;
@@ -241,6 +370,7 @@ void rmnet_map_aggregate(struct sk_buff *skb,
 	struct sk_buff *agg_skb;
 	struct timespec diff, last;
 	int size, rc, agg_count = 0;
+	unsigned int reason;
 
 
 	if (!skb || !config)
@@ -322,6 +452,21 @@ new_packet:
 	rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
 
 schedule:
+	reason = rmnet_map_agg_flush_reason(config);
+	if (reason) {
+		rmnet_stats_agg_pkts(config->agg_count);
+		agg_skb = config->agg_skb;
+		agg_count = config->agg_count;
+		config->agg_skb = 0;
+		config->agg_count = 0;
+		memset(&(config->agg_time), 0, sizeof(struct timespec));
+		spin_unlock_irqrestore(&config->agg_lock, flags);
+		trace_rmnet_map_flush_packet_queue(agg_skb, agg_count);
+		rc = dev_queue_xmit(agg_skb);
+		rmnet_stats_queue_xmit(rc, reason);
+		return;
+	}
+
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
 		work = kmalloc(sizeof(*work), GFP_ATOMIC);
 		if (!work) {
@@ -590,7 +735,7 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
  */
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 {
-	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer;
+	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer, trailer;
 	unsigned int data_len;
 	unsigned char *map_payload;
 	unsigned char ip_version;
@@ -601,9 +746,12 @@ int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 	    sizeof(struct rmnet_map_dl_checksum_trailer_s))))
 		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
-	cksum_trailer = (struct rmnet_map_dl_checksum_trailer_s *)
-			(skb->data + data_len
-			+ sizeof(struct rmnet_map_header_s));
+	/* the trailer may be in a page fragment, see rmnet_map_deaggregate() */
+	cksum_trailer = skb_header_pointer(skb, data_len +
+			sizeof(struct rmnet_map_header_s),
+			sizeof(trailer), &trailer);
+	if (unlikely(!cksum_trailer))
+		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
 	if (unlikely(!ntohs(cksum_trailer->valid)))
 		return RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET;
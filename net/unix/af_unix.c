@@ -1646,6 +1646,39 @@ static bool unix_skb_scm_eq(struct sk_buff *skb,
  *	Send AF_UNIX data.
  */
 
+/*
+ * Datagrams bigger than the head plus a full set of page frags used to
+ * put the remainder in one large linear head, a high order allocation
+ * for multi-MB messages. Chain page-only skbs as frag_list instead. They
+ * are charged to the sender like the head, without waiting for sndbuf
+ * room, as the whole message was already checked against it.
+ */
+static int unix_dgram_alloc_frag_list(struct sock *sk, struct sk_buff *skb,
+				      size_t len)
+{
+	struct sk_buff **next = &skb_shinfo(skb)->frag_list;
+	struct sk_buff *frag;
+	size_t chunk;
+	int err;
+
+	while (len) {
+		chunk = min_t(size_t, len, MAX_SKB_FRAGS * PAGE_SIZE);
+		frag = alloc_skb_with_frags(0, chunk, PAGE_ALLOC_COSTLY_ORDER,
+					    &err, sk->sk_allocation);
+		if (!frag)
+			return err;
+		skb_set_owner_w(frag, sk);
+		frag->data_len = chunk;
+		frag->len = chunk;
+
+		*next = frag;
+		next = &frag->next;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
 static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 			      size_t len)
 {
@@ -1662,6 +1695,7 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 	struct scm_cookie scm;
 	int max_level;
 	int data_len = 0;
+	size_t frag_list_len = 0;
 	int sk_locked;
 
 	wait_for_unix_gc();
@@ -1701,21 +1735,30 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 		data_len = PAGE_ALIGN(data_len);
 
 		BUILD_BUG_ON(SKB_MAX_ALLOC < PAGE_SIZE);
+
+		if (len - data_len > SKB_MAX_ALLOC)
+			frag_list_len = len - data_len - SKB_MAX_ALLOC;
 	}
 
-	skb = sock_alloc_send_pskb(sk, len - data_len, data_len,
+	skb = sock_alloc_send_pskb(sk, len - data_len - frag_list_len, data_len,
 				   msg->msg_flags & MSG_DONTWAIT, &err,
 				   PAGE_ALLOC_COSTLY_ORDER);
 	if (skb == NULL)
 		goto out;
 
+	if (frag_list_len) {
+		err = unix_dgram_alloc_frag_list(sk, skb, frag_list_len);
+		if (err)
+			goto out_free;
+	}
+
 	err = unix_scm_to_skb(&scm, skb, true);
 	if (err < 0)
 		goto out_free;
 	max_level = err + 1;
 
-	skb_put(skb, len - data_len);
-	skb->data_len = data_len;
+	skb_put(skb, len - data_len - frag_list_len);
+	skb->data_len = data_len + frag_list_len;
 	skb->len = len;
 	err = skb_copy_datagram_from_iter(skb, 0, &msg->msg_iter, len);
 	if (err)
@@ -2886,6 +2929,21 @@ static const struct net_proto_family unix_family_ops = {
 };
 
 
+#ifdef CONFIG_PROC_FS
+static int unix_gc_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, unix_gc_seq_show, NULL);
+}
+
+static const struct file_operations unix_gc_seq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= unix_gc_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int __net_init unix_net_init(struct net *net)
 {
 	int error = -ENOMEM;
@@ -2899,6 +2957,9 @@ static int __net_init unix_net_init(struct net *net)
 		unix_sysctl_unregister(net);
 		goto out;
 	}
+	/* the collector is global, report it once */
+	if (net_eq(net, &init_net))
+		proc_create("unix_gc", 0, net->proc_net, &unix_gc_seq_fops);
 #endif
 	error = 0;
 out:
@@ -2909,6 +2970,8 @@ static void __net_exit unix_net_exit(struct net *net)
 {
 	unix_sysctl_unregister(net);
 	remove_proc_entry("unix", net->proc_net);
+	if (net_eq(net, &init_net))
+		remove_proc_entry("unix_gc", net->proc_net);
 }
 
 static struct pernet_operations unix_net_ops = {
@@ -80,6 +80,8 @@
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -91,7 +93,15 @@
 /* Internal data structures and random procedures: */
 
 static LIST_HEAD(gc_candidates);
-static DECLARE_WAIT_QUEUE_HEAD(unix_gc_wait);
+
+/* Collector cost and frequency, protected by unix_gc_lock */
+static struct {
+	unsigned long runs;
+	unsigned long candidates;
+	unsigned long collected;
+	u64 total_ns;
+	u64 max_ns;
+} unix_gc_stats;
 
 static void scan_inflight(struct sock *x, void (*func)(struct unix_sock *),
 			  struct sk_buff_head *hitlist)
@@ -193,6 +203,10 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 
 static bool gc_in_progress;
 #define UNIX_INFLIGHT_TRIGGER_GC 16000
+#define UNIX_INFLIGHT_SANE_USER (SCM_MAX_FD * 8)
+
+static void __unix_gc(struct work_struct *work);
+static DECLARE_WORK(unix_gc_work, __unix_gc);
 
 void wait_for_unix_gc(void)
 {
@@ -204,27 +218,59 @@ void wait_for_unix_gc(void)
 	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
 	    !READ_ONCE(gc_in_progress))
 		unix_gc();
-	wait_event(unix_gc_wait, !READ_ONCE(gc_in_progress));
+
+	/* Only throttle the senders that keep many files in flight
+	 * themselves, everybody else goes on while the collector runs.
+	 */
+	if (READ_ONCE(current_user()->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
+		return;
+
+	if (READ_ONCE(gc_in_progress))
+		flush_work(&unix_gc_work);
 }
 
 /* The external entry point: unix_gc() */
 void unix_gc(void)
+{
+	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
+	WRITE_ONCE(gc_in_progress, true);
+	queue_work(system_unbound_wq, &unix_gc_work);
+}
+
+int unix_gc_seq_show(struct seq_file *seq, void *v)
+{
+	unsigned long runs, candidates, collected;
+	u64 total_ns, max_ns;
+
+	spin_lock(&unix_gc_lock);
+	runs = unix_gc_stats.runs;
+	candidates = unix_gc_stats.candidates;
+	collected = unix_gc_stats.collected;
+	total_ns = unix_gc_stats.total_ns;
+	max_ns = unix_gc_stats.max_ns;
+	spin_unlock(&unix_gc_lock);
+
+	seq_printf(seq, "inflight %u\nruns %lu\ncandidates %lu\n"
+		   "collected %lu\ntotal_us %llu\nmax_us %llu\n",
+		   READ_ONCE(unix_tot_inflight), runs, candidates, collected,
+		   div_u64(total_ns, NSEC_PER_USEC),
+		   div_u64(max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static void __unix_gc(struct work_struct *work)
 {
 	struct unix_sock *u;
 	struct unix_sock *next;
 	struct sk_buff_head hitlist;
 	struct list_head cursor;
 	LIST_HEAD(not_cycle_list);
+	unsigned long candidates = 0, collected;
+	ktime_t start = ktime_get();
+	u64 ns;
 
 	spin_lock(&unix_gc_lock);
 
-	/* Avoid a recursive GC. */
-	if (gc_in_progress)
-		goto out;
-
-	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
-	WRITE_ONCE(gc_in_progress, true);
-
 	/* First, select candidates for garbage collection.  Only
 	 * in-flight sockets are considered, and from those only ones
 	 * which don't have any external reference.
@@ -259,6 +305,7 @@ void unix_gc(void)
 		BUG_ON(!u->inflight);
 		BUG_ON(total_refs < u->inflight);
 		if (total_refs == u->inflight) {
+			candidates++;
 			list_move_tail(&u->link, &gc_candidates);
 			__set_bit(UNIX_GC_CANDIDATE, &u->gc_flags);
 			__set_bit(UNIX_GC_MAYBE_CYCLE, &u->gc_flags);
@@ -318,6 +365,7 @@ void unix_gc(void)
 	spin_unlock(&unix_gc_lock);
 
 	/* Here we are. Hitlist is filled. Die. */
+	collected = skb_queue_len(&hitlist);
 	__skb_queue_purge(&hitlist);
 
 	spin_lock(&unix_gc_lock);
@@ -328,8 +376,13 @@ void unix_gc(void)
 	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
 	WRITE_ONCE(gc_in_progress, false);
 
-	wake_up(&unix_gc_wait);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unix_gc_stats.runs++;
+	unix_gc_stats.candidates += candidates;
+	unix_gc_stats.collected += collected;
+	unix_gc_stats.total_ns += ns;
+	if (ns > unix_gc_stats.max_ns)
+		unix_gc_stats.max_ns = ns;
 
- out:
 	spin_unlock(&unix_gc_lock);
 }
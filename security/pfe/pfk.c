@@ -58,6 +58,7 @@
 #include "ecryptfs_kernel.h"
 #include "pfk_ice.h"
 #include "pfk_ext4.h"
+#include "pfk_fscrypt.h"
 #include "pfk_ecryptfs.h"
 #include "pfk_internal.h"
 #include "ext4.h"
@@ -70,7 +71,7 @@ static bool pfk_ready;
 #define PFK_SUPPORTED_SALT_SIZE 32
 
 /* Various PFE types and function tables to support each one of them */
-enum pfe_type {ECRYPTFS_PFE, EXT4_CRYPT_PFE, INVALID_PFE};
+enum pfe_type {ECRYPTFS_PFE, EXT4_CRYPT_PFE, FSCRYPT_PFE, INVALID_PFE};
 
 typedef int (*pfk_parse_inode_type)(const struct bio *bio,
 	const struct inode *inode,
@@ -85,16 +86,19 @@ typedef bool (*pfk_allow_merge_bio_type)(const struct bio *bio1,
 static const pfk_parse_inode_type pfk_parse_inode_ftable[] = {
 	/* ECRYPTFS_PFE */   &pfk_ecryptfs_parse_inode,
 	/* EXT4_CRYPT_PFE */ &pfk_ext4_parse_inode,
+	/* FSCRYPT_PFE */    &pfk_fscrypt_parse_inode,
 };
 
 static const pfk_allow_merge_bio_type pfk_allow_merge_bio_ftable[] = {
 	/* ECRYPTFS_PFE */   &pfk_ecryptfs_allow_merge_bio,
 	/* EXT4_CRYPT_PFE */ &pfk_ext4_allow_merge_bio,
+	/* FSCRYPT_PFE */    &pfk_fscrypt_allow_merge_bio,
 };
 
 static void __exit pfk_exit(void)
 {
 	pfk_ready = false;
+	pfk_fscrypt_deinit();
 	pfk_ext4_deinit();
 	pfk_ecryptfs_deinit();
 	pfk_kc_deinit();
@@ -115,9 +119,17 @@ static int __init pfk_init(void)
 		goto fail;
 	}
 
+	ret = pfk_fscrypt_init();
+	if (ret != 0) {
+		pfk_ext4_deinit();
+		pfk_ecryptfs_deinit();
+		goto fail;
+	}
+
 	ret = pfk_kc_init();
 	if (ret != 0) {
 		pr_err("could init pfk key cache, error %d\n", ret);
+		pfk_fscrypt_deinit();
 		pfk_ext4_deinit();
 		pfk_ecryptfs_deinit();
 		goto fail;
@@ -148,6 +160,9 @@ static enum pfe_type pfk_get_pfe_type(const struct inode *inode)
 	if (pfk_is_ext4_type(inode))
 		return EXT4_CRYPT_PFE;
 
+	if (pfk_is_fscrypt_type(inode))
+		return FSCRYPT_PFE;
+
 	return INVALID_PFE;
 }
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Per-File-Key (PFK) - fscrypt
+ *
+ * This driver is used for working with files encrypted through the generic
+ * fs/crypto layer when the filesystem lets the inline crypto engine handle
+ * their contents.
+ *
+ * The derived per-file key is kept in the inode's fscrypt_info when the key
+ * is set up, and is later looked up by the Block Device Driver to load it
+ * into the encryption hw.
+ */
+
+
+/* Uncomment the line below to enable debug messages */
+/* #define DEBUG 1 */
+#define pr_fmt(fmt)	"pfk_fscrypt [%s]: " fmt, __func__
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/errno.h>
+#include <linux/printk.h>
+
+#include "fscrypt_ice.h"
+#include "pfk_fscrypt.h"
+
+static bool pfk_fscrypt_ready;
+
+/*
+ * pfk_fscrypt_deinit() - Deinit function, should be invoked by upper PFK layer
+ */
+void pfk_fscrypt_deinit(void)
+{
+	pfk_fscrypt_ready = false;
+}
+
+/*
+ * pfk_fscrypt_init() - Init function, should be invoked by upper PFK layer
+ */
+int __init pfk_fscrypt_init(void)
+{
+	pfk_fscrypt_ready = true;
+	pr_info("PFK fscrypt inited successfully\n");
+
+	return 0;
+}
+
+/**
+ * pfk_fscrypt_is_ready() - driver is initialized and ready.
+ *
+ * Return: true if the driver is ready.
+ */
+static inline bool pfk_fscrypt_is_ready(void)
+{
+	return pfk_fscrypt_ready;
+}
+
+/**
+ * pfk_is_fscrypt_type() - return true if inode belongs to ICE fscrypt PFE
+ * @inode: inode pointer
+ */
+bool pfk_is_fscrypt_type(const struct inode *inode)
+{
+	return fscrypt_should_be_processed_by_ice(inode);
+}
+
+/**
+ * pfk_fscrypt_parse_cipher() - parse cipher from inode to enum
+ * @inode: inode
+ * @algo: pointer to store the output enum (can be null)
+ *
+ * return 0 in case of success, error otherwise (i.e not supported cipher)
+ */
+static int pfk_fscrypt_parse_cipher(const struct inode *inode,
+	enum ice_cryto_algo_mode *algo)
+{
+	if (!inode)
+		return -EINVAL;
+
+	if (!fscrypt_is_aes_xts_cipher(inode)) {
+		pr_err("fscrypt alghoritm is not supported by pfk\n");
+		return -EINVAL;
+	}
+
+	if (algo)
+		*algo = ICE_CRYPTO_ALGO_MODE_AES_XTS;
+
+	return 0;
+}
+
+
+int pfk_fscrypt_parse_inode(const struct bio *bio,
+	const struct inode *inode,
+	struct pfk_key_info *key_info,
+	enum ice_cryto_algo_mode *algo,
+	bool *is_pfe)
+{
+	int ret = 0;
+
+	if (!is_pfe)
+		return -EINVAL;
+
+	/*
+	 * only a few errors below can indicate that
+	 * this function was not invoked within PFE context,
+	 * otherwise we will consider it PFE
+	 */
+	*is_pfe = true;
+
+	if (!pfk_fscrypt_is_ready())
+		return -ENODEV;
+
+	if (!inode)
+		return -EINVAL;
+
+	if (!key_info)
+		return -EINVAL;
+
+	key_info->key = fscrypt_get_ice_encryption_key(inode);
+	if (!key_info->key) {
+		pr_err("could not parse key from fscrypt\n");
+		return -EINVAL;
+	}
+
+	key_info->key_size = fscrypt_get_ice_encryption_key_size(inode);
+	if (!key_info->key_size) {
+		pr_err("could not parse key size from fscrypt\n");
+		return -EINVAL;
+	}
+
+	key_info->salt = fscrypt_get_ice_encryption_salt(inode);
+	if (!key_info->salt) {
+		pr_err("could not parse salt from fscrypt\n");
+		return -EINVAL;
+	}
+
+	key_info->salt_size = fscrypt_get_ice_encryption_salt_size(inode);
+	if (!key_info->salt_size) {
+		pr_err("could not parse salt size from fscrypt\n");
+		return -EINVAL;
+	}
+
+	ret = pfk_fscrypt_parse_cipher(inode, algo);
+	if (ret != 0) {
+		pr_err("not supported cipher\n");
+		return ret;
+	}
+
+	return 0;
+}
+
+bool pfk_fscrypt_allow_merge_bio(const struct bio *bio1,
+	const struct bio *bio2, const struct inode *inode1,
+	const struct inode *inode2)
+{
+	/* if there is no fscrypt pfk, don't disallow merging blocks */
+	if (!pfk_fscrypt_is_ready())
+		return true;
+
+	if (!inode1 || !inode2)
+		return false;
+
+	return fscrypt_is_ice_encryption_info_equal(inode1, inode2);
+}
@@ -17,6 +17,7 @@
 #include <linux/of_gpio.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/rtmutex.h>
 #include <linux/regulator/consumer.h>
 #include <linux/io.h>
 #include <linux/module.h>
@@ -156,19 +157,24 @@ enum {
 	PCM_I2S_SEL_MAX,
 };
 
+/*
+ * The interface locks are taken from the RT audio threads on stream start
+ * and stop, so they are PI mutexes: a CFS task holding one gets boosted
+ * instead of delaying the audio thread.
+ */
 struct mi2s_aux_pcm_common_conf {
-	struct mutex lock;
+	struct rt_mutex lock;
 	void *pcm_i2s_sel_vt_addr;
 };
 
 struct mi2s_conf {
-	struct mutex lock;
+	struct rt_mutex lock;
 	u32 ref_cnt;
 	u32 msm_is_mi2s_master;
 };
 
 struct auxpcm_conf {
-	struct mutex lock;
+	struct rt_mutex lock;
 	u32 ref_cnt;
 };
 
@@ -5123,13 +5129,13 @@ static int msm_aux_pcm_snd_startup(struct snd_pcm_substream *substream)
 		goto done;
 	}
 
-	mutex_lock(&auxpcm_intf_conf[index].lock);
+	rt_mutex_lock(&auxpcm_intf_conf[index].lock);
 	if (++auxpcm_intf_conf[index].ref_cnt == 1) {
 		if (mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr != NULL) {
-			mutex_lock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_lock(&mi2s_auxpcm_conf[index].lock);
 			iowrite32(1,
 				mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr);
-			mutex_unlock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_unlock(&mi2s_auxpcm_conf[index].lock);
 		} else {
 			dev_err(rtd->card->dev,
 				"%s lpaif_tert_muxsel_virt_addr is NULL\n",
@@ -5140,7 +5146,7 @@ static int msm_aux_pcm_snd_startup(struct snd_pcm_substream *substream)
 	if (IS_ERR_VALUE(ret))
 		auxpcm_intf_conf[index].ref_cnt--;
 
-	mutex_unlock(&auxpcm_intf_conf[index].lock);
+	rt_mutex_unlock(&auxpcm_intf_conf[index].lock);
 
 done:
 	return ret;
@@ -5164,20 +5170,20 @@ static void msm_aux_pcm_snd_shutdown(struct snd_pcm_substream *substream)
 		return;
 	}
 
-	mutex_lock(&auxpcm_intf_conf[index].lock);
+	rt_mutex_lock(&auxpcm_intf_conf[index].lock);
 	if (--auxpcm_intf_conf[index].ref_cnt == 0) {
 		if (mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr != NULL) {
-			mutex_lock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_lock(&mi2s_auxpcm_conf[index].lock);
 			iowrite32(0,
 				mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr);
-			mutex_unlock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_unlock(&mi2s_auxpcm_conf[index].lock);
 		} else {
 			dev_err(rtd->card->dev,
 				"%s lpaif_tert_muxsel_virt_addr is NULL\n",
 				__func__);
 		}
 	}
-	mutex_unlock(&auxpcm_intf_conf[index].lock);
+	rt_mutex_unlock(&auxpcm_intf_conf[index].lock);
 }
 
 static int msm_get_port_id(int be_id)
@@ -6653,7 +6659,7 @@ static int msm_mi2s_snd_startup(struct snd_pcm_substream *substream)
 	 * interface using for both TX and RX  so
 	 * that the same clock won't be enable twice.
 	 */
-	mutex_lock(&mi2s_intf_conf[index].lock);
+	rt_mutex_lock(&mi2s_intf_conf[index].lock);
 	if (++mi2s_intf_conf[index].ref_cnt == 1) {
 		/* Check if msm needs to provide the clock to the interface */
 		if (!mi2s_intf_conf[index].msm_is_mi2s_master) {
@@ -6668,10 +6674,10 @@ static int msm_mi2s_snd_startup(struct snd_pcm_substream *substream)
 			goto clean_up;
 		}
 		if (mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr != NULL) {
-			mutex_lock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_lock(&mi2s_auxpcm_conf[index].lock);
 			iowrite32(0,
 				mi2s_auxpcm_conf[index].pcm_i2s_sel_vt_addr);
-			mutex_unlock(&mi2s_auxpcm_conf[index].lock);
+			rt_mutex_unlock(&mi2s_auxpcm_conf[index].lock);
 		} else {
 			dev_err(rtd->card->dev,
 				"%s lpaif_muxsel_virt_addr is NULL for dai %d\n",
@@ -6692,7 +6698,7 @@ clk_off:
 clean_up:
 	if (IS_ERR_VALUE(ret))
 		mi2s_intf_conf[index].ref_cnt--;
-	mutex_unlock(&mi2s_intf_conf[index].lock);
+	rt_mutex_unlock(&mi2s_intf_conf[index].lock);
 done:
 	return ret;
 }
@@ -6714,14 +6720,14 @@ static void msm_mi2s_snd_shutdown(struct snd_pcm_substream *substream)
 		return;
 	}
 
-	mutex_lock(&mi2s_intf_conf[index].lock);
+	rt_mutex_lock(&mi2s_intf_conf[index].lock);
 	if (--mi2s_intf_conf[index].ref_cnt == 0) {
 		ret = msm_mi2s_set_sclk(substream, false);
 		if (ret < 0)
 			pr_err("%s:clock disable failed for MI2S (%d); ret=%d\n",
 				__func__, index, ret);
 	}
-	mutex_unlock(&mi2s_intf_conf[index].lock);
+	rt_mutex_unlock(&mi2s_intf_conf[index].lock);
 
 	if (index == QUAT_MI2S) {
 		ret_pinctrl = msm_set_pinctrl(pinctrl_info, STATE_DISABLE);
@@ -9627,17 +9633,17 @@ static void i2s_auxpcm_init(struct platform_device *pdev)
 	};
 
 	for (count = 0; count < MI2S_MAX; count++) {
-		mutex_init(&mi2s_intf_conf[count].lock);
+		rt_mutex_init(&mi2s_intf_conf[count].lock);
 		mi2s_intf_conf[count].ref_cnt = 0;
 	}
 
 	for (count = 0; count < AUX_PCM_MAX; count++) {
-		mutex_init(&auxpcm_intf_conf[count].lock);
+		rt_mutex_init(&auxpcm_intf_conf[count].lock);
 		auxpcm_intf_conf[count].ref_cnt = 0;
 	}
 
 	for (count = 0; count < PCM_I2S_SEL_MAX; count++) {
-		mutex_init(&mi2s_auxpcm_conf[count].lock);
+		rt_mutex_init(&mi2s_auxpcm_conf[count].lock);
 		mi2s_auxpcm_conf[count].pcm_i2s_sel_vt_addr = NULL;
 	}
 